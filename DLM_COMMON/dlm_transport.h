@@ -0,0 +1,353 @@
+/**
+ * @file dlm_transport.h
+ * @brief DLM 侧 Standard MIH 传输层 - 批量发送与预读接收
+ * @date 2025-12-02
+ *
+ * 帧格式与 CM Core 的 mih_transport.h 一致: 12 字节头部 + 原语结构体。
+ *
+ * - 连接: 优先 SOCK_SEQPACKET (内核保留消息边界),
+ *         CM Core 未提供时回退 SOCK_STREAM
+ * - 发送: 单条原语以 iovec 一次 sendmsg() 发出, 有效载荷不拷贝;
+ *         批量模式下多个原语累积后一次系统调用发出
+ *         (流式: 一次 send(); 顺序包: 一次 sendmmsg(), 每个原语一条记录)
+ * - 接收: 流式连接一次 recv() 预读尽可能多的数据, 逐帧返回缓冲区内指针;
+ *         顺序包连接每次 recv() 恰好得到一帧
+ *
+ * 使用本文件的 DLM 须在包含任何系统头文件之前定义 _GNU_SOURCE (sendmmsg)。
+ */
+
+#ifndef DLM_TRANSPORT_H
+#define DLM_TRANSPORT_H
+
+#include "dlm_common.h"
+#include <sys/uio.h>
+#include <sys/un.h>
+
+/*===========================================================================
+ * 传输配置
+ *===========================================================================*/
+
+#define DLM_MIH_STREAM_PATH     "/tmp/magic_core.sock"      /* 流式 Socket */
+#define DLM_MIH_SEQPACKET_PATH  "/tmp/magic_core_seq.sock"  /* 顺序包 Socket */
+#define DLM_MIH_MAX_FRAME       65535   /* 帧上限 (message_length 为 16 位) */
+#define DLM_RX_BUFFER_SIZE      65536   /* 预读缓冲区, 可容纳一个最大帧 */
+#define DLM_TX_BATCH_MAX        32      /* 单批最多原语数 */
+#define DLM_TX_BATCH_BYTES      16384   /* 单批暂存区大小 */
+
+/*===========================================================================
+ * 帧头
+ *===========================================================================*/
+
+/* 12字节传输头 */
+typedef struct {
+    uint16_t primitive_type;  // MIH 原语类型码
+    uint16_t message_length;  // 总长度 (Header + Payload)
+    uint32_t transaction_id;  // 事务 ID
+    uint32_t timestamp;       // 发送时间戳
+} __attribute__((packed)) mih_transport_header_t;
+
+/*===========================================================================
+ * 连接
+ *===========================================================================*/
+
+/**
+ * @brief 连接 CM Core, 优先使用顺序包 Socket
+ * @param seqpacket 输出: 是否为 SOCK_SEQPACKET 连接
+ * @return 成功返回 Socket FD, 失败返回 -1
+ */
+static inline int dlm_transport_connect(bool* seqpacket)
+{
+    static const struct {
+        int         type;
+        const char* path;
+    } candidates[] = {
+        { SOCK_SEQPACKET, DLM_MIH_SEQPACKET_PATH },
+        { SOCK_STREAM,    DLM_MIH_STREAM_PATH },
+    };
+
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        int fd = socket(AF_UNIX, candidates[i].type, 0);
+        if (fd < 0) {
+            continue;
+        }
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, candidates[i].path, sizeof(addr.sun_path) - 1);
+
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            *seqpacket = (candidates[i].type == SOCK_SEQPACKET);
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+/*===========================================================================
+ * 发送
+ *===========================================================================*/
+
+/**
+ * @brief 发送批: 累积多个已编码的帧, 一次系统调用发出
+ */
+typedef struct {
+    int         fd;
+    bool        seqpacket;
+    int         count;                           /* 已累积的帧数 */
+    size_t      used;                            /* 暂存区已用字节 */
+    uint16_t    frame_len[DLM_TX_BATCH_MAX];     /* 各帧长度 */
+    uint8_t     buf[DLM_TX_BATCH_BYTES];         /* 帧暂存区 (连续存放) */
+} dlm_tx_batch_t;
+
+/* 当前线程正在累积的批 (NULL 表示直接发送) */
+static __thread dlm_tx_batch_t* dlm_tx_current = NULL;
+
+/* 多个线程共用一个连接: 批发出与单条发送互斥, 流式连接上帧不会交错 */
+static pthread_mutex_t dlm_tx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 发出批中累积的全部帧
+ * @return 0 成功, -1 失败
+ */
+static inline int dlm_tx_batch_flush(dlm_tx_batch_t* batch)
+{
+    int ret = 0;
+
+    if (batch->count == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&dlm_tx_lock);
+    if (batch->seqpacket) {
+        /* 每帧一条记录, 一次 sendmmsg() 发出 */
+        struct iovec iov[DLM_TX_BATCH_MAX];
+        struct mmsghdr msgs[DLM_TX_BATCH_MAX];
+        size_t off = 0;
+
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < batch->count; i++) {
+            iov[i].iov_base = batch->buf + off;
+            iov[i].iov_len = batch->frame_len[i];
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            off += batch->frame_len[i];
+        }
+
+        int done = 0;
+        while (done < batch->count) {
+            int n = sendmmsg(batch->fd, msgs + done, batch->count - done,
+                             MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ret = -1;
+                break;
+            }
+            done += n;
+        }
+    } else {
+        /* 流式连接: 帧已连续存放, 一次 send() 发出 */
+        size_t sent = 0;
+        while (sent < batch->used) {
+            ssize_t n = send(batch->fd, batch->buf + sent, batch->used - sent,
+                             MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ret = -1;
+                break;
+            }
+            sent += (size_t)n;
+        }
+    }
+    pthread_mutex_unlock(&dlm_tx_lock);
+
+    batch->count = 0;
+    batch->used = 0;
+    return ret;
+}
+
+/**
+ * @brief 开始在当前线程累积发送 (之后 dlm_transport_send 先写入批)
+ */
+static inline void dlm_tx_batch_begin(dlm_tx_batch_t* batch, int fd,
+                                      bool seqpacket)
+{
+    batch->fd = fd;
+    batch->seqpacket = seqpacket;
+    batch->count = 0;
+    batch->used = 0;
+    dlm_tx_current = batch;
+}
+
+/**
+ * @brief 结束累积并发出剩余帧
+ * @return 0 成功, -1 失败
+ */
+static inline int dlm_tx_batch_end(dlm_tx_batch_t* batch)
+{
+    dlm_tx_current = NULL;
+    return dlm_tx_batch_flush(batch);
+}
+
+/**
+ * @brief 发送一个 MIH 原语
+ *
+ * 当前线程处于批量模式时追加到批 (满则先发出); 否则头部与有效载荷
+ * 以两个 iovec 一次 sendmsg() 发出, 不拷贝有效载荷。
+ *
+ * @param fd Socket FD
+ * @param hdr 已填好的帧头 (message_length 含头部)
+ * @param payload 有效载荷 (可为 NULL)
+ * @return 0 成功, -1 失败
+ */
+static inline int dlm_transport_send(int fd, const mih_transport_header_t* hdr,
+                                     const void* payload)
+{
+    size_t payload_len = hdr->message_length - sizeof(*hdr);
+    dlm_tx_batch_t* batch = dlm_tx_current;
+
+    if (batch && batch->fd == fd && hdr->message_length <= sizeof(batch->buf)) {
+        if (batch->count == DLM_TX_BATCH_MAX ||
+            batch->used + hdr->message_length > sizeof(batch->buf)) {
+            if (dlm_tx_batch_flush(batch) != 0) {
+                return -1;
+            }
+        }
+        memcpy(batch->buf + batch->used, hdr, sizeof(*hdr));
+        if (payload_len > 0) {
+            memcpy(batch->buf + batch->used + sizeof(*hdr), payload,
+                   payload_len);
+        }
+        batch->frame_len[batch->count++] = hdr->message_length;
+        batch->used += hdr->message_length;
+        return 0;
+    }
+
+    /* 超出暂存区的大帧: 先发出已累积的帧, 保持原语顺序 */
+    if (batch && batch->fd == fd && dlm_tx_batch_flush(batch) != 0) {
+        return -1;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)hdr;
+    iov[0].iov_len = sizeof(*hdr);
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = payload_len;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = payload_len > 0 ? 2 : 1;
+
+    pthread_mutex_lock(&dlm_tx_lock);
+    ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    pthread_mutex_unlock(&dlm_tx_lock);
+    if (sent < 0 || (size_t)sent != hdr->message_length) {
+        return -1;
+    }
+    return 0;
+}
+
+/*===========================================================================
+ * 接收
+ *===========================================================================*/
+
+#define DLM_RX_CLOSED   (-2)    /* 对端正常关闭连接 */
+
+/**
+ * @brief 预读接收器 (仅由接收线程使用)
+ */
+typedef struct {
+    int         fd;
+    bool        seqpacket;
+    size_t      start;                      /* 下一帧在缓冲区中的偏移 */
+    size_t      len;                        /* 缓冲区中未处理的字节数 */
+    uint8_t     buf[DLM_RX_BUFFER_SIZE];
+} dlm_rx_reader_t;
+
+static inline void dlm_rx_reader_init(dlm_rx_reader_t* r, int fd,
+                                      bool seqpacket)
+{
+    r->fd = fd;
+    r->seqpacket = seqpacket;
+    r->start = 0;
+    r->len = 0;
+}
+
+/**
+ * @brief 缓冲区中是否已有完整的帧 (下一次 dlm_rx_reader_next 不会阻塞)
+ */
+static inline bool dlm_rx_reader_has_frame(const dlm_rx_reader_t* r)
+{
+    mih_transport_header_t hdr;
+
+    if (r->len < sizeof(hdr)) {
+        return false;
+    }
+    memcpy(&hdr, r->buf + r->start, sizeof(hdr));
+    return r->len >= hdr.message_length;
+}
+
+/**
+ * @brief 取下一帧 (缓冲区中没有完整帧时阻塞读取)
+ *
+ * @param r 接收器
+ * @param hdr 输出: 帧头
+ * @param payload 输出: 有效载荷指针, 指向接收缓冲区 (不保证按结构体对齐),
+ *                在下一次调用前有效
+ * @return 有效载荷长度; -1 接收错误或帧非法; DLM_RX_CLOSED 对端关闭
+ */
+static inline int dlm_rx_reader_next(dlm_rx_reader_t* r,
+                                     mih_transport_header_t* hdr,
+                                     const uint8_t** payload)
+{
+    /* 跳过上一次返回的帧 (顺序包每次重新读取整条记录) */
+    if (r->seqpacket) {
+        r->start = 0;
+        r->len = 0;
+    }
+
+    while (!dlm_rx_reader_has_frame(r)) {
+        /* 半帧移到缓冲区头部, 为预读腾出空间 */
+        if (r->start > 0) {
+            memmove(r->buf, r->buf + r->start, r->len);
+            r->start = 0;
+        }
+
+        ssize_t n = recv(r->fd, r->buf + r->len, sizeof(r->buf) - r->len, 0);
+        if (n == 0) {
+            return DLM_RX_CLOSED;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        r->len += (size_t)n;
+
+        /* 顺序包记录须恰好是一个完整帧 */
+        if (r->seqpacket && !dlm_rx_reader_has_frame(r)) {
+            errno = EPROTO;
+            return -1;
+        }
+    }
+
+    memcpy(hdr, r->buf + r->start, sizeof(*hdr));
+    if (hdr->message_length < sizeof(*hdr) ||
+        (r->seqpacket && hdr->message_length != r->len)) {
+        errno = EPROTO;   /* 帧长度非法, 无法再定位帧边界 */
+        return -1;
+    }
+    *payload = r->buf + r->start + sizeof(*hdr);
+    r->start += hdr->message_length;
+    r->len -= hdr->message_length;
+    return (int)(hdr->message_length - sizeof(*hdr));
+}
+
+#endif /* DLM_TRANSPORT_H */
@@ -15,6 +15,8 @@
  * ============================================================================
  */
 
+#define _GNU_SOURCE /* sendmmsg (dlm_transport.h) */
+
 #include <arpa/inet.h>
 #include <ctype.h>
 #include <errno.h>
@@ -32,9 +34,11 @@
 
 /* 引入公共 DLM 定义 */
 #include "../DLM_COMMON/dlm_common.h"
+#include "../DLM_COMMON/dlm_transport.h"
 
 /* 引入 MIH 协议定义 */
 #include "../extensions/app_magic/mih_extensions.h"
+#include "../extensions/app_magic/mih_linkstate.h"
 #include "../extensions/app_magic/mih_protocol.h"
 
 /* ============================================================================
@@ -43,20 +47,6 @@
  */
 
 #define DEFAULT_CONFIG_PATH "../DLM_CONFIG/dlm_wifi.ini"
-#define MIH_STANDARD_SOCKET_PATH "/tmp/magic_core.sock"
-
-/* ============================================================================
- * 传输层定义 (Standard MIH)
- * ============================================================================
- */
-
-/* 12字节传输头 */
-typedef struct {
-  uint16_t primitive_type; // MIH 原语类型码
-  uint16_t message_length; // 总长度 (Header + Payload)
-  uint32_t transaction_id; // 事务 ID
-  uint32_t timestamp;      // 发送时间戳
-} __attribute__((packed)) mih_transport_header_t;
 
 /* ============================================================================
  * 全局上下文
@@ -67,6 +57,12 @@ static dlm_context_t g_ctx;
 static dlm_network_config_t g_net_config;
 static volatile int g_running = 1;
 static uint32_t g_transaction_id_counter = 1;
+static bool g_seqpacket = false;     /* SOCK_SEQPACKET 连接 */
+static dlm_rx_reader_t g_rx_reader;  /* 接收线程预读缓冲区 */
+
+/* 共享内存链路状态表 (CM Core 未创建时为 NULL, 仅经 Socket 上报) */
+static mih_linkstate_region_t *g_linkstate = NULL;
+static mih_linkstate_slot_t *g_linkstate_slot = NULL;
 
 /* ============================================================================
  * 前向声明
@@ -75,10 +71,12 @@ static uint32_t g_transaction_id_counter = 1;
 
 static int dlm_init_config_manager(const char *config_path);
 static int dlm_init_state_simulator(void);
-static int dlm_init_socket(void);
 static int dlm_connect_to_server(void);
 static int dlm_send_mih_message(uint16_t type, const void *payload,
                                 uint16_t payload_len);
+static int dlm_send_mih_message_txn(uint16_t type, const void *payload,
+                                    uint16_t payload_len,
+                                    uint32_t transaction_id);
 static int dlm_send_register_request(void);
 static void dlm_signal_handler(int sig);
 static void *dlm_reporting_thread(void *arg);
@@ -238,31 +236,18 @@ static int dlm_init_state_simulator(void) {
  * ============================================================================
  */
 
-static int dlm_init_socket(void) {
-  /* 创建 STREAM Socket */
-  g_ctx.socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (g_ctx.socket_fd < 0) {
-    perror("[WIFI] socket() failed");
-    return -1;
-  }
-  return 0;
-}
-
 static int dlm_connect_to_server(void) {
-  struct sockaddr_un addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sun_family = AF_UNIX;
-  strncpy(addr.sun_path, MIH_STANDARD_SOCKET_PATH, sizeof(addr.sun_path) - 1);
-
-  printf("[WIFI] Connecting to MIH Server at %s ...\n",
-         MIH_STANDARD_SOCKET_PATH);
+  printf("[WIFI] Connecting to MIH Server at %s (fallback %s) ...\n",
+         DLM_MIH_SEQPACKET_PATH, DLM_MIH_STREAM_PATH);
 
-  if (connect(g_ctx.socket_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+  g_ctx.socket_fd = dlm_transport_connect(&g_seqpacket);
+  if (g_ctx.socket_fd < 0) {
     perror("[WIFI] connect() failed");
     return -1;
   }
 
-  printf("[WIFI] Connected! Sending Registration...\n");
+  printf("[WIFI] Connected (%s)! Sending Registration...\n",
+         g_seqpacket ? "SOCK_SEQPACKET" : "SOCK_STREAM");
   return dlm_send_register_request();
 }
 
@@ -271,25 +256,31 @@ static int dlm_connect_to_server(void) {
  */
 static int dlm_send_mih_message(uint16_t type, const void *payload,
                                 uint16_t payload_len) {
-  uint8_t buffer[4096];
-  if (sizeof(mih_transport_header_t) + payload_len > sizeof(buffer)) {
+  return dlm_send_mih_message_txn(type, payload, payload_len, 0);
+}
+
+/**
+ * @brief 构建并发送携带指定事务 ID 的 Standard MIH 消息
+ * @details Confirm 原语回显对应 Request 的事务 ID, 供 CM Core 匹配;
+ *          transaction_id 为 0 时使用本地计数器
+ */
+static int dlm_send_mih_message_txn(uint16_t type, const void *payload,
+                                    uint16_t payload_len,
+                                    uint32_t transaction_id) {
+  if (sizeof(mih_transport_header_t) + payload_len > DLM_MIH_MAX_FRAME) {
     fprintf(stderr, "[WIFI] Message too large\n");
     return -1;
   }
 
-  mih_transport_header_t *hdr = (mih_transport_header_t *)buffer;
-  hdr->primitive_type = type;
-  hdr->message_length = sizeof(mih_transport_header_t) + payload_len;
-  hdr->transaction_id = g_transaction_id_counter++;
-  hdr->timestamp = (uint32_t)time(NULL);
-
-  if (payload && payload_len > 0) {
-    memcpy(buffer + sizeof(mih_transport_header_t), payload, payload_len);
-  }
+  mih_transport_header_t hdr;
+  hdr.primitive_type = type;
+  hdr.message_length = sizeof(mih_transport_header_t) + payload_len;
+  hdr.transaction_id =
+      transaction_id ? transaction_id : g_transaction_id_counter++;
+  hdr.timestamp = (uint32_t)time(NULL);
 
-  ssize_t sent =
-      send(g_ctx.socket_fd, buffer, hdr->message_length, MSG_NOSIGNAL);
-  if (sent < 0) {
+  /* 接收/上报线程处于批量模式时先累积, 否则头部与载荷一次 sendmsg() 发出 */
+  if (dlm_transport_send(g_ctx.socket_fd, &hdr, payload) != 0) {
     perror("[WIFI] send() failed");
     return -1;
   }
@@ -347,6 +338,45 @@ static void dlm_send_heartbeat(void) {
   dlm_send_mih_message(MIH_EXT_HEARTBEAT, &hb, sizeof(hb));
 }
 
+/* ============================================================================
+ * 共享内存链路状态发布
+ * ============================================================================
+ */
+
+/*
+ * 将当前链路状态写入共享内存槽位, CM Core 策略引擎无锁读取。
+ * 发布在 g_ctx.state.mutex 内完成: 读取的状态一致, 且多个线程发布时
+ * 槽位仍只有一个写者 (seqlock 要求)。
+ */
+static void dlm_publish_link_state(void) {
+  if (!g_linkstate_slot) {
+    return;
+  }
+
+  mih_linkstate_snapshot_t st;
+  memset(&st, 0, sizeof(st));
+
+  pthread_mutex_lock(&g_ctx.state.mutex);
+  if (!g_ctx.state.is_connected) {
+    st.link_state = LINK_STATE_DOWN;
+  } else if (g_ctx.state.is_going_down) {
+    st.link_state = LINK_STATE_GOING_DOWN;
+  } else {
+    st.link_state = LINK_STATE_UP;
+  }
+  st.signal_quality = g_ctx.state.signal_quality;
+  st.active_bearers = g_ctx.state.num_active_bearers;
+  st.signal_strength_dbm = g_ctx.state.simulated_rssi;
+  st.available_bandwidth_kbps =
+      g_ctx.config.max_bandwidth_fl - g_ctx.state.current_usage_fl;
+  st.current_tx_rate_kbps = g_ctx.state.current_usage_rl;
+  st.current_rx_rate_kbps = g_ctx.state.current_usage_fl;
+  st.current_latency_ms = g_ctx.config.reported_delay_ms;
+  st.current_jitter_ms = g_ctx.config.delay_jitter_ms;
+  mih_linkstate_publish(g_linkstate_slot, &st);
+  pthread_mutex_unlock(&g_ctx.state.mutex);
+}
+
 /* ============================================================================
  * 物理链路操作 (Migrated from Prototype)
  * ============================================================================
@@ -375,6 +405,7 @@ static int dlm_physical_link_up(void) {
   g_ctx.state.is_going_down = 0;
   g_ctx.state.last_up_time = time(NULL);
   pthread_mutex_unlock(&g_ctx.state.mutex);
+  dlm_publish_link_state();
 
   /* 发送 Link_Up 指示 */
   mih_link_up_ind_t ind;
@@ -417,6 +448,7 @@ static int dlm_physical_link_down(int reason_code) {
   g_ctx.state.is_going_down = 0;
   g_ctx.state.last_down_time = time(NULL);
   pthread_mutex_unlock(&g_ctx.state.mutex);
+  dlm_publish_link_state();
 
   /* 发送 Link_Down 指示 */
   mih_link_down_ind_t ind;
@@ -438,7 +470,8 @@ static int dlm_physical_link_down(int reason_code) {
  * ============================================================================
  */
 
-static int dlm_handle_link_resource(const LINK_Resource_Request *req) {
+static int dlm_handle_link_resource(const LINK_Resource_Request *req,
+                                    uint32_t transaction_id) {
   printf("[WIFI-PRIM] 处理 Link_Resource.request\n");
 
   LINK_Resource_Confirm confirm;
@@ -477,7 +510,11 @@ static int dlm_handle_link_resource(const LINK_Resource_Request *req) {
     }
   }
 
-  return dlm_send_mih_message(MIH_LINK_RESOURCE_CNF, &confirm, sizeof(confirm));
+  /* Bearer 数与可用带宽已变化, 立即更新共享链路状态 */
+  dlm_publish_link_state();
+
+  return dlm_send_mih_message_txn(MIH_LINK_RESOURCE_CNF, &confirm,
+                                  sizeof(confirm), transaction_id);
 }
 
 static int dlm_handle_capability_discover(const LINK_Capability_Discover_Request *req) {
@@ -639,14 +676,24 @@ static int dlm_send_parameters_report(void) {
 }
 
 static void *dlm_message_receiver_thread(void *arg) {
-  uint8_t recv_buf[4096];
+  dlm_tx_batch_t batch;
   printf("[WIFI-THR] Receiver Thread started\n");
 
+  /* 同一批到达的请求, 其应答累积后一次发出 */
+  dlm_rx_reader_init(&g_rx_reader, g_ctx.socket_fd, g_seqpacket);
+  dlm_tx_batch_begin(&batch, g_ctx.socket_fd, g_seqpacket);
+
   while (g_running) {
-    ssize_t n = recv(g_ctx.socket_fd, recv_buf, sizeof(mih_transport_header_t),
-                     MSG_WAITALL);
-    if (n <= 0) {
-      if (n == 0) {
+    /* 预读缓冲区已处理完, 阻塞等待前先发出累积的应答 */
+    if (!dlm_rx_reader_has_frame(&g_rx_reader)) {
+      dlm_tx_batch_flush(&batch);
+    }
+
+    mih_transport_header_t frame;
+    const uint8_t *payload = NULL;
+    int n = dlm_rx_reader_next(&g_rx_reader, &frame, &payload);
+    if (n < 0) {
+      if (n == DLM_RX_CLOSED) {
         fprintf(stderr, "[WIFI] Server closed connection cleanly\n");
       } else {
         fprintf(stderr, "[WIFI] recv() error: %s (errno=%d)\n", strerror(errno), errno);
@@ -655,19 +702,8 @@ static void *dlm_message_receiver_thread(void *arg) {
       break;
     }
 
-    mih_transport_header_t *hdr = (mih_transport_header_t *)recv_buf;
-    uint16_t payload_len = hdr->message_length - sizeof(mih_transport_header_t);
-
-    if (payload_len > 0) {
-      n = recv(g_ctx.socket_fd, recv_buf + sizeof(mih_transport_header_t),
-               payload_len, MSG_WAITALL);
-      if (n <= 0) {
-        fprintf(stderr, "[WIFI] recv() payload error: %s\n", strerror(errno));
-        break;
-      }
-    }
-
-    uint8_t *payload = recv_buf + sizeof(mih_transport_header_t);
+    mih_transport_header_t *hdr = &frame;
+    uint16_t payload_len = (uint16_t)n;
 
     switch (hdr->primitive_type) {
     case MIH_EXT_LINK_REGISTER_CONFIRM:
@@ -685,7 +721,8 @@ static void *dlm_message_receiver_thread(void *arg) {
     case MIH_LINK_RESOURCE_REQ:
       /* 资源分配请求 */
       if (payload_len >= sizeof(LINK_Resource_Request)) {
-        dlm_handle_link_resource((LINK_Resource_Request *)payload);
+        dlm_handle_link_resource((LINK_Resource_Request *)payload,
+                                 hdr->transaction_id);
       }
       break;
 
@@ -724,6 +761,7 @@ static void *dlm_message_receiver_thread(void *arg) {
       break;
     }
   }
+  dlm_tx_batch_end(&batch);
   return NULL;
 }
 
@@ -754,12 +792,18 @@ static void *dlm_reporting_thread(void *arg) {
     }
     prev_iface_up = curr_iface_up;
 
+    /* 共享链路状态每秒刷新 (断开时同样发布, CM Core 据此判定新鲜度) */
+    dlm_publish_link_state();
+
     /* 心跳 & 报告 (仅在链路已连接时发送) */
     pthread_mutex_lock(&g_ctx.state.mutex);
     bool is_connected = g_ctx.state.is_connected;
     pthread_mutex_unlock(&g_ctx.state.mutex);
 
     if (is_connected) {
+      /* 心跳与参数报告合并为一次系统调用 */
+      dlm_tx_batch_t batch;
+      dlm_tx_batch_begin(&batch, g_ctx.socket_fd, g_seqpacket);
       dlm_send_heartbeat();
 
       static int report_counter = 0;
@@ -767,6 +811,7 @@ static void *dlm_reporting_thread(void *arg) {
         report_counter = 0;
         dlm_send_parameters_report();
       }
+      dlm_tx_batch_end(&batch);
     }
   }
   return NULL;
@@ -797,14 +842,25 @@ int main(int argc, char **argv) {
   dlm_init_config_manager(config_path);
   dlm_init_state_simulator();
 
-  if (dlm_init_socket() != 0)
-    return -1;
   if (dlm_connect_to_server() != 0) {
     fprintf(stderr, "[WIFI] Failed to connect to Standard MIH Server. Is "
                     "app_magic running?\n");
     return -1;
   }
 
+  /* 附着 CM Core 创建的共享链路状态表 */
+  g_linkstate = mih_linkstate_attach();
+  if (g_linkstate) {
+    g_linkstate_slot = mih_linkstate_claim(g_linkstate, g_ctx.config.link_name);
+  }
+  if (g_linkstate_slot) {
+    dlm_publish_link_state();
+    printf("[WIFI] Shared link-state slot claimed\n");
+  } else {
+    printf("[WIFI] Shared link-state table unavailable, "
+           "socket reports only\n");
+  }
+
   pthread_t rpt_thread, rx_thread, pkt_thread;
   pthread_create(&rpt_thread, NULL, dlm_reporting_thread, NULL);
   pthread_create(&rx_thread, NULL, dlm_message_receiver_thread, NULL);
@@ -814,6 +870,12 @@ int main(int argc, char **argv) {
   pthread_join(rpt_thread, NULL);
   pthread_join(pkt_thread, NULL);
 
+  /* 释放槽位 (状态置为 Down), CM Core 立即看到链路不可用 */
+  if (g_linkstate_slot) {
+    mih_linkstate_release(g_linkstate_slot);
+  }
+  mih_linkstate_detach(g_linkstate);
+
   close(g_ctx.socket_fd);
   printf("[WIFI] Terminated.\n");
   return 0;
@@ -37,10 +37,233 @@
  */
 MagicContext g_magic_ctx;
 
+/*===========================================================================
+ * 流量计费周期更新
+ *===========================================================================*/
+
+/**
+ * @brief 周期性把流量计数写入活动会话的 CDR (定时器线程)。
+ * @details 每轮先整体刷新一次流量统计 (nftables 计数器后端下为一次 netlink
+ * dump)，随后按会话 ID 快照逐会话读取内存中的 mark 槽位，在会话锁内回写
+ * 会话的流量缓存，并通过会话索引更新 CDR
+ * (cdr_update_session_traffic，无逐记录加锁)，最后重新调度自身。
+ * 扩展退出 (running=false) 后不再调度。
+ *
+ * @param[in] arg 未使用。
+ */
+static void traffic_cdr_tick(void *arg) {
+  (void)arg;
+
+  if (!g_magic_ctx.running) {
+    return;
+  }
+
+  if (traffic_refresh_stats(&g_magic_ctx.traffic_ctx) == 0) {
+    /* 会话 ID 快照: 读取统计与更新 CDR 时不持会话锁，会话字段在锁内回写。
+     * 缓冲区随会话池容量增长，仅定时器线程使用 */
+    static char (*ids)[MAX_SESSION_ID_LEN];
+    static int ids_cap;
+    int capacity = magic_session_capacity(&g_magic_ctx.session_mgr);
+    if (capacity > ids_cap) {
+      void *p = realloc(ids, (size_t)capacity * sizeof(*ids));
+      if (p) {
+        ids = p;
+        ids_cap = capacity;
+      }
+    }
+    int count = magic_session_get_active_ids(&g_magic_ctx.session_mgr, ids,
+                                             ids_cap);
+
+    for (int i = 0; i < count; i++) {
+      TrafficStats stats;
+      if (traffic_get_session_stats(&g_magic_ctx.traffic_ctx, ids[i],
+                                    &stats) != 0) {
+        continue;
+      }
+
+      if (magic_session_update_traffic(&g_magic_ctx.session_mgr, ids[i],
+                                       stats.bytes_in, stats.bytes_out) != 0) {
+        continue; /* 快照之后会话已删除 */
+      }
+
+      cdr_update_session_traffic(&g_magic_ctx.cdr_mgr, ids[i], stats.bytes_in,
+                                 stats.bytes_out, stats.packets_in,
+                                 stats.packets_out);
+    }
+  }
+
+  magic_timer_schedule(&g_magic_ctx.timer_ctx, TRAFFIC_CDR_UPDATE_MS,
+                       traffic_cdr_tick, NULL);
+}
+
+/**
+ * @brief 周期检查计费导出分段是否到期轮转 (定时器线程)。
+ * @details 与流量监控无关: 只要 CDR 管理器可用就调度，空闲时也能按时
+ * 关闭分段。扩展退出 (running=false) 后不再调度。
+ *
+ * @param[in] arg 未使用。
+ */
+static void cdr_export_tick_timer(void *arg) {
+  (void)arg;
+
+  if (!g_magic_ctx.running) {
+    return;
+  }
+
+  cdr_export_tick(&g_magic_ctx.cdr_mgr.exporter);
+
+  magic_timer_schedule(&g_magic_ctx.timer_ctx, CDR_EXPORT_TICK_MS,
+                       cdr_export_tick_timer, NULL);
+}
+
+/**
+ * @brief 流量监控归属回调: 用全局流分类器把连接归到 TFT 匹配的会话。
+ * @details 连接原方向由客户端发起时按 TFT-to-Ground 匹配，由地面发起时
+ *          按 TFT-to-Aircraft 匹配。
+ *
+ * @param[in] arg 流分类器。
+ * @param[in] tuple 连接原方向五元组。
+ * @param[out] session_id 命中会话 ID。
+ * @param[in] len session_id 缓冲区长度。
+ * @return 0 命中，-1 未命中。
+ */
+static int traffic_flow_classify(void *arg, const TrafficFlowTuple *tuple,
+                                 char *session_id, size_t len) {
+  MagicFlowKey key = {
+      .src_ip = tuple->src_ip,
+      .dst_ip = tuple->dst_ip,
+      .src_port = tuple->src_port,
+      .dst_port = tuple->dst_port,
+      .protocol = tuple->protocol,
+      .direction = FLOW_DIR_TO_GROUND,
+  };
+  MagicFlowMatch match;
+
+  if (magic_flow_lookup((MagicFlowClassifier *)arg, &key, &match) != 0) {
+    key.direction = FLOW_DIR_TO_AIRCRAFT;
+    if (magic_flow_lookup((MagicFlowClassifier *)arg, &key, &match) != 0)
+      return -1;
+  }
+
+  snprintf(session_id, len, "%s", match.session_id);
+  return 0;
+}
+
+/*===========================================================================
+ * 配置热重载
+ *===========================================================================*/
+
+/* 定时器回调在读临界区内执行，挂起的 MCAR/MCCR 续跑时再 pin 回原版本 */
+static void timer_config_enter(void *arg) {
+  magic_config_read_begin((MagicConfigStore *)arg);
+}
+
+static void timer_config_leave(void *arg) {
+  magic_config_read_end((MagicConfigStore *)arg);
+}
+
+/**
+ * @brief 新配置发布回调 (重载线程)。
+ * @details 刷新缓存了配置派生值的模块：准入账本容量/客户端限额与
+ * MSCR/MNTR 推送确认策略。策略引擎、LMI 与 CIC 每次使用时取快照，无需通知。
+ *
+ * @param[in] config 新发布的配置。
+ * @param[in] arg 未使用。
+ */
+static void on_config_published(const MagicConfig *config, void *arg) {
+  (void)arg;
+
+  magic_admission_reconfigure(&g_magic_ctx.admission_ctx, config);
+  magic_cic_push_configure(&config->policy.push_ack);
+}
+
+/**
+ * @brief SIGUSR1 触发的配置重载 (freeDiameter 事件触发线程)。
+ * @details 解析与校验在本线程完成，期间请求照常使用旧版本；失败时旧版本
+ * 保持生效。进行中的请求在旧版本上完成后旧快照才被回收。
+ */
+static void on_config_reload_signal(void) {
+  fd_log_notice("[MAGIC] SIGUSR1 received, reloading configuration...");
+  magic_config_store_reload(&g_magic_ctx.config_store);
+}
+
 /*===========================================================================
  * LMI→MSCR 桥接回调 (v2.1: 链路事件自动触发 MSCR 广播)
  *===========================================================================*/
 
+/**
+ * @brief 链路中断的后续处理 (定时器线程)。
+ * @details 先把会话迁移到备用链路，剩余会话再挂起并广播 MSCR。迁移需要发起
+ * MIH 资源请求并等待确认，而确认由触发 LINK_EVENT_DOWN 的 LMI 事件循环线程
+ * 接收，因此不在回调中直接执行。
+ *
+ * @param[in] arg 链路 ID (strdup, 由本函数释放)。
+ */
+static void on_link_down_job(void *arg) {
+  char *link_id = (char *)arg;
+
+  if (!g_magic_ctx.running) { /* 卸载时的冲刷: 会话随后整体清理 */
+    free(link_id);
+    return;
+  }
+
+  magic_cic_failover_link(&g_magic_ctx, link_id);
+  magic_cic_on_link_status_change(&g_magic_ctx, link_id, false);
+  free(link_id);
+}
+
+/**
+ * @brief 链路劣化的后续处理 (定时器线程)。
+ * @details 链路仍在线，会话在备用链路上先建后拆；找不到备用链路的会话
+ * 留在原链路上，直到链路真正中断再按 on_link_down_job 处理。
+ *
+ * @param[in] arg 链路 ID (strdup, 由本函数释放)。
+ */
+static void on_link_going_down_job(void *arg) {
+  char *link_id = (char *)arg;
+
+  if (!g_magic_ctx.running) {
+    free(link_id);
+    return;
+  }
+
+  magic_cic_failover_link(&g_magic_ctx, link_id);
+  free(link_id);
+}
+
+/**
+ * @brief LMI 链路劣化回调 - 在主链路中断前迁移会话。
+ * @details LINK_EVENT_GOING_DOWN 来自 DLM 的 Link_Going_Down.indication
+ *          或 LMI 对参数报告的趋势预测。策略引擎此时已避开该链路。
+ *
+ * @param[in,out] lmi_ctx LMI 上下文指针。
+ * @param[in]     link_id 正在劣化的链路 ID。
+ * @param[in]     event_type 事件类型 (LINK_EVENT_GOING_DOWN)。
+ * @param[in]     event_data `LINK_Going_Down_Indication` 指针。
+ */
+static void on_lmi_link_going_down(struct MagicLmiContext *lmi_ctx,
+                                   const char *link_id, uint16_t event_type,
+                                   const void *event_data) {
+  (void)lmi_ctx;
+  (void)event_type;
+
+  const LINK_Going_Down_Indication *ind =
+      (const LINK_Going_Down_Indication *)event_data;
+  if (!link_id || !link_id[0]) {
+    return;
+  }
+
+  fd_log_notice("[MAGIC] LMI→CIC bridge: Link %s going down in ~%u ms, "
+                "moving sessions ahead of the outage",
+                link_id, ind ? ind->time_to_down_ms : 0);
+
+  char *job_arg = strdup(link_id);
+  if (!job_arg || magic_timer_schedule(&g_magic_ctx.timer_ctx, 0,
+                                       on_link_going_down_job, job_arg) != 0) {
+    free(job_arg);
+  }
+}
+
 /**
  * @brief LMI 链路事件回调 - 桥接到 MSCR 广播。
  * @details 当 DLM (Data Link Manager) 报告链路状态变化（如 UP/DOWN）时，
@@ -73,7 +296,23 @@ static void on_lmi_link_event_for_mscr(struct MagicLmiContext *lmi_ctx,
                 is_up ? "UP" : "DOWN");
 
   /* 调用 CIC 推送模块触发 MSCR 广播 */
-  magic_cic_on_link_status_change(&g_magic_ctx, link_id, is_up);
+  magic_admission_set_link_available(&g_magic_ctx.admission_ctx, link_id,
+                                     is_up);
+  if (is_up) {
+    magic_cic_on_link_status_change(&g_magic_ctx, link_id, true);
+  } else {
+    char *job_arg = strdup(link_id);
+    if (!job_arg || magic_timer_schedule(&g_magic_ctx.timer_ctx, 0,
+                                         on_link_down_job, job_arg) != 0) {
+      free(job_arg);
+      magic_cic_on_link_status_change(&g_magic_ctx, link_id, false);
+    }
+  }
+
+  /* 链路恢复可能满足排队中的 MCCR 请求 */
+  if (is_up) {
+    magic_cic_queue_wakeup("link up");
+  }
 }
 
 /*===========================================================================
@@ -143,42 +382,46 @@ static int magic_entry(char *conffile) {
 
   fd_log_notice("[MAGIC] Loading configuration files from: %s", config_base);
 
-  // 加载数据链路配置
-  ret = magic_config_load_datalinks(&g_magic_ctx.config, config_base);
+  // 加载 Datalink/Policy/Client 三个 XML 并发布首个配置快照
+  magic_config_store_init(&g_magic_ctx.config_store, config_base);
+  ret = magic_config_store_reload(&g_magic_ctx.config_store);
   if (ret < 0) {
-    fd_log_error("[MAGIC] Failed to load Datalink_Profile.xml");
+    fd_log_error("[MAGIC] Failed to load configuration");
+    magic_config_store_cleanup(&g_magic_ctx.config_store);
     return EINVAL;
   }
-  fd_log_notice("[MAGIC] ✓ Loaded %u DLM configs (v2.0)",
-                g_magic_ctx.config.num_dlm_configs);
+  MagicConfig *config = magic_config_current(&g_magic_ctx.config_store);
+  fd_log_notice("[MAGIC] ✓ Loaded %u DLM configs, %u client profiles",
+                config->num_dlm_configs, config->num_clients);
 
-  // 加载策略配置
-  ret = magic_config_load_policy(&g_magic_ctx.config, config_base);
+  /* ========================================
+   * 步骤 2: 初始化策略引擎
+   * ======================================== */
+
+  ret = magic_policy_init(&g_magic_ctx.policy_ctx, &g_magic_ctx.config_store);
   if (ret < 0) {
-    fd_log_error("[MAGIC] Failed to load Central_Policy_Profile.xml");
+    fd_log_error("[MAGIC] Failed to initialize policy engine");
     return EINVAL;
   }
-  fd_log_notice("[MAGIC] ✓ Loaded policy configuration");
+  fd_log_notice("[MAGIC] ✓ Policy engine initialized");
 
-  // 加载客户端配置
-  ret = magic_config_load_clients(&g_magic_ctx.config, config_base);
+  /* 步骤 2b: 按 DLM 配置建立带宽准入账本 */
+  ret = magic_admission_init(&g_magic_ctx.admission_ctx,
+                             &g_magic_ctx.config_store);
   if (ret < 0) {
-    fd_log_error("[MAGIC] Failed to load Client_Profile.xml");
+    fd_log_error("[MAGIC] Failed to initialize admission control");
+    magic_policy_cleanup(&g_magic_ctx.policy_ctx);
     return EINVAL;
   }
-  fd_log_notice("[MAGIC] ✓ Loaded %u client profiles",
-                g_magic_ctx.config.num_clients);
 
-  /* ========================================
-   * 步骤 2: 初始化策略引擎
-   * ======================================== */
-
-  ret = magic_policy_init(&g_magic_ctx.policy_ctx, &g_magic_ctx.config);
+  /* 步骤 2c: 全局流分类器 (TFT 冲突检测与流量归属) */
+  ret = magic_flow_init(&g_magic_ctx.flow_ctx);
   if (ret < 0) {
-    fd_log_error("[MAGIC] Failed to initialize policy engine");
+    fd_log_error("[MAGIC] Failed to initialize flow classifier");
+    magic_admission_cleanup(&g_magic_ctx.admission_ctx);
+    magic_policy_cleanup(&g_magic_ctx.policy_ctx);
     return EINVAL;
   }
-  fd_log_notice("[MAGIC] ✓ Policy engine initialized");
 
   /* ========================================
    * 步骤 3: 初始化 LMI 接口
@@ -217,8 +460,10 @@ static int magic_entry(char *conffile) {
   const char *ingress_interface = "ens39";
   const char *ingress_ip = "192.168.126.1";
 
-  ret = magic_dataplane_init(&g_magic_ctx.dataplane_ctx, ingress_interface,
-                             ingress_ip);
+  ret = magic_dataplane_init(
+      &g_magic_ctx.dataplane_ctx, ingress_interface, ingress_ip,
+      magic_dataplane_backend_from_string(
+          config->policy.dataplane_backend));
   if (ret < 0) {
     fd_log_error("[MAGIC] Failed to initialize dataplane");
     magic_session_cleanup(&g_magic_ctx.session_mgr);
@@ -240,9 +485,9 @@ static int magic_entry(char *conffile) {
     // 不返回错误，流量监控是可选功能
   } else {
     fd_log_notice("[MAGIC] ✓ Traffic monitor initialized (backend: %s)",
-                  g_magic_ctx.traffic_ctx.backend == TRAFFIC_BACKEND_NFTABLES
-                      ? "nftables"
-                      : "iptables");
+                  traffic_backend_name(g_magic_ctx.traffic_ctx.backend));
+    traffic_set_classifier(&g_magic_ctx.traffic_ctx, traffic_flow_classify,
+                           &g_magic_ctx.flow_ctx);
   }
 
   /* ========================================
@@ -262,8 +507,8 @@ static int magic_entry(char *conffile) {
   }
 
   /* 注册 DLM 到数据平面 - v2.0: 使用 Socket 路径 */
-  for (uint32_t i = 0; i < g_magic_ctx.config.num_dlm_configs; i++) {
-    DLMConfig *dlm = &g_magic_ctx.config.dlm_configs[i];
+  for (uint32_t i = 0; i < config->num_dlm_configs; i++) {
+    DLMConfig *dlm = &config->dlm_configs[i];
     /* v2.0: DLM 通过 Unix Socket 通信，不需要网络接口注册 */
     /* 数据平面路由由 DLM 动态通知，此处仅记录 DLM 信息 */
     fd_log_notice("[MAGIC] ✓ DLM %s: Socket=%s, BW=%.0f/%.0f kbps",
@@ -275,7 +520,7 @@ static int magic_entry(char *conffile) {
    * 步骤 6: 启动 LMI 服务器
    * ======================================== */
 
-  ret = magic_lmi_start_server(&g_magic_ctx.lmi_ctx, &g_magic_ctx.config);
+  ret = magic_lmi_start_server(&g_magic_ctx.lmi_ctx, &g_magic_ctx.config_store);
   if (ret < 0) {
     fd_log_notice("[MAGIC] ⚠ LMI server start failed (may not be needed)");
     // 不返回错误，允许无 DLM 模式运行
@@ -305,6 +550,8 @@ static int magic_entry(char *conffile) {
                                     on_lmi_link_event_for_mscr);
   magic_lmi_register_event_callback(&g_magic_ctx.lmi_ctx, LINK_EVENT_DOWN,
                                     on_lmi_link_event_for_mscr);
+  magic_lmi_register_event_callback(&g_magic_ctx.lmi_ctx, LINK_EVENT_GOING_DOWN,
+                                    on_lmi_link_going_down);
   fd_log_notice("[MAGIC] ✓ LMI→MSCR bridge callbacks registered");
 
   /* ========================================
@@ -344,13 +591,46 @@ static int magic_entry(char *conffile) {
     fd_log_notice("[MAGIC] ⚠ ADIF client init failed");
   }
 
+  /* ========================================
+   * 步骤 6d: 启动延迟任务调度器 (MCAR/MCCR 资源请求重试)
+   * ======================================== */
+
+  ret = magic_timer_init(&g_magic_ctx.timer_ctx);
+  if (ret < 0) {
+    fd_log_error("[MAGIC] Failed to start timer scheduler");
+    magic_dataplane_cleanup(&g_magic_ctx.dataplane_ctx);
+    magic_lmi_cleanup(&g_magic_ctx.lmi_ctx);
+    magic_policy_cleanup(&g_magic_ctx.policy_ctx);
+    return EINVAL;
+  }
+  magic_timer_set_hooks(&g_magic_ctx.timer_ctx, timer_config_enter,
+                        timer_config_leave, &g_magic_ctx.config_store);
+  fd_log_notice("[MAGIC] ✓ Timer scheduler started");
+
+  /* 启动 CDR 流量周期更新 (需要流量监控与 CDR 管理器均可用) */
+  if (g_magic_ctx.traffic_ctx.is_initialized &&
+      g_magic_ctx.cdr_mgr.is_initialized) {
+    magic_timer_schedule(&g_magic_ctx.timer_ctx, TRAFFIC_CDR_UPDATE_MS,
+                         traffic_cdr_tick, NULL);
+  }
+
+  /* 计费导出分段轮转检查 (只需 CDR 管理器可用) */
+  if (g_magic_ctx.cdr_mgr.is_initialized &&
+      g_magic_ctx.cdr_mgr.export_enabled) {
+    magic_timer_schedule(&g_magic_ctx.timer_ctx, CDR_EXPORT_TICK_MS,
+                         cdr_export_tick_timer, NULL);
+  }
+
   /* ========================================
    * 步骤 7: 注册 Diameter 应用和命令处理器
    * ======================================== */
 
+  magic_cic_push_configure(&config->policy.push_ack);
+
   ret = magic_cic_init(&g_magic_ctx);
   if (ret < 0) {
     fd_log_error("[MAGIC] Failed to initialize CIC handlers");
+    magic_timer_cleanup(&g_magic_ctx.timer_ctx);
     magic_dataplane_cleanup(&g_magic_ctx.dataplane_ctx);
     magic_lmi_cleanup(&g_magic_ctx.lmi_ctx);
     magic_policy_cleanup(&g_magic_ctx.policy_ctx);
@@ -364,12 +644,17 @@ static int magic_entry(char *conffile) {
   signal(SIGINT, magic_signal_handler);
   signal(SIGTERM, magic_signal_handler);
 
+  /* SIGUSR1: 重新加载 XML 配置并原子切换到新快照 */
+  magic_config_store_set_publish_cb(&g_magic_ctx.config_store,
+                                    on_config_published, NULL);
+  CHECK_FCT(fd_event_trig_regcb(SIGUSR1, "app_magic", on_config_reload_signal));
+
   fd_log_notice("========================================");
   fd_log_notice("  MAGIC Extension Ready");
   fd_log_notice("========================================");
   fd_log_notice("  DLM Configs: %u configured (v2.0)",
-                g_magic_ctx.config.num_dlm_configs);
-  fd_log_notice("  Clients:    %u configured", g_magic_ctx.config.num_clients);
+                config->num_dlm_configs);
+  fd_log_notice("  Clients:    %u configured", config->num_clients);
   fd_log_notice("  LMI Server: %s",
                 g_magic_ctx.lmi_ctx.server_fd >= 0 ? "Running" : "Disabled");
   fd_log_notice("  Dataplane:  %s", g_magic_ctx.dataplane_ctx.is_initialized
@@ -387,8 +672,11 @@ static int magic_entry(char *conffile) {
  * @brief MAGIC 扩展的卸载清理函数。
  * @details 在 freeDiameter 卸载扩展或主进程正常退出时被触发。
  *          按照依赖关系的逆序依次清理所有持有的资源、线程和文件句柄。
- *          顺序如下：CIC -> TrafficMonitor -> CDR -> Dataplane -> Session ->
- * LMI -> Policy -> ADIF -> Config。
+ *          先清除 running，使定时器冲刷的剩余任务 (挂起的 MCAR/MCCR、链路
+ *          事件、计费周期) 只做失败应答或释放参数；定时器须先于 CIC 停止，
+ *          因为续跑回调仍要访问 CIC 上下文。
+ *          顺序如下：Timer -> CIC -> TrafficMonitor -> CDR -> Dataplane -> Session ->
+ * LMI -> Policy -> Admission -> ADIF -> Config。
  *
  * @return void
  *
@@ -398,7 +686,10 @@ static int magic_entry(char *conffile) {
 void fd_ext_fini(void) {
   fd_log_notice("[MAGIC] Extension unloading...");
 
+  g_magic_ctx.running = false;
+
   // 清理各个组件
+  magic_timer_cleanup(&g_magic_ctx.timer_ctx); /* 应答仍挂起的 MCAR/MCCR */
   magic_cic_cleanup(&g_magic_ctx);
   traffic_monitor_cleanup(&g_magic_ctx.traffic_ctx); /* v2.1: 清理流量监控 */
   cdr_manager_cleanup(&g_magic_ctx.cdr_mgr);         /* v2.2: 清理 CDR 管理器 */
@@ -406,8 +697,10 @@ void fd_ext_fini(void) {
   magic_session_cleanup(&g_magic_ctx.session_mgr);
   magic_lmi_cleanup(&g_magic_ctx.lmi_ctx);
   magic_policy_cleanup(&g_magic_ctx.policy_ctx);
+  magic_admission_cleanup(&g_magic_ctx.admission_ctx);
+  magic_flow_cleanup(&g_magic_ctx.flow_ctx);
   adif_client_cleanup(&g_magic_ctx.adif_ctx);
-  magic_config_cleanup(&g_magic_ctx.config);
+  magic_config_store_cleanup(&g_magic_ctx.config_store);
 
   fd_log_notice("[MAGIC] Extension unloaded");
 }
@@ -20,13 +20,17 @@
  *===========================================================================*/
 
 #include "magic_adif.h"
+#include "magic_admission.h"
 #include "magic_cdr.h"
 #include "magic_cic.h"
 #include "magic_config.h"
+#include "magic_config_store.h"
 #include "magic_dataplane.h"
+#include "magic_flow.h"
 #include "magic_lmi.h"
 #include "magic_policy.h"
 #include "magic_session.h"
+#include "magic_timer.h"
 #include "magic_traffic_monitor.h"
 
 /*===========================================================================
@@ -39,7 +43,7 @@
  */
 struct MagicContext {
   bool running;               ///< 运行标志位，为 false 时触发优雅退出。
-  MagicConfig config;         ///< 静态配置数据（从 XML 加载）。
+  MagicConfigStore config_store; ///< 配置快照存储（从 XML 加载，可热重载）。
   PolicyContext policy_ctx;   ///< 策略决策引擎上下文。
   MagicLmiContext lmi_ctx;    ///< LMI (Link Management Interface) 接口上下文。
   SessionManager session_mgr; ///< Diameter 会话管理器。
@@ -48,6 +52,9 @@ struct MagicContext {
   TrafficMonitorContext
       traffic_ctx;    ///< 流量监控上下文 (基于 nftables/iptables)。
   CDRManager cdr_mgr; ///< CDR (Call Detail Record) 管理器，负责计费数据持久化。
+  MagicTimerContext timer_ctx; ///< 延迟任务调度器 (MIH 资源请求重试等)。
+  MagicAdmissionContext admission_ctx; ///< 带宽准入控制 (链路/客户端账本)。
+  MagicFlowClassifier flow_ctx; ///< 全局流分类器 (五元组 → 会话/承载)。
 };
 typedef struct MagicContext MagicContext;
 
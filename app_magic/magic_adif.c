@@ -259,168 +259,515 @@ int adif_generate_subscribe_xml(char *buffer, size_t buffer_size,
   return len;
 }
 
-/**
- * @brief XML 属性提取辅助函数。
- * @details 在 XML 字符串中查找指定标签的特定属性值。
- *          注意：这是一个简单的字符串匹配实现，不依赖外部 XML 库。
- *
- * @param xml XML 输入字符串。
- * @param tag 标签名称 (如 "WeightOnWheels")。
- * @param attr 属性名称 (如 "value", "validity")。
- * @param value [out] 输出属性值的缓冲区。
- * @param value_size 缓冲区大小。
- * @return int 成功返回 0，失败返回 -1。
- */
-static int extract_xml_attr(const char *xml, const char *tag, const char *attr,
-                            char *value, size_t value_size) {
-  char pattern[128];
-  snprintf(pattern, sizeof(pattern), "name=\"%s\"", tag);
+/*===========================================================================
+ * XML 流式解析 (SAX 风格状态机)
+ *===========================================================================*/
 
-  const char *pos = strstr(xml, pattern);
-  if (!pos)
-    return -1;
+/* 词法状态 */
+enum {
+  ADIF_XML_ST_TEXT = 0,   /* 元素之间的文本 */
+  ADIF_XML_ST_TAG_OPEN,   /* 刚读到 '<' */
+  ADIF_XML_ST_TAG_NAME,   /* 读取标签名 */
+  ADIF_XML_ST_ATTR_WAIT,  /* 等待属性名、'/' 或 '>' */
+  ADIF_XML_ST_ATTR_NAME,  /* 读取属性名 */
+  ADIF_XML_ST_ATTR_EQ,    /* 属性名后等待 '=' */
+  ADIF_XML_ST_ATTR_QUOTE, /* 等待属性值起始引号 */
+  ADIF_XML_ST_ATTR_VALUE, /* 读取属性值 */
+  ADIF_XML_ST_EMPTY_END,  /* 读到 '/'，等待 '>' */
+  ADIF_XML_ST_SKIP        /* <?...?> / <!...> 跳过到 '>' */
+};
 
-  snprintf(pattern, sizeof(pattern), "%s=\"", attr);
-  pos = strstr(pos, pattern);
-  if (!pos)
-    return -1;
+/* 发布文档的根元素: <method name="publishAvionicParameters"> */
+#define ADIF_XML_ROOT_TAG "method"
+#define ADIF_XML_ROOT_NAME "publishAvionicParameters"
+
+/* 参数名，下标为 AdifParamId */
+static const char *adif_param_names[ADIF_PARAM_COUNT] = {
+    "WeightOnWheels",        /* ADIF_PARAM_WOW */
+    "Latitude",              /* ADIF_PARAM_LATITUDE */
+    "Longitude",             /* ADIF_PARAM_LONGITUDE */
+    "BaroCorrectedAltitude", /* ADIF_PARAM_ALTITUDE */
+    "FlightPhase",           /* ADIF_PARAM_FLIGHT_PHASE */
+    "AircraftTailNumber",    /* ADIF_PARAM_TAIL_NUMBER */
+    "GroundSpeed",           /* ADIF_PARAM_GROUND_SPEED */
+    "VerticalSpeed"          /* ADIF_PARAM_VERT_SPEED */
+};
 
-  pos += strlen(pattern);
-  const char *end = strchr(pos, '"');
-  if (!end)
-    return -1;
+static inline bool adif_xml_is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
-  size_t len = end - pos;
-  if (len >= value_size)
-    len = value_size - 1;
+/* 追加一个字符并保持 NUL 结尾，超长部分截断 (与旧实现一致) */
+static inline void adif_xml_append(char *buf, size_t *len, size_t size,
+                                   char c) {
+  if (*len + 1 < size) {
+    buf[(*len)++] = c;
+    buf[*len] = '\0';
+  }
+}
 
-  strncpy(value, pos, len);
-  value[len] = '\0';
+/* 批量追加 n 个字符，语义同 adif_xml_append */
+static inline void adif_xml_append_n(char *buf, size_t *len, size_t size,
+                                     const char *src, size_t n) {
+  size_t room = size - 1 - *len;
+  if (n > room)
+    n = room;
+  memcpy(buf + *len, src, n);
+  *len += n;
+  buf[*len] = '\0';
+}
 
-  return 0;
+static int adif_xml_lookup_param(const char *name) {
+  for (int i = 0; i < ADIF_PARAM_COUNT; i++) {
+    if (strcmp(name, adif_param_names[i]) == 0)
+      return i;
+  }
+  return -1;
 }
 
 /**
- * @brief 解析 ADIF 发布的 XML 数据。
- * @details 解析从 ADIF Server 接收到的 XML 状态报告，更新 AdifAircraftState
- * 结构体。
- *
- * @param xml 接收到的 XML 字符串。
- * @param state [out] 用于存储解析结果的飞机状态结构体指针。
- * @return int 成功返回 0，失败返回 -1。
+ * @brief 清除一个参数对应的状态字段。
+ * @details 上一文档出现而本文档缺失的参数按旧实现的语义归零。
  */
-int adif_parse_publish_xml(const char *xml, AdifAircraftState *state) {
-  if (!xml || !state)
-    return -1;
+static void adif_xml_clear_param(AdifXmlParser *p, int id) {
+  AdifAircraftState *s = &p->aircraft;
 
-  char value_str[64];
-  char validity_str[8];
-  char time_str[32];
+  switch (id) {
+  case ADIF_PARAM_WOW:
+    memset(&s->wow, 0, sizeof(s->wow));
+    break;
+  case ADIF_PARAM_LATITUDE:
+    s->position.latitude = 0;
+    s->position.lat_validity = VALIDITY_NO_DATA;
+    break;
+  case ADIF_PARAM_LONGITUDE:
+    s->position.longitude = 0;
+    s->position.lon_validity = VALIDITY_NO_DATA;
+    break;
+  case ADIF_PARAM_ALTITUDE:
+    s->position.altitude_ft = 0;
+    s->position.alt_validity = VALIDITY_NO_DATA;
+    s->position.timestamp_ms = 0;
+    break;
+  case ADIF_PARAM_FLIGHT_PHASE:
+    memset(&s->flight_phase, 0, sizeof(s->flight_phase));
+    break;
+  case ADIF_PARAM_TAIL_NUMBER:
+    memset(&s->aircraft_id, 0, sizeof(s->aircraft_id));
+    break;
+  case ADIF_PARAM_GROUND_SPEED:
+    s->speed.ground_speed_kts = 0;
+    s->speed.gs_validity = VALIDITY_NO_DATA;
+    break;
+  case ADIF_PARAM_VERT_SPEED:
+    s->speed.vertical_speed_fpm = 0;
+    s->speed.vs_validity = VALIDITY_NO_DATA;
+    s->speed.timestamp_ms = 0;
+    break;
+  }
+  memset(&p->cache[id], 0, sizeof(p->cache[id]));
+}
 
-  /* 解析 WeightOnWheels */
-  if (extract_xml_attr(xml, "WeightOnWheels", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->wow.on_ground = (atoi(value_str) == 0);
+/**
+ * @brief 将一个完整的 <parameter> 元素写入状态。
+ * @details value/validity 与缓存一致时只刷新时间戳，
+ *          跳过 atof/字符串映射且不置 changed_mask。
+ */
+static void adif_xml_apply_param(AdifXmlParser *p) {
+  int id = p->param_id;
+  uint32_t bit = ADIF_PARAM_BIT(id);
+  AdifXmlParamCache *c = &p->cache[id];
+  AdifAircraftState *s = &p->aircraft;
+  AdifValidity validity = (AdifValidity)p->param_validity;
+  const char *v = p->param_value;
+
+  bool changed = !(p->prev_seen_mask & bit) ||
+                 c->validity != p->param_validity || strcmp(c->value, v) != 0;
+  p->seen_mask |= bit;
+  if (changed) {
+    memcpy(c->value, v, sizeof(c->value));
+    c->validity = p->param_validity;
+    p->changed_mask |= bit;
+  }
 
-    if (extract_xml_attr(xml, "WeightOnWheels", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->wow.validity = (AdifValidity)atoi(validity_str);
+  switch (id) {
+  case ADIF_PARAM_WOW:
+    if (changed) {
+      s->wow.on_ground = (atoi(v) == 0);
+      s->wow.validity = validity;
     }
-    if (extract_xml_attr(xml, "WeightOnWheels", "time", time_str,
-                         sizeof(time_str)) == 0) {
-      state->wow.timestamp_ms = strtoull(time_str, NULL, 10);
+    s->wow.timestamp_ms = p->param_time;
+    break;
+  case ADIF_PARAM_LATITUDE:
+    if (changed) {
+      s->position.latitude = atof(v);
+      s->position.lat_validity = validity;
     }
+    break;
+  case ADIF_PARAM_LONGITUDE:
+    if (changed) {
+      s->position.longitude = atof(v);
+      s->position.lon_validity = validity;
+    }
+    break;
+  case ADIF_PARAM_ALTITUDE:
+    if (changed) {
+      s->position.altitude_ft = atof(v);
+      s->position.alt_validity = validity;
+    }
+    s->position.timestamp_ms = p->param_time;
+    break;
+  case ADIF_PARAM_FLIGHT_PHASE:
+    if (changed) {
+      s->flight_phase.phase = adif_string_to_flight_phase(v);
+      s->flight_phase.validity = validity;
+    }
+    s->flight_phase.timestamp_ms = p->param_time;
+    break;
+  case ADIF_PARAM_TAIL_NUMBER:
+    if (changed) {
+      strncpy(s->aircraft_id.tail_number, v, ADIF_MAX_TAIL_NUMBER_LEN - 1);
+      s->aircraft_id.tail_number[ADIF_MAX_TAIL_NUMBER_LEN - 1] = '\0';
+      s->aircraft_id.validity = validity;
+    }
+    break;
+  case ADIF_PARAM_GROUND_SPEED:
+    if (changed) {
+      s->speed.ground_speed_kts = atof(v);
+      s->speed.gs_validity = validity;
+    }
+    break;
+  case ADIF_PARAM_VERT_SPEED:
+    if (changed) {
+      s->speed.vertical_speed_fpm = atof(v);
+      s->speed.vs_validity = validity;
+    }
+    s->speed.timestamp_ms = p->param_time;
+    break;
   }
+}
 
-  /* 解析 Latitude */
-  if (extract_xml_attr(xml, "Latitude", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->position.latitude = atof(value_str);
-    if (extract_xml_attr(xml, "Latitude", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->position.lat_validity = (AdifValidity)atoi(validity_str);
-    }
+/* 标签名读完: 判断是否为 <parameter> 并复位参数暂存区 */
+static void adif_xml_on_tag_name(AdifXmlParser *p) {
+  p->in_param = !p->closing && strcmp(p->tag, "parameter") == 0;
+  if (p->in_param) {
+    p->param_id = -1;
+    p->param_has_value = false;
+    p->param_value[0] = '\0';
+    p->param_validity = VALIDITY_NO_DATA;
+    p->param_time = 0;
   }
+}
 
-  /* 解析 Longitude */
-  if (extract_xml_attr(xml, "Longitude", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->position.longitude = atof(value_str);
-    if (extract_xml_attr(xml, "Longitude", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->position.lon_validity = (AdifValidity)atoi(validity_str);
-    }
+/* 属性值读完: 只关心 <parameter> 的 name/value/validity/time */
+static void adif_xml_on_attr(AdifXmlParser *p) {
+  if (p->depth == 0 && strcmp(p->attr, "name") == 0)
+    p->root_ok = strcmp(p->text, ADIF_XML_ROOT_NAME) == 0;
+
+  if (!p->in_param)
+    return;
+
+  if (strcmp(p->attr, "name") == 0) {
+    p->param_id = adif_xml_lookup_param(p->text);
+  } else if (strcmp(p->attr, "value") == 0) {
+    memcpy(p->param_value, p->text, p->text_len + 1);
+    p->param_has_value = true;
+  } else if (strcmp(p->attr, "validity") == 0) {
+    p->param_validity = atoi(p->text);
+  } else if (strcmp(p->attr, "time") == 0) {
+    p->param_time = strtoull(p->text, NULL, 10);
   }
+}
 
-  /* 解析 BaroCorrectedAltitude */
-  if (extract_xml_attr(xml, "BaroCorrectedAltitude", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->position.altitude_ft = atof(value_str);
-    if (extract_xml_attr(xml, "BaroCorrectedAltitude", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->position.alt_validity = (AdifValidity)atoi(validity_str);
-    }
-    if (extract_xml_attr(xml, "BaroCorrectedAltitude", "time", time_str,
-                         sizeof(time_str)) == 0) {
-      state->position.timestamp_ms = strtoull(time_str, NULL, 10);
-    }
+static void adif_xml_on_doc_begin(AdifXmlParser *p) {
+  p->seen_mask = 0;
+  p->changed_mask = 0;
+}
+
+static void adif_xml_on_doc_end(AdifXmlParser *p) {
+  AdifAircraftState *s = &p->aircraft;
+  uint32_t missing = p->prev_seen_mask & ~p->seen_mask;
+
+  for (int id = 0; missing && id < ADIF_PARAM_COUNT; id++) {
+    if (missing & ADIF_PARAM_BIT(id))
+      adif_xml_clear_param(p, id);
   }
+  p->changed_mask |= missing;
+  p->prev_seen_mask = p->seen_mask;
 
-  /* 解析 FlightPhase */
-  if (extract_xml_attr(xml, "FlightPhase", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->flight_phase.phase = adif_string_to_flight_phase(value_str);
-    if (extract_xml_attr(xml, "FlightPhase", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->flight_phase.validity = (AdifValidity)atoi(validity_str);
-    }
-    if (extract_xml_attr(xml, "FlightPhase", "time", time_str,
-                         sizeof(time_str)) == 0) {
-      state->flight_phase.timestamp_ms = strtoull(time_str, NULL, 10);
+  s->data_valid = (s->wow.validity == VALIDITY_NORMAL) &&
+                  (s->flight_phase.validity == VALIDITY_NORMAL);
+  s->last_update_ms = (uint64_t)time(NULL) * 1000;
+
+  p->documents++;
+  if (p->changed_mask == 0)
+    p->noop_documents++;
+}
+
+/**
+ * @brief 处理标签结束 ('>' 或 '/>')。
+ * @return int 1=根元素结束 (文档完成)，0=继续，-1=格式错误。
+ */
+static int adif_xml_on_tag_end(AdifXmlParser *p, bool self_closing) {
+  if (p->resync) {
+    /* 重新同步: 只有发布根开始标签才开始新文档，其余标签丢弃 */
+    if (p->closing || self_closing || !p->root_ok ||
+        strcmp(p->tag, ADIF_XML_ROOT_TAG) != 0) {
+      p->in_param = false;
+      return 0;
     }
+    p->resync = false;
   }
 
-  /* 解析 AircraftTailNumber */
-  if (extract_xml_attr(xml, "AircraftTailNumber", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    strncpy(state->aircraft_id.tail_number, value_str,
-            ADIF_MAX_TAIL_NUMBER_LEN - 1);
-    state->aircraft_id.tail_number[ADIF_MAX_TAIL_NUMBER_LEN - 1] = '\0';
-    if (extract_xml_attr(xml, "AircraftTailNumber", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->aircraft_id.validity = (AdifValidity)atoi(validity_str);
+  if (p->closing) {
+    if (self_closing || p->depth == 0)
+      return -1;
+    if (--p->depth == 0) {
+      adif_xml_on_doc_end(p);
+      return 1;
     }
+    return 0;
   }
 
-  /* 解析 GroundSpeed */
-  if (extract_xml_attr(xml, "GroundSpeed", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->speed.ground_speed_kts = atof(value_str);
-    if (extract_xml_attr(xml, "GroundSpeed", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->speed.gs_validity = (AdifValidity)atoi(validity_str);
+  if (p->depth == 0)
+    adif_xml_on_doc_begin(p);
+
+  if (p->in_param && p->param_id >= 0 && p->param_has_value)
+    adif_xml_apply_param(p);
+  p->in_param = false;
+
+  if (self_closing) {
+    if (p->depth == 0) {
+      adif_xml_on_doc_end(p);
+      return 1;
     }
+    return 0;
   }
 
-  /* 解析 VerticalSpeed */
-  if (extract_xml_attr(xml, "VerticalSpeed", "value", value_str,
-                       sizeof(value_str)) == 0) {
-    state->speed.vertical_speed_fpm = atof(value_str);
-    if (extract_xml_attr(xml, "VerticalSpeed", "validity", validity_str,
-                         sizeof(validity_str)) == 0) {
-      state->speed.vs_validity = (AdifValidity)atoi(validity_str);
+  if (++p->depth > ADIF_XML_MAX_DEPTH)
+    return -1;
+  return 0;
+}
+
+/**
+ * @brief 初始化 (或重置) 流式解析器。
+ * @details 解析错误后必须整体重置: 半份文档可能已更新缓存，
+ *          若只复位词法状态，下一份文档会把这些参数误判为未变化。
+ *
+ * @param parser 解析器。
+ */
+void adif_xml_parser_init(AdifXmlParser *parser) {
+  if (!parser)
+    return;
+
+  memset(parser, 0, sizeof(*parser));
+  parser->lex_state = ADIF_XML_ST_TEXT;
+  parser->param_id = -1;
+}
+
+/**
+ * @brief 解析错误后重置解析器，并跳过数据直到下一个发布根开始标签。
+ * @details 只按 '<' 重新开始会把错误位置之后残留的 <parameter .../>
+ *          当作一份自闭合的根文档提交，或把 </parameters> 再次判为错误。
+ *
+ * @param parser 解析器。
+ */
+void adif_xml_parser_resync(AdifXmlParser *parser) {
+  if (!parser)
+    return;
+
+  adif_xml_parser_init(parser);
+  parser->resync = true;
+}
+
+/**
+ * @brief 向流式解析器喂入一段数据。
+ * @details 逐字节驱动状态机 (文本与属性值用 memchr 整段跳过)，
+ *          所有订阅参数在同一遍扫描中提取；
+ *          词法状态保存在 parser 中，因此标签/属性可以在任意位置
+ *          被 TCP 分段截断。根元素结束时立即返回，剩余数据由调用方
+ *          继续喂入。
+ *
+ * @param parser 解析器。
+ * @param data 数据 (无需 NUL 结尾)。
+ * @param len 数据长度。
+ * @param consumed [out] 本次消费的字节数。
+ * @return int 1=完成一份文档，0=需要更多数据，-1=格式错误。
+ */
+int adif_xml_parser_feed(AdifXmlParser *parser, const char *data, size_t len,
+                         size_t *consumed) {
+  AdifXmlParser *p = parser;
+  size_t i;
+  int rc = 0;
+
+  if (!parser || (!data && len) || !consumed)
+    return -1;
+
+  for (i = 0; i < len && rc == 0; i++) {
+    char c = data[i];
+
+    switch (p->lex_state) {
+    case ADIF_XML_ST_TEXT: {
+      /* 元素间文本不关心内容，直接跳到下一个 '<' */
+      const char *lt = memchr(data + i, '<', len - i);
+      if (!lt) {
+        i = len - 1;
+        break;
+      }
+      i = (size_t)(lt - data);
+      p->closing = false;
+      p->root_ok = false;
+      p->tag_len = 0;
+      p->tag[0] = '\0';
+      p->lex_state = ADIF_XML_ST_TAG_OPEN;
+      break;
+    }
+
+    case ADIF_XML_ST_TAG_OPEN:
+      if (c == '?' || c == '!') {
+        p->lex_state = ADIF_XML_ST_SKIP;
+      } else if (c == '/' && !p->closing) {
+        p->closing = true;
+      } else if (adif_xml_is_space(c) || c == '>' || c == '/') {
+        rc = -1;
+      } else {
+        adif_xml_append(p->tag, &p->tag_len, sizeof(p->tag), c);
+        p->lex_state = ADIF_XML_ST_TAG_NAME;
+      }
+      break;
+
+    case ADIF_XML_ST_TAG_NAME:
+      if (adif_xml_is_space(c)) {
+        adif_xml_on_tag_name(p);
+        p->lex_state = ADIF_XML_ST_ATTR_WAIT;
+      } else if (c == '>') {
+        adif_xml_on_tag_name(p);
+        rc = adif_xml_on_tag_end(p, false);
+        p->lex_state = ADIF_XML_ST_TEXT;
+      } else if (c == '/') {
+        adif_xml_on_tag_name(p);
+        p->lex_state = ADIF_XML_ST_EMPTY_END;
+      } else {
+        adif_xml_append(p->tag, &p->tag_len, sizeof(p->tag), c);
+      }
+      break;
+
+    case ADIF_XML_ST_ATTR_WAIT:
+      if (adif_xml_is_space(c)) {
+        break;
+      } else if (c == '>') {
+        rc = adif_xml_on_tag_end(p, false);
+        p->lex_state = ADIF_XML_ST_TEXT;
+      } else if (c == '/') {
+        p->lex_state = ADIF_XML_ST_EMPTY_END;
+      } else if (p->closing || c == '=' || c == '"' || c == '\'') {
+        rc = -1;
+      } else {
+        p->attr_len = 0;
+        adif_xml_append(p->attr, &p->attr_len, sizeof(p->attr), c);
+        p->lex_state = ADIF_XML_ST_ATTR_NAME;
+      }
+      break;
+
+    case ADIF_XML_ST_ATTR_NAME:
+      if (c == '=') {
+        p->lex_state = ADIF_XML_ST_ATTR_QUOTE;
+      } else if (adif_xml_is_space(c)) {
+        p->lex_state = ADIF_XML_ST_ATTR_EQ;
+      } else if (c == '>' || c == '/') {
+        rc = -1;
+      } else {
+        adif_xml_append(p->attr, &p->attr_len, sizeof(p->attr), c);
+      }
+      break;
+
+    case ADIF_XML_ST_ATTR_EQ:
+      if (c == '=')
+        p->lex_state = ADIF_XML_ST_ATTR_QUOTE;
+      else if (!adif_xml_is_space(c))
+        rc = -1;
+      break;
+
+    case ADIF_XML_ST_ATTR_QUOTE:
+      if (c == '"' || c == '\'') {
+        p->quote = c;
+        p->text_len = 0;
+        p->text[0] = '\0';
+        p->lex_state = ADIF_XML_ST_ATTR_VALUE;
+      } else if (!adif_xml_is_space(c)) {
+        rc = -1;
+      }
+      break;
+
+    case ADIF_XML_ST_ATTR_VALUE: {
+      /* 属性值整段拷贝到结束引号，引号不在本段内则等待下一段 */
+      const char *q = memchr(data + i, p->quote, len - i);
+      size_t end = q ? (size_t)(q - data) : len;
+      adif_xml_append_n(p->text, &p->text_len, sizeof(p->text), data + i,
+                        end - i);
+      if (!q) {
+        i = len - 1;
+        break;
+      }
+      i = end;
+      adif_xml_on_attr(p);
+      p->lex_state = ADIF_XML_ST_ATTR_WAIT;
+      break;
+    }
+
+    case ADIF_XML_ST_EMPTY_END:
+      if (c == '>') {
+        rc = adif_xml_on_tag_end(p, true);
+        p->lex_state = ADIF_XML_ST_TEXT;
+      } else {
+        rc = -1;
+      }
+      break;
+
+    case ADIF_XML_ST_SKIP:
+      if (c == '>')
+        p->lex_state = ADIF_XML_ST_TEXT;
+      break;
+
+    default:
+      rc = -1;
+      break;
     }
-    if (extract_xml_attr(xml, "VerticalSpeed", "time", time_str,
-                         sizeof(time_str)) == 0) {
-      state->speed.timestamp_ms = strtoull(time_str, NULL, 10);
+
+    if (rc < 0 && p->resync) {
+      /* 重新同步期间的残缺标签不算错误，继续寻找根标签 */
+      rc = 0;
+      p->lex_state = ADIF_XML_ST_TEXT;
     }
   }
 
-  /* 更新整体状态 */
-  state->data_valid = (state->wow.validity == VALIDITY_NORMAL) &&
-                      (state->flight_phase.validity == VALIDITY_NORMAL);
-  state->last_update_ms = (uint64_t)time(NULL) * 1000;
+  *consumed = i;
+  return rc;
+}
+
+/**
+ * @brief 解析 ADIF 发布的 XML 数据。
+ * @details 一次性解析完整的 XML 状态报告，更新 AdifAircraftState 结构体。
+ *          接收线程直接使用 AdifXmlParser 增量解析，本函数保留给
+ *          一次性解析的调用方。
+ *
+ * @param xml 接收到的 XML 字符串。
+ * @param state [out] 用于存储解析结果的飞机状态结构体指针。
+ * @return int 成功返回 0，失败或文档不完整返回 -1。
+ */
+int adif_parse_publish_xml(const char *xml, AdifAircraftState *state) {
+  if (!xml || !state)
+    return -1;
+
+  AdifXmlParser parser;
+  size_t consumed = 0;
 
+  adif_xml_parser_init(&parser);
+  int rc = adif_xml_parser_feed(&parser, xml, strlen(xml), &consumed);
+  if (rc != 1)
+    return -1;
+
+  memcpy(state, &parser.aircraft, sizeof(*state));
   return 0;
 }
 
@@ -526,12 +873,60 @@ static int create_async_listener(uint16_t port) {
  * 接收线程
  *===========================================================================*/
 
+/**
+ * @brief 提交一份解析完成的文档。
+ * @details changed_mask 为 0 的 no-op 发布 (100 Hz 推送中的常态)
+ *          只刷新时间戳，不做字段比较也不触发回调；否则仅当飞行阶段
+ *          或 WoW 真正变化时才调用回调。
+ *
+ * @param ctx ADIF 客户端上下文。
+ * @param parser 刚完成一份文档的解析器。
+ */
+static void adif_commit_document(AdifClientContext *ctx,
+                                 const AdifXmlParser *parser) {
+  const AdifAircraftState *new_state = &parser->aircraft;
+  const uint32_t trigger_mask =
+      ADIF_PARAM_BIT(ADIF_PARAM_WOW) | ADIF_PARAM_BIT(ADIF_PARAM_FLIGHT_PHASE);
+  AdifFlightPhase old_phase;
+  bool state_changed = false;
+
+  pthread_mutex_lock(&ctx->state_mutex);
+  old_phase = ctx->aircraft_state.flight_phase.phase;
+
+  /* 检查状态是否真正变化（飞行阶段或 WoW 状态） */
+  if ((parser->changed_mask & trigger_mask) &&
+      (old_phase != new_state->flight_phase.phase ||
+       ctx->aircraft_state.wow.on_ground != new_state->wow.on_ground)) {
+    state_changed = true;
+  }
+
+  memcpy(&ctx->aircraft_state, new_state, sizeof(AdifAircraftState));
+  pthread_mutex_unlock(&ctx->state_mutex);
+
+  /* 只在状态真正变化时触发回调和日志 */
+  if (!state_changed)
+    return;
+
+  /* 检查是否需要通知策略引擎 */
+  if (adif_should_reevaluate_routing(old_phase,
+                                     new_state->flight_phase.phase)) {
+    LOG_INFO("Flight phase changed: %s -> %s, triggering route reevaluation",
+             adif_flight_phase_to_string(old_phase),
+             adif_flight_phase_to_string(new_state->flight_phase.phase));
+  }
+
+  /* 调用回调函数 - 仅在状态变化时 */
+  if (ctx->callback) {
+    ctx->callback(new_state, ctx->callback_data);
+  }
+}
+
 /**
  * @brief ADIF 数据接收线程函数。
  * @details 处理异步连接的接受和数据接收循环。
  *          - 接受来自 ADIF 服务器的连接
- *          - 循环接收 XML 数据
- *          - 解析并更新本地状态
+ *          - 循环接收 XML 数据，交给 AdifXmlParser 增量解析
+ *          - 每完成一份文档更新本地状态
  *          - 只在状态发生实质变化时触发回调
  *
  * @param arg ADIF 客户端上下文 (AdifClientContext*)。
@@ -540,6 +935,7 @@ static int create_async_listener(uint16_t port) {
 static void *adif_receiver_thread(void *arg) {
   AdifClientContext *ctx = (AdifClientContext *)arg;
   char buffer[ADIF_MAX_XML_BUFFER];
+  AdifXmlParser *parser = NULL;
   int async_client = -1;
 
   LOG_INFO("ADIF receiver thread started");
@@ -573,6 +969,14 @@ static void *adif_receiver_thread(void *arg) {
     return NULL;
   }
 
+  parser = malloc(sizeof(*parser));
+  if (!parser) {
+    LOG_ERROR("Failed to allocate XML parser");
+    close(async_client);
+    return NULL;
+  }
+  adif_xml_parser_init(parser);
+
   /* 主接收循环 */
   while (ctx->running) {
     FD_ZERO(&read_fds);
@@ -594,7 +998,7 @@ static void *adif_receiver_thread(void *arg) {
     }
 
     if (FD_ISSET(async_client, &read_fds)) {
-      ssize_t n = recv(async_client, buffer, sizeof(buffer) - 1, 0);
+      ssize_t n = recv(async_client, buffer, sizeof(buffer), 0);
       if (n <= 0) {
         if (n == 0) {
           LOG_INFO("ADIF server disconnected");
@@ -604,44 +1008,22 @@ static void *adif_receiver_thread(void *arg) {
         break;
       }
 
-      buffer[n] = '\0';
       LOG_DEBUG("Received ADIF data (%zd bytes)", n);
 
-      /* 解析 XML 并更新状态 */
-      AdifAircraftState new_state;
-      memset(&new_state, 0, sizeof(new_state));
-
-      if (adif_parse_publish_xml(buffer, &new_state) == 0) {
-        AdifFlightPhase old_phase;
-        bool state_changed = false;
-
-        pthread_mutex_lock(&ctx->state_mutex);
-        old_phase = ctx->aircraft_state.flight_phase.phase;
-
-        /* 检查状态是否真正变化（飞行阶段或 WoW 状态） */
-        if (old_phase != new_state.flight_phase.phase ||
-            ctx->aircraft_state.wow.on_ground != new_state.wow.on_ground) {
-          state_changed = true;
+      /* 增量解析: 一次 recv 可能含半份或多份文档 */
+      size_t off = 0;
+      while (off < (size_t)n) {
+        size_t used = 0;
+        int rc = adif_xml_parser_feed(parser, buffer + off, (size_t)n - off,
+                                      &used);
+        off += used;
+        if (rc < 0) {
+          LOG_ERROR("Malformed ADIF XML, resynchronizing");
+          adif_xml_parser_resync(parser);
+          continue; /* 本段剩余数据中可能已有下一份文档 */
         }
-
-        memcpy(&ctx->aircraft_state, &new_state, sizeof(AdifAircraftState));
-        pthread_mutex_unlock(&ctx->state_mutex);
-
-        /* 只在状态真正变化时触发回调和日志 */
-        if (state_changed) {
-          /* 检查是否需要通知策略引擎 */
-          if (adif_should_reevaluate_routing(old_phase,
-                                             new_state.flight_phase.phase)) {
-            LOG_INFO(
-                "Flight phase changed: %s -> %s, triggering route reevaluation",
-                adif_flight_phase_to_string(old_phase),
-                adif_flight_phase_to_string(new_state.flight_phase.phase));
-          }
-
-          /* 调用回调函数 - 仅在状态变化时 */
-          if (ctx->callback) {
-            ctx->callback(&new_state, ctx->callback_data);
-          }
+        if (rc == 1) {
+          adif_commit_document(ctx, parser);
         }
       }
     }
@@ -651,7 +1033,10 @@ static void *adif_receiver_thread(void *arg) {
     close(async_client);
   }
 
-  LOG_INFO("ADIF receiver thread exiting");
+  LOG_INFO("ADIF receiver thread exiting (%llu documents, %llu no-op)",
+           (unsigned long long)parser->documents,
+           (unsigned long long)parser->noop_documents);
+  free(parser);
   return NULL;
 }
 
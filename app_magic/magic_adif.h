@@ -29,7 +29,10 @@
 #define ADIF_DEFAULT_REFRESH_MS     1000    ///< 默认刷新周期 (毫秒)
 #define ADIF_DEFAULT_SERVER_PORT    4000    ///< ADIF 服务端默认端口
 #define ADIF_DEFAULT_ASYNC_PORT     64001   ///< 异步数据接收端口
-#define ADIF_MAX_XML_BUFFER         4096    ///< XML 缓冲区大小
+#define ADIF_MAX_XML_BUFFER         4096    ///< XML 缓冲区/单次接收块大小
+#define ADIF_XML_NAME_LEN           32      ///< 流式解析: 标签/属性名最大长度
+#define ADIF_XML_VALUE_LEN          64      ///< 流式解析: 属性值最大长度
+#define ADIF_XML_MAX_DEPTH          16      ///< 流式解析: 最大元素嵌套深度
 
 /*===========================================================================
  * 飞行阶段枚举 (ARINC 834 Flight Phase)
@@ -291,12 +294,111 @@ bool adif_should_reevaluate_routing(AdifFlightPhase old_phase, AdifFlightPhase n
  * XML 解析辅助函数
  *===========================================================================*/
 
+/**
+ * @brief 订阅参数编号
+ * @details 与 subscribeAvionicParameters 中的参数一一对应，
+ *          用作 AdifXmlParser 各掩码的位号。
+ */
+typedef enum {
+    ADIF_PARAM_WOW          = 0,    ///< WeightOnWheels
+    ADIF_PARAM_LATITUDE     = 1,    ///< Latitude
+    ADIF_PARAM_LONGITUDE    = 2,    ///< Longitude
+    ADIF_PARAM_ALTITUDE     = 3,    ///< BaroCorrectedAltitude
+    ADIF_PARAM_FLIGHT_PHASE = 4,    ///< FlightPhase
+    ADIF_PARAM_TAIL_NUMBER  = 5,    ///< AircraftTailNumber
+    ADIF_PARAM_GROUND_SPEED = 6,    ///< GroundSpeed
+    ADIF_PARAM_VERT_SPEED   = 7,    ///< VerticalSpeed
+    ADIF_PARAM_COUNT        = 8
+} AdifParamId;
+
+#define ADIF_PARAM_BIT(id)          (1u << (id))
+
+/**
+ * @brief 参数原始值缓存
+ * @details 保存上一份文档中参数的 value/validity 原文，
+ *          未变化时跳过数值转换并且不计入 changed_mask。
+ */
+typedef struct {
+    char        value[ADIF_XML_VALUE_LEN];  ///< 上次的 value 原始字符串
+    int         validity;                   ///< 上次的 validity
+} AdifXmlParamCache;
+
+/**
+ * @brief ADIF publish XML 流式解析器
+ * @details SAX 风格的单遍状态机: 逐字节消费 TCP 数据，
+ *          一次扫描提取全部订阅参数；文档可以跨任意次 recv 拆分，
+ *          一次 recv 中也可以包含多份文档。
+ *          aircraft 跨文档保留，changed_mask 标出本文档中
+ *          value/validity 实际变化的参数，全 0 即为 no-op 发布。
+ */
+typedef struct {
+    int         lex_state;                  ///< 词法状态 (内部使用)
+    int         depth;                      ///< 当前元素嵌套深度
+    bool        closing;                    ///< 当前标签为 </...>
+    bool        in_param;                   ///< 当前标签为 <parameter>
+    bool        resync;                     ///< 错误后跳过，直到发布根标签
+    bool        root_ok;                    ///< 当前标签的 name 为发布方法名
+    char        quote;                      ///< 当前属性值的引号字符
+    char        tag[ADIF_XML_NAME_LEN];     ///< 当前标签名
+    size_t      tag_len;
+    char        attr[ADIF_XML_NAME_LEN];    ///< 当前属性名
+    size_t      attr_len;
+    char        text[ADIF_XML_VALUE_LEN];   ///< 当前属性值
+    size_t      text_len;
+
+    int         param_id;                   ///< 当前参数编号，-1=未订阅
+    bool        param_has_value;            ///< 当前参数带 value 属性
+    char        param_value[ADIF_XML_VALUE_LEN]; ///< 当前参数 value
+    int         param_validity;             ///< 当前参数 validity
+    uint64_t    param_time;                 ///< 当前参数 time
+
+    uint32_t    seen_mask;                  ///< 本文档出现的参数
+    uint32_t    prev_seen_mask;             ///< 上一文档出现的参数
+    uint32_t    changed_mask;               ///< 本文档变化的参数
+    AdifXmlParamCache cache[ADIF_PARAM_COUNT]; ///< 参数原始值缓存
+    AdifAircraftState aircraft;             ///< 解析结果 (跨文档保留)
+
+    uint64_t    documents;                  ///< 已完成文档数
+    uint64_t    noop_documents;             ///< 其中无变化的文档数
+} AdifXmlParser;
+
+/**
+ * @brief 初始化 (或在解析错误后重置) 流式解析器
+ * @param parser 解析器
+ */
+void adif_xml_parser_init(AdifXmlParser* parser);
+
+/**
+ * @brief 解析错误后重置解析器并进入重新同步状态
+ * @details 错误位置之后仍是半份文档，其中的 <parameter .../> 等标签
+ *          不能被当作新文档的根。重新同步期间丢弃一切数据，直到遇到
+ *          <method name="publishAvionicParameters"> 根开始标签。
+ * @param parser 解析器
+ */
+void adif_xml_parser_resync(AdifXmlParser* parser);
+
+/**
+ * @brief 向流式解析器喂入一段数据
+ * @details 遇到根元素结束即停止消费并返回 1，此时 parser->aircraft
+ *          与 parser->changed_mask 描述刚完成的文档；调用方应从
+ *          data + *consumed 继续喂入剩余数据。
+ * @param parser 解析器
+ * @param data 数据 (无需 NUL 结尾)
+ * @param len 数据长度
+ * @param consumed [out] 本次消费的字节数
+ * @return int 1=完成一份文档，0=数据已耗尽需要更多数据，
+ *             -1=XML 格式错误 (需调用 adif_xml_parser_resync 重置)
+ */
+int adif_xml_parser_feed(AdifXmlParser* parser, const char* data,
+                         size_t len, size_t* consumed);
+
 /**
  * @brief 解析 ADIF 发布的 XML 数据
  * @details 解析符合 ARINC 834 标准的 XML 状态报告。
+ *          基于 AdifXmlParser 的一次性封装，xml 须为完整文档。
  * @param xml XML 字符串
  * @param state [out] 输出：解析后的飞机状态
- * @return int 成功返回 0，失败返回 -1
+ * @return int 成功返回 0，失败或文档不完整返回 -1
  */
 int adif_parse_publish_xml(const char* xml, AdifAircraftState* state);
 
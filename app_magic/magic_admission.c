@@ -0,0 +1,860 @@
+/**
+ * @file magic_admission.c
+ * @brief MAGIC 带宽准入控制模块实现。
+ * @details 链路/客户端账本 + 预留记录池。账本按 ID、记录池按 Session-ID
+ *          经哈希表定位，记录还按链路串成双向链表供抢占时遍历。
+ *          全部操作在一把互斥锁下完成，预留 → 提交/回滚 对其他请求
+ *          呈原子性。
+ */
+
+#include "magic_admission.h"
+#include "magic_hash.h"
+#include <freeDiameter/extension.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*===========================================================================
+ * 内部辅助函数 (调用方持锁)
+ *===========================================================================*/
+
+/* Session-ID 哈希 (FNV-1a) */
+static uint32_t adm_hash(const char *session_id) {
+  return magic_fnv1a32_str(session_id) & (ADMISSION_HASH_BUCKETS - 1);
+}
+
+static uint32_t adm_min_u32(uint64_t a, uint64_t b) {
+  uint64_t m = a < b ? a : b;
+  return m > UINT32_MAX ? UINT32_MAX : (uint32_t)m;
+}
+
+/* a - b，下限为 0 */
+static uint64_t adm_sub_sat(uint64_t a, uint64_t b) { return a > b ? a - b : 0; }
+
+static uint8_t adm_effective_priority(uint8_t priority_class) {
+  return priority_class ? priority_class : ADMISSION_LOWEST_PRIORITY;
+}
+
+/**
+ * @brief 确保账本数组容量不小于 need (倍增扩容，新增部分清零)。
+ * @return 0 成功，-1 内存不足 (原数组保持不变)。
+ */
+static int adm_reserve_array(void **array, uint32_t *capacity, uint32_t need,
+                             size_t elem_size) {
+  if (need <= *capacity)
+    return 0;
+
+  uint32_t cap = *capacity ? *capacity : ADMISSION_INITIAL_CAPACITY;
+  while (cap < need)
+    cap *= 2;
+
+  void *grown = realloc(*array, (size_t)cap * elem_size);
+  if (!grown) {
+    fd_log_error("[app_magic] Admission: out of memory growing ledger to %u",
+                 cap);
+    return -1;
+  }
+  memset((char *)grown + (size_t)*capacity * elem_size, 0,
+         (size_t)(cap - *capacity) * elem_size);
+  *array = grown;
+  *capacity = cap;
+  return 0;
+}
+
+/* 账本 ID 所在的桶 (buckets 为 2 的幂) */
+static uint32_t adm_ledger_bucket(const char *id, uint32_t buckets) {
+  return magic_fnv1a32_str(id) & (buckets - 1);
+}
+
+/* 分配 n 个空桶，内存不足返回 NULL */
+static int *adm_alloc_buckets(uint32_t n) {
+  int *buckets = malloc((size_t)n * sizeof(*buckets));
+  if (!buckets) {
+    fd_log_error("[app_magic] Admission: out of memory growing index to %u",
+                 n);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < n; i++)
+    buckets[i] = -1;
+  return buckets;
+}
+
+/**
+ * @brief 账本数组扩容后按新容量重建链路索引。
+ * @details 失败时保留旧索引 (仍然完整)，下次追加时重试。
+ */
+static int adm_index_links(MagicAdmissionContext *ac) {
+  int *buckets = adm_alloc_buckets(ac->link_capacity);
+  if (!buckets)
+    return -1;
+  for (uint32_t i = 0; i < ac->link_count; i++) {
+    uint32_t b = adm_ledger_bucket(ac->links[i].link_id, ac->link_capacity);
+    ac->links[i].hash_next = buckets[b];
+    buckets[b] = (int)i;
+  }
+  free(ac->link_hash);
+  ac->link_hash = buckets;
+  ac->link_buckets = ac->link_capacity;
+  return 0;
+}
+
+/* 同 adm_index_links，重建客户端索引 */
+static int adm_index_clients(MagicAdmissionContext *ac) {
+  int *buckets = adm_alloc_buckets(ac->client_capacity);
+  if (!buckets)
+    return -1;
+  for (uint32_t i = 0; i < ac->client_count; i++) {
+    uint32_t b =
+        adm_ledger_bucket(ac->clients[i].client_id, ac->client_capacity);
+    ac->clients[i].hash_next = buckets[b];
+    buckets[b] = (int)i;
+  }
+  free(ac->client_hash);
+  ac->client_hash = buckets;
+  ac->client_buckets = ac->client_capacity;
+  return 0;
+}
+
+static int adm_find_link(MagicAdmissionContext *ac, const char *link_id) {
+  if (!ac->link_buckets)
+    return -1;
+  int idx = ac->link_hash[adm_ledger_bucket(link_id, ac->link_buckets)];
+  while (idx >= 0) {
+    const AdmissionLinkLedger *l = &ac->links[idx];
+    if (l->in_use && strcmp(l->link_id, link_id) == 0)
+      return idx;
+    idx = l->hash_next;
+  }
+  return -1;
+}
+
+static int adm_find_client(MagicAdmissionContext *ac, const char *client_id) {
+  if (!ac->client_buckets)
+    return -1;
+  int idx = ac->client_hash[adm_ledger_bucket(client_id, ac->client_buckets)];
+  while (idx >= 0) {
+    const AdmissionClientLedger *cl = &ac->clients[idx];
+    if (strcmp(cl->client_id, client_id) == 0)
+      return idx;
+    idx = cl->hash_next;
+  }
+  return -1;
+}
+
+static int adm_get_client(MagicAdmissionContext *ac, const char *client_id) {
+  int found = adm_find_client(ac, client_id);
+  if (found >= 0)
+    return found;
+  if (adm_reserve_array((void **)&ac->clients, &ac->client_capacity,
+                        ac->client_count + 1, sizeof(*ac->clients)) < 0)
+    return -1;
+  if (ac->client_buckets < ac->client_capacity && adm_index_clients(ac) < 0)
+    return -1;
+
+  int idx = (int)ac->client_count;
+  AdmissionClientLedger *cl = &ac->clients[idx];
+  memset(cl, 0, sizeof(*cl));
+  cl->in_use = true;
+  strncpy(cl->client_id, client_id, sizeof(cl->client_id) - 1);
+
+  uint32_t b = adm_ledger_bucket(cl->client_id, ac->client_buckets);
+  cl->hash_next = ac->client_hash[b];
+  ac->client_hash[b] = idx;
+
+  MagicConfig *config =
+      ac->config_store ? magic_config_current(ac->config_store) : NULL;
+  ClientProfile *profile =
+      config ? magic_config_find_client(config, client_id) : NULL;
+  if (profile) {
+    cl->max_fwd_kbps = profile->bandwidth.max_forward_kbps;
+    cl->max_ret_kbps = profile->bandwidth.max_return_kbps;
+  }
+
+  ac->client_count++;
+  return idx;
+}
+
+/* 按 DLM 配置设置链路容量 (超售容量 = 物理容量 × oversubscription_ratio) */
+static void adm_set_link_capacity(AdmissionLinkLedger *l,
+                                  const DLMConfig *dlm) {
+  float ratio =
+      dlm->oversubscription_ratio >= 1.0f ? dlm->oversubscription_ratio : 1.0f;
+  l->capacity_fwd_kbps = (uint32_t)dlm->max_forward_bw_kbps;
+  l->capacity_ret_kbps = (uint32_t)dlm->max_return_bw_kbps;
+  l->oversub_fwd_kbps = (uint32_t)(dlm->max_forward_bw_kbps * ratio);
+  l->oversub_ret_kbps = (uint32_t)(dlm->max_return_bw_kbps * ratio);
+}
+
+/* 为 DLM 追加链路账本，返回下标，内存不足返回 -1 */
+static int adm_add_link(MagicAdmissionContext *ac, const DLMConfig *dlm) {
+  if (adm_reserve_array((void **)&ac->links, &ac->link_capacity,
+                        ac->link_count + 1, sizeof(*ac->links)) < 0)
+    return -1;
+  if (ac->link_buckets < ac->link_capacity && adm_index_links(ac) < 0)
+    return -1;
+
+  int idx = (int)ac->link_count;
+  AdmissionLinkLedger *l = &ac->links[idx];
+  memset(l, 0, sizeof(*l));
+  l->in_use = true;
+  l->available = true;
+  strncpy(l->link_id, dlm->dlm_name, sizeof(l->link_id) - 1);
+  l->res_head = -1;
+  adm_set_link_capacity(l, dlm);
+
+  uint32_t b = adm_ledger_bucket(l->link_id, ac->link_buckets);
+  l->hash_next = ac->link_hash[b];
+  ac->link_hash[b] = idx;
+  ac->link_count++;
+  return idx;
+}
+
+/* 按会话和状态查找预留记录，未找到返回 -1 */
+static int adm_find_res(MagicAdmissionContext *ac, const char *session_id,
+                        AdmissionResState state) {
+  int idx = ac->hash[adm_hash(session_id)];
+  while (idx >= 0) {
+    AdmissionReservation *r = &ac->res[idx];
+    if (r->state == state && strcmp(r->session_id, session_id) == 0)
+      return idx;
+    idx = r->hash_next;
+  }
+  return -1;
+}
+
+/* 计入/扣除账本: sign = +1 计入, -1 扣除 */
+static void adm_charge(MagicAdmissionContext *ac, const AdmissionReservation *r,
+                       int sign) {
+  AdmissionLinkLedger *l = &ac->links[r->link_idx];
+  AdmissionClientLedger *cl = &ac->clients[r->client_idx];
+
+  if (sign > 0) {
+    l->used_fwd_kbps[r->qos_class] += r->fwd_kbps;
+    l->used_ret_kbps[r->qos_class] += r->ret_kbps;
+    cl->used_fwd_kbps += r->fwd_kbps;
+    cl->used_ret_kbps += r->ret_kbps;
+  } else {
+    l->used_fwd_kbps[r->qos_class] =
+        adm_sub_sat(l->used_fwd_kbps[r->qos_class], r->fwd_kbps);
+    l->used_ret_kbps[r->qos_class] =
+        adm_sub_sat(l->used_ret_kbps[r->qos_class], r->ret_kbps);
+    cl->used_fwd_kbps = adm_sub_sat(cl->used_fwd_kbps, r->fwd_kbps);
+    cl->used_ret_kbps = adm_sub_sat(cl->used_ret_kbps, r->ret_kbps);
+  }
+}
+
+static int adm_alloc_res(MagicAdmissionContext *ac, const char *session_id,
+                         int link_idx) {
+  if (ac->free_head < 0)
+    return -1;
+
+  int idx = ac->free_head;
+  AdmissionReservation *r = &ac->res[idx];
+  ac->free_head = r->hash_next;
+
+  memset(r, 0, sizeof(*r));
+  strncpy(r->session_id, session_id, sizeof(r->session_id) - 1);
+  r->link_idx = link_idx;
+  r->preempted_by = -1;
+
+  uint32_t bucket = adm_hash(session_id);
+  r->hash_next = ac->hash[bucket];
+  ac->hash[bucket] = idx;
+
+  AdmissionLinkLedger *l = &ac->links[link_idx];
+  r->link_prev = -1;
+  r->link_next = l->res_head;
+  if (l->res_head >= 0)
+    ac->res[l->res_head].link_prev = idx;
+  l->res_head = idx;
+  l->res_count++;
+
+  ac->res_count++;
+  return idx;
+}
+
+/* 从索引中移除记录并归还槽位 (不改账本) */
+static void adm_free_res(MagicAdmissionContext *ac, int idx) {
+  AdmissionReservation *r = &ac->res[idx];
+
+  int *link = &ac->hash[adm_hash(r->session_id)];
+  while (*link >= 0 && *link != idx)
+    link = &ac->res[*link].hash_next;
+  if (*link == idx)
+    *link = r->hash_next;
+
+  AdmissionLinkLedger *l = &ac->links[r->link_idx];
+  if (r->link_prev >= 0)
+    ac->res[r->link_prev].link_next = r->link_next;
+  else
+    l->res_head = r->link_next;
+  if (r->link_next >= 0)
+    ac->res[r->link_next].link_prev = r->link_prev;
+  l->res_count--;
+
+  r->state = ADMISSION_RES_FREE;
+  r->hash_next = ac->free_head;
+  ac->free_head = idx;
+  ac->res_count--;
+}
+
+/* 回滚一条 RESERVED 记录并恢复其挂起的挤占对象 */
+static void adm_rollback_locked(MagicAdmissionContext *ac, int idx) {
+  AdmissionReservation *r = &ac->res[idx];
+
+  adm_charge(ac, r, -1);
+  for (uint32_t i = 0; i < r->victim_count; i++) {
+    AdmissionReservation *v = &ac->res[r->victims[i]];
+    if (v->state == ADMISSION_RES_PREEMPTING && v->preempted_by == idx) {
+      v->state = ADMISSION_RES_COMMITTED;
+      v->preempted_by = -1;
+      adm_charge(ac, v, +1);
+    }
+  }
+
+  adm_free_res(ac, idx);
+  ac->total_rolled_back++;
+}
+
+/**
+ * @brief 计算链路对某类别的剩余带宽。
+ * @details credit_* 为同会话在该链路上即将被替换的旧预留，可复用。
+ */
+static void adm_link_headroom(const AdmissionLinkLedger *l,
+                              AdmissionQosClass qos_class,
+                              const uint64_t credit_fwd[ADMISSION_CLASS_COUNT],
+                              const uint64_t credit_ret[ADMISSION_CLASS_COUNT],
+                              uint64_t *avail_fwd, uint64_t *avail_ret) {
+  uint64_t used_fwd = 0, used_ret = 0;
+  for (int c = 0; c < ADMISSION_CLASS_COUNT; c++) {
+    used_fwd += adm_sub_sat(l->used_fwd_kbps[c], credit_fwd[c]);
+    used_ret += adm_sub_sat(l->used_ret_kbps[c], credit_ret[c]);
+  }
+
+  *avail_fwd = adm_sub_sat(l->oversub_fwd_kbps, used_fwd);
+  *avail_ret = adm_sub_sat(l->oversub_ret_kbps, used_ret);
+
+  if (qos_class == ADMISSION_CLASS_GUARANTEED) {
+    /* 保证类不参与超售 */
+    uint64_t g_fwd = adm_sub_sat(
+        l->capacity_fwd_kbps,
+        adm_sub_sat(l->used_fwd_kbps[ADMISSION_CLASS_GUARANTEED],
+                    credit_fwd[ADMISSION_CLASS_GUARANTEED]));
+    uint64_t g_ret = adm_sub_sat(
+        l->capacity_ret_kbps,
+        adm_sub_sat(l->used_ret_kbps[ADMISSION_CLASS_GUARANTEED],
+                    credit_ret[ADMISSION_CLASS_GUARANTEED]));
+    if (g_fwd < *avail_fwd)
+      *avail_fwd = g_fwd;
+    if (g_ret < *avail_ret)
+      *avail_ret = g_ret;
+  }
+}
+
+/**
+ * @brief 挑选下一个挤占对象。
+ * @details 仅考虑同链路、其他会话、优先级更低的已提交预留。
+ *          优先 BEST_EFFORT，其次优先级最低，再次带宽最大。
+ *
+ * @param guaranteed_only 仅保证类容量不足时只挑 GUARANTEED 记录。
+ */
+static int adm_pick_victim(MagicAdmissionContext *ac, int link_idx,
+                           const char *session_id, uint8_t priority,
+                           bool guaranteed_only) {
+  int best = -1;
+  for (int idx = ac->links[link_idx].res_head; idx >= 0;
+       idx = ac->res[idx].link_next) {
+    AdmissionReservation *r = &ac->res[idx];
+    if (r->state != ADMISSION_RES_COMMITTED ||
+        adm_effective_priority(r->priority_class) <= priority ||
+        strcmp(r->session_id, session_id) == 0)
+      continue;
+    if (guaranteed_only && r->qos_class != ADMISSION_CLASS_GUARANTEED)
+      continue;
+
+    if (best < 0) {
+      best = idx;
+      continue;
+    }
+    AdmissionReservation *b = &ac->res[best];
+    if (r->qos_class != b->qos_class) {
+      if (r->qos_class == ADMISSION_CLASS_BEST_EFFORT)
+        best = idx;
+    } else if (r->priority_class != b->priority_class) {
+      if (adm_effective_priority(r->priority_class) >
+          adm_effective_priority(b->priority_class))
+        best = idx;
+    } else if (r->fwd_kbps > b->fwd_kbps) {
+      best = idx;
+    }
+  }
+  return best;
+}
+
+/*===========================================================================
+ * 公共 API
+ *===========================================================================*/
+
+int magic_admission_init(MagicAdmissionContext *ac, MagicConfigStore *store) {
+  if (!ac)
+    return -1;
+
+  memset(ac, 0, sizeof(*ac));
+  ac->config_store = store;
+  for (int i = 0; i < ADMISSION_HASH_BUCKETS; i++)
+    ac->hash[i] = -1;
+  for (int i = 0; i < ADMISSION_MAX_RESERVATIONS; i++)
+    ac->res[i].hash_next = (i + 1 < ADMISSION_MAX_RESERVATIONS) ? i + 1 : -1;
+  ac->free_head = 0;
+
+  MagicConfig *config = store ? magic_config_current(store) : NULL;
+  if (config) {
+    for (uint32_t i = 0; i < config->num_dlm_configs; i++) {
+      int idx = adm_add_link(ac, &config->dlm_configs[i]);
+      if (idx < 0) {
+        free(ac->links);
+        free(ac->link_hash);
+        ac->links = NULL;
+        ac->link_hash = NULL;
+        return -1;
+      }
+
+      const AdmissionLinkLedger *l = &ac->links[idx];
+      fd_log_notice("[app_magic] Admission ledger: %s capacity=%u/%u kbps "
+                    "(oversubscribed %u/%u)",
+                    l->link_id, l->capacity_fwd_kbps, l->capacity_ret_kbps,
+                    l->oversub_fwd_kbps, l->oversub_ret_kbps);
+    }
+  }
+
+  if (pthread_mutex_init(&ac->lock, NULL) != 0) {
+    fd_log_error("[app_magic] Admission control: mutex init failed");
+    return -1;
+  }
+  ac->initialized = true;
+
+  fd_log_notice("[app_magic] Admission control initialized (%u links, "
+                "max %d reservations)",
+                ac->link_count, ADMISSION_MAX_RESERVATIONS);
+  return 0;
+}
+
+void magic_admission_reconfigure(MagicAdmissionContext *ac,
+                                 const MagicConfig *config) {
+  if (!ac || !ac->initialized || !config)
+    return;
+
+  pthread_mutex_lock(&ac->lock);
+
+  /* 链路: 已有账本更新容量，新增 DLM 追加账本；已占用额度保持不变 */
+  for (uint32_t i = 0; i < config->num_dlm_configs; i++) {
+    const DLMConfig *dlm = &config->dlm_configs[i];
+    int idx = adm_find_link(ac, dlm->dlm_name);
+    if (idx < 0) {
+      idx = adm_add_link(ac, dlm);
+      if (idx < 0) {
+        fd_log_error("[app_magic] Admission: %s not added", dlm->dlm_name);
+        continue;
+      }
+    }
+    AdmissionLinkLedger *l = &ac->links[idx];
+    adm_set_link_capacity(l, dlm);
+    fd_log_notice("[app_magic] Admission ledger: %s capacity=%u/%u kbps "
+                  "(oversubscribed %u/%u)",
+                  l->link_id, l->capacity_fwd_kbps, l->capacity_ret_kbps,
+                  l->oversub_fwd_kbps, l->oversub_ret_kbps);
+  }
+
+  /* 客户端: 按新 Client_Profile 刷新限额，已删除的客户端不再限额 */
+  for (uint32_t i = 0; i < ac->client_count; i++) {
+    AdmissionClientLedger *cl = &ac->clients[i];
+    const ClientProfile *profile =
+        magic_config_find_client((MagicConfig *)config, cl->client_id);
+    cl->max_fwd_kbps = profile ? profile->bandwidth.max_forward_kbps : 0;
+    cl->max_ret_kbps = profile ? profile->bandwidth.max_return_kbps : 0;
+  }
+
+  pthread_mutex_unlock(&ac->lock);
+}
+
+void magic_admission_cleanup(MagicAdmissionContext *ac) {
+  if (!ac || !ac->initialized)
+    return;
+
+  magic_admission_dump(ac);
+  pthread_mutex_destroy(&ac->lock);
+  free(ac->links);
+  free(ac->clients);
+  free(ac->link_hash);
+  free(ac->client_hash);
+  ac->links = NULL;
+  ac->clients = NULL;
+  ac->link_hash = NULL;
+  ac->client_hash = NULL;
+  ac->link_count = ac->link_capacity = ac->link_buckets = 0;
+  ac->client_count = ac->client_capacity = ac->client_buckets = 0;
+  ac->initialized = false;
+}
+
+AdmissionResult magic_admission_reserve(MagicAdmissionContext *ac,
+                                        const AdmissionRequest *req,
+                                        AdmissionGrant *grant) {
+  if (!ac || !ac->initialized || !req || !req->session_id || !req->client_id ||
+      !req->link_id)
+    return ADMISSION_ERR_INVALID;
+
+  AdmissionResult result = ADMISSION_OK;
+
+  pthread_mutex_lock(&ac->lock);
+
+  int link_idx = adm_find_link(ac, req->link_id);
+  if (link_idx < 0) {
+    result = ADMISSION_ERR_NO_LINK;
+    goto out;
+  }
+  AdmissionLinkLedger *l = &ac->links[link_idx];
+  if (!l->available) {
+    result = ADMISSION_ERR_LINK_DOWN;
+    goto out;
+  }
+
+  int client_idx = adm_get_client(ac, req->client_id);
+  if (client_idx < 0) {
+    result = ADMISSION_ERR_TABLE_FULL;
+    goto out;
+  }
+  AdmissionClientLedger *cl = &ac->clients[client_idx];
+
+  /* 同会话上一次未完成的预留作废 */
+  int stale = adm_find_res(ac, req->session_id, ADMISSION_RES_RESERVED);
+  if (stale >= 0)
+    adm_rollback_locked(ac, stale);
+
+  /* 同会话已提交的预留将在提交时被替换，其额度可复用 */
+  uint64_t link_credit_fwd[ADMISSION_CLASS_COUNT] = {0};
+  uint64_t link_credit_ret[ADMISSION_CLASS_COUNT] = {0};
+  uint64_t client_credit_fwd = 0, client_credit_ret = 0;
+  int own = adm_find_res(ac, req->session_id, ADMISSION_RES_COMMITTED);
+  if (own >= 0) {
+    AdmissionReservation *o = &ac->res[own];
+    if (o->client_idx == client_idx) {
+      client_credit_fwd = o->fwd_kbps;
+      client_credit_ret = o->ret_kbps;
+    }
+    if (o->link_idx == link_idx) {
+      link_credit_fwd[o->qos_class] = o->fwd_kbps;
+      link_credit_ret[o->qos_class] = o->ret_kbps;
+    }
+  }
+
+  AdmissionQosClass qos_class =
+      (req->required_fwd_kbps || req->required_ret_kbps)
+          ? ADMISSION_CLASS_GUARANTEED
+          : ADMISSION_CLASS_BEST_EFFORT;
+
+  /* 可接受的最小带宽: 有保证值取保证值，否则只要求非零 */
+  uint32_t need_fwd =
+      req->required_fwd_kbps
+          ? adm_min_u32(req->required_fwd_kbps, req->requested_fwd_kbps)
+          : (req->requested_fwd_kbps ? 1 : 0);
+  uint32_t need_ret =
+      req->required_ret_kbps
+          ? adm_min_u32(req->required_ret_kbps, req->requested_ret_kbps)
+          : (req->requested_ret_kbps ? 1 : 0);
+
+  /* 客户端配额 (不可抢占) */
+  uint64_t client_fwd =
+      cl->max_fwd_kbps ? adm_sub_sat(cl->max_fwd_kbps,
+                                     adm_sub_sat(cl->used_fwd_kbps,
+                                                 client_credit_fwd))
+                       : UINT32_MAX;
+  uint64_t client_ret =
+      cl->max_ret_kbps ? adm_sub_sat(cl->max_ret_kbps,
+                                     adm_sub_sat(cl->used_ret_kbps,
+                                                 client_credit_ret))
+                       : UINT32_MAX;
+  if (client_fwd < need_fwd || client_ret < need_ret) {
+    result = ADMISSION_ERR_CLIENT_QUOTA;
+    goto out;
+  }
+
+  /* 链路容量，不足时尝试挤占 */
+  uint64_t link_fwd, link_ret;
+  adm_link_headroom(l, qos_class, link_credit_fwd, link_credit_ret, &link_fwd,
+                    &link_ret);
+
+  int victims[ADMISSION_MAX_VICTIMS];
+  uint32_t victim_count = 0;
+  uint8_t priority = adm_effective_priority(req->priority_class);
+
+  while ((link_fwd < need_fwd || link_ret < need_ret) &&
+         req->allow_preemption && victim_count < ADMISSION_MAX_VICTIMS) {
+    /* 仅保证类容量不足时，挤占尽力而为的预留无济于事 */
+    uint64_t total_fwd, total_ret;
+    adm_link_headroom(l, ADMISSION_CLASS_BEST_EFFORT, link_credit_fwd,
+                      link_credit_ret, &total_fwd, &total_ret);
+    bool guaranteed_only = total_fwd >= need_fwd && total_ret >= need_ret;
+
+    int v = adm_pick_victim(ac, link_idx, req->session_id, priority,
+                            guaranteed_only);
+    if (v < 0)
+      break;
+
+    ac->res[v].state = ADMISSION_RES_PREEMPTING;
+    adm_charge(ac, &ac->res[v], -1);
+    victims[victim_count++] = v;
+
+    adm_link_headroom(l, qos_class, link_credit_fwd, link_credit_ret,
+                      &link_fwd, &link_ret);
+  }
+
+  if (link_fwd < need_fwd || link_ret < need_ret) {
+    /* 挤占仍不足，恢复已挂起的对象 */
+    for (uint32_t i = 0; i < victim_count; i++) {
+      ac->res[victims[i]].state = ADMISSION_RES_COMMITTED;
+      adm_charge(ac, &ac->res[victims[i]], +1);
+    }
+    result = ADMISSION_ERR_LINK_CAPACITY;
+    goto out;
+  }
+
+  int idx = adm_alloc_res(ac, req->session_id, link_idx);
+  if (idx < 0) {
+    for (uint32_t i = 0; i < victim_count; i++) {
+      ac->res[victims[i]].state = ADMISSION_RES_COMMITTED;
+      adm_charge(ac, &ac->res[victims[i]], +1);
+    }
+    result = ADMISSION_ERR_TABLE_FULL;
+    goto out;
+  }
+
+  AdmissionReservation *r = &ac->res[idx];
+  r->state = ADMISSION_RES_RESERVED;
+  r->client_idx = client_idx;
+  r->qos_class = qos_class;
+  r->priority_class = req->priority_class;
+  r->fwd_kbps = adm_min_u32(req->requested_fwd_kbps,
+                            client_fwd < link_fwd ? client_fwd : link_fwd);
+  r->ret_kbps = adm_min_u32(req->requested_ret_kbps,
+                            client_ret < link_ret ? client_ret : link_ret);
+  for (uint32_t i = 0; i < victim_count; i++) {
+    r->victims[i] = victims[i];
+    ac->res[victims[i]].preempted_by = idx;
+  }
+  r->victim_count = victim_count;
+  adm_charge(ac, r, +1);
+
+  if (grant) {
+    grant->granted_fwd_kbps = r->fwd_kbps;
+    grant->granted_ret_kbps = r->ret_kbps;
+    grant->qos_class = qos_class;
+    grant->pending_victims = victim_count;
+  }
+
+out:
+  if (result == ADMISSION_OK)
+    ac->total_admitted++;
+  else
+    ac->total_rejected++;
+  pthread_mutex_unlock(&ac->lock);
+
+  if (result != ADMISSION_OK) {
+    fd_log_notice("[app_magic] Admission rejected: session=%s link=%s "
+                  "req=%u/%u kbps (%s)",
+                  req->session_id, req->link_id, req->requested_fwd_kbps,
+                  req->requested_ret_kbps, magic_admission_result_str(result));
+  }
+  return result;
+}
+
+int magic_admission_commit(MagicAdmissionContext *ac, const char *session_id,
+                           AdmissionVictims *victims) {
+  if (victims)
+    memset(victims, 0, sizeof(*victims));
+  if (!ac || !ac->initialized || !session_id)
+    return -1;
+
+  pthread_mutex_lock(&ac->lock);
+
+  int idx = adm_find_res(ac, session_id, ADMISSION_RES_RESERVED);
+  if (idx < 0) {
+    pthread_mutex_unlock(&ac->lock);
+    return -1;
+  }
+  AdmissionReservation *r = &ac->res[idx];
+
+  /* 替换旧的已提交预留 (MODIFY / 链路切换) */
+  int own = adm_find_res(ac, session_id, ADMISSION_RES_COMMITTED);
+  if (own >= 0) {
+    adm_charge(ac, &ac->res[own], -1);
+    adm_free_res(ac, own);
+  }
+
+  /* 确认挤占: 被挤占的记录已从账本扣除，这里只回收槽位 */
+  if (victims)
+    strncpy(victims->link_id, ac->links[r->link_idx].link_id,
+            sizeof(victims->link_id) - 1);
+  for (uint32_t i = 0; i < r->victim_count; i++) {
+    int v = r->victims[i];
+    if (ac->res[v].state != ADMISSION_RES_PREEMPTING ||
+        ac->res[v].preempted_by != idx)
+      continue;
+    if (victims && victims->count < ADMISSION_MAX_VICTIMS) {
+      strncpy(victims->session_id[victims->count], ac->res[v].session_id,
+              ADMISSION_SESSION_ID_LEN - 1);
+      victims->count++;
+    }
+    adm_free_res(ac, v);
+    ac->total_preempted++;
+  }
+  r->victim_count = 0;
+  r->state = ADMISSION_RES_COMMITTED;
+  ac->total_committed++;
+
+  pthread_mutex_unlock(&ac->lock);
+  return 0;
+}
+
+int magic_admission_rollback(MagicAdmissionContext *ac,
+                             const char *session_id) {
+  if (!ac || !ac->initialized || !session_id)
+    return -1;
+
+  pthread_mutex_lock(&ac->lock);
+  int idx = adm_find_res(ac, session_id, ADMISSION_RES_RESERVED);
+  if (idx >= 0)
+    adm_rollback_locked(ac, idx);
+  pthread_mutex_unlock(&ac->lock);
+
+  return idx >= 0 ? 0 : -1;
+}
+
+int magic_admission_release(MagicAdmissionContext *ac,
+                            const char *session_id) {
+  if (!ac || !ac->initialized || !session_id)
+    return 0;
+
+  int released = 0;
+
+  pthread_mutex_lock(&ac->lock);
+
+  int idx = ac->hash[adm_hash(session_id)];
+  while (idx >= 0) {
+    AdmissionReservation *r = &ac->res[idx];
+    int next = r->hash_next;
+    if (strcmp(r->session_id, session_id) == 0) {
+      switch (r->state) {
+      case ADMISSION_RES_RESERVED:
+        adm_rollback_locked(ac, idx);
+        break;
+      case ADMISSION_RES_COMMITTED:
+        adm_charge(ac, r, -1);
+        adm_free_res(ac, idx);
+        break;
+      case ADMISSION_RES_PREEMPTING:
+        /* 已从账本扣除，挤占方提交时会跳过该槽位 */
+        adm_free_res(ac, idx);
+        break;
+      default:
+        break;
+      }
+      released++;
+      /* 回滚可能恢复/释放同链上的其他记录，从桶头重新扫描 */
+      idx = ac->hash[adm_hash(session_id)];
+      continue;
+    }
+    idx = next;
+  }
+
+  pthread_mutex_unlock(&ac->lock);
+  return released;
+}
+
+void magic_admission_set_link_available(MagicAdmissionContext *ac,
+                                        const char *link_id, bool available) {
+  if (!ac || !ac->initialized || !link_id)
+    return;
+
+  pthread_mutex_lock(&ac->lock);
+  int idx = adm_find_link(ac, link_id);
+  if (idx >= 0)
+    ac->links[idx].available = available;
+  pthread_mutex_unlock(&ac->lock);
+}
+
+int magic_admission_get_link_headroom(MagicAdmissionContext *ac,
+                                      const char *link_id, uint32_t *fwd_kbps,
+                                      uint32_t *ret_kbps) {
+  if (!ac || !ac->initialized || !link_id)
+    return -1;
+
+  static const uint64_t no_credit[ADMISSION_CLASS_COUNT] = {0};
+  uint64_t fwd = 0, ret = 0;
+
+  pthread_mutex_lock(&ac->lock);
+  int idx = adm_find_link(ac, link_id);
+  if (idx >= 0) {
+    adm_link_headroom(&ac->links[idx], ADMISSION_CLASS_BEST_EFFORT, no_credit,
+                      no_credit, &fwd, &ret);
+  }
+  pthread_mutex_unlock(&ac->lock);
+
+  if (idx < 0)
+    return -1;
+  if (fwd_kbps)
+    *fwd_kbps = adm_min_u32(fwd, UINT32_MAX);
+  if (ret_kbps)
+    *ret_kbps = adm_min_u32(ret, UINT32_MAX);
+  return 0;
+}
+
+const char *magic_admission_result_str(AdmissionResult result) {
+  switch (result) {
+  case ADMISSION_OK:
+    return "OK";
+  case ADMISSION_ERR_INVALID:
+    return "INVALID";
+  case ADMISSION_ERR_NO_LINK:
+    return "NO_LINK";
+  case ADMISSION_ERR_LINK_DOWN:
+    return "LINK_DOWN";
+  case ADMISSION_ERR_CLIENT_QUOTA:
+    return "CLIENT_QUOTA";
+  case ADMISSION_ERR_LINK_CAPACITY:
+    return "LINK_CAPACITY";
+  case ADMISSION_ERR_TABLE_FULL:
+    return "TABLE_FULL";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+void magic_admission_dump(MagicAdmissionContext *ac) {
+  if (!ac || !ac->initialized)
+    return;
+
+  pthread_mutex_lock(&ac->lock);
+
+  fd_log_notice("[app_magic] Admission: reservations=%u admitted=%llu "
+                "rejected=%llu committed=%llu rolled_back=%llu preempted=%llu",
+                ac->res_count, (unsigned long long)ac->total_admitted,
+                (unsigned long long)ac->total_rejected,
+                (unsigned long long)ac->total_committed,
+                (unsigned long long)ac->total_rolled_back,
+                (unsigned long long)ac->total_preempted);
+
+  for (uint32_t i = 0; i < ac->link_count; i++) {
+    const AdmissionLinkLedger *l = &ac->links[i];
+    fd_log_notice(
+        "[app_magic]   %s%s: GR=%llu/%llu BE=%llu/%llu kbps (cap %u/%u, "
+        "oversub %u/%u), %u reservation(s)",
+        l->link_id, l->available ? "" : " [DOWN]",
+        (unsigned long long)l->used_fwd_kbps[ADMISSION_CLASS_GUARANTEED],
+        (unsigned long long)l->used_ret_kbps[ADMISSION_CLASS_GUARANTEED],
+        (unsigned long long)l->used_fwd_kbps[ADMISSION_CLASS_BEST_EFFORT],
+        (unsigned long long)l->used_ret_kbps[ADMISSION_CLASS_BEST_EFFORT],
+        l->capacity_fwd_kbps, l->capacity_ret_kbps, l->oversub_fwd_kbps,
+        l->oversub_ret_kbps, l->res_count);
+  }
+
+  pthread_mutex_unlock(&ac->lock);
+}
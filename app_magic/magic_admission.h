@@ -0,0 +1,301 @@
+/**
+ * @file magic_admission.h
+ * @brief MAGIC 带宽准入控制模块头文件。
+ * @details 统一维护每条链路、每个客户端的带宽账本，所有链路资源申请
+ *          (MCAR 0-RTT、MCCR、链路切换、ADIF 重评估) 在发起 MIH 请求前
+ *          先在此预留带宽，MIH 成功后提交，失败则回滚。
+ *
+ * 账本模型:
+ * - 链路账本按 QoS 类别分账: GUARANTEED (有最小保证带宽的请求) 只能占用
+ *   物理容量；GUARANTEED + BEST_EFFORT 总和不超过含超售比的容量
+ * - 客户端账本按 Client_Profile 中的 max_forward/max_return 限额
+ * - 链路与客户端账本数组按需倍增，预留记录以下标引用账本；账本按 ID
+ *   建哈希索引，桶数随容量一起倍增
+ * - 预留 (RESERVED) 已计入账本，提交 (COMMITTED) 后替换该会话旧的预留，
+ *   回滚则原样退回；同一会话在同一链路上修改带宽时旧预留额度可复用
+ * - 抢占: 请求方 QoS 为 PREEMPTION 时，可挤占同链路上 priority_class
+ *   更低的已提交预留 (优先挤占 BEST_EFFORT)。被挤占者在提交前仅被
+ *   "挂起"，回滚时恢复；提交时才返回给调用方执行拆除
+ *
+ * 所有账本查询为 O(1)：链路/客户端账本按 ID、预留记录按 Session-ID
+ * 经 FNV-1a 哈希索引定位。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_ADMISSION_H
+#define MAGIC_ADMISSION_H
+
+#include "magic_config.h"
+#include "magic_config_store.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ADMISSION_INITIAL_CAPACITY 16       /* 账本初始容量 (2 的幂) */
+#define ADMISSION_MAX_RESERVATIONS 4096     /* 最大并存预留记录数 */
+#define ADMISSION_HASH_BUCKETS 1024         /* Session-ID 哈希桶数 (2 的幂) */
+#define ADMISSION_MAX_VICTIMS 16            /* 单次请求最多挤占的预留数 */
+#define ADMISSION_SESSION_ID_LEN 128        /* 会话 ID 最大长度 */
+#define ADMISSION_LOWEST_PRIORITY 10        /* priority_class 未设置时视为最低 */
+
+/**
+ * @brief 账本 QoS 类别。
+ */
+typedef enum {
+  ADMISSION_CLASS_GUARANTEED = 0, ///< 有最小保证带宽 (required > 0)。
+  ADMISSION_CLASS_BEST_EFFORT,    ///< 尽力而为。
+  ADMISSION_CLASS_COUNT
+} AdmissionQosClass;
+
+/**
+ * @brief 准入结果码。
+ */
+typedef enum {
+  ADMISSION_OK = 0,                 ///< 预留成功。
+  ADMISSION_ERR_INVALID = -1,       ///< 参数错误或模块未初始化。
+  ADMISSION_ERR_NO_LINK = -2,       ///< 链路不在账本中。
+  ADMISSION_ERR_LINK_DOWN = -3,     ///< 链路不可用。
+  ADMISSION_ERR_CLIENT_QUOTA = -4,  ///< 超出客户端配额。
+  ADMISSION_ERR_LINK_CAPACITY = -5, ///< 链路容量不足 (含抢占后)。
+  ADMISSION_ERR_TABLE_FULL = -6     ///< 预留记录已满。
+} AdmissionResult;
+
+/**
+ * @brief 预留记录状态。
+ */
+typedef enum {
+  ADMISSION_RES_FREE = 0,   ///< 空闲槽位。
+  ADMISSION_RES_RESERVED,   ///< 已预留，等待提交或回滚。
+  ADMISSION_RES_COMMITTED,  ///< 已提交 (资源已在 DLM 上分配)。
+  ADMISSION_RES_PREEMPTING  ///< 已提交但正被更高优先级的预留挤占。
+} AdmissionResState;
+
+/**
+ * @brief 单条链路账本。
+ */
+typedef struct {
+  bool in_use;                    ///< 是否在使用。
+  bool available;                 ///< 链路是否可用 (LMI Link UP/DOWN)。
+  char link_id[MAX_ID_LEN];       ///< 链路 ID (DLM 名称)。
+  uint32_t capacity_fwd_kbps;     ///< 物理前向容量 (GUARANTEED 上限)。
+  uint32_t capacity_ret_kbps;     ///< 物理返回容量。
+  uint32_t oversub_fwd_kbps;      ///< 含超售的前向容量 (总上限)。
+  uint32_t oversub_ret_kbps;      ///< 含超售的返回容量。
+  uint64_t used_fwd_kbps[ADMISSION_CLASS_COUNT]; ///< 各类别已占用前向带宽。
+  uint64_t used_ret_kbps[ADMISSION_CLASS_COUNT]; ///< 各类别已占用返回带宽。
+  int res_head;                   ///< 本链路预留链表头 (-1 = 空)。
+  uint32_t res_count;             ///< 本链路预留记录数。
+  int hash_next;                  ///< 同桶下一链路账本 (-1 = 链尾)。
+} AdmissionLinkLedger;
+
+/**
+ * @brief 单个客户端账本。
+ */
+typedef struct {
+  bool in_use;                ///< 是否在使用。
+  char client_id[MAX_ID_LEN]; ///< 客户端 ID。
+  uint32_t max_fwd_kbps;      ///< 前向限额 (0 = 不限)。
+  uint32_t max_ret_kbps;      ///< 返回限额 (0 = 不限)。
+  uint64_t used_fwd_kbps;     ///< 已占用前向带宽。
+  uint64_t used_ret_kbps;     ///< 已占用返回带宽。
+  int hash_next;              ///< 同桶下一客户端账本 (-1 = 链尾)。
+} AdmissionClientLedger;
+
+/**
+ * @brief 预留记录。
+ */
+typedef struct {
+  AdmissionResState state;                ///< 记录状态。
+  char session_id[ADMISSION_SESSION_ID_LEN]; ///< 所属会话。
+  int link_idx;                           ///< 链路账本下标。
+  int client_idx;                         ///< 客户端账本下标。
+  AdmissionQosClass qos_class;            ///< 账本类别。
+  uint8_t priority_class;                 ///< 优先级 (1-9, 越小越高)。
+  uint32_t fwd_kbps;                      ///< 前向带宽。
+  uint32_t ret_kbps;                      ///< 返回带宽。
+  int victims[ADMISSION_MAX_VICTIMS];     ///< 本预留挤占的记录 (RESERVED 时有效)。
+  uint32_t victim_count;                  ///< 挤占记录数。
+  int preempted_by;                       ///< PREEMPTING 时指向挤占方 (-1 = 无)。
+  int hash_next;                          ///< 哈希链/空闲链下一槽位。
+  int link_prev;                          ///< 链路链表前驱。
+  int link_next;                          ///< 链路链表后继。
+} AdmissionReservation;
+
+/**
+ * @brief 准入请求。
+ */
+typedef struct {
+  const char *session_id;      ///< 会话 ID (必填)。
+  const char *client_id;       ///< 客户端 ID (必填)。
+  const char *link_id;         ///< 目标链路 (必填)。
+  uint32_t requested_fwd_kbps; ///< 请求前向带宽。
+  uint32_t requested_ret_kbps; ///< 请求返回带宽。
+  uint32_t required_fwd_kbps;  ///< 最小保证前向带宽 (0 = 尽力而为)。
+  uint32_t required_ret_kbps;  ///< 最小保证返回带宽。
+  uint8_t priority_class;      ///< 优先级 (1-9, 越小越高, 0 = 最低)。
+  bool allow_preemption;       ///< 是否允许挤占低优先级预留。
+} AdmissionRequest;
+
+/**
+ * @brief 准入结果 (预留成功时填充)。
+ */
+typedef struct {
+  uint32_t granted_fwd_kbps;   ///< 批准前向带宽 (可能小于请求值)。
+  uint32_t granted_ret_kbps;   ///< 批准返回带宽。
+  AdmissionQosClass qos_class; ///< 记账类别。
+  uint32_t pending_victims;    ///< 提交时将被拆除的会话数。
+} AdmissionGrant;
+
+/**
+ * @brief 提交时被挤占的会话列表。
+ */
+typedef struct {
+  char session_id[ADMISSION_MAX_VICTIMS][ADMISSION_SESSION_ID_LEN];
+  char link_id[MAX_ID_LEN]; ///< 被挤占会话所在链路。
+  uint32_t count;
+} AdmissionVictims;
+
+/**
+ * @brief 准入控制上下文。
+ */
+typedef struct {
+  AdmissionLinkLedger *links;     ///< 链路账本 (满时倍增，按下标引用)。
+  uint32_t link_count;            ///< 使用中的链路账本数。
+  uint32_t link_capacity;         ///< links 已分配容量。
+  int *link_hash;                 ///< link_id 哈希桶 (-1 = 空)。
+  uint32_t link_buckets;          ///< link_hash 桶数 (2 的幂)。
+  AdmissionClientLedger *clients; ///< 客户端账本 (满时倍增)。
+  uint32_t client_count;          ///< 使用中的客户端账本数。
+  uint32_t client_capacity;       ///< clients 已分配容量。
+  int *client_hash;               ///< client_id 哈希桶 (-1 = 空)。
+  uint32_t client_buckets;        ///< client_hash 桶数 (2 的幂)。
+
+  AdmissionReservation res[ADMISSION_MAX_RESERVATIONS]; ///< 预留记录池。
+  int hash[ADMISSION_HASH_BUCKETS]; ///< Session-ID 哈希桶。
+  int free_head;                    ///< 空闲槽位链表头。
+  uint32_t res_count;               ///< 使用中的预留记录数。
+
+  /* 统计 */
+  uint64_t total_admitted;    ///< 预留成功次数。
+  uint64_t total_rejected;    ///< 预留拒绝次数。
+  uint64_t total_committed;   ///< 提交次数。
+  uint64_t total_rolled_back; ///< 回滚次数。
+  uint64_t total_preempted;   ///< 被挤占的预留数。
+
+  MagicConfigStore *config_store; ///< 配置存储 (DLM 容量与客户端限额)。
+  pthread_mutex_t lock;           ///< 保护全部账本。
+  bool initialized;               ///< 是否已初始化。
+} MagicAdmissionContext;
+
+/**
+ * @brief 初始化准入控制模块。
+ * @details 按 DLM 配置建立链路账本 (容量 = max_*_bw_kbps，超售容量再乘以
+ *          oversubscription_ratio)。客户端账本在首次预留时按 Client_Profile
+ *          限额创建。
+ *
+ * @param ac 准入控制上下文。
+ * @param store 已加载首个版本的配置存储。
+ * @return 0 成功，-1 失败。
+ */
+int magic_admission_init(MagicAdmissionContext *ac, MagicConfigStore *store);
+
+/**
+ * @brief 按新发布的配置刷新账本容量与限额。
+ * @details 配置重载时调用。已有链路更新容量，新增 DLM 追加账本；
+ *          已占用额度与预留记录保持不变，超出新容量的部分不做回收，
+ *          只影响后续准入。已建立的客户端账本按新 Client_Profile 刷新限额。
+ *
+ * @param ac 准入控制上下文。
+ * @param config 新发布的配置。
+ */
+void magic_admission_reconfigure(MagicAdmissionContext *ac,
+                                 const MagicConfig *config);
+
+/**
+ * @brief 清理准入控制模块。
+ * @param ac 准入控制上下文。
+ */
+void magic_admission_cleanup(MagicAdmissionContext *ac);
+
+/**
+ * @brief 为会话在指定链路上预留带宽。
+ * @details 同时检查客户端账本和链路账本；容量不足时按请求允许的范围挤占
+ *          低优先级预留。批准带宽取请求值与可用值的较小者，但不低于
+ *          required。同一会话之前未提交的预留会被先回滚。
+ *
+ * @param ac 准入控制上下文。
+ * @param req 准入请求。
+ * @param grant 输出参数，批准结果 (可为 NULL)。
+ * @return ADMISSION_OK 或 AdmissionResult 中的错误码。
+ */
+AdmissionResult magic_admission_reserve(MagicAdmissionContext *ac,
+                                        const AdmissionRequest *req,
+                                        AdmissionGrant *grant);
+
+/**
+ * @brief 提交会话的预留。
+ * @details 替换该会话原有的已提交预留，并确认挤占。
+ *
+ * @param ac 准入控制上下文。
+ * @param session_id 会话 ID。
+ * @param victims 输出参数，需由调用方拆除的会话 (可为 NULL)。
+ * @return 0 成功，-1 未找到预留。
+ */
+int magic_admission_commit(MagicAdmissionContext *ac, const char *session_id,
+                           AdmissionVictims *victims);
+
+/**
+ * @brief 回滚会话未提交的预留，恢复被挂起的挤占对象。
+ *
+ * @param ac 准入控制上下文。
+ * @param session_id 会话 ID。
+ * @return 0 成功，-1 未找到预留。
+ */
+int magic_admission_rollback(MagicAdmissionContext *ac, const char *session_id);
+
+/**
+ * @brief 释放会话的全部预留 (链路关闭、会话终止)。
+ *
+ * @param ac 准入控制上下文。
+ * @param session_id 会话 ID。
+ * @return 释放的记录数。
+ */
+int magic_admission_release(MagicAdmissionContext *ac, const char *session_id);
+
+/**
+ * @brief 设置链路可用状态 (LMI Link UP/DOWN)。
+ *
+ * @param ac 准入控制上下文。
+ * @param link_id 链路 ID。
+ * @param available 是否可用。
+ */
+void magic_admission_set_link_available(MagicAdmissionContext *ac,
+                                        const char *link_id, bool available);
+
+/**
+ * @brief 查询链路剩余可用带宽 (含超售，O(1))。
+ *
+ * @param ac 准入控制上下文。
+ * @param link_id 链路 ID。
+ * @param fwd_kbps 输出参数，剩余前向带宽 (可为 NULL)。
+ * @param ret_kbps 输出参数，剩余返回带宽 (可为 NULL)。
+ * @return 0 成功，-1 链路不存在。
+ */
+int magic_admission_get_link_headroom(MagicAdmissionContext *ac,
+                                      const char *link_id, uint32_t *fwd_kbps,
+                                      uint32_t *ret_kbps);
+
+/**
+ * @brief 结果码转字符串。
+ */
+const char *magic_admission_result_str(AdmissionResult result);
+
+/**
+ * @brief 输出账本与统计到日志。
+ * @param ac 准入控制上下文。
+ */
+void magic_admission_dump(MagicAdmissionContext *ac);
+
+#endif /* MAGIC_ADMISSION_H */
@@ -1,7 +1,15 @@
 /**
  * @file magic_cdr.c
  * @brief MAGIC CDR (Call Data Record) 管理模块实现
- * @description 实现 CDR 的创建、关闭、切分和 JSON 持久化存储
+ * @description 实现 CDR 的创建、关闭、切分和持久化存储
+ *
+ * 持久化: 每次状态变化向 CDR 日志追加一条快照 (magic_cdr_journal.c)。
+ * 创建/归档等关键操作等待日志落盘，同一操作内的多条快照只等待最后一条，
+ * 并发操作共享一次 fsync；日志不可用或写入失败时回退到 JSON 文件。
+ *
+ * 计费导出: 归档时先把 CDR 追加到导出分段 (magic_cdr_export.c)，再写入
+ * 带"已导出"标志的 ARCHIVED 快照；重启时日志中已关闭但未带该标志的 CDR
+ * 会被补导出 (先按 cdr_id 点查去重)。
  *
  * @author MAGIC System Development Team
  * @version 1.0
@@ -9,6 +17,7 @@
  */
 
 #include "magic_cdr.h"
+#include "magic_hash.h"
 
 #include <dirent.h>
 #include <errno.h>
@@ -28,6 +37,11 @@ static int ensure_directory_exists(const char *path);
 static int cdr_to_json(const CDRRecord *cdr, char *buffer, size_t buf_size);
 static int json_to_cdr(const char *json, CDRRecord *cdr);
 static char *read_file_content(const char *filepath);
+static void cdr_to_entry(const CDRRecord *cdr, CDRJournalEntry *entry);
+static int cdr_persist(CDRManager *mgr, const CDRRecord *cdr, bool durable);
+static void journal_replay_cb(const CDRJournalEntry *entry, void *arg);
+static int migrate_legacy_files(CDRManager *mgr);
+static int migrate_legacy_archives(CDRManager *mgr);
 
 /*===========================================================================
  * UUID 生成
@@ -134,6 +148,192 @@ static int ensure_directory_exists(const char *path) {
   return 0;
 }
 
+/*===========================================================================
+ * 记录存储与索引
+ *===========================================================================*/
+
+#define CDR_REPLAY_EXPORT_MAX 4096 /* 单次启动补导出后回写标志的记录上限 */
+#define CDR_MIGRATE_BATCH 1024     /* 旧版归档迁移: 每批落盘后删除的文件数 */
+
+/**
+ * @brief 日志回放上下文。
+ */
+typedef struct {
+  CDRManager *mgr;          ///< CDR 管理器。
+  CDRJournalEntry *pending; ///< 待写回的 ARCHIVED 快照 (已补导出)。
+  uint32_t num_pending;     ///< 待写回数。
+  uint32_t cap_pending;     ///< 容量。
+  uint32_t exported;        ///< 补导出的记录数。
+} ReplayContext;
+
+/* 原子读写流量字段 */
+#define CDR_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define CDR_STORE(field, v) __atomic_store_n(&(field), (v), __ATOMIC_RELAXED)
+
+static uint32_t id_hash(uint32_t id) { return id * 2654435761u; }
+
+/**
+ * @brief 按新桶数重建三个索引。
+ * @note 调用者须持有写锁 (初始化时除外)。
+ */
+static int index_resize(CDRManager *mgr, uint32_t nbuckets) {
+  CDRRecord **ids = calloc(nbuckets, sizeof(CDRRecord *));
+  CDRRecord **sessions = calloc(nbuckets, sizeof(CDRRecord *));
+  CDRRecord **clients = calloc(nbuckets, sizeof(CDRRecord *));
+  if (!ids || !sessions || !clients) {
+    free(ids);
+    free(sessions);
+    free(clients);
+    return -1;
+  }
+
+  uint32_t mask = nbuckets - 1;
+  for (uint32_t c = 0; c < mgr->num_chunks; c++) {
+    for (uint32_t i = 0; i < CDR_CHUNK_RECORDS; i++) {
+      CDRRecord *cdr = &mgr->chunks[c][i];
+      if (!cdr->in_use) {
+        continue;
+      }
+      uint32_t b = id_hash(cdr->cdr_id) & mask;
+      cdr->id_next = ids[b];
+      ids[b] = cdr;
+      b = magic_fnv1a32_str(cdr->session_id) & mask;
+      cdr->session_next = sessions[b];
+      sessions[b] = cdr;
+      b = magic_fnv1a32_str(cdr->client_id) & mask;
+      cdr->client_next = clients[b];
+      clients[b] = cdr;
+    }
+  }
+
+  free(mgr->id_buckets);
+  free(mgr->session_buckets);
+  free(mgr->client_buckets);
+  mgr->id_buckets = ids;
+  mgr->session_buckets = sessions;
+  mgr->client_buckets = clients;
+  mgr->num_buckets = nbuckets;
+  return 0;
+}
+
+/**
+ * @brief 把已填好标识字段且 in_use 已置位的记录加入索引并计数。
+ * @note 调用者须持有写锁。
+ */
+static void record_insert(CDRManager *mgr, CDRRecord *cdr) {
+  uint32_t mask = mgr->num_buckets - 1;
+  uint32_t b = id_hash(cdr->cdr_id) & mask;
+  cdr->id_next = mgr->id_buckets[b];
+  mgr->id_buckets[b] = cdr;
+  b = magic_fnv1a32_str(cdr->session_id) & mask;
+  cdr->session_next = mgr->session_buckets[b];
+  mgr->session_buckets[b] = cdr;
+  b = magic_fnv1a32_str(cdr->client_id) & mask;
+  cdr->client_next = mgr->client_buckets[b];
+  mgr->client_buckets[b] = cdr;
+
+  /* 平均链长超过 1 时倍增 (按 in_use 重建，失败时沿用旧表) */
+  if (++mgr->record_count > mgr->num_buckets) {
+    index_resize(mgr, mgr->num_buckets * 2);
+  }
+}
+
+/**
+ * @brief 分配一条空记录 (必要时新增一个记录块)。
+ * @note 调用者须持有写锁 (初始化时除外)。
+ */
+static CDRRecord *record_alloc(CDRManager *mgr) {
+  if (!mgr->free_list) {
+    if (mgr->num_chunks >= CDR_MAX_CHUNKS) {
+      return NULL;
+    }
+    CDRRecord *chunk = calloc(CDR_CHUNK_RECORDS, sizeof(CDRRecord));
+    if (!chunk) {
+      return NULL;
+    }
+    mgr->chunks[mgr->num_chunks++] = chunk;
+    for (int i = CDR_CHUNK_RECORDS - 1; i >= 0; i--) {
+      chunk[i].id_next = mgr->free_list;
+      mgr->free_list = &chunk[i];
+    }
+  }
+
+  CDRRecord *cdr = mgr->free_list;
+  mgr->free_list = cdr->id_next;
+  cdr->id_next = NULL;
+  return cdr;
+}
+
+/**
+ * @brief 从索引摘除记录，销毁其锁并放回空闲链。
+ * @note 调用者须持有写锁。
+ */
+static void record_release(CDRManager *mgr, CDRRecord *cdr) {
+  uint32_t mask = mgr->num_buckets - 1;
+  CDRRecord **pp;
+
+  for (pp = &mgr->id_buckets[id_hash(cdr->cdr_id) & mask]; *pp;
+       pp = &(*pp)->id_next) {
+    if (*pp == cdr) {
+      *pp = cdr->id_next;
+      break;
+    }
+  }
+  uint32_t b = magic_fnv1a32_str(cdr->session_id) & mask;
+  for (pp = &mgr->session_buckets[b]; *pp; pp = &(*pp)->session_next) {
+    if (*pp == cdr) {
+      *pp = cdr->session_next;
+      break;
+    }
+  }
+  b = magic_fnv1a32_str(cdr->client_id) & mask;
+  for (pp = &mgr->client_buckets[b]; *pp; pp = &(*pp)->client_next) {
+    if (*pp == cdr) {
+      *pp = cdr->client_next;
+      break;
+    }
+  }
+
+  if (cdr->lock_initialized) {
+    pthread_mutex_destroy(&cdr->lock);
+  }
+
+  memset(cdr, 0, sizeof(CDRRecord));
+  cdr->id_next = mgr->free_list;
+  mgr->free_list = cdr;
+  mgr->record_count--;
+}
+
+/**
+ * @brief 按 session_id 查找 ACTIVE 记录。
+ * @note 调用者须持有读锁或写锁。
+ */
+static CDRRecord *find_active_locked(CDRManager *mgr, const char *session_id) {
+  uint32_t b = magic_fnv1a32_str(session_id) & (mgr->num_buckets - 1);
+  for (CDRRecord *cdr = mgr->session_buckets[b]; cdr;
+       cdr = cdr->session_next) {
+    if (cdr->status == CDR_STATUS_ACTIVE &&
+        strcmp(cdr->session_id, session_id) == 0) {
+      return cdr;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief 按 cdr_id 查找记录。
+ * @note 调用者须持有读锁或写锁。
+ */
+static CDRRecord *find_id_locked(CDRManager *mgr, uint32_t cdr_id) {
+  uint32_t b = id_hash(cdr_id) & (mgr->num_buckets - 1);
+  for (CDRRecord *cdr = mgr->id_buckets[b]; cdr; cdr = cdr->id_next) {
+    if (cdr->cdr_id == cdr_id) {
+      return cdr;
+    }
+  }
+  return NULL;
+}
+
 /*===========================================================================
  * 初始化和清理
  *===========================================================================*/
@@ -169,19 +369,77 @@ int cdr_manager_init(CDRManager *mgr, const char *base_dir,
     return -1;
   }
 
-  /* 初始化管理器锁 */
-  if (pthread_mutex_init(&mgr->manager_lock, NULL) != 0) {
-    fd_log_error("[CDR] Failed to initialize manager mutex");
+  /* 初始化管理器锁与索引 */
+  if (pthread_rwlock_init(&mgr->manager_lock, NULL) != 0) {
+    fd_log_error("[CDR] Failed to initialize manager lock");
+    return -1;
+  }
+
+  if (index_resize(mgr, CDR_INDEX_MIN_BUCKETS) != 0) {
+    fd_log_error("[CDR] Failed to allocate CDR indexes");
+    pthread_rwlock_destroy(&mgr->manager_lock);
     return -1;
   }
 
   /* 生成初始 CDR ID (基于时间戳) */
   mgr->next_cdr_id = (uint32_t)(time(NULL) & 0xFFFFFFFF);
 
-  /* 加载已有的活跃 CDR */
-  int loaded = cdr_load_all_active(mgr);
-  if (loaded > 0) {
-    fd_log_notice("[CDR] Loaded %d active CDR records", loaded);
+  /* 打开计费导出器 (回放时可能需要补导出) */
+  if (cdr_export_open(&mgr->exporter, mgr->archive_dir, CDR_EXPORT_JSONL) ==
+      0) {
+    mgr->export_enabled = true;
+  } else {
+    fd_log_notice("[CDR] ⚠ CDR export unavailable, archiving per-record JSON");
+  }
+
+  /* 打开 CDR 日志并回放活跃 CDR */
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  ReplayContext replay = {.mgr = mgr};
+  int replayed = cdr_journal_open(&mgr->journal, mgr->base_dir,
+                                  journal_replay_cb, &replay);
+  if (replayed >= 0) {
+    mgr->journal_enabled = true;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fd_log_notice("[CDR] Journal replayed: %d CDRs (%u active) in %ld ms",
+                  replayed, mgr->record_count,
+                  (long)((t1.tv_sec - t0.tv_sec) * 1000 +
+                         (t1.tv_nsec - t0.tv_nsec) / 1000000));
+
+    /* 补导出的 CDR 写回带导出标志的 ARCHIVED 快照，下次启动不再处理 */
+    uint64_t last_seq = 0;
+    for (uint32_t i = 0; i < replay.num_pending; i++) {
+      uint64_t seq = cdr_journal_append(&mgr->journal, &replay.pending[i]);
+      last_seq = seq ? seq : last_seq;
+    }
+    if (last_seq != 0) {
+      cdr_journal_sync(&mgr->journal, last_seq);
+    }
+    if (replay.exported > 0) {
+      fd_log_notice("[CDR] Exported %u closed CDRs found in journal",
+                    replay.exported);
+    }
+
+    int migrated = migrate_legacy_files(mgr);
+    if (migrated > 0) {
+      fd_log_notice("[CDR] Migrated %d legacy JSON CDR records into journal",
+                    migrated);
+    }
+  } else {
+    fd_log_notice("[CDR] ⚠ Journal unavailable, using per-record JSON files");
+
+    /* 加载已有的活跃 CDR */
+    int loaded = cdr_load_all_active(mgr);
+    if (loaded > 0) {
+      fd_log_notice("[CDR] Loaded %d active CDR records", loaded);
+    }
+  }
+  free(replay.pending);
+
+  int archived = migrate_legacy_archives(mgr);
+  if (archived > 0) {
+    fd_log_notice("[CDR] Exported %d legacy JSON archives", archived);
   }
 
   mgr->is_initialized = true;
@@ -189,6 +447,8 @@ int cdr_manager_init(CDRManager *mgr, const char *base_dir,
 
   fd_log_notice("[CDR] CDR Manager initialized:");
   fd_log_notice("[CDR]   Base dir: %s", mgr->base_dir);
+  fd_log_notice("[CDR]   Storage: %s",
+                mgr->journal_enabled ? mgr->journal.path : "JSON files");
   fd_log_notice("[CDR]   Retention: %u seconds (%u hours)", mgr->retention_sec,
                 mgr->retention_sec / 3600);
 
@@ -199,21 +459,44 @@ void cdr_manager_cleanup(CDRManager *mgr) {
   if (!mgr || !mgr->is_initialized)
     return;
 
-  pthread_mutex_lock(&mgr->manager_lock);
-
   /* 保存所有活跃 CDR */
   cdr_save_all_active(mgr);
 
-  /* 销毁所有 CDR 锁 */
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && cdr->lock_initialized) {
-      pthread_mutex_destroy(&cdr->lock);
+  pthread_rwlock_wrlock(&mgr->manager_lock);
+
+  /* 销毁所有 CDR 锁并释放记录块与索引 */
+  for (uint32_t c = 0; c < mgr->num_chunks; c++) {
+    for (uint32_t i = 0; i < CDR_CHUNK_RECORDS; i++) {
+      CDRRecord *cdr = &mgr->chunks[c][i];
+      if (cdr->in_use && cdr->lock_initialized) {
+        pthread_mutex_destroy(&cdr->lock);
+      }
     }
+    free(mgr->chunks[c]);
+    mgr->chunks[c] = NULL;
+  }
+  mgr->num_chunks = 0;
+  mgr->free_list = NULL;
+  mgr->record_count = 0;
+
+  free(mgr->id_buckets);
+  free(mgr->session_buckets);
+  free(mgr->client_buckets);
+  mgr->id_buckets = mgr->session_buckets = mgr->client_buckets = NULL;
+  mgr->num_buckets = 0;
+
+  pthread_rwlock_unlock(&mgr->manager_lock);
+  pthread_rwlock_destroy(&mgr->manager_lock);
+
+  if (mgr->journal_enabled) {
+    cdr_journal_close(&mgr->journal);
+    mgr->journal_enabled = false;
   }
 
-  pthread_mutex_unlock(&mgr->manager_lock);
-  pthread_mutex_destroy(&mgr->manager_lock);
+  if (mgr->export_enabled) {
+    cdr_export_close(&mgr->exporter);
+    mgr->export_enabled = false;
+  }
 
   mgr->is_initialized = false;
 
@@ -233,27 +516,16 @@ CDRRecord *cdr_create(CDRManager *mgr, const char *session_id,
   if (!mgr || !mgr->is_initialized || !session_id)
     return NULL;
 
-  pthread_mutex_lock(&mgr->manager_lock);
-
-  CDRRecord *cdr = NULL;
-
-  /* 查找空闲槽位 */
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    if (!mgr->records[i].in_use) {
-      cdr = &mgr->records[i];
-      break;
-    }
-  }
+  pthread_rwlock_wrlock(&mgr->manager_lock);
 
+  /* 分配记录 (已清零) */
+  CDRRecord *cdr = record_alloc(mgr);
   if (!cdr) {
     fd_log_error("[CDR] No free CDR slot available");
-    pthread_mutex_unlock(&mgr->manager_lock);
+    pthread_rwlock_unlock(&mgr->manager_lock);
     return NULL;
   }
 
-  /* 初始化 CDR 记录 */
-  memset(cdr, 0, sizeof(CDRRecord));
-
   cdr->cdr_id = mgr->next_cdr_id++;
   cdr_generate_uuid(cdr->cdr_uuid, sizeof(cdr->cdr_uuid));
 
@@ -274,13 +546,13 @@ CDRRecord *cdr_create(CDRManager *mgr, const char *session_id,
     cdr->lock_initialized = true;
   }
 
-  mgr->record_count++;
+  record_insert(mgr, cdr);
   mgr->total_cdrs_created++;
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
 
-  /* 保存到文件 */
-  cdr_save_to_file(mgr, cdr);
+  /* 持久化 (等待落盘) */
+  cdr_persist(mgr, cdr, true);
 
   fd_log_notice("[CDR] Created CDR: id=%u, uuid=%s, session=%s, client=%s",
                 cdr->cdr_id, cdr->cdr_uuid, cdr->session_id, cdr->client_id);
@@ -296,15 +568,15 @@ int cdr_close(CDRManager *mgr, CDRRecord *cdr, uint64_t final_bytes_in,
   cdr_lock(cdr);
 
   /* 更新最终流量 */
-  cdr->bytes_in = final_bytes_in;
-  cdr->bytes_out = final_bytes_out;
+  CDR_STORE(cdr->bytes_in, final_bytes_in);
+  CDR_STORE(cdr->bytes_out, final_bytes_out);
   cdr->stop_time = time(NULL);
   cdr->status = CDR_STATUS_FINISHED;
 
   cdr_unlock(cdr);
 
-  /* 保存并归档 */
-  cdr_save_to_file(mgr, cdr);
+  /* 保存并归档 (归档快照落盘时一并覆盖本条) */
+  cdr_persist(mgr, cdr, false);
   cdr_archive(mgr, cdr);
 
   fd_log_notice(
@@ -323,53 +595,58 @@ int cdr_rollover(CDRManager *mgr, const char *session_id,
 
   memset(result, 0, sizeof(CDRRolloverResult));
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_wrlock(&mgr->manager_lock);
 
   /* 1. 查找当前活跃的 CDR */
-  CDRRecord *old_cdr = NULL;
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && cdr->status == CDR_STATUS_ACTIVE &&
-        strcmp(cdr->session_id, session_id) == 0) {
-      old_cdr = cdr;
-      break;
-    }
-  }
-
+  CDRRecord *old_cdr = find_active_locked(mgr, session_id);
   if (!old_cdr) {
     result->error_code = -1;
     snprintf(result->error_message, sizeof(result->error_message),
              "No active CDR found for session: %s", session_id);
-    pthread_mutex_unlock(&mgr->manager_lock);
+    pthread_rwlock_unlock(&mgr->manager_lock);
+    return -1;
+  }
+
+  /* 2. 先分配新 CDR，失败时旧 CDR 保持不变 */
+  CDRRecord *new_cdr = record_alloc(mgr);
+  if (!new_cdr) {
+    result->error_code = -2;
+    snprintf(result->error_message, sizeof(result->error_message),
+             "No free CDR slot for new record");
+    pthread_rwlock_unlock(&mgr->manager_lock);
     return -1;
   }
 
   /* 锁定旧 CDR */
   cdr_lock(old_cdr);
 
-  /* 2. 计算旧 CDR 的最终流量 (考虑溢出) */
+  /* 3. 计算旧 CDR 的最终流量 (考虑溢出) */
   uint64_t actual_bytes_in = current_bytes_in;
   uint64_t actual_bytes_out = current_bytes_out;
+  uint64_t prev_in = __atomic_exchange_n(&old_cdr->last_bytes_in,
+                                         current_bytes_in, __ATOMIC_ACQ_REL);
+  uint64_t prev_out = __atomic_exchange_n(&old_cdr->last_bytes_out,
+                                          current_bytes_out, __ATOMIC_ACQ_REL);
 
   /* 检测溢出 */
-  if (cdr_detect_overflow(current_bytes_in, old_cdr->last_bytes_in)) {
-    old_cdr->overflow_count_in++;
-    fd_log_notice("[CDR] Overflow detected for bytes_in, count=%u",
-                  old_cdr->overflow_count_in);
+  if (cdr_detect_overflow(current_bytes_in, prev_in)) {
+    uint32_t n =
+        __atomic_add_fetch(&old_cdr->overflow_count_in, 1, __ATOMIC_RELAXED);
+    fd_log_notice("[CDR] Overflow detected for bytes_in, count=%u", n);
     /* 溢出时，使用最大值计算本次增量 */
-    actual_bytes_in = UINT64_MAX - old_cdr->last_bytes_in + current_bytes_in;
+    actual_bytes_in = UINT64_MAX - prev_in + current_bytes_in;
   }
 
-  if (cdr_detect_overflow(current_bytes_out, old_cdr->last_bytes_out)) {
-    old_cdr->overflow_count_out++;
-    fd_log_notice("[CDR] Overflow detected for bytes_out, count=%u",
-                  old_cdr->overflow_count_out);
-    actual_bytes_out = UINT64_MAX - old_cdr->last_bytes_out + current_bytes_out;
+  if (cdr_detect_overflow(current_bytes_out, prev_out)) {
+    uint32_t n =
+        __atomic_add_fetch(&old_cdr->overflow_count_out, 1, __ATOMIC_RELAXED);
+    fd_log_notice("[CDR] Overflow detected for bytes_out, count=%u", n);
+    actual_bytes_out = UINT64_MAX - prev_out + current_bytes_out;
   }
 
-  /* 3. 关闭旧 CDR */
-  old_cdr->bytes_in = actual_bytes_in;
-  old_cdr->bytes_out = actual_bytes_out;
+  /* 4. 关闭旧 CDR */
+  CDR_STORE(old_cdr->bytes_in, actual_bytes_in);
+  CDR_STORE(old_cdr->bytes_out, actual_bytes_out);
   old_cdr->stop_time = time(NULL);
   old_cdr->status = CDR_STATUS_ROLLOVER;
 
@@ -383,31 +660,7 @@ int cdr_rollover(CDRManager *mgr, const char *session_id,
 
   cdr_unlock(old_cdr);
 
-  /* 4. 创建新 CDR */
-  CDRRecord *new_cdr = NULL;
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    if (!mgr->records[i].in_use) {
-      new_cdr = &mgr->records[i];
-      break;
-    }
-  }
-
-  if (!new_cdr) {
-    result->error_code = -2;
-    snprintf(result->error_message, sizeof(result->error_message),
-             "No free CDR slot for new record");
-    pthread_mutex_unlock(&mgr->manager_lock);
-    /* 回滚: 恢复旧 CDR 状态 */
-    cdr_lock(old_cdr);
-    old_cdr->status = CDR_STATUS_ACTIVE;
-    old_cdr->stop_time = 0;
-    cdr_unlock(old_cdr);
-    return -1;
-  }
-
-  /* 初始化新 CDR */
-  memset(new_cdr, 0, sizeof(CDRRecord));
-
+  /* 5. 初始化新 CDR */
   new_cdr->cdr_id = mgr->next_cdr_id++;
   cdr_generate_uuid(new_cdr->cdr_uuid, sizeof(new_cdr->cdr_uuid));
 
@@ -433,7 +686,7 @@ int cdr_rollover(CDRManager *mgr, const char *session_id,
     new_cdr->lock_initialized = true;
   }
 
-  mgr->record_count++;
+  record_insert(mgr, new_cdr);
   mgr->total_cdrs_created++;
 
   result->new_cdr_id = new_cdr->cdr_id;
@@ -441,13 +694,13 @@ int cdr_rollover(CDRManager *mgr, const char *session_id,
           sizeof(result->new_cdr_uuid) - 1);
   result->success = true;
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
 
-  /* 5. 保存文件 */
-  cdr_save_to_file(mgr, old_cdr);
-  cdr_save_to_file(mgr, new_cdr);
+  /* 6. 保存 (与下一步归档快照一次落盘) */
+  cdr_persist(mgr, old_cdr, false);
+  cdr_persist(mgr, new_cdr, false);
 
-  /* 6. 归档旧 CDR */
+  /* 7. 归档旧 CDR */
   cdr_archive(mgr, old_cdr);
 
   fd_log_notice("[CDR] Rollover complete: old_id=%u -> new_id=%u, session=%s",
@@ -470,37 +723,22 @@ CDRRecord *cdr_find_by_session(CDRManager *mgr, const char *session_id) {
   if (!mgr || !session_id)
     return NULL;
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_rdlock(&mgr->manager_lock);
+  CDRRecord *cdr = find_active_locked(mgr, session_id);
+  pthread_rwlock_unlock(&mgr->manager_lock);
 
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && cdr->status == CDR_STATUS_ACTIVE &&
-        strcmp(cdr->session_id, session_id) == 0) {
-      pthread_mutex_unlock(&mgr->manager_lock);
-      return cdr;
-    }
-  }
-
-  pthread_mutex_unlock(&mgr->manager_lock);
-  return NULL;
+  return cdr;
 }
 
 CDRRecord *cdr_find_by_id(CDRManager *mgr, uint32_t cdr_id) {
   if (!mgr)
     return NULL;
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_rdlock(&mgr->manager_lock);
+  CDRRecord *cdr = find_id_locked(mgr, cdr_id);
+  pthread_rwlock_unlock(&mgr->manager_lock);
 
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && cdr->cdr_id == cdr_id) {
-      pthread_mutex_unlock(&mgr->manager_lock);
-      return cdr;
-    }
-  }
-
-  pthread_mutex_unlock(&mgr->manager_lock);
-  return NULL;
+  return cdr;
 }
 
 int cdr_find_by_client(CDRManager *mgr, const char *client_id,
@@ -510,16 +748,17 @@ int cdr_find_by_client(CDRManager *mgr, const char *client_id,
 
   int count = 0;
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_rdlock(&mgr->manager_lock);
 
-  for (int i = 0; i < MAX_CDR_RECORDS && count < max_count; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && strcmp(cdr->client_id, client_id) == 0) {
+  uint32_t b = magic_fnv1a32_str(client_id) & (mgr->num_buckets - 1);
+  for (CDRRecord *cdr = mgr->client_buckets[b]; cdr && count < max_count;
+       cdr = cdr->client_next) {
+    if (strcmp(cdr->client_id, client_id) == 0) {
       out_cdrs[count++] = cdr;
     }
   }
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
   return count;
 }
 
@@ -529,40 +768,60 @@ int cdr_find_by_client(CDRManager *mgr, const char *client_id,
 
 int cdr_update_traffic(CDRRecord *cdr, uint64_t bytes_in, uint64_t bytes_out,
                        uint64_t packets_in, uint64_t packets_out) {
-  if (!cdr || !cdr->in_use)
+  if (!cdr || !__atomic_load_n(&cdr->in_use, __ATOMIC_ACQUIRE))
     return -1;
 
-  cdr_lock(cdr);
-
   int overflow_detected = 0;
 
+  /* 交换出上次读数: 并发更新者各自与前一读数比较，回绕只被计一次 */
+  uint64_t prev_in =
+      __atomic_exchange_n(&cdr->last_bytes_in, bytes_in, __ATOMIC_ACQ_REL);
+  uint64_t prev_out =
+      __atomic_exchange_n(&cdr->last_bytes_out, bytes_out, __ATOMIC_ACQ_REL);
+
   /* 检测入站溢出 */
-  if (cdr_detect_overflow(bytes_in, cdr->last_bytes_in)) {
-    cdr->overflow_count_in++;
+  if (cdr_detect_overflow(bytes_in, prev_in)) {
+    __atomic_add_fetch(&cdr->overflow_count_in, 1, __ATOMIC_RELAXED);
     overflow_detected = 1;
     fd_log_notice("[CDR %u] Overflow detected: bytes_in wrapped", cdr->cdr_id);
   }
 
   /* 检测出站溢出 */
-  if (cdr_detect_overflow(bytes_out, cdr->last_bytes_out)) {
-    cdr->overflow_count_out++;
+  if (cdr_detect_overflow(bytes_out, prev_out)) {
+    __atomic_add_fetch(&cdr->overflow_count_out, 1, __ATOMIC_RELAXED);
     overflow_detected = 1;
     fd_log_notice("[CDR %u] Overflow detected: bytes_out wrapped", cdr->cdr_id);
   }
 
   /* 更新统计 */
-  cdr->bytes_in = bytes_in;
-  cdr->bytes_out = bytes_out;
-  cdr->packets_in = packets_in;
-  cdr->packets_out = packets_out;
-  cdr->last_bytes_in = bytes_in;
-  cdr->last_bytes_out = bytes_out;
-
-  cdr_unlock(cdr);
+  CDR_STORE(cdr->bytes_in, bytes_in);
+  CDR_STORE(cdr->bytes_out, bytes_out);
+  CDR_STORE(cdr->packets_in, packets_in);
+  CDR_STORE(cdr->packets_out, packets_out);
 
   return overflow_detected;
 }
 
+int cdr_update_session_traffic(CDRManager *mgr, const char *session_id,
+                               uint64_t bytes_in, uint64_t bytes_out,
+                               uint64_t packets_in, uint64_t packets_out) {
+  if (!mgr || !session_id)
+    return -1;
+
+  /* 读锁保证更新期间记录不被归档回收 */
+  pthread_rwlock_rdlock(&mgr->manager_lock);
+
+  int ret = -1;
+  CDRRecord *cdr = find_active_locked(mgr, session_id);
+  if (cdr) {
+    ret = cdr_update_traffic(cdr, bytes_in, bytes_out, packets_in,
+                             packets_out);
+  }
+
+  pthread_rwlock_unlock(&mgr->manager_lock);
+  return ret;
+}
+
 void cdr_get_actual_traffic(const CDRRecord *cdr, uint64_t *out_bytes_in,
                             uint64_t *out_bytes_out) {
   if (!cdr) {
@@ -573,30 +832,35 @@ void cdr_get_actual_traffic(const CDRRecord *cdr, uint64_t *out_bytes_in,
     return;
   }
 
+  uint64_t bytes_in = CDR_LOAD(cdr->bytes_in);
+  uint64_t bytes_out = CDR_LOAD(cdr->bytes_out);
+  uint32_t overflow_in = CDR_LOAD(cdr->overflow_count_in);
+  uint32_t overflow_out = CDR_LOAD(cdr->overflow_count_out);
+
   /* 实际流量 = 累计流量 - 基准偏移 (考虑溢出) */
   if (out_bytes_in) {
-    if (cdr->bytes_in >= cdr->base_offset_in) {
-      *out_bytes_in = cdr->bytes_in - cdr->base_offset_in;
+    if (bytes_in >= cdr->base_offset_in) {
+      *out_bytes_in = bytes_in - cdr->base_offset_in;
     } else {
       /* 溢出情况: 累计值比基准小，说明发生了回绕 */
-      *out_bytes_in = (UINT64_MAX - cdr->base_offset_in) + cdr->bytes_in + 1;
+      *out_bytes_in = (UINT64_MAX - cdr->base_offset_in) + bytes_in + 1;
     }
 
     /* 加上溢出次数对应的增量 */
-    if (cdr->overflow_count_in > 0) {
-      *out_bytes_in += (uint64_t)cdr->overflow_count_in * UINT64_MAX;
+    if (overflow_in > 0) {
+      *out_bytes_in += (uint64_t)overflow_in * UINT64_MAX;
     }
   }
 
   if (out_bytes_out) {
-    if (cdr->bytes_out >= cdr->base_offset_out) {
-      *out_bytes_out = cdr->bytes_out - cdr->base_offset_out;
+    if (bytes_out >= cdr->base_offset_out) {
+      *out_bytes_out = bytes_out - cdr->base_offset_out;
     } else {
-      *out_bytes_out = (UINT64_MAX - cdr->base_offset_out) + cdr->bytes_out + 1;
+      *out_bytes_out = (UINT64_MAX - cdr->base_offset_out) + bytes_out + 1;
     }
 
-    if (cdr->overflow_count_out > 0) {
-      *out_bytes_out += (uint64_t)cdr->overflow_count_out * UINT64_MAX;
+    if (overflow_out > 0) {
+      *out_bytes_out += (uint64_t)overflow_out * UINT64_MAX;
     }
   }
 }
@@ -854,52 +1118,46 @@ CDRRecord *cdr_load_from_file(CDRManager *mgr, const char *filepath) {
     return NULL;
   }
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  CDRRecord tmp;
+  memset(&tmp, 0, sizeof(tmp));
+  int rc = json_to_cdr(content, &tmp);
+  free(content);
 
-  /* 查找空闲槽位 */
-  CDRRecord *cdr = NULL;
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    if (!mgr->records[i].in_use) {
-      cdr = &mgr->records[i];
-      break;
-    }
+  /* 只加载活跃的 CDR */
+  if (rc != 0 || tmp.status != CDR_STATUS_ACTIVE) {
+    return NULL;
   }
 
-  if (!cdr) {
-    pthread_mutex_unlock(&mgr->manager_lock);
-    free(content);
+  pthread_rwlock_wrlock(&mgr->manager_lock);
+
+  /* 已由日志回放恢复 (迁移中断后重启) */
+  if (find_id_locked(mgr, tmp.cdr_id)) {
+    pthread_rwlock_unlock(&mgr->manager_lock);
     return NULL;
   }
 
-  if (json_to_cdr(content, cdr) != 0) {
-    pthread_mutex_unlock(&mgr->manager_lock);
-    free(content);
+  CDRRecord *cdr = record_alloc(mgr);
+  if (!cdr) {
+    pthread_rwlock_unlock(&mgr->manager_lock);
     return NULL;
   }
 
-  free(content);
-
-  /* 只加载活跃的 CDR */
-  if (cdr->status == CDR_STATUS_ACTIVE) {
-    cdr->in_use = true;
+  *cdr = tmp;
+  cdr->in_use = true;
 
-    /* 初始化锁 */
-    if (pthread_mutex_init(&cdr->lock, NULL) == 0) {
-      cdr->lock_initialized = true;
-    }
+  /* 初始化锁 */
+  if (pthread_mutex_init(&cdr->lock, NULL) == 0) {
+    cdr->lock_initialized = true;
+  }
 
-    mgr->record_count++;
+  record_insert(mgr, cdr);
 
-    /* 更新 next_cdr_id */
-    if (cdr->cdr_id >= mgr->next_cdr_id) {
-      mgr->next_cdr_id = cdr->cdr_id + 1;
-    }
-  } else {
-    memset(cdr, 0, sizeof(CDRRecord));
-    cdr = NULL;
+  /* 更新 next_cdr_id */
+  if (cdr->cdr_id >= mgr->next_cdr_id) {
+    mgr->next_cdr_id = cdr->cdr_id + 1;
   }
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
 
   return cdr;
 }
@@ -956,19 +1214,329 @@ int cdr_save_all_active(CDRManager *mgr) {
     return -1;
 
   int count = 0;
+  uint64_t last_seq = 0;
+
+  pthread_rwlock_rdlock(&mgr->manager_lock);
 
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && cdr->status == CDR_STATUS_ACTIVE) {
+  for (uint32_t c = 0; c < mgr->num_chunks; c++) {
+    for (uint32_t i = 0; i < CDR_CHUNK_RECORDS; i++) {
+      CDRRecord *cdr = &mgr->chunks[c][i];
+      if (!cdr->in_use || cdr->status != CDR_STATUS_ACTIVE) {
+        continue;
+      }
+      if (mgr->journal_enabled) {
+        CDRJournalEntry entry;
+        cdr_to_entry(cdr, &entry);
+        uint64_t seq = cdr_journal_append(&mgr->journal, &entry);
+        if (seq != 0) {
+          last_seq = seq;
+          count++;
+          continue;
+        }
+      }
       if (cdr_save_to_file(mgr, cdr) == 0) {
         count++;
       }
     }
   }
 
+  pthread_rwlock_unlock(&mgr->manager_lock);
+
+  /* 整批只等待一次落盘 */
+  if (last_seq != 0 && cdr_journal_sync(&mgr->journal, last_seq) != 0) {
+    fd_log_error("[CDR] Journal sync failed while saving active CDRs");
+    return -1;
+  }
+
   return count;
 }
 
+/*===========================================================================
+ * CDR 日志
+ *===========================================================================*/
+
+static void cdr_to_entry(const CDRRecord *cdr, CDRJournalEntry *entry) {
+  memset(entry, 0, sizeof(*entry));
+
+  entry->cdr_id = cdr->cdr_id;
+  entry->status = (int32_t)cdr->status;
+  entry->start_time = (int64_t)cdr->start_time;
+  entry->stop_time = (int64_t)cdr->stop_time;
+  entry->archive_time = (int64_t)cdr->archive_time;
+  entry->bytes_in = CDR_LOAD(cdr->bytes_in);
+  entry->bytes_out = CDR_LOAD(cdr->bytes_out);
+  entry->packets_in = CDR_LOAD(cdr->packets_in);
+  entry->packets_out = cdr->packets_out;
+  entry->base_offset_in = cdr->base_offset_in;
+  entry->base_offset_out = cdr->base_offset_out;
+  entry->last_bytes_in = CDR_LOAD(cdr->last_bytes_in);
+  entry->last_bytes_out = CDR_LOAD(cdr->last_bytes_out);
+  entry->overflow_count_in = CDR_LOAD(cdr->overflow_count_in);
+  entry->overflow_count_out = CDR_LOAD(cdr->overflow_count_out);
+  entry->bearer_id = cdr->bearer_id;
+
+  snprintf(entry->cdr_uuid, sizeof(entry->cdr_uuid), "%s", cdr->cdr_uuid);
+  snprintf(entry->session_id, sizeof(entry->session_id), "%s",
+           cdr->session_id);
+  snprintf(entry->client_id, sizeof(entry->client_id), "%s", cdr->client_id);
+  snprintf(entry->dlm_name, sizeof(entry->dlm_name), "%s", cdr->dlm_name);
+  entry->flags = cdr->exported ? CDR_JOURNAL_FLAG_EXPORTED : 0;
+}
+
+static void entry_to_cdr(const CDRJournalEntry *entry, CDRRecord *cdr) {
+  memset(cdr, 0, sizeof(CDRRecord));
+
+  cdr->cdr_id = entry->cdr_id;
+  cdr->status = (CDRStatus)entry->status;
+  cdr->start_time = (time_t)entry->start_time;
+  cdr->stop_time = (time_t)entry->stop_time;
+  cdr->archive_time = (time_t)entry->archive_time;
+  cdr->bytes_in = entry->bytes_in;
+  cdr->bytes_out = entry->bytes_out;
+  cdr->packets_in = entry->packets_in;
+  cdr->packets_out = entry->packets_out;
+  cdr->base_offset_in = entry->base_offset_in;
+  cdr->base_offset_out = entry->base_offset_out;
+  cdr->last_bytes_in = entry->last_bytes_in;
+  cdr->last_bytes_out = entry->last_bytes_out;
+  cdr->overflow_count_in = entry->overflow_count_in;
+  cdr->overflow_count_out = entry->overflow_count_out;
+  cdr->bearer_id = entry->bearer_id;
+  cdr->exported = (entry->flags & CDR_JOURNAL_FLAG_EXPORTED) != 0;
+
+  /* 日志中的字符串可能未以 NUL 结尾 (损坏/旧格式)，按长度截断 */
+  snprintf(cdr->cdr_uuid, sizeof(cdr->cdr_uuid), "%.*s",
+           (int)sizeof(entry->cdr_uuid), entry->cdr_uuid);
+  snprintf(cdr->session_id, sizeof(cdr->session_id), "%.*s",
+           (int)sizeof(entry->session_id), entry->session_id);
+  snprintf(cdr->client_id, sizeof(cdr->client_id), "%.*s",
+           (int)sizeof(entry->client_id), entry->client_id);
+  snprintf(cdr->dlm_name, sizeof(cdr->dlm_name), "%.*s",
+           (int)sizeof(entry->dlm_name), entry->dlm_name);
+}
+
+/**
+ * @brief 持久化一条 CDR 快照。
+ * @details 日志模式下追加到日志；durable 时等待落盘 (与并发操作共享
+ *          fsync)。日志追加或落盘失败时写 JSON 文件，保证不丢账单。
+ *
+ * @param mgr CDR 管理器指针。
+ * @param cdr CDR 记录指针。
+ * @param durable 是否等待落盘。
+ * @return int 成功返回 0，失败返回 -1。
+ */
+static int cdr_persist(CDRManager *mgr, const CDRRecord *cdr, bool durable) {
+  if (!mgr->journal_enabled) {
+    return cdr_save_to_file(mgr, cdr);
+  }
+
+  CDRJournalEntry entry;
+  cdr_to_entry(cdr, &entry);
+
+  uint64_t seq = cdr_journal_append(&mgr->journal, &entry);
+  if (seq != 0 && (!durable || cdr_journal_sync(&mgr->journal, seq) == 0)) {
+    return 0;
+  }
+
+  fd_log_error("[CDR] Journal write failed for CDR %u, falling back to JSON",
+               cdr->cdr_id);
+  return cdr_save_to_file(mgr, cdr);
+}
+
+/**
+ * @brief 补导出: 已关闭但尚未导出的 CDR (点查去重后导出)。
+ * @return 0=已导出 (或此前已导出), -1=失败
+ */
+static int export_closed(CDRManager *mgr, CDRRecord *cdr) {
+  char line[CDR_EXPORT_LINE_MAX];
+
+  if (cdr->archive_time == 0) {
+    cdr->archive_time = time(NULL);
+  }
+  if (cdr_export_lookup(&mgr->exporter, cdr->cdr_id, line, sizeof(line)) >=
+      0) {
+    return 0;
+  }
+  return cdr_export_append(&mgr->exporter, cdr, false);
+}
+
+/**
+ * @brief 日志回放回调: 恢复活跃 CDR，推进 next_cdr_id，补导出已关闭 CDR。
+ * @details 归档/已完成的 CDR 不占用内存槽位；其中未带导出标志的 (归档落盘
+ *          前崩溃，或旧版日志) 在此导出，并暂存带标志的 ARCHIVED 快照，
+ *          待日志打开后写回。
+ */
+static void journal_replay_cb(const CDRJournalEntry *entry, void *arg) {
+  ReplayContext *ctx = (ReplayContext *)arg;
+  CDRManager *mgr = ctx->mgr;
+
+  if (entry->cdr_id >= mgr->next_cdr_id) {
+    mgr->next_cdr_id = entry->cdr_id + 1;
+  }
+
+  if (entry->status != CDR_STATUS_ACTIVE) {
+    if (!mgr->export_enabled || (entry->flags & CDR_JOURNAL_FLAG_EXPORTED)) {
+      return;
+    }
+
+    CDRRecord tmp;
+    entry_to_cdr(entry, &tmp);
+    if (export_closed(mgr, &tmp) != 0) {
+      return;
+    }
+    ctx->exported++;
+
+    /* 超出上限的记录下次启动再处理 (点查去重，不会重复导出) */
+    if (ctx->num_pending == ctx->cap_pending &&
+        ctx->cap_pending < CDR_REPLAY_EXPORT_MAX) {
+      uint32_t cap = ctx->cap_pending ? ctx->cap_pending * 2 : 64;
+      CDRJournalEntry *p = realloc(ctx->pending, cap * sizeof(*p));
+      if (p) {
+        ctx->pending = p;
+        ctx->cap_pending = cap;
+      }
+    }
+    if (ctx->num_pending < ctx->cap_pending) {
+      tmp.status = CDR_STATUS_ARCHIVED;
+      tmp.exported = true;
+      cdr_to_entry(&tmp, &ctx->pending[ctx->num_pending++]);
+    }
+    return;
+  }
+
+  /* 初始化阶段单线程回放，无需加锁 */
+  CDRRecord *cdr = record_alloc(mgr);
+  if (!cdr) {
+    fd_log_error("[CDR] No free slot to restore active CDR %u",
+                 entry->cdr_id);
+    return;
+  }
+
+  entry_to_cdr(entry, cdr);
+  cdr->in_use = true;
+  if (pthread_mutex_init(&cdr->lock, NULL) == 0) {
+    cdr->lock_initialized = true;
+  }
+  record_insert(mgr, cdr);
+}
+
+/**
+ * @brief 把 active 目录中的旧版 JSON 记录导入日志。
+ * @details 导入并落盘成功后才删除 JSON 文件，且只删除已在内存中恢复的
+ *          CDR 对应的文件；迁移中断时重启会再次导入，已由日志恢复的 CDR
+ *          被跳过。
+ *
+ * @param mgr CDR 管理器指针。
+ * @return int 导入的记录数。
+ */
+static int migrate_legacy_files(CDRManager *mgr) {
+  int migrated = cdr_load_all_active(mgr);
+  if (migrated < 0) {
+    return 0;
+  }
+
+  if (migrated > 0 && cdr_save_all_active(mgr) < 0) {
+    fd_log_error("[CDR] Legacy CDR migration not committed, keeping JSON "
+                 "files");
+    return 0;
+  }
+
+  DIR *dir = opendir(mgr->active_dir);
+  if (dir) {
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+      unsigned int cdr_id;
+      if (strncmp(ent->d_name, "cdr_", 4) != 0 ||
+          strstr(ent->d_name, ".json") == NULL ||
+          sscanf(ent->d_name, "cdr_%u_", &cdr_id) != 1 ||
+          !cdr_find_by_id(mgr, cdr_id)) {
+        continue;
+      }
+
+      char filepath[MAX_CDR_PATH_LEN];
+      snprintf(filepath, sizeof(filepath), "%s/%s", mgr->active_dir,
+               ent->d_name);
+      unlink(filepath);
+    }
+    closedir(dir);
+  }
+
+  return migrated;
+}
+
+/**
+ * @brief 把 archive 目录中的旧版单条 JSON 归档导出到分段文件。
+ * @details 每 CDR_MIGRATE_BATCH 个文件落盘一次导出分段后再删除这一批
+ *          JSON 文件；中断后重启会再次处理剩余文件，已导出的 CDR 经点查
+ *          去重。
+ *
+ * @param mgr CDR 管理器指针。
+ * @return int 导出的记录数。
+ */
+static int migrate_legacy_archives(CDRManager *mgr) {
+  if (!mgr->export_enabled) {
+    return 0;
+  }
+
+  DIR *dir = opendir(mgr->archive_dir);
+  if (!dir) {
+    return 0;
+  }
+
+  char(*batch)[MAX_CDR_PATH_LEN] = malloc(CDR_MIGRATE_BATCH * sizeof(*batch));
+  if (!batch) {
+    closedir(dir);
+    return 0;
+  }
+
+  int migrated = 0;
+  int n = 0;
+  struct dirent *ent;
+
+  for (;;) {
+    ent = readdir(dir);
+    if (ent && (strncmp(ent->d_name, "cdr_", 4) != 0 ||
+                strstr(ent->d_name, ".json") == NULL)) {
+      continue;
+    }
+
+    if (ent) {
+      snprintf(batch[n], MAX_CDR_PATH_LEN, "%s/%s", mgr->archive_dir,
+               ent->d_name);
+
+      char *content = read_file_content(batch[n]);
+      CDRRecord tmp;
+      memset(&tmp, 0, sizeof(tmp));
+      if (!content || json_to_cdr(content, &tmp) != 0 ||
+          export_closed(mgr, &tmp) != 0) {
+        free(content);
+        continue;
+      }
+      free(content);
+      n++;
+      migrated++;
+    }
+
+    /* 一批导出落盘后才删除对应的 JSON 文件 */
+    if (n == CDR_MIGRATE_BATCH || (!ent && n > 0)) {
+      if (cdr_export_sync(&mgr->exporter) == 0) {
+        for (int i = 0; i < n; i++) {
+          unlink(batch[i]);
+        }
+      }
+      n = 0;
+    }
+
+    if (!ent) {
+      break;
+    }
+  }
+
+  closedir(dir);
+  free(batch);
+  return migrated;
+}
+
 /*===========================================================================
  * 归档和清理
  *===========================================================================*/
@@ -978,8 +1546,8 @@ int cdr_save_all_active(CDRManager *mgr) {
  * @details
  *          1. 验证 CDR 不再处于 ACTIVE 状态。
  *          2. 将其在 active 目录下的旧文件删除。
- *          3. 设置状态为 ARCHIVED 并更新归档时间。
- *          4. 保存到 archive 目录。
+ *          3. 追加到当前导出分段并设置状态为 ARCHIVED。
+ *          4. 持久化归档快照 (导出不可用时保存到 archive 目录)。
  *          5. 释放内存资源 (互斥锁)。
  *
  * @param mgr CDR 管理器指针。
@@ -996,54 +1564,51 @@ int cdr_archive(CDRManager *mgr, CDRRecord *cdr) {
 
   cdr_lock(cdr);
 
-  /* 从 active 目录删除旧文件 */
-  char old_path[MAX_CDR_PATH_LEN];
-  snprintf(old_path, sizeof(old_path), "%s/cdr_%u_%s.json", mgr->active_dir,
-           cdr->cdr_id, cdr->cdr_uuid);
-  unlink(old_path);
+  /* 从 active 目录删除旧文件 (JSON 存储模式) */
+  if (!mgr->journal_enabled) {
+    char old_path[MAX_CDR_PATH_LEN];
+    snprintf(old_path, sizeof(old_path), "%s/cdr_%u_%s.json", mgr->active_dir,
+             cdr->cdr_id, cdr->cdr_uuid);
+    unlink(old_path);
+  }
+
+  /* 导出到计费分段 (此时 status 仍为 FINISHED/ROLLOVER)；
+   * 没有日志时导出文件是唯一的归档记录，需等待落盘 */
+  cdr->archive_time = time(NULL);
+  if (mgr->export_enabled &&
+      cdr_export_append(&mgr->exporter, cdr, !mgr->journal_enabled) == 0) {
+    cdr->exported = true;
+  }
 
   /* 更新状态 */
   cdr->status = CDR_STATUS_ARCHIVED;
-  cdr->archive_time = time(NULL);
 
   cdr_unlock(cdr);
 
-  /* 保存到 archive 目录 */
-  cdr_save_to_file(mgr, cdr);
+  /* 持久化归档状态 (等待落盘)；JSON 模式下已导出的不再写单条归档文件 */
+  if (mgr->journal_enabled || !cdr->exported) {
+    cdr_persist(mgr, cdr, true);
+  }
 
   /* 释放内存槽位 */
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_wrlock(&mgr->manager_lock);
 
-  if (cdr->lock_initialized) {
-    pthread_mutex_destroy(&cdr->lock);
-  }
-
-  memset(cdr, 0, sizeof(CDRRecord));
-  mgr->record_count--;
+  record_release(mgr, cdr);
   mgr->total_cdrs_archived++;
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
 
   return 0;
 }
 
 /**
- * @brief 清理过期的归档 CDR。
- * @details 遍历 archive 目录，删除修改时间早于 retention_sec 的 .json 文件。
- *
- * @param mgr CDR 管理器指针。
- * @return int 删除的文件数量，失败返回 -1。
+ * @brief 删除 archive 目录中过期的单条 JSON 归档 (导出不可用时)。
  */
-int cdr_cleanup_expired(CDRManager *mgr) {
-  if (!mgr)
-    return -1;
-
+static int cleanup_legacy_archives(CDRManager *mgr, time_t cutoff) {
   DIR *dir = opendir(mgr->archive_dir);
   if (!dir)
     return 0;
 
-  time_t now = time(NULL);
-  time_t cutoff = now - mgr->retention_sec;
   int deleted = 0;
 
   struct dirent *entry;
@@ -1069,12 +1634,41 @@ int cdr_cleanup_expired(CDRManager *mgr) {
   }
 
   closedir(dir);
+  return deleted;
+}
+
+/**
+ * @brief 清理过期的归档 CDR。
+ * @details 整文件删除关闭时间早于 retention_sec 的导出分段；导出不可用时
+ *          遍历 archive 目录删除过期的单条 .json 文件。
+ *
+ * @param mgr CDR 管理器指针。
+ * @return int 删除的归档 CDR 数量，失败返回 -1。
+ */
+int cdr_cleanup_expired(CDRManager *mgr) {
+  if (!mgr)
+    return -1;
+
+  time_t now = time(NULL);
+  time_t cutoff = now - mgr->retention_sec;
+  int deleted;
+
+  if (mgr->export_enabled) {
+    deleted = cdr_export_expire(&mgr->exporter, cutoff);
+  } else {
+    deleted = cleanup_legacy_archives(mgr, cutoff);
+  }
 
   if (deleted > 0) {
     mgr->total_cdrs_deleted += deleted;
     fd_log_notice("[CDR] Cleaned up %d expired CDR archives", deleted);
   }
 
+  /* 日志中的过期归档记录由后台压缩丢弃 */
+  if (mgr->journal_enabled) {
+    cdr_journal_request_compact(&mgr->journal, cutoff);
+  }
+
   return deleted;
 }
 
@@ -1147,16 +1741,17 @@ int cdr_lock_session(CDRManager *mgr, const char *session_id) {
   if (!mgr || !session_id)
     return -1;
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_rdlock(&mgr->manager_lock);
 
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && strcmp(cdr->session_id, session_id) == 0) {
+  uint32_t b = magic_fnv1a32_str(session_id) & (mgr->num_buckets - 1);
+  for (CDRRecord *cdr = mgr->session_buckets[b]; cdr;
+       cdr = cdr->session_next) {
+    if (strcmp(cdr->session_id, session_id) == 0) {
       cdr_lock(cdr);
     }
   }
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
   return 0;
 }
 
@@ -1170,16 +1765,17 @@ int cdr_unlock_session(CDRManager *mgr, const char *session_id) {
   if (!mgr || !session_id)
     return -1;
 
-  pthread_mutex_lock(&mgr->manager_lock);
+  pthread_rwlock_rdlock(&mgr->manager_lock);
 
-  for (int i = 0; i < MAX_CDR_RECORDS; i++) {
-    CDRRecord *cdr = &mgr->records[i];
-    if (cdr->in_use && strcmp(cdr->session_id, session_id) == 0) {
+  uint32_t b = magic_fnv1a32_str(session_id) & (mgr->num_buckets - 1);
+  for (CDRRecord *cdr = mgr->session_buckets[b]; cdr;
+       cdr = cdr->session_next) {
+    if (strcmp(cdr->session_id, session_id) == 0) {
       cdr_unlock(cdr);
     }
   }
 
-  pthread_mutex_unlock(&mgr->manager_lock);
+  pthread_rwlock_unlock(&mgr->manager_lock);
   return 0;
 }
 
@@ -1226,8 +1822,9 @@ void cdr_manager_print_status(const CDRManager *mgr) {
   fd_log_notice("[CDR] CDR Manager Status:");
   fd_log_notice("  Initialized: %s", mgr->is_initialized ? "yes" : "no");
   fd_log_notice("  Base dir: %s", mgr->base_dir);
-  fd_log_notice("  Active records: %u / %d", mgr->record_count,
-                MAX_CDR_RECORDS);
+  fd_log_notice("  Active records: %u / %u (max %d, index buckets %u)",
+                mgr->record_count, mgr->num_chunks * CDR_CHUNK_RECORDS,
+                MAX_CDR_RECORDS, mgr->num_buckets);
   fd_log_notice("  Next CDR ID: %u", mgr->next_cdr_id);
   fd_log_notice("  Retention: %u seconds (%u hours)", mgr->retention_sec,
                 mgr->retention_sec / 3600);
@@ -1235,4 +1832,21 @@ void cdr_manager_print_status(const CDRManager *mgr) {
                 (unsigned long)mgr->total_cdrs_created,
                 (unsigned long)mgr->total_cdrs_archived,
                 (unsigned long)mgr->total_cdrs_deleted);
+  if (mgr->journal_enabled) {
+    fd_log_notice("  Journal: %s, size=%lu bytes, records=%lu, syncs=%lu, "
+                  "compactions=%lu, dropped=%lu",
+                  mgr->journal.path, (unsigned long)mgr->journal.file_size,
+                  (unsigned long)mgr->journal.total_records,
+                  (unsigned long)mgr->journal.total_syncs,
+                  (unsigned long)mgr->journal.total_compactions,
+                  (unsigned long)mgr->journal.total_dropped);
+  }
+  if (mgr->export_enabled) {
+    fd_log_notice("  Export: %s, segments=%u, records=%lu, rotations=%lu, "
+                  "errors=%lu",
+                  mgr->exporter.dir, mgr->exporter.num_segments,
+                  (unsigned long)mgr->exporter.total_records,
+                  (unsigned long)mgr->exporter.total_rotations,
+                  (unsigned long)mgr->exporter.total_errors);
+  }
 }
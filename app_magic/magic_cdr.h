@@ -6,10 +6,13 @@
  *
  * 核心功能:
  * 1. CDR 生命周期管理 (创建/关闭/切分)
- * 2. JSON 格式文件存储
- * 3. CDR 级别互斥锁 (并发保护)
- * 4. 自动归档和清理 (默认保留1天)
+ * 2. 追加式二进制日志存储 (组提交 fsync、后台压缩、启动快速回放)；
+ *    日志不可用时回退到每条 CDR 一个 JSON 文件
+ * 3. CDR 级别互斥锁 (并发保护)；流量计数器为原子变量，更新无需加锁
+ * 4. 归档 CDR 流式导出到轮转的 JSON Lines / CSV 分段文件 (带 cdr_id 索引)，
+ *    按分段整文件清理 (默认保留1天)
  * 5. 流量计数器溢出检测
+ * 6. 按 cdr_id / session_id / client_id 的哈希索引，容量按块动态增长
  *
  * 设计原则:
  * - Snapshot (快照) -> Archive (归档旧的) -> Create (创建新的)
@@ -30,11 +33,17 @@
 #include <time.h>
 #include <pthread.h>
 
+#include "magic_cdr_export.h"
+#include "magic_cdr_journal.h"
+
 /*===========================================================================
  * 常量定义
  *===========================================================================*/
 
-#define MAX_CDR_RECORDS         1024    ///< 最大活跃 CDR 数量
+#define CDR_CHUNK_RECORDS       256     ///< 每次扩容分配的记录数
+#define CDR_MAX_CHUNKS          1024    ///< 记录块数上限
+#define MAX_CDR_RECORDS         (CDR_CHUNK_RECORDS * CDR_MAX_CHUNKS) ///< 内存中 CDR 数量上限
+#define CDR_INDEX_MIN_BUCKETS   1024    ///< 哈希索引初始桶数 (2 的幂, 按需倍增)
 #define MAX_CDR_ID_LEN          64      ///< CDR ID 最大长度
 #define MAX_CDR_SESSION_ID_LEN  128     ///< 会话 ID 最大长度
 #define MAX_CDR_CLIENT_ID_LEN   64      ///< 客户端 ID 最大长度
@@ -74,8 +83,10 @@ typedef enum {
 /**
  * @brief CDR 记录结构体
  * @details 存储单个计费数据记录的完整信息，包括标识、状态、时间和流量统计。
+ *          流量与溢出字段以 __atomic 内建函数读写；记录内存在管理器生命
+ *          周期内不会释放，指针始终有效。
  */
-typedef struct {
+typedef struct CDRRecord {
     /* 标识信息 */
     uint32_t        cdr_id;                         ///< CDR 唯一标识符 (数字ID)
     char            cdr_uuid[MAX_CDR_ID_LEN];       ///< CDR UUID 字符串
@@ -110,10 +121,16 @@ typedef struct {
     /* 链路信息 */
     char            dlm_name[64];                   ///< 使用的 DLM 名称
     uint8_t         bearer_id;                      ///< Bearer ID
+    bool            exported;                       ///< 已写入计费导出文件
     
     /* 并发控制 */
     pthread_mutex_t lock;                           ///< CDR 级别互斥锁
     bool            lock_initialized;               ///< 锁是否已初始化
+    
+    /* 索引链 (由管理器维护) */
+    struct CDRRecord *id_next;                      ///< cdr_id 哈希链 / 空闲链
+    struct CDRRecord *session_next;                 ///< session_id 哈希链
+    struct CDRRecord *client_next;                  ///< client_id 哈希链
 } CDRRecord;
 
 /*===========================================================================
@@ -123,13 +140,23 @@ typedef struct {
 /**
  * @brief CDR 管理器上下文结构体
  * @details 管理系统中所有活跃和归档的 CDR 记录。
+ *          记录按 CDR_CHUNK_RECORDS 成块分配 (地址稳定)，释放的记录进入空闲链；
+ *          三个哈希索引的桶数在记录数超过桶数时倍增。
  */
 typedef struct {
-    CDRRecord       records[MAX_CDR_RECORDS];       ///< CDR 记录数组
+    CDRRecord      *chunks[CDR_MAX_CHUNKS];         ///< CDR 记录块
+    uint32_t        num_chunks;                     ///< 已分配块数
+    CDRRecord      *free_list;                      ///< 空闲记录链 (经 id_next)
     uint32_t        record_count;                   ///< 活跃记录数量
     uint32_t        next_cdr_id;                    ///< 下一个可用 CDR ID
     
-    pthread_mutex_t manager_lock;                   ///< 管理器级别锁
+    /* 哈希索引 (持写锁修改) */
+    CDRRecord     **id_buckets;                     ///< cdr_id 索引
+    CDRRecord     **session_buckets;                ///< session_id 索引
+    CDRRecord     **client_buckets;                 ///< client_id 索引
+    uint32_t        num_buckets;                    ///< 每个索引的桶数 (2 的幂)
+    
+    pthread_rwlock_t manager_lock;                  ///< 管理器级别锁 (查找共享, 增删独占)
     bool            is_initialized;                 ///< 是否已初始化
     
     /* 存储路径 */
@@ -137,6 +164,14 @@ typedef struct {
     char            active_dir[MAX_CDR_PATH_LEN];   ///< 活跃 CDR 目录
     char            archive_dir[MAX_CDR_PATH_LEN];  ///< 归档目录
     
+    /* 追加式日志 */
+    CDRJournal      journal;                        ///< CDR 日志
+    bool            journal_enabled;                ///< 日志可用 (否则使用 JSON 文件)
+    
+    /* 计费导出 (归档目录下的轮转分段文件) */
+    CDRExporter     exporter;                       ///< 流式导出器
+    bool            export_enabled;                 ///< 导出可用 (否则每条归档一个 JSON 文件)
+    
     /* 归档策略 */
     uint32_t        retention_sec;                  ///< 归档保留时间 (秒)
     time_t          last_cleanup_time;              ///< 上次清理时间
@@ -177,7 +212,10 @@ typedef struct {
 
 /**
  * @brief 初始化 CDR 管理器
- * @details 创建必要的目录结构，加载活跃 CDR 记录。
+ * @details 创建必要的目录结构，打开导出器与 CDR 日志并回放活跃 CDR 记录；
+ *          active 目录中旧版 JSON 文件会被导入日志后删除，archive 目录中
+ *          旧版单条 JSON 归档会被导出到分段文件后删除。日志中已关闭但
+ *          尚未导出的 CDR (崩溃窗口或旧版日志) 在此补导出。
  * @param mgr CDR 管理器指针
  * @param base_dir 基础存储目录 (NULL=使用默认目录)
  * @param retention_sec 归档保留时间 (0=使用默认值)
@@ -282,6 +320,7 @@ int cdr_find_by_client(CDRManager *mgr,
 /**
  * @brief 更新 CDR 流量统计 (带溢出检测)
  * @details 更新字节和包计数，并检测 uint64 计数器是否发生回绕。
+ *          无锁: 以原子交换取得上次字节数，每次回绕只计一次。
  * @param cdr CDR 记录指针
  * @param bytes_in 当前入站字节数
  * @param bytes_out 当前出站字节数
@@ -295,6 +334,25 @@ int cdr_update_traffic(CDRRecord *cdr,
                        uint64_t packets_in,
                        uint64_t packets_out);
 
+/**
+ * @brief 按会话更新活跃 CDR 的流量统计
+ * @details 持管理器读锁完成查找与原子更新，期间记录不会被归档复用；
+ *          适合周期性批量更新。
+ * @param mgr CDR 管理器指针
+ * @param session_id 会话 ID
+ * @param bytes_in 当前入站字节数
+ * @param bytes_out 当前出站字节数
+ * @param packets_in 当前入站数据包数
+ * @param packets_out 当前出站数据包数
+ * @return int 0=正常, 1=检测到溢出, -1=未找到活跃 CDR
+ */
+int cdr_update_session_traffic(CDRManager *mgr,
+                               const char *session_id,
+                               uint64_t bytes_in,
+                               uint64_t bytes_out,
+                               uint64_t packets_in,
+                               uint64_t packets_out);
+
 /**
  * @brief 计算 CDR 的实际流量 (减去基准偏移)
  * @details 用于获取自 CDR 创建或切分以来的增量流量。
@@ -312,6 +370,7 @@ void cdr_get_actual_traffic(const CDRRecord *cdr,
 
 /**
  * @brief 保存 CDR 到文件 (JSON 格式)
+ * @details 日志不可用或写入失败时的回退存储，也可用于单条导出。
  * @param mgr CDR 管理器指针
  * @param cdr CDR 记录指针
  * @return int 0=成功, -1=失败
@@ -336,7 +395,8 @@ int cdr_load_all_active(CDRManager *mgr);
 
 /**
  * @brief 保存所有活跃 CDR
- * @details 周期性或关机前保存所有内存中的 CDR 记录。
+ * @details 周期性或关机前保存所有内存中的 CDR 记录 (日志模式下为一批
+ *          追加 + 一次 fsync)。
  * @param mgr CDR 管理器指针
  * @return int 保存的 CDR 数量, -1=失败
  */
@@ -348,7 +408,8 @@ int cdr_save_all_active(CDRManager *mgr);
 
 /**
  * @brief 归档已完成的 CDR
- * @details 将已关闭的 CDR 移动到归档目录。
+ * @details 将已关闭的 CDR 追加到当前导出分段并释放内存槽位；
+ *          导出不可用时写入归档目录下的单条 JSON 文件。
  * @param mgr CDR 管理器指针
  * @param cdr CDR 记录指针
  * @return int 0=成功, -1=失败
@@ -357,9 +418,10 @@ int cdr_archive(CDRManager *mgr, CDRRecord *cdr);
 
 /**
  * @brief 清理过期的归档 CDR
- * @details 删除超过保留时间的归档文件。
+ * @details 整文件删除关闭时间超过保留期的导出分段 (导出不可用时删除过期的
+ *          单条 JSON 文件)，并请求日志后台压缩 (丢弃过期归档记录)。
  * @param mgr CDR 管理器指针
- * @return int 删除的文件数量, -1=失败
+ * @return int 删除的归档 CDR 数量, -1=失败
  */
 int cdr_cleanup_expired(CDRManager *mgr);
 
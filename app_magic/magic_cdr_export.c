@@ -0,0 +1,1021 @@
+/**
+ * @file magic_cdr_export.c
+ * @brief MAGIC CDR 流式导出实现
+ * @description 每条 CDR 格式化为一行后直接 write 追加到当前分段 (进程崩溃
+ * 不丢已导出的行)；轮转时 fdatasync 数据文件，先写排序好的 .idx 再把
+ * .part 重命名为正式文件名，因此正式分段总有完整索引。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_cdr_export.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <freeDiameter/extension.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "magic_cdr.h"
+
+/*===========================================================================
+ * 文件格式
+ *===========================================================================*/
+
+/**
+ * @brief 索引文件头 (主机字节序)，其后为 count 个 CDRExportIndexEntry。
+ */
+typedef struct {
+  uint32_t magic;      ///< CDR_EXPORT_INDEX_MAGIC。
+  uint32_t count;      ///< 索引项数。
+  uint32_t min_id;     ///< 最小 cdr_id。
+  uint32_t max_id;     ///< 最大 cdr_id。
+  int64_t closed_time; ///< 分段关闭时间。
+} ExportIndexHeader;
+
+#define PART_SUFFIX ".part"
+#define INDEX_SUFFIX ".idx"
+#define RECOVER_CHUNK 65536 /* 恢复 .part 时的读取块大小 */
+
+static const char CSV_HEADER[] =
+    "cdr_id,cdr_uuid,session_id,client_id,dlm_name,bearer_id,status,"
+    "start_time,stop_time,archive_time,duration,usage_bytes_in,"
+    "usage_bytes_out,bytes_in,bytes_out,packets_in,packets_out,"
+    "base_offset_in,base_offset_out,overflow_count_in,overflow_count_out\n";
+
+static const char *format_ext(CDRExportFormat format) {
+  return format == CDR_EXPORT_CSV ? ".csv" : ".jsonl";
+}
+
+/*===========================================================================
+ * 行格式化
+ *===========================================================================*/
+
+/**
+ * @brief 追加 JSON 字符串 (含引号与转义)。
+ */
+static size_t put_json_string(char *buf, size_t pos, size_t size,
+                              const char *s) {
+  if (pos < size) {
+    buf[pos] = '"';
+  }
+  pos++;
+
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    char esc[8];
+    size_t n;
+
+    if (c == '"' || c == '\\') {
+      esc[0] = '\\';
+      esc[1] = (char)c;
+      n = 2;
+    } else if (c < 0x20) {
+      n = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", c);
+    } else {
+      esc[0] = (char)c;
+      n = 1;
+    }
+
+    for (size_t i = 0; i < n; i++, pos++) {
+      if (pos < size) {
+        buf[pos] = esc[i];
+      }
+    }
+  }
+
+  if (pos < size) {
+    buf[pos] = '"';
+  }
+  return pos + 1;
+}
+
+/**
+ * @brief 追加 CSV 字段 (含逗号、引号或换行时加引号，引号加倍)。
+ */
+static size_t put_csv_string(char *buf, size_t pos, size_t size,
+                             const char *s) {
+  bool quote = strpbrk(s, ",\"\r\n") != NULL;
+
+  if (quote && pos < size) {
+    buf[pos] = '"';
+  }
+  pos += quote;
+
+  for (; *s; s++) {
+    if (*s == '"') {
+      if (pos < size) {
+        buf[pos] = '"';
+      }
+      pos++;
+    }
+    if (pos < size) {
+      buf[pos] = *s;
+    }
+    pos++;
+  }
+
+  if (quote && pos < size) {
+    buf[pos] = '"';
+  }
+  return pos + quote;
+}
+
+static size_t put_fmt(char *buf, size_t pos, size_t size, const char *fmt,
+                      ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(pos < size ? buf + pos : NULL, pos < size ? size - pos : 0,
+                    fmt, ap);
+  va_end(ap);
+  return pos + (n > 0 ? (size_t)n : 0);
+}
+
+/**
+ * @brief 把 CDR 格式化为一行 (含换行)。
+ * @return 行长度, 超出缓冲区时返回 0
+ */
+static size_t format_line(CDRExportFormat format, const CDRRecord *cdr,
+                          char *buf, size_t size) {
+  uint64_t usage_in, usage_out;
+  cdr_get_actual_traffic(cdr, &usage_in, &usage_out);
+
+  long duration = cdr->stop_time > cdr->start_time
+                      ? (long)(cdr->stop_time - cdr->start_time)
+                      : 0;
+  size_t pos = 0;
+
+  if (format == CDR_EXPORT_CSV) {
+    pos = put_fmt(buf, pos, size, "%u,", cdr->cdr_id);
+    pos = put_csv_string(buf, pos, size, cdr->cdr_uuid);
+    pos = put_fmt(buf, pos, size, ",");
+    pos = put_csv_string(buf, pos, size, cdr->session_id);
+    pos = put_fmt(buf, pos, size, ",");
+    pos = put_csv_string(buf, pos, size, cdr->client_id);
+    pos = put_fmt(buf, pos, size, ",");
+    pos = put_csv_string(buf, pos, size, cdr->dlm_name);
+    pos = put_fmt(buf, pos, size,
+                  ",%u,%s,%ld,%ld,%ld,%ld,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,"
+                  "%u,%u\n",
+                  cdr->bearer_id, cdr_status_name(cdr->status),
+                  (long)cdr->start_time, (long)cdr->stop_time,
+                  (long)cdr->archive_time, duration, (unsigned long)usage_in,
+                  (unsigned long)usage_out, (unsigned long)cdr->bytes_in,
+                  (unsigned long)cdr->bytes_out,
+                  (unsigned long)cdr->packets_in,
+                  (unsigned long)cdr->packets_out,
+                  (unsigned long)cdr->base_offset_in,
+                  (unsigned long)cdr->base_offset_out, cdr->overflow_count_in,
+                  cdr->overflow_count_out);
+  } else {
+    pos = put_fmt(buf, pos, size, "{\"cdr_id\":%u,\"cdr_uuid\":", cdr->cdr_id);
+    pos = put_json_string(buf, pos, size, cdr->cdr_uuid);
+    pos = put_fmt(buf, pos, size, ",\"session_id\":");
+    pos = put_json_string(buf, pos, size, cdr->session_id);
+    pos = put_fmt(buf, pos, size, ",\"client_id\":");
+    pos = put_json_string(buf, pos, size, cdr->client_id);
+    pos = put_fmt(buf, pos, size, ",\"dlm_name\":");
+    pos = put_json_string(buf, pos, size, cdr->dlm_name);
+    pos = put_fmt(
+        buf, pos, size,
+        ",\"bearer_id\":%u,\"status\":\"%s\",\"start_time\":%ld,"
+        "\"stop_time\":%ld,\"archive_time\":%ld,\"duration\":%ld,"
+        "\"usage_bytes_in\":%lu,\"usage_bytes_out\":%lu,\"bytes_in\":%lu,"
+        "\"bytes_out\":%lu,\"packets_in\":%lu,\"packets_out\":%lu,"
+        "\"base_offset_in\":%lu,\"base_offset_out\":%lu,"
+        "\"overflow_count_in\":%u,\"overflow_count_out\":%u}\n",
+        cdr->bearer_id, cdr_status_name(cdr->status), (long)cdr->start_time,
+        (long)cdr->stop_time, (long)cdr->archive_time, duration,
+        (unsigned long)usage_in, (unsigned long)usage_out,
+        (unsigned long)cdr->bytes_in, (unsigned long)cdr->bytes_out,
+        (unsigned long)cdr->packets_in, (unsigned long)cdr->packets_out,
+        (unsigned long)cdr->base_offset_in,
+        (unsigned long)cdr->base_offset_out, cdr->overflow_count_in,
+        cdr->overflow_count_out);
+  }
+
+  return pos < size ? pos : 0;
+}
+
+/**
+ * @brief 解析行首的 cdr_id (两种格式的首字段都是 cdr_id)。
+ * @return 0=成功, -1=不是数据行 (如 CSV 列名行)
+ */
+static int parse_line_id(const char *line, size_t len, uint32_t *id) {
+  static const char json_prefix[] = "{\"cdr_id\":";
+  size_t i = 0;
+
+  if (len > 0 && line[0] == '{') {
+    if (len < sizeof(json_prefix) - 1 ||
+        memcmp(line, json_prefix, sizeof(json_prefix) - 1) != 0) {
+      return -1;
+    }
+    i = sizeof(json_prefix) - 1;
+  }
+
+  if (i >= len || line[i] < '0' || line[i] > '9') {
+    return -1;
+  }
+
+  uint64_t v = 0;
+  while (i < len && line[i] >= '0' && line[i] <= '9' && v <= UINT32_MAX) {
+    v = v * 10 + (uint64_t)(line[i++] - '0');
+  }
+  if (v > UINT32_MAX) {
+    return -1;
+  }
+
+  *id = (uint32_t)v;
+  return 0;
+}
+
+/*===========================================================================
+ * 文件辅助
+ *===========================================================================*/
+
+static int write_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int read_at(int fd, void *buf, size_t len, uint64_t off) {
+  char *p = (char *)buf;
+  while (len > 0) {
+    ssize_t n = pread(fd, p, len, (off_t)off);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+    off += (uint64_t)n;
+  }
+  return 0;
+}
+
+static void fsync_dir(const char *dir) {
+  int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dfd >= 0) {
+    fsync(dfd);
+    close(dfd);
+  }
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+  size_t n = strlen(name), m = strlen(suffix);
+  return n > m && strcmp(name + n - m, suffix) == 0;
+}
+
+/* 按 cdr_id 排序，同一 ID 保持写入先后 (偏移升序) */
+static int entry_cmp(const void *a, const void *b) {
+  const CDRExportIndexEntry *x = a, *y = b;
+  if (x->cdr_id != y->cdr_id) {
+    return x->cdr_id < y->cdr_id ? -1 : 1;
+  }
+  return x->offset < y->offset ? -1 : (x->offset > y->offset);
+}
+
+static int segment_cmp(const void *a, const void *b) {
+  const CDRExportSegment *x = a, *y = b;
+  if (x->closed_time != y->closed_time) {
+    return x->closed_time < y->closed_time ? -1 : 1;
+  }
+  return strcmp(x->name, y->name);
+}
+
+/*===========================================================================
+ * 分段管理
+ *===========================================================================*/
+
+static int segments_push(CDRExporter *exp, const CDRExportSegment *seg) {
+  if (exp->num_segments == exp->cap_segments) {
+    uint32_t cap = exp->cap_segments ? exp->cap_segments * 2 : 64;
+    CDRExportSegment *p =
+        realloc(exp->segments, (size_t)cap * sizeof(CDRExportSegment));
+    if (!p) {
+      return -1;
+    }
+    exp->segments = p;
+    exp->cap_segments = cap;
+  }
+  exp->segments[exp->num_segments++] = *seg;
+  return 0;
+}
+
+/**
+ * @brief 排序索引项并写入 <name>.idx (先写临时文件再 rename)。
+ * @param[out] seg 填写分段的 ID 范围与记录数
+ */
+static int write_index(const char *dir, const char *name,
+                       CDRExportIndexEntry *entries, uint32_t count,
+                       time_t closed_time, CDRExportSegment *seg) {
+  qsort(entries, count, sizeof(CDRExportIndexEntry), entry_cmp);
+
+  ExportIndexHeader hdr = {
+      .magic = CDR_EXPORT_INDEX_MAGIC,
+      .count = count,
+      .min_id = count ? entries[0].cdr_id : 0,
+      .max_id = count ? entries[count - 1].cdr_id : 0,
+      .closed_time = (int64_t)closed_time,
+  };
+
+  char tmp[512], path[512];
+  snprintf(tmp, sizeof(tmp), "%s/%s%s.tmp", dir, name, INDEX_SUFFIX);
+  snprintf(path, sizeof(path), "%s/%s%s", dir, name, INDEX_SUFFIX);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (write_all(fd, (const char *)&hdr, sizeof(hdr)) != 0 ||
+      write_all(fd, (const char *)entries,
+                (size_t)count * sizeof(CDRExportIndexEntry)) != 0 ||
+      fdatasync(fd) != 0) {
+    close(fd);
+    unlink(tmp);
+    return -1;
+  }
+  close(fd);
+
+  if (rename(tmp, path) != 0) {
+    unlink(tmp);
+    return -1;
+  }
+
+  memset(seg, 0, sizeof(*seg));
+  snprintf(seg->name, sizeof(seg->name), "%s", name);
+  seg->min_id = hdr.min_id;
+  seg->max_id = hdr.max_id;
+  seg->records = count;
+  seg->closed_time = closed_time;
+  return 0;
+}
+
+/**
+ * @brief 打开新的当前分段 (<name>.part)。
+ * @note 调用者持有 exp->lock。
+ */
+static int segment_open(CDRExporter *exp) {
+  time_t now = time(NULL);
+  struct tm tm;
+  char stamp[32];
+  gmtime_r(&now, &tm);
+  strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+  for (int attempt = 0; attempt < 64; attempt++) {
+    snprintf(exp->name, sizeof(exp->name), "cdr-%s-%04u%s", stamp,
+             exp->file_seq++ % 10000, format_ext(exp->format));
+
+    /* 同一秒内重启时序号从 0 开始，跳过已存在的正式分段 */
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", exp->dir, exp->name);
+    if (access(path, F_OK) == 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s/%s%s", exp->dir, exp->name, PART_SUFFIX);
+
+    /* O_RDWR: 点查时直接 pread 当前分段 */
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      if (errno == EEXIST) {
+        continue;
+      }
+      fd_log_error("[CDR] Cannot create export segment %s: %s", path,
+                   strerror(errno));
+      return -1;
+    }
+
+    exp->offset = 0;
+    if (exp->format == CDR_EXPORT_CSV) {
+      if (write_all(fd, CSV_HEADER, sizeof(CSV_HEADER) - 1) != 0) {
+        close(fd);
+        unlink(path);
+        return -1;
+      }
+      exp->offset = sizeof(CSV_HEADER) - 1;
+    }
+
+    fsync_dir(exp->dir);
+    exp->fd = fd;
+    exp->opened_time = now;
+    exp->num_entries = 0;
+    return 0;
+  }
+
+  return -1;
+}
+
+/**
+ * @brief 关闭当前分段: 落盘、写索引、去掉 .part 后缀。
+ * @note 调用者持有 exp->lock。
+ */
+static void segment_finalize(CDRExporter *exp) {
+  if (exp->fd < 0) {
+    return;
+  }
+
+  char part[512], path[512];
+  snprintf(part, sizeof(part), "%s/%s%s", exp->dir, exp->name, PART_SUFFIX);
+  snprintf(path, sizeof(path), "%s/%s", exp->dir, exp->name);
+
+  fdatasync(exp->fd);
+  close(exp->fd);
+  exp->fd = -1;
+
+  if (exp->num_entries == 0) {
+    unlink(part);
+    return;
+  }
+
+  CDRExportSegment seg;
+  if (write_index(exp->dir, exp->name, exp->entries, exp->num_entries,
+                  time(NULL), &seg) != 0 ||
+      rename(part, path) != 0) {
+    /* 保留 .part，下次启动时恢复 */
+    fd_log_error("[CDR] Failed to finalize export segment %s: %s", exp->name,
+                 strerror(errno));
+    exp->total_errors++;
+    exp->num_entries = 0;
+    return;
+  }
+  fsync_dir(exp->dir);
+
+  if (segments_push(exp, &seg) != 0) {
+    fd_log_error("[CDR] Export segment table full, %s not tracked", exp->name);
+  }
+
+  exp->num_entries = 0;
+  exp->total_rotations++;
+
+  fd_log_debug("[CDR] Export segment closed: %s (%u records, %lu bytes)",
+               seg.name, seg.records, (unsigned long)exp->offset);
+}
+
+/**
+ * @brief 恢复遗留的 .part 分段: 截去残行、扫描重建索引、重命名。
+ */
+static void recover_part(CDRExporter *exp, const char *part_name) {
+  char name[64], part[512], path[512];
+  size_t n = strlen(part_name) - strlen(PART_SUFFIX);
+  if (n >= sizeof(name)) {
+    return;
+  }
+  memcpy(name, part_name, n);
+  name[n] = '\0';
+
+  snprintf(part, sizeof(part), "%s/%s", exp->dir, part_name);
+  snprintf(path, sizeof(path), "%s/%s", exp->dir, name);
+
+  int fd = open(part, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  char *chunk = malloc(RECOVER_CHUNK + CDR_EXPORT_LINE_MAX);
+  CDRExportIndexEntry *entries = NULL;
+  uint32_t count = 0, cap = 0;
+  uint64_t line_start = 0, off = 0;
+  size_t carry = 0;
+  bool ok = chunk && fstat(fd, &st) == 0;
+
+  /* 逐块读取，按换行切分；carry 为跨块的未完成行 */
+  while (ok) {
+    ssize_t r = pread(fd, chunk + carry, RECOVER_CHUNK, (off_t)off);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      break;
+    }
+    off += (uint64_t)r;
+
+    size_t avail = carry + (size_t)r, begin = 0;
+    for (size_t i = 0; i < avail; i++) {
+      if (chunk[i] != '\n') {
+        continue;
+      }
+      uint32_t id;
+      size_t len = i + 1 - begin;
+      if (parse_line_id(chunk + begin, len, &id) == 0 &&
+          count < CDR_EXPORT_MAX_RECORDS) {
+        if (count == cap) {
+          cap = cap ? cap * 2 : 1024;
+          CDRExportIndexEntry *p = realloc(entries, cap * sizeof(*p));
+          if (!p) {
+            ok = false;
+            break;
+          }
+          entries = p;
+        }
+        entries[count].cdr_id = id;
+        entries[count].len = (uint32_t)len;
+        entries[count].offset = line_start;
+        count++;
+      }
+      line_start += len;
+      begin = i + 1;
+    }
+
+    carry = avail - begin;
+    if (carry > CDR_EXPORT_LINE_MAX) {
+      break; /* 超长残行，从行首截断 */
+    }
+    memmove(chunk, chunk + begin, carry);
+  }
+
+  if (ok && line_start < (uint64_t)st.st_size &&
+      ftruncate(fd, (off_t)line_start) != 0) {
+    ok = false;
+  }
+  if (ok) {
+    fdatasync(fd);
+  }
+  close(fd);
+  free(chunk);
+
+  CDRExportSegment seg;
+  if (!ok) {
+    fd_log_error("[CDR] Cannot recover export segment %s", part_name);
+  } else if (count == 0) {
+    unlink(part);
+  } else if (write_index(exp->dir, name, entries, count, st.st_mtime, &seg) ==
+                 0 &&
+             rename(part, path) == 0) {
+    segments_push(exp, &seg);
+    fd_log_notice("[CDR] Recovered export segment %s (%u records)", name,
+                  count);
+  }
+
+  free(entries);
+}
+
+/**
+ * @brief 从 .idx 文件头加载一个已关闭分段。
+ */
+static void load_segment(CDRExporter *exp, const char *idx_name) {
+  char name[64], path[512];
+  size_t n = strlen(idx_name) - strlen(INDEX_SUFFIX);
+  if (n >= sizeof(name)) {
+    return;
+  }
+  memcpy(name, idx_name, n);
+  name[n] = '\0';
+
+  snprintf(path, sizeof(path), "%s/%s", exp->dir, name);
+  if (access(path, F_OK) != 0) {
+    /* 数据文件已被删除 (保留期清理中断) */
+    snprintf(path, sizeof(path), "%s/%s", exp->dir, idx_name);
+    unlink(path);
+    return;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", exp->dir, idx_name);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  ExportIndexHeader hdr;
+  if (read_at(fd, &hdr, sizeof(hdr), 0) == 0 &&
+      hdr.magic == CDR_EXPORT_INDEX_MAGIC) {
+    CDRExportSegment seg;
+    memset(&seg, 0, sizeof(seg));
+    snprintf(seg.name, sizeof(seg.name), "%s", name);
+    seg.min_id = hdr.min_id;
+    seg.max_id = hdr.max_id;
+    seg.records = hdr.count;
+    seg.closed_time = (time_t)hdr.closed_time;
+    segments_push(exp, &seg);
+  } else {
+    fd_log_error("[CDR] Invalid export index: %s", path);
+  }
+  close(fd);
+}
+
+/**
+ * @brief 在分段索引中二分查找 cdr_id 最新一行。
+ * @return 0=找到, -1=未找到
+ */
+static int segment_find(const CDRExporter *exp, const CDRExportSegment *seg,
+                        uint32_t cdr_id, CDRExportIndexEntry *out) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s%s", exp->dir, seg->name, INDEX_SUFFIX);
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  /* 查找第一个 cdr_id 大于目标的位置 (上界)，其前一项即最新匹配 */
+  uint32_t lo = 0, hi = seg->records;
+  int found = -1;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    CDRExportIndexEntry e;
+    if (read_at(fd, &e, sizeof(e),
+                sizeof(ExportIndexHeader) + (uint64_t)mid * sizeof(e)) != 0) {
+      hi = lo;
+      break;
+    }
+    if (e.cdr_id <= cdr_id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo > 0 &&
+      read_at(fd, out, sizeof(*out),
+              sizeof(ExportIndexHeader) + (uint64_t)(lo - 1) * sizeof(*out)) ==
+          0 &&
+      out->cdr_id == cdr_id) {
+    found = 0;
+  }
+
+  close(fd);
+  return found;
+}
+
+static int read_line(const char *path, int fd, const CDRExportIndexEntry *e,
+                     char *buf, size_t buf_size) {
+  int own = -1;
+  if (fd < 0) {
+    fd = own = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return -1;
+    }
+  }
+
+  size_t len = e->len > 0 ? e->len - 1 : 0; /* 去掉换行 */
+  if (len >= buf_size) {
+    len = buf_size - 1;
+  }
+
+  int ret = read_at(fd, buf, len, e->offset) == 0 ? (int)len : -1;
+  if (ret >= 0) {
+    buf[len] = '\0';
+  }
+
+  if (own >= 0) {
+    close(own);
+  }
+  return ret;
+}
+
+/**
+ * @brief 等待 seq 之前写入的行全部落盘 (组提交)。
+ * @details 没有线程在落盘时由本线程发起: 记下当前最后写入的行号，复制
+ *          文件描述符后释放锁执行 fdatasync，一次覆盖期间已写入的全部行；
+ *          落盘期间到达的追加等待下一轮。分段在落盘期间被轮转时，复制的
+ *          描述符保证仍对原文件落盘。
+ * @note 调用者持有 exp->lock，返回时仍持有。
+ * @return 0=成功, -1=seq 所在批次落盘失败。
+ */
+static int export_sync_wait(CDRExporter *exp, uint64_t seq) {
+  while (exp->sync_seq < seq) {
+    if (exp->syncing) {
+      pthread_cond_wait(&exp->sync_cond, &exp->lock);
+      continue;
+    }
+
+    uint64_t lo = exp->sync_seq + 1;
+    uint64_t target = exp->write_seq;
+    /* 分段已关闭时 segment_finalize 已落盘，无需再做 */
+    int fd = exp->fd >= 0 ? dup(exp->fd) : -1;
+    int ret = 0;
+
+    exp->syncing = true;
+    pthread_mutex_unlock(&exp->lock);
+    if (fd >= 0) {
+      ret = fdatasync(fd);
+      if (ret != 0) {
+        fd_log_error("[CDR] Export sync failed: %s", strerror(errno));
+      }
+      close(fd);
+    }
+    pthread_mutex_lock(&exp->lock);
+
+    if (ret != 0) {
+      uint32_t slot = exp->error_count % CDR_EXPORT_ERROR_RANGES;
+      if (exp->error_count >= CDR_EXPORT_ERROR_RANGES) {
+        exp->error_horizon = exp->error_hi[slot];
+      }
+      exp->error_lo[slot] = lo;
+      exp->error_hi[slot] = target;
+      exp->error_count++;
+      exp->total_errors++;
+    }
+    exp->sync_seq = target;
+    exp->syncing = false;
+    pthread_cond_broadcast(&exp->sync_cond);
+  }
+
+  if (seq <= exp->error_horizon) {
+    return -1;
+  }
+  uint32_t n = exp->error_count < CDR_EXPORT_ERROR_RANGES
+                   ? exp->error_count
+                   : CDR_EXPORT_ERROR_RANGES;
+  for (uint32_t i = 0; i < n; i++) {
+    if (seq >= exp->error_lo[i] && seq <= exp->error_hi[i]) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*===========================================================================
+ * 公共 API
+ *===========================================================================*/
+
+int cdr_export_open(CDRExporter *exp, const char *dir, CDRExportFormat format) {
+  if (!exp || !dir) {
+    return -1;
+  }
+
+  memset(exp, 0, sizeof(*exp));
+  exp->fd = -1;
+  exp->format = format;
+  exp->rotate_bytes = CDR_EXPORT_ROTATE_BYTES;
+  exp->rotate_sec = CDR_EXPORT_ROTATE_SEC;
+  snprintf(exp->dir, sizeof(exp->dir), "%s", dir);
+
+  DIR *d = opendir(dir);
+  if (!d) {
+    fd_log_error("[CDR] Cannot open export directory %s: %s", dir,
+                 strerror(errno));
+    return -1;
+  }
+
+  /* 第一遍: 恢复遗留 .part；第二遍: 加载分段表 (含刚恢复的之外的全部) */
+  struct dirent *ent;
+  while ((ent = readdir(d)) != NULL) {
+    if (strncmp(ent->d_name, "cdr-", 4) == 0 &&
+        has_suffix(ent->d_name, PART_SUFFIX)) {
+      recover_part(exp, ent->d_name);
+    }
+  }
+
+  uint32_t recovered = exp->num_segments;
+  rewinddir(d);
+  while ((ent = readdir(d)) != NULL) {
+    if (strncmp(ent->d_name, "cdr-", 4) != 0 ||
+        !has_suffix(ent->d_name, INDEX_SUFFIX)) {
+      continue;
+    }
+
+    bool known = false;
+    for (uint32_t i = 0; i < recovered && !known; i++) {
+      size_t n = strlen(exp->segments[i].name);
+      known = strncmp(ent->d_name, exp->segments[i].name, n) == 0 &&
+              strcmp(ent->d_name + n, INDEX_SUFFIX) == 0;
+    }
+    if (!known) {
+      load_segment(exp, ent->d_name);
+    }
+  }
+  closedir(d);
+
+  qsort(exp->segments, exp->num_segments, sizeof(CDRExportSegment),
+        segment_cmp);
+
+  pthread_mutex_init(&exp->lock, NULL);
+  pthread_cond_init(&exp->sync_cond, NULL);
+  exp->is_open = true;
+
+  fd_log_notice("[CDR] Export ready: %s (%s, %u segments)", dir,
+                format_ext(format) + 1, exp->num_segments);
+  return 0;
+}
+
+void cdr_export_close(CDRExporter *exp) {
+  if (!exp || !exp->is_open) {
+    return;
+  }
+
+  pthread_mutex_lock(&exp->lock);
+  while (exp->syncing) {
+    pthread_cond_wait(&exp->sync_cond, &exp->lock);
+  }
+  segment_finalize(exp);
+  exp->is_open = false;
+  free(exp->entries);
+  exp->entries = NULL;
+  exp->cap_entries = 0;
+  free(exp->segments);
+  exp->segments = NULL;
+  exp->num_segments = exp->cap_segments = 0;
+  pthread_mutex_unlock(&exp->lock);
+
+  pthread_cond_destroy(&exp->sync_cond);
+  pthread_mutex_destroy(&exp->lock);
+
+  fd_log_notice("[CDR] Export closed: records=%lu, rotations=%lu, errors=%lu",
+                (unsigned long)exp->total_records,
+                (unsigned long)exp->total_rotations,
+                (unsigned long)exp->total_errors);
+}
+
+void cdr_export_configure(CDRExporter *exp, CDRExportFormat format,
+                          uint64_t rotate_bytes, uint32_t rotate_sec) {
+  if (!exp || !exp->is_open) {
+    return;
+  }
+
+  pthread_mutex_lock(&exp->lock);
+  if (format != exp->format) {
+    segment_finalize(exp);
+    exp->format = format;
+  }
+  exp->rotate_bytes = rotate_bytes ? rotate_bytes : CDR_EXPORT_ROTATE_BYTES;
+  exp->rotate_sec = rotate_sec ? rotate_sec : CDR_EXPORT_ROTATE_SEC;
+  pthread_mutex_unlock(&exp->lock);
+}
+
+int cdr_export_append(CDRExporter *exp, const CDRRecord *cdr, bool durable) {
+  if (!exp || !exp->is_open || !cdr) {
+    return -1;
+  }
+
+  char line[CDR_EXPORT_LINE_MAX];
+  time_t now = time(NULL);
+  int ret = -1;
+
+  pthread_mutex_lock(&exp->lock);
+
+  size_t len = format_line(exp->format, cdr, line, sizeof(line));
+  if (len == 0) {
+    fd_log_error("[CDR] CDR %u too long for export line", cdr->cdr_id);
+    goto out;
+  }
+
+  /* 轮转: 大小 / 时长 / 条数任一超限 */
+  if (exp->fd >= 0 && exp->num_entries > 0 &&
+      (exp->offset + len > exp->rotate_bytes ||
+       now - exp->opened_time >= (time_t)exp->rotate_sec ||
+       exp->num_entries >= CDR_EXPORT_MAX_RECORDS)) {
+    segment_finalize(exp);
+  }
+
+  if (exp->fd < 0 && segment_open(exp) != 0) {
+    exp->total_errors++;
+    goto out;
+  }
+
+  if (exp->num_entries == exp->cap_entries) {
+    uint32_t cap = exp->cap_entries ? exp->cap_entries * 2 : 4096;
+    CDRExportIndexEntry *p =
+        realloc(exp->entries, (size_t)cap * sizeof(CDRExportIndexEntry));
+    if (!p) {
+      exp->total_errors++;
+      goto out;
+    }
+    exp->entries = p;
+    exp->cap_entries = cap;
+  }
+
+  if (write_all(exp->fd, line, len) != 0) {
+    fd_log_error("[CDR] Export write failed (%s): %s", exp->name,
+                 strerror(errno));
+    /* 去掉可能写入的半行，保持分段按行完整 */
+    if (ftruncate(exp->fd, (off_t)exp->offset) != 0) {
+      segment_finalize(exp);
+    }
+    exp->total_errors++;
+    goto out;
+  }
+
+  CDRExportIndexEntry *e = &exp->entries[exp->num_entries++];
+  e->cdr_id = cdr->cdr_id;
+  e->len = (uint32_t)len;
+  e->offset = exp->offset;
+  exp->offset += len;
+  exp->total_records++;
+  uint64_t seq = ++exp->write_seq;
+
+  ret = durable ? export_sync_wait(exp, seq) : 0;
+
+out:
+  pthread_mutex_unlock(&exp->lock);
+  return ret;
+}
+
+int cdr_export_sync(CDRExporter *exp) {
+  if (!exp || !exp->is_open) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&exp->lock);
+  int ret = export_sync_wait(exp, exp->write_seq);
+  pthread_mutex_unlock(&exp->lock);
+  return ret;
+}
+
+void cdr_export_tick(CDRExporter *exp) {
+  if (!exp || !exp->is_open) {
+    return;
+  }
+
+  pthread_mutex_lock(&exp->lock);
+  if (exp->fd >= 0 &&
+      time(NULL) - exp->opened_time >= (time_t)exp->rotate_sec) {
+    segment_finalize(exp);
+  }
+  pthread_mutex_unlock(&exp->lock);
+}
+
+int cdr_export_expire(CDRExporter *exp, time_t cutoff) {
+  if (!exp || !exp->is_open) {
+    return -1;
+  }
+
+  int deleted = 0;
+  uint32_t kept = 0;
+
+  pthread_mutex_lock(&exp->lock);
+
+  for (uint32_t i = 0; i < exp->num_segments; i++) {
+    CDRExportSegment *seg = &exp->segments[i];
+    if (seg->closed_time >= cutoff) {
+      exp->segments[kept++] = *seg;
+      continue;
+    }
+
+    /* 先删数据文件: 中断时残留的 .idx 在下次打开时清理 */
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", exp->dir, seg->name);
+    if (unlink(path) != 0 && errno != ENOENT) {
+      exp->segments[kept++] = *seg;
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s/%s%s", exp->dir, seg->name, INDEX_SUFFIX);
+    unlink(path);
+
+    deleted += (int)seg->records;
+    fd_log_debug("[CDR] Deleted expired export segment: %s", seg->name);
+  }
+  exp->num_segments = kept;
+
+  pthread_mutex_unlock(&exp->lock);
+  return deleted;
+}
+
+int cdr_export_lookup(CDRExporter *exp, uint32_t cdr_id, char *buf,
+                      size_t buf_size) {
+  if (!exp || !exp->is_open || !buf || buf_size == 0) {
+    return -1;
+  }
+
+  int ret = -1;
+
+  pthread_mutex_lock(&exp->lock);
+
+  /* 当前分段: 内存索引，从后向前取最新 */
+  if (exp->fd >= 0) {
+    for (uint32_t i = exp->num_entries; i > 0; i--) {
+      if (exp->entries[i - 1].cdr_id == cdr_id) {
+        ret = read_line(NULL, exp->fd, &exp->entries[i - 1], buf, buf_size);
+        goto out;
+      }
+    }
+  }
+
+  /* 已关闭分段: 从新到旧，按 ID 范围过滤 */
+  for (uint32_t i = exp->num_segments; i > 0; i--) {
+    const CDRExportSegment *seg = &exp->segments[i - 1];
+    CDRExportIndexEntry e;
+    if (cdr_id < seg->min_id || cdr_id > seg->max_id ||
+        segment_find(exp, seg, cdr_id, &e) != 0) {
+      continue;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", exp->dir, seg->name);
+    ret = read_line(path, -1, &e, buf, buf_size);
+    goto out;
+  }
+
+out:
+  pthread_mutex_unlock(&exp->lock);
+  return ret;
+}
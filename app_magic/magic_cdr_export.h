@@ -0,0 +1,185 @@
+/**
+ * @file magic_cdr_export.h
+ * @brief MAGIC CDR 流式导出 (计费话单文件)
+ * @details 已关闭的 CDR 逐条追加到当前分段文件，按大小/时间/条数轮转，
+ *          替代"每条归档 CDR 一个 JSON 文件":
+ *
+ * - 格式: JSON Lines (每行一个对象) 或 CSV (首行为列名)；每行首字段为 cdr_id
+ * - 分段: 写入中的文件名带 .part 后缀，轮转时 fdatasync 后去掉后缀，
+ *   计费侧只需拉取不带 .part 的文件
+ * - 索引: 每个分段生成 <分段名>.idx (按 cdr_id 排序的 {cdr_id, 长度, 偏移})，
+ *   点查按分段的 cdr_id 范围过滤后二分查找，无需扫描数据文件
+ * - 保留: 按分段关闭时间整文件删除，不再遍历单条记录文件
+ * - 内存: 只有当前分段的索引常驻内存，上限 CDR_EXPORT_MAX_RECORDS 条
+ * - 恢复: 启动时遗留的 .part 文件截去残行、重建索引后转为正式分段
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_CDR_EXPORT_H
+#define MAGIC_CDR_EXPORT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define CDR_EXPORT_ROTATE_BYTES (64u * 1024 * 1024) /* 默认分段大小上限 */
+#define CDR_EXPORT_ROTATE_SEC 3600                  /* 默认分段时长上限 */
+#define CDR_EXPORT_MAX_RECORDS 262144 /* 单个分段的记录数上限 (索引内存上界) */
+#define CDR_EXPORT_TICK_MS 1000       /* 轮转检查周期 (cdr_export_tick) */
+#define CDR_EXPORT_ERROR_RANGES 4     /* 记住的落盘失败区间数 */
+#define CDR_EXPORT_LINE_MAX 2048      /* 单行上限 */
+#define CDR_EXPORT_INDEX_MAGIC 0x58524443u /* 索引文件魔数 ("CDRX") */
+
+struct CDRRecord;
+
+/**
+ * @brief 导出格式。
+ */
+typedef enum {
+  CDR_EXPORT_JSONL = 0, ///< JSON Lines (.jsonl)。
+  CDR_EXPORT_CSV = 1,   ///< CSV (.csv)。
+} CDRExportFormat;
+
+/**
+ * @brief 索引项 (索引文件与内存中当前分段共用)。
+ */
+typedef struct {
+  uint32_t cdr_id; ///< CDR ID。
+  uint32_t len;    ///< 行长度 (含换行)。
+  uint64_t offset; ///< 行在数据文件中的偏移。
+} CDRExportIndexEntry;
+
+/**
+ * @brief 已关闭的分段。
+ */
+typedef struct {
+  char name[64];       ///< 数据文件名 (不含目录)。
+  uint32_t min_id;     ///< 最小 cdr_id。
+  uint32_t max_id;     ///< 最大 cdr_id。
+  uint32_t records;    ///< 记录数。
+  time_t closed_time;  ///< 关闭时间 (保留期判断依据)。
+} CDRExportSegment;
+
+/**
+ * @brief 导出器上下文。
+ */
+typedef struct {
+  char dir[256];          ///< 输出目录。
+  CDRExportFormat format; ///< 当前格式。
+  uint64_t rotate_bytes;  ///< 分段大小上限。
+  uint32_t rotate_sec;    ///< 分段时长上限。
+
+  /* 当前分段 (fd<0 表示尚未打开，首条记录到达时创建) */
+  int fd;                         ///< 数据文件描述符。
+  char name[64];                  ///< 数据文件名 (不含 .part)。
+  uint64_t offset;                ///< 已写入字节数。
+  time_t opened_time;             ///< 打开时间。
+  CDRExportIndexEntry *entries;   ///< 当前分段索引 (追加顺序)。
+  uint32_t num_entries;           ///< 索引项数。
+  uint32_t cap_entries;           ///< 索引容量。
+  uint32_t file_seq;              ///< 文件名序号 (同一秒内区分)。
+
+  /* 已关闭分段 (按关闭顺序) */
+  CDRExportSegment *segments; ///< 分段表。
+  uint32_t num_segments;      ///< 分段数。
+  uint32_t cap_segments;      ///< 分段表容量。
+
+  /* 组提交: 行按写入顺序编号，一次 fdatasync 覆盖此前写入的全部行 */
+  uint64_t write_seq;  ///< 最后写入的行序号。
+  uint64_t sync_seq;   ///< 已完成落盘的行序号。
+  bool syncing;        ///< 是否有线程正在 (不持锁) fdatasync。
+  pthread_cond_t sync_cond; ///< 落盘完成通知。
+  uint64_t error_lo[CDR_EXPORT_ERROR_RANGES]; ///< 落盘失败区间起点。
+  uint64_t error_hi[CDR_EXPORT_ERROR_RANGES]; ///< 落盘失败区间终点。
+  uint32_t error_count;   ///< 累计失败区间数。
+  uint64_t error_horizon; ///< 被挤出的最新失败区间终点 (此前保守视为失败)。
+
+  /* 统计 */
+  uint64_t total_records;  ///< 导出的记录数。
+  uint64_t total_rotations; ///< 轮转次数。
+  uint64_t total_errors;   ///< 写入失败次数。
+
+  pthread_mutex_t lock; ///< 保护以上全部字段。
+  bool is_open;         ///< 是否已打开。
+} CDRExporter;
+
+/**
+ * @brief 打开导出器。
+ * @details 恢复目录中遗留的 .part 分段，并从 .idx 文件加载已关闭分段表。
+ *
+ * @param exp 导出器
+ * @param dir 输出目录 (须已存在)
+ * @param format 导出格式
+ * @return 0=成功, -1=失败
+ */
+int cdr_export_open(CDRExporter *exp, const char *dir, CDRExportFormat format);
+
+/**
+ * @brief 关闭当前分段 (轮转) 并释放导出器。
+ * @param exp 导出器
+ */
+void cdr_export_close(CDRExporter *exp);
+
+/**
+ * @brief 设置轮转策略。
+ * @details 格式变化时立即轮转当前分段；大小/时长在下一次写入时生效。
+ *
+ * @param exp 导出器
+ * @param format 导出格式
+ * @param rotate_bytes 分段大小上限 (0=默认值)
+ * @param rotate_sec 分段时长上限 (0=默认值)
+ */
+void cdr_export_configure(CDRExporter *exp, CDRExportFormat format,
+                          uint64_t rotate_bytes, uint32_t rotate_sec);
+
+/**
+ * @brief 导出一条已关闭的 CDR。
+ * @param exp 导出器
+ * @param cdr CDR 记录 (调用者保证期间不被修改)
+ * @param durable 是否在返回前落盘；fdatasync 不持 exp->lock，并发的持久化
+ *        追加共用一次 (组提交)
+ * @return 0=成功, -1=失败
+ */
+int cdr_export_append(CDRExporter *exp, const struct CDRRecord *cdr,
+                      bool durable);
+
+/**
+ * @brief 把当前分段已写入的行落盘。
+ * @param exp 导出器
+ * @return 0=成功, -1=失败
+ */
+int cdr_export_sync(CDRExporter *exp);
+
+/**
+ * @brief 按时长检查当前分段是否需要轮转 (周期调用)。
+ * @param exp 导出器
+ */
+void cdr_export_tick(CDRExporter *exp);
+
+/**
+ * @brief 删除关闭时间早于 cutoff 的分段 (数据文件与索引)。
+ * @param exp 导出器
+ * @param cutoff 截止时间
+ * @return 删除的记录数 (>=0), -1=失败
+ */
+int cdr_export_expire(CDRExporter *exp, time_t cutoff);
+
+/**
+ * @brief 按 cdr_id 点查已导出的行。
+ * @details 先查当前分段，再按 cdr_id 范围筛选已关闭分段并二分查找其索引；
+ *          同一 cdr_id 导出过多次时返回最新的一行。
+ *
+ * @param exp 导出器
+ * @param cdr_id CDR ID
+ * @param buf 输出缓冲区 (行内容，去掉换行并以 0 结尾)
+ * @param buf_size 缓冲区大小
+ * @return 行长度 (>=0), -1=未找到或读取失败
+ */
+int cdr_export_lookup(CDRExporter *exp, uint32_t cdr_id, char *buf,
+                      size_t buf_size);
+
+#endif /* MAGIC_CDR_EXPORT_H */
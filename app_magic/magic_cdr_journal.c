@@ -0,0 +1,657 @@
+/**
+ * @file magic_cdr_journal.c
+ * @brief MAGIC CDR 追加式日志实现
+ * @description 记录以 [魔数][长度][CRC32] 为头顺序追加；刷盘线程把一批记录
+ * 一次写入并 fdatasync，随后唤醒该批的全部等待者。回放与压缩共用一次
+ * mmap 扫描: 以 cdr_id 为键的开放寻址表记录每个 ID 最新记录的文件偏移。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_cdr_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <freeDiameter/extension.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*===========================================================================
+ * 记录格式
+ *===========================================================================*/
+
+/**
+ * @brief 记录头 (主机字节序)。
+ */
+typedef struct {
+  uint32_t magic; ///< CDR_JOURNAL_MAGIC。
+  uint32_t len;   ///< payload 长度。
+  uint32_t crc;   ///< payload 的 CRC32。
+} JournalRecordHeader;
+
+#define RECORD_SIZE (sizeof(JournalRecordHeader) + sizeof(CDRJournalEntry))
+#define COMPACT_CHUNK (1024 * 1024) /* 压缩时的写出批量 */
+#define MAX_PAYLOAD 65536           /* 单条 payload 上限 (超出视为损坏) */
+
+static uint32_t g_crc_table[256];
+static pthread_once_t g_crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_table_init(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    g_crc_table[i] = c;
+  }
+}
+
+/**
+ * @brief CRC32 (IEEE 802.3)。
+ */
+static uint32_t crc32_calc(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t c = 0xFFFFFFFFu;
+  while (len--) {
+    c = g_crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFFu;
+}
+
+/*===========================================================================
+ * cdr_id → 最新记录偏移索引 (开放寻址)
+ *===========================================================================*/
+
+typedef struct {
+  uint64_t off;  ///< 最新记录在文件中的偏移。
+  uint32_t id;   ///< cdr_id。
+  uint32_t used; ///< 槽位是否占用。
+} IndexSlot;
+
+typedef struct {
+  IndexSlot *slots;
+  size_t cap;   ///< 2 的幂。
+  size_t count; ///< 不同 cdr_id 数。
+} JournalIndex;
+
+static size_t index_hash(uint32_t id, size_t cap) {
+  return (size_t)((id * 2654435761u) & (cap - 1));
+}
+
+static int index_grow(JournalIndex *idx) {
+  size_t new_cap = idx->cap ? idx->cap * 2 : 1024;
+  IndexSlot *slots = calloc(new_cap, sizeof(IndexSlot));
+  if (!slots) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < idx->cap; i++) {
+    if (idx->slots[i].used) {
+      size_t h = index_hash(idx->slots[i].id, new_cap);
+      while (slots[h].used) {
+        h = (h + 1) & (new_cap - 1);
+      }
+      slots[h] = idx->slots[i];
+    }
+  }
+
+  free(idx->slots);
+  idx->slots = slots;
+  idx->cap = new_cap;
+  return 0;
+}
+
+static int index_put(JournalIndex *idx, uint32_t id, uint64_t off) {
+  if ((idx->count + 1) * 2 > idx->cap && index_grow(idx) != 0) {
+    return -1;
+  }
+
+  size_t h = index_hash(id, idx->cap);
+  while (idx->slots[h].used && idx->slots[h].id != id) {
+    h = (h + 1) & (idx->cap - 1);
+  }
+
+  if (!idx->slots[h].used) {
+    idx->slots[h].used = 1;
+    idx->slots[h].id = id;
+    idx->count++;
+  }
+  idx->slots[h].off = off;
+  return 0;
+}
+
+/**
+ * @brief 顺序扫描日志映像，建立索引。
+ * @return 完整记录的总长度 (其后为残缺或损坏数据), 索引内存不足时返回
+ *         已扫描的长度并置 *oom
+ */
+static size_t journal_scan(const char *data, size_t size, JournalIndex *idx,
+                           bool *oom) {
+  size_t off = 0;
+  *oom = false;
+
+  while (size - off >= sizeof(JournalRecordHeader)) {
+    JournalRecordHeader hdr;
+    memcpy(&hdr, data + off, sizeof(hdr));
+
+    if (hdr.magic != CDR_JOURNAL_MAGIC || hdr.len < sizeof(uint32_t) ||
+        hdr.len > MAX_PAYLOAD || hdr.len > size - off - sizeof(hdr)) {
+      break;
+    }
+
+    const char *payload = data + off + sizeof(hdr);
+    if (crc32_calc(payload, hdr.len) != hdr.crc) {
+      break;
+    }
+
+    uint32_t id;
+    memcpy(&id, payload, sizeof(id));
+    if (index_put(idx, id, off) != 0) {
+      *oom = true;
+      break;
+    }
+
+    off += sizeof(hdr) + hdr.len;
+  }
+
+  return off;
+}
+
+/**
+ * @brief 从映像解码一条记录 (兼容长度不同的旧/新 payload)。
+ */
+static void journal_decode(const char *data, uint64_t off,
+                           CDRJournalEntry *entry) {
+  JournalRecordHeader hdr;
+  memcpy(&hdr, data + off, sizeof(hdr));
+
+  memset(entry, 0, sizeof(*entry));
+  memcpy(entry, data + off + sizeof(hdr),
+         hdr.len < sizeof(*entry) ? hdr.len : sizeof(*entry));
+}
+
+/*===========================================================================
+ * 文件写入
+ *===========================================================================*/
+
+static int write_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * @brief 同步日志所在目录 (使 rename / 新建文件持久化)。
+ */
+static void fsync_parent_dir(const char *path) {
+  char dir[sizeof(((CDRJournal *)0)->path)];
+  snprintf(dir, sizeof(dir), "%s", path);
+
+  char *slash = strrchr(dir, '/');
+  if (!slash) {
+    return;
+  }
+  *slash = '\0';
+
+  int dfd = open(dir[0] ? dir : "/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dfd >= 0) {
+    fsync(dfd);
+    close(dfd);
+  }
+}
+
+/**
+ * @brief 压缩: 只保留每个 cdr_id 的最新记录，丢弃过期归档。
+ * @details 仅在刷盘线程中调用 (此时文件内容已全部落盘，j->fd 不被其他
+ *          线程使用)；压缩期间的追加继续写入内存缓冲，随后写入新文件。
+ */
+static void journal_compact(CDRJournal *j, time_t cutoff) {
+  size_t size = (size_t)j->file_size;
+  if (size == 0) {
+    return;
+  }
+
+  char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, j->fd, 0);
+  if (data == MAP_FAILED) {
+    fd_log_error("[CDR] Journal compaction: mmap failed: %s", strerror(errno));
+    return;
+  }
+
+  JournalIndex idx = {0};
+  bool oom;
+  journal_scan(data, size, &idx, &oom);
+  if (oom) {
+    fd_log_error("[CDR] Journal compaction: out of memory");
+    goto out;
+  }
+
+  char tmp_path[sizeof(j->path) + 16];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.compact", j->path);
+
+  /* 读写打开: 新文件随后成为 j->fd，下次压缩还要 mmap 读取它 */
+  int tfd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                 0644);
+  if (tfd < 0) {
+    fd_log_error("[CDR] Journal compaction: cannot create %s: %s", tmp_path,
+                 strerror(errno));
+    goto out;
+  }
+
+  char *chunk = malloc(COMPACT_CHUNK);
+  size_t chunk_len = 0;
+  uint64_t new_size = 0;
+  uint64_t dropped = 0;
+  int ret = chunk ? 0 : -1;
+
+  for (size_t i = 0; i < idx.cap && ret == 0; i++) {
+    if (!idx.slots[i].used) {
+      continue;
+    }
+
+    CDRJournalEntry entry;
+    journal_decode(data, idx.slots[i].off, &entry);
+    if (cutoff > 0 && entry.archive_time != 0 && entry.archive_time < cutoff) {
+      dropped++;
+      continue;
+    }
+
+    /* 原样复制记录 (头 + payload) */
+    JournalRecordHeader hdr;
+    memcpy(&hdr, data + idx.slots[i].off, sizeof(hdr));
+    size_t rec_len = sizeof(hdr) + hdr.len;
+
+    if (chunk_len + rec_len > COMPACT_CHUNK) {
+      ret = write_all(tfd, chunk, chunk_len);
+      chunk_len = 0;
+    }
+    memcpy(chunk + chunk_len, data + idx.slots[i].off, rec_len);
+    chunk_len += rec_len;
+    new_size += rec_len;
+  }
+
+  if (ret == 0 && chunk_len > 0) {
+    ret = write_all(tfd, chunk, chunk_len);
+  }
+  free(chunk);
+
+  if (ret != 0 || fdatasync(tfd) != 0 || rename(tmp_path, j->path) != 0) {
+    fd_log_error("[CDR] Journal compaction failed: %s", strerror(errno));
+    close(tfd);
+    unlink(tmp_path);
+    goto out;
+  }
+
+  fsync_parent_dir(j->path);
+
+  close(j->fd);
+  j->fd = tfd;
+
+  pthread_mutex_lock(&j->lock);
+  j->file_size = new_size;
+  j->compacted_size = new_size;
+  j->total_compactions++;
+  j->total_dropped += dropped;
+  pthread_mutex_unlock(&j->lock);
+
+  fd_log_notice("[CDR] Journal compacted: %zu -> %lu bytes, %zu CDRs kept, "
+                "%lu expired dropped",
+                size, (unsigned long)new_size, idx.count - (size_t)dropped,
+                (unsigned long)dropped);
+
+out:
+  free(idx.slots);
+  munmap(data, size);
+}
+
+/*===========================================================================
+ * 刷盘线程
+ *===========================================================================*/
+
+/**
+ * @brief 刷盘线程: 批量写入 + 一次 fdatasync，必要时压缩。
+ * @details 没有等待者时最多积累 CDR_JOURNAL_SYNC_MS；有等待者时立即刷盘，
+ *          刷盘期间到达的追加进入下一批。与追加缓冲交替使用两块内存，
+ *          写盘时不持锁。
+ */
+static void *journal_thread_func(void *arg) {
+  CDRJournal *j = (CDRJournal *)arg;
+  char *out = NULL;
+  size_t out_cap = 0;
+
+  pthread_mutex_lock(&j->lock);
+
+  for (;;) {
+    if (j->len == 0 && !j->compact_requested) {
+      if (!j->running) {
+        break;
+      }
+      pthread_cond_wait(&j->cond, &j->lock);
+      continue;
+    }
+
+    if (j->len > 0 && !j->urgent && j->running) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_nsec += (long)CDR_JOURNAL_SYNC_MS * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+      }
+      while (!j->urgent && j->running &&
+             pthread_cond_timedwait(&j->cond, &j->lock, &deadline) == 0) {
+      }
+    }
+
+    if (j->len > 0) {
+      /* 交换缓冲区 */
+      char *batch = j->buf;
+      size_t batch_len = j->len;
+      size_t batch_cap = j->cap;
+      uint64_t batch_seq = j->next_seq;
+      uint64_t old_size = j->file_size;
+
+      j->buf = out;
+      j->cap = out_cap;
+      j->len = 0;
+      j->urgent = false;
+      out = batch;
+      out_cap = batch_cap;
+
+      pthread_mutex_unlock(&j->lock);
+
+      int ret = write_all(j->fd, batch, batch_len);
+      if (ret == 0) {
+        ret = fdatasync(j->fd);
+      }
+      if (ret != 0) {
+        fd_log_error("[CDR] Journal write failed: %s", strerror(errno));
+        /* 去掉可能写入一半的记录，保证后续追加仍可回放 */
+        if (ftruncate(j->fd, (off_t)old_size) != 0) {
+          fd_log_error("[CDR] Journal truncate failed: %s", strerror(errno));
+        }
+      }
+
+      pthread_mutex_lock(&j->lock);
+      if (ret != 0) {
+        /* 记下失败批次的序号区间，更早的成功批次不受影响 */
+        uint32_t slot = j->error_count % CDR_JOURNAL_ERROR_RANGES;
+        if (j->error_count >= CDR_JOURNAL_ERROR_RANGES) {
+          j->error_horizon = j->error_hi[slot];
+        }
+        j->error_lo[slot] = j->done_seq + 1;
+        j->error_hi[slot] = batch_seq;
+        j->error_count++;
+      }
+      j->done_seq = batch_seq;
+      if (ret == 0) {
+        j->file_size += batch_len;
+        j->total_syncs++;
+      }
+      pthread_cond_broadcast(&j->cond);
+    }
+
+    bool oversized = j->file_size > CDR_JOURNAL_COMPACT_BYTES &&
+                     j->file_size > 2 * j->compacted_size;
+    if (j->running && (j->compact_requested || oversized)) {
+      time_t cutoff = j->compact_requested ? j->compact_cutoff : 0;
+      j->compact_requested = false;
+      pthread_mutex_unlock(&j->lock);
+      journal_compact(j, cutoff);
+      pthread_mutex_lock(&j->lock);
+    } else if (!j->running) {
+      j->compact_requested = false;
+    }
+  }
+
+  pthread_mutex_unlock(&j->lock);
+  free(out);
+  return NULL;
+}
+
+/*===========================================================================
+ * 公共 API
+ *===========================================================================*/
+
+int cdr_journal_open(CDRJournal *j, const char *dir, cdr_journal_replay_cb_t cb,
+                     void *arg) {
+  if (!j || !dir) {
+    return -1;
+  }
+
+  memset(j, 0, sizeof(*j));
+  j->fd = -1;
+  pthread_once(&g_crc_once, crc_table_init);
+
+  snprintf(j->path, sizeof(j->path), "%s/%s", dir, CDR_JOURNAL_FILE);
+
+  int fd = open(j->path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fd_log_error("[CDR] Cannot open journal %s: %s", j->path, strerror(errno));
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  /* 回放: 一次 mmap 顺序扫描，每个 cdr_id 只回调最新快照 */
+  size_t size = (size_t)st.st_size;
+  size_t valid = 0;
+  int replayed = 0;
+
+  if (size > 0) {
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      fd_log_error("[CDR] Cannot map journal %s: %s", j->path,
+                   strerror(errno));
+      close(fd);
+      return -1;
+    }
+
+    JournalIndex idx = {0};
+    bool oom;
+    valid = journal_scan(data, size, &idx, &oom);
+    if (oom) {
+      fd_log_error("[CDR] Journal replay: out of memory");
+      free(idx.slots);
+      munmap(data, size);
+      close(fd);
+      return -1;
+    }
+
+    for (size_t i = 0; i < idx.cap; i++) {
+      if (idx.slots[i].used) {
+        CDRJournalEntry entry;
+        journal_decode(data, idx.slots[i].off, &entry);
+        if (cb) {
+          cb(&entry, arg);
+        }
+        replayed++;
+      }
+    }
+
+    free(idx.slots);
+    munmap(data, size);
+  }
+
+  if (valid < size) {
+    fd_log_notice("[CDR] ⚠ Journal tail damaged, truncating %zu -> %zu bytes",
+                  size, valid);
+    if (ftruncate(fd, (off_t)valid) != 0) {
+      fd_log_error("[CDR] Journal truncate failed: %s", strerror(errno));
+      close(fd);
+      return -1;
+    }
+  }
+
+  if (size == 0) {
+    fsync_parent_dir(j->path);
+  }
+
+  j->fd = fd;
+  j->file_size = valid;
+  j->compacted_size = valid;
+
+  j->buf = malloc(CDR_JOURNAL_BUF_INITIAL);
+  j->cap = j->buf ? CDR_JOURNAL_BUF_INITIAL : 0;
+
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&j->cond, &cattr);
+  pthread_condattr_destroy(&cattr);
+  pthread_mutex_init(&j->lock, NULL);
+
+  j->running = true;
+  if (pthread_create(&j->thread, NULL, journal_thread_func, j) != 0) {
+    fd_log_error("[CDR] Failed to start journal thread");
+    j->running = false;
+    pthread_cond_destroy(&j->cond);
+    pthread_mutex_destroy(&j->lock);
+    free(j->buf);
+    j->buf = NULL;
+    close(fd);
+    j->fd = -1;
+    return -1;
+  }
+
+  j->is_open = true;
+  return replayed;
+}
+
+void cdr_journal_close(CDRJournal *j) {
+  if (!j || !j->is_open) {
+    return;
+  }
+
+  /* 刷盘线程在退出前写完剩余缓冲 */
+  pthread_mutex_lock(&j->lock);
+  j->running = false;
+  j->urgent = true;
+  pthread_cond_broadcast(&j->cond);
+  pthread_mutex_unlock(&j->lock);
+
+  pthread_join(j->thread, NULL);
+
+  close(j->fd);
+  j->fd = -1;
+  free(j->buf);
+  j->buf = NULL;
+  j->is_open = false;
+
+  pthread_cond_destroy(&j->cond);
+  pthread_mutex_destroy(&j->lock);
+
+  fd_log_notice("[CDR] Journal closed: records=%lu, syncs=%lu, "
+                "compactions=%lu, size=%lu bytes",
+                (unsigned long)j->total_records, (unsigned long)j->total_syncs,
+                (unsigned long)j->total_compactions,
+                (unsigned long)j->file_size);
+}
+
+uint64_t cdr_journal_append(CDRJournal *j, const CDRJournalEntry *entry) {
+  if (!j || !j->is_open || !entry) {
+    return 0;
+  }
+
+  JournalRecordHeader hdr = {.magic = CDR_JOURNAL_MAGIC,
+                             .len = sizeof(*entry),
+                             .crc = crc32_calc(entry, sizeof(*entry))};
+
+  pthread_mutex_lock(&j->lock);
+
+  /* 刷盘线程只在 running=false 且缓冲为空时退出，之后不再接受追加 */
+  if (!j->running) {
+    pthread_mutex_unlock(&j->lock);
+    return 0;
+  }
+
+  if (j->len + RECORD_SIZE > j->cap) {
+    size_t new_cap = j->cap ? j->cap : CDR_JOURNAL_BUF_INITIAL;
+    while (j->len + RECORD_SIZE > new_cap) {
+      new_cap *= 2;
+    }
+    char *nb = realloc(j->buf, new_cap);
+    if (!nb) {
+      pthread_mutex_unlock(&j->lock);
+      fd_log_error("[CDR] Journal buffer allocation failed");
+      return 0;
+    }
+    j->buf = nb;
+    j->cap = new_cap;
+  }
+
+  memcpy(j->buf + j->len, &hdr, sizeof(hdr));
+  memcpy(j->buf + j->len + sizeof(hdr), entry, sizeof(*entry));
+  j->len += RECORD_SIZE;
+
+  uint64_t seq = ++j->next_seq;
+  j->total_records++;
+
+  /* 缓冲区积累较多时提前刷盘 */
+  if (j->len >= CDR_JOURNAL_BUF_INITIAL) {
+    j->urgent = true;
+    pthread_cond_broadcast(&j->cond);
+  }
+
+  pthread_mutex_unlock(&j->lock);
+  return seq;
+}
+
+int cdr_journal_sync(CDRJournal *j, uint64_t seq) {
+  if (!j || !j->is_open || seq == 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&j->lock);
+
+  if (j->done_seq < seq) {
+    j->urgent = true;
+    pthread_cond_broadcast(&j->cond);
+    while (j->done_seq < seq) {
+      pthread_cond_wait(&j->cond, &j->lock);
+    }
+  }
+
+  /* 只有 seq 落在失败批次内才算失败；被挤出记录的旧区间保守处理 */
+  int ret = (seq <= j->error_horizon) ? -1 : 0;
+  uint32_t n = j->error_count < CDR_JOURNAL_ERROR_RANGES
+                   ? j->error_count
+                   : CDR_JOURNAL_ERROR_RANGES;
+  for (uint32_t i = 0; i < n && ret == 0; i++) {
+    if (seq >= j->error_lo[i] && seq <= j->error_hi[i]) {
+      ret = -1;
+    }
+  }
+
+  pthread_mutex_unlock(&j->lock);
+  return ret;
+}
+
+void cdr_journal_request_compact(CDRJournal *j, time_t cutoff) {
+  if (!j || !j->is_open) {
+    return;
+  }
+
+  pthread_mutex_lock(&j->lock);
+  j->compact_requested = true;
+  j->compact_cutoff = cutoff;
+  pthread_cond_broadcast(&j->cond);
+  pthread_mutex_unlock(&j->lock);
+}
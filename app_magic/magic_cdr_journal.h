@@ -0,0 +1,163 @@
+/**
+ * @file magic_cdr_journal.h
+ * @brief MAGIC CDR 追加式日志 (journal)
+ * @details 以追加写入的二进制日志替代"每条 CDR 一个 JSON 文件"的存储方式:
+ *
+ * - 每次 CDR 状态变化追加一条完整快照，文件内同一 cdr_id 以最后一条为准
+ * - 记录格式: [magic u32][len u32][crc32 u32][payload len 字节]，
+ *   payload 为定长 CDRJournalEntry；尾部的残缺记录在打开时截断
+ * - 组提交: 追加只写内存缓冲，后台线程按批 write + 一次 fdatasync；
+ *   需要落盘保证的调用者等待自己的序号，同一批内的等待者共享一次 fsync
+ * - 压缩: 文件超过阈值或按保留期清理时，由后台线程把每个 cdr_id 的最新
+ *   快照写入新文件 (丢弃超过保留期的归档记录)，再原子 rename 替换
+ * - 启动恢复: mmap 整个文件顺序扫描，按 cdr_id 去重后回调，
+ *   不做文本解析
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_CDR_JOURNAL_H
+#define MAGIC_CDR_JOURNAL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define CDR_JOURNAL_FILE "cdr.journal"   /* 日志文件名 (位于 CDR 基础目录) */
+#define CDR_JOURNAL_MAGIC 0x4A524443u    /* 记录头魔数 ("CDRJ") */
+#define CDR_JOURNAL_SYNC_MS 100          /* 无等待者时的最长落盘间隔 */
+#define CDR_JOURNAL_BUF_INITIAL 65536    /* 追加缓冲区初始容量 (按需倍增) */
+#define CDR_JOURNAL_COMPACT_BYTES (64u * 1024 * 1024) /* 触发压缩的文件大小 */
+#define CDR_JOURNAL_ERROR_RANGES 8       /* 记录的失败批次序号区间数 */
+
+#define CDR_JOURNAL_FLAG_EXPORTED 0x01 /* 已写入计费导出文件 */
+
+/* 快照中字符串字段长度 (与 CDRRecord 一致) */
+#define CDR_JOURNAL_UUID_LEN 64
+#define CDR_JOURNAL_SESSION_LEN 128
+#define CDR_JOURNAL_CLIENT_LEN 64
+#define CDR_JOURNAL_DLM_LEN 64
+
+/**
+ * @brief CDR 快照 (日志 payload，定长、主机字节序)。
+ */
+typedef struct {
+  uint32_t cdr_id;              ///< CDR ID (去重键)。
+  int32_t status;               ///< CDRStatus。
+  int64_t start_time;           ///< 开始时间。
+  int64_t stop_time;            ///< 结束时间。
+  int64_t archive_time;         ///< 归档时间 (0=未归档)。
+  uint64_t bytes_in;            ///< 入站字节数。
+  uint64_t bytes_out;           ///< 出站字节数。
+  uint64_t packets_in;          ///< 入站数据包数。
+  uint64_t packets_out;         ///< 出站数据包数。
+  uint64_t base_offset_in;      ///< 入站基准偏移。
+  uint64_t base_offset_out;     ///< 出站基准偏移。
+  uint64_t last_bytes_in;       ///< 上次入站字节数。
+  uint64_t last_bytes_out;      ///< 上次出站字节数。
+  uint32_t overflow_count_in;   ///< 入站溢出次数。
+  uint32_t overflow_count_out;  ///< 出站溢出次数。
+  uint8_t bearer_id;            ///< Bearer ID。
+  uint8_t flags;                ///< CDR_JOURNAL_FLAG_*。
+  uint8_t reserved[6];          ///< 保留 (填 0)。
+  char cdr_uuid[CDR_JOURNAL_UUID_LEN];        ///< CDR UUID。
+  char session_id[CDR_JOURNAL_SESSION_LEN];   ///< 会话 ID。
+  char client_id[CDR_JOURNAL_CLIENT_LEN];     ///< 客户端 ID。
+  char dlm_name[CDR_JOURNAL_DLM_LEN];         ///< DLM 名称。
+} CDRJournalEntry;
+
+/**
+ * @brief 回放回调 (每个 cdr_id 调用一次，参数为其最新快照)。
+ */
+typedef void (*cdr_journal_replay_cb_t)(const CDRJournalEntry *entry,
+                                        void *arg);
+
+/**
+ * @brief CDR 日志上下文。
+ */
+typedef struct {
+  int fd;                  ///< 日志文件描述符。
+  char path[256];          ///< 日志文件路径。
+  uint64_t file_size;      ///< 已写入文件的字节数。
+  uint64_t compacted_size; ///< 上次压缩后的文件大小。
+
+  /* 追加缓冲 (持 lock 访问) */
+  char *buf;         ///< 待写入记录。
+  size_t len;        ///< 缓冲区已用字节数。
+  size_t cap;        ///< 缓冲区容量。
+  uint64_t next_seq; ///< 最后一条追加记录的序号。
+  uint64_t done_seq; ///< 已处理 (落盘或写入失败) 的最大序号。
+  bool urgent;       ///< 有等待者，立即落盘。
+
+  /* 写入失败的批次 (持 lock 访问，环形保留最近几次) */
+  uint64_t error_lo[CDR_JOURNAL_ERROR_RANGES]; ///< 失败批次首序号。
+  uint64_t error_hi[CDR_JOURNAL_ERROR_RANGES]; ///< 失败批次末序号。
+  uint32_t error_count;   ///< 累计失败批次数。
+  uint64_t error_horizon; ///< 已移出环形记录的失败批次的最大末序号。
+
+  /* 压缩请求 */
+  bool compact_requested; ///< 待执行压缩。
+  time_t compact_cutoff;  ///< 丢弃 archive_time 早于此值的归档记录 (0=不丢弃)。
+
+  /* 统计 */
+  uint64_t total_records;     ///< 追加的记录数。
+  uint64_t total_syncs;       ///< fdatasync 次数。
+  uint64_t total_compactions; ///< 压缩次数。
+  uint64_t total_dropped;     ///< 压缩丢弃的过期记录数。
+
+  pthread_mutex_t lock;  ///< 保护缓冲与序号。
+  pthread_cond_t cond;   ///< 唤醒刷盘线程 / 等待者。
+  pthread_t thread;      ///< 刷盘线程。
+  bool running;          ///< 刷盘线程运行中。
+  bool is_open;          ///< 是否已打开。
+} CDRJournal;
+
+/**
+ * @brief 打开日志并回放。
+ * @details 扫描已有文件，截断尾部残缺记录，对每个 cdr_id 的最新快照调用
+ *          cb，随后启动刷盘线程。
+ *
+ * @param j 日志上下文
+ * @param dir 所在目录
+ * @param cb 回放回调 (可为 NULL)
+ * @param arg 回调参数
+ * @return 回放的 CDR 数 (>=0), -1=失败
+ */
+int cdr_journal_open(CDRJournal *j, const char *dir, cdr_journal_replay_cb_t cb,
+                     void *arg);
+
+/**
+ * @brief 落盘全部待写记录并关闭日志。
+ * @param j 日志上下文
+ */
+void cdr_journal_close(CDRJournal *j);
+
+/**
+ * @brief 追加一条快照 (只写内存缓冲，不等待落盘)。
+ * @param j 日志上下文
+ * @param entry 快照
+ * @return 记录序号 (>0), 0=失败
+ */
+uint64_t cdr_journal_append(CDRJournal *j, const CDRJournalEntry *entry);
+
+/**
+ * @brief 等待序号 seq 及之前的记录落盘。
+ * @param j 日志上下文
+ * @param seq cdr_journal_append 返回的序号
+ * @return 0=已落盘, -1=写入失败或日志已关闭
+ * @note 只有 seq 所在批次写入失败才返回 -1；最近 CDR_JOURNAL_ERROR_RANGES
+ *       个失败批次之前的序号无法区分，保守返回 -1。
+ */
+int cdr_journal_sync(CDRJournal *j, uint64_t seq);
+
+/**
+ * @brief 请求后台压缩。
+ * @param j 日志上下文
+ * @param cutoff 丢弃 archive_time 早于此值的归档记录 (0=只去重)
+ */
+void cdr_journal_request_compact(CDRJournal *j, time_t cutoff);
+
+#endif /* MAGIC_CDR_JOURNAL_H */
@@ -39,13 +39,16 @@
 #include "magic_cdr.h"          /* CDR 管理接口 */
 #include "magic_cic_push.h"     /* MSCR/MNTR 推送接口 */
 #include "magic_config.h"       /* 配置管理接口 */
+#include "magic_config_store.h" /* 配置快照存储 */
 #include "magic_dataplane.h"    /* 数据平面路由接口 */
 #include "magic_dict_handles.h" /* MAGIC Diameter 字典句柄 */
 
 #include "magic_group_avp_simple.h"  /* 复合 AVP 处理 */
+#include "magic_hash.h"              /* 会话 ID 哈希 */
 #include "magic_napt_validator.h"    /* ARINC 839 NAPT 验证器 */
 #include "magic_policy.h"            /* 策略引擎接口 */
 #include "magic_tft_validator.h"     /* TFT 白名单验证器 */
+#include "magic_timer.h"             /* 资源请求重试定时器 */
 #include "mih_protocol.h"            /* MIH 协议定义 */
 #include <arpa/inet.h>               /* inet_ntoa 函数 */
 #include <freeDiameter/extension.h>  /* freeDiameter 扩展框架 */
@@ -129,6 +132,58 @@ static int cic_handle_macr(struct msg **msg, struct avp *avp,
  */
 static MagicContext *g_ctx = NULL;
 
+/* 本线程当前应使用的配置快照 (分发/定时器/ADIF 线程均处于读临界区内) */
+static inline MagicConfig *cic_config(void) {
+  return magic_config_current(&g_ctx->config_store);
+}
+
+/*===========================================================================
+ * 配置快照固定的消息分发
+ *===========================================================================*/
+
+typedef int (*cic_handler_t)(struct msg **msg, struct avp *avp,
+                             struct session *sess, void *opaque,
+                             enum disp_action *act);
+
+#define CIC_MAX_HANDLERS 8 /* 注册的命令处理器数 */
+
+/* 分发槽位: 作为 opaque 传给 fd_disp_register，指向真正的处理器 */
+typedef struct {
+  cic_handler_t handler;
+} CicHandlerSlot;
+
+static CicHandlerSlot g_cic_handlers[CIC_MAX_HANDLERS];
+static int g_cic_handler_count = 0;
+
+/**
+ * @brief 分发入口: 在读临界区内调用真正的处理器。
+ * @details 处理器看到的始终是请求到达时的配置版本；重载只影响之后的请求。
+ */
+static int cic_dispatch_pinned(struct msg **msg, struct avp *avp,
+                               struct session *sess, void *opaque,
+                               enum disp_action *act) {
+  const CicHandlerSlot *slot = (const CicHandlerSlot *)opaque;
+
+  magic_config_read_begin(&g_ctx->config_store);
+  int ret = slot->handler(msg, avp, sess, NULL, act);
+  magic_config_read_end(&g_ctx->config_store);
+  return ret;
+}
+
+/**
+ * @brief 注册命令处理器 (经 cic_dispatch_pinned 包装)。
+ * @return 0 成功，ENOSPC 槽位已满，其他为 fd_disp_register 错误码。
+ */
+static int cic_register_handler(cic_handler_t handler,
+                                struct disp_when *when) {
+  if (g_cic_handler_count >= CIC_MAX_HANDLERS) {
+    return ENOSPC;
+  }
+  CicHandlerSlot *slot = &g_cic_handlers[g_cic_handler_count++];
+  slot->handler = handler;
+  return fd_disp_register(cic_dispatch_pinned, DISP_HOW_CC, when, slot, NULL);
+}
+
 /*===========================================================================
  * MSXR 速率限制 (v2.1)
  * 关联到 Client-ID，防止同一客户端频繁轮询
@@ -964,6 +1019,203 @@ static int extract_float32_from_grouped_avp(struct avp *grouped_avp,
 #define MCAR_RETRY_DELAY_MS 100
 #define MCAR_FALLBACK_MAX_LINKS 4
 
+/* 链路资源分配推进结果 (MCAR/MCCR 共用) */
+typedef enum {
+  LINK_ALLOC_DONE = 0,   /* 资源分配成功 */
+  LINK_ALLOC_FAILED,     /* 所有候选链路均失败 */
+  LINK_ALLOC_RETRY_LATER /* 当前链路需延迟重试，请求挂起等待定时器 */
+} LinkAllocStatus;
+
+/**
+ * @brief 释放 DLM 上已分配的承载 (MCAR/MCCR 共用)。
+ *
+ * @param link_id 链路 ID。
+ * @param bearer_id 承载 ID。
+ */
+static void cic_release_link_resource(const char *link_id, uint8_t bearer_id) {
+  MIH_Link_Resource_Request mih_release;
+  memset(&mih_release, 0, sizeof(mih_release));
+
+  snprintf(mih_release.destination_id.mihf_id,
+           sizeof(mih_release.destination_id.mihf_id), "MIHF_%s", link_id);
+  mih_release.resource_action = RESOURCE_ACTION_RELEASE;
+  mih_release.has_bearer_id = true;
+  mih_release.bearer_identifier = bearer_id;
+
+  /* 释放无需等待 DLM 确认 */
+  magic_lmi_resource_request_async(&g_ctx->lmi_ctx, &mih_release, 0, NULL,
+                                   NULL);
+}
+
+/**
+ * @brief 拆除会话的数据平面与计费状态 (被挤占时)。
+ * @details 与 STR 相同的顺序: 取最终流量并关闭 CDR，注销流量监控，
+ *          再删除 TFT mangle 规则、客户端路由与流分类器登记。
+ *          会话重新建立链路时按新链路重新登记。
+ *
+ * @param session 被挤占的会话。
+ */
+static void cic_teardown_session_dataplane(ClientSession *session) {
+  TrafficStats final_stats;
+  if (traffic_get_session_stats(&g_ctx->traffic_ctx, session->session_id,
+                                &final_stats) == 0) {
+    session->bytes_in = final_stats.bytes_in;
+    session->bytes_out = final_stats.bytes_out;
+  }
+
+  CDRRecord *cdr = cdr_find_by_session(&g_ctx->cdr_mgr, session->session_id);
+  if (cdr && cdr_close(&g_ctx->cdr_mgr, cdr, session->bytes_in,
+                       session->bytes_out) == 0) {
+    fd_log_notice("[app_magic]       ✓ CDR closed: id=%u", cdr->cdr_id);
+  }
+
+  traffic_unregister_session(&g_ctx->traffic_ctx, session->session_id);
+  session->conntrack_mark = 0;
+
+  magic_dataplane_remove_tft_rules(&g_ctx->dataplane_ctx, session->session_id);
+  magic_dataplane_remove_client_route(&g_ctx->dataplane_ctx,
+                                      session->session_id);
+  magic_flow_remove_session(&g_ctx->flow_ctx, session->session_id);
+}
+
+/**
+ * @brief 拆除被准入控制挤占的会话。
+ * @details 释放其 DLM 承载，拆除数据平面、流量监控与 CDR 状态，会话回到
+ *          AUTHENTICATED，并以 MNTR (NO_FREE_BANDWIDTH) 通知客户端。
+ *
+ * @param victims magic_admission_commit 返回的被挤占会话列表。
+ */
+static void cic_preempt_sessions(const AdmissionVictims *victims) {
+  for (uint32_t i = 0; i < victims->count; i++) {
+    ClientSession *session =
+        magic_session_find_by_id(&g_ctx->session_mgr, victims->session_id[i]);
+    if (!session || !session->assigned_link_id[0]) {
+      continue;
+    }
+
+    fd_log_notice("[app_magic]     ⚠ Preempting session %s on %s (bearer=%u)",
+                  session->session_id, session->assigned_link_id,
+                  session->bearer_id);
+
+    cic_release_link_resource(session->assigned_link_id, session->bearer_id);
+    cic_teardown_session_dataplane(session);
+
+    MNTRParams mntr;
+    memset(&mntr, 0, sizeof(mntr));
+    mntr.magic_status_code = MAGIC_STATUS_NO_FREE_BANDWIDTH;
+    mntr.error_message = "Preempted by higher priority session";
+    mntr.force_send = true;
+    magic_cic_send_mntr(g_ctx, session, &mntr);
+
+    session->assigned_link_id[0] = '\0';
+    session->bearer_id = 0;
+    session->granted_bw_kbps = 0;
+    session->granted_ret_bw_kbps = 0;
+    magic_session_set_state(session, SESSION_STATE_AUTHENTICATED);
+  }
+}
+
+/**
+ * @brief 向 DLM 发起一次链路资源请求 (MCAR/MCCR 共用)。
+ * @details 先在准入控制账本中预留带宽 (批准值可能小于策略给出的值，
+ *          会回写到 `policy_resp`)，再按批准带宽构造 MIH_Link_Resource_Request
+ *          并同步等待确认。成功则提交预留并拆除被挤占的会话，失败则回滚。
+ *          不做重试，重试节奏由调用方的状态机和定时器控制。
+ *
+ * @param session_id 会话 ID。
+ * @param client_id 客户端 ID。
+ * @param params 通信请求参数 (保证带宽与优先级)。
+ * @param profile 客户端配置 (可为 NULL)。
+ * @param link_id 目标链路 ID。
+ * @param policy_resp 策略引擎返回的带宽参数 (输入/输出)。
+ * @param mih_confirm 输出参数，存储 MIH 确认结果。
+ * @return 0 成功，-1 MIH 请求失败，-2 准入控制拒绝 (该链路重试无意义)。
+ */
+static int cic_request_link_resource(const char *session_id,
+                                     const char *client_id,
+                                     const CommReqParams *params,
+                                     const ClientProfile *profile,
+                                     const char *link_id,
+                                     PolicyResponse *policy_resp,
+                                     MIH_Link_Resource_Confirm *mih_confirm) {
+  memset(mih_confirm, 0, sizeof(*mih_confirm));
+
+  /* 准入控制: 预留链路与客户端带宽 */
+  AdmissionRequest adm_req;
+  memset(&adm_req, 0, sizeof(adm_req));
+  adm_req.session_id = session_id;
+  adm_req.client_id = client_id;
+  adm_req.link_id = link_id;
+  adm_req.requested_fwd_kbps = policy_resp->granted_bw_kbps;
+  adm_req.requested_ret_kbps = policy_resp->granted_ret_bw_kbps;
+  if (params) {
+    adm_req.required_fwd_kbps = (uint32_t)params->required_bw;
+    adm_req.required_ret_kbps = (uint32_t)params->required_ret_bw;
+    adm_req.priority_class = (uint8_t)atoi(params->priority_class);
+  }
+  /* 客户端声明的优先级不能高于 Profile 授权的优先级 */
+  if (profile && profile->qos.priority_class > 0 &&
+      (adm_req.priority_class == 0 ||
+       adm_req.priority_class < profile->qos.priority_class)) {
+    adm_req.priority_class = profile->qos.priority_class;
+  }
+  adm_req.allow_preemption =
+      params && params->priority_type == PRIORITY_TYPE_PREEMPTION && profile &&
+      profile->qos.priority_type == PRIORITY_TYPE_PREEMPTION;
+
+  AdmissionGrant grant;
+  AdmissionResult adm = magic_admission_reserve(&g_ctx->admission_ctx,
+                                                &adm_req, &grant);
+  if (adm != ADMISSION_OK) {
+    fd_log_notice("[app_magic]     ⚠ Admission control rejected %s: %s",
+                  link_id, magic_admission_result_str(adm));
+    return -2;
+  }
+  if (grant.granted_fwd_kbps != policy_resp->granted_bw_kbps ||
+      grant.granted_ret_kbps != policy_resp->granted_ret_bw_kbps) {
+    fd_log_notice("[app_magic]     → Admission trimmed BW: %u/%u → %u/%u kbps",
+                  policy_resp->granted_bw_kbps,
+                  policy_resp->granted_ret_bw_kbps, grant.granted_fwd_kbps,
+                  grant.granted_ret_kbps);
+    policy_resp->granted_bw_kbps = grant.granted_fwd_kbps;
+    policy_resp->granted_ret_bw_kbps = grant.granted_ret_kbps;
+  }
+
+  MIH_Link_Resource_Request mih_req;
+  memset(&mih_req, 0, sizeof(mih_req));
+
+  snprintf(mih_req.destination_id.mihf_id,
+           sizeof(mih_req.destination_id.mihf_id), "MIHF_%s", link_id);
+  mih_req.link_identifier.link_type = 1;
+  strncpy(mih_req.link_identifier.link_addr, link_id,
+          sizeof(mih_req.link_identifier.link_addr) - 1);
+  mih_req.resource_action = RESOURCE_ACTION_REQUEST;
+  mih_req.has_qos_params = true;
+  mih_req.qos_parameters.cos_id = COS_BEST_EFFORT;
+  mih_req.qos_parameters.forward_link_rate = policy_resp->granted_bw_kbps;
+  mih_req.qos_parameters.return_link_rate = policy_resp->granted_ret_bw_kbps;
+  mih_req.qos_parameters.avg_pk_tx_delay = 100;
+  mih_req.qos_parameters.max_pk_tx_delay = 500;
+  mih_req.qos_parameters.pk_delay_jitter = 50;
+  mih_req.qos_parameters.pk_loss_rate = 0.01f;
+
+  int mih_result = magic_dlm_mih_link_resource_request(&g_ctx->lmi_ctx,
+                                                       &mih_req, mih_confirm);
+  if (mih_result == 0 && mih_confirm->status == STATUS_SUCCESS) {
+    AdmissionVictims victims;
+    magic_admission_commit(&g_ctx->admission_ctx, session_id, &victims);
+    if (victims.count > 0) {
+      cic_preempt_sessions(&victims);
+    }
+    return 0;
+  }
+
+  magic_admission_rollback(&g_ctx->admission_ctx, session_id);
+  fd_log_notice("[app_magic]     ⚠ MIH request failed: status=%s",
+                status_to_string(mih_confirm->status));
+  return -1;
+}
+
 /* MCAR 处理上下文 - 用于在各步骤间传递状态 */
 typedef struct {
   /* 从请求中提取的信息 */
@@ -1003,8 +1255,11 @@ typedef struct {
 
   /* 重试与回退控制 (场景 C: MIH 资源请求) */
   uint32_t retry_count;                                  /* 当前重试次数 */
+  uint32_t link_attempt; /* 当前候选链路上已失败的尝试次数 */
   char tried_links[MCAR_FALLBACK_MAX_LINKS][MAX_ID_LEN]; /* 已尝试的链路列表 */
   int tried_link_count;                                  /* 已尝试链路数 */
+  struct msg *pending_qry; /* 挂起等待重试时保留的 MCAR 请求 */
+  MagicConfigSnapshot *config_snap; /* 挂起期间持有的配置版本 */
 
   /* 应答构建参数 */
   uint32_t result_code;         /* Diameter Result-Code */
@@ -1094,6 +1349,7 @@ static int mcar_step1_validation(struct msg *qry, McarProcessContext *ctx) {
       if (exist_sess->assigned_link_id[0]) {
         magic_dataplane_remove_client_route(&g_ctx->dataplane_ctx,
                                             exist_sess->session_id);
+        magic_flow_remove_session(&g_ctx->flow_ctx, exist_sess->session_id);
       }
     }
   }
@@ -1211,19 +1467,19 @@ static int mcar_step2_auth(McarProcessContext *ctx) {
 
   if (ctx->username[0] != '\0') {
     /* 优先尝试用 User-Name 查找 */
-    ctx->profile = magic_config_find_client(&g_ctx->config, ctx->username);
+    ctx->profile = magic_config_find_client(cic_config(), ctx->username);
     if (ctx->profile) {
       fd_log_notice("[app_magic]   Using User-Name '%s' as Client-ID",
                     ctx->username);
     } else {
       /* 回退到 Origin-Host */
-      ctx->profile = magic_config_find_client(&g_ctx->config, ctx->client_id);
+      ctx->profile = magic_config_find_client(cic_config(), ctx->client_id);
       fd_log_notice("[app_magic]   User-Name '%s' not found, fallback to "
                     "Origin-Host '%s'",
                     ctx->username, ctx->client_id);
     }
   } else {
-    ctx->profile = magic_config_find_client(&g_ctx->config, ctx->client_id);
+    ctx->profile = magic_config_find_client(cic_config(), ctx->client_id);
   }
 
   if (!ctx->profile) {
@@ -1579,83 +1835,21 @@ static void mcar_mark_link_tried(McarProcessContext *ctx, const char *link_id) {
 }
 
 /**
- * @brief 带重试机制的链路资源请求 (MCAR Helper)。
- * @details 向 LMI/DLM 发起资源请求 (MIH_Link_Resource_Request)。
- *          如果失败 (Resource Denied/Unavailable)，支持重试
- * (MCAR_RETRY_MAX_COUNT)。 用于 0-RTT 场景 (Scenario C)。
+ * @brief 选择下一条未尝试过的回退链路 (MCAR Helper)。
+ * @details 当前候选链路的重试次数用尽后，查询策略引擎获取备选链路，
+ *          结果写入 `ctx->policy_resp` 并标记为已尝试。使用 ADIF 数据辅助决策。
  *
  * @param ctx MCAR 处理上下文。
- * @param link_id 目标链路 ID。
- * @param policy_resp 策略引擎返回的带宽参数。
- * @param mih_confirm 输出参数，存储 MIH 确认结果。
- * @return 0 成功 (Resource Success/Parameters Updated)，-1 失败。
+ * @return 0 已选出新的候选链路，-1 没有更多可用链路。
  */
-static int mcar_try_link_with_retry(McarProcessContext *ctx,
-                                    const char *link_id,
-                                    PolicyResponse *policy_resp,
-                                    MIH_Link_Resource_Confirm *mih_confirm) {
-  int attempt;
-  int mih_result;
-
-  for (attempt = 0; attempt < MCAR_RETRY_MAX_COUNT; attempt++) {
-    if (attempt > 0) {
-      fd_log_notice("[app_magic]     → Retry attempt %d/%d for link %s",
-                    attempt + 1, MCAR_RETRY_MAX_COUNT, link_id);
-      usleep(MCAR_RETRY_DELAY_MS * 1000);
-    }
-
-    /* 构造 MIH 请求 */
-    MIH_Link_Resource_Request mih_req;
-    memset(&mih_req, 0, sizeof(mih_req));
-    memset(mih_confirm, 0, sizeof(*mih_confirm));
-
-    snprintf(mih_req.destination_id.mihf_id,
-             sizeof(mih_req.destination_id.mihf_id), "MIHF_%s", link_id);
-    mih_req.link_identifier.link_type = 1;
-    strncpy(mih_req.link_identifier.link_addr, link_id,
-            sizeof(mih_req.link_identifier.link_addr) - 1);
-    mih_req.resource_action = RESOURCE_ACTION_REQUEST;
-    mih_req.has_qos_params = true;
-    mih_req.qos_parameters.cos_id = COS_BEST_EFFORT;
-    mih_req.qos_parameters.forward_link_rate = policy_resp->granted_bw_kbps;
-    mih_req.qos_parameters.return_link_rate = policy_resp->granted_ret_bw_kbps;
-    mih_req.qos_parameters.avg_pk_tx_delay = 100;
-    mih_req.qos_parameters.max_pk_tx_delay = 500;
-    mih_req.qos_parameters.pk_delay_jitter = 50;
-    mih_req.qos_parameters.pk_loss_rate = 0.01f;
-
-    /* 发送 MIH 请求 */
-    mih_result = magic_dlm_mih_link_resource_request(&g_ctx->lmi_ctx, &mih_req,
-                                                     mih_confirm);
-
-    if (mih_result == 0 && mih_confirm->status == STATUS_SUCCESS) {
-      fd_log_notice("[app_magic]     ✓ MIH request succeeded on attempt %d",
-                    attempt + 1);
-      ctx->retry_count = attempt;
-      return 0;
-    }
+static int mcar_select_fallback_link(McarProcessContext *ctx) {
+  fd_log_notice("[app_magic]   → Attempting fallback to alternative links...");
 
-    fd_log_notice("[app_magic]     ⚠ MIH request failed: status=%s",
-                  status_to_string(mih_confirm->status));
+  if (ctx->tried_link_count >= MCAR_FALLBACK_MAX_LINKS) {
+    fd_log_error("[app_magic]     ✗ All fallback links exhausted");
+    return -1;
   }
 
-  fd_log_error("[app_magic]     ✗ All %d retry attempts failed for link %s",
-               MCAR_RETRY_MAX_COUNT, link_id);
-  return -1;
-}
-
-/**
- * @brief 尝试回退到备选链路 (MCAR Helper)。
- * @details
- * 当首选链路分配失败时，查询策略引擎获取备选链路并在备选链路上尝试分配资源。
- *          使用 ADIF 数据辅助决策。
- *
- * @param ctx MCAR 处理上下文。
- * @return 0 成功找到可用链路并分配资源，-1 所有链路都失败。
- */
-static int mcar_try_fallback_links(McarProcessContext *ctx) {
-  fd_log_notice("[app_magic]   → Attempting fallback to alternative links...");
-
   /* 获取所有可用链路列表 */
   PolicyRequest fallback_req;
   memset(&fallback_req, 0, sizeof(fallback_req));
@@ -1686,12 +1880,11 @@ static int mcar_try_fallback_links(McarProcessContext *ctx) {
     fallback_req.has_adif_data = true;
   }
 
-  /* 遍历尝试所有候选链路 */
+  /* 请求策略引擎返回下一个未尝试的最佳链路 */
   for (int i = 0; i < MCAR_FALLBACK_MAX_LINKS; i++) {
     PolicyResponse fallback_resp;
     memset(&fallback_resp, 0, sizeof(fallback_resp));
 
-    /* 请求策略引擎返回下一个最佳链路 */
     fallback_req.exclude_link_count = ctx->tried_link_count;
     for (int j = 0; j < ctx->tried_link_count && j < 4; j++) {
       strncpy(fallback_req.exclude_links[j], ctx->tried_links[j],
@@ -1713,25 +1906,66 @@ static int mcar_try_fallback_links(McarProcessContext *ctx) {
     fd_log_notice("[app_magic]     → Trying fallback link: %s",
                   fallback_resp.selected_link_id);
     mcar_mark_link_tried(ctx, fallback_resp.selected_link_id);
-
-    /* 尝试分配资源（带重试） */
-    MIH_Link_Resource_Confirm fallback_confirm;
-    if (mcar_try_link_with_retry(ctx, fallback_resp.selected_link_id,
-                                 &fallback_resp, &fallback_confirm) == 0) {
-      /* 成功！更新上下文 */
-      memcpy(&ctx->policy_resp, &fallback_resp, sizeof(PolicyResponse));
-      memcpy(&ctx->mih_confirm, &fallback_confirm,
-             sizeof(MIH_Link_Resource_Confirm));
-      fd_log_notice("[app_magic]     ✓ Fallback succeeded: link=%s",
-                    fallback_resp.selected_link_id);
-      return 0;
-    }
+    memcpy(&ctx->policy_resp, &fallback_resp, sizeof(PolicyResponse));
+    return 0;
   }
 
   fd_log_error("[app_magic]     ✗ All fallback links exhausted");
   return -1;
 }
 
+/**
+ * @brief 推进 MCAR 链路资源分配状态机 (MCAR Helper)。
+ * @details 在当前候选链路 (`ctx->policy_resp`) 上发起一次 MIH 资源请求。
+ *          失败且该链路尚有重试次数时返回 `LINK_ALLOC_RETRY_LATER`，由调用方
+ *          通过定时器在 MCAR_RETRY_DELAY_MS 后再次调用本函数；次数用尽则
+ *          切换到下一条回退链路并立即尝试。本函数从不睡眠，可在 Diameter
+ *          分发线程中调用。用于 0-RTT 场景 (Scenario C)。
+ *
+ * @param ctx MCAR 处理上下文。
+ * @return LINK_ALLOC_DONE / LINK_ALLOC_FAILED / LINK_ALLOC_RETRY_LATER。
+ */
+static LinkAllocStatus mcar_alloc_advance(McarProcessContext *ctx) {
+  for (;;) {
+    const char *link_id = ctx->policy_resp.selected_link_id;
+
+    if (ctx->link_attempt > 0) {
+      fd_log_notice("[app_magic]     → Retry attempt %u/%d for link %s",
+                    ctx->link_attempt + 1, MCAR_RETRY_MAX_COUNT, link_id);
+    }
+
+    int req_ret = cic_request_link_resource(
+        ctx->session_id, ctx->client_id, &ctx->comm_params, ctx->profile,
+        link_id, &ctx->policy_resp, &ctx->mih_confirm);
+    if (req_ret == 0) {
+      fd_log_notice("[app_magic]     ✓ MIH request succeeded on attempt %u",
+                    ctx->link_attempt + 1);
+      ctx->retry_count = ctx->link_attempt;
+      return LINK_ALLOC_DONE;
+    }
+
+    if (req_ret == -2) {
+      /* 准入控制拒绝: 容量不会在重试间隔内恢复，直接换链路 */
+      fd_log_notice("[app_magic]     → No admission on %s, skipping retries",
+                    link_id);
+    } else {
+      ctx->link_attempt++;
+      if (ctx->link_attempt < MCAR_RETRY_MAX_COUNT) {
+        return LINK_ALLOC_RETRY_LATER;
+      }
+
+      fd_log_error(
+          "[app_magic]     ✗ All %d retry attempts failed for link %s",
+          MCAR_RETRY_MAX_COUNT, link_id);
+    }
+
+    if (mcar_select_fallback_link(ctx) != 0) {
+      return LINK_ALLOC_FAILED;
+    }
+    ctx->link_attempt = 0;
+  }
+}
+
 /**
  * @brief 从 TFT-to-Ground 规则中提取目的 IP (MCAR Helper)。
  * @details 解析 TFT 规则以提取目的 IP 地址，用于数据平面路由和防火墙规则。
@@ -1795,6 +2029,120 @@ static void mcar_extract_dest_ip_from_tft(McarProcessContext *ctx) {
   }
 }
 
+/**
+ * @brief 取会话的数据平面源地址 (与 4.5/4.6 节下发 mangle 规则时一致)。
+ * @return 客户端 IP 字符串，未知时返回 NULL。
+ */
+static const char *cic_flow_client_ip(const ClientProfile *profile,
+                                      const ClientSession *session) {
+  if (profile && profile->auth.source_ip[0])
+    return profile->auth.source_ip;
+  if (session && session->client_ip[0])
+    return session->client_ip;
+  return NULL;
+}
+
+/**
+ * @brief 检查请求的一组 TFT 是否与其他会话已生效的同方向 TFT 重叠。
+ * @details 只告警不拒绝: 数据平面按客户端源地址打标，重叠的流量
+ *          只会被先生效的规则捕获，需要运维关注但不影响本次授权。
+ *
+ * @param session_id 本会话 ID (自身已有规则不计入)。
+ * @param client_ip 客户端 IP (可为 NULL)。
+ * @param tfts TFT 规则字符串数组。
+ * @param count 规则数量。
+ * @param direction FLOW_DIR_TO_GROUND / FLOW_DIR_TO_AIRCRAFT。
+ * @return 冲突总数。
+ */
+static int cic_flow_check_conflicts(const char *session_id,
+                                    const char *client_ip,
+                                    const char (*tfts)[256], int count,
+                                    uint8_t direction) {
+  const char *label =
+      direction == FLOW_DIR_TO_AIRCRAFT ? "TFT-to-Aircraft" : "TFT";
+  int total = 0;
+
+  for (int i = 0; i < count; i++) {
+    TFTRule parsed;
+    if (tft_parse_rule(tfts[i], &parsed) != 0 || !parsed.is_valid)
+      continue;
+
+    MagicFlowRule rule;
+    magic_flow_rule_from_tft(&parsed, client_ip, direction, &rule);
+    strncpy(rule.session_id, session_id, sizeof(rule.session_id) - 1);
+
+    MagicFlowMatch conflicts[FLOW_MAX_CONFLICTS];
+    int n = magic_flow_find_conflicts(&g_ctx->flow_ctx, &rule, conflicts,
+                                      FLOW_MAX_CONFLICTS);
+    for (int j = 0; j < n; j++) {
+      fd_log_notice("[app_magic]   ⚠ %s[%d] overlaps session %s TFT[%u] "
+                    "(bearer %u)",
+                    label, i + 1, conflicts[j].session_id,
+                    conflicts[j].tft_index + 1, conflicts[j].bearer_id);
+    }
+    total += n;
+  }
+
+  return total;
+}
+
+/**
+ * @brief 把一组 TFT 按请求中的顺序插入全局流分类器，顺序即评估优先级。
+ * @return 成功插入的规则数。
+ */
+static int cic_flow_insert_tfts(const char *session_id, const char *client_ip,
+                                const char (*tfts)[256], int count,
+                                uint8_t direction, uint32_t bearer_id) {
+  int added = 0;
+
+  for (int i = 0; i < count; i++) {
+    TFTRule parsed;
+    if (tft_parse_rule(tfts[i], &parsed) != 0 || !parsed.is_valid)
+      continue;
+
+    MagicFlowRule rule;
+    magic_flow_rule_from_tft(&parsed, client_ip, direction, &rule);
+    strncpy(rule.session_id, session_id, sizeof(rule.session_id) - 1);
+    rule.precedence = (uint16_t)i;
+    rule.tft_index = (uint8_t)i;
+    rule.bearer_id = bearer_id;
+    if (magic_flow_insert(&g_ctx->flow_ctx, &rule) >= 0)
+      added++;
+  }
+
+  return added;
+}
+
+/**
+ * @brief 将会话已下发的 TFT (两个方向) 登记到全局流分类器。
+ * @details 先清除该会话旧的登记 (MCCR 修改时 TFT 可能变化)，再按方向
+ *          分别插入。流量监控按连接五元组经此归属到会话。
+ *
+ * @param session_id 会话 ID。
+ * @param client_ip 客户端 IP (可为 NULL)。
+ * @param params 通信请求参数。
+ * @param bearer_id 会话当前承载 ID。
+ */
+static void cic_flow_register_tfts(const char *session_id,
+                                   const char *client_ip,
+                                   const CommReqParams *params,
+                                   uint32_t bearer_id) {
+  magic_flow_remove_session(&g_ctx->flow_ctx, session_id);
+
+  int to_ground = cic_flow_insert_tfts(
+      session_id, client_ip, params->tft_to_ground, params->tft_to_ground_count,
+      FLOW_DIR_TO_GROUND, bearer_id);
+  int to_aircraft = cic_flow_insert_tfts(
+      session_id, client_ip, params->tft_to_aircraft,
+      params->tft_to_aircraft_count, FLOW_DIR_TO_AIRCRAFT, bearer_id);
+
+  if (to_ground + to_aircraft > 0) {
+    fd_log_debug("[app_magic]     Flow classifier: %d+%d TFT(s) registered "
+                 "for %s",
+                 to_ground, to_aircraft, session_id);
+  }
+}
+
 /**
  * @brief MCAR 场景 C: TFT/NAPT 白名单验证。
  * @details 验证 TFT 和 NAPT 规则是否符合用户配置文件中的白名单限制。
@@ -1835,6 +2183,12 @@ static int mcar_validate_tft_napt_whitelist(McarProcessContext *ctx) {
     fd_log_notice("[app_magic]   ✓ All %d TFT-to-Ground rules passed whitelist "
                   "validation",
                   ctx->comm_params.tft_to_ground_count);
+
+    cic_flow_check_conflicts(ctx->session_id,
+                             cic_flow_client_ip(ctx->profile, ctx->session),
+                             ctx->comm_params.tft_to_ground,
+                             ctx->comm_params.tft_to_ground_count,
+                             FLOW_DIR_TO_GROUND);
   }
 
   if (ctx->comm_params.tft_to_aircraft_count > 0) {
@@ -1862,6 +2216,12 @@ static int mcar_validate_tft_napt_whitelist(McarProcessContext *ctx) {
     fd_log_notice("[app_magic]   ✓ All %d TFT-to-Aircraft rules passed "
                   "whitelist validation",
                   ctx->comm_params.tft_to_aircraft_count);
+
+    cic_flow_check_conflicts(ctx->session_id,
+                             cic_flow_client_ip(ctx->profile, ctx->session),
+                             ctx->comm_params.tft_to_aircraft,
+                             ctx->comm_params.tft_to_aircraft_count,
+                             FLOW_DIR_TO_AIRCRAFT);
   }
 
   /* NAPT 白名单验证 */
@@ -1891,134 +2251,21 @@ static int mcar_validate_tft_napt_whitelist(McarProcessContext *ctx) {
 }
 
 /**
- * @brief MCAR Step 4: 0-RTT 资源申请 (场景 C)。
- * @details 调用策略引擎选择最佳链路，并通过 MIH 向 DLM 申请带宽资源。
- *          支持链路回退机制、RFC 削峰、TFT/NAPT配置下发。
+ * @brief MCAR Step 4 收尾: 落地资源分配结果。
+ * @details 分配失败时设置错误码；成功时更新会话为 ACTIVE 并下发数据平面路由、
+ *          TFT mangle 规则、流量监控与 CDR。同步路径与定时器续跑路径共用。
  *
  * @param ctx MCAR 处理上下文。
+ * @param status mcar_alloc_advance 的最终结果 (DONE 或 FAILED)。
  */
-static void mcar_step4_allocation(McarProcessContext *ctx) {
-  if (!ctx->has_comm_req_params) {
-    return; /* 场景 A/B：无需分配带宽 */
-  }
-
-  fd_log_notice("[app_magic] → Step 4: 0-RTT Resource Allocation");
-
-  /* 初始化本步骤的运行状态 */
-  ctx->resource_allocated = false;
-  ctx->route_added = false;
-  ctx->retry_count = 0;
-  ctx->tried_link_count = 0;
-  ctx->extracted_dest_ip[0] = '\0';
-
-  /* 4.1 从 Profile 填充缺失的默认值 */
-  if (ctx->profile) {
-    comm_req_params_fill_from_profile(&ctx->comm_params, ctx->profile);
-  }
-
-  /* 4.1b 安全校验：TFT/NAPT 白名单验证（失败则保持认证成功但拒绝资源分配） */
-  if (mcar_validate_tft_napt_whitelist(ctx) != 0) {
-    fd_log_notice("[app_magic]   ⚠ Auth OK, but security validation failed; "
-                  "skip allocation");
-    return;
-  }
-
-  /* 4.1c 从 TFT 提取目的 IP（用于 dataplane 精确控制） */
-  mcar_extract_dest_ip_from_tft(ctx);
-
-  /* 4.2 v2.0: 校验请求是否超限 (削峰) - 使用 bandwidth.max_forward_kbps */
-  if (ctx->profile && ctx->profile->bandwidth.max_forward_kbps > 0) {
-    float max_fwd = (float)ctx->profile->bandwidth.max_forward_kbps;
-    float max_ret = (float)ctx->profile->bandwidth.max_return_kbps;
-    if (max_ret == 0)
-      max_ret = max_fwd; /* 如果没有返回带宽限制，使用前向限制 */
-
-    if (ctx->comm_params.requested_bw > max_fwd) {
-      fd_log_notice(
-          "[app_magic]   ⚠ Capping requested FWD BW from %.0f to %.0f kbps",
-          ctx->comm_params.requested_bw, max_fwd);
-      ctx->comm_params.requested_bw = max_fwd;
-    }
-    if (ctx->comm_params.requested_ret_bw > max_ret) {
-      fd_log_notice(
-          "[app_magic]   ⚠ Capping requested RET BW from %.0f to %.0f kbps",
-          ctx->comm_params.requested_ret_bw, max_ret);
-      ctx->comm_params.requested_ret_bw = max_ret;
-    }
-  }
-
-  /* 4.3 调用策略引擎 (CM) 进行链路选择 */
-  PolicyRequest policy_req;
-  memset(&policy_req, 0, sizeof(policy_req));
-
-  strncpy(policy_req.client_id, ctx->client_id,
-          sizeof(policy_req.client_id) - 1);
-  strncpy(policy_req.profile_name, ctx->comm_params.profile_name,
-          sizeof(policy_req.profile_name) - 1);
-  policy_req.requested_bw_kbps = (uint32_t)ctx->comm_params.requested_bw;
-  policy_req.requested_ret_bw_kbps =
-      (uint32_t)ctx->comm_params.requested_ret_bw;
-  policy_req.required_bw_kbps = (uint32_t)ctx->comm_params.required_bw;
-  policy_req.required_ret_bw_kbps = (uint32_t)ctx->comm_params.required_ret_bw;
-  policy_req.priority_class = (uint8_t)atoi(ctx->comm_params.priority_class);
-  policy_req.qos_level = (uint8_t)ctx->comm_params.qos_level;
-  strncpy(policy_req.flight_phase, ctx->comm_params.flight_phase,
-          sizeof(policy_req.flight_phase) - 1);
-
-  /* v2.2: 从 ADIF 获取实时位置和 WoW 数据用于策略决策 */
-  AdifAircraftState adif_state;
-  if (adif_client_get_state(&g_ctx->adif_ctx, &adif_state) == 0 &&
-      adif_state.data_valid) {
-    policy_req.aircraft_lat = adif_state.position.latitude;
-    policy_req.aircraft_lon = adif_state.position.longitude;
-    policy_req.aircraft_alt = adif_state.position.altitude_ft * 0.3048;
-    policy_req.on_ground = adif_state.wow.on_ground;
-    policy_req.has_adif_data = true;
-    fd_log_debug(
-        "[app_magic]   ADIF Data: lat=%.4f, lon=%.4f, alt=%.0fm, WoW=%s",
-        policy_req.aircraft_lat, policy_req.aircraft_lon,
-        policy_req.aircraft_alt, policy_req.on_ground ? "Ground" : "Airborne");
-  } else {
-    policy_req.aircraft_lat = 0.0;
-    policy_req.aircraft_lon = 0.0;
-    policy_req.aircraft_alt = 0.0;
-    policy_req.on_ground = false;
-    policy_req.has_adif_data = false;
-  }
-
-  memset(&ctx->policy_resp, 0, sizeof(ctx->policy_resp));
-
-  if (magic_policy_select_path(&g_ctx->policy_ctx, &policy_req,
-                               &ctx->policy_resp) != 0 ||
-      !ctx->policy_resp.success) {
-    /* 策略决策失败 - 保持 AUTHENTICATED 状态 (允许登录但不给网) */
-    fd_log_error("[app_magic]   ✗ Policy decision failed: %s",
-                 ctx->policy_resp.reason);
-    ctx->magic_status_code = 1010; /* NO_ENTRY_IN_BANDWIDTHTABLE / NO_BW */
-    ctx->error_message = "Auth OK, but bandwidth allocation failed (policy)";
-    ctx->resource_allocated = false;
+static void mcar_step4_finish(McarProcessContext *ctx, LinkAllocStatus status) {
+  if (status != LINK_ALLOC_DONE) {
+    fd_log_error("[app_magic]   ✗ All link resource requests failed (MCAR)");
+    ctx->magic_status_code = 1010; /* NO_BW */
+    ctx->error_message = "Auth OK, but bandwidth allocation failed (MIH)";
     return;
   }
 
-  fd_log_notice("[app_magic]   ✓ Policy Decision: Link=%s, BW=%u/%u kbps",
-                ctx->policy_resp.selected_link_id,
-                ctx->policy_resp.granted_bw_kbps,
-                ctx->policy_resp.granted_ret_bw_kbps);
-
-  /* 4.4 通过 MIH 请求链路资源（带重试 + 回退） */
-  memset(&ctx->mih_confirm, 0, sizeof(ctx->mih_confirm));
-  mcar_mark_link_tried(ctx, ctx->policy_resp.selected_link_id);
-
-  if (mcar_try_link_with_retry(ctx, ctx->policy_resp.selected_link_id,
-                               &ctx->policy_resp, &ctx->mih_confirm) != 0) {
-    if (mcar_try_fallback_links(ctx) != 0) {
-      fd_log_error("[app_magic]   ✗ All link resource requests failed (MCAR)");
-      ctx->magic_status_code = 1010; /* NO_BW */
-      ctx->error_message = "Auth OK, but bandwidth allocation failed (MIH)";
-      return;
-    }
-  }
-
   fd_log_notice(
       "[app_magic]   ✓ MIH Link Resource Allocated: Bearer=%u, Retries=%u",
       ctx->mih_confirm.has_bearer_id ? ctx->mih_confirm.bearer_identifier : 0,
@@ -2173,6 +2420,8 @@ static void mcar_step4_allocation(McarProcessContext *ctx) {
         fd_log_notice("[app_magic]     → No TFT-to-Ground rules specified, "
                       "skipping TFT mangle rules");
       }
+      cic_flow_register_tfts(ctx->session_id, client_ip, &ctx->comm_params,
+                             ctx->session ? ctx->session->bearer_id : 0);
 
       /* 4.6.4 注册流量监控 */
       uint32_t traffic_mark = traffic_register_session(
@@ -2198,16 +2447,148 @@ static void mcar_step4_allocation(McarProcessContext *ctx) {
 }
 
 /**
- * @brief MCAR Step 5: 构建并发送应答。
- * @details 构造 MCAA (Client Authentication Answer) 消息并发送。
- *          包含 Standard AVP, Magic-Status-Code, Error-Message, Policy-Answer
- * 等。 处理所有 MCAR 场景 (A/B/C) 的应答差异。
+ * @brief MCAR Step 4: 0-RTT 资源申请 (场景 C)。
+ * @details 调用策略引擎选择最佳链路，并通过 MIH 向 DLM 申请带宽资源。
+ *          支持链路回退机制、RFC 削峰、TFT/NAPT配置下发。
+ *          首次 MIH 请求失败时不在分发线程中等待，而是返回 1，
+ *          由调用方挂起请求并交给定时器重试 (见 mcar_alloc_resume)。
  *
- * @param msg Diameter 消息指针的指针 (输入为请求，输出为应答)。
  * @param ctx MCAR 处理上下文。
- * @return 0 成功，-1 失败。
+ * @return 0 本步骤已完成，1 资源请求已挂起等待重试。
  */
-static int mcar_step5_finalize(struct msg **msg, McarProcessContext *ctx) {
+static int mcar_step4_allocation(McarProcessContext *ctx) {
+  if (!ctx->has_comm_req_params) {
+    return 0; /* 场景 A/B：无需分配带宽 */
+  }
+
+  fd_log_notice("[app_magic] → Step 4: 0-RTT Resource Allocation");
+
+  /* 初始化本步骤的运行状态 */
+  ctx->resource_allocated = false;
+  ctx->route_added = false;
+  ctx->retry_count = 0;
+  ctx->tried_link_count = 0;
+  ctx->extracted_dest_ip[0] = '\0';
+
+  /* 4.1 从 Profile 填充缺失的默认值 */
+  if (ctx->profile) {
+    comm_req_params_fill_from_profile(&ctx->comm_params, ctx->profile);
+  }
+
+  /* 4.1b 安全校验：TFT/NAPT 白名单验证（失败则保持认证成功但拒绝资源分配） */
+  if (mcar_validate_tft_napt_whitelist(ctx) != 0) {
+    fd_log_notice("[app_magic]   ⚠ Auth OK, but security validation failed; "
+                  "skip allocation");
+    return 0;
+  }
+
+  /* 4.1c 从 TFT 提取目的 IP（用于 dataplane 精确控制） */
+  mcar_extract_dest_ip_from_tft(ctx);
+
+  /* 4.2 v2.0: 校验请求是否超限 (削峰) - 使用 bandwidth.max_forward_kbps */
+  if (ctx->profile && ctx->profile->bandwidth.max_forward_kbps > 0) {
+    float max_fwd = (float)ctx->profile->bandwidth.max_forward_kbps;
+    float max_ret = (float)ctx->profile->bandwidth.max_return_kbps;
+    if (max_ret == 0)
+      max_ret = max_fwd; /* 如果没有返回带宽限制，使用前向限制 */
+
+    if (ctx->comm_params.requested_bw > max_fwd) {
+      fd_log_notice(
+          "[app_magic]   ⚠ Capping requested FWD BW from %.0f to %.0f kbps",
+          ctx->comm_params.requested_bw, max_fwd);
+      ctx->comm_params.requested_bw = max_fwd;
+    }
+    if (ctx->comm_params.requested_ret_bw > max_ret) {
+      fd_log_notice(
+          "[app_magic]   ⚠ Capping requested RET BW from %.0f to %.0f kbps",
+          ctx->comm_params.requested_ret_bw, max_ret);
+      ctx->comm_params.requested_ret_bw = max_ret;
+    }
+  }
+
+  /* 4.3 调用策略引擎 (CM) 进行链路选择 */
+  PolicyRequest policy_req;
+  memset(&policy_req, 0, sizeof(policy_req));
+
+  strncpy(policy_req.client_id, ctx->client_id,
+          sizeof(policy_req.client_id) - 1);
+  strncpy(policy_req.profile_name, ctx->comm_params.profile_name,
+          sizeof(policy_req.profile_name) - 1);
+  policy_req.requested_bw_kbps = (uint32_t)ctx->comm_params.requested_bw;
+  policy_req.requested_ret_bw_kbps =
+      (uint32_t)ctx->comm_params.requested_ret_bw;
+  policy_req.required_bw_kbps = (uint32_t)ctx->comm_params.required_bw;
+  policy_req.required_ret_bw_kbps = (uint32_t)ctx->comm_params.required_ret_bw;
+  policy_req.priority_class = (uint8_t)atoi(ctx->comm_params.priority_class);
+  policy_req.qos_level = (uint8_t)ctx->comm_params.qos_level;
+  strncpy(policy_req.flight_phase, ctx->comm_params.flight_phase,
+          sizeof(policy_req.flight_phase) - 1);
+
+  /* v2.2: 从 ADIF 获取实时位置和 WoW 数据用于策略决策 */
+  AdifAircraftState adif_state;
+  if (adif_client_get_state(&g_ctx->adif_ctx, &adif_state) == 0 &&
+      adif_state.data_valid) {
+    policy_req.aircraft_lat = adif_state.position.latitude;
+    policy_req.aircraft_lon = adif_state.position.longitude;
+    policy_req.aircraft_alt = adif_state.position.altitude_ft * 0.3048;
+    policy_req.on_ground = adif_state.wow.on_ground;
+    policy_req.has_adif_data = true;
+    fd_log_debug(
+        "[app_magic]   ADIF Data: lat=%.4f, lon=%.4f, alt=%.0fm, WoW=%s",
+        policy_req.aircraft_lat, policy_req.aircraft_lon,
+        policy_req.aircraft_alt, policy_req.on_ground ? "Ground" : "Airborne");
+  } else {
+    policy_req.aircraft_lat = 0.0;
+    policy_req.aircraft_lon = 0.0;
+    policy_req.aircraft_alt = 0.0;
+    policy_req.on_ground = false;
+    policy_req.has_adif_data = false;
+  }
+
+  memset(&ctx->policy_resp, 0, sizeof(ctx->policy_resp));
+
+  if (magic_policy_select_path(&g_ctx->policy_ctx, &policy_req,
+                               &ctx->policy_resp) != 0 ||
+      !ctx->policy_resp.success) {
+    /* 策略决策失败 - 保持 AUTHENTICATED 状态 (允许登录但不给网) */
+    fd_log_error("[app_magic]   ✗ Policy decision failed: %s",
+                 ctx->policy_resp.reason);
+    ctx->magic_status_code = 1010; /* NO_ENTRY_IN_BANDWIDTHTABLE / NO_BW */
+    ctx->error_message = "Auth OK, but bandwidth allocation failed (policy)";
+    ctx->resource_allocated = false;
+    return 0;
+  }
+
+  fd_log_notice("[app_magic]   ✓ Policy Decision: Link=%s, BW=%u/%u kbps",
+                ctx->policy_resp.selected_link_id,
+                ctx->policy_resp.granted_bw_kbps,
+                ctx->policy_resp.granted_ret_bw_kbps);
+
+  /* 4.4 通过 MIH 请求链路资源（失败时定时重试 + 回退，不阻塞分发线程） */
+  memset(&ctx->mih_confirm, 0, sizeof(ctx->mih_confirm));
+  mcar_mark_link_tried(ctx, ctx->policy_resp.selected_link_id);
+  ctx->link_attempt = 0;
+
+  LinkAllocStatus alloc_status = mcar_alloc_advance(ctx);
+  if (alloc_status == LINK_ALLOC_RETRY_LATER) {
+    return 1;
+  }
+
+  mcar_step4_finish(ctx, alloc_status);
+  return 0;
+}
+
+/**
+ * @brief MCAR Step 5: 构建并发送应答。
+ * @details 构造 MCAA (Client Authentication Answer) 消息并发送。
+ *          包含 Standard AVP, Magic-Status-Code, Error-Message, Policy-Answer
+ * 等。 处理所有 MCAR 场景 (A/B/C) 的应答差异。
+ *
+ * @param msg Diameter 消息指针的指针 (输入为请求，输出为应答)。
+ * @param ctx MCAR 处理上下文。
+ * @return 0 成功，-1 失败。
+ */
+static int mcar_step5_finalize(struct msg **msg, McarProcessContext *ctx) {
   struct msg *ans;
 
   fd_log_notice("[app_magic] → Step 5: Finalize Response");
@@ -2329,6 +2710,92 @@ static int mcar_step5_finalize(struct msg **msg, McarProcessContext *ctx) {
   return 0;
 }
 
+static void mcar_alloc_resume(void *arg);
+
+/**
+ * @brief 挂起 MCAR 请求并安排资源请求重试 (MCAR Helper)。
+ * @details 保留原始请求消息，MCAR_RETRY_DELAY_MS 后由定时器线程调用
+ *          mcar_alloc_resume 继续分配；分发线程随即返回，不再阻塞其他客户端。
+ *
+ * @param ctx MCAR 处理上下文 (堆分配，所有权转交定时器)。
+ * @param qry 原始 MCAR 请求。
+ * @return 0 已挂起，-1 调度失败 (所有权仍归调用方)。
+ */
+static int mcar_park(McarProcessContext *ctx, struct msg *qry) {
+  /* 续跑时沿用请求开始时的配置版本，期间的重载不影响本请求 */
+  bool fresh_hold = !ctx->config_snap;
+  if (fresh_hold) {
+    ctx->config_snap = magic_config_hold(&g_ctx->config_store);
+  }
+
+  ctx->pending_qry = qry;
+  if (magic_timer_schedule(&g_ctx->timer_ctx, MCAR_RETRY_DELAY_MS,
+                           mcar_alloc_resume, ctx) != 0) {
+    fd_log_error("[app_magic]   ✗ Failed to schedule MCAR retry: session=%s",
+                 ctx->session_id);
+    if (fresh_hold) {
+      magic_config_release(&g_ctx->config_store, ctx->config_snap);
+      ctx->config_snap = NULL;
+    }
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief MCAR 资源请求重试的定时器续跑入口。
+ * @details 在定时器线程中推进分配状态机；仍需等待则再次挂起，
+ *          否则完成 Step 4 收尾并从此处发送 MCAA，最后释放上下文。
+ *
+ * @param arg 挂起的 MCAR 处理上下文。
+ */
+static void mcar_alloc_resume(void *arg) {
+  McarProcessContext *ctx = (McarProcessContext *)arg;
+  MagicConfigSnapshot *prev_snap =
+      magic_config_pin(&g_ctx->config_store, ctx->config_snap);
+
+  fd_log_notice("[app_magic] MCAR resume: session=%s, link=%s",
+                ctx->session_id, ctx->policy_resp.selected_link_id);
+
+  /* 扩展卸载时定时器冲刷剩余任务，不再发起 MIH 请求，直接失败应答 */
+  LinkAllocStatus status =
+      g_ctx->running ? mcar_alloc_advance(ctx) : LINK_ALLOC_FAILED;
+  if (status == LINK_ALLOC_RETRY_LATER) {
+    if (mcar_park(ctx, ctx->pending_qry) == 0) {
+      magic_config_unpin(&g_ctx->config_store, prev_snap);
+      return;
+    }
+    status = LINK_ALLOC_FAILED;
+  }
+
+  /* 挂起期间会话可能已被 STR 终止，重新查找而不是信任旧指针 */
+  ctx->session = magic_session_find_by_id(&g_ctx->session_mgr, ctx->session_id);
+  if (!ctx->session && status == LINK_ALLOC_DONE) {
+    fd_log_notice("[app_magic]   ⚠ Session %s closed while allocating, "
+                  "releasing bearer on %s",
+                  ctx->session_id, ctx->policy_resp.selected_link_id);
+    cic_release_link_resource(ctx->policy_resp.selected_link_id,
+                              ctx->mih_confirm.has_bearer_id
+                                  ? ctx->mih_confirm.bearer_identifier
+                                  : 0);
+    magic_admission_release(&g_ctx->admission_ctx, ctx->session_id);
+    status = LINK_ALLOC_FAILED;
+  }
+
+  mcar_step4_finish(ctx, status);
+
+  if (mcar_step5_finalize(&ctx->pending_qry, ctx) != 0) {
+    fd_log_error("[app_magic] ✗ Failed to send deferred MCAA");
+    if (ctx->pending_qry) {
+      fd_msg_free(ctx->pending_qry);
+    }
+  }
+
+  magic_config_unpin(&g_ctx->config_store, prev_snap);
+  magic_config_release(&g_ctx->config_store, ctx->config_snap);
+  free(ctx);
+}
+
 /**
  * @brief MCAR (Client Authentication Request) 主处理器。
  * @details 协调执行 MCAR 处理的 5 步流水线：
@@ -2339,6 +2806,9 @@ static int mcar_step5_finalize(struct msg **msg, McarProcessContext *ctx) {
  *          4. Resource Allocation
  *          5. Finalize Response
  *
+ *          若 Step 4 的首次 MIH 请求失败，请求被挂起 (`*msg` 置 NULL)，
+ *          MCAA 稍后由 mcar_alloc_resume 发送。
+ *
  * @param msg Diameter 消息指针。
  * @param avp 触发 AVP (未使用)。
  * @param sess 会话对象。
@@ -2363,43 +2833,57 @@ static int cic_handle_mcar(struct msg **msg, struct avp *avp,
   fd_log_notice("[app_magic] MCAR (Client Authentication Request)");
   fd_log_notice("[app_magic] ========================================");
 
-  /* 初始化处理上下文 */
-  McarProcessContext ctx;
-  memset(&ctx, 0, sizeof(ctx));
-  ctx.granted_lifetime = 3600; /* 默认 1 小时 */
-  ctx.auth_grace_period = 300; /* 默认 5 分钟 */
-  ctx.result_code = 2001;      /* 默认成功 */
+  /* 初始化处理上下文 (堆分配: 挂起重试时所有权转交定时器) */
+  McarProcessContext *ctx = calloc(1, sizeof(*ctx));
+  if (!ctx) {
+    fd_log_error("[app_magic] ✗ Out of memory for MCAR context");
+    return -1;
+  }
+  ctx->granted_lifetime = 3600; /* 默认 1 小时 */
+  ctx->auth_grace_period = 300; /* 默认 5 分钟 */
+  ctx->result_code = 2001;      /* 默认成功 */
 
   /* Step 1: 格式解析与安全校验 */
-  if (mcar_step1_validation(qry, &ctx) != 0) {
+  if (mcar_step1_validation(qry, ctx) != 0) {
     goto finalize; /* 校验失败，直接返回错误 */
   }
 
   /* Step 2: 身份鉴权 */
-  if (mcar_step2_auth(&ctx) != 0) {
+  if (mcar_step2_auth(ctx) != 0) {
     goto finalize; /* 认证失败，返回错误 */
   }
 
   /* Step 3: 订阅处理 (场景 B) */
-  mcar_step3_subscription(&ctx);
+  mcar_step3_subscription(ctx);
 
   /* Step 3b: ARINC 839 会话激活条件验证 (v2.3) */
-  if (mcar_step3b_session_conditions(&ctx) != 0) {
+  if (mcar_step3b_session_conditions(ctx) != 0) {
     goto finalize; /* 会话激活条件不满足，返回错误 */
   }
 
   /* Step 4: 0-RTT 资源申请 (场景 C) */
-  mcar_step4_allocation(&ctx);
+  if (mcar_step4_allocation(ctx) != 0) {
+    if (mcar_park(ctx, qry) == 0) {
+      *msg = NULL; /* 请求已挂起，MCAA 由 mcar_alloc_resume 发送 */
+      fd_log_notice("[app_magic] MCAR deferred: retry in %d ms",
+                    MCAR_RETRY_DELAY_MS);
+      fd_log_notice("[app_magic] ========================================\n");
+      return 0;
+    }
+    mcar_step4_finish(ctx, LINK_ALLOC_FAILED);
+  }
 
 finalize:
   /* Step 5: 构建并发送应答 */
-  if (mcar_step5_finalize(msg, &ctx) != 0) {
+  if (mcar_step5_finalize(msg, ctx) != 0) {
     fd_log_error("[app_magic] ✗ Failed to send MCAA");
     fd_log_notice("[app_magic] ========================================\n");
+    free(ctx);
     return -1;
   }
 
   fd_log_notice("[app_magic] ========================================\n");
+  free(ctx);
   return 0;
 }
 
@@ -2436,13 +2920,29 @@ typedef enum {
 
 /*===========================================================================
  * 排队队列管理结构
+ *
+ * 存储池 + 三个索引，均由 g_mccr_queue.lock 保护:
+ * - 二叉堆: 按 (priority, 入队序号) 排序，O(log n) 入队/出队，O(1) 取队首
+ * - Session-ID 哈希表: O(1) 按会话查找 (更新/出队/取消)
+ * - 入队顺序链表: 超时时间 = 入队时间 + 常量，链表头即最早过期条目，
+ *   过期清理为 O(过期数)
+ *
+ * 链路 UP、带宽释放 (CloseLink) 和会话关闭 (STR) 会唤醒调度器
+ * (mccr_queue_kick)，调度器在定时器线程中按优先级依次为排队请求分配资源。
  *===========================================================================*/
 
-#define MCCR_QUEUE_MAX_SIZE 64    /* 最大排队请求数 */
-#define MCCR_QUEUE_TIMEOUT_SEC 30 /* 排队超时时间(秒) */
-#define MCCR_RETRY_MAX_COUNT 3    /* 最大重试次数 */
-#define MCCR_RETRY_DELAY_MS 100   /* 重试间隔(毫秒) */
-#define MCCR_FALLBACK_MAX_LINKS 4 /* 最大回退链路数 */
+#define MCCR_QUEUE_MAX_SIZE 64      /* 最大排队请求数 */
+#define MCCR_QUEUE_TIMEOUT_SEC 30   /* 排队超时时间(秒) */
+#define MCCR_QUEUE_HASH_BUCKETS 128 /* Session-ID 哈希桶数 (2 的幂) */
+#define MCCR_QUEUE_WAIT_BUCKETS 8   /* 等待时间直方图桶数 */
+#define MCCR_QUEUE_RECHECK_MS 1000  /* 队列非空时调度器复查间隔(毫秒) */
+#define MCCR_RETRY_MAX_COUNT 3      /* 最大重试次数 */
+#define MCCR_RETRY_DELAY_MS 100     /* 重试间隔(毫秒) */
+#define MCCR_FALLBACK_MAX_LINKS 4   /* 最大回退链路数 */
+
+/* 等待时间直方图上界 (毫秒)，最后一个桶收纳其余 */
+static const uint32_t g_mccr_wait_bounds_ms[MCCR_QUEUE_WAIT_BUCKETS - 1] = {
+    100, 500, 1000, 2000, 5000, 10000, 30000};
 
 /* 排队条目状态 */
 typedef enum {
@@ -2455,31 +2955,163 @@ typedef enum {
 
 /* 排队条目结构 */
 typedef struct {
-  bool in_use;                /* 是否在使用 */
-  MccxQueueState state;       /* 条目状态 */
-  char session_id[128];       /* 会话 ID */
-  char client_id[MAX_ID_LEN]; /* 客户端 ID */
-  CommReqParams params;       /* 通信参数 */
-  time_t enqueue_time;        /* 入队时间 */
-  time_t expire_time;         /* 过期时间 */
-  uint32_t retry_count;       /* 重试次数 */
-  uint32_t priority;          /* 优先级 (数字越小越高) */
+  bool in_use;                   /* 是否在使用 */
+  MccxQueueState state;          /* 条目状态 */
+  char session_id[128];          /* 会话 ID */
+  char client_id[MAX_ID_LEN];    /* 客户端 ID */
+  char client_realm[MAX_ID_LEN]; /* 客户端域 (授予时创建会话用) */
+  char extracted_dest_ip[64];    /* 从 TFT 提取的目的 IP */
+  CommReqParams params;          /* 通信参数 */
+  time_t enqueue_time;           /* 入队时间 */
+  time_t expire_time;            /* 过期时间 */
+  uint64_t enqueue_ms;           /* 入队时间 (单调时钟, 用于等待直方图) */
+  uint64_t seq;                  /* 入队序号 (同优先级先到先服务) */
+  uint32_t retry_count;          /* 重试次数 */
+  uint32_t priority;             /* 优先级 (数字越小越高) */
+  int heap_pos;                  /* 在堆中的位置 */
+  int hash_next;                 /* 哈希链下一槽位 (-1 = 链尾) */
+  int age_prev;                  /* 入队顺序链表前驱 (-1 = 无) */
+  int age_next;                  /* 入队顺序链表后继 (-1 = 无) */
 } MccxQueueEntry;
 
 /* 排队管理器结构 */
 typedef struct {
-  MccxQueueEntry entries[MCCR_QUEUE_MAX_SIZE]; /* 排队条目数组 */
+  MccxQueueEntry entries[MCCR_QUEUE_MAX_SIZE]; /* 排队条目存储池 */
+  int heap[MCCR_QUEUE_MAX_SIZE];               /* 二叉堆 (存槽位下标) */
+  int hash[MCCR_QUEUE_HASH_BUCKETS];           /* Session-ID 哈希桶 */
+  int free_slots[MCCR_QUEUE_MAX_SIZE];         /* 空闲槽位栈 */
+  int free_top;                                /* 空闲槽位数 */
+  int age_head;                                /* 最早入队条目 */
+  int age_tail;                                /* 最晚入队条目 */
   uint32_t count;                              /* 当前排队数量 */
-  pthread_mutex_t lock;                        /* 线程锁 */
-  bool initialized;                            /* 是否已初始化 */
+  uint64_t next_seq;                           /* 下一个入队序号 */
+  bool dispatch_scheduled;                     /* 调度器是否已排程 */
+
+  /* 统计 */
+  uint64_t total_enqueued;  /* 累计入队数 */
+  uint64_t total_granted;   /* 累计出队授予数 */
+  uint64_t total_expired;   /* 累计超时数 */
+  uint64_t total_cancelled; /* 累计取消数 */
+  uint64_t wait_granted[MCCR_QUEUE_WAIT_BUCKETS]; /* 授予前等待时间直方图 */
+  uint64_t wait_expired[MCCR_QUEUE_WAIT_BUCKETS]; /* 过期前等待时间直方图 */
+
+  pthread_mutex_t lock; /* 线程锁 */
+  bool initialized;     /* 是否已初始化 */
 } MccxQueueManager;
 
 /* 全局排队管理器 */
 static MccxQueueManager g_mccr_queue = {0};
 
+static void mccr_queue_dispatch(void *arg);
+
+/* Session-ID 哈希 (FNV-1a) */
+static uint32_t mccr_queue_hash(const char *session_id) {
+  return magic_fnv1a32_str(session_id) & (MCCR_QUEUE_HASH_BUCKETS - 1);
+}
+
+/* 堆序比较: 槽位 a 是否排在槽位 b 之前 (调用方持锁) */
+static bool mccr_queue_before(int a, int b) {
+  const MccxQueueEntry *ea = &g_mccr_queue.entries[a];
+  const MccxQueueEntry *eb = &g_mccr_queue.entries[b];
+  if (ea->priority != eb->priority)
+    return ea->priority < eb->priority;
+  return ea->seq < eb->seq;
+}
+
+static void mccr_queue_heap_set(int pos, int slot) {
+  g_mccr_queue.heap[pos] = slot;
+  g_mccr_queue.entries[slot].heap_pos = pos;
+}
+
+static void mccr_queue_sift_up(int pos) {
+  int slot = g_mccr_queue.heap[pos];
+  while (pos > 0) {
+    int parent = (pos - 1) / 2;
+    if (!mccr_queue_before(slot, g_mccr_queue.heap[parent]))
+      break;
+    mccr_queue_heap_set(pos, g_mccr_queue.heap[parent]);
+    pos = parent;
+  }
+  mccr_queue_heap_set(pos, slot);
+}
+
+static void mccr_queue_sift_down(int pos) {
+  int n = (int)g_mccr_queue.count;
+  int slot = g_mccr_queue.heap[pos];
+  for (;;) {
+    int child = 2 * pos + 1;
+    if (child >= n)
+      break;
+    if (child + 1 < n &&
+        mccr_queue_before(g_mccr_queue.heap[child + 1],
+                          g_mccr_queue.heap[child]))
+      child++;
+    if (!mccr_queue_before(g_mccr_queue.heap[child], slot))
+      break;
+    mccr_queue_heap_set(pos, g_mccr_queue.heap[child]);
+    pos = child;
+  }
+  mccr_queue_heap_set(pos, slot);
+}
+
+/* 按 Session-ID 查找槽位 (调用方持锁)，未找到返回 -1 */
+static int mccr_queue_find_locked(const char *session_id) {
+  int slot = g_mccr_queue.hash[mccr_queue_hash(session_id)];
+  while (slot >= 0) {
+    if (strcmp(g_mccr_queue.entries[slot].session_id, session_id) == 0)
+      return slot;
+    slot = g_mccr_queue.entries[slot].hash_next;
+  }
+  return -1;
+}
+
+/* 记录等待时间到直方图 (调用方持锁) */
+static void mccr_queue_record_wait(uint64_t *hist, const MccxQueueEntry *entry) {
+  uint64_t waited = magic_timer_now_ms() - entry->enqueue_ms;
+  int b = 0;
+  while (b < MCCR_QUEUE_WAIT_BUCKETS - 1 && waited >= g_mccr_wait_bounds_ms[b])
+    b++;
+  hist[b]++;
+}
+
+/* 从所有索引中移除槽位并归还存储池 (调用方持锁) */
+static void mccr_queue_remove_locked(int slot, MccxQueueState final_state) {
+  MccxQueueEntry *entry = &g_mccr_queue.entries[slot];
+
+  /* 堆: 用末尾元素填补空位后重新调整 */
+  int pos = entry->heap_pos;
+  g_mccr_queue.count--;
+  if (pos != (int)g_mccr_queue.count) {
+    mccr_queue_heap_set(pos, g_mccr_queue.heap[g_mccr_queue.count]);
+    mccr_queue_sift_up(pos);
+    mccr_queue_sift_down(g_mccr_queue.entries[g_mccr_queue.heap[pos]].heap_pos);
+  }
+
+  /* 哈希链 */
+  int *link = &g_mccr_queue.hash[mccr_queue_hash(entry->session_id)];
+  while (*link >= 0 && *link != slot)
+    link = &g_mccr_queue.entries[*link].hash_next;
+  if (*link == slot)
+    *link = entry->hash_next;
+
+  /* 入队顺序链表 */
+  if (entry->age_prev >= 0)
+    g_mccr_queue.entries[entry->age_prev].age_next = entry->age_next;
+  else
+    g_mccr_queue.age_head = entry->age_next;
+  if (entry->age_next >= 0)
+    g_mccr_queue.entries[entry->age_next].age_prev = entry->age_prev;
+  else
+    g_mccr_queue.age_tail = entry->age_prev;
+
+  entry->state = final_state;
+  entry->in_use = false;
+  g_mccr_queue.free_slots[g_mccr_queue.free_top++] = slot;
+}
+
 /**
  * @brief 初始化排队管理器。
- * @details 初始化排队队列的互斥锁和状态。
+ * @details 初始化排队队列的互斥锁、索引和空闲槽位栈。
  *          队列用于暂存无法立即满足的 MCCR 请求 (QueueLink)。
  */
 static void mccr_queue_init(void) {
@@ -2488,6 +3120,14 @@ static void mccr_queue_init(void) {
 
   memset(&g_mccr_queue, 0, sizeof(g_mccr_queue));
   pthread_mutex_init(&g_mccr_queue.lock, NULL);
+  for (int i = 0; i < MCCR_QUEUE_HASH_BUCKETS; i++) {
+    g_mccr_queue.hash[i] = -1;
+  }
+  for (int i = MCCR_QUEUE_MAX_SIZE - 1; i >= 0; i--) {
+    g_mccr_queue.free_slots[g_mccr_queue.free_top++] = i;
+  }
+  g_mccr_queue.age_head = -1;
+  g_mccr_queue.age_tail = -1;
   g_mccr_queue.initialized = true;
 
   fd_log_notice(
@@ -2497,8 +3137,8 @@ static void mccr_queue_init(void) {
 
 /**
  * @brief 清理过期的排队条目。
- * @details 遍历队列，检查并移除超过 `MCCR_QUEUE_TIMEOUT_SEC` 的请求。
- *          过期请求的状态将被标记为 `QUEUE_STATE_EXPIRED`。
+ * @details 从入队顺序链表头开始移除超过 `MCCR_QUEUE_TIMEOUT_SEC` 的请求，
+ *          遇到第一个未过期条目即停止。
  *
  * @return 清理的条目数量。
  */
@@ -2511,19 +3151,18 @@ static int mccr_queue_cleanup_expired(void) {
 
   pthread_mutex_lock(&g_mccr_queue.lock);
 
-  for (int i = 0; i < MCCR_QUEUE_MAX_SIZE; i++) {
-    MccxQueueEntry *entry = &g_mccr_queue.entries[i];
-    if (entry->in_use && entry->state == QUEUE_STATE_PENDING) {
-      if (now >= entry->expire_time) {
-        fd_log_notice(
-            "[app_magic] Queue entry expired: session=%s, waited=%lds",
-            entry->session_id, now - entry->enqueue_time);
-        entry->state = QUEUE_STATE_EXPIRED;
-        entry->in_use = false;
-        g_mccr_queue.count--;
-        cleaned++;
-      }
-    }
+  while (g_mccr_queue.age_head >= 0) {
+    int slot = g_mccr_queue.age_head;
+    MccxQueueEntry *entry = &g_mccr_queue.entries[slot];
+    if (now < entry->expire_time || entry->state != QUEUE_STATE_PENDING)
+      break;
+
+    fd_log_notice("[app_magic] Queue entry expired: session=%s, waited=%lds",
+                  entry->session_id, now - entry->enqueue_time);
+    mccr_queue_record_wait(g_mccr_queue.wait_expired, entry);
+    g_mccr_queue.total_expired++;
+    mccr_queue_remove_locked(slot, QUEUE_STATE_EXPIRED);
+    cleaned++;
   }
 
   pthread_mutex_unlock(&g_mccr_queue.lock);
@@ -2535,15 +3174,19 @@ static int mccr_queue_cleanup_expired(void) {
  * @brief 添加请求到排队队列。
  * @details 将 MCCR 请求加入等待队列。
  *          如果队列已满 (MCCR_QUEUE_MAX_SIZE)，则返回失败。
- *          如果已存在相同 Session-ID 的请求，则更新其参数和优先级。
+ *          如果已存在相同 Session-ID 的请求，则更新其参数和优先级
+ *          (保留原入队时间和过期时间)。
  *
  * @param session_id 会话 ID。
  * @param client_id 客户端 ID。
+ * @param client_realm 客户端域。
+ * @param dest_ip 从 TFT 提取的目的 IP (可为空串)。
  * @param params 通信请求参数。
  * @param priority 优先级值 (数字越小优先级越高)。
  * @return 0 成功入队，-1 队列已满。
  */
 static int mccr_queue_enqueue(const char *session_id, const char *client_id,
+                              const char *client_realm, const char *dest_ip,
                               const CommReqParams *params, uint32_t priority) {
   if (!g_mccr_queue.initialized) {
     mccr_queue_init();
@@ -2555,58 +3198,78 @@ static int mccr_queue_enqueue(const char *session_id, const char *client_id,
   pthread_mutex_lock(&g_mccr_queue.lock);
 
   /* 检查是否已存在相同会话的排队请求 */
-  for (int i = 0; i < MCCR_QUEUE_MAX_SIZE; i++) {
-    MccxQueueEntry *entry = &g_mccr_queue.entries[i];
-    if (entry->in_use && strcmp(entry->session_id, session_id) == 0) {
-      /* 更新已有请求 */
-      memcpy(&entry->params, params, sizeof(CommReqParams));
-      entry->priority = priority;
-      entry->retry_count++;
-      pthread_mutex_unlock(&g_mccr_queue.lock);
-      fd_log_notice("[app_magic] Queue entry updated: session=%s, retry=%u",
-                    session_id, entry->retry_count);
-      return 0;
-    }
+  int slot = mccr_queue_find_locked(session_id);
+  if (slot >= 0) {
+    /* 更新已有请求 */
+    MccxQueueEntry *entry = &g_mccr_queue.entries[slot];
+    memcpy(&entry->params, params, sizeof(CommReqParams));
+    strncpy(entry->extracted_dest_ip, dest_ip,
+            sizeof(entry->extracted_dest_ip) - 1);
+    entry->priority = priority;
+    entry->retry_count++;
+    mccr_queue_sift_up(entry->heap_pos);
+    mccr_queue_sift_down(entry->heap_pos);
+    pthread_mutex_unlock(&g_mccr_queue.lock);
+    fd_log_notice("[app_magic] Queue entry updated: session=%s, retry=%u",
+                  session_id, entry->retry_count);
+    return 0;
   }
 
   /* 队列已满检查 */
-  if (g_mccr_queue.count >= MCCR_QUEUE_MAX_SIZE) {
+  if (g_mccr_queue.free_top == 0) {
     pthread_mutex_unlock(&g_mccr_queue.lock);
     fd_log_error("[app_magic] Queue full, cannot enqueue: session=%s",
                  session_id);
     return -1;
   }
 
-  /* 查找空闲槽位 */
-  for (int i = 0; i < MCCR_QUEUE_MAX_SIZE; i++) {
-    MccxQueueEntry *entry = &g_mccr_queue.entries[i];
-    if (!entry->in_use) {
-      entry->in_use = true;
-      entry->state = QUEUE_STATE_PENDING;
-      strncpy(entry->session_id, session_id, sizeof(entry->session_id) - 1);
-      strncpy(entry->client_id, client_id, sizeof(entry->client_id) - 1);
-      memcpy(&entry->params, params, sizeof(CommReqParams));
-      entry->enqueue_time = time(NULL);
-      entry->expire_time = entry->enqueue_time + MCCR_QUEUE_TIMEOUT_SEC;
-      entry->retry_count = 0;
-      entry->priority = priority;
-      g_mccr_queue.count++;
-
-      pthread_mutex_unlock(&g_mccr_queue.lock);
-      fd_log_notice(
-          "[app_magic] Queue entry added: session=%s, priority=%u, count=%u/%d",
-          session_id, priority, g_mccr_queue.count, MCCR_QUEUE_MAX_SIZE);
-      return 0;
-    }
-  }
+  slot = g_mccr_queue.free_slots[--g_mccr_queue.free_top];
+  MccxQueueEntry *entry = &g_mccr_queue.entries[slot];
+  memset(entry, 0, sizeof(*entry));
+  entry->in_use = true;
+  entry->state = QUEUE_STATE_PENDING;
+  strncpy(entry->session_id, session_id, sizeof(entry->session_id) - 1);
+  strncpy(entry->client_id, client_id, sizeof(entry->client_id) - 1);
+  strncpy(entry->client_realm, client_realm, sizeof(entry->client_realm) - 1);
+  strncpy(entry->extracted_dest_ip, dest_ip,
+          sizeof(entry->extracted_dest_ip) - 1);
+  memcpy(&entry->params, params, sizeof(CommReqParams));
+  entry->enqueue_time = time(NULL);
+  entry->expire_time = entry->enqueue_time + MCCR_QUEUE_TIMEOUT_SEC;
+  entry->enqueue_ms = magic_timer_now_ms();
+  entry->seq = g_mccr_queue.next_seq++;
+  entry->priority = priority;
+
+  /* 哈希链头插 */
+  uint32_t bucket = mccr_queue_hash(session_id);
+  entry->hash_next = g_mccr_queue.hash[bucket];
+  g_mccr_queue.hash[bucket] = slot;
+
+  /* 入队顺序链表尾插 */
+  entry->age_prev = g_mccr_queue.age_tail;
+  entry->age_next = -1;
+  if (g_mccr_queue.age_tail >= 0)
+    g_mccr_queue.entries[g_mccr_queue.age_tail].age_next = slot;
+  else
+    g_mccr_queue.age_head = slot;
+  g_mccr_queue.age_tail = slot;
+
+  /* 堆尾插入后上浮 */
+  g_mccr_queue.count++;
+  mccr_queue_heap_set((int)g_mccr_queue.count - 1, slot);
+  mccr_queue_sift_up((int)g_mccr_queue.count - 1);
+  g_mccr_queue.total_enqueued++;
 
   pthread_mutex_unlock(&g_mccr_queue.lock);
-  return -1;
+  fd_log_notice(
+      "[app_magic] Queue entry added: session=%s, priority=%u, count=%u/%d",
+      session_id, priority, g_mccr_queue.count, MCCR_QUEUE_MAX_SIZE);
+  return 0;
 }
 
 /**
- * @brief 从队列中移除指定会话的请求。
- * @details 将指定 Session-ID 的请求标记为 COMPLETED 并从队列中移除。
+ * @brief 请求已获得资源，从队列中移除。
+ * @details 将指定 Session-ID 的请求标记为 COMPLETED 并记录等待时间。
  *
  * @param session_id 会话 ID。
  * @return 0 成功移除，-1 未找到。
@@ -2617,57 +3280,126 @@ static int mccr_queue_dequeue(const char *session_id) {
 
   pthread_mutex_lock(&g_mccr_queue.lock);
 
-  for (int i = 0; i < MCCR_QUEUE_MAX_SIZE; i++) {
-    MccxQueueEntry *entry = &g_mccr_queue.entries[i];
-    if (entry->in_use && strcmp(entry->session_id, session_id) == 0) {
-      entry->state = QUEUE_STATE_COMPLETED;
-      entry->in_use = false;
-      g_mccr_queue.count--;
-      pthread_mutex_unlock(&g_mccr_queue.lock);
-      fd_log_notice("[app_magic] Queue entry removed: session=%s", session_id);
-      return 0;
-    }
+  int slot = mccr_queue_find_locked(session_id);
+  if (slot < 0) {
+    pthread_mutex_unlock(&g_mccr_queue.lock);
+    return -1;
   }
 
+  mccr_queue_record_wait(g_mccr_queue.wait_granted,
+                         &g_mccr_queue.entries[slot]);
+  g_mccr_queue.total_granted++;
+  mccr_queue_remove_locked(slot, QUEUE_STATE_COMPLETED);
+
   pthread_mutex_unlock(&g_mccr_queue.lock);
-  return -1;
+  fd_log_notice("[app_magic] Queue entry removed: session=%s", session_id);
+  return 0;
 }
 
 /**
- * @brief 获取队列中最高优先级的待处理请求。
- * @details 遍历队列查找优先级最高 (数值最小) 的 PENDING 状态请求。
+ * @brief 取消指定会话的排队请求 (CloseLink / STR)。
  *
- * @return 指向最高优先级条目的指针，若队列为空则返回 NULL。
+ * @param session_id 会话 ID。
+ * @return 0 成功取消，-1 未找到。
  */
-static __attribute__((unused)) MccxQueueEntry *
-mccr_queue_peek_highest_priority(void) {
+static int mccr_queue_cancel(const char *session_id) {
   if (!g_mccr_queue.initialized)
-    return NULL;
+    return -1;
+
+  pthread_mutex_lock(&g_mccr_queue.lock);
+
+  int slot = mccr_queue_find_locked(session_id);
+  if (slot < 0) {
+    pthread_mutex_unlock(&g_mccr_queue.lock);
+    return -1;
+  }
+
+  g_mccr_queue.total_cancelled++;
+  mccr_queue_remove_locked(slot, QUEUE_STATE_CANCELLED);
+
+  pthread_mutex_unlock(&g_mccr_queue.lock);
+  fd_log_notice("[app_magic] Queue entry cancelled: session=%s", session_id);
+  return 0;
+}
+
+/**
+ * @brief 取出队列中最高优先级的待处理请求。
+ * @details 读取堆顶条目，复制到 `out` 并标记为 PROCESSING，
+ *          使调度器可在不持锁的情况下为其分配资源。
+ *
+ * @param out 输出参数，堆顶条目的副本。
+ * @return true 取到条目，false 队列为空或堆顶正在处理。
+ */
+static bool mccr_queue_take_highest_priority(MccxQueueEntry *out) {
+  if (!g_mccr_queue.initialized)
+    return false;
 
   mccr_queue_cleanup_expired();
 
   pthread_mutex_lock(&g_mccr_queue.lock);
 
-  MccxQueueEntry *best = NULL;
-  uint32_t best_priority = UINT32_MAX;
+  if (g_mccr_queue.count == 0) {
+    pthread_mutex_unlock(&g_mccr_queue.lock);
+    return false;
+  }
 
-  for (int i = 0; i < MCCR_QUEUE_MAX_SIZE; i++) {
-    MccxQueueEntry *entry = &g_mccr_queue.entries[i];
-    if (entry->in_use && entry->state == QUEUE_STATE_PENDING) {
-      if (entry->priority < best_priority) {
-        best_priority = entry->priority;
-        best = entry;
-      }
-    }
+  MccxQueueEntry *best = &g_mccr_queue.entries[g_mccr_queue.heap[0]];
+  if (best->state != QUEUE_STATE_PENDING) {
+    pthread_mutex_unlock(&g_mccr_queue.lock);
+    return false;
   }
 
-  if (best) {
-    best->state = QUEUE_STATE_PROCESSING;
+  best->state = QUEUE_STATE_PROCESSING;
+  memcpy(out, best, sizeof(*out));
+
+  pthread_mutex_unlock(&g_mccr_queue.lock);
+
+  return true;
+}
+
+/**
+ * @brief 资源分配失败后把条目放回 PENDING。
+ *
+ * @param session_id 会话 ID。
+ */
+static void mccr_queue_requeue(const char *session_id) {
+  pthread_mutex_lock(&g_mccr_queue.lock);
+  int slot = mccr_queue_find_locked(session_id);
+  if (slot >= 0) {
+    g_mccr_queue.entries[slot].state = QUEUE_STATE_PENDING;
+    g_mccr_queue.entries[slot].retry_count++;
   }
+  pthread_mutex_unlock(&g_mccr_queue.lock);
+}
+
+/**
+ * @brief 唤醒排队调度器。
+ * @details 在链路 UP、带宽释放、会话关闭后调用。多次唤醒在调度器运行前
+ *          合并为一次，调度在定时器线程中执行，不占用调用方线程。
+ *
+ * @param reason 唤醒原因 (仅用于日志)。
+ */
+static void mccr_queue_kick(const char *reason) {
+  if (!g_mccr_queue.initialized || !g_ctx)
+    return;
 
+  pthread_mutex_lock(&g_mccr_queue.lock);
+  bool need_schedule = g_mccr_queue.count > 0 && !g_mccr_queue.dispatch_scheduled;
+  if (need_schedule) {
+    g_mccr_queue.dispatch_scheduled = true;
+  }
   pthread_mutex_unlock(&g_mccr_queue.lock);
 
-  return best;
+  if (!need_schedule)
+    return;
+
+  fd_log_debug("[app_magic] Queue dispatcher woken: %s", reason);
+  if (magic_timer_schedule(&g_ctx->timer_ctx, 0, mccr_queue_dispatch, NULL) !=
+      0) {
+    pthread_mutex_lock(&g_mccr_queue.lock);
+    g_mccr_queue.dispatch_scheduled = false;
+    pthread_mutex_unlock(&g_mccr_queue.lock);
+  }
 }
 
 /**
@@ -2688,22 +3420,63 @@ static void mccr_queue_get_status(uint32_t *pending, uint32_t *total) {
 
   pthread_mutex_lock(&g_mccr_queue.lock);
 
-  uint32_t p = 0;
-  for (int i = 0; i < MCCR_QUEUE_MAX_SIZE; i++) {
-    if (g_mccr_queue.entries[i].in_use &&
-        g_mccr_queue.entries[i].state == QUEUE_STATE_PENDING) {
-      p++;
-    }
+  uint32_t processing = 0;
+  for (uint32_t i = 0; i < g_mccr_queue.count; i++) {
+    if (g_mccr_queue.entries[g_mccr_queue.heap[i]].state ==
+        QUEUE_STATE_PROCESSING)
+      processing++;
   }
 
   if (pending)
-    *pending = p;
+    *pending = g_mccr_queue.count - processing;
   if (total)
     *total = g_mccr_queue.count;
 
   pthread_mutex_unlock(&g_mccr_queue.lock);
 }
 
+/**
+ * @brief 输出队列统计与等待时间直方图到日志。
+ */
+static void mccr_queue_dump_stats(void) {
+  if (!g_mccr_queue.initialized)
+    return;
+
+  char granted[256] = "";
+  char expired[256] = "";
+  int og = 0, oe = 0;
+
+  pthread_mutex_lock(&g_mccr_queue.lock);
+
+  for (int b = 0; b < MCCR_QUEUE_WAIT_BUCKETS; b++) {
+    char label[16];
+    if (b < MCCR_QUEUE_WAIT_BUCKETS - 1)
+      snprintf(label, sizeof(label), "<%ums", g_mccr_wait_bounds_ms[b]);
+    else
+      snprintf(label, sizeof(label), ">=%ums", g_mccr_wait_bounds_ms[b - 1]);
+
+    og += snprintf(granted + og, sizeof(granted) - og, "%s%s:%llu",
+                   b ? " " : "", label,
+                   (unsigned long long)g_mccr_queue.wait_granted[b]);
+    oe += snprintf(expired + oe, sizeof(expired) - oe, "%s%s:%llu",
+                   b ? " " : "", label,
+                   (unsigned long long)g_mccr_queue.wait_expired[b]);
+  }
+
+  fd_log_notice("[app_magic] MCCR Queue: depth=%u enqueued=%llu granted=%llu "
+                "expired=%llu cancelled=%llu",
+                g_mccr_queue.count,
+                (unsigned long long)g_mccr_queue.total_enqueued,
+                (unsigned long long)g_mccr_queue.total_granted,
+                (unsigned long long)g_mccr_queue.total_expired,
+                (unsigned long long)g_mccr_queue.total_cancelled);
+
+  pthread_mutex_unlock(&g_mccr_queue.lock);
+
+  fd_log_notice("[app_magic]   Wait (granted): %s", granted);
+  fd_log_notice("[app_magic]   Wait (expired): %s", expired);
+}
+
 /*===========================================================================
  * MCCR 处理上下文
  *===========================================================================*/
@@ -2741,8 +3514,11 @@ typedef struct {
 
   /* 重试与回退控制 */
   uint32_t retry_count;                                  /* 当前重试次数 */
+  uint32_t link_attempt; /* 当前候选链路上已失败的尝试次数 */
   char tried_links[MCCR_FALLBACK_MAX_LINKS][MAX_ID_LEN]; /* 已尝试的链路 */
   int tried_link_count;                                  /* 已尝试链路数 */
+  struct msg *pending_qry; /* 挂起等待重试时保留的 MCCR 请求 */
+  MagicConfigSnapshot *config_snap; /* 挂起期间持有的配置版本 */
 
   /* 应答构建参数 */
   uint32_t result_code;       /* Diameter Result-Code */
@@ -2788,80 +3564,21 @@ static void mccr_mark_link_tried(MccxProcessContext *ctx, const char *link_id) {
 }
 
 /**
- * @brief 带重试机制的链路资源请求 (MCCR Helper)。
- * @details 向 LMI/DLM 发起资源请求。支持重试机制 (MCCR_RETRY_MAX_COUNT)。
- *
- * @param ctx MCCR 处理上下文。
- * @param link_id 目标链路 ID。
- * @param policy_resp 策略引擎返回的参数。
- * @param mih_confirm 输出参数，存储 MIH 确认结果。
- * @return 0 成功，-1 失败。
- */
-static int mccr_try_link_with_retry(MccxProcessContext *ctx,
-                                    const char *link_id,
-                                    PolicyResponse *policy_resp,
-                                    MIH_Link_Resource_Confirm *mih_confirm) {
-  int attempt;
-  int mih_result;
-
-  for (attempt = 0; attempt < MCCR_RETRY_MAX_COUNT; attempt++) {
-    if (attempt > 0) {
-      fd_log_notice("[app_magic]     → Retry attempt %d/%d for link %s",
-                    attempt + 1, MCCR_RETRY_MAX_COUNT, link_id);
-      /* 等待重试间隔 */
-      usleep(MCCR_RETRY_DELAY_MS * 1000);
-    }
-
-    /* 构造 MIH 请求 */
-    MIH_Link_Resource_Request mih_req;
-    memset(&mih_req, 0, sizeof(mih_req));
-    memset(mih_confirm, 0, sizeof(*mih_confirm));
-
-    snprintf(mih_req.destination_id.mihf_id,
-             sizeof(mih_req.destination_id.mihf_id), "MIHF_%s", link_id);
-    mih_req.link_identifier.link_type = 1;
-    strncpy(mih_req.link_identifier.link_addr, link_id,
-            sizeof(mih_req.link_identifier.link_addr) - 1);
-    mih_req.resource_action = RESOURCE_ACTION_REQUEST;
-    mih_req.has_qos_params = true;
-    mih_req.qos_parameters.cos_id = COS_BEST_EFFORT;
-    mih_req.qos_parameters.forward_link_rate = policy_resp->granted_bw_kbps;
-    mih_req.qos_parameters.return_link_rate = policy_resp->granted_ret_bw_kbps;
-    mih_req.qos_parameters.avg_pk_tx_delay = 100;
-    mih_req.qos_parameters.max_pk_tx_delay = 500;
-    mih_req.qos_parameters.pk_delay_jitter = 50;
-    mih_req.qos_parameters.pk_loss_rate = 0.01f;
-
-    /* 发送 MIH 请求 */
-    mih_result = magic_dlm_mih_link_resource_request(&g_ctx->lmi_ctx, &mih_req,
-                                                     mih_confirm);
-
-    if (mih_result == 0 && mih_confirm->status == STATUS_SUCCESS) {
-      fd_log_notice("[app_magic]     ✓ MIH request succeeded on attempt %d",
-                    attempt + 1);
-      ctx->retry_count = attempt;
-      return 0;
-    }
-
-    fd_log_notice("[app_magic]     ⚠ MIH request failed: status=%s",
-                  status_to_string(mih_confirm->status));
-  }
-
-  fd_log_error("[app_magic]     ✗ All %d retry attempts failed for link %s",
-               MCCR_RETRY_MAX_COUNT, link_id);
-  return -1;
-}
-
-/**
- * @brief 尝试回退到备选链路 (MCCR Helper)。
- * @details 当首选链路由于资源不足等原因失败时，尝试使用策略引擎推荐的备选链路。
+ * @brief 选择下一条未尝试过的回退链路 (MCCR Helper)。
+ * @details 当首选链路由于资源不足等原因重试用尽时，向策略引擎请求备选链路，
+ *          结果写入 `ctx->policy_resp` 并标记为已尝试。
  *
  * @param ctx MCCR 处理上下文。
- * @return 0 成功找到可用链路并分配资源，-1 所有链路都失败。
+ * @return 0 已选出新的候选链路，-1 没有更多可用链路。
  */
-static int mccr_try_fallback_links(MccxProcessContext *ctx) {
+static int mccr_select_fallback_link(MccxProcessContext *ctx) {
   fd_log_notice("[app_magic]   → Attempting fallback to alternative links...");
 
+  if (ctx->tried_link_count >= MCCR_FALLBACK_MAX_LINKS) {
+    fd_log_error("[app_magic]     ✗ All fallback links exhausted");
+    return -1;
+  }
+
   /* 获取所有可用链路列表 */
   PolicyRequest fallback_req;
   memset(&fallback_req, 0, sizeof(fallback_req));
@@ -2881,12 +3598,11 @@ static int mccr_try_fallback_links(MccxProcessContext *ctx) {
   strncpy(fallback_req.flight_phase, ctx->comm_params.flight_phase,
           sizeof(fallback_req.flight_phase) - 1);
 
-  /* 遍历尝试所有候选链路 */
+  /* 请求策略引擎返回下一个未尝试的最佳链路 */
   for (int i = 0; i < MCCR_FALLBACK_MAX_LINKS; i++) {
     PolicyResponse fallback_resp;
     memset(&fallback_resp, 0, sizeof(fallback_resp));
 
-    /* 请求策略引擎返回下一个最佳链路 */
     fallback_req.exclude_link_count = ctx->tried_link_count;
     for (int j = 0; j < ctx->tried_link_count && j < 4; j++) {
       strncpy(fallback_req.exclude_links[j], ctx->tried_links[j],
@@ -2908,25 +3624,64 @@ static int mccr_try_fallback_links(MccxProcessContext *ctx) {
     fd_log_notice("[app_magic]     → Trying fallback link: %s",
                   fallback_resp.selected_link_id);
     mccr_mark_link_tried(ctx, fallback_resp.selected_link_id);
-
-    /* 尝试分配资源（带重试） */
-    MIH_Link_Resource_Confirm fallback_confirm;
-    if (mccr_try_link_with_retry(ctx, fallback_resp.selected_link_id,
-                                 &fallback_resp, &fallback_confirm) == 0) {
-      /* 成功！更新上下文 */
-      memcpy(&ctx->policy_resp, &fallback_resp, sizeof(PolicyResponse));
-      memcpy(&ctx->mih_confirm, &fallback_confirm,
-             sizeof(MIH_Link_Resource_Confirm));
-      fd_log_notice("[app_magic]     ✓ Fallback succeeded: link=%s",
-                    fallback_resp.selected_link_id);
-      return 0;
-    }
+    memcpy(&ctx->policy_resp, &fallback_resp, sizeof(PolicyResponse));
+    return 0;
   }
 
   fd_log_error("[app_magic]     ✗ All fallback links exhausted");
   return -1;
 }
 
+/**
+ * @brief 推进 MCCR 链路资源分配状态机 (MCCR Helper)。
+ * @details 与 mcar_alloc_advance 相同的语义：每次调用只发起一次 MIH 请求，
+ *          需要等待重试间隔时返回 `LINK_ALLOC_RETRY_LATER` 而不是睡眠。
+ *
+ * @param ctx MCCR 处理上下文。
+ * @return LINK_ALLOC_DONE / LINK_ALLOC_FAILED / LINK_ALLOC_RETRY_LATER。
+ */
+static LinkAllocStatus mccr_alloc_advance(MccxProcessContext *ctx) {
+  for (;;) {
+    const char *link_id = ctx->policy_resp.selected_link_id;
+
+    if (ctx->link_attempt > 0) {
+      fd_log_notice("[app_magic]     → Retry attempt %u/%d for link %s",
+                    ctx->link_attempt + 1, MCCR_RETRY_MAX_COUNT, link_id);
+    }
+
+    int req_ret = cic_request_link_resource(
+        ctx->session_id, ctx->client_id, &ctx->comm_params, ctx->profile,
+        link_id, &ctx->policy_resp, &ctx->mih_confirm);
+    if (req_ret == 0) {
+      fd_log_notice("[app_magic]     ✓ MIH request succeeded on attempt %u",
+                    ctx->link_attempt + 1);
+      ctx->retry_count = ctx->link_attempt;
+      return LINK_ALLOC_DONE;
+    }
+
+    if (req_ret == -2) {
+      /* 准入控制拒绝: 容量不会在重试间隔内恢复，直接换链路 */
+      fd_log_notice("[app_magic]     → No admission on %s, skipping retries",
+                    link_id);
+    } else {
+      ctx->link_attempt++;
+      if (ctx->link_attempt < MCCR_RETRY_MAX_COUNT) {
+        return LINK_ALLOC_RETRY_LATER;
+      }
+
+      fd_log_error(
+          "[app_magic]     ✗ All %d retry attempts failed for link %s",
+          MCCR_RETRY_MAX_COUNT, link_id);
+    }
+
+    /* 主链路失败，尝试回退到备选链路 */
+    if (mccr_select_fallback_link(ctx) != 0) {
+      return LINK_ALLOC_FAILED;
+    }
+    ctx->link_attempt = 0;
+  }
+}
+
 /*===========================================================================
  * MCCR 4 阶段流水线实现
  *===========================================================================*/
@@ -3077,7 +3832,7 @@ static int mccr_phase2_param_security(struct msg *qry,
   }
 
   /* 2.3 从客户端 Profile 填充缺失的默认值 */
-  ctx->profile = magic_config_find_client(&g_ctx->config, ctx->client_id);
+  ctx->profile = magic_config_find_client(cic_config(), ctx->client_id);
   if (ctx->profile) {
     comm_req_params_fill_from_profile(&ctx->comm_params, ctx->profile);
     fd_log_notice("[app_magic]   ✓ Profile defaults applied from: %s",
@@ -3355,6 +4110,12 @@ static int mccr_phase2_param_security(struct msg *qry,
     fd_log_notice("[app_magic]   ✓ All %d TFT-to-Ground rules passed whitelist "
                   "validation",
                   ctx->comm_params.tft_to_ground_count);
+
+    cic_flow_check_conflicts(
+        ctx->session_id,
+        cic_flow_client_ip(ctx->profile, ctx->existing_session),
+        ctx->comm_params.tft_to_ground, ctx->comm_params.tft_to_ground_count,
+        FLOW_DIR_TO_GROUND);
   }
 
   /* 2.4.2 验证 TFTtoAircraft-Rule（如果存在）- 原子性验证 */
@@ -3387,6 +4148,12 @@ static int mccr_phase2_param_security(struct msg *qry,
     fd_log_notice("[app_magic]   ✓ All %d TFT-to-Aircraft rules passed "
                   "whitelist validation",
                   ctx->comm_params.tft_to_aircraft_count);
+
+    cic_flow_check_conflicts(
+        ctx->session_id,
+        cic_flow_client_ip(ctx->profile, ctx->existing_session),
+        ctx->comm_params.tft_to_aircraft,
+        ctx->comm_params.tft_to_aircraft_count, FLOW_DIR_TO_AIRCRAFT);
   }
 
   /* 2.4.3 NAPT 白名单验证 */
@@ -3541,9 +4308,7 @@ static void mccr_execute_stop(MccxProcessContext *ctx) {
   if (ctx->existing_session && ctx->existing_session->assigned_link_id[0]) {
     /* 释放 MIH 资源 */
     MIH_Link_Resource_Request mih_release;
-    MIH_Link_Resource_Confirm mih_rel_confirm;
     memset(&mih_release, 0, sizeof(mih_release));
-    memset(&mih_rel_confirm, 0, sizeof(mih_rel_confirm));
 
     snprintf(mih_release.destination_id.mihf_id,
              sizeof(mih_release.destination_id.mihf_id), "MIHF_%s",
@@ -3552,12 +4317,14 @@ static void mccr_execute_stop(MccxProcessContext *ctx) {
     mih_release.has_bearer_id = true;
     mih_release.bearer_identifier = ctx->existing_session->bearer_id;
 
-    magic_dlm_mih_link_resource_request(&g_ctx->lmi_ctx, &mih_release,
-                                        &mih_rel_confirm);
+    magic_lmi_resource_request_async(&g_ctx->lmi_ctx, &mih_release, 0, NULL,
+                                     NULL);
+    magic_admission_release(&g_ctx->admission_ctx, ctx->session_id);
     fd_log_notice("[app_magic]     ✓ MIH resource released");
 
     /* 删除数据平面路由 */
     magic_dataplane_remove_client_route(&g_ctx->dataplane_ctx, ctx->session_id);
+    magic_flow_remove_session(&g_ctx->flow_ctx, ctx->session_id);
     fd_log_notice("[app_magic]     ✓ Dataplane route removed");
 
     /* 清除会话链路分配，状态转换: ACTIVE → AUTHENTICATED */
@@ -3569,128 +4336,35 @@ static void mccr_execute_stop(MccxProcessContext *ctx) {
     fd_log_notice("[app_magic]     ✓ Session state: ACTIVE → AUTHENTICATED");
   }
 
-  /* 从排队队列中移除（如果存在） */
-  mccr_queue_dequeue(ctx->session_id);
+  /* 从排队队列中移除（如果存在），释放的带宽可供排队请求使用 */
+  mccr_queue_cancel(ctx->session_id);
+  mccr_queue_kick("bandwidth released");
 
   ctx->result_code = 2001; /* SUCCESS */
   ctx->resource_allocated = false;
 }
 
 /**
- * @brief MCCR Phase 4 辅助函数: 执行 START/MODIFY 操作。
- * @details 调用策略引擎选择链路，通过 MIH 申请资源。
- *          如果成功，更新会话状态为 ACTIVE 并配置数据平面 TFT/路由。
- *          如果失败，尝试回退链路。
+ * @brief MCCR START/MODIFY 收尾: 落地资源分配结果。
+ * @details 分配失败时设置错误码；成功时创建/更新会话并下发数据平面路由、
+ *          TFT mangle 规则、流量监控与 CDR。同步路径与定时器续跑路径共用。
  *
  * @param ctx MCCR 处理上下文。
+ * @param status mccr_alloc_advance 的最终结果 (DONE 或 FAILED)。
  * @return 0 成功，-1 失败。
  */
-static int mccr_execute_start_modify(MccxProcessContext *ctx) {
-  fd_log_notice("[app_magic]   Executing: %s",
-                ctx->intent == MCCR_INTENT_START ? "OpenLink" : "ChangeLink");
-
-  /* 4.1 调用策略引擎进行链路选择 */
-  PolicyRequest policy_req;
-  memset(&policy_req, 0, sizeof(policy_req));
-
-  strncpy(policy_req.client_id, ctx->client_id,
-          sizeof(policy_req.client_id) - 1);
-  strncpy(policy_req.profile_name, ctx->comm_params.profile_name,
-          sizeof(policy_req.profile_name) - 1);
-  policy_req.requested_bw_kbps = (uint32_t)ctx->comm_params.requested_bw;
-  policy_req.requested_ret_bw_kbps =
-      (uint32_t)ctx->comm_params.requested_ret_bw;
-  policy_req.required_bw_kbps = (uint32_t)ctx->comm_params.required_bw;
-  policy_req.required_ret_bw_kbps = (uint32_t)ctx->comm_params.required_ret_bw;
-  policy_req.priority_class = (uint8_t)atoi(ctx->comm_params.priority_class);
-  policy_req.qos_level = (uint8_t)ctx->comm_params.qos_level;
-  strncpy(policy_req.flight_phase, ctx->comm_params.flight_phase,
-          sizeof(policy_req.flight_phase) - 1);
-
-  /* v2.2: 从 ADIF 获取实时位置和 WoW 数据用于策略决策 */
-  AdifAircraftState adif_state;
-  if (adif_client_get_state(&g_ctx->adif_ctx, &adif_state) == 0 &&
-      adif_state.data_valid) {
-    policy_req.aircraft_lat = adif_state.position.latitude;
-    policy_req.aircraft_lon = adif_state.position.longitude;
-    policy_req.aircraft_alt =
-        adif_state.position.altitude_ft * 0.3048; /* ft->m */
-    policy_req.on_ground = adif_state.wow.on_ground;
-    policy_req.has_adif_data = true;
-    fd_log_debug(
-        "[app_magic]   ADIF Data: lat=%.4f, lon=%.4f, alt=%.0fm, WoW=%s",
-        policy_req.aircraft_lat, policy_req.aircraft_lon,
-        policy_req.aircraft_alt, policy_req.on_ground ? "Ground" : "Airborne");
-  } else {
-    policy_req.aircraft_lat = 0.0;
-    policy_req.aircraft_lon = 0.0;
-    policy_req.aircraft_alt = 0.0;
-    policy_req.on_ground = false;
-    policy_req.has_adif_data = false;
-  }
-
-  memset(&ctx->policy_resp, 0, sizeof(ctx->policy_resp));
-
-  if (magic_policy_select_path(&g_ctx->policy_ctx, &policy_req,
-                               &ctx->policy_resp) != 0 ||
-      !ctx->policy_resp.success) {
-    fd_log_error("[app_magic]     ✗ Policy decision failed: %s",
-                 ctx->policy_resp.reason);
+static int mccr_execute_start_modify_finish(MccxProcessContext *ctx,
+                                            LinkAllocStatus status) {
+  if (status != LINK_ALLOC_DONE) {
+    /* 所有链路都失败 */
+    fd_log_error("[app_magic]     ✗ All link resource requests failed");
     ctx->result_code = 5012;       /* DIAMETER_UNABLE_TO_COMPLY */
-    ctx->magic_status_code = 1010; /* NO_ENTRY_IN_BANDWIDTHTABLE */
-    ctx->error_message = ctx->policy_resp.reason;
+    ctx->magic_status_code = 1010; /* NO_BW */
+    ctx->error_message = "No available link resources";
     ctx->resource_allocated = false;
     return -1;
   }
 
-  fd_log_notice("[app_magic]     ✓ Policy Decision: Link=%s, BW=%u/%u kbps",
-                ctx->policy_resp.selected_link_id,
-                ctx->policy_resp.granted_bw_kbps,
-                ctx->policy_resp.granted_ret_bw_kbps);
-
-  /* 标记主选链路为已尝试 */
-  mccr_mark_link_tried(ctx, ctx->policy_resp.selected_link_id);
-
-  /* 4.2 如果是 MODIFY 且链路变化，先释放旧资源 */
-  if (ctx->intent == MCCR_INTENT_MODIFY && ctx->existing_session &&
-      ctx->existing_session->assigned_link_id[0] &&
-      strcmp(ctx->existing_session->assigned_link_id,
-             ctx->policy_resp.selected_link_id) != 0) {
-    fd_log_notice("[app_magic]     → Releasing old link: %s",
-                  ctx->existing_session->assigned_link_id);
-
-    MIH_Link_Resource_Request mih_release;
-    MIH_Link_Resource_Confirm mih_rel_confirm;
-    memset(&mih_release, 0, sizeof(mih_release));
-    memset(&mih_rel_confirm, 0, sizeof(mih_rel_confirm));
-
-    snprintf(mih_release.destination_id.mihf_id,
-             sizeof(mih_release.destination_id.mihf_id), "MIHF_%s",
-             ctx->existing_session->assigned_link_id);
-    mih_release.resource_action = RESOURCE_ACTION_RELEASE;
-    mih_release.has_bearer_id = true;
-    mih_release.bearer_identifier = ctx->existing_session->bearer_id;
-
-    magic_dlm_mih_link_resource_request(&g_ctx->lmi_ctx, &mih_release,
-                                        &mih_rel_confirm);
-    magic_dataplane_remove_client_route(&g_ctx->dataplane_ctx, ctx->session_id);
-  }
-
-  /* 4.3 通过 MIH 请求链路资源（带重试机制） */
-  if (mccr_try_link_with_retry(ctx, ctx->policy_resp.selected_link_id,
-                               &ctx->policy_resp, &ctx->mih_confirm) != 0) {
-    /* 主链路失败，尝试回退到备选链路 */
-    if (mccr_try_fallback_links(ctx) != 0) {
-      /* 所有链路都失败 */
-      fd_log_error("[app_magic]     ✗ All link resource requests failed");
-      ctx->result_code = 5012;       /* DIAMETER_UNABLE_TO_COMPLY */
-      ctx->magic_status_code = 1010; /* NO_BW */
-      ctx->error_message = "No available link resources";
-      ctx->resource_allocated = false;
-      return -1;
-    }
-  }
-
   fd_log_notice(
       "[app_magic]     ✓ MIH Link Resource Allocated: Bearer=%u, Retries=%u",
       ctx->mih_confirm.has_bearer_id ? ctx->mih_confirm.bearer_identifier : 0,
@@ -3702,6 +4376,7 @@ static int mccr_execute_start_modify(MccxProcessContext *ctx) {
                                         ctx->client_id, ctx->client_realm);
     if (!ctx->session) {
       fd_log_error("[app_magic]     ✗ Failed to create session");
+      magic_admission_release(&g_ctx->admission_ctx, ctx->session_id);
       ctx->result_code = 5012;
       ctx->magic_status_code = 1000; /* INTERNAL_ERROR */
       ctx->error_message = "Failed to create session";
@@ -3872,6 +4547,8 @@ static int mccr_execute_start_modify(MccxProcessContext *ctx) {
       fd_log_notice("[app_magic]     → No TFT-to-Ground rules specified, "
                     "skipping TFT mangle rules");
     }
+    cic_flow_register_tfts(ctx->session_id, client_ip, &ctx->comm_params,
+                           ctx->session ? ctx->session->bearer_id : 0);
 
     /* 4.6 v2.1: 注册流量监控 (Netlink conntrack) */
     uint32_t traffic_mark = traffic_register_session(
@@ -3906,6 +4583,106 @@ static int mccr_execute_start_modify(MccxProcessContext *ctx) {
   return 0;
 }
 
+/**
+ * @brief MCCR Phase 4 辅助函数: 执行 START/MODIFY 操作。
+ * @details 调用策略引擎选择链路，通过 MIH 申请资源。
+ *          如果成功，更新会话状态为 ACTIVE 并配置数据平面 TFT/路由。
+ *          如果失败，尝试回退链路；需要等待重试间隔时返回 1，
+ *          由调用方挂起请求 (见 mccr_alloc_resume)。
+ *
+ * @param ctx MCCR 处理上下文。
+ * @return 0 成功，-1 失败，1 资源请求已挂起等待重试。
+ */
+static int mccr_execute_start_modify(MccxProcessContext *ctx) {
+  fd_log_notice("[app_magic]   Executing: %s",
+                ctx->intent == MCCR_INTENT_START ? "OpenLink" : "ChangeLink");
+
+  /* 4.1 调用策略引擎进行链路选择 */
+  PolicyRequest policy_req;
+  memset(&policy_req, 0, sizeof(policy_req));
+
+  strncpy(policy_req.client_id, ctx->client_id,
+          sizeof(policy_req.client_id) - 1);
+  strncpy(policy_req.profile_name, ctx->comm_params.profile_name,
+          sizeof(policy_req.profile_name) - 1);
+  policy_req.requested_bw_kbps = (uint32_t)ctx->comm_params.requested_bw;
+  policy_req.requested_ret_bw_kbps =
+      (uint32_t)ctx->comm_params.requested_ret_bw;
+  policy_req.required_bw_kbps = (uint32_t)ctx->comm_params.required_bw;
+  policy_req.required_ret_bw_kbps = (uint32_t)ctx->comm_params.required_ret_bw;
+  policy_req.priority_class = (uint8_t)atoi(ctx->comm_params.priority_class);
+  policy_req.qos_level = (uint8_t)ctx->comm_params.qos_level;
+  strncpy(policy_req.flight_phase, ctx->comm_params.flight_phase,
+          sizeof(policy_req.flight_phase) - 1);
+
+  /* v2.2: 从 ADIF 获取实时位置和 WoW 数据用于策略决策 */
+  AdifAircraftState adif_state;
+  if (adif_client_get_state(&g_ctx->adif_ctx, &adif_state) == 0 &&
+      adif_state.data_valid) {
+    policy_req.aircraft_lat = adif_state.position.latitude;
+    policy_req.aircraft_lon = adif_state.position.longitude;
+    policy_req.aircraft_alt =
+        adif_state.position.altitude_ft * 0.3048; /* ft->m */
+    policy_req.on_ground = adif_state.wow.on_ground;
+    policy_req.has_adif_data = true;
+    fd_log_debug(
+        "[app_magic]   ADIF Data: lat=%.4f, lon=%.4f, alt=%.0fm, WoW=%s",
+        policy_req.aircraft_lat, policy_req.aircraft_lon,
+        policy_req.aircraft_alt, policy_req.on_ground ? "Ground" : "Airborne");
+  } else {
+    policy_req.aircraft_lat = 0.0;
+    policy_req.aircraft_lon = 0.0;
+    policy_req.aircraft_alt = 0.0;
+    policy_req.on_ground = false;
+    policy_req.has_adif_data = false;
+  }
+
+  memset(&ctx->policy_resp, 0, sizeof(ctx->policy_resp));
+
+  if (magic_policy_select_path(&g_ctx->policy_ctx, &policy_req,
+                               &ctx->policy_resp) != 0 ||
+      !ctx->policy_resp.success) {
+    fd_log_error("[app_magic]     ✗ Policy decision failed: %s",
+                 ctx->policy_resp.reason);
+    ctx->result_code = 5012;       /* DIAMETER_UNABLE_TO_COMPLY */
+    ctx->magic_status_code = 1010; /* NO_ENTRY_IN_BANDWIDTHTABLE */
+    ctx->error_message = ctx->policy_resp.reason;
+    ctx->resource_allocated = false;
+    return -1;
+  }
+
+  fd_log_notice("[app_magic]     ✓ Policy Decision: Link=%s, BW=%u/%u kbps",
+                ctx->policy_resp.selected_link_id,
+                ctx->policy_resp.granted_bw_kbps,
+                ctx->policy_resp.granted_ret_bw_kbps);
+
+  /* 标记主选链路为已尝试 */
+  mccr_mark_link_tried(ctx, ctx->policy_resp.selected_link_id);
+
+  /* 4.2 如果是 MODIFY 且链路变化，先释放旧资源 */
+  if (ctx->intent == MCCR_INTENT_MODIFY && ctx->existing_session &&
+      ctx->existing_session->assigned_link_id[0] &&
+      strcmp(ctx->existing_session->assigned_link_id,
+             ctx->policy_resp.selected_link_id) != 0) {
+    fd_log_notice("[app_magic]     → Releasing old link: %s",
+                  ctx->existing_session->assigned_link_id);
+
+    cic_release_link_resource(ctx->existing_session->assigned_link_id,
+                              ctx->existing_session->bearer_id);
+    magic_dataplane_remove_client_route(&g_ctx->dataplane_ctx, ctx->session_id);
+    magic_flow_remove_session(&g_ctx->flow_ctx, ctx->session_id);
+  }
+
+  /* 4.3 通过 MIH 请求链路资源（失败时定时重试 + 回退，不阻塞分发线程） */
+  ctx->link_attempt = 0;
+  LinkAllocStatus alloc_status = mccr_alloc_advance(ctx);
+  if (alloc_status == LINK_ALLOC_RETRY_LATER) {
+    return 1;
+  }
+
+  return mccr_execute_start_modify_finish(ctx, alloc_status);
+}
+
 /**
  * @brief MCCR Phase 4 辅助函数: 执行 QUEUE 操作。
  * @details 尝试将请求加入排队队列等待资源。
@@ -3953,12 +4730,14 @@ static void mccr_execute_queue(MccxProcessContext *ctx) {
   if (magic_policy_select_path(&g_ctx->policy_ctx, &policy_req, &policy_resp) ==
           0 &&
       policy_resp.success) {
-    /* 有可用资源，尝试分配 */
+    /* 有可用资源，尝试分配一次；失败直接排队，不在分发线程中重试等待 */
     mccr_mark_link_tried(ctx, policy_resp.selected_link_id);
 
     MIH_Link_Resource_Confirm mih_confirm;
-    if (mccr_try_link_with_retry(ctx, policy_resp.selected_link_id,
-                                 &policy_resp, &mih_confirm) == 0) {
+    if (cic_request_link_resource(ctx->session_id, ctx->client_id,
+                                  &ctx->comm_params, ctx->profile,
+                                  policy_resp.selected_link_id, &policy_resp,
+                                  &mih_confirm) == 0) {
       /* 资源分配成功 */
       fd_log_notice("[app_magic]     ✓ Immediate allocation succeeded, no "
                     "queueing needed");
@@ -3989,35 +4768,149 @@ static void mccr_execute_queue(MccxProcessContext *ctx) {
     }
   }
 
-  /* 资源不足，加入排队队列 */
-  fd_log_notice("[app_magic]     → Resources not available, adding to queue");
+  /* 资源不足，加入排队队列 */
+  fd_log_notice("[app_magic]     → Resources not available, adding to queue");
+
+  /* 计算优先级（数字越小越高） */
+  uint32_t priority =
+      (uint32_t)(100 - atoi(ctx->comm_params.priority_class) * 10);
+
+  if (mccr_queue_enqueue(ctx->session_id, ctx->client_id, ctx->client_realm,
+                         ctx->extracted_dest_ip, &ctx->comm_params,
+                         priority) == 0) {
+    fd_log_notice("[app_magic]     ✓ Request queued successfully");
+    ctx->result_code = 2001; /* SUCCESS (request accepted, queued) */
+    ctx->resource_allocated = false;
+    ctx->queued = true;
+
+    /* 记录队列状态 */
+    uint32_t pending, total;
+    mccr_queue_get_status(&pending, &total);
+    fd_log_notice("[app_magic]     Queue status: %u pending, %u total", pending,
+                  total);
+  } else {
+    fd_log_error("[app_magic]     ✗ Queue full, cannot accept request");
+    ctx->result_code = 5012;       /* DIAMETER_UNABLE_TO_COMPLY */
+    ctx->magic_status_code = 1011; /* QUEUE_FULL */
+    ctx->error_message = "Request queue is full";
+    ctx->resource_allocated = false;
+    ctx->queued = false;
+  }
+}
+
+/**
+ * @brief 排队调度器: 按优先级为排队请求分配资源。
+ * @details 由 mccr_queue_kick 在定时器线程中触发。依次取堆顶请求走
+ *          START 流程 (策略选路 + MIH 申请 + 数据平面)，成功后通过 MNTR
+ *          通知客户端新的链路与带宽；遇到第一个无法满足的请求即停止，
+ *          保持队首阻塞语义，避免低优先级请求越过高优先级请求。
+ *          队列非空时按 MCCR_QUEUE_RECHECK_MS 自行复查，以处理超时条目。
+ *
+ * @param arg 未使用。
+ */
+static void mccr_queue_dispatch(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&g_mccr_queue.lock);
+  g_mccr_queue.dispatch_scheduled = false;
+  pthread_mutex_unlock(&g_mccr_queue.lock);
+
+  if (!g_ctx)
+    return;
+
+  int granted = 0;
+  MccxQueueEntry entry;
+
+  while (mccr_queue_take_highest_priority(&entry)) {
+    ClientSession *session =
+        magic_session_find_by_id(&g_ctx->session_mgr, entry.session_id);
+    if (!session) {
+      /* 会话已不存在 (STR 与调度竞争)，直接丢弃 */
+      mccr_queue_cancel(entry.session_id);
+      continue;
+    }
+
+    MccxProcessContext *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+      mccr_queue_requeue(entry.session_id);
+      break;
+    }
+
+    strncpy(ctx->session_id, entry.session_id, sizeof(ctx->session_id) - 1);
+    strncpy(ctx->client_id, entry.client_id, sizeof(ctx->client_id) - 1);
+    strncpy(ctx->client_realm, entry.client_realm,
+            sizeof(ctx->client_realm) - 1);
+    strncpy(ctx->extracted_dest_ip, entry.extracted_dest_ip,
+            sizeof(ctx->extracted_dest_ip) - 1);
+    memcpy(&ctx->comm_params, &entry.params, sizeof(ctx->comm_params));
+    ctx->has_comm_req_params = true;
+    ctx->profile = magic_config_find_client(cic_config(), entry.client_id);
+    ctx->existing_session = session;
+    ctx->intent = MCCR_INTENT_START;
+
+    fd_log_notice("[app_magic] Queue dispatch: session=%s, priority=%u",
+                  entry.session_id, entry.priority);
 
-  /* 计算优先级（数字越小越高） */
-  uint32_t priority =
-      (uint32_t)(100 - atoi(ctx->comm_params.priority_class) * 10);
+    /* 返回 1 表示首选链路需等待重试，此时未占用任何资源，按未满足处理 */
+    if (mccr_execute_start_modify(ctx) != 0) {
+      fd_log_notice("[app_magic]   → Still no resources, keep queued: %s",
+                    entry.session_id);
+      mccr_queue_requeue(entry.session_id);
+      free(ctx);
+      break;
+    }
 
-  if (mccr_queue_enqueue(ctx->session_id, ctx->client_id, &ctx->comm_params,
-                         priority) == 0) {
-    fd_log_notice("[app_magic]     ✓ Request queued successfully");
-    ctx->result_code = 2001; /* SUCCESS (request accepted, queued) */
-    ctx->resource_allocated = false;
-    ctx->queued = true;
+    /* 成功: mccr_execute_start_modify_finish 已将其移出队列 */
+    MNTRParams mntr;
+    memset(&mntr, 0, sizeof(mntr));
+    mntr.magic_status_code = 0;
+    mntr.error_message = "Queued request granted";
+    mntr.new_granted_bw = ctx->policy_resp.granted_bw_kbps * 1000;
+    mntr.new_granted_ret_bw = ctx->policy_resp.granted_ret_bw_kbps * 1000;
+    mntr.new_link_id = ctx->policy_resp.selected_link_id;
+    mntr.new_bearer_id = ctx->session ? ctx->session->bearer_id : 0;
+    mntr.force_send = true;
+    if (ctx->session) {
+      magic_cic_send_mntr(g_ctx, ctx->session, &mntr);
+    }
+    granted++;
+    free(ctx);
+  }
+
+  uint32_t pending = 0;
+  mccr_queue_get_status(&pending, NULL);
+  if (granted > 0) {
+    fd_log_notice("[app_magic] Queue dispatch: %d granted, %u still pending",
+                  granted, pending);
+  }
+
+  /* 队列非空时定期复查 (超时清理 + 外部事件丢失时兜底) */
+  if (pending > 0) {
+    pthread_mutex_lock(&g_mccr_queue.lock);
+    bool need_schedule = !g_mccr_queue.dispatch_scheduled;
+    if (need_schedule)
+      g_mccr_queue.dispatch_scheduled = true;
+    pthread_mutex_unlock(&g_mccr_queue.lock);
 
-    /* 记录队列状态 */
-    uint32_t pending, total;
-    mccr_queue_get_status(&pending, &total);
-    fd_log_notice("[app_magic]     Queue status: %u pending, %u total", pending,
-                  total);
-  } else {
-    fd_log_error("[app_magic]     ✗ Queue full, cannot accept request");
-    ctx->result_code = 5012;       /* DIAMETER_UNABLE_TO_COMPLY */
-    ctx->magic_status_code = 1011; /* QUEUE_FULL */
-    ctx->error_message = "Request queue is full";
-    ctx->resource_allocated = false;
-    ctx->queued = false;
+    if (need_schedule &&
+        magic_timer_schedule(&g_ctx->timer_ctx, MCCR_QUEUE_RECHECK_MS,
+                             mccr_queue_dispatch, NULL) != 0) {
+      pthread_mutex_lock(&g_mccr_queue.lock);
+      g_mccr_queue.dispatch_scheduled = false;
+      pthread_mutex_unlock(&g_mccr_queue.lock);
+    }
   }
 }
 
+/**
+ * @brief 唤醒 MCCR 排队调度器 (对外接口)。
+ */
+void magic_cic_queue_wakeup(const char *reason) {
+  mccr_queue_kick(reason ? reason : "external");
+}
+
+static int mccr_phase4_respond(struct msg **msg, MccxProcessContext *ctx);
+
 /**
  * @brief MCCR Phase 4: 执行与响应。
  * @details 根据 Phase 3 确定的意图 (Intent) 执行具体操作
@@ -4026,11 +4919,9 @@ static void mccr_execute_queue(MccxProcessContext *ctx) {
  *
  * @param msg Diameter 消息指针的指针 (输入为请求，输出为应答)。
  * @param ctx MCCR 处理上下文。
- * @return 0 成功，-1 失败。
+ * @return 0 成功，-1 失败，1 资源请求已挂起 (尚未应答)。
  */
 static int mccr_phase4_execution(struct msg **msg, MccxProcessContext *ctx) {
-  struct msg *ans;
-
   fd_log_notice("[app_magic] → Phase 4: Execution & Response");
 
   /* 4.1 根据意图执行不同操作 */
@@ -4041,7 +4932,9 @@ static int mccr_phase4_execution(struct msg **msg, MccxProcessContext *ctx) {
 
   case MCCR_INTENT_START:
   case MCCR_INTENT_MODIFY:
-    mccr_execute_start_modify(ctx);
+    if (mccr_execute_start_modify(ctx) == 1) {
+      return 1; /* 资源请求已挂起，MCCA 由 mccr_alloc_resume 发送 */
+    }
     break;
 
   case MCCR_INTENT_QUEUE:
@@ -4056,6 +4949,21 @@ static int mccr_phase4_execution(struct msg **msg, MccxProcessContext *ctx) {
     break;
   }
 
+  return mccr_phase4_respond(msg, ctx);
+}
+
+/**
+ * @brief MCCR Phase 4 应答: 构建并发送 MCCA。
+ * @details 填充 Communication-Answer-Parameters 并发送应答。
+ *          同步路径与定时器续跑路径共用。
+ *
+ * @param msg Diameter 消息指针的指针 (输入为请求，输出为应答)。
+ * @param ctx MCCR 处理上下文。
+ * @return 0 成功，-1 失败。
+ */
+static int mccr_phase4_respond(struct msg **msg, MccxProcessContext *ctx) {
+  struct msg *ans;
+
   /* 4.2 构建应答消息 (MCCA) */
   fd_log_notice("[app_magic]   Building Response...");
 
@@ -4170,6 +5078,93 @@ static int mccr_phase4_execution(struct msg **msg, MccxProcessContext *ctx) {
   return 0;
 }
 
+static void mccr_alloc_resume(void *arg);
+
+/**
+ * @brief 挂起 MCCR 请求并安排资源请求重试 (MCCR Helper)。
+ *
+ * @param ctx MCCR 处理上下文 (堆分配，所有权转交定时器)。
+ * @param qry 原始 MCCR 请求。
+ * @return 0 已挂起，-1 调度失败 (所有权仍归调用方)。
+ */
+static int mccr_park(MccxProcessContext *ctx, struct msg *qry) {
+  /* 续跑时沿用请求开始时的配置版本，期间的重载不影响本请求 */
+  bool fresh_hold = !ctx->config_snap;
+  if (fresh_hold) {
+    ctx->config_snap = magic_config_hold(&g_ctx->config_store);
+  }
+
+  ctx->pending_qry = qry;
+  if (magic_timer_schedule(&g_ctx->timer_ctx, MCCR_RETRY_DELAY_MS,
+                           mccr_alloc_resume, ctx) != 0) {
+    fd_log_error("[app_magic]   ✗ Failed to schedule MCCR retry: session=%s",
+                 ctx->session_id);
+    if (fresh_hold) {
+      magic_config_release(&g_ctx->config_store, ctx->config_snap);
+      ctx->config_snap = NULL;
+    }
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief MCCR 资源请求重试的定时器续跑入口。
+ * @details 在定时器线程中推进分配状态机；完成后执行 START/MODIFY 收尾并
+ *          从此处发送 MCCA，最后释放上下文。
+ *
+ * @param arg 挂起的 MCCR 处理上下文。
+ */
+static void mccr_alloc_resume(void *arg) {
+  MccxProcessContext *ctx = (MccxProcessContext *)arg;
+  MagicConfigSnapshot *prev_snap =
+      magic_config_pin(&g_ctx->config_store, ctx->config_snap);
+
+  fd_log_notice("[app_magic] MCCR resume: session=%s, link=%s",
+                ctx->session_id, ctx->policy_resp.selected_link_id);
+
+  /* 扩展卸载时定时器冲刷剩余任务，不再发起 MIH 请求，直接失败应答 */
+  LinkAllocStatus status =
+      g_ctx->running ? mccr_alloc_advance(ctx) : LINK_ALLOC_FAILED;
+  if (status == LINK_ALLOC_RETRY_LATER) {
+    if (mccr_park(ctx, ctx->pending_qry) == 0) {
+      magic_config_unpin(&g_ctx->config_store, prev_snap);
+      return;
+    }
+    status = LINK_ALLOC_FAILED;
+  }
+
+  /* 挂起期间已有会话可能被 STR 终止，重新查找而不是信任旧指针 */
+  if (ctx->existing_session) {
+    ctx->existing_session =
+        magic_session_find_by_id(&g_ctx->session_mgr, ctx->session_id);
+    if (!ctx->existing_session && status == LINK_ALLOC_DONE) {
+      fd_log_notice("[app_magic]   ⚠ Session %s closed while allocating, "
+                    "releasing bearer on %s",
+                    ctx->session_id, ctx->policy_resp.selected_link_id);
+      cic_release_link_resource(ctx->policy_resp.selected_link_id,
+                                ctx->mih_confirm.has_bearer_id
+                                    ? ctx->mih_confirm.bearer_identifier
+                                    : 0);
+      magic_admission_release(&g_ctx->admission_ctx, ctx->session_id);
+      status = LINK_ALLOC_FAILED;
+    }
+  }
+
+  mccr_execute_start_modify_finish(ctx, status);
+
+  if (mccr_phase4_respond(&ctx->pending_qry, ctx) != 0) {
+    fd_log_error("[app_magic] ✗ Failed to send deferred MCCA");
+    if (ctx->pending_qry) {
+      fd_msg_free(ctx->pending_qry);
+    }
+  }
+
+  magic_config_unpin(&g_ctx->config_store, prev_snap);
+  magic_config_release(&g_ctx->config_store, ctx->config_snap);
+  free(ctx);
+}
+
 /**
  * @brief MCCR (Client Communication Request) 主处理器。
  * @details 协调执行 MCCR 处理的 4 阶段流水线：
@@ -4178,6 +5173,9 @@ static int mccr_phase4_execution(struct msg **msg, MccxProcessContext *ctx) {
  *          3. Intent Routing
  *          4. Execution & Response
  *
+ *          START/MODIFY 的首次 MIH 请求失败时，请求被挂起 (`*msg` 置 NULL)，
+ *          MCCA 稍后由 mccr_alloc_resume 发送。
+ *
  * @param msg Diameter 消息指针。
  * @param avp 触发 AVP (未使用)。
  * @param sess 会话对象。
@@ -4189,6 +5187,7 @@ static int cic_handle_mccr(struct msg **msg, struct avp *avp,
                            struct session *sess, void *opaque,
                            enum disp_action *act) {
   struct msg *qry;
+  int ret;
 
   (void)avp;
   (void)opaque;
@@ -4202,30 +5201,48 @@ static int cic_handle_mccr(struct msg **msg, struct avp *avp,
   fd_log_notice("[app_magic] MCCR (Communication Change Request)");
   fd_log_notice("[app_magic] ========================================");
 
-  /* 初始化处理上下文 */
-  MccxProcessContext ctx;
-  memset(&ctx, 0, sizeof(ctx));
-  ctx.result_code = 2001; /* 默认成功 */
-  ctx.security_passed = true;
+  /* 初始化处理上下文 (堆分配: 挂起重试时所有权转交定时器) */
+  MccxProcessContext *ctx = calloc(1, sizeof(*ctx));
+  if (!ctx) {
+    fd_log_error("[app_magic] ✗ Out of memory for MCCR context");
+    return -1;
+  }
+  ctx->result_code = 2001; /* 默认成功 */
+  ctx->security_passed = true;
 
   /* Phase 1: 会话验证 */
-  if (mccr_phase1_session_validation(qry, &ctx) != 0) {
+  if (mccr_phase1_session_validation(qry, ctx) != 0) {
     goto finalize;
   }
 
   /* Phase 2: 参数与安全校验 */
-  if (mccr_phase2_param_security(qry, &ctx) != 0) {
+  if (mccr_phase2_param_security(qry, ctx) != 0) {
     goto finalize;
   }
 
   /* Phase 3: 意图路由 */
-  if (mccr_phase3_intent_routing(&ctx) != 0) {
+  if (mccr_phase3_intent_routing(ctx) != 0) {
     goto finalize;
   }
 
 finalize:
   /* Phase 4: 执行与响应 */
-  if (mccr_phase4_execution(msg, &ctx) != 0) {
+  ret = mccr_phase4_execution(msg, ctx);
+  if (ret == 1) {
+    if (mccr_park(ctx, qry) == 0) {
+      *msg = NULL; /* 请求已挂起，MCCA 由 mccr_alloc_resume 发送 */
+      fd_log_notice("[app_magic] MCCR deferred: retry in %d ms",
+                    MCCR_RETRY_DELAY_MS);
+      fd_log_notice("[app_magic] ========================================\n");
+      return 0;
+    }
+    mccr_execute_start_modify_finish(ctx, LINK_ALLOC_FAILED);
+    ret = mccr_phase4_respond(msg, ctx);
+  }
+
+  free(ctx);
+
+  if (ret != 0) {
     fd_log_error("[app_magic] ✗ Failed to send MCCA");
     fd_log_notice("[app_magic] ========================================\n");
     return -1;
@@ -4336,9 +5353,15 @@ static int cic_handle_str(struct msg **msg, struct avp *avp,
     /* 删除数据平面路由 */
     int dp_ret =
         magic_dataplane_remove_client_route(&g_ctx->dataplane_ctx, session_id);
+    magic_flow_remove_session(&g_ctx->flow_ctx, session_id);
     if (dp_ret == 0) {
       fd_log_notice("[app_magic] ✓ Dataplane route removed for session");
     }
+
+    /* 归还准入控制账本并取消排队请求，释放的资源交给其他排队请求 */
+    magic_admission_release(&g_ctx->admission_ctx, session_id);
+    mccr_queue_cancel(session_id);
+    mccr_queue_kick("session closed");
   }
 
   /* 创建应答消息 (STA) */
@@ -4890,7 +5913,7 @@ static int cic_handle_msxr(struct msg **msg, struct avp *avp,
 
   /* 查找客户端配置 */
   ClientProfile *client_profile =
-      g_ctx ? magic_config_find_client(&g_ctx->config, client_id) : NULL;
+      g_ctx ? magic_config_find_client(cic_config(), client_id) : NULL;
 
   /* v2.1: 速率限制检查 (关联到 Client-ID) */
   uint32_t rate_limit = 5; /* 默认 5 秒 */
@@ -4951,6 +5974,11 @@ static int cic_handle_msxr(struct msg **msg, struct avp *avp,
 
   /* 添加 Registered-Clients (MAGIC 系统状态) */
   if (need_magic_status && g_ctx) {
+    /* 排队等待时间直方图、流分类器统计无对应 AVP，输出到日志 */
+    mccr_queue_dump_stats();
+    magic_cic_push_dump_stats();
+    magic_flow_dump(&g_ctx->flow_ctx);
+
     /* 规则 B: 检查是否允许查看客户端列表 */
     bool can_see_clients = true;
     if (client_profile && !client_profile->session.allow_registered_clients) {
@@ -4969,12 +5997,14 @@ static int cic_handle_msxr(struct msg **msg, struct avp *avp,
         int session_count;
         char first_session_id[256]; /* 首个会话 ID (用于单会话时显示) */
       } ClientSessionCount;
-      ClientSessionCount client_counts[MAX_SESSIONS];
+      int capacity = magic_session_capacity(&g_ctx->session_mgr);
+      ClientSessionCount *client_counts =
+          calloc(capacity > 0 ? capacity : 1, sizeof(*client_counts));
       int unique_clients = 0;
 
       /* 第一遍：统计每个 client_id 的会话数 */
-      for (int i = 0; i < MAX_SESSIONS; i++) {
-        ClientSession *session = &g_ctx->session_mgr.sessions[i];
+      for (int i = 0; client_counts && i < capacity; i++) {
+        ClientSession *session = magic_session_at(&g_ctx->session_mgr, i);
         if (!session->in_use)
           continue;
         if (session->state != SESSION_STATE_AUTHENTICATED &&
@@ -4992,7 +6022,7 @@ static int cic_handle_msxr(struct msg **msg, struct avp *avp,
 
         if (found >= 0) {
           client_counts[found].session_count++;
-        } else if (unique_clients < MAX_SESSIONS) {
+        } else if (unique_clients < capacity) {
           strncpy(client_counts[unique_clients].client_id, session->client_id,
                   sizeof(client_counts[unique_clients].client_id) - 1);
           strncpy(client_counts[unique_clients].first_session_id,
@@ -5021,6 +6051,7 @@ static int cic_handle_msxr(struct msg **msg, struct avp *avp,
         if (written > 0)
           offset += written;
       }
+      free(client_counts);
 
       if (offset > 0) {
         ADD_AVP_STR(ans, g_magic_dict.avp_registered_clients, clients_str);
@@ -5038,8 +6069,9 @@ static int cic_handle_msxr(struct msg **msg, struct avp *avp,
     int dlm_count = 0; /* 计数实际添加的 DLM */
 
     /* 遍历 LMI 中的所有 DLM 客户端 */
-    for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-      DlmClient *dlm = &g_ctx->lmi_ctx.clients[i];
+    int dlm_capacity = magic_lmi_client_capacity(&g_ctx->lmi_ctx);
+    for (int i = 0; i < dlm_capacity; i++) {
+      DlmClient *dlm = magic_lmi_client_at(&g_ctx->lmi_ctx, i);
       if (!dlm->is_registered)
         continue; /* 跳过未注册的 DLM */
 
@@ -5278,8 +6310,9 @@ static int cic_handle_madr(struct msg **msg, struct avp *avp,
         { goto send; });
 
     if (g_ctx) {
-      for (int i = 0; i < MAX_SESSIONS; i++) {
-        ClientSession *session = &g_ctx->session_mgr.sessions[i];
+      int capacity = magic_session_capacity(&g_ctx->session_mgr);
+      for (int i = 0; i < capacity; i++) {
+        ClientSession *session = magic_session_at(&g_ctx->session_mgr, i);
         if (!session->in_use)
           continue;
         if (session->state != SESSION_STATE_ACTIVE)
@@ -5369,8 +6402,9 @@ static int cic_handle_madr(struct msg **msg, struct avp *avp,
         { goto add_forwarded; });
 
     if (g_ctx) {
-      for (int i = 0; i < MAX_SESSIONS; i++) {
-        ClientSession *session = &g_ctx->session_mgr.sessions[i];
+      int capacity = magic_session_capacity(&g_ctx->session_mgr);
+      for (int i = 0; i < capacity; i++) {
+        ClientSession *session = magic_session_at(&g_ctx->session_mgr, i);
         /* 注意: TERMINATED 状态的会话可能已被释放，这里只处理 in_use 的 */
         if (!session->in_use)
           continue;
@@ -5446,8 +6480,9 @@ add_forwarded:
     /* 如果请求了特定 CDR-Request-Identifier 但未找到，添加到 Unknown */
     int found = 0;
     if (g_ctx) {
-      for (int i = 0; i < MAX_SESSIONS; i++) {
-        ClientSession *session = &g_ctx->session_mgr.sessions[i];
+      int capacity = magic_session_capacity(&g_ctx->session_mgr);
+      for (int i = 0; i < capacity; i++) {
+        ClientSession *session = magic_session_at(&g_ctx->session_mgr, i);
         if (session->in_use) {
           uint32_t current_cdr_id =
               traffic_session_id_to_mark(session->session_id);
@@ -5595,7 +6630,7 @@ static int cic_handle_macr(struct msg **msg, struct avp *avp,
         magic_session_find_by_id(&g_ctx->session_mgr, requester_session_id);
     if (requester_session) {
       requester_profile = magic_config_find_client(
-          &g_ctx->config, requester_session->client_id);
+          cic_config(), requester_session->client_id);
     }
   }
 
@@ -5850,7 +6885,7 @@ static bool check_session_activation_conditions(ClientSession *session,
  * @brief 为会话重新选择链路
  * @param ctx MAGIC 上下文
  * @param session 会话对象
- * @param state ADIF 飞机状态
+ * @param state ADIF 飞机状态 (NULL = 无 ADIF 数据)
  * @param profile 客户端配置文件
  * @return 新选择的链路ID（如果改变），NULL 如果保持不变或失败
  */
@@ -5858,7 +6893,7 @@ static const char *reevaluate_session_link(MagicContext *ctx,
                                            ClientSession *session,
                                            const AdifAircraftState *state,
                                            ClientProfile *profile) {
-  if (!ctx || !session || !state) {
+  if (!ctx || !session) {
     return NULL;
   }
 
@@ -5876,50 +6911,52 @@ static const char *reevaluate_session_link(MagicContext *ctx,
   policy_req.required_ret_bw_kbps = session->granted_ret_bw_kbps / 2;
 
   /* 填充 ADIF 数据 */
-  policy_req.aircraft_lat = state->position.latitude;
-  policy_req.aircraft_lon = state->position.longitude;
-  policy_req.aircraft_alt = state->position.altitude_ft * 0.3048;
-  policy_req.on_ground = state->wow.on_ground;
-  policy_req.has_adif_data = true;
+  if (state) {
+    policy_req.aircraft_lat = state->position.latitude;
+    policy_req.aircraft_lon = state->position.longitude;
+    policy_req.aircraft_alt = state->position.altitude_ft * 0.3048;
+    policy_req.on_ground = state->wow.on_ground;
+    policy_req.has_adif_data = true;
 
-  /* 根据飞行阶段设置请求中的 flight_phase */
-  switch (state->flight_phase.phase) {
-  case FLIGHT_PHASE_GATE:
-    strncpy(policy_req.flight_phase, "GATE",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_TAXI:
-    strncpy(policy_req.flight_phase, "TAXI",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_TAKEOFF:
-    strncpy(policy_req.flight_phase, "TAKE-OFF",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_CLIMB:
-    strncpy(policy_req.flight_phase, "CLIMB",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_CRUISE:
-    strncpy(policy_req.flight_phase, "CRUISE",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_DESCENT:
-    strncpy(policy_req.flight_phase, "DESCENT",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_APPROACH:
-    strncpy(policy_req.flight_phase, "APPROACH",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  case FLIGHT_PHASE_LANDING:
-    strncpy(policy_req.flight_phase, "LANDING",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
-  default:
-    strncpy(policy_req.flight_phase, "GATE",
-            sizeof(policy_req.flight_phase) - 1);
-    break;
+    /* 根据飞行阶段设置请求中的 flight_phase */
+    switch (state->flight_phase.phase) {
+    case FLIGHT_PHASE_GATE:
+      strncpy(policy_req.flight_phase, "GATE",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_TAXI:
+      strncpy(policy_req.flight_phase, "TAXI",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_TAKEOFF:
+      strncpy(policy_req.flight_phase, "TAKE-OFF",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_CLIMB:
+      strncpy(policy_req.flight_phase, "CLIMB",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_CRUISE:
+      strncpy(policy_req.flight_phase, "CRUISE",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_DESCENT:
+      strncpy(policy_req.flight_phase, "DESCENT",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_APPROACH:
+      strncpy(policy_req.flight_phase, "APPROACH",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    case FLIGHT_PHASE_LANDING:
+      strncpy(policy_req.flight_phase, "LANDING",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    default:
+      strncpy(policy_req.flight_phase, "GATE",
+              sizeof(policy_req.flight_phase) - 1);
+      break;
+    }
   }
 
   /* 调用策略引擎 */
@@ -5947,24 +6984,149 @@ static const char *reevaluate_session_link(MagicContext *ctx,
   return new_link_id;
 }
 
+/**
+ * @brief 发送链路切换完成通知。
+ * @details 刷新会话网关并按 ARINC 839 §4.1.3.3 发送 MNTR (NOTIFY_HANDOVER)。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param session 会话对象 (assigned_link_id 已更新)。
+ */
+static void notify_link_handover(MagicContext *ctx, ClientSession *session) {
+  const char *new_link_id = session->assigned_link_id;
+
+  char gateway_ip[64] = {0};
+  if (magic_dataplane_get_link_gateway(&ctx->dataplane_ctx, new_link_id,
+                                       gateway_ip, sizeof(gateway_ip)) == 0) {
+    /* 更新会话网关信息 */
+    strncpy(session->gateway_ip, gateway_ip, sizeof(session->gateway_ip) - 1);
+  }
+
+  /* 调用专用接口发送 MNTR (NOTIFY_HANDOVER) */
+  if (magic_cic_on_handover(ctx, session, new_link_id, gateway_ip) == 0) {
+    fd_log_notice(
+        "[app_magic]     MNTR sent to client: new_link=%s, gateway=%s",
+        new_link_id, gateway_ip[0] ? gateway_ip : "(unknown)");
+  } else {
+    fd_log_error("[app_magic]     ⚠ Failed to send MNTR to client");
+  }
+
+  fd_log_notice("[app_magic]   ✓ Handover complete: %s now using %s",
+                session->session_id, new_link_id);
+}
+
+/**
+ * @brief 已申请到新链路资源、尚未生效的会话切换。
+ * @details 批量切换时准入提交、会话更新、旧承载释放与 MNTR 都推迟到
+ *          数据平面事务提交成功之后；提交失败则回滚准入并释放新承载，
+ *          会话原样留在旧链路上。
+ */
+typedef struct {
+  ClientSession *session;    ///< 切换的会话。
+  char old_link_id[64];      ///< 切换前的链路。
+  uint8_t old_bearer_id;     ///< 旧链路上的承载 ID (0 = 无)。
+  char new_link_id[64];      ///< 目标链路。
+  uint8_t new_bearer_id;     ///< 新链路上分配的承载 ID (0 = 无)。
+  uint32_t granted_fwd_kbps; ///< 新链路上批准的下行带宽。
+  uint32_t granted_ret_kbps; ///< 新链路上批准的上行带宽。
+} LinkHandoverPending;
+
+/**
+ * @brief 释放链路上的一个承载 (不等待确认)。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param link_id 链路 ID。
+ * @param bearer_id 承载 ID (0 = 未分配)。
+ */
+static void release_handover_bearer(MagicContext *ctx, const char *link_id,
+                                    uint8_t bearer_id) {
+  MIH_Link_Resource_Request release_req;
+  memset(&release_req, 0, sizeof(release_req));
+  snprintf(release_req.destination_id.mihf_id,
+           sizeof(release_req.destination_id.mihf_id), "MIHF_%s", link_id);
+  /* 设置 link_identifier 用于查找 DLM */
+  strncpy(release_req.link_identifier.link_addr, link_id,
+          sizeof(release_req.link_identifier.link_addr) - 1);
+  release_req.resource_action = RESOURCE_ACTION_RELEASE;
+  release_req.has_bearer_id = (bearer_id > 0);
+  release_req.bearer_identifier = bearer_id;
+
+  /* 不等待释放确认 */
+  magic_lmi_resource_request_async(&ctx->lmi_ctx, &release_req, 0, NULL, NULL);
+
+  fd_log_notice("[app_magic]     Released resources on %s (bearer=%u)",
+                link_id, bearer_id);
+}
+
+/**
+ * @brief 使切换生效: 提交准入、更新会话、释放旧承载并发送 MNTR。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param ho 已申请到新链路资源的切换。
+ */
+static void finish_link_handover(MagicContext *ctx,
+                                 const LinkHandoverPending *ho) {
+  ClientSession *session = ho->session;
+
+  /* 提交预留 (替换旧链路上的预留) */
+  magic_admission_commit(&ctx->admission_ctx, session->session_id, NULL);
+  session->granted_bw_kbps = ho->granted_fwd_kbps;
+  session->granted_ret_bw_kbps = ho->granted_ret_kbps;
+
+  /* 4. 路由已切到新链路后再释放旧链路资源 (先建后拆) */
+  if (ho->old_link_id[0]) {
+    release_handover_bearer(ctx, ho->old_link_id, ho->old_bearer_id);
+  }
+
+  /* 5. 更新会话信息 */
+  strncpy(session->assigned_link_id, ho->new_link_id,
+          sizeof(session->assigned_link_id) - 1);
+  session->bearer_id = ho->new_bearer_id;
+
+  /* 6. 根据 ARINC 839 §4.1.3.3 发送 MNTR 通知客户端链路切换 */
+  notify_link_handover(ctx, session);
+}
+
+/**
+ * @brief 放弃未生效的切换: 回滚准入预留并释放新承载，会话留在旧链路。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param ho 已申请到新链路资源的切换。
+ */
+static void abort_link_handover(MagicContext *ctx,
+                                const LinkHandoverPending *ho) {
+  magic_admission_rollback(&ctx->admission_ctx, ho->session->session_id);
+  release_handover_bearer(ctx, ho->new_link_id, ho->new_bearer_id);
+  fd_log_notice("[app_magic]     Handover of %s rolled back, staying on %s",
+                ho->session->session_id,
+                ho->old_link_id[0] ? ho->old_link_id : "(none)");
+}
+
 /**
  * @brief 执行会话链路切换 (Handover)。
- * @details 执行以下步骤：
- *          1. 释放旧链路资源 (MIH Release)。
- *          2. 申请新链路资源 (MIH Request)。
- *          3. 确保新链路已注册到数据平面 (Register Link)。
- *          4. 切换数据平面路由 (Switch Route)。
- *          5. 发送 MNTR 通知客户端 (Notify Client)。
+ * @details 按先建后拆 (make-before-break) 顺序执行以下步骤：
+ *          1. 申请新链路资源 (MIH Request)，失败时旧链路保持不动。
+ *          2. 确保新链路已注册到数据平面 (Register Link)。
+ *          3. 切换数据平面路由 (Switch Route)。
+ *          4. 释放旧链路资源 (MIH Release)。
+ *          5. 更新会话信息。
+ *          6. 发送 MNTR 通知客户端 (Notify Client)。
+ *
+ *          txn 非 NULL 时第 3 步只登记到数据平面事务，其余步骤记入
+ *          pending，由 commit_link_handovers 在事务提交后完成或回滚，
+ *          多个会话共用一次提交。
  *
  * @param ctx MAGIC 上下文。
  * @param session 会话对象。
  * @param old_link_id 旧链路 ID。
  * @param new_link_id 新链路 ID。
+ * @param txn 数据平面事务 (NULL = 立即切换并通知)。
+ * @param[out] pending 批量时记录待提交的切换 (txn 为 NULL 时不使用)。
  * @return 0 成功，-1 失败。
  */
 static int perform_link_handover(MagicContext *ctx, ClientSession *session,
                                  const char *old_link_id,
-                                 const char *new_link_id) {
+                                 const char *new_link_id, DataplaneTxn *txn,
+                                 LinkHandoverPending *pending) {
   if (!ctx || !session || !new_link_id) {
     return -1;
   }
@@ -5972,30 +7134,30 @@ static int perform_link_handover(MagicContext *ctx, ClientSession *session,
   fd_log_notice("[app_magic]   → Performing handover: %s -> %s",
                 old_link_id ? old_link_id : "(none)", new_link_id);
 
-  /* 1. 释放旧链路资源 */
-  if (old_link_id && old_link_id[0]) {
-    MIH_Link_Resource_Request release_req;
-    memset(&release_req, 0, sizeof(release_req));
-    snprintf(release_req.destination_id.mihf_id,
-             sizeof(release_req.destination_id.mihf_id), "MIHF_%s",
-             old_link_id);
-    /* 设置 link_identifier 用于查找 DLM */
-    strncpy(release_req.link_identifier.link_addr, old_link_id,
-            sizeof(release_req.link_identifier.link_addr) - 1);
-    release_req.resource_action = RESOURCE_ACTION_RELEASE;
-    release_req.has_bearer_id = (session->bearer_id > 0);
-    release_req.bearer_identifier = session->bearer_id;
-
-    MIH_Link_Resource_Confirm release_confirm;
-    memset(&release_confirm, 0, sizeof(release_confirm));
-    magic_dlm_mih_link_resource_request(&ctx->lmi_ctx, &release_req,
-                                        &release_confirm);
-
-    fd_log_notice("[app_magic]     Released resources on %s (bearer=%u)",
-                  old_link_id, session->bearer_id);
-  }
-
-  /* 2. 请求新链路资源 */
+  /* 0. 先在新链路上预留带宽，不足则保持旧链路不动 */
+  ClientProfile *profile =
+      magic_config_find_client(cic_config(), session->client_id);
+  AdmissionRequest adm_req;
+  memset(&adm_req, 0, sizeof(adm_req));
+  adm_req.session_id = session->session_id;
+  adm_req.client_id = session->client_id;
+  adm_req.link_id = new_link_id;
+  adm_req.requested_fwd_kbps = session->granted_bw_kbps;
+  adm_req.requested_ret_kbps = session->granted_ret_bw_kbps;
+  adm_req.priority_class = profile ? profile->qos.priority_class : 0;
+
+  AdmissionGrant grant;
+  AdmissionResult adm =
+      magic_admission_reserve(&ctx->admission_ctx, &adm_req, &grant);
+  if (adm != ADMISSION_OK) {
+    fd_log_notice("[app_magic]     ⚠ Handover to %s not admitted (%s), "
+                  "staying on %s",
+                  new_link_id, magic_admission_result_str(adm),
+                  old_link_id ? old_link_id : "(none)");
+    return -1;
+  }
+
+  /* 1. 请求新链路资源 (旧链路保持不动) */
   MIH_Link_Resource_Request alloc_req;
   memset(&alloc_req, 0, sizeof(alloc_req));
   snprintf(alloc_req.destination_id.mihf_id,
@@ -6006,8 +7168,8 @@ static int perform_link_handover(MagicContext *ctx, ClientSession *session,
   alloc_req.resource_action = RESOURCE_ACTION_REQUEST;
   alloc_req.has_qos_params = true;
   alloc_req.qos_parameters.cos_id = COS_BEST_EFFORT;
-  alloc_req.qos_parameters.forward_link_rate = session->granted_bw_kbps;
-  alloc_req.qos_parameters.return_link_rate = session->granted_ret_bw_kbps;
+  alloc_req.qos_parameters.forward_link_rate = grant.granted_fwd_kbps;
+  alloc_req.qos_parameters.return_link_rate = grant.granted_ret_kbps;
 
   MIH_Link_Resource_Confirm alloc_confirm;
   memset(&alloc_confirm, 0, sizeof(alloc_confirm));
@@ -6018,7 +7180,8 @@ static int perform_link_handover(MagicContext *ctx, ClientSession *session,
     fd_log_error(
         "[app_magic]     ✗ Failed to allocate resources on %s (status=%d)",
         new_link_id, alloc_confirm.status);
-    /* 尝试恢复旧链路（可选，暂不实现） */
+    /* 旧链路尚未释放，回滚新链路上的预留即可 */
+    magic_admission_rollback(&ctx->admission_ctx, session->session_id);
     return -1;
   }
 
@@ -6026,7 +7189,21 @@ static int perform_link_handover(MagicContext *ctx, ClientSession *session,
       "[app_magic]     Allocated resources on %s (bearer=%u)", new_link_id,
       alloc_confirm.has_bearer_id ? alloc_confirm.bearer_identifier : 0);
 
-  /* 2.5 确保新链路已注册到数据平面（按需注册） */
+  /* 准入提交与会话更新在切换生效时进行 (finish_link_handover) */
+  LinkHandoverPending local;
+  LinkHandoverPending *ho = txn ? pending : &local;
+  memset(ho, 0, sizeof(*ho));
+  ho->session = session;
+  snprintf(ho->old_link_id, sizeof(ho->old_link_id), "%s",
+           old_link_id ? old_link_id : "");
+  ho->old_bearer_id = session->bearer_id;
+  snprintf(ho->new_link_id, sizeof(ho->new_link_id), "%s", new_link_id);
+  ho->new_bearer_id =
+      alloc_confirm.has_bearer_id ? alloc_confirm.bearer_identifier : 0;
+  ho->granted_fwd_kbps = grant.granted_fwd_kbps;
+  ho->granted_ret_kbps = grant.granted_ret_kbps;
+
+  /* 2. 确保新链路已注册到数据平面（按需注册） */
   uint32_t table_id =
       magic_dataplane_get_table_id(&ctx->dataplane_ctx, new_link_id);
   if (table_id == 0) {
@@ -6071,9 +7248,20 @@ static int perform_link_handover(MagicContext *ctx, ClientSession *session,
     }
   }
 
-  /* 3. 使用专用函数切换数据平面路由 */
-  if (magic_dataplane_switch_client_link(
-          &ctx->dataplane_ctx, session->session_id, new_link_id) == 0) {
+  /* 3. 使用专用函数切换数据平面路由 (批量时仅登记, 由调用方统一提交) */
+  if (txn) {
+    if (magic_dataplane_txn_switch_session(txn, session->session_id,
+                                           new_link_id) != 0) {
+      fd_log_error("[app_magic]     ✗ Failed to queue dataplane switch");
+      abort_link_handover(ctx, ho);
+      return -1;
+    }
+    return 0; /* 4-6 步在事务提交后完成 */
+  }
+
+  if (magic_dataplane_switch_client_link(&ctx->dataplane_ctx,
+                                         session->session_id,
+                                         new_link_id) == 0) {
     fd_log_notice("[app_magic]     Switched dataplane routing to %s",
                   new_link_id);
   } else {
@@ -6081,33 +7269,48 @@ static int perform_link_handover(MagicContext *ctx, ClientSession *session,
     /* 继续更新会话信息，路由切换失败不阻止会话更新 */
   }
 
-  /* 4. 更新会话信息 */
-  strncpy(session->assigned_link_id, new_link_id,
-          sizeof(session->assigned_link_id) - 1);
-  session->bearer_id =
-      alloc_confirm.has_bearer_id ? alloc_confirm.bearer_identifier : 0;
+  /* 4-6. 提交准入、释放旧链路资源、更新会话并发送 MNTR */
+  finish_link_handover(ctx, ho);
+  return 0;
+}
 
-  /* 5. 根据 ARINC 839 §4.1.3.3 发送 MNTR 通知客户端链路切换 */
-  char gateway_ip[64] = {0};
-  if (magic_dataplane_get_link_gateway(&ctx->dataplane_ctx, new_link_id,
-                                       gateway_ip, sizeof(gateway_ip)) == 0) {
-    /* 更新会话网关信息 */
-    strncpy(session->gateway_ip, gateway_ip, sizeof(session->gateway_ip) - 1);
+/**
+ * @brief 提交批量切换事务，使切换生效或整体回滚。
+ * @details 提交后按各会话在事务中的结果处理: 切换成功的提交准入、更新会话、
+ *          释放旧承载并发送 MNTR；失败的流量仍走旧链路，回滚准入、释放新承载，
+ *          会话与旧承载保持不变，也不通知客户端。事务在处理完全部切换后释放。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param txn 数据平面事务 (提交后释放)。
+ * @param moved 已申请到新链路资源、等待提交的切换。
+ * @param count 切换数量。
+ * @return 生效的切换数。
+ */
+static int commit_link_handovers(MagicContext *ctx, DataplaneTxn *txn,
+                                 LinkHandoverPending *moved, int count) {
+  if (count > 0) {
+    int switched = magic_dataplane_txn_commit(txn);
+    if (switched >= 0) {
+      fd_log_notice("[app_magic]   Switched dataplane routing for %d "
+                    "session(s) in one commit (%d TFT rules)",
+                    count, switched);
+    } else {
+      fd_log_error("[app_magic]   ✗ Failed to switch dataplane routing, "
+                   "rolling back %d handover(s)", count);
+    }
   }
 
-  /* 调用专用接口发送 MNTR (NOTIFY_HANDOVER) */
-  if (magic_cic_on_handover(ctx, session, new_link_id, gateway_ip) == 0) {
-    fd_log_notice(
-        "[app_magic]     MNTR sent to client: new_link=%s, gateway=%s",
-        new_link_id, gateway_ip[0] ? gateway_ip : "(unknown)");
-  } else {
-    fd_log_error("[app_magic]     ⚠ Failed to send MNTR to client");
+  int finished = 0;
+  for (int i = 0; i < count; i++) {
+    if (magic_dataplane_txn_result(txn, moved[i].session->session_id) >= 0) {
+      finish_link_handover(ctx, &moved[i]);
+      finished++;
+    } else {
+      abort_link_handover(ctx, &moved[i]);
+    }
   }
-
-  fd_log_notice("[app_magic]   ✓ Handover complete: %s now using %s",
-                session->session_id, new_link_id);
-
-  return 0;
+  magic_dataplane_txn_release(txn);
+  return finished;
 }
 
 /**
@@ -6127,16 +7330,30 @@ void on_adif_state_changed(const AdifAircraftState *state, void *user_data) {
 
   MagicContext *ctx = (MagicContext *)user_data;
 
+  /* ADIF 接收线程: 整轮重评估使用同一个配置快照 */
+  magic_config_read_begin(&ctx->config_store);
+
   fd_log_notice("[app_magic] ========================================");
   fd_log_notice("[app_magic] ADIF State Changed - Reevaluating Sessions");
   fd_log_notice("[app_magic] WoW=%d, Alt=%.0f ft, Phase=%s",
                 state->wow.on_ground, state->position.altitude_ft,
                 adif_flight_phase_to_string(state->flight_phase.phase));
 
-  /* 获取所有活动会话 */
-  ClientSession *active_sessions[MAX_SESSIONS];
+  /* 获取所有活动会话 (按会话池当前容量分配快照) */
+  int capacity = magic_session_capacity(&ctx->session_mgr);
+  ClientSession **active_sessions =
+      calloc(capacity > 0 ? capacity : 1, sizeof(*active_sessions));
+  LinkHandoverPending *moved =
+      calloc(capacity > 0 ? capacity : 1, sizeof(*moved));
+  if (!active_sessions || !moved) {
+    fd_log_error("[app_magic] ✗ Out of memory, skipping reevaluation");
+    free(active_sessions);
+    free(moved);
+    magic_config_read_end(&ctx->config_store);
+    return;
+  }
   int session_count = magic_session_get_active_sessions(
-      &ctx->session_mgr, active_sessions, MAX_SESSIONS);
+      &ctx->session_mgr, active_sessions, capacity);
 
   fd_log_notice("[app_magic] Reevaluating %d active sessions", session_count);
 
@@ -6144,13 +7361,18 @@ void on_adif_state_changed(const AdifAircraftState *state, void *user_data) {
   int handover_count = 0;
   int unchanged_count = 0;
 
+  /* 所有切换的数据平面改写合并为一次提交 */
+  DataplaneTxn txn;
+  DataplaneTxn *txn_ptr =
+      magic_dataplane_txn_begin(&ctx->dataplane_ctx, &txn) == 0 ? &txn : NULL;
+
   /* 检查每个会话 */
   for (int i = 0; i < session_count; i++) {
     ClientSession *session = active_sessions[i];
 
     /* 查找客户端配置文件 */
     ClientProfile *profile =
-        magic_config_find_client(&ctx->config, session->client_id);
+        magic_config_find_client(cic_config(), session->client_id);
     if (!profile) {
       fd_log_notice("[app_magic]   Session %s: no profile found, skipping",
                     session->session_id);
@@ -6176,14 +7398,14 @@ void on_adif_state_changed(const AdifAircraftState *state, void *user_data) {
                  session->assigned_link_id);
         mih_req.resource_action = RESOURCE_ACTION_RELEASE;
 
-        MIH_Link_Resource_Confirm mih_confirm;
-        memset(&mih_confirm, 0, sizeof(mih_confirm));
-        magic_dlm_mih_link_resource_request(&ctx->lmi_ctx, &mih_req,
-                                            &mih_confirm);
+        magic_lmi_resource_request_async(&ctx->lmi_ctx, &mih_req, 0, NULL,
+                                         NULL);
+        magic_admission_release(&ctx->admission_ctx, session->session_id);
 
         /* 清除数据平面路由 */
         magic_dataplane_remove_client_route(&ctx->dataplane_ctx,
                                             session->session_id);
+        magic_flow_remove_session(&ctx->flow_ctx, session->session_id);
       }
 
       /* TODO: 发送 STR (Session Termination Request) 通知客户端 */
@@ -6209,8 +7431,8 @@ void on_adif_state_changed(const AdifAircraftState *state, void *user_data) {
             "[app_magic]   ⚡ Session %s: link change detected (%s -> %s)",
             session->session_id, old_link_id, new_link_id);
 
-        if (perform_link_handover(ctx, session, old_link_id, new_link_id) ==
-            0) {
+        if (perform_link_handover(ctx, session, old_link_id, new_link_id,
+                                  txn_ptr, &moved[handover_count]) == 0) {
           handover_count++;
         } else {
           fd_log_error("[app_magic]   ✗ Handover failed for session %s",
@@ -6229,11 +7451,110 @@ void on_adif_state_changed(const AdifAircraftState *state, void *user_data) {
     }
   }
 
+  if (txn_ptr) {
+    handover_count = commit_link_handovers(ctx, txn_ptr, moved, handover_count);
+  }
+
   fd_log_notice("[app_magic] Session reevaluation complete:");
   fd_log_notice("[app_magic]   - Terminated: %d", terminated_count);
   fd_log_notice("[app_magic]   - Handovers: %d", handover_count);
   fd_log_notice("[app_magic]   - Unchanged: %d", unchanged_count);
   fd_log_notice("[app_magic] ========================================\n");
+
+  free(active_sessions);
+  free(moved);
+  magic_config_read_end(&ctx->config_store);
+}
+
+/**
+ * @brief 链路中断或预测即将中断时把其上的会话整体迁移到备用链路。
+ * @details 对仍在使用 link_id 的 ACTIVE 会话重新执行链路选择 (该链路已
+ *          标记为离线或劣化，策略会选出备用链路)，逐个完成准入与 MIH 资源
+ *          切换 (先建后拆)，数据平面改写合并为一次事务提交，之后再逐个发送
+ *          MNTR。找不到备用链路或切换失败的会话保持原链路，由调用方按原流程
+ *          挂起 (链路劣化时则继续留在原链路上)。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param link_id 中断或劣化的链路 ID。
+ * @return 迁移成功的会话数，-1 参数错误。
+ */
+int magic_cic_failover_link(MagicContext *ctx, const char *link_id) {
+  if (!ctx || !link_id || !link_id[0]) {
+    return -1;
+  }
+
+  int capacity = magic_session_capacity(&ctx->session_mgr);
+  ClientSession **active_sessions =
+      calloc(capacity > 0 ? capacity : 1, sizeof(*active_sessions));
+  LinkHandoverPending *moved =
+      calloc(capacity > 0 ? capacity : 1, sizeof(*moved));
+  if (!active_sessions || !moved) {
+    fd_log_error("[app_magic] ✗ Out of memory, cannot fail over %s", link_id);
+    free(active_sessions);
+    free(moved);
+    return 0;
+  }
+  int session_count = magic_session_get_active_sessions(
+      &ctx->session_mgr, active_sessions, capacity);
+
+  AdifAircraftState state;
+  const AdifAircraftState *state_ptr = NULL;
+  if (adif_client_is_connected(&ctx->adif_ctx) &&
+      adif_client_get_state(&ctx->adif_ctx, &state) == 0) {
+    state_ptr = &state;
+  }
+
+  DataplaneTxn txn;
+  if (magic_dataplane_txn_begin(&ctx->dataplane_ctx, &txn) != 0) {
+    free(active_sessions);
+    free(moved);
+    return 0;
+  }
+
+  int moved_count = 0;
+  int affected = 0;
+
+  for (int i = 0; i < session_count; i++) {
+    ClientSession *session = active_sessions[i];
+    if (session->state != SESSION_STATE_ACTIVE ||
+        strcmp(session->assigned_link_id, link_id) != 0) {
+      continue;
+    }
+    affected++;
+
+    ClientProfile *profile =
+        magic_config_find_client(cic_config(), session->client_id);
+    const char *selected =
+        reevaluate_session_link(ctx, session, state_ptr, profile);
+    if (!selected) {
+      fd_log_notice("[app_magic]   ⚠ Session %s: no fallback link available",
+                    session->session_id);
+      continue;
+    }
+
+    char new_link_id[64];
+    strncpy(new_link_id, selected, sizeof(new_link_id) - 1);
+    new_link_id[sizeof(new_link_id) - 1] = '\0';
+
+    fd_log_notice("[app_magic]   ⚡ Session %s: failover %s -> %s",
+                  session->session_id, link_id, new_link_id);
+
+    if (perform_link_handover(ctx, session, link_id, new_link_id, &txn,
+                              &moved[moved_count]) == 0) {
+      moved_count++;
+    }
+  }
+
+  moved_count = commit_link_handovers(ctx, &txn, moved, moved_count);
+
+  if (affected > 0) {
+    fd_log_notice("[app_magic] Link %s failover: %d/%d session(s) moved to "
+                  "fallback links",
+                  link_id, moved_count, affected);
+  }
+  free(active_sessions);
+  free(moved);
+  return moved_count;
 }
 
 /**
@@ -6277,12 +7598,12 @@ int magic_cic_init(MagicContext *ctx) {
 
   /* 注册 MCAR (Client Authentication Request) 处理器 */
   when.command = g_magic_dict.cmd_mcar;
-  CHECK_FCT(fd_disp_register(cic_handle_mcar, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_mcar, &when));
   fd_log_notice("[app_magic] ✓ MCAR handler registered");
 
   /* 注册 MCCR (Communication Change Request) 处理器 */
   when.command = g_magic_dict.cmd_mccr;
-  CHECK_FCT(fd_disp_register(cic_handle_mccr, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_mccr, &when));
   fd_log_notice("[app_magic] ✓ MCCR handler registered");
 
   /* STR 使用标准 Diameter 命令 (Session Termination Request) */
@@ -6295,32 +7616,32 @@ int magic_cic_init(MagicContext *ctx) {
                  return -1;
                });
   when.command = cmd_str; /* 设置为标准 STR 命令 */
-  CHECK_FCT(fd_disp_register(cic_handle_str, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_str, &when));
   fd_log_notice("[app_magic] ✓ STR handler registered");
 
   /* 注册 MNTR (Notification Report) 处理器 */
   when.command = g_magic_dict.cmd_mntr;
-  CHECK_FCT(fd_disp_register(cic_handle_mntr, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_mntr, &when));
   fd_log_notice("[app_magic] ✓ MNTR handler registered");
 
   /* 注册 MSCR (Status Change Report) 处理器 */
   when.command = g_magic_dict.cmd_mscr;
-  CHECK_FCT(fd_disp_register(cic_handle_mscr, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_mscr, &when));
   fd_log_notice("[app_magic] ✓ MSCR handler registered");
 
   /* 注册 MSXR (Status Request) 处理器 */
   when.command = g_magic_dict.cmd_msxr;
-  CHECK_FCT(fd_disp_register(cic_handle_msxr, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_msxr, &when));
   fd_log_notice("[app_magic] ✓ MSXR handler registered");
 
   /* 注册 MADR (Accounting Data Request) 处理器 */
   when.command = g_magic_dict.cmd_madr;
-  CHECK_FCT(fd_disp_register(cic_handle_madr, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_madr, &when));
   fd_log_notice("[app_magic] ✓ MADR handler registered");
 
   /* 注册 MACR (Accounting Control Request) 处理器 */
   when.command = g_magic_dict.cmd_macr;
-  CHECK_FCT(fd_disp_register(cic_handle_macr, DISP_HOW_CC, &when, NULL, NULL));
+  CHECK_FCT(cic_register_handler(cic_handle_macr, &when));
   fd_log_notice("[app_magic] ✓ MACR handler registered");
 
   return 0; /* 初始化成功 */
@@ -6335,6 +7656,8 @@ int magic_cic_init(MagicContext *ctx) {
 
 void magic_cic_cleanup(MagicContext *ctx) {
   if (ctx) {
+    mccr_queue_dump_stats();
+    magic_cic_push_dump_stats();
     g_ctx = NULL; /* 清空全局上下文指针 */
     fd_log_notice("[app_magic] CIC module cleaned up");
   }
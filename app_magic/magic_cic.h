@@ -69,4 +69,25 @@ int magic_cic_init(MagicContext *ctx);
  */
 void magic_cic_cleanup(MagicContext *ctx);
 
+/**
+ * @brief 唤醒 MCCR 排队调度器。
+ * @details 在可能释放出资源的事件后调用 (链路 UP、带宽释放、会话关闭)，
+ *          调度器在定时器线程中按优先级为排队请求分配资源并以 MNTR 通知客户端。
+ *          可在任意线程调用，多次唤醒会合并。
+ *
+ * @param reason 唤醒原因 (仅用于日志)。
+ */
+void magic_cic_queue_wakeup(const char *reason);
+
+/**
+ * @brief 链路中断或预测即将中断时把其上的会话迁移到备用链路。
+ * @details 重新为受影响的 ACTIVE 会话选择链路并先建后拆，全部会话的数据
+ *          平面切换在一次事务中提交。未能迁移的会话保持原链路，由调用方挂起。
+ *
+ * @param ctx 指向 MAGIC 系统上下文的指针。
+ * @param link_id 中断或劣化的链路 ID。
+ * @return 迁移成功的会话数，-1 参数错误。
+ */
+int magic_cic_failover_link(MagicContext *ctx, const char *link_id);
+
 #endif /* MAGIC_CIC_H */ /* 头文件保护宏结束 */
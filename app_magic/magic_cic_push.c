@@ -16,6 +16,7 @@
 #include "add_avp.h"
 #include "magic_dict_handles.h"
 #include "magic_group_avp_simple.h"
+#include "magic_hash.h"
 #include <freeDiameter/freeDiameter-host.h>
 #include <freeDiameter/libfdcore.h>
 
@@ -24,6 +25,596 @@
 /* 前向声明 */
 static MagicContext *g_push_ctx = NULL; /* 用于超时回调访问上下文 */
 
+/*===========================================================================
+ * 推送调度器
+ *
+ * 待发送状态按会话池下标存放 (与 magic_session_at() 的下标一一对应，随会话池
+ * 扩容按需加倍)，由 g_push_sched.lock 保护:
+ * - MNTR: 每个会话最多一条待发送变更，新变更覆盖旧变更
+ * - MSCR: 事件表按 DLM 名称 (MAGIC 状态事件共用一项) 合并，会话槽位用
+ *   位图记录尚未送达的事件，事件在所有目标送达后释放
+ * - 对端表: 开放寻址哈希表，按 Origin-Host 查找，记录令牌桶与在途请求数；
+ *   令牌已补满且无在途请求的项可被新对端直接复用
+ * - 在途请求 (事务): 固定大小的事务池，发送前在对端窗口内预留，应答回调
+ *   以 (下标, 代数) 句柄找回事务；超时由哈希时间轮驱动
+ *
+ * 入队后在 PUSH_COALESCE_MS 后于定时器线程中统一发送 (push_flush)；
+ * 持锁只做快照与记账，构造与发送消息在锁外进行。
+ *===========================================================================*/
+
+/* 单个会话的待发送状态 */
+typedef struct {
+  char session_id[MAX_SESSION_ID_LEN]; /* 入队时的会话 ID (防止槽位复用) */
+  bool mntr_pending;                   /* 有待发送的 MNTR */
+  bool force_send;                     /* 合并期间任一变更要求强制发送 */
+  uint32_t magic_status_code;          /* MAGIC-Status-Code */
+  uint32_t granted_bw;                 /* 授予带宽 (bps) */
+  uint32_t granted_ret_bw;             /* 返回带宽 (bps) */
+  uint32_t bearer_id;                  /* Bearer ID */
+  char error_message[128];             /* Error-Message (空=无) */
+  char link_id[64];                    /* 新链路 ID (空=无) */
+  char gateway_ip[64];                 /* 新网关 IP (空=无) */
+  uint32_t mscr_mask; /* 待送达的 MSCR 事件 (位 i 对应 events[i]) */
+} PushSlot;
+
+/* 待广播的 MSCR 事件 */
+typedef struct {
+  bool in_use;                /* 是否在使用 */
+  StatusChangeType type;      /* 状态变更类型 */
+  uint32_t magic_status_code; /* MAGIC-Status-Code */
+  int dlm_available;          /* 0=可用, 1=不可用 */
+  char dlm_name[64];          /* DLM 名称 (空=MAGIC 状态事件) */
+  char error_message[128];    /* Error-Message (空=无) */
+  uint32_t refs;              /* 尚未送达的目标数 */
+} PushEvent;
+
+/* 对端状态 */
+typedef struct {
+  char peer[64];         /* 对端 Origin-Host (空=未使用) */
+  uint32_t tokens_milli; /* 剩余令牌 (千分之一条) */
+  uint64_t refill_ms;    /* 上次补充时间 (单调时钟) */
+  uint32_t inflight;     /* 在途请求数 (含已预留未发送) */
+} PushPeerBucket;
+
+/* 在途请求类型 */
+typedef enum {
+  PUSH_TXN_MNTR = 1,         /* MNTR 等待 MNTA */
+  PUSH_TXN_MSCR = 2,         /* MSCR 等待 MSCA */
+  PUSH_TXN_MSCR_INITIAL = 3, /* 订阅后的初始 MSCR 等待 MSCA */
+} PushTxnKind;
+
+/* 在途请求 (事务) */
+typedef struct {
+  bool in_use;         /* 是否在使用 */
+  bool armed;          /* 已挂入时间轮 */
+  bool claimed;        /* 已被应答/超时处理取走 (句柄已失效) */
+  uint8_t kind;        /* PushTxnKind */
+  uint16_t gen;        /* 代数，句柄失效时递增 */
+  uint16_t attempt;    /* 已重试次数 */
+  int32_t session_idx; /* 会话池下标 */
+  int16_t peer_idx;    /* 对端表下标 (-1=未计入窗口) */
+  uint16_t bucket;     /* 所在时间轮槽 */
+  int prev;            /* 时间轮链表前驱 (-1=无) */
+  int next;            /* 时间轮链表后继 / 空闲链表 (-1=无) */
+  uint32_t rounds;     /* 到期前还需经过的整圈数 */
+  char session_id[MAX_SESSION_ID_LEN]; /* 会话 ID */
+  union {
+    PushSlot mntr;  /* MNTR 内容 (重试时重建消息) */
+    PushEvent mscr; /* MSCR 事件 (重试时重建消息) */
+  } u;
+} PushTxn;
+
+/* MNTR 发送快照 */
+typedef struct {
+  ClientSession *session; /* 目标会话 */
+  PushSlot slot;          /* 入队内容副本 */
+  int txn;                /* 预留的事务 */
+} PushMntrJob;
+
+typedef struct {
+  PushSlot *slots;                      /* 会话待发送状态 */
+  int *mntr_txn;                        /* 会话当前的 MNTR 事务 (-1=无) */
+  int session_capacity;                 /* slots/mntr_txn 的长度 */
+  PushEvent events[PUSH_MAX_EVENTS];    /* MSCR 事件表 */
+  PushPeerBucket peers[PUSH_MAX_PEERS]; /* 对端表 */
+  bool flush_scheduled;                 /* 发送任务是否已排程 */
+
+  /* 在途请求与时间轮 */
+  PushTxn txns[PUSH_ACK_MAX_TXNS];  /* 事务池 */
+  int txn_free;                     /* 空闲链表头 (-1=耗尽) */
+  uint32_t txn_active;              /* 已分配的事务数 */
+  uint32_t txn_armed;               /* 挂在时间轮上的事务数 */
+  int wheel[PUSH_ACK_WHEEL_SLOTS];  /* 时间轮槽链表头 */
+  uint64_t wheel_tick;              /* 已处理到的刻度 */
+  bool tick_scheduled;              /* 时间轮推进任务是否已排程 */
+  PushAckPolicy ack;                /* 超时/重试/窗口参数 */
+  bool initialized;                 /* 事务池是否已初始化 */
+
+  MagicPushStats stats;                 /* 统计 (原子更新) */
+  pthread_mutex_t lock;                 /* 保护除 stats 外的字段 */
+} PushScheduler;
+
+static PushScheduler g_push_sched = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+#define PUSH_STAT_ADD(field, n)                                                \
+  __atomic_add_fetch(&g_push_sched.stats.field, (n), __ATOMIC_RELAXED)
+
+/* push_admit 的失败原因 */
+#define PUSH_ADMIT_RATE -1   /* 对端令牌不足 */
+#define PUSH_ADMIT_WINDOW -2 /* 对端在途窗口已满或事务池耗尽 */
+
+static void push_flush(void *arg);
+static void push_ack_tick(void *arg);
+
+/**
+ * @brief 初始化事务池与时间轮 (持锁调用，只执行一次)。
+ */
+static void push_init_locked(void) {
+  if (g_push_sched.initialized) {
+    return;
+  }
+
+  for (int i = 0; i < PUSH_ACK_MAX_TXNS; i++) {
+    g_push_sched.txns[i].next = i + 1 < PUSH_ACK_MAX_TXNS ? i + 1 : -1;
+  }
+  g_push_sched.txn_free = 0;
+  for (int i = 0; i < PUSH_ACK_WHEEL_SLOTS; i++) {
+    g_push_sched.wheel[i] = -1;
+  }
+  g_push_sched.wheel_tick = magic_timer_now_ms() / PUSH_ACK_TICK_MS;
+
+  if (g_push_sched.ack.ack_timeout_ms == 0) {
+    g_push_sched.ack.ack_timeout_ms = MNTR_ACK_TIMEOUT_SEC * 1000;
+    g_push_sched.ack.max_retries = 2;
+    g_push_sched.ack.backoff_factor = 2;
+    g_push_sched.ack.max_timeout_ms = 4 * MNTR_ACK_TIMEOUT_SEC * 1000;
+    g_push_sched.ack.inflight_window = 8;
+  }
+  g_push_sched.initialized = true;
+}
+
+/**
+ * @brief 确保会话下标 session_idx 有对应的槽位 (持锁调用)。
+ * @details 按会话池容量加倍扩容，新槽位清零、MNTR 事务置 -1。扩容会搬移
+ *          数组，调用方不得跨越本函数持有槽位指针。
+ * @return 0 成功，-1 内存不足。
+ */
+static int push_reserve_locked(int session_idx) {
+  int old = g_push_sched.session_capacity;
+  if (session_idx < old) {
+    return 0;
+  }
+
+  int cap = old ? old : MAGIC_SESSION_CHUNK;
+  while (cap <= session_idx) {
+    cap *= 2;
+  }
+  PushSlot *slots = realloc(g_push_sched.slots, (size_t)cap * sizeof(*slots));
+  if (!slots) {
+    return -1;
+  }
+  g_push_sched.slots = slots;
+  int *mntr_txn =
+      realloc(g_push_sched.mntr_txn, (size_t)cap * sizeof(*mntr_txn));
+  if (!mntr_txn) {
+    return -1;
+  }
+  g_push_sched.mntr_txn = mntr_txn;
+
+  memset(&slots[old], 0, (size_t)(cap - old) * sizeof(*slots));
+  for (int i = old; i < cap; i++) {
+    mntr_txn[i] = -1;
+  }
+  g_push_sched.session_capacity = cap;
+  return 0;
+}
+
+/**
+ * @brief 查找或创建对端表项并补充令牌 (持锁调用)。
+ * @param peer 对端 Origin-Host。
+ * @param now_ms 当前单调时钟 (毫秒)。
+ * @return 表项下标，表满且无可复用项时返回 -1 (不限速、不计窗口)。
+ */
+static int push_peer_get(const char *peer, uint64_t now_ms) {
+  const uint32_t full = PUSH_PEER_BURST * 1000u;
+  const uint64_t idle_ms =
+      (uint64_t)PUSH_PEER_BURST * 1000 / PUSH_PEER_RATE_PER_SEC;
+
+  uint32_t h = magic_fnv1a32_str(peer);
+
+  int found = -1;
+  int reusable = -1;
+  for (uint32_t i = 0; i < PUSH_MAX_PEERS; i++) {
+    int pos = (int)((h + i) & (PUSH_MAX_PEERS - 1));
+    PushPeerBucket *b = &g_push_sched.peers[pos];
+    if (b->peer[0] == '\0') {
+      found = reusable >= 0 ? reusable : pos;
+      break;
+    }
+    if (strcmp(b->peer, peer) == 0) {
+      found = pos;
+      break;
+    }
+    if (reusable < 0 && b->inflight == 0 && now_ms - b->refill_ms >= idle_ms) {
+      reusable = pos; /* 令牌已补满且无在途请求，等价于新表项 */
+    }
+  }
+  if (found < 0) {
+    found = reusable;
+  }
+  if (found < 0) {
+    return -1;
+  }
+
+  PushPeerBucket *bucket = &g_push_sched.peers[found];
+  if (strcmp(bucket->peer, peer) != 0) {
+    strncpy(bucket->peer, peer, sizeof(bucket->peer) - 1);
+    bucket->peer[sizeof(bucket->peer) - 1] = '\0';
+    bucket->tokens_milli = full;
+    bucket->refill_ms = now_ms;
+    bucket->inflight = 0;
+  }
+
+  uint64_t refill = (now_ms - bucket->refill_ms) * PUSH_PEER_RATE_PER_SEC;
+  if (refill >= full - bucket->tokens_milli) {
+    bucket->tokens_milli = full;
+  } else {
+    bucket->tokens_milli += (uint32_t)refill;
+  }
+  bucket->refill_ms = now_ms;
+  return found;
+}
+
+/* 事务句柄: 高 16 位为代数，低 16 位为下标 + 1 (0 表示不跟踪) */
+static void *push_txn_handle(int idx) {
+  if (idx < 0) {
+    return NULL;
+  }
+  return (void *)(uintptr_t)(((uint32_t)g_push_sched.txns[idx].gen << 16) |
+                             (uint32_t)(idx + 1));
+}
+
+/**
+ * @brief 把事务从时间轮上摘下 (持锁调用)。
+ */
+static void push_wheel_unlink(int idx) {
+  PushTxn *t = &g_push_sched.txns[idx];
+  if (!t->armed) {
+    return;
+  }
+  if (t->prev >= 0) {
+    g_push_sched.txns[t->prev].next = t->next;
+  } else {
+    g_push_sched.wheel[t->bucket] = t->next;
+  }
+  if (t->next >= 0) {
+    g_push_sched.txns[t->next].prev = t->prev;
+  }
+  t->armed = false;
+  g_push_sched.txn_armed--;
+}
+
+/**
+ * @brief 释放事务，归还对端窗口 (持锁调用)。
+ */
+static void push_txn_release_locked(int idx) {
+  PushTxn *t = &g_push_sched.txns[idx];
+  if (!t->in_use) {
+    return;
+  }
+
+  push_wheel_unlink(idx);
+  if (t->session_idx >= 0 && g_push_sched.mntr_txn[t->session_idx] == idx) {
+    g_push_sched.mntr_txn[t->session_idx] = -1;
+  }
+  if (t->peer_idx >= 0 && g_push_sched.peers[t->peer_idx].inflight > 0) {
+    g_push_sched.peers[t->peer_idx].inflight--;
+  }
+
+  t->in_use = false;
+  t->claimed = false;
+  t->gen++;
+  t->next = g_push_sched.txn_free;
+  g_push_sched.txn_free = idx;
+  g_push_sched.txn_active--;
+}
+
+/**
+ * @brief 释放事务 (发送失败或发送前被抑制时调用)。
+ */
+static void push_txn_drop(int idx) {
+  if (idx < 0) {
+    return;
+  }
+  pthread_mutex_lock(&g_push_sched.lock);
+  push_txn_release_locked(idx);
+  pthread_mutex_unlock(&g_push_sched.lock);
+}
+
+/**
+ * @brief 为一次推送预留事务 (持锁调用)。
+ * @details 检查对端令牌 (use_token 时) 与在途窗口，成功后占用一个窗口位。
+ *          新的 MNTR 事务取代同一会话尚未应答的旧 MNTR 事务，旧事务的
+ *          应答到达时被忽略。
+ *
+ * @param session_idx 会话池下标。
+ * @param session 目标会话。
+ * @param kind 事务类型。
+ * @param payload 重试所需内容 (PushSlot 或 PushEvent，可为 NULL)。
+ * @param attempt 已重试次数。
+ * @param use_token 是否消耗对端令牌 (重试不消耗)。
+ * @param now_ms 当前单调时钟。
+ * @return 事务下标 (>=0)，PUSH_ADMIT_RATE 或 PUSH_ADMIT_WINDOW。
+ */
+static int push_admit_locked(int session_idx, const ClientSession *session,
+                             PushTxnKind kind, const void *payload,
+                             uint16_t attempt, bool use_token,
+                             uint64_t now_ms) {
+  push_init_locked();
+  if (push_reserve_locked(session_idx) != 0) {
+    return PUSH_ADMIT_WINDOW;
+  }
+
+  int peer_idx = push_peer_get(session->client_id, now_ms);
+  PushPeerBucket *bucket = peer_idx >= 0 ? &g_push_sched.peers[peer_idx] : NULL;
+
+  if (bucket && g_push_sched.ack.inflight_window > 0 &&
+      bucket->inflight >= g_push_sched.ack.inflight_window) {
+    return PUSH_ADMIT_WINDOW;
+  }
+  if (g_push_sched.txn_free < 0) {
+    return PUSH_ADMIT_WINDOW;
+  }
+  if (use_token && bucket) {
+    if (bucket->tokens_milli < 1000) {
+      return PUSH_ADMIT_RATE;
+    }
+    bucket->tokens_milli -= 1000;
+  }
+
+  if (kind == PUSH_TXN_MNTR) {
+    int old = g_push_sched.mntr_txn[session_idx];
+    if (old >= 0 && !g_push_sched.txns[old].claimed) {
+      push_txn_release_locked(old); /* 被新的 MNTR 取代 */
+    }
+    g_push_sched.mntr_txn[session_idx] = -1;
+  }
+
+  int idx = g_push_sched.txn_free;
+  PushTxn *t = &g_push_sched.txns[idx];
+  g_push_sched.txn_free = t->next;
+  g_push_sched.txn_active++;
+
+  t->in_use = true;
+  t->armed = false;
+  t->claimed = false;
+  t->kind = (uint8_t)kind;
+  t->attempt = attempt;
+  t->session_idx = session_idx;
+  t->peer_idx = (int16_t)peer_idx;
+  t->prev = t->next = -1;
+  strncpy(t->session_id, session->session_id, sizeof(t->session_id) - 1);
+  t->session_id[sizeof(t->session_id) - 1] = '\0';
+  if (kind == PUSH_TXN_MNTR && payload) {
+    t->u.mntr = *(const PushSlot *)payload;
+  } else if (kind == PUSH_TXN_MSCR && payload) {
+    t->u.mscr = *(const PushEvent *)payload;
+  }
+
+  if (bucket) {
+    bucket->inflight++;
+  }
+  if (kind == PUSH_TXN_MNTR) {
+    g_push_sched.mntr_txn[session_idx] = idx;
+  }
+  return idx;
+}
+
+/**
+ * @brief 计算第 attempt 次重试的应答超时。
+ */
+static uint32_t push_ack_timeout_ms(uint16_t attempt) {
+  uint64_t t = g_push_sched.ack.ack_timeout_ms;
+  for (uint16_t i = 0; i < attempt; i++) {
+    t *= g_push_sched.ack.backoff_factor ? g_push_sched.ack.backoff_factor : 1;
+    if (t >= g_push_sched.ack.max_timeout_ms) {
+      break;
+    }
+  }
+  if (g_push_sched.ack.max_timeout_ms && t > g_push_sched.ack.max_timeout_ms) {
+    t = g_push_sched.ack.max_timeout_ms;
+  }
+  return (uint32_t)t;
+}
+
+/**
+ * @brief 排程时间轮推进任务 (有挂起事务且尚未排程时)。
+ */
+static void push_ack_schedule(MagicContext *ctx) {
+  pthread_mutex_lock(&g_push_sched.lock);
+  bool need_schedule =
+      g_push_sched.txn_armed > 0 && !g_push_sched.tick_scheduled;
+  if (need_schedule) {
+    g_push_sched.tick_scheduled = true;
+  }
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  if (need_schedule && magic_timer_schedule(&ctx->timer_ctx, PUSH_ACK_TICK_MS,
+                                            push_ack_tick, ctx) != 0) {
+    pthread_mutex_lock(&g_push_sched.lock);
+    g_push_sched.tick_scheduled = false;
+    pthread_mutex_unlock(&g_push_sched.lock);
+  }
+}
+
+/**
+ * @brief 消息发出后把事务挂入时间轮。
+ * @details 应答可能在挂入之前到达，此时句柄已失效，直接忽略。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param handle 发送时使用的事务句柄。
+ */
+static void push_txn_arm(MagicContext *ctx, void *handle) {
+  uintptr_t h = (uintptr_t)handle;
+  int idx = (int)(h & 0xFFFF) - 1;
+  if (idx < 0 || idx >= PUSH_ACK_MAX_TXNS) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_push_sched.lock);
+  PushTxn *t = &g_push_sched.txns[idx];
+  if (!t->in_use || t->claimed || t->armed || t->gen != (uint16_t)(h >> 16)) {
+    pthread_mutex_unlock(&g_push_sched.lock);
+    return;
+  }
+
+  uint64_t now_ms = magic_timer_now_ms();
+  if (g_push_sched.txn_armed == 0) {
+    g_push_sched.wheel_tick = now_ms / PUSH_ACK_TICK_MS; /* 空轮直接对齐 */
+  }
+
+  uint64_t target =
+      (now_ms + push_ack_timeout_ms(t->attempt) + PUSH_ACK_TICK_MS - 1) /
+      PUSH_ACK_TICK_MS;
+  if (target <= g_push_sched.wheel_tick) {
+    target = g_push_sched.wheel_tick + 1;
+  }
+  t->rounds =
+      (uint32_t)((target - g_push_sched.wheel_tick - 1) / PUSH_ACK_WHEEL_SLOTS);
+  t->bucket = (uint16_t)(target & (PUSH_ACK_WHEEL_SLOTS - 1));
+  t->prev = -1;
+  t->next = g_push_sched.wheel[t->bucket];
+  if (t->next >= 0) {
+    g_push_sched.txns[t->next].prev = idx;
+  }
+  g_push_sched.wheel[t->bucket] = idx;
+  t->armed = true;
+  g_push_sched.txn_armed++;
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  push_ack_schedule(ctx);
+}
+
+/**
+ * @brief 按句柄取走事务 (应答回调中调用)。
+ * @details 成功后事务从时间轮摘下、句柄失效，由调用者独占，处理完后
+ *          调用 push_txn_drop 或 push_txn_fail。
+ *
+ * @param handle 事务句柄。
+ * @param out 输出: 事务内容副本。
+ * @return 事务下标，句柄已失效 (超时已处理、被取代或不跟踪) 时返回 -1。
+ */
+static int push_txn_claim(void *handle, PushTxn *out) {
+  uintptr_t h = (uintptr_t)handle;
+  int idx = (int)(h & 0xFFFF) - 1;
+  if (idx < 0 || idx >= PUSH_ACK_MAX_TXNS) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_push_sched.lock);
+  PushTxn *t = &g_push_sched.txns[idx];
+  if (!t->in_use || t->claimed || t->gen != (uint16_t)(h >> 16)) {
+    pthread_mutex_unlock(&g_push_sched.lock);
+    return -1;
+  }
+  push_wheel_unlink(idx);
+  t->claimed = true;
+  t->gen++;
+  *out = *t;
+  pthread_mutex_unlock(&g_push_sched.lock);
+  return idx;
+}
+
+/**
+ * @brief 释放槽位上尚未送达的 MSCR 事件并清空槽位 (持锁调用)。
+ * @param slot 会话槽位。
+ * @return 被丢弃的通知数。
+ */
+static uint32_t push_slot_reset(PushSlot *slot) {
+  uint32_t dropped = slot->mntr_pending ? 1 : 0;
+
+  for (int e = 0; e < PUSH_MAX_EVENTS; e++) {
+    if (slot->mscr_mask & (1u << e)) {
+      PushEvent *ev = &g_push_sched.events[e];
+      if (--ev->refs == 0) {
+        ev->in_use = false;
+      }
+      dropped++;
+    }
+  }
+
+  slot->mntr_pending = false;
+  slot->force_send = false;
+  slot->mscr_mask = 0;
+  return dropped;
+}
+
+/**
+ * @brief 取会话对应的槽位，槽位属于已结束的旧会话时先清空 (持锁调用)。
+ * @param ctx MAGIC 上下文。
+ * @param session 会话 (须属于 ctx->session_mgr)。
+ * @return 槽位指针，会话不在会话池中或内存不足时返回 NULL。
+ */
+static PushSlot *push_slot_get(MagicContext *ctx,
+                               const ClientSession *session) {
+  int idx = magic_session_index(&ctx->session_mgr, session);
+  if (idx < 0 || push_reserve_locked(idx) != 0) {
+    return NULL;
+  }
+
+  PushSlot *slot = &g_push_sched.slots[idx];
+  if (strcmp(slot->session_id, session->session_id) != 0) {
+    uint32_t dropped = push_slot_reset(slot);
+    if (dropped) {
+      PUSH_STAT_ADD(discarded, dropped);
+    }
+    strncpy(slot->session_id, session->session_id,
+            sizeof(slot->session_id) - 1);
+    slot->session_id[sizeof(slot->session_id) - 1] = '\0';
+  }
+  return slot;
+}
+
+/**
+ * @brief 排程一次发送任务。
+ * @param ctx MAGIC 上下文。
+ * @param delay_ms 延迟 (毫秒)。
+ * @return 0 成功 (或已排程)，-1 定时器不可用。
+ */
+static int push_kick(MagicContext *ctx, uint32_t delay_ms) {
+  pthread_mutex_lock(&g_push_sched.lock);
+  bool need_schedule = !g_push_sched.flush_scheduled;
+  g_push_sched.flush_scheduled = true;
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  if (!need_schedule) {
+    return 0;
+  }
+
+  if (magic_timer_schedule(&ctx->timer_ctx, delay_ms, push_flush, ctx) != 0) {
+    pthread_mutex_lock(&g_push_sched.lock);
+    g_push_sched.flush_scheduled = false;
+    pthread_mutex_unlock(&g_push_sched.lock);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief 计算会话的 Destination-Realm。
+ * @details 优先使用会话中保存的客户端 Origin-Realm，否则从 client_id 提取。
+ */
+static void push_dest_realm(const ClientSession *session, char *out,
+                            size_t size) {
+  const char *realm = session->client_realm;
+  if (!realm[0]) {
+    const char *at = strchr(session->client_id, '.');
+    realm = at ? at + 1 : "client.local";
+  }
+  strncpy(out, realm, size - 1);
+  out[size - 1] = '\0';
+}
+
 /**
  * @brief 检查是否应该发送 MNTR (风暴抑制)。
  * @details 实现了基于时间窗和变化阈值的抑制逻辑：
@@ -91,21 +682,237 @@ bool magic_cic_should_send_mntr(ClientSession *session, uint32_t new_bw_kbps,
   return true;
 }
 
+/**
+ * @brief 取事务对应的会话，会话已结束 (槽位被复用) 时返回 NULL。
+ */
+static ClientSession *push_txn_session(MagicContext *ctx, const PushTxn *t) {
+  if (!ctx || t->session_idx < 0) {
+    return NULL;
+  }
+  ClientSession *session = magic_session_at(&ctx->session_mgr, t->session_idx);
+  if (!session || !session->in_use ||
+      strcmp(session->session_id, t->session_id) != 0) {
+    return NULL;
+  }
+  return session;
+}
+
+/**
+ * @brief 收到应答后释放事务。
+ * @return true 该事务是会话最新的 MNTR (可清除 mntr_pending_ack)。
+ */
+static bool push_txn_ack(int idx) {
+  pthread_mutex_lock(&g_push_sched.lock);
+  const PushTxn *t = &g_push_sched.txns[idx];
+  bool latest = t->kind == PUSH_TXN_MNTR && t->session_idx >= 0 &&
+                g_push_sched.mntr_txn[t->session_idx] == idx;
+  push_txn_release_locked(idx);
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  PUSH_STAT_ADD(acked, 1);
+  return latest;
+}
+
+static int mntr_send_now(MagicContext *ctx, ClientSession *session,
+                         const MNTRParams *params, int txn);
+static int push_deliver_mscr(MagicContext *ctx, const PushEvent *ev,
+                             ClientSession **targets, const int *txns,
+                             int count);
+static int mscr_send_initial(MagicContext *ctx, ClientSession *session,
+                             uint16_t attempt);
+
+/**
+ * @brief 由槽位内容还原 MNTR 参数 (指针指向槽位内的字符串)。
+ */
+static void push_params_from_slot(MNTRParams *params, const PushSlot *s) {
+  memset(params, 0, sizeof(*params));
+  params->magic_status_code = s->magic_status_code;
+  params->error_message = s->error_message;
+  params->new_granted_bw = s->granted_bw;
+  params->new_granted_ret_bw = s->granted_ret_bw;
+  params->new_link_id = s->link_id[0] ? s->link_id : NULL;
+  params->new_bearer_id = s->bearer_id;
+  params->new_gateway_ip = s->gateway_ip;
+  params->force_send = s->force_send;
+}
+
+/**
+ * @brief 把 MNTR 参数写入槽位。
+ */
+static void push_slot_fill(PushSlot *slot, const MNTRParams *params) {
+  slot->magic_status_code = params->magic_status_code;
+  slot->granted_bw = params->new_granted_bw;
+  slot->granted_ret_bw = params->new_granted_ret_bw;
+  slot->bearer_id = params->new_bearer_id;
+  snprintf(slot->error_message, sizeof(slot->error_message), "%s",
+           params->error_message ? params->error_message : "");
+  snprintf(slot->link_id, sizeof(slot->link_id), "%s",
+           params->new_link_id ? params->new_link_id : "");
+  snprintf(slot->gateway_ip, sizeof(slot->gateway_ip), "%s",
+           params->new_gateway_ip ? params->new_gateway_ip : "");
+}
+
+/**
+ * @brief 处理未得到应答的事务: 按退避重发或放弃。
+ * @details 事务须已被取走 (push_txn_claim 或超时摘除)。重试次数未用完时
+ *          以同样内容重发 (不消耗对端令牌)；已被新 MNTR 取代、会话已结束
+ *          的事务直接丢弃。放弃时沿用 v2.1 策略:
+ *          - MNTR: 视为客户端不可达，强制关闭会话
+ *          - MSCR: 取消该客户端的状态订阅
+ *
+ * @param ctx MAGIC 上下文。
+ * @param idx 事务下标。
+ */
+static void push_txn_fail(MagicContext *ctx, int idx) {
+  pthread_mutex_lock(&g_push_sched.lock);
+  PushTxn t = g_push_sched.txns[idx];
+  bool superseded = t.kind == PUSH_TXN_MNTR &&
+                    g_push_sched.mntr_txn[t.session_idx] != idx;
+  push_txn_release_locked(idx);
+
+  ClientSession *session = push_txn_session(ctx, &t);
+  bool retry =
+      session && !superseded && t.attempt < g_push_sched.ack.max_retries;
+  int next = -1;
+  if (retry && t.kind != PUSH_TXN_MSCR_INITIAL) {
+    const void *payload =
+        t.kind == PUSH_TXN_MNTR ? (const void *)&t.u.mntr : &t.u.mscr;
+    next = push_admit_locked(t.session_idx, session, (PushTxnKind)t.kind,
+                             payload, t.attempt + 1, false,
+                             magic_timer_now_ms());
+    retry = next >= 0;
+  }
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  if (!session || superseded) {
+    return; /* 会话已结束或已有更新的 MNTR 在途 */
+  }
+
+  if (retry) {
+    PUSH_STAT_ADD(retried, 1);
+    fd_log_notice("[app_magic] ⚠ %s to session %s unanswered, retry %u/%u",
+                  t.kind == PUSH_TXN_MNTR ? "MNTR" : "MSCR", t.session_id,
+                  t.attempt + 1, g_push_sched.ack.max_retries);
+
+    if (t.kind == PUSH_TXN_MNTR) {
+      MNTRParams params;
+      push_params_from_slot(&params, &t.u.mntr);
+      mntr_send_now(ctx, session, &params, next);
+    } else if (t.kind == PUSH_TXN_MSCR) {
+      push_deliver_mscr(ctx, &t.u.mscr, &session, &next, 1);
+    } else {
+      mscr_send_initial(ctx, session, t.attempt + 1);
+    }
+    return;
+  }
+
+  PUSH_STAT_ADD(timed_out, 1);
+
+  if (t.kind == PUSH_TXN_MNTR) {
+    /* 超时处理: 强制清理会话 */
+    fd_log_error("[app_magic] MNTA timeout for session %s after %u attempt(s) "
+                 "- forcing cleanup",
+                 t.session_id, t.attempt + 1);
+    session->mntr_pending_ack = false;
+    magic_admission_release(&ctx->admission_ctx, t.session_id);
+    magic_session_delete(&ctx->session_mgr, t.session_id);
+  } else {
+    fd_log_error("[app_magic] MSCR send failed/timeout for session %s - "
+                 "removing subscription",
+                 t.session_id);
+    session->status_subscription_active = false;
+    session->subscribed_status_level = 0;
+  }
+}
+
+/**
+ * @brief 推进时间轮，处理所有已到期的事务。
+ * @details 只访问从上次推进到当前时刻之间的槽位，每个槽位内只处理本圈
+ *          到期的事务，开销与到期数成正比，与在途总数无关。
+ *
+ * @param ctx MAGIC 上下文。
+ * @return 到期的事务数。
+ */
+static int push_ack_expire(MagicContext *ctx) {
+  uint64_t now_tick = magic_timer_now_ms() / PUSH_ACK_TICK_MS;
+  int expired = -1;
+  int count = 0;
+
+  pthread_mutex_lock(&g_push_sched.lock);
+  if (!g_push_sched.initialized) {
+    pthread_mutex_unlock(&g_push_sched.lock);
+    return 0;
+  }
+
+  while (g_push_sched.txn_armed > 0 && g_push_sched.wheel_tick < now_tick) {
+    g_push_sched.wheel_tick++;
+    int i = g_push_sched.wheel[g_push_sched.wheel_tick &
+                               (PUSH_ACK_WHEEL_SLOTS - 1)];
+    while (i >= 0) {
+      PushTxn *t = &g_push_sched.txns[i];
+      int next = t->next;
+      if (t->rounds > 0) {
+        t->rounds--;
+      } else {
+        push_wheel_unlink(i);
+        t->claimed = true;
+        t->gen++; /* 之后到达的应答被忽略 */
+        t->next = expired;
+        expired = i;
+        count++;
+      }
+      i = next;
+    }
+  }
+  if (g_push_sched.txn_armed == 0) {
+    g_push_sched.wheel_tick = now_tick;
+  }
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  /* 已取走的事务只由本线程访问，锁外重发或放弃 */
+  while (expired >= 0) {
+    int next = g_push_sched.txns[expired].next;
+    push_txn_fail(ctx, expired);
+    expired = next;
+  }
+  return count;
+}
+
+/**
+ * @brief 时间轮推进任务 (定时器线程)，仍有在途事务时继续排程。
+ */
+static void push_ack_tick(void *arg) {
+  MagicContext *ctx = (MagicContext *)arg;
+
+  pthread_mutex_lock(&g_push_sched.lock);
+  g_push_sched.tick_scheduled = false;
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  push_ack_expire(ctx);
+  push_ack_schedule(ctx);
+}
+
 /**
  * @brief MNTR 应答 (MNTA) 回调函数。
  * @details 处理客户端对 MNTR 的响应。
- *          - 清除 pending_ack 标志。
+ *          - 按句柄找回事务并释放在途窗口。
  *          - 检查 Result-Code。
  *          - 记录日志。
- *          如果回调时 msg 为 NULL，视为超时，根据 v2.1 策略强制关闭会话。
+ *          如果回调时 msg 为 NULL (发送失败)，按重试策略重发或强制关闭会话；
+ *          超时已处理或被新 MNTR 取代的事务，其迟到应答直接丢弃。
  *
- * @param data 用户数据 (ClientSession 指针)。
+ * @param data 事务句柄。
  * @param msg 指向接收到的消息的指针。
  */
 static void mntr_answer_callback(void *data, struct msg **msg) {
-  ClientSession *session = (ClientSession *)data;
+  PushTxn txn;
+  int idx = push_txn_claim(data, &txn);
 
-  if (!session) {
+  if (idx < 0) {
+    if (data) {
+      PUSH_STAT_ADD(late_answers, 1);
+      fd_log_debug("[app_magic] Late/superseded MNTA ignored");
+    }
     if (msg && *msg) {
       fd_msg_free(*msg);
       *msg = NULL;
@@ -113,22 +920,18 @@ static void mntr_answer_callback(void *data, struct msg **msg) {
     return;
   }
 
-  /* 清除待确认标志 */
-  session->mntr_pending_ack = false;
-
   if (!msg || !*msg) {
     fd_log_error("[app_magic] MNTR answer callback: no message (timeout?)");
-
-    /* 超时处理: 强制清理会话 */
-    fd_log_error("[app_magic] MNTA timeout for session %s - forcing cleanup",
-                 session->session_id);
-
-    if (g_push_ctx) {
-      magic_session_delete(&g_push_ctx->session_mgr, session->session_id);
-    }
+    push_txn_fail(g_push_ctx, idx);
     return;
   }
 
+  /* 清除待确认标志 (仅当没有更新的 MNTR 在途) */
+  ClientSession *session = push_txn_session(g_push_ctx, &txn);
+  if (push_txn_ack(idx) && session) {
+    session->mntr_pending_ack = false;
+  }
+
   /* 提取 Result-Code */
   struct avp *avp_result = NULL;
   uint32_t result_code = 0;
@@ -143,7 +946,7 @@ static void mntr_answer_callback(void *data, struct msg **msg) {
 
   if (result_code == 2001) {
     fd_log_notice("[app_magic] MNTA received: SUCCESS (session: %s)",
-                  session->session_id);
+                  txn.session_id);
   } else {
     fd_log_error("[app_magic] MNTA received: FAILED (Result-Code=%u)",
                  result_code);
@@ -163,50 +966,11 @@ static void mntr_answer_callback(void *data, struct msg **msg) {
 }
 
 /**
- * @brief 发送 MNTR 通知 (v2.1 实现)。
- * @details 构造并发送 MNTR 消息。
- *          - 执行风暴抑制检查。
- *          - 填充 Communication-Report-Parameters (Profile, BW, Gateway)。
- *          - 设置超时跟踪 (last_mntr_sent_time, pending_ack)。
- *          - 注册异步回调。
- *
- * @param ctx MAGIC 上下文。
- * @param session 目标会话。
- * @param params 通知参数。
- * @return 0 成功 (或被抑制)，-1 失败。
+ * @brief 向 MNTR 添加 AVP。
+ * @return 0 成功，-1 失败 (调用者释放 mntr)。
  */
-int magic_cic_send_mntr(MagicContext *ctx, ClientSession *session,
-                        const MNTRParams *params) {
-  if (!ctx || !session || !params) {
-    return -1;
-  }
-
-  /* 保存上下文供回调使用 */
-  g_push_ctx = ctx;
-
-  /* v2.1: 风暴抑制检查 */
-  uint32_t new_bw_kbps = params->new_granted_bw / 1000;
-  if (!magic_cic_should_send_mntr(session, new_bw_kbps, params->force_send)) {
-    fd_log_notice("[app_magic] MNTR suppressed for session %s (storm control)",
-                  session->session_id);
-    return 0; /* 抑制成功，不是错误 */
-  }
-
-  struct msg *mntr = NULL;
-
-  fd_log_notice("[app_magic] ========================================");
-  fd_log_notice("[app_magic] Sending MNTR to session: %s", session->session_id);
-  fd_log_notice("[app_magic]   MAGIC-Status-Code: %u",
-                params->magic_status_code);
-  fd_log_notice("[app_magic]   Granted-BW: %u bps", params->new_granted_bw);
-  fd_log_notice("[app_magic] ========================================");
-
-  /* 创建 MNTR 消息 */
-  CHECK_FCT_DO(fd_msg_new(g_magic_dict.cmd_mntr, MSGFL_ALLOC_ETEID, &mntr), {
-    fd_log_error("[app_magic] Failed to create MNTR message");
-    return -1;
-  });
-
+static int mntr_add_avps(struct msg *mntr, ClientSession *session,
+                         const MNTRParams *params) {
   /* 添加 Session-Id */
   ADD_AVP_STR(mntr, g_std_dict.avp_session_id, session->session_id);
 
@@ -215,18 +979,10 @@ int magic_cic_send_mntr(MagicContext *ctx, ClientSession *session,
   ADD_AVP_STR(mntr, g_std_dict.avp_origin_realm, fd_g_config->cnf_diamrlm);
 
   /* 添加 Destination-Realm (客户端域) - v2.1: 优先使用会话中保存的 realm */
-  char dest_realm[128] = "";
-  if (session->client_realm[0]) {
-    /* 使用会话中保存的客户端 Origin-Realm */
-    strncpy(dest_realm, session->client_realm, sizeof(dest_realm) - 1);
-  } else {
+  char dest_realm[128];
+  push_dest_realm(session, dest_realm, sizeof(dest_realm));
+  if (!session->client_realm[0]) {
     /* 回退: 从 client_id 提取（兼容旧会话） */
-    const char *at = strchr(session->client_id, '.');
-    if (at) {
-      strncpy(dest_realm, at + 1, sizeof(dest_realm) - 1);
-    } else {
-      strncpy(dest_realm, "client.local", sizeof(dest_realm) - 1);
-    }
     fd_log_notice("[app_magic] MNTR: client_realm not stored, falling back to "
                   "extract from client_id: %s",
                   dest_realm);
@@ -265,342 +1021,1029 @@ int magic_cic_send_mntr(MagicContext *ctx, ClientSession *session,
     ADD_AVP_STR(mntr, g_std_dict.avp_error_message, params->error_message);
   }
 
+  return 0;
+}
+
+/**
+ * @brief 构造并发送 MNTR 消息 (不做抑制与限速检查)。
+ * @details
+ *          - 填充 Communication-Report-Parameters (Profile, BW, Gateway)。
+ *          - 设置超时跟踪 (last_mntr_sent_time, pending_ack)。
+ *          - 以事务句柄注册异步回调，发出后挂入时间轮。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param session 目标会话。
+ * @param params 通知参数。
+ * @param txn 预留的事务 (-1=不跟踪)，失败时由本函数释放。
+ * @return 0 成功，-1 失败。
+ */
+static int mntr_send_now(MagicContext *ctx, ClientSession *session,
+                         const MNTRParams *params, int txn) {
+  uint32_t new_bw_kbps = params->new_granted_bw / 1000;
+  struct msg *mntr = NULL;
+
+  fd_log_notice("[app_magic] ========================================");
+  fd_log_notice("[app_magic] Sending MNTR to session: %s", session->session_id);
+  fd_log_notice("[app_magic]   MAGIC-Status-Code: %u",
+                params->magic_status_code);
+  fd_log_notice("[app_magic]   Granted-BW: %u bps", params->new_granted_bw);
+  fd_log_notice("[app_magic] ========================================");
+
+  /* 创建 MNTR 消息 */
+  CHECK_FCT_DO(fd_msg_new(g_magic_dict.cmd_mntr, MSGFL_ALLOC_ETEID, &mntr), {
+    fd_log_error("[app_magic] Failed to create MNTR message");
+    push_txn_drop(txn);
+    return -1;
+  });
+
+  if (mntr_add_avps(mntr, session, params) != 0) {
+    fd_log_error("[app_magic] Failed to build MNTR message");
+    fd_msg_free(mntr);
+    push_txn_drop(txn);
+    return -1;
+  }
+
   /* v2.1: 标记待确认状态并记录发送时间 */
   session->mntr_pending_ack = true;
   session->last_mntr_sent_time = time(NULL);
   session->last_notified_bw_kbps = new_bw_kbps;
+  snprintf(session->last_notified_link_id,
+           sizeof(session->last_notified_link_id), "%s",
+           params->new_link_id ? params->new_link_id : "");
+  session->last_notified_bearer_id = params->new_bearer_id;
 
   /* 发送消息并注册回调 (异步非阻塞) */
-  CHECK_FCT_DO(fd_msg_send(&mntr, mntr_answer_callback, session), {
+  void *handle = push_txn_handle(txn);
+  CHECK_FCT_DO(fd_msg_send(&mntr, mntr_answer_callback, handle), {
     fd_log_error("[app_magic] Failed to send MNTR message");
     session->mntr_pending_ack = false;
     if (mntr)
       fd_msg_free(mntr);
+    push_txn_drop(txn);
+    return -1;
+  });
+  push_txn_arm(ctx, handle);
+
+  fd_log_notice("[app_magic] ✓ MNTR sent, waiting for MNTA%s...",
+                txn >= 0 ? "" : " (untracked)");
+
+  PUSH_STAT_ADD(sent_mntr, 1);
+  return 0;
+}
+
+/**
+ * @brief 发送 MNTR 通知 (v2.1 实现)。
+ * @details 执行风暴抑制检查、对端限速与在途窗口检查后立即发送。
+ *          强制发送的通知超出对端限速或窗口时转入推送调度器，其余直接丢弃。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param session 目标会话。
+ * @param params 通知参数。
+ * @return 0 成功 (或被抑制)，-1 失败。
+ */
+int magic_cic_send_mntr(MagicContext *ctx, ClientSession *session,
+                        const MNTRParams *params) {
+  if (!ctx || !session || !params) {
+    return -1;
+  }
+
+  /* 保存上下文供回调使用 */
+  g_push_ctx = ctx;
+
+  /* v2.1: 风暴抑制检查 */
+  uint32_t new_bw_kbps = params->new_granted_bw / 1000;
+  if (!magic_cic_should_send_mntr(session, new_bw_kbps, params->force_send)) {
+    fd_log_notice("[app_magic] MNTR suppressed for session %s (storm control)",
+                  session->session_id);
+    PUSH_STAT_ADD(suppressed, 1);
+    return 0; /* 抑制成功，不是错误 */
+  }
+
+  int session_idx = magic_session_index(&ctx->session_mgr, session);
+  if (session_idx < 0) {
+    return mntr_send_now(ctx, session, params, -1); /* 不在会话池中 */
+  }
+
+  /* 对端全局限速与在途窗口 */
+  PushSlot payload;
+  memset(&payload, 0, sizeof(payload));
+  push_slot_fill(&payload, params);
+  payload.force_send = params->force_send;
+
+  pthread_mutex_lock(&g_push_sched.lock);
+  int txn = push_admit_locked(session_idx, session, PUSH_TXN_MNTR,
+                              &payload, 0, true, magic_timer_now_ms());
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  if (txn < 0) {
+    if (txn == PUSH_ADMIT_RATE) {
+      PUSH_STAT_ADD(rate_limited, 1);
+    } else {
+      PUSH_STAT_ADD(window_full, 1);
+    }
+    if (params->force_send) {
+      fd_log_notice("[app_magic] MNTR to %s %s, deferred", session->client_id,
+                    txn == PUSH_ADMIT_RATE ? "rate-limited" : "window full");
+      return magic_cic_queue_mntr(ctx, session, params);
+    }
+    fd_log_notice("[app_magic] MNTR suppressed for session %s (peer %s %s)",
+                  session->session_id, session->client_id,
+                  txn == PUSH_ADMIT_RATE ? "rate limit" : "window full");
+    PUSH_STAT_ADD(suppressed, 1);
+    return 0;
+  }
+
+  return mntr_send_now(ctx, session, params, txn);
+}
+
+/**
+ * @brief 处理已到期的 MNTR/MSCR 应答超时。
+ * @details 推进应答时间轮，只处理已到期的事务 (O(到期数))，按重试策略
+ *          重发，重试用尽后强制关闭会话 (MNTR) 或取消订阅 (MSCR)。
+ *          时间轮由定时器自动推进，本函数供无定时器时手动驱动。
+ *
+ * @param ctx MAGIC 上下文。
+ */
+void magic_cic_check_mntr_timeouts(MagicContext *ctx) {
+  if (!ctx) {
+    return;
+  }
+
+  g_push_ctx = ctx;
+
+  int expired = push_ack_expire(ctx);
+  if (expired > 0) {
+    fd_log_notice("[app_magic] Push ACK check: %d transaction(s) expired",
+                  expired);
+  }
+}
+
+/**
+ * @brief MSCR 应答 (MSCA) 回调函数。
+ * @details 处理客户端对 MSCR 的响应。
+ *          发送失败时按重试策略重发，重试用尽后取消订阅；收到错误响应时，
+ *          为了减少网络负载和错误风暴，自动取消该客户端的订阅
+ *          (removing subscription)。
+ *
+ * @param data 事务句柄。
+ * @param msg 指向接收到的消息的指针。
+ */
+static void mscr_answer_callback(void *data, struct msg **msg) {
+  PushTxn txn;
+  int idx = push_txn_claim(data, &txn);
+
+  if (idx < 0) {
+    if (data) {
+      PUSH_STAT_ADD(late_answers, 1);
+      fd_log_debug("[app_magic] Late MSCA ignored");
+    }
+    if (msg && *msg) {
+      fd_msg_free(*msg);
+      *msg = NULL;
+    }
+    return;
+  }
+
+  /* 发送失败 - 重试或移除订阅 */
+  if (!msg || !*msg) {
+    push_txn_fail(g_push_ctx, idx);
+    return;
+  }
+
+  ClientSession *session = push_txn_session(g_push_ctx, &txn);
+  push_txn_ack(idx);
+
+  struct avp *avp_result = NULL;
+  uint32_t result_code = 0;
+
+  if (fd_msg_search_avp(*msg, g_std_dict.avp_result_code, &avp_result) == 0 &&
+      avp_result) {
+    struct avp_hdr *hdr;
+    if (fd_msg_avp_hdr(avp_result, &hdr) == 0 && hdr->avp_value) {
+      result_code = hdr->avp_value->u32;
+    }
+  }
+
+  if (result_code == 2001) {
+    fd_log_notice("[app_magic] MSCA received from %s: SUCCESS",
+                  txn.session_id);
+  } else {
+    /* MSCA 失败 - 移除订阅 */
+    fd_log_error("[app_magic] MSCA failed from %s: Result-Code=%u - removing "
+                 "subscription",
+                 txn.session_id, result_code);
+    if (session) {
+      session->status_subscription_active = false;
+      session->subscribed_status_level = 0;
+    }
+  }
+
+  fd_msg_free(*msg);
+  *msg = NULL;
+}
+
+/**
+ * @brief 根据订阅级别判断会话需要的 MSCR 内容。
+ * @details
+ *          - MAGIC 状态: 订阅级别 1, 3, 7。
+ *          - DLM 状态: 订阅级别 2, 3, 6, 7。
+ *
+ * @param session 会话。
+ * @param type 状态变更类型。
+ * @param need_magic 输出: 是否包含 MAGIC 状态 (Registered-Clients)。
+ * @param need_dlm 输出: 是否包含 DLM 状态 (DLM-List)。
+ * @return true 该会话需要接收此类变更。
+ */
+static bool mscr_subscription(const ClientSession *session,
+                              StatusChangeType type, bool *need_magic,
+                              bool *need_dlm) {
+  *need_dlm = (session->subscribed_status_level >= 2);
+  *need_magic = (session->subscribed_status_level == 1 ||
+                 session->subscribed_status_level == 3 ||
+                 session->subscribed_status_level == 7);
+
+  if (type == STATUS_CHANGE_CLIENT_JOIN || type == STATUS_CHANGE_CLIENT_LEAVE) {
+    return *need_magic; /* MAGIC 状态变更 */
+  }
+  return *need_dlm; /* DLM 状态变更 */
+}
+
+/**
+ * @brief 向 MSCR 添加各目标共用的 AVP。
+ * @details Origin-Host/Realm、Registered-Clients、DLM-List、MAGIC-Status-Code、
+ *          Error-Message；Session-Id 与 Destination-Realm 由复制时补充。
+ *
+ * @return 0 成功，-1 失败 (调用者释放 mscr)。
+ */
+static int mscr_add_shared_avps(MagicContext *ctx, struct msg *mscr,
+                                const PushEvent *ev, bool need_magic,
+                                bool need_dlm) {
+  ADD_AVP_STR(mscr, g_std_dict.avp_origin_host, fd_g_config->cnf_diamid);
+  ADD_AVP_STR(mscr, g_std_dict.avp_origin_realm, fd_g_config->cnf_diamrlm);
+
+  /* 添加 Registered-Clients (如果订阅了 MAGIC 状态) */
+  if (need_magic) {
+    ADD_AVP_U32(mscr, g_magic_dict.avp_registered_clients,
+                ctx->session_mgr.session_count);
+  }
+
+  /* 添加 DLM-List (如果订阅了 DLM 状态)；先挂到消息上，失败时随消息释放 */
+  if (need_dlm && ev->dlm_name[0]) {
+    struct avp *dlm_list_avp = NULL;
+    CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_dlm_list, 0, &dlm_list_avp),
+                 return -1);
+    CHECK_FCT_DO(fd_msg_avp_add(mscr, MSG_BRW_LAST_CHILD, dlm_list_avp), {
+      fd_msg_free((struct msg *)dlm_list_avp);
+      return -1;
+    });
+
+    struct avp *dlm_info_avp = NULL;
+    CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_dlm_info, 0, &dlm_info_avp),
+                 return -1);
+    CHECK_FCT_DO(
+        fd_msg_avp_add(dlm_list_avp, MSG_BRW_LAST_CHILD, dlm_info_avp), {
+          fd_msg_free((struct msg *)dlm_info_avp);
+          return -1;
+        });
+
+    /* 1. DLM-Name (10004) */
+    ADD_AVP_STR(dlm_info_avp, g_magic_dict.avp_dlm_name, ev->dlm_name);
+
+    /* 2. DLM-Available (10005) - Enum: 1=YES, 2=NO, 3=UNKNOWN */
+    /* ev->dlm_available 为 0/1，映射为 1/2 */
+    int32_t avail_enum = (ev->dlm_available == 0) ? 1 : 2;
+    ADD_AVP_I32(dlm_info_avp, g_magic_dict.avp_dlm_available, avail_enum);
+
+    /* 3. DLM-Max-Links (10010) */
+    ADD_AVP_U32(dlm_info_avp, g_magic_dict.avp_dlm_max_links, MAX_BEARERS);
+
+    /* 4. DLM-Max-Bandwidth (10006) - Float32 */
+    ADD_AVP_FLOAT(dlm_info_avp, g_magic_dict.avp_dlm_max_bw,
+                  10000.0f); /* 10 Mbps Mock */
+
+    /* 5. DLM-Allocated-Links (10011) */
+    /* For broadcast, we don't have easy access to DlmClient struct here,
+     * assume 0 or 1? Ideally we should fetch DlmClient. Using 0 to carry on.
+     */
+    ADD_AVP_U32(dlm_info_avp, g_magic_dict.avp_dlm_alloc_links, 0);
+
+    /* 6. DLM-Allocated-Bandwidth (10007) - Float32 */
+    ADD_AVP_FLOAT(dlm_info_avp, g_magic_dict.avp_dlm_alloc_bw, 0.0f);
+
+    /* 7. DLM-QoS-Level-List (20009) */
+    struct avp *list_avp = NULL;
+    CHECK_FCT_DO(
+        fd_msg_avp_new(g_magic_dict.avp_dlm_qos_level_list, 0, &list_avp),
+        return -1);
+    CHECK_FCT_DO(fd_msg_avp_add(dlm_info_avp, MSG_BRW_LAST_CHILD, list_avp), {
+      fd_msg_free((struct msg *)list_avp);
+      return -1;
+    });
+    ADD_AVP_I32(list_avp, g_magic_dict.avp_qos_level, 0); /* BE */
+  }
+
+  /* 添加 MAGIC-Status-Code (如果有) */
+  if (ev->magic_status_code > 0) {
+    ADD_AVP_U32(mscr, g_magic_dict.avp_magic_status_code,
+                ev->magic_status_code);
+  }
+
+  /* 添加 Error-Message (如果有) */
+  if (ev->error_message[0]) {
+    ADD_AVP_STR(mscr, g_std_dict.avp_error_message, ev->error_message);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief 构造 MSCR 共享负载 (序列化后的模板消息)。
+ * @param ctx MAGIC 上下文。
+ * @param ev 事件。
+ * @param need_magic 是否包含 MAGIC 状态。
+ * @param need_dlm 是否包含 DLM 状态。
+ * @param buf 输出: 负载缓冲区 (malloc，调用者释放)。
+ * @param len 输出: 负载长度。
+ * @return 0 成功，-1 失败。
+ */
+static int mscr_build_payload(MagicContext *ctx, const PushEvent *ev,
+                              bool need_magic, bool need_dlm, uint8_t **buf,
+                              size_t *len) {
+  struct msg *tmpl = NULL;
+  CHECK_FCT_DO(fd_msg_new(g_magic_dict.cmd_mscr, MSGFL_ALLOC_ETEID, &tmpl),
+               return -1);
+
+  if (mscr_add_shared_avps(ctx, tmpl, ev, need_magic, need_dlm) != 0) {
+    fd_log_error("[app_magic] Failed to build MSCR payload");
+    fd_msg_free(tmpl);
+    return -1;
+  }
+
+  CHECK_FCT_DO(fd_msg_bufferize(tmpl, buf, len), {
+    fd_msg_free(tmpl);
+    return -1;
+  });
+
+  fd_msg_free(tmpl);
+  PUSH_STAT_ADD(payloads, 1);
+  return 0;
+}
+
+/**
+ * @brief 在 ref 的指定位置插入字符串 AVP。
+ */
+static int push_insert_str_avp(msg_or_avp *ref, enum msg_brw_dir dir,
+                               struct dict_object *model, const char *str) {
+  struct avp *avp = NULL;
+  CHECK_FCT_DO(fd_msg_avp_new(model, 0, &avp), return -1);
+  CHECK_FCT_DO(fd_avp_set_str(avp, str), {
+    __fd_avp_cleanup(avp);
+    return -1;
+  });
+  CHECK_FCT_DO(fd_msg_avp_add(ref, dir, avp), {
+    __fd_avp_cleanup(avp);
     return -1;
   });
-
-  fd_log_notice("[app_magic] ✓ MNTR sent, waiting for MNTA (timeout=%ds)...",
-                MNTR_ACK_TIMEOUT_SEC);
-
   return 0;
 }
 
 /**
- * @brief 检查并清理 MNTR 超时的会话。
- * @details 遍历所有活动会话，检查是否存在等待 ACK 超过规定时间
- * (MNTR_ACK_TIMEOUT_SEC) 的会话。
- *          如果超时，视为客户端不可达或协议错误，强制关闭会话。
+ * @brief 由共享负载复制出发往指定会话的 MSCR。
+ * @details 解析负载副本得到新消息，分配新的 End-to-End ID，
+ *          在 Origin-Realm 之后插入 Destination-Realm，在首位插入 Session-Id。
  *
- * @param ctx MAGIC 上下文。
+ * @param buf 共享负载。
+ * @param len 负载长度。
+ * @param session 目标会话。
+ * @return 新消息，失败返回 NULL。
  */
-void magic_cic_check_mntr_timeouts(MagicContext *ctx) {
-  if (!ctx) {
-    return;
+static struct msg *mscr_clone_payload(const uint8_t *buf, size_t len,
+                                      const ClientSession *session) {
+  uint8_t *raw = malloc(len);
+  if (!raw) {
+    return NULL;
   }
+  memcpy(raw, buf, len);
 
-  time_t now = time(NULL);
-  int timeout_count = 0;
-
-  pthread_mutex_lock(&ctx->session_mgr.mutex);
-
-  for (int i = 0; i < MAX_SESSIONS; i++) {
-    ClientSession *session = &ctx->session_mgr.sessions[i];
-
-    if (!session->in_use) {
-      continue;
-    }
-
-    /* 检查是否有待确认的 MNTR 超时 */
-    if (session->mntr_pending_ack) {
-      time_t elapsed = now - session->last_mntr_sent_time;
-
-      if (elapsed >= MNTR_ACK_TIMEOUT_SEC) {
-        fd_log_error(
-            "[app_magic] MNTR ACK timeout for session %s (elapsed=%lds)",
-            session->session_id, (long)elapsed);
-
-        /* 强制清理会话 */
-        session->mntr_pending_ack = false;
-        session->state = SESSION_STATE_CLOSED;
-        session->in_use = false;
-        ctx->session_mgr.session_count--;
-
-        timeout_count++;
+  struct msg *mscr = NULL;
+  CHECK_FCT_DO(fd_msg_parse_buffer(&raw, len, &mscr), {
+    free(raw);
+    return NULL;
+  });
+  CHECK_FCT_DO(fd_msg_parse_dict(mscr, fd_g_config->cnf_dict, NULL),
+               goto error);
+
+  struct msg_hdr *hdr = NULL;
+  CHECK_FCT_DO(fd_msg_hdr(mscr, &hdr), goto error);
+  hdr->msg_eteid = fd_msg_eteid_get();
+
+  /* 负载以 Origin-Host, Origin-Realm 开头 */
+  struct avp *origin_host = NULL;
+  struct avp *origin_realm = NULL;
+  CHECK_FCT_DO(fd_msg_browse(mscr, MSG_BRW_FIRST_CHILD, &origin_host, NULL),
+               goto error);
+  CHECK_FCT_DO(fd_msg_browse(origin_host, MSG_BRW_NEXT, &origin_realm, NULL),
+               goto error);
+  if (!origin_realm) {
+    goto error;
+  }
 
-        fd_log_notice("[app_magic] Session %s force-closed due to MNTR timeout",
-                      session->session_id);
-      }
-    }
+  char dest_realm[128];
+  push_dest_realm(session, dest_realm, sizeof(dest_realm));
+  if (push_insert_str_avp(origin_realm, MSG_BRW_NEXT,
+                          g_std_dict.avp_destination_realm, dest_realm) != 0 ||
+      push_insert_str_avp(mscr, MSG_BRW_FIRST_CHILD, g_std_dict.avp_session_id,
+                          session->session_id) != 0) {
+    goto error;
   }
 
-  pthread_mutex_unlock(&ctx->session_mgr.mutex);
+  return mscr;
 
-  if (timeout_count > 0) {
-    fd_log_notice("[app_magic] MNTR timeout check: %d session(s) force-closed",
-                  timeout_count);
-  }
+error:
+  fd_msg_free(mscr);
+  return NULL;
 }
 
 /**
- * @brief MSCR 应答 (MSCA) 回调函数。
- * @details 处理客户端对 MSCR 的响应。
- *          如果发送失败或收到错误响应，为了减少网络负载和错误风暴，
- *          自动取消该客户端的订阅 (removing subscription)。
+ * @brief 向一组会话发送同一 MSCR 事件。
+ * @details 每种订阅内容 (MAGIC/DLM/两者) 的负载只构造一次，逐目标复制发送。
  *
- * @param data 用户数据 (ClientSession 指针)。
- * @param msg 指向接收到的消息的指针。
+ * @param ctx MAGIC 上下文。
+ * @param ev 事件。
+ * @param targets 目标会话。
+ * @param txns 各目标预留的事务 (失败时由本函数释放)。
+ * @param count 目标数。
+ * @return 发送成功的数量。
  */
-static void mscr_answer_callback(void *data, struct msg **msg) {
-  ClientSession *session = (ClientSession *)data;
+static int push_deliver_mscr(MagicContext *ctx, const PushEvent *ev,
+                             ClientSession **targets, const int *txns,
+                             int count) {
+  uint8_t *payload[4] = {NULL}; /* 下标: need_magic | need_dlm << 1 */
+  size_t payload_len[4] = {0};
+  int sent_count = 0;
 
-  /* 发送失败或超时 - 移除订阅 */
-  if (!msg || !*msg) {
-    if (session) {
-      fd_log_error("[app_magic] MSCR send failed/timeout for session %s - "
-                   "removing subscription",
-                   session->session_id);
-      session->status_subscription_active = false;
-      session->subscribed_status_level = 0;
+  for (int i = 0; i < count; i++) {
+    ClientSession *session = targets[i];
+    bool need_magic, need_dlm;
+
+    if (!mscr_subscription(session, ev->type, &need_magic, &need_dlm)) {
+      push_txn_drop(txns[i]);
+      continue; /* 入队后订阅已变化 */
     }
-    return;
-  }
 
-  struct avp *avp_result = NULL;
-  uint32_t result_code = 0;
+    int variant = (need_magic ? 1 : 0) | (need_dlm ? 2 : 0);
+    if (!payload[variant] &&
+        mscr_build_payload(ctx, ev, need_magic, need_dlm, &payload[variant],
+                           &payload_len[variant]) != 0) {
+      push_txn_drop(txns[i]);
+      continue;
+    }
 
-  if (fd_msg_search_avp(*msg, g_std_dict.avp_result_code, &avp_result) == 0 &&
-      avp_result) {
-    struct avp_hdr *hdr;
-    if (fd_msg_avp_hdr(avp_result, &hdr) == 0 && hdr->avp_value) {
-      result_code = hdr->avp_value->u32;
+    struct msg *mscr =
+        mscr_clone_payload(payload[variant], payload_len[variant], session);
+    if (!mscr) {
+      fd_log_error("[app_magic] Failed to clone MSCR for session %s",
+                   session->session_id);
+      push_txn_drop(txns[i]);
+      continue;
     }
+
+    /* 发送 MSCR */
+    void *handle = push_txn_handle(txns[i]);
+    CHECK_FCT_DO(fd_msg_send(&mscr, mscr_answer_callback, handle), {
+      if (mscr)
+        fd_msg_free(mscr);
+      push_txn_drop(txns[i]);
+      continue;
+    });
+    push_txn_arm(ctx, handle);
+
+    sent_count++;
+    fd_log_notice("[app_magic] ✓ MSCR sent to session: %s",
+                  session->session_id);
   }
 
-  if (result_code == 2001) {
-    fd_log_notice("[app_magic] MSCA received from %s: SUCCESS",
-                  session ? session->session_id : "unknown");
-  } else {
-    /* MSCA 失败 - 移除订阅 */
-    fd_log_error("[app_magic] MSCA failed from %s: Result-Code=%u - removing "
-                 "subscription",
-                 session ? session->session_id : "unknown", result_code);
-    if (session) {
-      session->status_subscription_active = false;
-      session->subscribed_status_level = 0;
-    }
+  for (int v = 0; v < 4; v++) {
+    free(payload[v]);
   }
 
-  fd_msg_free(*msg);
-  *msg = NULL;
+  PUSH_STAT_ADD(sent_mscr, (uint64_t)sent_count);
+  return sent_count;
 }
 
 /**
  * @brief 向所有已订阅状态的会话广播 MSCR。
- * @details 遍历所有会话，向已订阅相应状态变更的客户端发送 MSCR。
+ * @details 查找已订阅的会话，按订阅级别过滤后交给推送调度器:
  *          - MAGIC 状态变更: 发送给订阅级别 1, 3, 7 的客户端。
  *          - DLM 状态变更: 发送给订阅级别 2, 3, 6, 7 的客户端。
- *          支持 v2.1 版本，包含详细的 DLM-Info 构建。
+ *          同一 DLM 尚未发出的事件被本次事件覆盖 (计入 coalesced)。
+ *          事件表已满时退化为立即发送。
  *
  * @param ctx MAGIC 上下文。
  * @param params 状态变更参数。
- * @return 发送成功的消息数量。
+ * @return 排入发送队列 (或立即发送成功) 的会话数量。
  */
 int magic_cic_broadcast_mscr(MagicContext *ctx, const MSCRParams *params) {
   if (!ctx || !params) {
     return -1;
   }
 
-  fd_log_notice("[app_magic] ========================================");
-  fd_log_notice("[app_magic] Broadcasting MSCR (Status Change Report)");
-  fd_log_notice("[app_magic]   Change type: %d, DLM: %s", params->type,
-                params->dlm_name ? params->dlm_name : "N/A");
-  fd_log_notice("[app_magic] ========================================");
+  g_push_ctx = ctx;
 
-  /* 查找所有已订阅状态的会话 */
-  ClientSession *subscribed[MAX_SESSIONS];
+  fd_log_notice("[app_magic] Broadcasting MSCR: type=%d, DLM: %s",
+                params->type, params->dlm_name ? params->dlm_name : "N/A");
+
+  /* 查找所有已订阅状态的会话 (数组按会话池当前容量分配) */
+  int capacity = magic_session_capacity(&ctx->session_mgr);
+  ClientSession **subscribed =
+      calloc((size_t)capacity + 1, sizeof(*subscribed));
+  ClientSession **direct = calloc((size_t)capacity + 1, sizeof(*direct));
+  int *direct_txns = calloc((size_t)capacity + 1, sizeof(*direct_txns));
+  if (!subscribed || !direct || !direct_txns) {
+    fd_log_error("[app_magic] ✗ Out of memory broadcasting MSCR");
+    free(subscribed);
+    free(direct);
+    free(direct_txns);
+    return -1;
+  }
   int count = magic_session_find_subscribed(&ctx->session_mgr, subscribed,
-                                            MAX_SESSIONS);
-
-  fd_log_notice("[app_magic] DEBUG: Total sessions checked for subscription");
-  fd_log_notice("[app_magic] DEBUG: Found %d subscribed sessions", count);
-
+                                            capacity);
   if (count == 0) {
     fd_log_notice("[app_magic] No subscribed sessions to notify");
+    free(subscribed);
+    free(direct);
+    free(direct_txns);
     return 0;
   }
 
-  fd_log_notice("[app_magic] Found %d subscribed session(s)", count);
+  bool is_magic = (params->type == STATUS_CHANGE_CLIENT_JOIN ||
+                   params->type == STATUS_CHANGE_CLIENT_LEAVE);
+  const char *key = is_magic ? "" : (params->dlm_name ? params->dlm_name : "");
+
+  PushEvent local;
+  memset(&local, 0, sizeof(local));
+  local.type = params->type;
+  local.magic_status_code = params->magic_status_code;
+  local.dlm_available = params->dlm_available;
+  strncpy(local.dlm_name, key, sizeof(local.dlm_name) - 1);
+  snprintf(local.error_message, sizeof(local.error_message), "%s",
+           params->error_message ? params->error_message : "");
+
+  pthread_mutex_lock(&g_push_sched.lock);
+
+  /* 按 DLM 名称合并 (MAGIC 状态事件共用一项) */
+  int slot_ev = -1;
+  int free_ev = -1;
+  for (int e = 0; e < PUSH_MAX_EVENTS; e++) {
+    PushEvent *ev = &g_push_sched.events[e];
+    if (!ev->in_use) {
+      if (free_ev < 0)
+        free_ev = e;
+      continue;
+    }
+    bool ev_magic = (ev->type == STATUS_CHANGE_CLIENT_JOIN ||
+                     ev->type == STATUS_CHANGE_CLIENT_LEAVE);
+    if (ev_magic == is_magic && strcmp(ev->dlm_name, key) == 0) {
+      slot_ev = e;
+      break;
+    }
+  }
+  if (slot_ev < 0) {
+    slot_ev = free_ev;
+  }
 
-  int sent_count = 0;
+  /* 最新状态覆盖尚未发出的旧状态，保留待送达计数 */
+  PushEvent *ev = slot_ev >= 0 ? &g_push_sched.events[slot_ev] : NULL;
+  if (ev) {
+    uint32_t refs = ev->in_use ? ev->refs : 0;
+    *ev = local;
+    ev->refs = refs;
+  }
+
+  int queued = 0;
+  int num_direct = 0;
+  uint64_t coalesced = 0;
+  uint64_t denied = 0;
+  uint64_t now_ms = magic_timer_now_ms();
 
   for (int i = 0; i < count; i++) {
     ClientSession *session = subscribed[i];
+    bool need_magic, need_dlm;
 
-    /* 检查订阅级别是否包含 DLM 状态 */
-    bool need_dlm = (session->subscribed_status_level >= 2);
-    bool need_magic = (session->subscribed_status_level == 1 ||
-                       session->subscribed_status_level == 3 ||
-                       session->subscribed_status_level == 7);
-
-    /* 根据状态变更类型决定是否发送 */
-    bool should_send = false;
-    if (params->type == STATUS_CHANGE_CLIENT_JOIN ||
-        params->type == STATUS_CHANGE_CLIENT_LEAVE) {
-      should_send = need_magic; /* MAGIC 状态变更 */
-    } else {
-      should_send = need_dlm; /* DLM 状态变更 */
+    if (!mscr_subscription(session, params->type, &need_magic, &need_dlm)) {
+      continue;
     }
 
-    if (!should_send) {
+    PushSlot *slot = ev ? push_slot_get(ctx, session) : NULL;
+    if (!slot) {
+      /* 事件表已满: 不合并，但仍受对端限速与在途窗口约束 */
+      int idx = magic_session_index(&ctx->session_mgr, session);
+      int txn = idx < 0 ? PUSH_ADMIT_WINDOW
+                        : push_admit_locked(idx, session, PUSH_TXN_MSCR,
+                                            &local, 0, true, now_ms);
+      if (txn < 0) {
+        denied++;
+        continue;
+      }
+      direct_txns[num_direct] = txn;
+      direct[num_direct++] = session;
       continue;
     }
 
-    /* 创建 MSCR 消息 */
-    struct msg *mscr = NULL;
-    CHECK_FCT_DO(fd_msg_new(g_magic_dict.cmd_mscr, MSGFL_ALLOC_ETEID, &mscr),
-                 { continue; });
-
-    /* 添加 Session-Id */
-    ADD_AVP_STR(mscr, g_std_dict.avp_session_id, session->session_id);
-    ADD_AVP_STR(mscr, g_std_dict.avp_origin_host, fd_g_config->cnf_diamid);
-    ADD_AVP_STR(mscr, g_std_dict.avp_origin_realm, fd_g_config->cnf_diamrlm);
-
-    /* Destination-Realm - v2.1: 优先使用会话中保存的 realm */
-    char dest_realm[128] = "";
-    if (session->client_realm[0]) {
-      strncpy(dest_realm, session->client_realm, sizeof(dest_realm) - 1);
+    uint32_t bit = 1u << slot_ev;
+    if (slot->mscr_mask & bit) {
+      coalesced++; /* 上一事件尚未送达，由本次事件替代 */
     } else {
-      const char *at = strchr(session->client_id, '.');
-      if (at) {
-        strncpy(dest_realm, at + 1, sizeof(dest_realm) - 1);
-      } else {
-        strncpy(dest_realm, "client.local", sizeof(dest_realm) - 1);
-      }
+      slot->mscr_mask |= bit;
+      ev->refs++;
     }
-    ADD_AVP_STR(mscr, g_std_dict.avp_destination_realm, dest_realm);
+    queued++;
+  }
 
-    /* 添加 Registered-Clients (如果订阅了 MAGIC 状态) */
-    if (need_magic) {
-      ADD_AVP_U32(mscr, g_magic_dict.avp_registered_clients,
-                  ctx->session_mgr.session_count);
-    }
+  if (ev) {
+    ev->in_use = ev->refs > 0;
+  }
 
-    /* 添加 DLM-List (如果订阅了 DLM 状态) */
-    if (need_dlm && params->dlm_name) {
-      struct avp *dlm_list_avp = NULL;
-      CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_dlm_list, 0, &dlm_list_avp),
-                   {
-                     fd_msg_free(mscr);
-                     continue;
-                   });
+  pthread_mutex_unlock(&g_push_sched.lock);
 
-      struct avp *dlm_info_avp = NULL;
-      CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_dlm_info, 0, &dlm_info_avp),
-                   {
-                     fd_msg_free((struct msg *)dlm_list_avp);
-                     fd_msg_free(mscr);
-                     continue;
-                   });
+  PUSH_STAT_ADD(enqueued, (uint64_t)queued - coalesced);
+  PUSH_STAT_ADD(coalesced, coalesced);
+  if (denied) {
+    PUSH_STAT_ADD(suppressed, denied);
+  }
 
-      /* 1. DLM-Name (10004) */
-      ADD_AVP_STR(dlm_info_avp, g_magic_dict.avp_dlm_name, params->dlm_name);
+  if (queued > 0 && push_kick(ctx, PUSH_COALESCE_MS) != 0) {
+    push_flush(ctx); /* 定时器不可用 (如正在关闭)，就地发送 */
+  }
 
-      /* 2. DLM-Available (10005) - Enum: 1=YES, 2=NO, 3=UNKNOWN */
-      /* params->dlm_available passed as 0/1 in caller, map to 1/2 */
-      int32_t avail_enum = (params->dlm_available == 0) ? 1 : 2;
-      ADD_AVP_I32(dlm_info_avp, g_magic_dict.avp_dlm_available, avail_enum);
+  if (num_direct > 0) {
+    fd_log_notice("[app_magic] MSCR event table full, sending %d directly",
+                  num_direct);
+    queued += push_deliver_mscr(ctx, &local, direct, direct_txns, num_direct);
+  }
 
-      /* 3. DLM-Max-Links (10010) */
-      ADD_AVP_U32(dlm_info_avp, g_magic_dict.avp_dlm_max_links, MAX_BEARERS);
+  fd_log_notice("[app_magic] MSCR queued for %d/%d subscribed session(s) "
+                "(%llu coalesced)",
+                queued, count, (unsigned long long)coalesced);
 
-      /* 4. DLM-Max-Bandwidth (10006) - Float32 */
-      {
-        struct avp *avp = NULL;
-        union avp_value val;
-        val.f32 = 10000.0f; /* 10 Mbps Mock */
-        CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_dlm_max_bw, 0, &avp),
-                     continue);
-        CHECK_FCT_DO(fd_msg_avp_setvalue(avp, &val), continue);
-        CHECK_FCT_DO(fd_msg_avp_add(dlm_info_avp, MSG_BRW_LAST_CHILD, avp),
-                     continue);
-      }
+  free(subscribed);
+  free(direct);
+  free(direct_txns);
+  return queued;
+}
 
-      /* 5. DLM-Allocated-Links (10011) */
-      /* For broadcast, we don't have easy access to DlmClient struct here,
-       * assume 0 or 1? Ideally we should fetch DlmClient. Using 0 to carry on.
-       */
-      ADD_AVP_U32(dlm_info_avp, g_magic_dict.avp_dlm_alloc_links, 0);
+/**
+ * @brief 把 MNTR 通知交给推送调度器 (合并后发送)。
+ * @details 同一会话尚未发出的变更被本次变更覆盖 (计入 coalesced)；
+ *          force_send 在合并期间保持。覆盖后若最终状态 (带宽、链路、Bearer)
+ *          与客户端上次收到的一致 (链路断开后在窗口内恢复)，撤销这条待发送
+ *          通知。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param session 目标会话。
+ * @param params 通知参数。
+ * @return 0 成功，-1 失败。
+ */
+int magic_cic_queue_mntr(MagicContext *ctx, ClientSession *session,
+                         const MNTRParams *params) {
+  if (!ctx || !session || !params) {
+    return -1;
+  }
 
-      /* 6. DLM-Allocated-Bandwidth (10007) - Float32 */
-      {
-        struct avp *avp = NULL;
-        union avp_value val;
-        val.f32 = 0.0f;
-        CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_dlm_alloc_bw, 0, &avp),
-                     continue);
-        CHECK_FCT_DO(fd_msg_avp_setvalue(avp, &val), continue);
-        CHECK_FCT_DO(fd_msg_avp_add(dlm_info_avp, MSG_BRW_LAST_CHILD, avp),
-                     continue);
-      }
+  g_push_ctx = ctx;
 
-      /* 7. DLM-QoS-Level-List (20009) */
-      {
-        struct avp *list_avp = NULL;
-        CHECK_FCT_DO(
-            fd_msg_avp_new(g_magic_dict.avp_dlm_qos_level_list, 0, &list_avp),
-            continue);
+  pthread_mutex_lock(&g_push_sched.lock);
 
-        /* Add BE (0) */
-        struct avp *qos_avp = NULL;
-        CHECK_FCT_DO(fd_msg_avp_new(g_magic_dict.avp_qos_level, 0, &qos_avp),
-                     continue);
-        union avp_value val;
-        val.i32 = 0; /* BE */
-        CHECK_FCT_DO(fd_msg_avp_setvalue(qos_avp, &val), continue);
-        CHECK_FCT_DO(fd_msg_avp_add(list_avp, MSG_BRW_LAST_CHILD, qos_avp),
-                     continue);
+  PushSlot *slot = push_slot_get(ctx, session);
+  if (!slot) {
+    pthread_mutex_unlock(&g_push_sched.lock);
+    /* 不在会话池中，无法合并与跟踪 */
+    return mntr_send_now(ctx, session, params, -1);
+  }
 
-        CHECK_FCT_DO(fd_msg_avp_add(dlm_info_avp, MSG_BRW_LAST_CHILD, list_avp),
-                     continue);
-      }
+  bool replaced = slot->mntr_pending;
+  uint32_t new_bw_kbps = params->new_granted_bw / 1000;
 
-      fd_msg_avp_add(dlm_list_avp, MSG_BRW_LAST_CHILD, dlm_info_avp);
-      fd_msg_avp_add(mscr, MSG_BRW_LAST_CHILD, dlm_list_avp);
+  /* 净变化为零: 待发送的中断通知被恢复通知抵消 (带宽、链路与 Bearer
+   * 均与上次通知一致；恢复到另一条链路时客户端仍需收到通知) */
+  const char *new_link_id = params->new_link_id ? params->new_link_id : "";
+  if (replaced && params->magic_status_code == MAGIC_STATUS_SUCCESS &&
+      session->last_notified_bw_kbps > 0 &&
+      new_bw_kbps == session->last_notified_bw_kbps &&
+      strcmp(new_link_id, session->last_notified_link_id) == 0 &&
+      params->new_bearer_id == session->last_notified_bearer_id &&
+      !(params->new_gateway_ip && params->new_gateway_ip[0])) {
+    slot->mntr_pending = false;
+    slot->force_send = false;
+    pthread_mutex_unlock(&g_push_sched.lock);
+
+    PUSH_STAT_ADD(coalesced, 2);
+    fd_log_notice("[app_magic] MNTR for session %s cancelled: state restored "
+                  "within %dms window",
+                  session->session_id, PUSH_COALESCE_MS);
+    return 0;
+  }
+
+  slot->mntr_pending = true;
+  slot->force_send = (replaced && slot->force_send) || params->force_send;
+  push_slot_fill(slot, params);
+
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  if (replaced) {
+    PUSH_STAT_ADD(coalesced, 1);
+  } else {
+    PUSH_STAT_ADD(enqueued, 1);
+  }
+
+  if (push_kick(ctx, PUSH_COALESCE_MS) != 0) {
+    push_flush(ctx); /* 定时器不可用 (如正在关闭)，就地发送 */
+  }
+  return 0;
+}
+
+/**
+ * @brief 推送调度器发送任务 (定时器线程)。
+ * @details 持锁为每个会话快照待发送内容，按对端令牌桶与在途窗口预留事务，
+ *          超出限速或窗口的通知留在槽位中等待下一轮；解锁后构造并发送消息。
+ *
+ * @param arg MAGIC 上下文。
+ */
+static void push_flush(void *arg) {
+  MagicContext *ctx = (MagicContext *)arg;
+  PushEvent events[PUSH_MAX_EVENTS];
+  uint32_t used_events = 0;
+  int num_mntr = 0;
+  uint64_t rate_limited = 0;
+  uint64_t window_full = 0;
+  uint64_t discarded = 0;
+
+  pthread_mutex_lock(&g_push_sched.lock);
+  g_push_sched.flush_scheduled = false;
+  uint64_t now_ms = magic_timer_now_ms();
+
+  /* 快照数组按槽位数分配；本轮内 push_admit_locked 不会再扩容槽位 */
+  int nslots = g_push_sched.session_capacity;
+  size_t n = (size_t)nslots + 1;
+  PushMntrJob *mntr_jobs = calloc(n, sizeof(*mntr_jobs));
+  uint32_t *send_mask = calloc(n, sizeof(*send_mask));
+  int(*mscr_txn)[PUSH_MAX_EVENTS] = calloc(n, sizeof(*mscr_txn));
+  ClientSession **targets = calloc(n, sizeof(*targets));
+  int *txns = calloc(n, sizeof(*txns));
+  if (!mntr_jobs || !send_mask || !mscr_txn || !targets || !txns) {
+    pthread_mutex_unlock(&g_push_sched.lock);
+    fd_log_error("[app_magic] ✗ Push scheduler out of memory, retrying later");
+    free(mntr_jobs);
+    free(send_mask);
+    free(mscr_txn);
+    free(targets);
+    free(txns);
+    push_kick(ctx, PUSH_COALESCE_MS);
+    return;
+  }
+
+  for (int i = 0; i < nslots; i++) {
+    PushSlot *slot = &g_push_sched.slots[i];
+    if (!slot->mntr_pending && !slot->mscr_mask) {
+      continue;
     }
 
-    /* 添加 MAGIC-Status-Code (如果有) */
-    if (params->magic_status_code > 0) {
-      ADD_AVP_U32(mscr, g_magic_dict.avp_magic_status_code,
-                  params->magic_status_code);
+    ClientSession *session = magic_session_at(&ctx->session_mgr, i);
+    if (!session || !session->in_use ||
+        strcmp(session->session_id, slot->session_id) != 0) {
+      discarded += push_slot_reset(slot);
+      continue;
     }
 
-    /* 添加 Error-Message (如果有) */
-    if (params->error_message && params->error_message[0]) {
-      ADD_AVP_STR(mscr, g_std_dict.avp_error_message, params->error_message);
+    if (slot->mntr_pending) {
+      int txn = push_admit_locked(i, session, PUSH_TXN_MNTR, slot, 0, true,
+                                  now_ms);
+      if (txn >= 0) {
+        mntr_jobs[num_mntr].session = session;
+        mntr_jobs[num_mntr].slot = *slot;
+        mntr_jobs[num_mntr].txn = txn;
+        num_mntr++;
+        slot->mntr_pending = false;
+        slot->force_send = false;
+      } else if (txn == PUSH_ADMIT_RATE) {
+        rate_limited++;
+      } else {
+        window_full++;
+      }
     }
 
-    /* 发送 MSCR */
-    CHECK_FCT_DO(fd_msg_send(&mscr, mscr_answer_callback, session), {
-      if (mscr)
-        fd_msg_free(mscr);
+    for (int e = 0; e < PUSH_MAX_EVENTS && slot->mscr_mask; e++) {
+      uint32_t bit = 1u << e;
+      if (!(slot->mscr_mask & bit)) {
+        continue;
+      }
+      int txn = push_admit_locked(i, session, PUSH_TXN_MSCR,
+                                  &g_push_sched.events[e], 0, true, now_ms);
+      if (txn < 0) {
+        if (txn == PUSH_ADMIT_RATE) {
+          rate_limited++;
+        } else {
+          window_full++;
+        }
+        continue;
+      }
+      if (!(used_events & bit)) {
+        events[e] = g_push_sched.events[e];
+        used_events |= bit;
+      }
+      mscr_txn[i][e] = txn;
+      send_mask[i] |= bit;
+      slot->mscr_mask &= ~bit;
+      if (--g_push_sched.events[e].refs == 0) {
+        g_push_sched.events[e].in_use = false;
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  if (discarded) {
+    PUSH_STAT_ADD(discarded, discarded);
+  }
+  if (rate_limited) {
+    PUSH_STAT_ADD(rate_limited, rate_limited);
+  }
+  if (window_full) {
+    PUSH_STAT_ADD(window_full, window_full);
+  }
+
+  /* 1. MNTR: 仍经过会话级风暴抑制 */
+  for (int j = 0; j < num_mntr; j++) {
+    ClientSession *session = mntr_jobs[j].session;
+    const PushSlot *s = &mntr_jobs[j].slot;
+
+    if (!magic_cic_should_send_mntr(session, s->granted_bw / 1000,
+                                    s->force_send)) {
+      fd_log_notice("[app_magic] MNTR suppressed for session %s (storm "
+                    "control)",
+                    session->session_id);
+      PUSH_STAT_ADD(suppressed, 1);
+      push_txn_drop(mntr_jobs[j].txn);
       continue;
-    });
+    }
 
-    sent_count++;
-    fd_log_notice("[app_magic] ✓ MSCR sent to session: %s",
-                  session->session_id);
+    MNTRParams params;
+    push_params_from_slot(&params, s);
+    mntr_send_now(ctx, session, &params, mntr_jobs[j].txn);
   }
 
-  fd_log_notice("[app_magic] MSCR broadcast complete: %d/%d sent", sent_count,
-                count);
+  /* 2. MSCR: 每个事件的负载构造一次，逐目标复制 */
+  for (int e = 0; e < PUSH_MAX_EVENTS && used_events; e++) {
+    if (!(used_events & (1u << e))) {
+      continue;
+    }
 
-  return sent_count;
+    int count = 0;
+    for (int i = 0; i < nslots; i++) {
+      if (send_mask[i] & (1u << e)) {
+        targets[count] = magic_session_at(&ctx->session_mgr, i);
+        txns[count++] = mscr_txn[i][e];
+      }
+    }
+
+    int sent = push_deliver_mscr(ctx, &events[e], targets, txns, count);
+    fd_log_notice("[app_magic] MSCR broadcast complete (DLM: %s): %d/%d sent",
+                  events[e].dlm_name[0] ? events[e].dlm_name : "N/A", sent,
+                  count);
+  }
+
+  free(mntr_jobs);
+  free(send_mask);
+  free(mscr_txn);
+  free(targets);
+  free(txns);
+
+  /* 被限速或窗口推迟的通知在下一轮发送 */
+  uint64_t deferred = rate_limited + window_full;
+  if (deferred && push_kick(ctx, PUSH_COALESCE_MS) != 0) {
+    fd_log_error("[app_magic] Push scheduler: %llu notification(s) left "
+                 "pending, timer unavailable",
+                 (unsigned long long)deferred);
+  }
+}
+
+/**
+ * @brief 获取推送调度器统计。
+ * @param stats 输出统计。
+ */
+void magic_cic_push_get_stats(MagicPushStats *stats) {
+  if (!stats) {
+    return;
+  }
+
+  stats->enqueued = __atomic_load_n(&g_push_sched.stats.enqueued,
+                                    __ATOMIC_RELAXED);
+  stats->coalesced = __atomic_load_n(&g_push_sched.stats.coalesced,
+                                     __ATOMIC_RELAXED);
+  stats->suppressed = __atomic_load_n(&g_push_sched.stats.suppressed,
+                                      __ATOMIC_RELAXED);
+  stats->rate_limited = __atomic_load_n(&g_push_sched.stats.rate_limited,
+                                        __ATOMIC_RELAXED);
+  stats->discarded = __atomic_load_n(&g_push_sched.stats.discarded,
+                                     __ATOMIC_RELAXED);
+  stats->sent_mntr = __atomic_load_n(&g_push_sched.stats.sent_mntr,
+                                     __ATOMIC_RELAXED);
+  stats->sent_mscr = __atomic_load_n(&g_push_sched.stats.sent_mscr,
+                                     __ATOMIC_RELAXED);
+  stats->payloads = __atomic_load_n(&g_push_sched.stats.payloads,
+                                    __ATOMIC_RELAXED);
+  stats->acked = __atomic_load_n(&g_push_sched.stats.acked, __ATOMIC_RELAXED);
+  stats->retried = __atomic_load_n(&g_push_sched.stats.retried,
+                                   __ATOMIC_RELAXED);
+  stats->timed_out = __atomic_load_n(&g_push_sched.stats.timed_out,
+                                     __ATOMIC_RELAXED);
+  stats->window_full = __atomic_load_n(&g_push_sched.stats.window_full,
+                                       __ATOMIC_RELAXED);
+  stats->late_answers = __atomic_load_n(&g_push_sched.stats.late_answers,
+                                        __ATOMIC_RELAXED);
+
+  uint32_t pending = 0;
+  pthread_mutex_lock(&g_push_sched.lock);
+  for (int i = 0; i < g_push_sched.session_capacity; i++) {
+    const PushSlot *slot = &g_push_sched.slots[i];
+    pending += (slot->mntr_pending ? 1 : 0) +
+               (uint32_t)__builtin_popcount(slot->mscr_mask);
+  }
+  stats->inflight = g_push_sched.txn_active;
+  pthread_mutex_unlock(&g_push_sched.lock);
+  stats->pending = pending;
+}
+
+/**
+ * @brief 输出推送调度器统计到日志。
+ */
+void magic_cic_push_dump_stats(void) {
+  MagicPushStats s;
+  magic_cic_push_get_stats(&s);
+
+  fd_log_notice("[app_magic] Push scheduler: pending=%u enqueued=%llu "
+                "coalesced=%llu suppressed=%llu rate_limited=%llu "
+                "discarded=%llu",
+                s.pending, (unsigned long long)s.enqueued,
+                (unsigned long long)s.coalesced,
+                (unsigned long long)s.suppressed,
+                (unsigned long long)s.rate_limited,
+                (unsigned long long)s.discarded);
+  fd_log_notice("[app_magic]   sent MNTR=%llu MSCR=%llu (shared payloads=%llu)",
+                (unsigned long long)s.sent_mntr,
+                (unsigned long long)s.sent_mscr,
+                (unsigned long long)s.payloads);
+  fd_log_notice("[app_magic]   in-flight=%u acked=%llu retried=%llu "
+                "timed_out=%llu window_full=%llu late=%llu",
+                s.inflight, (unsigned long long)s.acked,
+                (unsigned long long)s.retried,
+                (unsigned long long)s.timed_out,
+                (unsigned long long)s.window_full,
+                (unsigned long long)s.late_answers);
+}
+
+/**
+ * @brief 设置 MNTR/MSCR 应答超时、重试与在途窗口参数。
+ * @details 超时、退避倍数与超时上限为 0 时使用默认值；MaxRetries 为 0
+ *          表示不重试，InFlightWindow 为 0 表示不限制在途数。
+ *          只影响之后发出的请求。
+ *
+ * @param policy 配置中的 PushAck 参数 (可为 NULL，表示全部使用默认值)。
+ */
+void magic_cic_push_configure(const PushAckPolicy *policy) {
+  pthread_mutex_lock(&g_push_sched.lock);
+  push_init_locked();
+
+  if (policy) {
+    if (policy->ack_timeout_ms) {
+      g_push_sched.ack.ack_timeout_ms = policy->ack_timeout_ms;
+    }
+    g_push_sched.ack.max_retries = policy->max_retries;
+    if (policy->backoff_factor) {
+      g_push_sched.ack.backoff_factor = policy->backoff_factor;
+    }
+    if (policy->max_timeout_ms) {
+      g_push_sched.ack.max_timeout_ms = policy->max_timeout_ms;
+    }
+    g_push_sched.ack.inflight_window = policy->inflight_window;
+  }
+  if (g_push_sched.ack.max_timeout_ms < g_push_sched.ack.ack_timeout_ms) {
+    g_push_sched.ack.max_timeout_ms = g_push_sched.ack.ack_timeout_ms;
+  }
+  PushAckPolicy ack = g_push_sched.ack;
+  pthread_mutex_unlock(&g_push_sched.lock);
+
+  fd_log_notice("[app_magic] Push ACK tracking: timeout=%ums retries=%u "
+                "backoff=x%u max=%ums window=%u",
+                ack.ack_timeout_ms, ack.max_retries, ack.backoff_factor,
+                ack.max_timeout_ms, ack.inflight_window);
 }
 
 /**
  * @brief 处理链路状态变化事件。
- * @details 当底层链路通断时调用。
- *          1. 遍历所有使用该链路的会话，发送 MNTR 通知 (Force Send)。
+ * @details 当底层链路通断时调用。会话状态立即更新，通知交给推送调度器，
+ *          链路抖动时合并窗口内的多次通断只发送最终状态。
+ *          1. 遍历所有使用该链路的会话，排队 MNTR 通知 (Force Send)。
  *          2. 向所有订阅了 DLM 状态的客户端广播 MSCR。
  *          对于 Link UP: 恢复挂起的会话。
  *          对于 Link DOWN: 挂起会话 (Suspend)。
@@ -619,11 +2062,12 @@ int magic_cic_on_link_status_change(MagicContext *ctx, const char *link_id,
   fd_log_notice("[app_magic] Link status change: %s → %s", link_id,
                 is_up ? "UP" : "DOWN");
 
-  /* 1. 向所有使用该链路的会话发送 MNTR */
+  /* 1. 向所有使用该链路的会话排队 MNTR */
   pthread_mutex_lock(&ctx->session_mgr.mutex);
 
-  for (int i = 0; i < MAX_SESSIONS; i++) {
-    ClientSession *session = &ctx->session_mgr.sessions[i];
+  int capacity = magic_session_capacity(&ctx->session_mgr);
+  for (int i = 0; i < capacity; i++) {
+    ClientSession *session = magic_session_at(&ctx->session_mgr, i);
 
     if (!session->in_use || session->state == SESSION_STATE_CLOSED) {
       continue;
@@ -661,7 +2105,7 @@ int magic_cic_on_link_status_change(MagicContext *ctx, const char *link_id,
     }
 
     pthread_mutex_unlock(&ctx->session_mgr.mutex);
-    magic_cic_send_mntr(ctx, session, &mntr_params);
+    magic_cic_queue_mntr(ctx, session, &mntr_params);
     pthread_mutex_lock(&ctx->session_mgr.mutex);
   }
 
@@ -808,6 +2252,22 @@ int magic_cic_send_initial_mscr(MagicContext *ctx, ClientSession *session) {
     return -1;
   }
 
+  g_push_ctx = ctx;
+  return mscr_send_initial(ctx, session, 0);
+}
+
+/**
+ * @brief 构造并发送初始状态快照 (首次发送或超时重发)。
+ * @details 快照在发送时重新生成，重发携带的是最新状态。
+ *          初始快照不消耗对端令牌；在途窗口已满时仍发送，但不跟踪应答。
+ *
+ * @param ctx MAGIC 上下文。
+ * @param session 目标会话。
+ * @param attempt 已重试次数。
+ * @return 0 成功，-1 失败。
+ */
+static int mscr_send_initial(MagicContext *ctx, ClientSession *session,
+                             uint16_t attempt) {
   if (session->subscribed_status_level == 0) {
     return 0; /* 未订阅，不发送 */
   }
@@ -863,8 +2323,9 @@ int magic_cic_send_initial_mscr(MagicContext *ctx, ClientSession *session) {
     pthread_mutex_lock(&ctx->lmi_ctx.clients_mutex);
 
     int added_count = 0;
-    for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-      DlmClient *dlm = &ctx->lmi_ctx.clients[i];
+    int dlm_capacity = magic_lmi_client_capacity(&ctx->lmi_ctx);
+    for (int i = 0; i < dlm_capacity; i++) {
+      DlmClient *dlm = magic_lmi_client_at(&ctx->lmi_ctx, i);
 
       if (!dlm->is_registered) {
         continue;
@@ -967,12 +2428,28 @@ int magic_cic_send_initial_mscr(MagicContext *ctx, ClientSession *session) {
   /* Error-Message: Initial Status */
   ADD_AVP_STR(mscr, g_std_dict.avp_error_message, "Initial Status Report");
 
+  /* 预留事务 (不消耗令牌) */
+  int txn = -1;
+  int session_idx = magic_session_index(&ctx->session_mgr, session);
+  if (session_idx >= 0) {
+    pthread_mutex_lock(&g_push_sched.lock);
+    txn = push_admit_locked(session_idx, session, PUSH_TXN_MSCR_INITIAL,
+                            NULL, attempt, false, magic_timer_now_ms());
+    pthread_mutex_unlock(&g_push_sched.lock);
+    if (txn < 0) {
+      txn = -1; /* 窗口已满，不跟踪 */
+    }
+  }
+
   /* 发送 */
-  CHECK_FCT_DO(fd_msg_send(&mscr, mscr_answer_callback, session), {
+  void *handle = push_txn_handle(txn);
+  CHECK_FCT_DO(fd_msg_send(&mscr, mscr_answer_callback, handle), {
     if (mscr)
       fd_msg_free(mscr);
+    push_txn_drop(txn);
     return -1;
   });
+  push_txn_arm(ctx, handle);
 
   fd_log_notice("[app_magic] ✓ Initial MSCR sent to session %s",
                 session->session_id);
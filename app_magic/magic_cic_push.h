@@ -27,6 +27,28 @@
   10 /* 带宽变化阈值 (百分比), 小于此值不发送                                \
       */
 
+/*===========================================================================
+ * 推送调度配置
+ *
+ * 链路抖动时 MNTR/MSCR 不再逐条立即发送，而是先进入调度器:
+ * - 合并: 窗口内同一会话的多次 MNTR 变更只发送最终状态；同一 DLM 的多次
+ *   MSCR 事件只广播最新状态
+ * - 共享负载: MSCR 按 (事件, 订阅内容) 只构造一次 AVP 负载，逐目标复制后
+ *   仅补 Session-Id / Destination-Realm
+ * - 限速: 按对端 (Origin-Host) 令牌桶全局限速，超限的通知推迟到下一轮
+ * - 应答跟踪: 发出的 MNTR/MSCR 作为事务挂入哈希时间轮，超时后按
+ *   PushAckPolicy 退避重发；每个对端的在途事务数受窗口限制
+ *===========================================================================*/
+
+#define PUSH_COALESCE_MS 200      /* 合并窗口 (毫秒) */
+#define PUSH_PEER_RATE_PER_SEC 20 /* 每个对端的持续推送速率 (条/秒) */
+#define PUSH_PEER_BURST 40        /* 每个对端的突发上限 (条) */
+#define PUSH_MAX_EVENTS 32        /* 待广播 MSCR 事件上限 (按 DLM 合并) */
+#define PUSH_MAX_PEERS 128        /* 对端限速表容量 (2 的幂) */
+#define PUSH_ACK_TICK_MS 50       /* 应答时间轮刻度 (毫秒) */
+#define PUSH_ACK_WHEEL_SLOTS 256  /* 时间轮槽数 (2 的幂，一圈 12.8 秒) */
+#define PUSH_ACK_MAX_TXNS 256     /* 同时在途的 MNTR/MSCR 事务上限 */
+
 /* MAGIC Status Codes (根据 ARINC 839 Attachment 1, §1.3.2)
  *
  * 重要: 以下状态码必须与 dict_magic_codes.h 中的定义一致！
@@ -129,6 +151,27 @@ typedef struct {
   float allocated_bandwidth; ///< 已分配带宽
 } MSCRParams;
 
+/**
+ * @brief 推送调度器统计 (累计值)
+ */
+typedef struct {
+  uint64_t enqueued;     ///< 进入调度器的通知数
+  uint64_t coalesced;    ///< 被同一目标后续变更合并掉的通知数
+  uint64_t suppressed;   ///< 被风暴抑制或对端限速丢弃的通知数
+  uint64_t rate_limited; ///< 因对端限速推迟到下一轮的次数
+  uint64_t discarded;    ///< 发送前会话已结束而丢弃的通知数
+  uint64_t sent_mntr;    ///< 已发送的 MNTR 数
+  uint64_t sent_mscr;    ///< 已发送的 MSCR 数
+  uint64_t payloads;     ///< 构造的 MSCR 共享负载数
+  uint64_t acked;        ///< 收到应答 (MNTA/MSCA) 的事务数
+  uint64_t retried;      ///< 超时或发送失败后重发的次数
+  uint64_t timed_out;    ///< 重试用尽后放弃的事务数
+  uint64_t window_full;  ///< 因对端在途窗口已满推迟的次数
+  uint64_t late_answers; ///< 超时处理后才到达 (或已被取代) 的应答数
+  uint32_t pending;      ///< 当前待发送的通知数
+  uint32_t inflight;     ///< 当前等待应答的事务数
+} MagicPushStats;
+
 /*===========================================================================
  * API 函数
  *===========================================================================*/
@@ -146,21 +189,36 @@ typedef struct {
 int magic_cic_send_mntr(MagicContext *ctx, ClientSession *session,
                         const MNTRParams *params);
 
+/**
+ * @brief 把 MNTR 通知交给推送调度器 (合并后发送)
+ * @details 合并窗口内同一会话的后续变更覆盖之前未发送的变更；如果最终状态
+ *          与客户端上次收到的一致 (如链路断开后在窗口内恢复)，则不再发送。
+ *          发送时仍经过风暴抑制检查和对端限速。
+ *
+ * @param ctx MAGIC 上下文
+ * @param session 目标会话 (须属于 ctx->session_mgr)
+ * @param params 通知参数 (内容被复制，调用返回后可释放)
+ * @return int 0 成功, -1 失败
+ */
+int magic_cic_queue_mntr(MagicContext *ctx, ClientSession *session,
+                         const MNTRParams *params);
+
 /**
  * @brief 向所有已订阅状态的会话广播 MSCR
- * @details 遍历所有会话，查找到已订阅状态更新的会话，并向其发送 MSCR 消息。
- *          根据订阅级别 (MAGIC/DLM/Link) 过滤发送内容。
+ * @details 查找已订阅状态更新的会话，按订阅级别 (MAGIC/DLM/Link) 过滤后
+ *          交给推送调度器。同一 DLM (或 MAGIC 状态) 尚未发出的事件被最新
+ *          事件覆盖；负载按订阅内容只构造一次，逐目标复制。
  *
  * @param ctx MAGIC 上下文
  * @param params 状态变更参数
- * @return int 发送成功的会话数量
+ * @return int 排入发送队列的会话数量
  */
 int magic_cic_broadcast_mscr(MagicContext *ctx, const MSCRParams *params);
 
 /**
  * @brief 链路状态变化时调用 - 自动向相关会话发送通知
  * @details 当底层 DLM 链路状态发生变化 (UP/DOWN) 时调用。
- *          1. 向该链路上的所有活动会话发送 MNTR 通知。
+ *          1. 向该链路上的所有活动会话发送 MNTR 通知 (经推送调度器合并)。
  *          2. 向所有订阅了 DLM 状态的客户端广播 MSCR。
  *
  * @param ctx MAGIC 上下文
@@ -201,8 +259,9 @@ int magic_cic_on_handover(MagicContext *ctx, ClientSession *session,
                           const char *new_link_id, const char *new_gateway_ip);
 
 /**
- * @brief 检查并清理 MNTR 超时的会话
- * @details 应由定时器周期性调用，检查 mntr_pending_ack 超时的会话并强制清理。
+ * @brief 处理已到期的 MNTR/MSCR 应答超时
+ * @details 推进应答时间轮，只处理已到期的事务 (O(到期数))。时间轮在有
+ *          在途事务时由定时器自动推进，无需周期性调用。
  * @param ctx MAGIC 上下文
  */
 void magic_cic_check_mntr_timeouts(MagicContext *ctx);
@@ -231,4 +290,21 @@ bool magic_cic_should_send_mntr(ClientSession *session, uint32_t new_bw_kbps,
  */
 int magic_cic_send_initial_mscr(MagicContext *ctx, ClientSession *session);
 
+/**
+ * @brief 获取推送调度器统计
+ * @param stats 输出统计
+ */
+void magic_cic_push_get_stats(MagicPushStats *stats);
+
+/**
+ * @brief 输出推送调度器统计到日志
+ */
+void magic_cic_push_dump_stats(void);
+
+/**
+ * @brief 设置 MNTR/MSCR 应答超时、重试与在途窗口参数
+ * @param policy 应答跟踪策略 (NULL=使用默认值)
+ */
+void magic_cic_push_configure(const PushAckPolicy *policy);
+
 #endif /* MAGIC_CIC_PUSH_H */
@@ -25,12 +25,15 @@
  * 头文件包含
  *===========================================================================*/
 #include "magic_config.h" /* 包含配置管理器头文件，定义所有数据结构和函数声明 */
+#include "magic_hash.h"          /* 索引键哈希 */
+#include "magic_tft_validator.h" /* TFT 白名单预编译 */
 #include <freeDiameter/extension.h> /* 包含 freeDiameter 扩展框架，提供日志和扩展功能 */
 #include <libxml/parser.h>          /* 包含 libxml2 XML 解析器头文件 */
 #include <libxml/tree.h>            /* 包含 libxml2 XML 树结构头文件 */
 #include <stdio.h>  /* 包含标准输入输出函数，如 printf, sprintf */
 #include <stdlib.h> /* 包含标准库函数，如 atoi, malloc */
 #include <string.h> /* 包含字符串操作函数，如 strcmp, strncpy, memset */
+#include <sys/mman.h> /* munmap (从二进制缓存载入的配置) */
 
 /*===========================================================================
  * XML 解析辅助函数
@@ -347,6 +350,186 @@ static bool get_child_bool(xmlNode *parent, const char *child_name,
   return default_val;
 }
 
+/*===========================================================================
+ * 动态数组与查找索引
+ *
+ * DLM 与客户端数组按需倍增扩容；查找索引为开放寻址哈希表 (线性探测)，
+ * 槽位只存键哈希与记录下标，命中后与记录中的键字符串比对确认
+ *===========================================================================*/
+
+/* 返回记录 idx 的键字符串 */
+typedef const char *(*cfg_key_fn)(const MagicConfig *config, uint32_t idx);
+
+static const char *key_dlm_name(const MagicConfig *config, uint32_t idx) {
+  return config->dlm_configs[idx].dlm_name;
+}
+
+static const char *key_client_id(const MagicConfig *config, uint32_t idx) {
+  return config->clients[idx].client_id;
+}
+
+static const char *key_profile_name(const MagicConfig *config, uint32_t idx) {
+  return config->clients[idx].profile_name;
+}
+
+static const char *key_username(const MagicConfig *config, uint32_t idx) {
+  return config->clients[idx].auth.username;
+}
+
+static const char *key_source_ip(const MagicConfig *config, uint32_t idx) {
+  return config->clients[idx].auth.source_ip;
+}
+
+static const char *key_phase_name(const MagicConfig *config, uint32_t idx) {
+  return config->ruleset_by_phase.names[idx];
+}
+
+/* 键哈希 (FNV-1a)，0 保留给空槽 */
+static uint32_t cfg_hash(const char *key) {
+  uint32_t h = magic_fnv1a32_str(key);
+  return h ? h : 1;
+}
+
+/**
+ * @brief 确保数组容量不小于 need (倍增扩容，新增部分清零)。
+ * @return 0 成功，-1 内存不足 (原数组保持不变)。
+ */
+static int cfg_reserve(void **array, uint32_t *capacity, uint32_t need,
+                       size_t elem_size) {
+  if (need <= *capacity)
+    return 0;
+
+  uint32_t cap = *capacity ? *capacity : MAGIC_CONFIG_INITIAL_CAPACITY;
+  while (cap < need)
+    cap *= 2;
+
+  void *grown = realloc(*array, (size_t)cap * elem_size);
+  if (!grown) {
+    fd_log_error("[app_magic] Config: out of memory growing to %u entries",
+                 cap);
+    return -1;
+  }
+  memset((char *)grown + (size_t)*capacity * elem_size, 0,
+         (size_t)(cap - *capacity) * elem_size);
+  *array = grown;
+  *capacity = cap;
+  return 0;
+}
+
+static void cfg_index_free(MagicConfigIndex *index) {
+  free(index->slots);
+  index->slots = NULL;
+  index->mask = 0;
+}
+
+/* 在索引中查找键，返回记录下标，未找到返回 -1 */
+static int32_t cfg_index_find(const MagicConfig *config,
+                              const MagicConfigIndex *index,
+                              cfg_key_fn key_of, const char *key) {
+  if (!index->slots || !key || !key[0])
+    return -1;
+
+  uint32_t h = cfg_hash(key);
+  for (uint32_t i = h & index->mask;; i = (i + 1) & index->mask) {
+    const MagicConfigIndexSlot *slot = &index->slots[i];
+    if (slot->hash == 0)
+      return -1;
+    if (slot->hash == h && strcmp(key_of(config, slot->value), key) == 0)
+      return (int32_t)slot->value;
+  }
+}
+
+/**
+ * @brief 为前 count 条记录重建索引 (空键不入索引，重复键保留第一条)。
+ * @return 0 成功，-1 内存不足。
+ */
+static int cfg_index_build(MagicConfig *config, MagicConfigIndex *index,
+                           uint32_t count, cfg_key_fn key_of) {
+  cfg_index_free(index);
+
+  uint32_t cap = MAGIC_CONFIG_INITIAL_CAPACITY;
+  while (cap < count * 2)
+    cap *= 2;
+
+  index->slots = calloc(cap, sizeof(MagicConfigIndexSlot));
+  if (!index->slots) {
+    fd_log_error("[app_magic] Config: out of memory building index");
+    return -1;
+  }
+  index->mask = cap - 1;
+
+  for (uint32_t n = 0; n < count; n++) {
+    const char *key = key_of(config, n);
+    if (!key[0])
+      continue;
+    if (cfg_index_find(config, index, key_of, key) >= 0) {
+      fd_log_notice("[app_magic] ⚠ Duplicate config key '%s', keeping first",
+                    key);
+      continue;
+    }
+
+    uint32_t h = cfg_hash(key);
+    uint32_t i = h & index->mask;
+    while (index->slots[i].hash != 0)
+      i = (i + 1) & index->mask;
+    index->slots[i].hash = h;
+    index->slots[i].value = n;
+  }
+  return 0;
+}
+
+/* 重建客户端的全部索引 */
+static int cfg_build_client_indexes(MagicConfig *config) {
+  uint32_t n = config->num_clients;
+  if (cfg_index_build(config, &config->client_by_id, n, key_client_id) < 0 ||
+      cfg_index_build(config, &config->client_by_profile, n,
+                      key_profile_name) < 0 ||
+      cfg_index_build(config, &config->client_by_username, n, key_username) <
+          0 ||
+      cfg_index_build(config, &config->client_by_source_ip, n,
+                      key_source_ip) < 0)
+    return -1;
+  return 0;
+}
+
+/**
+ * @brief 把各规则集的 flight_phases (逗号/空白分隔) 拆成阶段名并建立
+ *        阶段名 → 规则集位图索引。
+ * @return 0 成功，-1 内存不足。
+ */
+static int cfg_build_phase_index(MagicConfig *config) {
+  MagicPhaseIndex *px = &config->ruleset_by_phase;
+  cfg_index_free(&px->index);
+  memset(px, 0, sizeof(*px));
+
+  for (uint32_t r = 0; r < config->policy.num_rulesets; r++) {
+    char phases[MAX_NAME_LEN];
+    char *save = NULL;
+    strncpy(phases, config->policy.rulesets[r].flight_phases,
+            sizeof(phases) - 1);
+    phases[sizeof(phases) - 1] = '\0';
+
+    for (char *tok = strtok_r(phases, ", \t;|", &save); tok;
+         tok = strtok_r(NULL, ", \t;|", &save)) {
+      uint32_t k = 0;
+      while (k < px->count && strcmp(px->names[k], tok) != 0)
+        k++;
+      if (k == px->count) {
+        if (px->count >= MAX_PHASE_TOKENS) {
+          fd_log_error("[app_magic] Too many flight phase names, max %d",
+                       MAX_PHASE_TOKENS);
+          continue;
+        }
+        strncpy(px->names[k], tok, MAX_ID_LEN - 1);
+        px->count++;
+      }
+      px->rulesets[k] |= 1u << r;
+    }
+  }
+
+  return cfg_index_build(config, &px->index, px->count, key_phase_name);
+}
+
 /*===========================================================================
  * 初始化函数
  *
@@ -385,8 +568,7 @@ void magic_config_init(MagicConfig *config) {
  *
  * @return int 成功返回 0；如果文件缺失、损坏或 XML根节点不匹配则返回 -1。
  *
- * @warning 该函数会清空原有的 DLM 配置。如果配置的 DLM 数量超过
- * MAX_LINKS，后续节点将被忽略。
+ * @warning 该函数会清空原有的 DLM 配置 (数组保留并按需扩容)。
  */
 int magic_config_load_datalinks(MagicConfig *config, const char *base_path) {
   char filepath[512];
@@ -419,9 +601,10 @@ int magic_config_load_datalinks(MagicConfig *config, const char *base_path) {
       continue;
     }
 
-    if (config->num_dlm_configs >= MAX_LINKS) {
-      fd_log_error("[app_magic] Too many DLMs, max %d", MAX_LINKS);
-      break;
+    if (cfg_reserve((void **)&config->dlm_configs, &config->dlm_capacity,
+                    config->num_dlm_configs + 1, sizeof(DLMConfig)) < 0) {
+      xmlFreeDoc(doc);
+      return -1;
     }
 
     DLMConfig *dlm = &config->dlm_configs[config->num_dlm_configs];
@@ -554,6 +737,9 @@ int magic_config_load_datalinks(MagicConfig *config, const char *base_path) {
   }
 
   xmlFreeDoc(doc);
+  if (cfg_index_build(config, &config->dlm_by_name, config->num_dlm_configs,
+                      key_dlm_name) < 0)
+    return -1;
   fd_log_notice("[app_magic] Loaded %u DLM configs (v2.0 format)",
                 config->num_dlm_configs);
   return 0;
@@ -608,8 +794,12 @@ int magic_config_load_policy(MagicConfig *config, const char *base_path) {
 
   /* 获取中央策略配置结构体的指针 */
   CentralPolicyProfile *policy = &config->policy;
-  /* 清空结构体，确保初始状态 */
+  /* 清空结构体，确保初始状态 (可用链路数组保留复用) */
+  char(*links)[MAX_ID_LEN] = policy->available_links;
+  uint32_t link_capacity = policy->link_capacity;
   memset(policy, 0, sizeof(CentralPolicyProfile));
+  policy->available_links = links;
+  policy->link_capacity = link_capacity;
 
   /* 查找并解析可用链路节点 */
   xmlNode *links_node = find_child_node(root, "AvailableLinks");
@@ -618,13 +808,19 @@ int magic_config_load_policy(MagicConfig *config, const char *base_path) {
     policy->num_links = 0;
     /* 遍历所有链路子节点 */
     for (xmlNode *link = links_node->children; link; link = link->next) {
-      /* 检查是否为元素节点且为 Link 标签，且未超过最大链路数量 */
+      /* 检查是否为元素节点且为 Link 标签 */
       if (link->type == XML_ELEMENT_NODE &&
-          strcmp((char *)link->name, "Link") == 0 &&
-          policy->num_links < MAX_LINKS) {
+          strcmp((char *)link->name, "Link") == 0) {
 
         /* 解析链路 ID 属性 */
         char *id = get_attribute(link, "id");
+        if (id && cfg_reserve((void **)&policy->available_links,
+                              &policy->link_capacity, policy->num_links + 1,
+                              MAX_ID_LEN) < 0) {
+          xmlFree(id);
+          xmlFreeDoc(doc);
+          return -1;
+        }
         if (id) {
           /* 复制链路 ID 到可用链路数组 */
           strncpy(policy->available_links[policy->num_links], id,
@@ -921,8 +1117,35 @@ int magic_config_load_policy(MagicConfig *config, const char *base_path) {
     fd_log_debug("[app_magic] Using default SwitchingPolicy (30 sec, 10%%)");
   }
 
+  /* 数据平面下发后端: exec / netlink / auto (缺省 auto) */
+  const char *backend = get_child_content(root, "DataplaneBackend");
+  snprintf(policy->dataplane_backend, sizeof(policy->dataplane_backend), "%s",
+           backend ? backend : "auto");
+  fd_log_notice("[app_magic] DataplaneBackend: %s", policy->dataplane_backend);
+
+  /* MNTR/MSCR 应答跟踪 (节点缺失时各项取缺省值) */
+  xmlNode *ack_node = find_child_node(root, "PushAck");
+  policy->push_ack.ack_timeout_ms =
+      get_child_uint32(ack_node, "AckTimeoutMs", 5000);
+  policy->push_ack.max_retries = get_child_uint32(ack_node, "MaxRetries", 2);
+  policy->push_ack.backoff_factor =
+      get_child_uint32(ack_node, "BackoffFactor", 2);
+  policy->push_ack.max_timeout_ms =
+      get_child_uint32(ack_node, "MaxTimeoutMs", 20000);
+  policy->push_ack.inflight_window =
+      get_child_uint32(ack_node, "InFlightWindow", 8);
+  fd_log_notice("[app_magic] PushAck: timeout=%ums retries=%u backoff=x%u "
+                "max=%ums window=%u",
+                policy->push_ack.ack_timeout_ms, policy->push_ack.max_retries,
+                policy->push_ack.backoff_factor,
+                policy->push_ack.max_timeout_ms,
+                policy->push_ack.inflight_window);
+
   /* 释放 XML 文档内存 */
   xmlFreeDoc(doc);
+  /* 建立飞行阶段 → 规则集索引 */
+  if (cfg_build_phase_index(config) < 0)
+    return -1;
   /* 记录加载成功的通知信息 */
   fd_log_notice("[app_magic] Loaded %u policy rulesets", policy->num_rulesets);
   /* 返回成功 */
@@ -1191,11 +1414,19 @@ static void parse_client_traffic(xmlNode *traffic_node,
   traffic->max_packet_size =
       get_child_uint32(traffic_node, "MaxPacketSize", 1500);
 
+  /* 预编译 TFT 白名单，验证时不再逐条解析字符串 */
+  tft_whitelist_compile(traffic);
+  if (traffic->tft_matcher.num_invalid > 0) {
+    fd_log_notice("[app_magic]     ⚠ %u invalid TFT whitelist entr%s ignored",
+                  traffic->tft_matcher.num_invalid,
+                  traffic->tft_matcher.num_invalid == 1 ? "y" : "ies");
+  }
+
   fd_log_debug("[app_magic]     Traffic: encryption=%s, protocols=%u, "
-               "allowed_tfts=%u, max_pkt=%u",
+               "allowed_tfts=%u (compiled=%u), max_pkt=%u",
                traffic->encryption_required ? "yes" : "no",
                traffic->num_allowed_protocols, traffic->num_allowed_tfts,
-               traffic->max_packet_size);
+               traffic->tft_matcher.num_rules, traffic->max_packet_size);
 }
 
 /**
@@ -1287,10 +1518,11 @@ int magic_config_load_clients(MagicConfig *config, const char *base_path) {
       continue;
     }
 
-    /* 检查是否超过最大客户端数量限制 */
-    if (config->num_clients >= MAX_CLIENTS) {
-      fd_log_error("[app_magic] Too many clients, max %d", MAX_CLIENTS);
-      break;
+    /* 按需扩容客户端数组 */
+    if (cfg_reserve((void **)&config->clients, &config->client_capacity,
+                    config->num_clients + 1, sizeof(ClientProfile)) < 0) {
+      xmlFreeDoc(doc);
+      return -1;
     }
 
     /* 获取当前客户端配置结构体的指针 */
@@ -1364,6 +1596,9 @@ int magic_config_load_clients(MagicConfig *config, const char *base_path) {
 
   /* 释放 XML 文档内存 */
   xmlFreeDoc(doc);
+  /* 建立 client_id/ProfileName/Username/SourceIP 索引 */
+  if (cfg_build_client_indexes(config) < 0)
+    return -1;
   fd_log_notice("[app_magic] Loaded %u client profiles (v2.0 format)",
                 config->num_clients);
   return 0;
@@ -1378,8 +1613,8 @@ int magic_config_load_clients(MagicConfig *config, const char *base_path) {
 
 /**
  * @brief 根据 DLM 名称查找对应的 DLM 配置 (v2.0 推荐 API)。
- * @details 遍历 `config->dlm_configs` 数组，通过 `dlm_name` 字符串（如
- * "LINK_SATCOM"）进行精确匹配。
+ * @details 通过 `dlm_by_name` 索引按 `dlm_name` 字符串（如
+ * "LINK_SATCOM"）精确匹配，O(1)。
  *
  * @param[in] config   指向全局配置句柄的指针。
  * @param[in] dlm_name 要查找的 DLM 名称字符串。
@@ -1392,12 +1627,9 @@ DLMConfig *magic_config_find_dlm(MagicConfig *config, const char *dlm_name) {
   if (!config || !dlm_name)
     return NULL;
 
-  for (uint32_t i = 0; i < config->num_dlm_configs; i++) {
-    if (strcmp(config->dlm_configs[i].dlm_name, dlm_name) == 0) {
-      return &config->dlm_configs[i];
-    }
-  }
-  return NULL;
+  int32_t idx =
+      cfg_index_find(config, &config->dlm_by_name, key_dlm_name, dlm_name);
+  return idx >= 0 ? &config->dlm_configs[idx] : NULL;
 }
 
 /**
@@ -1473,23 +1705,16 @@ bool magic_config_dlm_supports_qos(const DLMConfig *dlm, uint8_t qos_level) {
  * @param client_id 要查找的客户端 ID
  * @return 找到的客户端配置指针，NULL=未找到
  *
- * 该函数遍历所有客户端配置，查找匹配的客户端 ID
+ * 该函数通过 client_by_id 索引查找匹配的客户端 ID
  */
 ClientProfile *magic_config_find_client(MagicConfig *config,
                                         const char *client_id) {
   if (!config || !client_id)
     return NULL;
 
-  /* 遍历所有客户端配置 */
-  for (uint32_t i = 0; i < config->num_clients; i++) {
-    /* 比较客户端 ID 是否匹配 */
-    if (strcmp(config->clients[i].client_id, client_id) == 0) {
-      /* 找到匹配的客户端，返回指针 */
-      return &config->clients[i];
-    }
-  }
-  /* 未找到匹配的客户端，返回 NULL */
-  return NULL;
+  int32_t idx =
+      cfg_index_find(config, &config->client_by_id, key_client_id, client_id);
+  return idx >= 0 ? &config->clients[idx] : NULL;
 }
 
 /**
@@ -1507,22 +1732,37 @@ ClientProfile *magic_config_find_client_by_profile(MagicConfig *config,
   if (!config || !profile_name)
     return NULL;
 
-  /* 遍历所有客户端配置 */
-  for (uint32_t i = 0; i < config->num_clients; i++) {
-    /* 比较 ProfileName 是否匹配 */
-    if (strcmp(config->clients[i].profile_name, profile_name) == 0) {
-      /* 检查配置是否启用 */
-      if (config->clients[i].enabled) {
-        return &config->clients[i];
-      } else {
-        fd_log_debug("[app_magic] Profile '%s' found but disabled",
-                     profile_name);
-        return NULL;
-      }
-    }
+  int32_t idx = cfg_index_find(config, &config->client_by_profile,
+                               key_profile_name, profile_name);
+  if (idx < 0)
+    return NULL;
+
+  /* 检查配置是否启用 */
+  if (!config->clients[idx].enabled) {
+    fd_log_debug("[app_magic] Profile '%s' found but disabled", profile_name);
+    return NULL;
   }
-  /* 未找到匹配的客户端 */
-  return NULL;
+  return &config->clients[idx];
+}
+
+ClientProfile *magic_config_find_client_by_username(MagicConfig *config,
+                                                    const char *username) {
+  if (!config || !username)
+    return NULL;
+
+  int32_t idx = cfg_index_find(config, &config->client_by_username,
+                               key_username, username);
+  return idx >= 0 ? &config->clients[idx] : NULL;
+}
+
+ClientProfile *magic_config_find_client_by_source_ip(MagicConfig *config,
+                                                     const char *source_ip) {
+  if (!config || !source_ip)
+    return NULL;
+
+  int32_t idx = cfg_index_find(config, &config->client_by_source_ip,
+                               key_source_ip, source_ip);
+  return idx >= 0 ? &config->clients[idx] : NULL;
 }
 
 /**
@@ -1615,10 +1855,20 @@ bool magic_config_is_flight_phase_allowed(const ClientProfile *client,
  * @param flight_phase 要查找的飞行阶段
  * @return 找到的规则集指针，NULL=未找到
  *
- * 该函数遍历所有策略规则集，查找包含指定飞行阶段的规则集
+ * 该函数先查飞行阶段索引，阶段名不是 flight_phases 中的完整词时
+ * 再遍历所有策略规则集做子串匹配
  */
 PolicyRuleSet *magic_config_find_ruleset(MagicConfig *config,
                                          const char *flight_phase) {
+  if (!config || !flight_phase)
+    return NULL;
+
+  /* 阶段名索引命中: 取位图中下标最小的规则集 (与配置顺序一致) */
+  const MagicPhaseIndex *px = &config->ruleset_by_phase;
+  int32_t k = cfg_index_find(config, &px->index, key_phase_name, flight_phase);
+  if (k >= 0 && px->rulesets[k])
+    return &config->policy.rulesets[__builtin_ctz(px->rulesets[k])];
+
   /* 遍历所有策略规则集 */
   for (uint32_t i = 0; i < config->policy.num_rulesets; i++) {
     /* 获取当前规则集指针 */
@@ -1700,7 +1950,22 @@ void magic_config_print_summary(const MagicConfig *config) {
 void magic_config_cleanup(MagicConfig *config) {
   /* 检查配置指针是否有效 */
   if (config) {
-    /* 将整个配置结构体清零，释放所有资源 */
+    if (config->image) {
+      /* 数组与索引都位于缓存映射内 */
+      munmap(config->image, config->image_size);
+    } else {
+      /* 释放动态数组与查找索引 */
+      free(config->dlm_configs);
+      free(config->clients);
+      free(config->policy.available_links);
+      cfg_index_free(&config->dlm_by_name);
+      cfg_index_free(&config->client_by_id);
+      cfg_index_free(&config->client_by_profile);
+      cfg_index_free(&config->client_by_username);
+      cfg_index_free(&config->client_by_source_ip);
+      cfg_index_free(&config->ruleset_by_phase.index);
+    }
+    /* 将整个配置结构体清零 */
     memset(config, 0, sizeof(MagicConfig));
   }
 }
@@ -28,6 +28,7 @@
  * 标准头文件包含
  *===========================================================================*/
 #include <stdbool.h> /* 包含布尔类型定义，如 bool, true, false */
+#include <stddef.h>  /* 包含 size_t 定义 */
 #include <stdint.h>  /* 包含标准整数类型定义，如 uint32_t, uint8_t 等 */
 #include <time.h>    /* 包含时间相关函数和类型定义，如 time_t */
 
@@ -36,8 +37,8 @@
  *===========================================================================*/
 
 /* 数据链路相关常量 */
-#define MAX_LINKS 10   /**< @brief 系统中最多支持的数据链路数量 */
-#define MAX_CLIENTS 50 /**< @brief 系统中最多支持的客户端数量 */
+#define MAGIC_CONFIG_INITIAL_CAPACITY 8 /**< @brief DLM/客户端数组初始容量 */
+#define MAX_PHASE_TOKENS 32 /**< @brief 规则集中不同飞行阶段名的最大数量 */
 #define MAX_POLICY_RULESETS                                                    \
   10 /**< @brief 策略配置文件中最多支持的规则集数量                \
       */
@@ -59,6 +60,7 @@
 #define MAX_ALLOWED_PHASES 10 /**< @brief 每个客户端允许的最大飞行阶段数量 */
 #define MAX_IP_RANGE_LEN 128  /**< @brief IP 范围字符串最大长度 */
 #define MAX_PROTOCOL_LEN 32   /**< @brief 协议名称最大长度 */
+#define MAX_ALLOWED_TFTS 255  /**< @brief 每个客户端 TFT 白名单最大条目数 */
 
 /*===========================================================================
  * 数据链路配置结构体 (Datalink_Profile.xml v2.0)
@@ -278,14 +280,28 @@ typedef struct {
                                   ///< 新链路需优于当前多少才切换
 } SwitchingPolicy;
 
+/**
+ * @brief MNTR/MSCR 应答跟踪策略结构体
+ * @details 定义服务端推送请求的应答超时、重试退避与每客户端在途窗口。
+ *          第 n 次重试的超时为 ack_timeout_ms * backoff_factor^n，
+ *          不超过 max_timeout_ms。
+ */
+typedef struct {
+  uint32_t ack_timeout_ms;  ///< 首次发送的应答超时 (毫秒)
+  uint32_t max_retries;     ///< 超时后的最大重试次数 (0=不重试)
+  uint32_t backoff_factor;  ///< 每次重试的超时倍数
+  uint32_t max_timeout_ms;  ///< 单次超时上限 (毫秒)
+  uint32_t inflight_window; ///< 每个客户端最大在途请求数 (0=不限)
+} PushAckPolicy;
+
 /**
  * @brief 中央策略配置结构体 (v2.0 增强版)
  * 包含所有策略配置信息
  */
 typedef struct {
-  char available_links[MAX_LINKS]
-                      [MAX_ID_LEN]; /* 可用链路列表 - 系统可用的链路 ID 数组 */
-  uint32_t num_links; /* 链路数量 - available_links 数组的有效元素数 */
+  char (*available_links)[MAX_ID_LEN]; /* 可用链路 ID 数组 (按需扩容) */
+  uint32_t num_links;     /* 链路数量 - available_links 数组的有效元素数 */
+  uint32_t link_capacity; /* available_links 已分配容量 */
 
   /* v2.0 新增: 流量类别定义 */
   TrafficClassDefinition traffic_class_defs[MAX_TRAFFIC_CLASS_DEFS];
@@ -294,6 +310,11 @@ typedef struct {
   /* v2.0 新增: 全局链路切换策略 */
   SwitchingPolicy switching_policy; /* 链路切换防抖动参数 */
 
+  /* 数据平面下发后端 ("exec" / "netlink" / "auto") */
+  char dataplane_backend[16];
+
+  PushAckPolicy push_ack; /* MNTR/MSCR 应答超时与重试 */
+
   PolicyRuleSet rulesets[MAX_POLICY_RULESETS]; /* 规则集数组 - 所有策略规则集 */
   uint32_t num_rulesets; /* 规则集数量 - rulesets 数组的有效元素数 */
 } CentralPolicyProfile;
@@ -415,6 +436,45 @@ typedef struct {
   bool allow_cdr_control; /* 是否允许控制他人 CDR (切分/重启) */
 } SessionPolicyConfig;
 
+/* TftMatchRule.flags */
+#define TFT_MATCH_HAS_SRC_IP 0x01   /**< @brief 白名单限定了源 IP */
+#define TFT_MATCH_HAS_DST_IP 0x02   /**< @brief 白名单限定了目标 IP */
+#define TFT_MATCH_ANY_DST_PORT 0x04 /**< @brief 目标端口为 0-65535 (不检查) */
+#define TFT_MATCH_ANY_SRC_PORT 0x08 /**< @brief 源端口为 0-65535 (不检查) */
+
+/**
+ * @brief 预编译的 TFT 白名单条目 (紧凑数值形式)
+ * @details 由 allowed_tfts[] 在配置加载时解析得到，验证时只做整数比较。
+ *          IP 为主机字节序。
+ */
+typedef struct {
+  uint32_t src_ip_start;   ///< 源 IP 起始。
+  uint32_t src_ip_end;     ///< 源 IP 结束。
+  uint32_t dst_ip_start;   ///< 目标 IP 起始。
+  uint32_t dst_ip_end;     ///< 目标 IP 结束。
+  uint16_t dst_port_start; ///< 目标端口起始。
+  uint16_t dst_port_end;   ///< 目标端口结束。
+  uint16_t src_port_start; ///< 源端口起始。
+  uint16_t src_port_end;   ///< 源端口结束。
+  uint8_t protocol;        ///< 协议号，0=任意。
+  uint8_t flags;           ///< TFT_MATCH_* 标志位。
+  uint16_t index;          ///< 在 allowed_tfts[] 中的下标。
+} TftMatchRule;
+
+/**
+ * @brief 预编译的 TFT 白名单匹配器
+ * @details 由 tft_whitelist_compile() 生成并缓存在 ClientProfile.traffic 中。
+ *          proto_bitmap 是所有条目协议号的并集 (存在任意协议条目时全部置位)，
+ *          用于在扫描条目前快速拒绝协议不符的请求。
+ */
+typedef struct {
+  TftMatchRule rules[MAX_ALLOWED_TFTS]; ///< 有效条目 (保持配置顺序)。
+  uint32_t num_rules;                   ///< 有效条目数。
+  uint32_t num_invalid;                 ///< 解析失败被跳过的条目数。
+  uint32_t proto_bitmap[8];             ///< 协议号位图 (256 位)。
+  bool compiled;                        ///< 是否已编译。
+} TftWhitelistMatcher;
+
 /**
  * @brief 6. 流量安全配置结构体 (Traffic 分区)
  * 定义客户端的流量安全约束
@@ -426,8 +486,9 @@ typedef struct {
   uint32_t num_allowed_protocols;           /* 允许的协议数量 */
 
   /* TFT 白名单 - 允许的流量规则（精确匹配） */
-  char allowed_tfts[255][512]; /* 允许的 TFT 规则列表 */
-  uint32_t num_allowed_tfts;   /* 允许的 TFT 数量 (1-255) */
+  char allowed_tfts[MAX_ALLOWED_TFTS][512]; /* 允许的 TFT 规则列表 */
+  uint32_t num_allowed_tfts; /* 允许的 TFT 数量 (1-255) */
+  TftWhitelistMatcher tft_matcher; /* 预编译的 TFT 白名单 (配置加载时生成) */
 
   /* TFT 白名单 - 范围验证（ARINC 839 §1.2.2.2） */
   char dest_ip_range[256];     /* 允许的目标IP范围 (如 10.2.2.0/24) */
@@ -482,19 +543,68 @@ typedef struct {
  * 本节定义全局配置管理器，整合所有配置信息
  *===========================================================================*/
 
+/**
+ * @brief 查找索引槽位
+ */
+typedef struct {
+  uint32_t hash;  ///< 键的 FNV-1a 哈希 (0 保留，表示空槽)
+  uint32_t value; ///< 记录下标
+} MagicConfigIndexSlot;
+
+/**
+ * @brief 字符串键开放寻址哈希索引 (线性探测)
+ * @details 加载时构建，装载因子不超过 1/2。槽位只存哈希与下标，
+ *          命中后再与记录中的键字符串比对确认。重复键只索引第一条，
+ *          与原先线性查找返回第一条匹配的语义一致。
+ */
+typedef struct {
+  MagicConfigIndexSlot *slots; ///< 槽位数组 (容量为 2 的幂)
+  uint32_t mask;               ///< 容量 - 1
+} MagicConfigIndex;
+
+/**
+ * @brief 飞行阶段 → 规则集位图
+ * @details 把各规则集 flight_phases 属性拆分成阶段名，每个阶段名对应
+ *          包含它的规则集位图 (bit i = policy.rulesets[i])。
+ */
+typedef struct {
+  char names[MAX_PHASE_TOKENS][MAX_ID_LEN]; ///< 阶段名
+  uint32_t rulesets[MAX_PHASE_TOKENS];      ///< 对应的规则集位图
+  uint32_t count;                           ///< 阶段名数量
+  MagicConfigIndex index;                   ///< 阶段名 → names[] 下标
+} MagicPhaseIndex;
+
 /**
  * @brief MAGIC 配置管理器结构体
  * @details 全局配置管理器的主结构体，包含所有从 XML 加载的配置信息。
+ *          DLM 与客户端数组按需扩容；各加载函数结束时重建对应的查找索引，
+ *          查找函数均为 O(1)。从二进制缓存载入的配置 (image 非 NULL)
+ *          不能再调用加载函数。
  */
 typedef struct {
-  DLMConfig
-      dlm_configs[MAX_LINKS];  ///< DLM 配置数组 (Datalink_Profile.xml v2.0)
+  DLMConfig *dlm_configs;      ///< DLM 配置数组 (Datalink_Profile.xml v2.0)
   uint32_t num_dlm_configs;    ///< DLM 数量
+  uint32_t dlm_capacity;       ///< dlm_configs 已分配容量
   CentralPolicyProfile policy; ///< 中央策略配置
-  ClientProfile clients[MAX_CLIENTS]; ///< 客户端配置数组
-  uint32_t num_clients;               ///< 客户端数量
-  time_t load_time;                   ///< 加载时间 - 配置最后加载的时间戳
-  bool is_loaded;                     ///< 是否已加载 - 配置是否成功加载
+  ClientProfile *clients;      ///< 客户端配置数组
+  uint32_t num_clients;        ///< 客户端数量
+  uint32_t client_capacity;    ///< clients 已分配容量
+
+  /* 查找索引 (加载时构建) */
+  MagicConfigIndex dlm_by_name;         ///< dlm_name → dlm_configs[]
+  MagicConfigIndex client_by_id;        ///< client_id → clients[]
+  MagicConfigIndex client_by_profile;   ///< profile_name → clients[]
+  MagicConfigIndex client_by_username;  ///< auth.username → clients[]
+  MagicConfigIndex client_by_source_ip; ///< auth.source_ip → clients[]
+  MagicPhaseIndex ruleset_by_phase;     ///< 飞行阶段 → 规则集位图
+
+  /* 二进制缓存映射 (见 magic_config_cache.h)，非 NULL 时上面的数组与
+   * 索引槽位都指向映射内部，由 magic_config_cleanup 统一 munmap */
+  void *image;       ///< 映射基址
+  size_t image_size; ///< 映射长度
+
+  time_t load_time;        ///< 加载时间 - 配置最后加载的时间戳
+  bool is_loaded;          ///< 是否已加载 - 配置是否成功加载
   bool adif_degraded_mode; ///< ADIF 连接失败时为 true，仅保障核心应用
 } MagicConfig;
 
@@ -589,6 +699,24 @@ ClientProfile *magic_config_find_client(MagicConfig *config,
 ClientProfile *magic_config_find_client_by_profile(MagicConfig *config,
                                                    const char *profile_name);
 
+/**
+ * @brief 查找客户端配置 (按 Auth.Username)
+ * @param config 指向配置管理器结构体的指针
+ * @param username 登录用户名
+ * @return 找到的客户端配置指针，未找到返回 NULL
+ */
+ClientProfile *magic_config_find_client_by_username(MagicConfig *config,
+                                                    const char *username);
+
+/**
+ * @brief 查找客户端配置 (按 Auth.SourceIP)
+ * @param config 指向配置管理器结构体的指针
+ * @param source_ip 客户端源 IP 字符串
+ * @return 找到的客户端配置指针，未找到返回 NULL
+ */
+ClientProfile *magic_config_find_client_by_source_ip(MagicConfig *config,
+                                                     const char *source_ip);
+
 /**
  * @brief 验证客户端是否允许使用指定的 DLM
  * @param client 客户端配置指针
@@ -625,6 +753,8 @@ CfgFlightPhase magic_config_parse_flight_phase(const char *phase_str);
 
 /**
  * @brief 查找策略规则集
+ * @details 先按阶段名查索引取位图中第一个规则集；阶段名不是完整的词时
+ *          退回到对 flight_phases 的子串匹配。
  * @param config 指向配置管理器结构体的指针
  * @param flight_phase 要查找的飞行阶段
  * @return 找到的规则集指针，未找到返回 NULL
@@ -640,7 +770,8 @@ void magic_config_print_summary(const MagicConfig *config);
 
 /**
  * @brief 清理配置管理器。
- * @details 释放配置结构体中分配的所有内存（如字符串、动态列表）。
+ * @details 释放配置结构体中分配的所有内存（如字符串、动态列表）；
+ *          从缓存载入的配置改为解除映射。
  * @param[in,out] config 指向配置管理器结构体的指针。
  * @return void
  */
@@ -0,0 +1,385 @@
+/**
+ * @file magic_config_cache.c
+ * @brief MAGIC 配置二进制缓存实现。
+ * @details 镜像头部保存一份 MagicConfig 副本 (其中的指针字段无意义) 与
+ *          段表；载入时校验后把数组与索引指针重定位到映射内的各段。
+ */
+
+#include "magic_config_cache.h"
+#include "magic_hash.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <freeDiameter/extension.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*===========================================================================
+ * 镜像格式
+ *===========================================================================*/
+
+/* 段编号 (顺序即文件中的排列顺序) */
+enum {
+  CACHE_SEC_DLMS,          /* DLMConfig[num_dlm_configs] */
+  CACHE_SEC_CLIENTS,       /* ClientProfile[num_clients] */
+  CACHE_SEC_LINKS,         /* policy.available_links[num_links] */
+  CACHE_SEC_IDX_DLM,       /* dlm_by_name 槽位 */
+  CACHE_SEC_IDX_CLIENT,    /* client_by_id 槽位 */
+  CACHE_SEC_IDX_PROFILE,   /* client_by_profile 槽位 */
+  CACHE_SEC_IDX_USERNAME,  /* client_by_username 槽位 */
+  CACHE_SEC_IDX_SOURCE_IP, /* client_by_source_ip 槽位 */
+  CACHE_SEC_IDX_PHASE,     /* ruleset_by_phase.index 槽位 */
+  CACHE_SEC_COUNT
+};
+
+#define CACHE_FIRST_INDEX CACHE_SEC_IDX_DLM
+
+typedef struct {
+  uint64_t offset; /* 相对文件起始的偏移 (对齐到 MAGIC_CONFIG_CACHE_ALIGN) */
+  uint64_t size;   /* 字节数 */
+} CacheSection;
+
+typedef struct {
+  char magic[8];                          /* MAGIC_CONFIG_CACHE_MAGIC */
+  uint32_t version;                       /* MAGIC_CONFIG_CACHE_VERSION */
+  uint32_t header_size;                   /* sizeof(CacheHeader) */
+  uint64_t layout;                        /* 布局签名 */
+  uint64_t key;                           /* 源文件缓存键 */
+  uint64_t image_size;                    /* 文件总长 */
+  CacheSection sections[CACHE_SEC_COUNT]; /* 段表 */
+  MagicConfig config;                     /* 配置副本 (指针字段清零) */
+} CacheHeader;
+
+/* 参与缓存键计算的源文件 (与各加载函数读取的文件一致) */
+static const char *const cache_sources[] = {
+    "Datalink_Profile.xml",
+    "Central_Policy_Profile.xml",
+    "Client_Profile.xml",
+};
+
+/*===========================================================================
+ * 内部辅助函数
+ *===========================================================================*/
+
+/* 布局签名: 结构体尺寸、指针宽度与字节序 */
+static uint64_t cache_layout_signature(void) {
+  const uint64_t traits[] = {
+      MAGIC_CONFIG_CACHE_VERSION,   sizeof(CacheHeader),
+      sizeof(MagicConfig),          sizeof(DLMConfig),
+      sizeof(ClientProfile),        sizeof(CentralPolicyProfile),
+      sizeof(TftWhitelistMatcher),  sizeof(MagicPhaseIndex),
+      sizeof(MagicConfigIndexSlot), sizeof(void *),
+      sizeof(time_t),               0x0102030405060708ull, /* 字节序 */
+  };
+  return magic_fnv1a64(MAGIC_FNV64_OFFSET, traits, sizeof(traits));
+}
+
+static uint64_t cache_align(uint64_t off) {
+  return (off + MAGIC_CONFIG_CACHE_ALIGN - 1) &
+         ~(uint64_t)(MAGIC_CONFIG_CACHE_ALIGN - 1);
+}
+
+/* 各索引在 MagicConfig 中的位置，与 CACHE_SEC_IDX_* 顺序一致 */
+static void cache_indexes(MagicConfig *config, MagicConfigIndex *out[]) {
+  out[0] = &config->dlm_by_name;
+  out[1] = &config->client_by_id;
+  out[2] = &config->client_by_profile;
+  out[3] = &config->client_by_username;
+  out[4] = &config->client_by_source_ip;
+  out[5] = &config->ruleset_by_phase.index;
+}
+
+/* 索引槽位中的下标上限，与 CACHE_SEC_IDX_* 顺序一致 */
+static void cache_index_limits(const MagicConfig *config, uint32_t out[]) {
+  out[0] = config->num_dlm_configs;
+  out[1] = out[2] = out[3] = out[4] = config->num_clients;
+  out[5] = config->ruleset_by_phase.count;
+}
+
+static int cache_write_all(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/* 校验头部与段表，返回失败原因，通过时返回 NULL */
+static const char *cache_validate(const CacheHeader *hdr, size_t size) {
+  static const char magic[8] = MAGIC_CONFIG_CACHE_MAGIC;
+
+  if (size < sizeof(*hdr) || memcmp(hdr->magic, magic, sizeof(magic)) != 0)
+    return "bad magic";
+  if (hdr->version != MAGIC_CONFIG_CACHE_VERSION ||
+      hdr->header_size != sizeof(*hdr) ||
+      hdr->layout != cache_layout_signature())
+    return "layout mismatch";
+  if (hdr->image_size != size)
+    return "truncated";
+
+  const MagicConfig *c = &hdr->config;
+  if (c->policy.num_rulesets > MAX_POLICY_RULESETS ||
+      c->policy.num_traffic_class_defs > MAX_TRAFFIC_CLASS_DEFS ||
+      c->ruleset_by_phase.count > MAX_PHASE_TOKENS)
+    return "bad counts";
+
+  const CacheSection *sec = hdr->sections;
+  if (sec[CACHE_SEC_DLMS].size !=
+          (uint64_t)c->num_dlm_configs * sizeof(DLMConfig) ||
+      sec[CACHE_SEC_CLIENTS].size !=
+          (uint64_t)c->num_clients * sizeof(ClientProfile) ||
+      sec[CACHE_SEC_LINKS].size != (uint64_t)c->policy.num_links * MAX_ID_LEN)
+    return "bad section size";
+
+  MagicConfigIndex *idx[CACHE_SEC_COUNT - CACHE_FIRST_INDEX];
+  cache_indexes((MagicConfig *)c, idx);
+  for (int i = 0; i < CACHE_SEC_COUNT; i++) {
+    if (sec[i].offset % MAGIC_CONFIG_CACHE_ALIGN != 0 ||
+        sec[i].offset < sizeof(*hdr) || sec[i].offset > size ||
+        sec[i].size > size - sec[i].offset)
+      return "bad section bounds";
+
+    if (i < CACHE_FIRST_INDEX)
+      continue;
+    uint64_t slots = sec[i].size / sizeof(MagicConfigIndexSlot);
+    uint32_t mask = idx[i - CACHE_FIRST_INDEX]->mask;
+    bool pow2 = slots != 0 && (slots & (slots - 1)) == 0;
+    if (slots == 0 ? mask != 0 : !pow2 || mask != slots - 1)
+      return "bad index";
+  }
+  return NULL;
+}
+
+/* 校验索引槽位中的下标 (只触及索引段，不读入客户端数组) */
+static bool cache_indexes_sane(const MagicConfig *config) {
+  MagicConfigIndex *idx[CACHE_SEC_COUNT - CACHE_FIRST_INDEX];
+  uint32_t limit[CACHE_SEC_COUNT - CACHE_FIRST_INDEX];
+  cache_indexes((MagicConfig *)config, idx);
+  cache_index_limits(config, limit);
+
+  for (int i = 0; i < CACHE_SEC_COUNT - CACHE_FIRST_INDEX; i++) {
+    if (!idx[i]->slots)
+      continue;
+    for (uint32_t s = 0; s <= idx[i]->mask; s++) {
+      const MagicConfigIndexSlot *slot = &idx[i]->slots[s];
+      if (slot->hash != 0 && slot->value >= limit[i])
+        return false;
+    }
+  }
+  return true;
+}
+
+/*===========================================================================
+ * 公共接口
+ *===========================================================================*/
+
+int magic_config_cache_key(const char *base_path, uint64_t *key) {
+  uint64_t h = MAGIC_FNV64_OFFSET;
+  char buf[16384];
+
+  for (size_t f = 0; f < sizeof(cache_sources) / sizeof(cache_sources[0]);
+       f++) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", base_path, cache_sources[f]);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return -1;
+
+    /* 文件名与长度一并计入，避免内容在文件间挪动时碰撞 */
+    h = magic_fnv1a64(h, cache_sources[f], strlen(cache_sources[f]) + 1);
+    uint64_t total = 0;
+    for (;;) {
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0) {
+        close(fd);
+        return -1;
+      }
+      if (n == 0)
+        break;
+      h = magic_fnv1a64(h, buf, (size_t)n);
+      total += (uint64_t)n;
+    }
+    close(fd);
+    h = magic_fnv1a64(h, &total, sizeof(total));
+  }
+
+  *key = h;
+  return 0;
+}
+
+int magic_config_cache_load(MagicConfig *config, const char *cache_path,
+                            uint64_t key) {
+  if (!config || !cache_path || !cache_path[0])
+    return -1;
+
+  int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+    close(fd);
+    return -1;
+  }
+
+  size_t size = (size_t)st.st_size;
+  char *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fd_log_error("[app_magic] Cannot map config cache %s: %s", cache_path,
+                 strerror(errno));
+    return -1;
+  }
+
+  const CacheHeader *hdr = (const CacheHeader *)base;
+  const char *why = cache_validate(hdr, size);
+  if (!why && hdr->key != key)
+    why = "stale";
+  if (why) {
+    fd_log_notice("[app_magic] ⚠ Config cache %s unusable (%s), rebuilding",
+                  cache_path, why);
+    munmap(base, size);
+    return -1;
+  }
+
+  /* 复制头部中的配置，再把数组与索引指向映射内的各段 */
+  const CacheSection *sec = hdr->sections;
+  memcpy(config, &hdr->config, sizeof(*config));
+  config->dlm_configs = (DLMConfig *)(base + sec[CACHE_SEC_DLMS].offset);
+  config->dlm_capacity = config->num_dlm_configs;
+  config->clients = (ClientProfile *)(base + sec[CACHE_SEC_CLIENTS].offset);
+  config->client_capacity = config->num_clients;
+  config->policy.available_links =
+      (char(*)[MAX_ID_LEN])(base + sec[CACHE_SEC_LINKS].offset);
+  config->policy.link_capacity = config->policy.num_links;
+
+  MagicConfigIndex *idx[CACHE_SEC_COUNT - CACHE_FIRST_INDEX];
+  cache_indexes(config, idx);
+  for (int i = CACHE_FIRST_INDEX; i < CACHE_SEC_COUNT; i++)
+    idx[i - CACHE_FIRST_INDEX]->slots =
+        sec[i].size ? (MagicConfigIndexSlot *)(base + sec[i].offset) : NULL;
+
+  config->image = base;
+  config->image_size = size;
+
+  if (!cache_indexes_sane(config)) {
+    fd_log_notice("[app_magic] ⚠ Config cache %s unusable (bad index), "
+                  "rebuilding",
+                  cache_path);
+    magic_config_cleanup(config);
+    return -1;
+  }
+
+  fd_log_notice("[app_magic] ✓ Config loaded from cache %s (%zu KB)",
+                cache_path, size / 1024);
+  return 0;
+}
+
+int magic_config_cache_save(const MagicConfig *config, const char *cache_path,
+                            uint64_t key) {
+  if (!config || !cache_path || !cache_path[0] || config->image)
+    return -1;
+
+  CacheHeader *hdr = calloc(1, sizeof(*hdr));
+  if (!hdr)
+    return -1;
+
+  memcpy(hdr->magic, MAGIC_CONFIG_CACHE_MAGIC, sizeof(hdr->magic));
+  hdr->version = MAGIC_CONFIG_CACHE_VERSION;
+  hdr->header_size = sizeof(*hdr);
+  hdr->layout = cache_layout_signature();
+  hdr->key = key;
+
+  /* 段内容与布局 */
+  const void *data[CACHE_SEC_COUNT];
+  MagicConfigIndex *idx[CACHE_SEC_COUNT - CACHE_FIRST_INDEX];
+  cache_indexes((MagicConfig *)config, idx);
+
+  data[CACHE_SEC_DLMS] = config->dlm_configs;
+  hdr->sections[CACHE_SEC_DLMS].size =
+      (uint64_t)config->num_dlm_configs * sizeof(DLMConfig);
+  data[CACHE_SEC_CLIENTS] = config->clients;
+  hdr->sections[CACHE_SEC_CLIENTS].size =
+      (uint64_t)config->num_clients * sizeof(ClientProfile);
+  data[CACHE_SEC_LINKS] = config->policy.available_links;
+  hdr->sections[CACHE_SEC_LINKS].size =
+      (uint64_t)config->policy.num_links * MAX_ID_LEN;
+  for (int i = CACHE_FIRST_INDEX; i < CACHE_SEC_COUNT; i++) {
+    const MagicConfigIndex *ix = idx[i - CACHE_FIRST_INDEX];
+    data[i] = ix->slots;
+    hdr->sections[i].size =
+        ix->slots ? ((uint64_t)ix->mask + 1) * sizeof(MagicConfigIndexSlot)
+                  : 0;
+  }
+
+  uint64_t off = cache_align(sizeof(*hdr));
+  for (int i = 0; i < CACHE_SEC_COUNT; i++) {
+    hdr->sections[i].offset = off;
+    off = cache_align(off + hdr->sections[i].size);
+  }
+  hdr->image_size = off;
+
+  /* 头部中的配置副本: 指针与运行时字段清零 */
+  hdr->config = *config;
+  hdr->config.dlm_configs = NULL;
+  hdr->config.clients = NULL;
+  hdr->config.policy.available_links = NULL;
+  cache_indexes(&hdr->config, idx);
+  for (int i = 0; i < CACHE_SEC_COUNT - CACHE_FIRST_INDEX; i++)
+    idx[i]->slots = NULL;
+  hdr->config.image = NULL;
+  hdr->config.image_size = 0;
+  hdr->config.load_time = 0;
+  hdr->config.is_loaded = false;
+  hdr->config.adif_degraded_mode = false;
+
+  char tmp_path[512];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%d", cache_path, (int)getpid());
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fd_log_notice("[app_magic] ⚠ Cannot write config cache %s: %s", tmp_path,
+                  strerror(errno));
+    free(hdr);
+    return -1;
+  }
+
+  static const char zeros[MAGIC_CONFIG_CACHE_ALIGN];
+  uint64_t pos = sizeof(*hdr);
+  int ret = cache_write_all(fd, hdr, sizeof(*hdr));
+  for (int i = 0; ret == 0 && i < CACHE_SEC_COUNT; i++) {
+    ret = cache_write_all(fd, zeros, hdr->sections[i].offset - pos);
+    if (ret == 0 && hdr->sections[i].size)
+      ret = cache_write_all(fd, data[i], hdr->sections[i].size);
+    pos = hdr->sections[i].offset + hdr->sections[i].size;
+  }
+  if (ret == 0)
+    ret = cache_write_all(fd, zeros, hdr->image_size - pos);
+
+  if (ret != 0 || fdatasync(fd) != 0 || rename(tmp_path, cache_path) != 0) {
+    fd_log_notice("[app_magic] ⚠ Cannot write config cache %s: %s",
+                  cache_path, strerror(errno));
+    close(fd);
+    unlink(tmp_path);
+    free(hdr);
+    return -1;
+  }
+  close(fd);
+
+  fd_log_notice("[app_magic] Config cache %s written (%llu KB)", cache_path,
+                (unsigned long long)(hdr->image_size / 1024));
+  free(hdr);
+  return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file magic_config_cache.h
+ * @brief MAGIC 配置二进制缓存 (预编译镜像)。
+ * @details 把解析并编译完成的 MagicConfig 写成可直接 mmap 的二进制镜像，
+ *          下次启动/重载时若源 XML 未变，一次 mmap 即可取得完整配置，
+ *          省去 libxml2 解析、TFT 白名单编译与索引构建。
+ *
+ * 设计要点:
+ * - 键: 三个 XML 文件内容的 FNV-1a 64 位哈希；任一文件改动即失效
+ * - 布局签名: 结构体尺寸、指针宽度与字节序折算成的哈希，编译器或
+ *   结构体改变后旧镜像自动作废；语义变化而尺寸不变时递增
+ *   MAGIC_CONFIG_CACHE_VERSION
+ * - 镜像格式: [头部 (含 MagicConfig 副本与段表)][DLM 数组][客户端数组]
+ *   [各索引槽位]，各段按 64 字节对齐，段内无指针，载入时只需把
+ *   MagicConfig 中的数组/索引指针指向映射内的偏移
+ * - 映射方式: MAP_PRIVATE 可写，运行时标志 (is_active/is_online) 写入时
+ *   写时复制，不影响文件；未访问的客户端页 (TFT 原文等) 不会读入内存
+ * - 写入: 临时文件 + fdatasync + rename，读者永远不会看到半个镜像；
+ *   已映射的旧镜像不受替换影响
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_CONFIG_CACHE_H
+#define MAGIC_CONFIG_CACHE_H
+
+#include "magic_config.h"
+#include <stdint.h>
+
+#define MAGIC_CONFIG_CACHE_PATH "/var/lib/magic/config.cache" /* 默认路径 */
+#define MAGIC_CONFIG_CACHE_MAGIC "MAGICFG"                    /* 文件魔数 */
+#define MAGIC_CONFIG_CACHE_VERSION 2 /* 镜像格式版本 */
+#define MAGIC_CONFIG_CACHE_ALIGN 64  /* 段对齐 (字节) */
+
+/**
+ * @brief 计算配置源文件的缓存键。
+ * @param base_path XML 配置目录。
+ * @param[out] key 三个 XML 文件内容的哈希。
+ * @return 0 成功，-1 任一文件无法读取。
+ */
+int magic_config_cache_key(const char *base_path, uint64_t *key);
+
+/**
+ * @brief 从缓存镜像载入配置。
+ * @details 校验魔数、版本、布局签名、键与各段边界后映射整个文件。
+ *          成功时 config->image 指向映射，由 magic_config_cleanup 解除。
+ * @param config 已 magic_config_init 的空配置。
+ * @param cache_path 镜像路径。
+ * @param key 期望的缓存键。
+ * @return 0 命中，-1 不存在、已过期或校验失败 (config 保持为空)。
+ */
+int magic_config_cache_load(MagicConfig *config, const char *cache_path,
+                            uint64_t key);
+
+/**
+ * @brief 把配置写成缓存镜像 (原子替换)。
+ * @param config 由 XML 加载完成的配置。
+ * @param cache_path 镜像路径。
+ * @param key 加载所用源文件的缓存键。
+ * @return 0 成功，-1 写入失败 (不影响已加载的配置)。
+ */
+int magic_config_cache_save(const MagicConfig *config, const char *cache_path,
+                            uint64_t key);
+
+#endif /* MAGIC_CONFIG_CACHE_H */
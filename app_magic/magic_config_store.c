@@ -0,0 +1,329 @@
+/**
+ * @file magic_config_store.c
+ * @brief MAGIC 配置快照存储实现。
+ * @details 读侧用线程局部变量记录嵌套深度与固定的快照；纪元计数器只在
+ *          最外层进入/退出时各做一次原子加减。写侧 (重载) 由 reload_lock
+ *          串行化：解析 → 发布 (publish_lock 内交换指针并带入运行时标志)
+ *          → 翻转纪元并等待旧纪元读者清零 → 释放旧快照。解析前先按源文件
+ *          哈希查二进制缓存，命中时以一次 mmap 代替解析。
+ */
+
+#include "magic_config_store.h"
+#include "magic_config_cache.h"
+#include <freeDiameter/extension.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*===========================================================================
+ * 线程局部读侧状态
+ *===========================================================================*/
+
+static __thread MagicConfigSnapshot *tls_section; /* 读临界区固定的快照 */
+static __thread MagicConfigSnapshot *tls_held;    /* pin 指定的持有快照 */
+static __thread uint32_t tls_depth;               /* 读临界区嵌套深度 */
+static __thread uint32_t tls_slot;                /* 登记的 readers[] 下标 */
+
+/* 本线程实际使用的快照: pin 优先于读临界区 */
+static inline MagicConfigSnapshot *tls_effective(void) {
+  return tls_held ? tls_held : tls_section;
+}
+
+/*===========================================================================
+ * 内部辅助函数
+ *===========================================================================*/
+
+static void snapshot_free(MagicConfigSnapshot *snap) {
+  fd_log_notice("[app_magic] Config v%llu reclaimed",
+                (unsigned long long)snap->version);
+  magic_config_cleanup(&snap->config);
+  free(snap);
+}
+
+static void snapshot_put(MagicConfigSnapshot *snap) {
+  if (snap && __atomic_sub_fetch(&snap->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    snapshot_free(snap);
+}
+
+/* 把旧快照中的运行时状态带入新快照 (调用方持有 publish_lock) */
+static void snapshot_carry_runtime(MagicConfigSnapshot *to,
+                                   MagicConfigSnapshot *from) {
+  to->config.adif_degraded_mode = from->config.adif_degraded_mode;
+
+  for (uint32_t i = 0; i < to->config.num_dlm_configs; i++) {
+    DLMConfig *dlm = &to->config.dlm_configs[i];
+    DLMConfig *old = magic_config_find_dlm(&from->config, dlm->dlm_name);
+    if (old)
+      dlm->is_active = old->is_active;
+  }
+
+  for (uint32_t i = 0; i < to->config.num_clients; i++) {
+    ClientProfile *client = &to->config.clients[i];
+    ClientProfile *old =
+        magic_config_find_client(&from->config, client->client_id);
+    if (old)
+      client->is_online = old->is_online;
+  }
+}
+
+/**
+ * @brief 等待宽限期。
+ * @details 翻转纪元后，新进入的读者登记到另一组计数器并读到新指针；
+ *          旧组计数清零即说明不再有读者可能持有旧指针。
+ */
+static void store_synchronize(MagicConfigStore *store) {
+  uint32_t old = __atomic_fetch_add(&store->epoch, 1, __ATOMIC_SEQ_CST);
+  uint32_t slot = old & 1;
+
+  while (__atomic_load_n(&store->readers[slot], __ATOMIC_SEQ_CST) != 0)
+    usleep(MAGIC_CONFIG_GRACE_POLL_US);
+}
+
+/* 发布新快照，返回被替换的旧快照 (可能为 NULL) */
+static MagicConfigSnapshot *store_publish(MagicConfigStore *store,
+                                          MagicConfigSnapshot *snap) {
+  pthread_mutex_lock(&store->publish_lock);
+  MagicConfigSnapshot *old = store->current;
+  snap->version = ++store->next_version;
+  snap->published_at = time(NULL);
+  snap->config.load_time = snap->published_at;
+  snap->config.is_loaded = true;
+  if (old)
+    snapshot_carry_runtime(snap, old);
+  __atomic_store_n(&store->current, snap, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&store->publish_lock);
+  return old;
+}
+
+/*===========================================================================
+ * 生命周期与重载
+ *===========================================================================*/
+
+int magic_config_store_init(MagicConfigStore *store, const char *base_path) {
+  if (!store || !base_path)
+    return -1;
+
+  memset(store, 0, sizeof(*store));
+  strncpy(store->base_path, base_path, sizeof(store->base_path) - 1);
+  strncpy(store->cache_path, MAGIC_CONFIG_CACHE_PATH,
+          sizeof(store->cache_path) - 1);
+  pthread_mutex_init(&store->publish_lock, NULL);
+  pthread_mutex_init(&store->reload_lock, NULL);
+  store->initialized = true;
+  return 0;
+}
+
+void magic_config_store_set_publish_cb(MagicConfigStore *store,
+                                       magic_config_publish_cb_t cb,
+                                       void *arg) {
+  if (!store)
+    return;
+
+  pthread_mutex_lock(&store->reload_lock);
+  store->on_publish = cb;
+  store->on_publish_arg = arg;
+  pthread_mutex_unlock(&store->reload_lock);
+}
+
+void magic_config_store_set_cache_path(MagicConfigStore *store,
+                                       const char *cache_path) {
+  if (!store)
+    return;
+
+  pthread_mutex_lock(&store->reload_lock);
+  snprintf(store->cache_path, sizeof(store->cache_path), "%s",
+           cache_path ? cache_path : "");
+  pthread_mutex_unlock(&store->reload_lock);
+}
+
+/**
+ * @brief 解析三个 XML 文件 (派生索引与 TFT 白名单在加载函数内编译)。
+ * @return 失败的文件名，成功返回 NULL。
+ */
+static const char *store_parse(MagicConfig *config, const char *base_path) {
+  if (magic_config_load_datalinks(config, base_path) < 0)
+    return "Datalink_Profile.xml";
+  if (magic_config_load_policy(config, base_path) < 0)
+    return "Central_Policy_Profile.xml";
+  if (magic_config_load_clients(config, base_path) < 0)
+    return "Client_Profile.xml";
+  return NULL;
+}
+
+int magic_config_store_reload(MagicConfigStore *store) {
+  if (!store || !store->initialized)
+    return -1;
+
+  pthread_mutex_lock(&store->reload_lock);
+
+  MagicConfigSnapshot *snap = calloc(1, sizeof(*snap));
+  if (!snap) {
+    fd_log_error("[app_magic] Config reload: out of memory");
+    store->reloads_failed++;
+    pthread_mutex_unlock(&store->reload_lock);
+    return -1;
+  }
+  magic_config_init(&snap->config);
+  snap->refs = 1;
+
+  /* 源文件未变时直接映射缓存镜像，否则解析后重写镜像 */
+  const char *failed = NULL;
+  bool use_cache = store->cache_path[0] != '\0';
+  uint64_t key = 0;
+  if (use_cache && magic_config_cache_key(store->base_path, &key) < 0)
+    use_cache = false; /* 源文件不可读，交给解析报告具体错误 */
+
+  if (use_cache &&
+      magic_config_cache_load(&snap->config, store->cache_path, key) == 0) {
+    store->cache_hits++;
+  } else if (!(failed = store_parse(&snap->config, store->base_path)) &&
+             use_cache) {
+    /* 解析期间源文件被改写时，镜像与键不再对应，不写入 */
+    uint64_t after = 0;
+    if (magic_config_cache_key(store->base_path, &after) == 0 && after == key)
+      magic_config_cache_save(&snap->config, store->cache_path, key);
+  }
+
+  if (failed) {
+    fd_log_error("[app_magic] ✗ Config reload failed at %s, keeping v%llu",
+                 failed, (unsigned long long)store->next_version);
+    magic_config_cleanup(&snap->config);
+    free(snap);
+    store->reloads_failed++;
+    pthread_mutex_unlock(&store->reload_lock);
+    return -1;
+  }
+
+  MagicConfigSnapshot *old = store_publish(store, snap);
+  fd_log_notice("[app_magic] ✓ Config v%llu published (%u DLMs, %u rulesets, "
+                "%u clients)",
+                (unsigned long long)snap->version, snap->config.num_dlm_configs,
+                snap->config.policy.num_rulesets, snap->config.num_clients);
+
+  if (store->on_publish)
+    store->on_publish(&snap->config, store->on_publish_arg);
+
+  if (old) {
+    /* 进行中的请求在旧版本上完成；挂起的请求各自持有引用 */
+    store_synchronize(store);
+    snapshot_put(old);
+  }
+
+  store->reloads_ok++;
+  pthread_mutex_unlock(&store->reload_lock);
+  return 0;
+}
+
+void magic_config_store_cleanup(MagicConfigStore *store) {
+  if (!store || !store->initialized)
+    return;
+
+  pthread_mutex_lock(&store->reload_lock);
+  MagicConfigSnapshot *old = __atomic_exchange_n(&store->current, NULL,
+                                                 __ATOMIC_ACQ_REL);
+  if (old) {
+    store_synchronize(store);
+    snapshot_put(old);
+  }
+  pthread_mutex_unlock(&store->reload_lock);
+
+  pthread_mutex_destroy(&store->publish_lock);
+  pthread_mutex_destroy(&store->reload_lock);
+  store->initialized = false;
+}
+
+/*===========================================================================
+ * 读侧
+ *===========================================================================*/
+
+MagicConfig *magic_config_read_begin(MagicConfigStore *store) {
+  if (!store)
+    return NULL;
+
+  if (tls_depth++ == 0) {
+    for (;;) {
+      uint32_t e = __atomic_load_n(&store->epoch, __ATOMIC_SEQ_CST);
+      __atomic_add_fetch(&store->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&store->epoch, __ATOMIC_SEQ_CST) == e) {
+        tls_slot = e & 1;
+        break;
+      }
+      /* 登记期间纪元已翻转，撤销后按新纪元重试 */
+      __atomic_sub_fetch(&store->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+    }
+    tls_section = __atomic_load_n(&store->current, __ATOMIC_ACQUIRE);
+  }
+
+  MagicConfigSnapshot *snap = tls_effective();
+  return snap ? &snap->config : NULL;
+}
+
+void magic_config_read_end(MagicConfigStore *store) {
+  if (!store || tls_depth == 0)
+    return;
+
+  if (--tls_depth == 0) {
+    tls_section = NULL;
+    __atomic_sub_fetch(&store->readers[tls_slot], 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+MagicConfig *magic_config_current(MagicConfigStore *store) {
+  MagicConfigSnapshot *snap = tls_effective();
+  if (!snap && store)
+    snap = __atomic_load_n(&store->current, __ATOMIC_ACQUIRE);
+  return snap ? &snap->config : NULL;
+}
+
+MagicConfigSnapshot *magic_config_hold(MagicConfigStore *store) {
+  (void)store;
+  MagicConfigSnapshot *snap = tls_effective();
+  if (snap)
+    __atomic_add_fetch(&snap->refs, 1, __ATOMIC_ACQ_REL);
+  return snap;
+}
+
+void magic_config_release(MagicConfigStore *store, MagicConfigSnapshot *snap) {
+  (void)store;
+  snapshot_put(snap);
+}
+
+MagicConfigSnapshot *magic_config_pin(MagicConfigStore *store,
+                                      MagicConfigSnapshot *snap) {
+  (void)store;
+  MagicConfigSnapshot *prev = tls_held;
+  if (snap)
+    tls_held = snap;
+  return prev;
+}
+
+void magic_config_unpin(MagicConfigStore *store, MagicConfigSnapshot *prev) {
+  (void)store;
+  tls_held = prev;
+}
+
+/*===========================================================================
+ * 运行时标志
+ *===========================================================================*/
+
+void magic_config_set_link_active(MagicConfigStore *store,
+                                  const char *dlm_name, bool active) {
+  if (!store || !dlm_name)
+    return;
+
+  pthread_mutex_lock(&store->publish_lock);
+  MagicConfigSnapshot *cur = store->current;
+  DLMConfig *dlm = cur ? magic_config_find_dlm(&cur->config, dlm_name) : NULL;
+  if (dlm)
+    dlm->is_active = active;
+
+  /* 本线程可能仍固定在旧版本上，区内后续读取应看到刚写入的值 */
+  MagicConfigSnapshot *mine = tls_effective();
+  if (mine && mine != cur) {
+    dlm = magic_config_find_dlm(&mine->config, dlm_name);
+    if (dlm)
+      dlm->is_active = active;
+  }
+  pthread_mutex_unlock(&store->publish_lock);
+}
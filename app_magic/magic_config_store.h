@@ -0,0 +1,201 @@
+/**
+ * @file magic_config_store.h
+ * @brief MAGIC 配置快照存储 (热重载)。
+ * @details 把 XML 配置解析成不可变的版本化快照，重载时在后台完成解析与
+ *          派生索引编译 (TFT 白名单等)，再以一次原子指针交换发布新版本。
+ *
+ * 设计要点:
+ * - 读侧: magic_config_read_begin/end 界定读临界区 (可嵌套)，区内固定
+ *   使用进入时的快照，同一请求看到的始终是同一版本
+ * - 回收: RCU 风格的两组纪元读者计数；发布后翻转纪元并等待旧纪元读者
+ *   清零 (宽限期)，随后释放存储对旧快照的引用
+ * - 长期持有: 跨线程挂起的请求 (MCAR/MCCR 重试) 用 magic_config_hold
+ *   取得引用，续跑时 magic_config_pin 回到原版本，完成后再释放
+ * - 运行时标志: DLMConfig.is_active 等由 LMI 在运行中改写的字段经
+ *   magic_config_set_link_active 写入，发布时带入新快照，不会丢失
+ * - 二进制缓存: 源 XML 未变时直接映射上次编译好的镜像
+ *   (magic_config_cache.h)，否则解析后重写镜像
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_CONFIG_STORE_H
+#define MAGIC_CONFIG_STORE_H
+
+#include "magic_config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define MAGIC_CONFIG_PATH_LEN 256       /* 配置目录路径最大长度 */
+#define MAGIC_CONFIG_GRACE_POLL_US 1000 /* 宽限期等待的轮询间隔 (微秒) */
+
+/**
+ * @brief 不可变配置快照。
+ * @details 发布后除运行时标志外不再修改；最后一个引用释放时回收。
+ */
+typedef struct MagicConfigSnapshot {
+  MagicConfig config;  ///< 解析并编译完成的配置。
+  uint64_t version;    ///< 版本号 (发布时分配，单调递增)。
+  time_t published_at; ///< 发布时间。
+  uint32_t refs;       ///< 引用计数 (存储本身持有 1 个)。
+} MagicConfigSnapshot;
+
+/**
+ * @brief 发布回调类型。
+ * @details 新快照发布后 (宽限期之前) 在重载线程中调用，
+ *          用于让缓存了配置派生值的模块 (准入账本、推送策略) 重新取值。
+ * @param config 新发布的配置。
+ * @param arg 注册时传入的用户数据。
+ */
+typedef void (*magic_config_publish_cb_t)(const MagicConfig *config,
+                                          void *arg);
+
+/**
+ * @brief 配置快照存储。
+ */
+typedef struct {
+  MagicConfigSnapshot *current; ///< 当前版本 (原子读写)。
+  uint32_t epoch;               ///< 读侧纪元，奇偶选择 readers[]。
+  uint32_t readers[2];          ///< 各纪元内的活跃读临界区数。
+
+  pthread_mutex_t publish_lock; ///< 串行化发布与运行时标志写入。
+  pthread_mutex_t reload_lock;  ///< 串行化重载 (解析 + 宽限期)。
+  char base_path[MAGIC_CONFIG_PATH_LEN];  ///< XML 配置目录。
+  char cache_path[MAGIC_CONFIG_PATH_LEN]; ///< 二进制缓存路径 (空=禁用)。
+  uint64_t next_version;                  ///< 下一个版本号。
+
+  magic_config_publish_cb_t on_publish; ///< 发布回调 (可为 NULL)。
+  void *on_publish_arg;                 ///< 发布回调参数。
+
+  uint64_t reloads_ok;     ///< 成功重载次数。
+  uint64_t reloads_failed; ///< 失败重载次数 (旧版本保持生效)。
+  uint64_t cache_hits;     ///< 直接映射缓存镜像的重载次数。
+  bool initialized;        ///< 是否已初始化。
+} MagicConfigStore;
+
+/*===========================================================================
+ * 生命周期与重载
+ *===========================================================================*/
+
+/**
+ * @brief 初始化存储 (尚无快照)。
+ * @details 二进制缓存默认使用 MAGIC_CONFIG_CACHE_PATH。
+ * @param store 存储。
+ * @param base_path XML 配置目录。
+ * @return 0 成功，-1 参数错误。
+ */
+int magic_config_store_init(MagicConfigStore *store, const char *base_path);
+
+/**
+ * @brief 设置发布回调。
+ * @param store 存储。
+ * @param cb 回调，NULL 取消。
+ * @param arg 回调参数。
+ */
+void magic_config_store_set_publish_cb(MagicConfigStore *store,
+                                       magic_config_publish_cb_t cb,
+                                       void *arg);
+
+/**
+ * @brief 设置二进制缓存路径。
+ * @param store 存储。
+ * @param cache_path 镜像路径，NULL 或空串禁用缓存。
+ */
+void magic_config_store_set_cache_path(MagicConfigStore *store,
+                                       const char *cache_path);
+
+/**
+ * @brief 从 base_path 重新加载全部 XML 并发布新快照。
+ * @details 解析在调用线程完成，期间读侧照常使用旧版本；任一文件失败则
+ *          丢弃新快照，旧版本继续生效。发布后等待宽限期并释放旧快照。
+ *          首次调用即完成初始加载。源文件与缓存镜像一致时跳过解析。
+ * @param store 存储。
+ * @return 0 成功，-1 失败。
+ * @warning 不可在读临界区内调用 (宽限期会等待自身)。
+ */
+int magic_config_store_reload(MagicConfigStore *store);
+
+/**
+ * @brief 释放当前快照并销毁存储。
+ * @details 调用时不应再有读者 (扩展卸载阶段)。
+ * @param store 存储。
+ */
+void magic_config_store_cleanup(MagicConfigStore *store);
+
+/*===========================================================================
+ * 读侧
+ *===========================================================================*/
+
+/**
+ * @brief 进入读临界区并固定当前快照。
+ * @details 可嵌套；只有最外层登记纪元读者。临界区内不得阻塞等待重载。
+ * @param store 存储。
+ * @return 固定的配置，尚未加载时为 NULL。
+ */
+MagicConfig *magic_config_read_begin(MagicConfigStore *store);
+
+/**
+ * @brief 退出读临界区。
+ * @param store 存储。
+ */
+void magic_config_read_end(MagicConfigStore *store);
+
+/**
+ * @brief 获取本线程应使用的配置。
+ * @details 在读临界区或 pin 之内返回固定的快照；否则返回最新版本
+ *          (仅限初始化/卸载等不会与重载并发的场景)。
+ * @param store 存储。
+ * @return 配置，尚未加载时为 NULL。
+ */
+MagicConfig *magic_config_current(MagicConfigStore *store);
+
+/**
+ * @brief 为本线程当前使用的快照增加一个引用。
+ * @details 用于把请求挂起到其他线程继续处理；须在读临界区内调用。
+ * @param store 存储。
+ * @return 快照，尚未加载时为 NULL。
+ */
+MagicConfigSnapshot *magic_config_hold(MagicConfigStore *store);
+
+/**
+ * @brief 释放 magic_config_hold 取得的引用。
+ * @param store 存储。
+ * @param snap 快照 (可为 NULL)。
+ */
+void magic_config_release(MagicConfigStore *store, MagicConfigSnapshot *snap);
+
+/**
+ * @brief 让本线程临时使用一个已持有引用的快照。
+ * @param store 存储。
+ * @param snap 已 hold 的快照 (NULL 时不改变)。
+ * @return 之前固定的快照，交给 magic_config_unpin 恢复。
+ */
+MagicConfigSnapshot *magic_config_pin(MagicConfigStore *store,
+                                      MagicConfigSnapshot *snap);
+
+/**
+ * @brief 恢复 magic_config_pin 之前固定的快照。
+ * @param store 存储。
+ * @param prev magic_config_pin 的返回值。
+ */
+void magic_config_unpin(MagicConfigStore *store, MagicConfigSnapshot *prev);
+
+/*===========================================================================
+ * 运行时标志
+ *===========================================================================*/
+
+/**
+ * @brief 设置 DLM 的运行时激活状态。
+ * @details 同时写入最新快照与本线程固定的快照，并与发布互斥，
+ *          保证状态随重载带入新版本。
+ * @param store 存储。
+ * @param dlm_name DLM 名称。
+ * @param active 是否激活。
+ */
+void magic_config_set_link_active(MagicConfigStore *store,
+                                  const char *dlm_name, bool active);
+
+#endif /* MAGIC_CONFIG_STORE_H */
@@ -11,6 +11,15 @@
  * 5. 会话建立: 添加 filter FORWARD 精确放行规则 (TFT 五元组)
  * 6. 会话关闭: 删除对应的 mangle 和 filter 规则，清理 conntrack
  *
+ * 下发后端: ip route / ip rule / ipset / conntrack 操作在 netlink 后端下经
+ * magic_dataplane_nl.c 直接下发，exec 后端下执行等价命令；iptables 规则
+ * 两种后端均通过命令行下发。
+ *
+ * 链路切换: 会话切换只改写 mangle 打标规则 (fwmark → 路由表的 ip rule 为静态)，
+ * 经数据平面事务 (magic_dataplane_txn_*) 以一次 iptables-restore --noflush
+ * 原子提交 (输入经管道写入，执行期间不持有 ctx->mutex)，批量切换多个会话时
+ * 也只执行一次，全部生效或全部不生效。
+ *
  * @author MAGIC System Development Team
  * @version 2.0
  * @date 2025-12-26
@@ -19,6 +28,7 @@
 #include "magic_dataplane.h"
 #include <freeDiameter/freeDiameter-host.h>
 #include <freeDiameter/libfdcore.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,16 +36,24 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <net/if.h>
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <strings.h>
 
 /*===========================================================================
  * 内部辅助函数
  *===========================================================================*/
 
+/* netlink 后端 (magic_dataplane_init 选中 netlink 时非 NULL)。
+ * ipset / 黑洞规则等 helper 不携带上下文，因此在模块内保存一份指针 */
+static DataplaneNetlink* g_dp_nl = NULL;
+
 /**
  * @brief 执行系统命令并返回退出码
  */
@@ -71,6 +89,71 @@ bool magic_dataplane_interface_exists(const char* interface_name)
     return (idx != 0);
 }
 
+DataplaneBackend magic_dataplane_backend_from_string(const char* name)
+{
+    if (name && strcasecmp(name, "exec") == 0) return DATAPLANE_BACKEND_EXEC;
+    if (name && strcasecmp(name, "netlink") == 0) return DATAPLANE_BACKEND_NETLINK;
+    return DATAPLANE_BACKEND_AUTO;
+}
+
+static const char* backend_name(DataplaneBackend backend)
+{
+    switch (backend) {
+        case DATAPLANE_BACKEND_EXEC:    return "exec";
+        case DATAPLANE_BACKEND_NETLINK: return "netlink";
+        default:                        return "auto";
+    }
+}
+
+/**
+ * @brief 添加/删除 ip rule
+ * netlink 后端直接下发，否则执行等价命令 cmd (同时用于日志)
+ */
+static int dp_rule(bool add, const char* src_ip, uint32_t fwmark,
+                   uint32_t table, uint32_t priority, const char* cmd)
+{
+    if (g_dp_nl) {
+        int err = magic_dp_nl_rule(g_dp_nl, add, src_ip, fwmark, table, priority);
+        if (err != 0) {
+            fd_log_debug("[dataplane] netlink: %s → %s", cmd, strerror(-err));
+        }
+        return err;
+    }
+    return magic_dataplane_exec_cmd(cmd);
+}
+
+/**
+ * @brief 清空路由表 (ip route flush table N)
+ */
+static void dp_route_flush(uint32_t table)
+{
+    if (g_dp_nl) {
+        magic_dp_nl_route_flush_table(g_dp_nl, table);
+        return;
+    }
+    char cmd[MAX_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "ip route flush table %u 2>/dev/null", table);
+    magic_dataplane_exec_cmd(cmd);
+}
+
+/**
+ * @brief 删除源地址落在 prefix 内的 conntrack 条目 (conntrack -D -s)
+ */
+static void dp_conntrack_flush(const char* prefix)
+{
+    if (g_dp_nl && g_dp_nl->has_conntrack) {
+        int ret = magic_dp_nl_conntrack_flush_src(g_dp_nl, prefix);
+        if (ret >= 0) {
+            fd_log_debug("[dataplane] conntrack: 删除 %d 条 (src %s)", ret, prefix);
+            return;
+        }
+        fd_log_debug("[dataplane] netlink conntrack 清理失败 (%s)，改用命令行", strerror(-ret));
+    }
+    char cmd[MAX_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "conntrack -D -s %s 2>/dev/null", prefix);
+    magic_dataplane_exec_cmd(cmd);
+}
+
 /*=========================================================================
  * ipset helpers
  *-------------------------------------------------------------------------
@@ -78,36 +161,84 @@ bool magic_dataplane_interface_exists(const char* interface_name)
  *   - magic_control : MCAR 阶段注册 (control 白名单)
  *   - magic_data    : MCCR 成功放行 (data 白名单)
  *
- * 这些函数使用 `ipset` 命令并依赖于 magic_dataplane_exec_cmd 执行。
+ * netlink 后端且内核 ip_set 可用时直接经 nfnetlink 下发，否则使用 `ipset`
+ * 命令 (magic_dataplane_exec_cmd)。
  *=======================================================================*/
 
+static DataplaneNetlink* dp_nl_ipset(void)
+{
+    return (g_dp_nl && g_dp_nl->has_ipset) ? g_dp_nl : NULL;
+}
+
+/**
+ * @brief 创建 hash:ip 集合 (已存在则保留) 并清空历史条目
+ * @return 0=创建成功, 非 0=创建失败
+ */
+static int ipset_prepare(const char* name)
+{
+    DataplaneNetlink* nl = dp_nl_ipset();
+    char cmd[MAX_CMD_LEN];
+    int ret;
+
+    if (nl) {
+        ret = magic_dp_nl_ipset_create(nl, name);
+        magic_dp_nl_ipset_flush(nl, name);
+        return ret;
+    }
+
+    snprintf(cmd, sizeof(cmd), "ipset create %s hash:ip family inet -exist", name);
+    ret = magic_dataplane_exec_cmd(cmd);
+    snprintf(cmd, sizeof(cmd), "ipset flush %s", name);
+    magic_dataplane_exec_cmd(cmd);
+    return ret;
+}
+
+static void ipset_destroy_set(const char* name)
+{
+    DataplaneNetlink* nl = dp_nl_ipset();
+    if (nl) {
+        magic_dp_nl_ipset_destroy(nl, name);
+        return;
+    }
+    char cmd[MAX_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "ipset destroy %s 2>/dev/null", name);
+    magic_dataplane_exec_cmd(cmd);
+}
+
+/**
+ * @brief 向集合添加/删除客户端 IP (幂等)
+ */
+static int ipset_entry(bool add, const char* name, const char* client_ip)
+{
+    DataplaneNetlink* nl = dp_nl_ipset();
+    if (nl) {
+        return magic_dp_nl_ipset_entry(nl, add, name, client_ip);
+    }
+    char cmd[MAX_CMD_LEN];
+    if (add) {
+        snprintf(cmd, sizeof(cmd), "ipset add %s %s -exist", name, client_ip);
+    } else {
+        snprintf(cmd, sizeof(cmd), "ipset del %s %s 2>/dev/null", name, client_ip);
+    }
+    return magic_dataplane_exec_cmd(cmd);
+}
+
 int magic_dataplane_ipset_init(DataplaneContext* ctx)
 {
     (void)ctx;
-    char cmd[MAX_CMD_LEN];
 
-    /* 创建 control 集合 (hash:ip)，如果已存在则忽略 */
-    snprintf(cmd, sizeof(cmd), "ipset create magic_control hash:ip family inet -exist");
-    if (magic_dataplane_exec_cmd(cmd) != 0) {
+    /* 创建 control 集合 (hash:ip)，如果已存在则忽略；同时清空历史条目 */
+    if (ipset_prepare("magic_control") != 0) {
         fd_log_error("[dataplane] ipset create magic_control 失败");
         /* 继续尝试创建 data 集合 */
     }
-
-    /* 清空 control 集合中的历史条目 */
-    snprintf(cmd, sizeof(cmd), "ipset flush magic_control");
-    magic_dataplane_exec_cmd(cmd);
     fd_log_notice("[dataplane] ✓ ipset: magic_control 已准备（历史条目已清空）");
 
     /* 创建 data 集合 */
-    snprintf(cmd, sizeof(cmd), "ipset create magic_data hash:ip family inet -exist");
-    if (magic_dataplane_exec_cmd(cmd) != 0) {
+    if (ipset_prepare("magic_data") != 0) {
         fd_log_error("[dataplane] ipset create magic_data 失败");
         return -1;
     }
-
-    /* 清空 data 集合中的历史条目 */
-    snprintf(cmd, sizeof(cmd), "ipset flush magic_data");
-    magic_dataplane_exec_cmd(cmd);
     fd_log_notice("[dataplane] ✓ ipset: magic_data 已准备（历史条目已清空）");
     
     return 0;
@@ -116,13 +247,10 @@ int magic_dataplane_ipset_init(DataplaneContext* ctx)
 int magic_dataplane_ipset_destroy(DataplaneContext* ctx)
 {
     (void)ctx;
-    char cmd[MAX_CMD_LEN];
 
     /* 销毁集合，忽略不存在的错误 */
-    snprintf(cmd, sizeof(cmd), "ipset destroy magic_control 2>/dev/null");
-    magic_dataplane_exec_cmd(cmd);
-    snprintf(cmd, sizeof(cmd), "ipset destroy magic_data 2>/dev/null");
-    magic_dataplane_exec_cmd(cmd);
+    ipset_destroy_set("magic_control");
+    ipset_destroy_set("magic_data");
 
     fd_log_notice("[dataplane] ✓ ipset: magic_control/magic_data 已销毁");
     return 0;
@@ -131,11 +259,8 @@ int magic_dataplane_ipset_destroy(DataplaneContext* ctx)
 int magic_dataplane_ipset_add_control(const char* client_ip)
 {
     if (!client_ip) return -1;
-    char cmd[MAX_CMD_LEN];
 
-    /* 使用 -exist 保证幂等 */
-    snprintf(cmd, sizeof(cmd), "ipset add magic_control %s -exist", client_ip);
-    if (magic_dataplane_exec_cmd(cmd) != 0) {
+    if (ipset_entry(true, "magic_control", client_ip) != 0) {
         fd_log_error("[dataplane] ipset add magic_control %s 失败", client_ip);
         return -1;
     }
@@ -146,10 +271,8 @@ int magic_dataplane_ipset_add_control(const char* client_ip)
 int magic_dataplane_ipset_add_data(const char* client_ip)
 {
     if (!client_ip) return -1;
-    char cmd[MAX_CMD_LEN];
 
-    snprintf(cmd, sizeof(cmd), "ipset add magic_data %s -exist", client_ip);
-    if (magic_dataplane_exec_cmd(cmd) != 0) {
+    if (ipset_entry(true, "magic_data", client_ip) != 0) {
         fd_log_error("[dataplane] ipset add magic_data %s 失败", client_ip);
         return -1;
     }
@@ -160,13 +283,10 @@ int magic_dataplane_ipset_add_data(const char* client_ip)
 int magic_dataplane_ipset_del(const char* client_ip)
 {
     if (!client_ip) return -1;
-    char cmd[MAX_CMD_LEN];
 
     /* 从 control 和 data 集合中删除（忽略不存在） */
-    snprintf(cmd, sizeof(cmd), "ipset del magic_control %s 2>/dev/null", client_ip);
-    magic_dataplane_exec_cmd(cmd);
-    snprintf(cmd, sizeof(cmd), "ipset del magic_data %s 2>/dev/null", client_ip);
-    magic_dataplane_exec_cmd(cmd);
+    ipset_entry(false, "magic_control", client_ip);
+    ipset_entry(false, "magic_data", client_ip);
 
     fd_log_notice("[dataplane] ✓ ipset del (all): %s", client_ip);
     return 0;
@@ -281,16 +401,21 @@ static int create_route_table(LinkRouteConfig* link)
     }
     
     /* 确保接口启动 */
-    snprintf(cmd, sizeof(cmd), "ip link set %s up", link->interface_name);
-    if (magic_dataplane_exec_cmd(cmd) == 0) {
+    int ret;
+    if (g_dp_nl) {
+        ret = magic_dp_nl_link_up(g_dp_nl, link->interface_name);
+    } else {
+        snprintf(cmd, sizeof(cmd), "ip link set %s up", link->interface_name);
+        ret = magic_dataplane_exec_cmd(cmd);
+    }
+    if (ret == 0) {
         fd_log_notice("[dataplane] ✓ 启动接口: %s", link->interface_name);
     } else {
         fd_log_error("[dataplane] ✗ 启动接口失败: %s", link->interface_name);
     }
     
     /* 清理可能存在的旧路由 */
-    snprintf(cmd, sizeof(cmd), "ip route flush table %u 2>/dev/null", link->route_table_id);
-    magic_dataplane_exec_cmd(cmd);
+    dp_route_flush(link->route_table_id);
     
     /* 检查网关 IP 是否等于接口 IP（测试环境：服务器和DLM在同一机器） */
     if (link->gateway_ip[0]) {
@@ -318,7 +443,18 @@ static int create_route_table(LinkRouteConfig* link)
     
     fd_log_notice("[dataplane] 执行命令: %s", cmd);
     
-    int ret = magic_dataplane_exec_cmd(cmd);
+    if (g_dp_nl) {
+        bool via_gateway = link->gateway_ip[0] && !use_direct_route;
+        ret = magic_dp_nl_route_default(g_dp_nl, link->route_table_id,
+                                        link->interface_name,
+                                        via_gateway ? link->gateway_ip : NULL,
+                                        via_gateway);
+        if (ret != 0) {
+            fd_log_error("[dataplane]   netlink: %s", strerror(-ret));
+        }
+    } else {
+        ret = magic_dataplane_exec_cmd(cmd);
+    }
     if (ret != 0) {
         fd_log_error("[dataplane] ✗ 创建路由表失败: %s", cmd);
         fd_log_error("[dataplane]   接口=%s, 网关=%s, 表=%u", 
@@ -326,8 +462,10 @@ static int create_route_table(LinkRouteConfig* link)
                      link->gateway_ip[0] ? link->gateway_ip : "无",
                      link->route_table_id);
         /* 检查接口状态 */
-        snprintf(cmd, sizeof(cmd), "ip link show %s 2>&1", link->interface_name);
-        magic_dataplane_exec_cmd(cmd);
+        if (!g_dp_nl) {
+            snprintf(cmd, sizeof(cmd), "ip link show %s 2>&1", link->interface_name);
+            magic_dataplane_exec_cmd(cmd);
+        }
         return -1;
     }
     
@@ -345,12 +483,9 @@ static int create_route_table(LinkRouteConfig* link)
  */
 static int delete_route_table(LinkRouteConfig* link)
 {
-    char cmd[MAX_CMD_LEN];
-    
     if (!link) return -1;
     
-    snprintf(cmd, sizeof(cmd), "ip route flush table %u 2>/dev/null", link->route_table_id);
-    magic_dataplane_exec_cmd(cmd);
+    dp_route_flush(link->route_table_id);
     
     link->is_configured = false;
     fd_log_notice("[dataplane] 删除路由表 %u: %s", link->route_table_id, link->link_id);
@@ -374,7 +509,7 @@ static int add_ip_rule(const char* client_ip, uint32_t table_id, uint32_t priori
              "ip rule add from %s lookup %u priority %u",
              client_ip, table_id, priority);
     
-    int ret = magic_dataplane_exec_cmd(cmd);
+    int ret = dp_rule(true, client_ip, 0, table_id, priority, cmd);
     if (ret != 0) {
         fd_log_error("[dataplane] 添加 ip rule 失败: from %s lookup %u", client_ip, table_id);
         return -1;
@@ -398,7 +533,7 @@ static int delete_ip_rule(const char* client_ip, uint32_t table_id)
              "ip rule del from %s lookup %u 2>/dev/null",
              client_ip, table_id);
     
-    int ret = magic_dataplane_exec_cmd(cmd);
+    int ret = dp_rule(false, client_ip, 0, table_id, 0, cmd);
     if (ret != 0) {
         fd_log_debug("[dataplane] 删除 ip rule 失败 (可能不存在): from %s lookup %u", 
                      client_ip, table_id);
@@ -434,16 +569,21 @@ static int init_fwmark_rules(DataplaneContext* ctx)
     fd_log_notice("[dataplane] 初始化 fwmark 策略路由规则 (ARINC 839 合规)...");
     
     /* 清理可能存在的旧 fwmark 规则 */
-    for (uint32_t mark = MAGIC_FWMARK_BLACKHOLE; mark <= MAGIC_RT_TABLE_MAX; mark++) {
-        snprintf(cmd, sizeof(cmd), "ip rule del fwmark %u 2>/dev/null", mark);
-        magic_dataplane_exec_cmd(cmd);
+    if (g_dp_nl) {
+        magic_dp_nl_rule_flush_fwmark(g_dp_nl, MAGIC_FWMARK_BLACKHOLE, MAGIC_RT_TABLE_MAX);
+    } else {
+        for (uint32_t mark = MAGIC_FWMARK_BLACKHOLE; mark <= MAGIC_RT_TABLE_MAX; mark++) {
+            snprintf(cmd, sizeof(cmd), "ip rule del fwmark %u 2>/dev/null", mark);
+            magic_dataplane_exec_cmd(cmd);
+        }
     }
     
     /* 创建黑洞路由表 */
-    snprintf(cmd, sizeof(cmd), "ip route flush table %d 2>/dev/null", MAGIC_BLACKHOLE_TABLE);
-    magic_dataplane_exec_cmd(cmd);
+    dp_route_flush(MAGIC_BLACKHOLE_TABLE);
     snprintf(cmd, sizeof(cmd), "ip route add blackhole default table %d", MAGIC_BLACKHOLE_TABLE);
-    if (magic_dataplane_exec_cmd(cmd) != 0) {
+    int ret = g_dp_nl ? magic_dp_nl_route_blackhole(g_dp_nl, MAGIC_BLACKHOLE_TABLE)
+                      : magic_dataplane_exec_cmd(cmd);
+    if (ret != 0) {
         fd_log_error("[dataplane] 创建黑洞路由表失败");
         return -1;
     }
@@ -453,7 +593,8 @@ static int init_fwmark_rules(DataplaneContext* ctx)
     snprintf(cmd, sizeof(cmd), 
              "ip rule add fwmark %d lookup %d priority %d",
              MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY);
-    magic_dataplane_exec_cmd(cmd);
+    dp_rule(true, NULL, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_TABLE,
+            MAGIC_BLACKHOLE_PRIORITY, cmd);
     fd_log_notice("[dataplane] ✓ fwmark %d → blackhole", MAGIC_BLACKHOLE_TABLE);
     
     /* 预创建链路 fwmark 规则 (100-109) */
@@ -462,7 +603,7 @@ static int init_fwmark_rules(DataplaneContext* ctx)
         snprintf(cmd, sizeof(cmd),
                  "ip rule add fwmark %u lookup %u priority %u",
                  mark, mark, mark);
-        if (magic_dataplane_exec_cmd(cmd) == 0) {
+        if (dp_rule(true, NULL, mark, mark, mark, cmd) == 0) {
             fd_log_notice("[dataplane] ✓ fwmark %u → table %u", mark, mark);
         }
     }
@@ -567,7 +708,7 @@ static int remove_blackhole_rule(const char* client_ip, const char* gateway_ip)
     snprintf(cmd, sizeof(cmd),
              "ip rule del from %s lookup %d priority %d 2>/dev/null",
              client_ip, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY);
-    magic_dataplane_exec_cmd(cmd);
+    dp_rule(false, client_ip, 0, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY, cmd);
     
     /* 不再在这里清理 iptables 规则，避免删除其他会话的 TFT 规则 */
     
@@ -692,7 +833,7 @@ static int add_blackhole_rule(const char* client_ip, const char* gateway_ip)
              "ip rule add from %s lookup %d priority %d",
              client_ip, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY);
     
-    int ret = magic_dataplane_exec_cmd(cmd);
+    int ret = dp_rule(true, client_ip, 0, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY, cmd);
     if (ret != 0) {
         fd_log_error("[dataplane] 添加黑洞规则失败: %s", client_ip);
         return -1;
@@ -712,7 +853,8 @@ static int add_blackhole_rule(const char* client_ip, const char* gateway_ip)
 
 int magic_dataplane_init(DataplaneContext* ctx, 
                          const char* ingress_if, 
-                         const char* ingress_ip)
+                         const char* ingress_ip,
+                         DataplaneBackend backend)
 {
     if (!ctx) {
         fd_log_error("[dataplane] 上下文指针为空");
@@ -743,6 +885,20 @@ int magic_dataplane_init(DataplaneContext* ctx,
     ctx->is_initialized = true;
     ctx->enable_routing = true;
     
+    /* === 选择下发后端: 路由/规则/ipset/conntrack 走 netlink 或命令行 === */
+    ctx->backend = DATAPLANE_BACKEND_EXEC;
+    g_dp_nl = NULL;
+    if (backend != DATAPLANE_BACKEND_EXEC) {
+        if (magic_dp_nl_open(&ctx->nl) == 0) {
+            ctx->backend = DATAPLANE_BACKEND_NETLINK;
+            g_dp_nl = &ctx->nl;
+        } else if (backend == DATAPLANE_BACKEND_NETLINK) {
+            fd_log_error("[dataplane] ✗ netlink 后端不可用，回退到命令行");
+        }
+    }
+    fd_log_notice("[dataplane] 下发后端: %s (配置: %s)",
+                  backend_name(ctx->backend), backend_name(backend));
+    
     /* === 第一步：初始化 fwmark 静态路由规则 (ARINC 839 合规) === */
     fd_log_notice("[dataplane] [ARINC 839] 初始化 Mark Based Routing...");
     init_fwmark_rules(ctx);
@@ -757,22 +913,35 @@ int magic_dataplane_init(DataplaneContext* ctx,
     magic_dataplane_exec_cmd("iptables-save | grep -v '192\\.168\\.126\\.' | iptables-restore 2>/dev/null || true");
     
     /* 清理所有客户端 IP 的策略路由规则 */
-    for (int i = 5; i <= 254; i++) {
-        char client_ip[32];
-        char cmd[MAX_CMD_LEN];
-        snprintf(client_ip, sizeof(client_ip), "192.168.126.%d", i);
-        /* 删除可能存在的策略路由规则 */
-        snprintf(cmd, sizeof(cmd), "ip rule del from %s 2>/dev/null || true", client_ip);
-        magic_dataplane_exec_cmd(cmd);
-        /* 删除黑洞规则 */
-        snprintf(cmd, sizeof(cmd), 
-                 "ip rule del from %s lookup %d priority %d 2>/dev/null || true",
-                 client_ip, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY);
-        magic_dataplane_exec_cmd(cmd);
+    if (g_dp_nl) {
+        /* 一次 dump 找出本模块残留的客户端规则和黑洞规则后批量删除，
+         * 其他优先级的规则 (管理员手工配置) 保持不动 */
+        int removed = magic_dp_nl_rule_flush_src(g_dp_nl, "192.168.126.0/24",
+                                                 MAGIC_RULE_PRIORITY_BASE,
+                                                 MAGIC_RULE_PRIORITY_MAX);
+        int removed_bh = magic_dp_nl_rule_flush_src(g_dp_nl, "192.168.126.0/24",
+                                                    MAGIC_BLACKHOLE_PRIORITY,
+                                                    MAGIC_BLACKHOLE_PRIORITY);
+        fd_log_notice("[dataplane] 删除残留 ip rule: %d 条",
+                      (removed > 0 ? removed : 0) + (removed_bh > 0 ? removed_bh : 0));
+    } else {
+        for (int i = 5; i <= 254; i++) {
+            char client_ip[32];
+            char cmd[MAX_CMD_LEN];
+            snprintf(client_ip, sizeof(client_ip), "192.168.126.%d", i);
+            /* 删除可能存在的策略路由规则 */
+            snprintf(cmd, sizeof(cmd), "ip rule del from %s 2>/dev/null || true", client_ip);
+            magic_dataplane_exec_cmd(cmd);
+            /* 删除黑洞规则 */
+            snprintf(cmd, sizeof(cmd), 
+                     "ip rule del from %s lookup %d priority %d 2>/dev/null || true",
+                     client_ip, MAGIC_BLACKHOLE_TABLE, MAGIC_BLACKHOLE_PRIORITY);
+            magic_dataplane_exec_cmd(cmd);
+        }
     }
     
     /* 清理所有客户端 IP 的连接跟踪条目 */
-    magic_dataplane_exec_cmd("conntrack -D -s 192.168.126.0/24 2>/dev/null || true");
+    dp_conntrack_flush("192.168.126.0/24");
     
     fd_log_notice("[dataplane] ✓ 客户端网段残留规则已清理");
     
@@ -868,6 +1037,7 @@ int magic_dataplane_init(DataplaneContext* ctx,
     fd_log_notice("[dataplane] MAGIC 数据平面初始化 (ARINC 839 合规)");
     fd_log_notice("[dataplane]   入口接口: %s", ingress_if ? ingress_if : "未指定");
     fd_log_notice("[dataplane]   入口 IP: %s", ingress_ip ? ingress_ip : "未指定");
+    fd_log_notice("[dataplane]   下发后端: %s", backend_name(ctx->backend));
     fd_log_notice("[dataplane]   流量控制: mangle打标 + fwmark路由");
     fd_log_notice("[dataplane]   放行策略: 连接追踪 + TFT精确规则");
     fd_log_notice("[dataplane]   默认策略: 阻断 192.168.126.0/24");
@@ -1070,7 +1240,10 @@ int magic_dataplane_add_client_route(DataplaneContext* ctx,
     fd_log_notice("[dataplane] ✓ 客户端路由: %s → %s (table=%u, prio=%u, 流量已允许)",
                   client_ip, link_id, link->route_table_id, priority);
     
-    /* 打印诊断信息 - 验证路由配置 */
+    /* 打印诊断信息 - 验证路由配置 (需要 fork 三个 shell，netlink 后端下跳过) */
+    if (ctx->backend != DATAPLANE_BACKEND_EXEC) {
+        return 0;
+    }
     fd_log_notice("[dataplane] === 路由配置验证 ===");
     char diag_cmd[256];
     
@@ -1162,11 +1335,7 @@ int magic_dataplane_remove_client_route(DataplaneContext* ctx,
 
         /* 从 ipset 中删除客户端 (control/data) 并清理 conntrack 条目 */
         magic_dataplane_ipset_del(client_ip);
-        {
-            char cmd[MAX_CMD_LEN];
-            snprintf(cmd, sizeof(cmd), "conntrack -D -s %s 2>/dev/null", client_ip);
-            magic_dataplane_exec_cmd(cmd);
-        }
+        dp_conntrack_flush(client_ip);
     }
     
     return 0;
@@ -1364,6 +1533,7 @@ void magic_dataplane_print_status(DataplaneContext* ctx)
                   ctx->ingress_interface[0] ? ctx->ingress_interface : "未配置",
                   ctx->ingress_ip[0] ? ctx->ingress_ip : "无 IP");
     fd_log_notice("[dataplane] 路由功能: %s", ctx->enable_routing ? "启用" : "禁用");
+    fd_log_notice("[dataplane] 下发后端: %s", backend_name(ctx->backend));
     fd_log_notice("[dataplane] fwmark规则: %s", ctx->fwmark_rules_installed ? "已安装" : "未安装");
     
     fd_log_notice("[dataplane] ─────────────────────────────────────");
@@ -1456,10 +1626,14 @@ void magic_dataplane_cleanup(DataplaneContext* ctx)
     
     /* 删除 fwmark 路由规则 */
     if (ctx->fwmark_rules_installed) {
-        char cmd[MAX_CMD_LEN];
-        for (uint32_t mark = MAGIC_FWMARK_BLACKHOLE; mark <= MAGIC_RT_TABLE_MAX; mark++) {
-            snprintf(cmd, sizeof(cmd), "ip rule del fwmark %u 2>/dev/null", mark);
-            magic_dataplane_exec_cmd(cmd);
+        if (g_dp_nl) {
+            magic_dp_nl_rule_flush_fwmark(g_dp_nl, MAGIC_FWMARK_BLACKHOLE, MAGIC_RT_TABLE_MAX);
+        } else {
+            char cmd[MAX_CMD_LEN];
+            for (uint32_t mark = MAGIC_FWMARK_BLACKHOLE; mark <= MAGIC_RT_TABLE_MAX; mark++) {
+                snprintf(cmd, sizeof(cmd), "ip rule del fwmark %u 2>/dev/null", mark);
+                magic_dataplane_exec_cmd(cmd);
+            }
         }
         ctx->fwmark_rules_installed = false;
     }
@@ -1478,6 +1652,12 @@ void magic_dataplane_cleanup(DataplaneContext* ctx)
     /* 销毁 ipset 集合 (如果存在) */
     magic_dataplane_ipset_destroy(ctx);
 
+    if (ctx->backend == DATAPLANE_BACKEND_NETLINK) {
+        g_dp_nl = NULL;
+        magic_dp_nl_close(&ctx->nl);
+        ctx->backend = DATAPLANE_BACKEND_EXEC;
+    }
+
     pthread_mutex_destroy(&ctx->mutex);
     
     fd_log_notice("[dataplane] ✓ 数据平面已清理");
@@ -1723,9 +1903,7 @@ int magic_dataplane_remove_tft_rules(DataplaneContext* ctx, const char* session_
         magic_dataplane_ipset_del(client_ip);
         
         /* 清理 conntrack */
-        char cmd[MAX_CMD_LEN];
-        snprintf(cmd, sizeof(cmd), "conntrack -D -s %s 2>/dev/null", client_ip);
-        magic_dataplane_exec_cmd(cmd);
+        dp_conntrack_flush(client_ip);
     }
     
     fd_log_notice("[dataplane] ✓ 删除会话 %s 的 %d 条 TFT 规则", session_id, removed);
@@ -1758,127 +1936,432 @@ int magic_dataplane_find_tft_rules(DataplaneContext* ctx,
     return found;
 }
 
+/*===========================================================================
+ * 数据平面事务 (批量原子切换)
+ *===========================================================================*/
+
+#define DP_TXN_INITIAL_ENTRIES 16  /* 事务切换项初始容量 */
+#define DP_RESTORE_INITIAL 4096    /* iptables-restore 输入初始大小 */
+
 /**
- * @brief 切换会话的 TFT 规则到新链路
- * 通过修改 mangle 表的 fwmark 实现精确的流量切换
+ * @brief iptables-restore 输入缓冲区 (按需扩容)
  */
-int magic_dataplane_switch_tft_link(DataplaneContext* ctx,
-                                    const char* session_id,
-                                    const char* new_link_id)
+typedef struct {
+    char* buf;
+    size_t len;
+    size_t cap;
+    bool oom;
+} RestoreBuf;
+
+static void restore_appendf(RestoreBuf* rb, const char* fmt, ...)
 {
-    if (!ctx || !ctx->is_initialized || !session_id || !new_link_id) {
+    while (!rb->oom) {
+        size_t avail = rb->cap - rb->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(rb->buf ? rb->buf + rb->len : NULL, avail, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            rb->oom = true;
+            return;
+        }
+        if ((size_t)n < avail) {
+            rb->len += (size_t)n;
+            return;
+        }
+
+        size_t cap = rb->cap ? rb->cap : DP_RESTORE_INITIAL;
+        while (cap < rb->len + (size_t)n + 1) cap *= 2;
+        char* p = realloc(rb->buf, cap);
+        if (!p) {
+            rb->oom = true;
+            return;
+        }
+        rb->buf = p;
+        rb->cap = cap;
+    }
+}
+
+/**
+ * @brief 追加一条 mangle PREROUTING 打标规则 (iptables-restore 语法)
+ * 匹配条件与 magic_dataplane_add_tft_rule 下发的规则一致
+ *
+ * @param op 'I'=插入, 'D'=删除
+ */
+static void restore_append_tft_mark(RestoreBuf* rb, char op,
+                                    const TftTuple* tuple, uint32_t fwmark)
+{
+    const char* proto_str = NULL;
+    switch (tuple->protocol) {
+        case 6:  proto_str = "tcp"; break;
+        case 17: proto_str = "udp"; break;
+        case 1:  proto_str = "icmp"; break;
+        default: proto_str = NULL; break;
+    }
+
+    restore_appendf(rb, "-%c PREROUTING -s %s -d %s", op, tuple->src_ip, tuple->dst_ip);
+    if (proto_str) {
+        restore_appendf(rb, " -p %s", proto_str);
+        if (tuple->src_port > 0) restore_appendf(rb, " --sport %u", tuple->src_port);
+        if (tuple->dst_port > 0) restore_appendf(rb, " --dport %u", tuple->dst_port);
+    }
+    restore_appendf(rb, " -j MARK --set-mark %u\n", fwmark);
+}
+
+/**
+ * @brief 把 len 字节完整写入 fd (处理部分写入与 EINTR)
+ * @return 0=成功, -1=失败 (errno 有效)
+ */
+static int write_all(int fd, const char* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 以 iptables-restore --noflush 一次性提交 rb 中的 mangle 规则
+ * 输入经管道直接写给 iptables-restore，不落盘；调用方不得持有 ctx->mutex。
+ * 写入期间本线程屏蔽 SIGPIPE，对端提前退出时只得到 EPIPE。
+ * 内核对整张表原子替换，失败时不生效任何一条。
+ *
+ * @return 0=成功, -1=失败
+ */
+static int run_mangle_restore(const RestoreBuf* rb)
+{
+    static const char head[] = "*mangle\n";
+    static const char tail[] = "COMMIT\n";
+    char* argv[] = {(char*)"iptables-restore", (char*)"--noflush", NULL};
+
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) != 0) {
+        fd_log_error("[dataplane] 创建 iptables-restore 管道失败: %s", strerror(errno));
         return -1;
     }
-    
-    pthread_mutex_lock(&ctx->mutex);
-    
-    /* 查找新链路 */
-    LinkRouteConfig* new_link = find_link_config(ctx, new_link_id);
-    if (!new_link) {
-        fd_log_error("[dataplane] 新链路未注册: %s", new_link_id);
-        pthread_mutex_unlock(&ctx->mutex);
+
+    /* dup2 到子进程 stdin 时清除 O_CLOEXEC，其余管道端在 exec 时关闭 */
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pfd[0], STDIN_FILENO);
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pfd[0]);
+    if (err != 0) {
+        fd_log_error("[dataplane] 启动 iptables-restore 失败: %s", strerror(err));
+        close(pfd[1]);
         return -1;
     }
-    
-    uint32_t new_fwmark = new_link->fwmark;
-    int switched = 0;
-    
-    for (uint32_t i = 0; i < MAX_TFT_RULES; i++) {
-        TftRule* rule = &ctx->tft_rules[i];
-        if (!rule->in_use) continue;
-        if (strcmp(rule->session_id, session_id) != 0) continue;
-        
-        /* 如果已经是同一链路，跳过 */
-        if (strcmp(rule->link_id, new_link_id) == 0) {
-            continue;
+
+    fd_log_debug("[dataplane] 执行命令: iptables-restore --noflush (%zu 字节)",
+                 rb->len + sizeof(head) + sizeof(tail) - 2);
+
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+    bool ok = write_all(pfd[1], head, sizeof(head) - 1) == 0 &&
+              write_all(pfd[1], rb->buf, rb->len) == 0 &&
+              write_all(pfd[1], tail, sizeof(tail) - 1) == 0;
+    int write_err = errno;
+    close(pfd[1]);
+
+    /* 丢弃写入失败在本线程挂起的 SIGPIPE，再恢复信号掩码 */
+    if (!ok && !sigismember(&old_set, SIGPIPE)) {
+        struct timespec zero = {0, 0};
+        while (sigtimedwait(&pipe_set, NULL, &zero) > 0) {
         }
-        
-        uint32_t old_fwmark = rule->fwmark;
-        
-        /* 构建协议字符串 */
-        const char* proto_str = NULL;
-        switch (rule->tuple.protocol) {
-            case 6:  proto_str = "tcp"; break;
-            case 17: proto_str = "udp"; break;
-            case 1:  proto_str = "icmp"; break;
-            default: proto_str = NULL; break;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    int status = 0;
+    pid_t waited;
+    while ((waited = waitpid(pid, &status, 0)) < 0 && errno == EINTR) {
+    }
+    if (waited < 0) {
+        fd_log_error("[dataplane] 等待 iptables-restore 失败: %s", strerror(errno));
+        return -1;
+    }
+    if (!ok) {
+        fd_log_error("[dataplane] 写入 iptables-restore 失败: %s", strerror(write_err));
+        return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fd_log_error("[dataplane] iptables-restore 执行失败 (status=0x%x)", status);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 事务中的一条 TFT 规则改写 (提交前在锁内记录)
+ */
+typedef struct {
+    uint32_t rule;        /* ctx->tft_rules 下标 */
+    uint32_t entry;       /* txn->entries 下标 */
+    TftTuple tuple;       /* 规则五元组快照 */
+    time_t created_at;    /* 规则创建时间 (识别被删除后重建的槽位) */
+    uint32_t old_fwmark;
+    uint32_t new_fwmark;
+} TxnRuleChange;
+
+static bool tft_tuple_equal(const TftTuple* a, const TftTuple* b)
+{
+    return strcmp(a->src_ip, b->src_ip) == 0 &&
+           strcmp(a->dst_ip, b->dst_ip) == 0 &&
+           a->src_port == b->src_port && a->dst_port == b->dst_port &&
+           a->protocol == b->protocol;
+}
+
+/**
+ * @brief 记录事务全部会话的规则改写并生成 iptables-restore 输入
+ * (调用方持有 ctx->mutex)。entries[i].switched 置为该会话的改写规则数。
+ *
+ * @param[out] changes 规则改写列表 (调用方释放)
+ * @param[out] nchanges 规则改写数
+ * @return 0=成功, -1=目标链路未注册或内存不足 (整个事务放弃)
+ */
+static int txn_plan(DataplaneContext* ctx, DataplaneTxn* txn, RestoreBuf* rb,
+                    TxnRuleChange** changes, uint32_t* nchanges)
+{
+    uint32_t cap = 0;
+
+    for (uint32_t e = 0; e < txn->count; e++) {
+        DataplaneTxnEntry* entry = &txn->entries[e];
+        LinkRouteConfig* new_link = find_link_config(ctx, entry->new_link_id);
+        if (!new_link) {
+            fd_log_error("[dataplane] 新链路未注册: %s (会话 %s)",
+                         entry->new_link_id, entry->session_id);
+            return -1;
         }
-        
-        char del_cmd[MAX_CMD_LEN];
-        char add_cmd[MAX_CMD_LEN];
-        
-        /* 删除旧的 mangle 规则，添加新的 mangle 规则 */
-        if (proto_str && rule->tuple.src_port > 0 && rule->tuple.dst_port > 0) {
-            snprintf(del_cmd, sizeof(del_cmd),
-                     "iptables -t mangle -D PREROUTING -s %s -d %s -p %s --sport %u --dport %u -j MARK --set-mark %u 2>/dev/null",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str,
-                     rule->tuple.src_port, rule->tuple.dst_port, old_fwmark);
-            snprintf(add_cmd, sizeof(add_cmd),
-                     "iptables -t mangle -I PREROUTING -s %s -d %s -p %s --sport %u --dport %u -j MARK --set-mark %u",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str,
-                     rule->tuple.src_port, rule->tuple.dst_port, new_fwmark);
-        } else if (proto_str && rule->tuple.dst_port > 0) {
-            snprintf(del_cmd, sizeof(del_cmd),
-                     "iptables -t mangle -D PREROUTING -s %s -d %s -p %s --dport %u -j MARK --set-mark %u 2>/dev/null",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str,
-                     rule->tuple.dst_port, old_fwmark);
-            snprintf(add_cmd, sizeof(add_cmd),
-                     "iptables -t mangle -I PREROUTING -s %s -d %s -p %s --dport %u -j MARK --set-mark %u",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str,
-                     rule->tuple.dst_port, new_fwmark);
-        } else if (proto_str && rule->tuple.src_port > 0) {
-            snprintf(del_cmd, sizeof(del_cmd),
-                     "iptables -t mangle -D PREROUTING -s %s -d %s -p %s --sport %u -j MARK --set-mark %u 2>/dev/null",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str,
-                     rule->tuple.src_port, old_fwmark);
-            snprintf(add_cmd, sizeof(add_cmd),
-                     "iptables -t mangle -I PREROUTING -s %s -d %s -p %s --sport %u -j MARK --set-mark %u",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str,
-                     rule->tuple.src_port, new_fwmark);
-        } else if (proto_str) {
-            snprintf(del_cmd, sizeof(del_cmd),
-                     "iptables -t mangle -D PREROUTING -s %s -d %s -p %s -j MARK --set-mark %u 2>/dev/null",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str, old_fwmark);
-            snprintf(add_cmd, sizeof(add_cmd),
-                     "iptables -t mangle -I PREROUTING -s %s -d %s -p %s -j MARK --set-mark %u",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, proto_str, new_fwmark);
-        } else {
-            snprintf(del_cmd, sizeof(del_cmd),
-                     "iptables -t mangle -D PREROUTING -s %s -d %s -j MARK --set-mark %u 2>/dev/null",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, old_fwmark);
-            snprintf(add_cmd, sizeof(add_cmd),
-                     "iptables -t mangle -I PREROUTING -s %s -d %s -j MARK --set-mark %u",
-                     rule->tuple.src_ip, rule->tuple.dst_ip, new_fwmark);
+
+        entry->switched = 0;
+        for (uint32_t i = 0; i < MAX_TFT_RULES; i++) {
+            TftRule* rule = &ctx->tft_rules[i];
+            if (!rule->in_use) continue;
+            if (strcmp(rule->session_id, entry->session_id) != 0) continue;
+            if (strcmp(rule->link_id, entry->new_link_id) == 0) continue;
+
+            if (*nchanges == cap) {
+                cap = cap ? cap * 2 : DP_TXN_INITIAL_ENTRIES;
+                TxnRuleChange* p = realloc(*changes, cap * sizeof(*p));
+                if (!p) {
+                    return -1;
+                }
+                *changes = p;
+            }
+            TxnRuleChange* c = &(*changes)[(*nchanges)++];
+            c->rule = i;
+            c->entry = e;
+            c->tuple = rule->tuple;
+            c->created_at = rule->created_at;
+            c->old_fwmark = rule->fwmark;
+            c->new_fwmark = new_link->fwmark;
+
+            restore_append_tft_mark(rb, 'D', &rule->tuple, rule->fwmark);
+            restore_append_tft_mark(rb, 'I', &rule->tuple, new_link->fwmark);
+            entry->switched++;
         }
-        
-        /* 执行删除和添加 */
-        magic_dataplane_exec_cmd(del_cmd);
-        int ret = magic_dataplane_exec_cmd(add_cmd);
-        
-        if (ret == 0) {
-            /* 更新规则记录 */
-            strncpy(rule->link_id, new_link_id, MAX_LINK_ID_LEN - 1);
-            rule->fwmark = new_fwmark;
-            switched++;
-            
-            fd_log_notice("[dataplane] ✓ TFT 切换: %s:%u → %s:%u (fwmark %u→%u, link=%s)",
-                          rule->tuple.src_ip, rule->tuple.src_port,
-                          rule->tuple.dst_ip, rule->tuple.dst_port,
-                          old_fwmark, new_fwmark, new_link_id);
-        } else {
-            fd_log_error("[dataplane] ✗ TFT 切换失败: %s → %s",
-                         rule->tuple.src_ip, rule->tuple.dst_ip);
+    }
+    return rb->oom ? -1 : 0;
+}
+
+/**
+ * @brief 提交成功后更新一条规则记录 (调用方持有 ctx->mutex)
+ * 提交期间 (未持锁) 规则已被删除时，删除方的 -D 旧 mark 未命中，
+ * 把新插入的规则记入 stale 由调用方撤掉
+ */
+static void txn_change_apply(DataplaneContext* ctx, const DataplaneTxn* txn,
+                             const TxnRuleChange* c, RestoreBuf* stale)
+{
+    const DataplaneTxnEntry* entry = &txn->entries[c->entry];
+    TftRule* rule = &ctx->tft_rules[c->rule];
+
+    if (!rule->in_use || rule->fwmark != c->old_fwmark ||
+        rule->created_at != c->created_at ||
+        strcmp(rule->session_id, entry->session_id) != 0 ||
+        !tft_tuple_equal(&rule->tuple, &c->tuple)) {
+        restore_append_tft_mark(stale, 'D', &c->tuple, c->new_fwmark);
+        return;
+    }
+
+    fd_log_debug("[dataplane] ✓ TFT 切换: %s:%u → %s:%u (fwmark %u→%u, link=%s)",
+                 rule->tuple.src_ip, rule->tuple.src_port,
+                 rule->tuple.dst_ip, rule->tuple.dst_port,
+                 rule->fwmark, c->new_fwmark, entry->new_link_id);
+
+    strncpy(rule->link_id, entry->new_link_id, MAX_LINK_ID_LEN - 1);
+    rule->link_id[MAX_LINK_ID_LEN - 1] = '\0';
+    rule->fwmark = c->new_fwmark;
+}
+
+int magic_dataplane_txn_begin(DataplaneContext* ctx, DataplaneTxn* txn)
+{
+    if (!ctx || !ctx->is_initialized || !txn) {
+        return -1;
+    }
+
+    memset(txn, 0, sizeof(*txn));
+    txn->ctx = ctx;
+    return 0;
+}
+
+int magic_dataplane_txn_switch_session(DataplaneTxn* txn,
+                                       const char* session_id,
+                                       const char* new_link_id)
+{
+    if (!txn || !txn->ctx || txn->committed || !session_id || !new_link_id) {
+        return -1;
+    }
+
+    DataplaneTxnEntry* entry = NULL;
+    for (uint32_t i = 0; i < txn->count; i++) {
+        if (strcmp(txn->entries[i].session_id, session_id) == 0) {
+            entry = &txn->entries[i];
+            break;
         }
     }
-    
+
+    if (!entry) {
+        if (txn->count == txn->capacity) {
+            uint32_t cap = txn->capacity ? txn->capacity * 2 : DP_TXN_INITIAL_ENTRIES;
+            DataplaneTxnEntry* p = realloc(txn->entries, cap * sizeof(*p));
+            if (!p) {
+                txn->failed = true;
+                return -1;
+            }
+            txn->entries = p;
+            txn->capacity = cap;
+        }
+        entry = &txn->entries[txn->count++];
+        memset(entry, 0, sizeof(*entry));
+        strncpy(entry->session_id, session_id, sizeof(entry->session_id) - 1);
+    }
+
+    strncpy(entry->new_link_id, new_link_id, sizeof(entry->new_link_id) - 1);
+    entry->new_link_id[sizeof(entry->new_link_id) - 1] = '\0';
+    return 0;
+}
+
+int magic_dataplane_txn_commit(DataplaneTxn* txn)
+{
+    if (!txn || !txn->ctx || txn->committed) {
+        return -1;
+    }
+    txn->committed = true;
+
+    if (txn->failed) {
+        fd_log_error("[dataplane] ✗ 事务登记不完整，放弃提交 (%u 个会话)", txn->count);
+        for (uint32_t i = 0; i < txn->count; i++) txn->entries[i].switched = -1;
+        return -1;
+    }
+    if (txn->count == 0) {
+        return 0;
+    }
+
+    DataplaneContext* ctx = txn->ctx;
+    RestoreBuf rb = {0};
+    RestoreBuf stale = {0};
+    TxnRuleChange* changes = NULL;
+    uint32_t nchanges = 0;
+
+    /* 1. 锁内记录全部会话的规则改写 */
+    pthread_mutex_lock(&ctx->mutex);
+    int ret = txn_plan(ctx, txn, &rb, &changes, &nchanges);
     pthread_mutex_unlock(&ctx->mutex);
-    
+
+    /* 2. 不持锁执行一次 iptables-restore: 全部生效或全部不生效 */
+    if (ret == 0 && nchanges > 0) {
+        ret = run_mangle_restore(&rb);
+    }
+    if (ret != 0) {
+        fd_log_error("[dataplane] ✗ 事务提交失败，%u 个会话保持原规则 (%u 条规则)",
+                     txn->count, nchanges);
+        for (uint32_t i = 0; i < txn->count; i++) txn->entries[i].switched = -1;
+        free(changes);
+        free(rb.buf);
+        return -1;
+    }
+
+    /* 3. 锁内更新规则记录 */
+    pthread_mutex_lock(&ctx->mutex);
+    for (uint32_t i = 0; i < nchanges; i++) {
+        txn_change_apply(ctx, txn, &changes[i], &stale);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+
+    if (stale.len > 0 && (stale.oom || run_mangle_restore(&stale) != 0)) {
+        fd_log_notice("[dataplane] ⚠ 撤销提交期间已删除会话的打标规则失败");
+    }
+
+    fd_log_notice("[dataplane] ✓ 事务提交: %u 个会话, 切换 %u 条 TFT 规则",
+                  txn->count, nchanges);
+    free(stale.buf);
+    free(changes);
+    free(rb.buf);
+    return (int)nchanges;
+}
+
+/**
+ * @brief 查询事务中某会话的提交结果
+ */
+int magic_dataplane_txn_result(const DataplaneTxn* txn, const char* session_id)
+{
+    if (!txn || !txn->committed || !session_id) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < txn->count; i++) {
+        if (strcmp(txn->entries[i].session_id, session_id) == 0) {
+            return txn->entries[i].switched;
+        }
+    }
+    return -1;
+}
+
+void magic_dataplane_txn_release(DataplaneTxn* txn)
+{
+    if (!txn) {
+        return;
+    }
+    free(txn->entries);
+    memset(txn, 0, sizeof(*txn));
+}
+
+/**
+ * @brief 切换会话的 TFT 规则到新链路
+ * 通过修改 mangle 表的 fwmark 实现精确的流量切换；单会话事务，
+ * 该会话的全部规则在同一次 iptables-restore 中原子改写
+ */
+int magic_dataplane_switch_tft_link(DataplaneContext* ctx,
+                                    const char* session_id,
+                                    const char* new_link_id)
+{
+    DataplaneTxn txn;
+    if (!session_id || !new_link_id || magic_dataplane_txn_begin(ctx, &txn) != 0) {
+        return -1;
+    }
+
+    int switched = -1;
+    if (magic_dataplane_txn_switch_session(&txn, session_id, new_link_id) == 0 &&
+        magic_dataplane_txn_commit(&txn) >= 0) {
+        switched = txn.entries[0].switched;
+    }
+    magic_dataplane_txn_release(&txn);
+
     if (switched > 0) {
         fd_log_notice("[dataplane] ✓ 会话 %s 切换 %d 条 TFT 规则到 %s",
                       session_id, switched, new_link_id);
     } else {
         fd_log_notice("[dataplane] ⚠ 会话 %s 无 TFT 规则需要切换", session_id);
     }
-    
+
     return switched > 0 ? 0 : -1;
 }
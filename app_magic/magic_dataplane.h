@@ -41,6 +41,7 @@
 #ifndef MAGIC_DATAPLANE_H
 #define MAGIC_DATAPLANE_H
 
+#include "magic_dataplane_nl.h"
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -73,6 +74,20 @@
 #define MAX_LINK_ID_LEN 64 /* 链路 ID 最大长度 */
 #define MAX_CMD_LEN 512    /* 命令字符串最大长度 */
 
+/*===========================================================================
+ * 下发后端
+ *===========================================================================*/
+
+/**
+ * @brief 数据平面下发后端
+ * 路由/策略规则/ipset/conntrack 的下发方式；iptables 规则始终走命令行
+ */
+typedef enum {
+  DATAPLANE_BACKEND_EXEC = 0,    ///< fork/exec ip、ipset、conntrack 命令。
+  DATAPLANE_BACKEND_NETLINK = 1, ///< rtnetlink/nfnetlink 直接下发。
+  DATAPLANE_BACKEND_AUTO = 2     ///< netlink 可用则使用，否则回退命令行。
+} DataplaneBackend;
+
 /*===========================================================================
  * TFT (Traffic Flow Template) 数据结构
  * 符合 ARINC 839 规范的五元组流量控制
@@ -158,6 +173,10 @@ typedef struct {
   TftRule tft_rules[MAX_TFT_RULES]; /* TFT 规则数组 */
   uint32_t num_tft_rules;           /* 活动 TFT 规则数量 */
 
+  /* 下发后端 */
+  DataplaneBackend backend; /* 实际生效的后端 (EXEC / NETLINK) */
+  DataplaneNetlink nl;      /* netlink 套接字 (backend=NETLINK 时有效) */
+
   /* 同步锁 */
   pthread_mutex_t mutex; /* 保护规则数组的互斥锁 */
 
@@ -177,10 +196,11 @@ typedef struct {
  * @param ctx 数据平面上下文指针
  * @param ingress_if 入口接口名称 (如 "ens39")
  * @param ingress_ip 入口接口 IP (如 "192.168.126.1")
+ * @param backend 下发后端 (AUTO 时探测 netlink)
  * @return 0=成功, -1=失败
  */
 int magic_dataplane_init(DataplaneContext *ctx, const char *ingress_if,
-                         const char *ingress_ip);
+                         const char *ingress_ip, DataplaneBackend backend);
 
 /**
  * @brief 注册数据链路
@@ -348,12 +368,107 @@ int magic_dataplane_find_tft_rules(DataplaneContext *ctx,
  * @return 0=成功, -1=失败
  *
  * @note 此函数通过修改 mangle 表的 fwmark 实现精确的流量切换，
- *       不影响同一源IP的其他会话
+ *       不影响同一源IP的其他会话；等价于只含一个会话的数据平面事务，
+ *       该会话的全部规则原子改写
  */
 int magic_dataplane_switch_tft_link(DataplaneContext *ctx,
                                     const char *session_id,
                                     const char *new_link_id);
 
+/*===========================================================================
+ * 数据平面事务 API - 批量切换
+ *
+ * 链路中断等场景下需要一次迁移大量会话。事务先收集各会话的目标链路，
+ * 提交时把全部 TFT 打标规则的改写 (-D 旧 mark / -I 新 mark) 拼成一份
+ * iptables-restore --noflush 输入，一次执行、由内核整表原子替换:
+ * 要么全部生效，要么全部不生效，任何报文都不会看到半切换的规则集。
+ *
+ * 提交失败 (目标链路未注册、个别旧规则已被外部删除等) 时整个事务不生效，
+ * 全部会话的规则及内存记录保持原状，由调用方整体回滚。
+ *
+ * 提交时先在 ctx->mutex 内记录改写，iptables-restore 执行期间释放锁，
+ * 完成后再加锁更新内存记录；其间被删除的规则会撤掉新插入的打标规则。
+ *
+ * 用法:
+ *   DataplaneTxn txn;
+ *   magic_dataplane_txn_begin(ctx, &txn);
+ *   magic_dataplane_txn_switch_session(&txn, "sess-1", "CELLULAR");
+ *   magic_dataplane_txn_switch_session(&txn, "sess-2", "CELLULAR");
+ *   magic_dataplane_txn_commit(&txn);
+ *   magic_dataplane_txn_release(&txn);  // 未提交即释放等价于放弃
+ *
+ * 事务本身不持有 ctx 锁，规则在提交时才解析，可跨越耗时操作 (MIH 请求)。
+ *===========================================================================*/
+
+/**
+ * @brief 事务内的会话切换项
+ */
+typedef struct {
+  char session_id[64];               ///< 会话 ID。
+  char new_link_id[MAX_LINK_ID_LEN]; ///< 目标链路 ID。
+  int switched;                      ///< 提交结果: 切换的规则数, -1=失败。
+} DataplaneTxnEntry;
+
+/**
+ * @brief 数据平面事务
+ */
+typedef struct {
+  DataplaneContext *ctx;      ///< 所属数据平面上下文。
+  DataplaneTxnEntry *entries; ///< 会话切换项 (按需扩容)。
+  uint32_t count;             ///< 切换项数量。
+  uint32_t capacity;          ///< 切换项容量。
+  bool failed;                ///< 登记失败 (内存不足), 提交时整体放弃。
+  bool committed;             ///< 是否已提交。
+} DataplaneTxn;
+
+/**
+ * @brief 开始一个数据平面事务
+ *
+ * @param ctx 数据平面上下文指针
+ * @param txn 事务对象 (调用方分配)
+ * @return 0=成功, -1=失败
+ */
+int magic_dataplane_txn_begin(DataplaneContext *ctx, DataplaneTxn *txn);
+
+/**
+ * @brief 在事务中登记会话切换
+ * 同一会话重复登记时以最后一次为准
+ *
+ * @param txn 事务对象
+ * @param session_id 会话 ID
+ * @param new_link_id 目标链路 ID
+ * @return 0=成功, -1=失败
+ */
+int magic_dataplane_txn_switch_session(DataplaneTxn *txn,
+                                       const char *session_id,
+                                       const char *new_link_id);
+
+/**
+ * @brief 提交事务 (全部生效或全部不生效)
+ * 各会话的结果写回 txn->entries[i].switched，释放前可读取
+ *
+ * @param txn 事务对象
+ * @return 切换的 TFT 规则总数 (>=0), -1=失败 (所有会话保持原规则)
+ */
+int magic_dataplane_txn_commit(DataplaneTxn *txn);
+
+/**
+ * @brief 查询已提交事务中某会话的结果
+ *
+ * @param txn 事务对象 (已提交、未释放)
+ * @param session_id 会话 ID
+ * @return 该会话切换的 TFT 规则数 (>=0), -1=失败或未登记
+ */
+int magic_dataplane_txn_result(const DataplaneTxn *txn,
+                               const char *session_id);
+
+/**
+ * @brief 释放事务 (未提交时不下发任何规则)
+ *
+ * @param txn 事务对象
+ */
+void magic_dataplane_txn_release(DataplaneTxn *txn);
+
 /**
  * @brief 打印数据平面状态
  * 打印当前所有链路和路由规则状态
@@ -423,6 +538,14 @@ int magic_dataplane_ipset_del(const char *client_ip);
  */
 int magic_dataplane_exec_cmd(const char *cmd);
 
+/**
+ * @brief 解析后端名称 ("exec" / "netlink" / "auto", 大小写不敏感)
+ *
+ * @param name 后端名称 (NULL 或无法识别时返回 AUTO)
+ * @return 对应的后端
+ */
+DataplaneBackend magic_dataplane_backend_from_string(const char *name);
+
 /**
  * @brief 检查接口是否存在
  *
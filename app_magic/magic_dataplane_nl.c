@@ -0,0 +1,1001 @@
+/**
+ * @file magic_dataplane_nl.c
+ * @brief MAGIC 数据平面 netlink 后端实现
+ * @description 不依赖 libmnl / libnl，直接组装 netlink 消息:
+ * - 单条请求: 发送带 NLM_F_ACK 的消息，等待对应序号的 NLMSG_ERROR
+ * - 批量删除: dump 收集匹配项 → 拼接删除请求 → 分块发送 → 逐条收 ACK
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_dataplane_nl.h"
+#include <freeDiameter/freeDiameter-host.h>
+#include <freeDiameter/libfdcore.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <linux/fib_rules.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+/*===========================================================================
+ * ipset netlink 协议常量 (linux/netfilter/ipset/ip_set.h, 未随 UAPI 安装时自定义)
+ *===========================================================================*/
+
+#ifndef IPSET_PROTOCOL
+#define IPSET_PROTOCOL          6
+#define IPSET_MAXNAMELEN        32
+#define IPSET_CMD_PROTOCOL      1
+#define IPSET_CMD_CREATE        2
+#define IPSET_CMD_DESTROY       3
+#define IPSET_CMD_FLUSH         4
+#define IPSET_CMD_ADD           9
+#define IPSET_CMD_DEL           10
+#define IPSET_CMD_TYPE          13
+#define IPSET_ATTR_PROTOCOL     1
+#define IPSET_ATTR_SETNAME      2
+#define IPSET_ATTR_TYPENAME     3
+#define IPSET_ATTR_REVISION     4
+#define IPSET_ATTR_FAMILY       5
+#define IPSET_ATTR_FLAGS        6
+#define IPSET_ATTR_DATA         7
+#define IPSET_ATTR_REVISION_MIN 10
+#define IPSET_FLAG_EXIST        (1U << 0)
+#define IPSET_ATTR_IP           1
+#define IPSET_ATTR_IPADDR_IPV4  1
+#endif
+
+#define DP_NL_MSG_BUF           1024  /* 单条请求缓冲区 */
+
+/*===========================================================================
+ * 消息构造
+ *===========================================================================*/
+
+typedef union {
+    struct nlmsghdr nlh;
+    char buf[DP_NL_MSG_BUF];
+} NlMsgBuf;
+
+/**
+ * @brief 初始化消息头并在其后预留 hdr_len 字节的协议头
+ */
+static void *nl_msg_init(NlMsgBuf *m, uint16_t type, uint16_t flags, size_t hdr_len)
+{
+    memset(m, 0, sizeof(*m));
+    m->nlh.nlmsg_len = NLMSG_LENGTH(hdr_len);
+    m->nlh.nlmsg_type = type;
+    m->nlh.nlmsg_flags = NLM_F_REQUEST | flags;
+    return NLMSG_DATA(&m->nlh);
+}
+
+static struct nlattr *nl_attr_put(NlMsgBuf *m, uint16_t type, const void *data, size_t len)
+{
+    size_t off = NLMSG_ALIGN(m->nlh.nlmsg_len);
+    size_t attr_len = NLA_HDRLEN + len;
+    if (off + NLA_ALIGN(attr_len) > sizeof(m->buf)) {
+        return NULL;
+    }
+    struct nlattr *nla = (struct nlattr *)(m->buf + off);
+    nla->nla_type = type;
+    nla->nla_len = (uint16_t)attr_len;
+    if (len > 0) {
+        memcpy((char *)nla + NLA_HDRLEN, data, len);
+    }
+    m->nlh.nlmsg_len = (uint32_t)(off + NLA_ALIGN(attr_len));
+    return nla;
+}
+
+static void nl_attr_u8(NlMsgBuf *m, uint16_t type, uint8_t v)
+{
+    nl_attr_put(m, type, &v, sizeof(v));
+}
+
+static void nl_attr_u32(NlMsgBuf *m, uint16_t type, uint32_t v)
+{
+    nl_attr_put(m, type, &v, sizeof(v));
+}
+
+static void nl_attr_str(NlMsgBuf *m, uint16_t type, const char *s)
+{
+    nl_attr_put(m, type, s, strlen(s) + 1);
+}
+
+static struct nlattr *nl_nest_start(NlMsgBuf *m, uint16_t type)
+{
+    return nl_attr_put(m, type | NLA_F_NESTED, NULL, 0);
+}
+
+static void nl_nest_end(NlMsgBuf *m, struct nlattr *nest)
+{
+    if (nest) {
+        nest->nla_len = (uint16_t)(m->buf + m->nlh.nlmsg_len - (char *)nest);
+    }
+}
+
+/**
+ * @brief 解析属性列表到 tb[0..max] (类型去掉 NESTED/BYTEORDER 标志)
+ */
+static void nl_parse_attrs(const void *start, int len, const struct nlattr **tb, int max)
+{
+    memset(tb, 0, sizeof(*tb) * (size_t)(max + 1));
+    const struct nlattr *nla = (const struct nlattr *)start;
+    while (len >= (int)NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN && nla->nla_len <= len) {
+        int type = nla->nla_type & NLA_TYPE_MASK;
+        if (type <= max) {
+            tb[type] = nla;
+        }
+        int step = NLA_ALIGN(nla->nla_len);
+        len -= step;
+        nla = (const struct nlattr *)((const char *)nla + step);
+    }
+}
+
+static const void *nl_attr_data(const struct nlattr *nla)
+{
+    return (const char *)nla + NLA_HDRLEN;
+}
+
+static int nl_attr_len(const struct nlattr *nla)
+{
+    return nla->nla_len - NLA_HDRLEN;
+}
+
+/**
+ * @brief 解析 "a.b.c.d[/len]" 为网络序地址与掩码
+ */
+static int parse_prefix(const char *prefix, uint32_t *addr_be, uint32_t *mask_be)
+{
+    char buf[64];
+    int plen = 32;
+
+    if (!prefix || strlen(prefix) >= sizeof(buf)) return -EINVAL;
+    strcpy(buf, prefix);
+    char *slash = strchr(buf, '/');
+    if (slash) {
+        *slash = '\0';
+        plen = atoi(slash + 1);
+        if (plen < 0 || plen > 32) return -EINVAL;
+    }
+
+    struct in_addr in;
+    if (inet_pton(AF_INET, buf, &in) != 1) return -EINVAL;
+
+    uint32_t mask = plen == 0 ? 0 : htonl(0xFFFFFFFFu << (32 - plen));
+    *addr_be = in.s_addr & mask;
+    *mask_be = mask;
+    return 0;
+}
+
+/*===========================================================================
+ * 收发
+ *===========================================================================*/
+
+static int nl_socket_open(int protocol)
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+    if (fd < 0) return -errno;
+
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+
+    /* ACK 不回显原请求，减少批量删除时的接收量 */
+    int one = 1;
+    setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+
+    struct timeval tv;
+    tv.tv_sec = DP_NL_RECV_TIMEOUT_MS / 1000;
+    tv.tv_usec = (DP_NL_RECV_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    return fd;
+}
+
+static int nl_send(int fd, const void *buf, size_t len)
+{
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+
+    ssize_t n;
+    do {
+        n = sendto(fd, buf, len, 0, (struct sockaddr *)&sa, sizeof(sa));
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return -errno;
+    return (size_t)n == len ? 0 : -EIO;
+}
+
+/**
+ * @brief 判断错误是否属于"目标不存在/已存在"这类可忽略错误
+ */
+static bool nl_err_ignorable(int err, int ignore)
+{
+    if (err == 0) return true;
+    if (ignore == 0) return false;
+    if (err == ignore) return true;
+    /* 删除类请求: 不同内核对不存在的对象返回 ENOENT 或 ESRCH */
+    return ignore == -ENOENT && err == -ESRCH;
+}
+
+/**
+ * @brief 接收序号 [first_seq, first_seq + count) 的全部 ACK
+ * @param ignore 视为成功的错误码 (0=无)
+ * @return 第一个不可忽略的错误 (0=全部成功)
+ */
+static int nl_recv_acks(DataplaneNetlink *nl, int fd, uint32_t first_seq,
+                        uint32_t count, int ignore)
+{
+    char *buf = nl->rx_buf;
+    uint32_t acked = 0;
+    int first_err = 0;
+
+    while (acked < count) {
+        ssize_t n = recv(fd, buf, DP_NL_RECV_BUF, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            int err = (errno == EAGAIN || errno == EWOULDBLOCK) ? -ETIMEDOUT : -errno;
+            return first_err ? first_err : err;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *h = (struct nlmsghdr *)buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_seq - first_seq >= count) continue;  /* 过期应答 */
+            if (h->nlmsg_type != NLMSG_ERROR) continue;       /* 附带的数据应答 */
+
+            const struct nlmsgerr *e = NLMSG_DATA(h);
+            acked++;
+            if (!nl_err_ignorable(e->error, ignore)) {
+                nl->total_errors++;
+                if (first_err == 0) first_err = e->error;
+            }
+        }
+    }
+
+    return first_err;
+}
+
+/**
+ * @brief 发送单条请求并等待 ACK (调用方持锁)
+ */
+static int nl_talk(DataplaneNetlink *nl, int fd, NlMsgBuf *m, int ignore)
+{
+    m->nlh.nlmsg_flags |= NLM_F_ACK;
+    m->nlh.nlmsg_seq = ++nl->seq;
+    nl->total_requests++;
+
+    int err = nl_send(fd, m->buf, m->nlh.nlmsg_len);
+    if (err) return err;
+    return nl_recv_acks(nl, fd, m->nlh.nlmsg_seq, 1, ignore);
+}
+
+typedef int (*nl_dump_cb)(const struct nlmsghdr *h, void *arg);
+
+/**
+ * @brief 发送单条查询, 对数据应答调用 cb, 并等待 ACK (调用方持锁)
+ */
+static int nl_query(DataplaneNetlink *nl, int fd, NlMsgBuf *m, nl_dump_cb cb, void *arg)
+{
+    m->nlh.nlmsg_flags |= NLM_F_ACK;
+    m->nlh.nlmsg_seq = ++nl->seq;
+    nl->total_requests++;
+
+    int err = nl_send(fd, m->buf, m->nlh.nlmsg_len);
+    if (err) return err;
+
+    char *buf = nl->rx_buf;
+    uint32_t seq = m->nlh.nlmsg_seq;
+    int ret = 0;
+    bool done = false;
+
+    while (!done) {
+        ssize_t n = recv(fd, buf, DP_NL_RECV_BUF, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ret = (errno == EAGAIN || errno == EWOULDBLOCK) ? -ETIMEDOUT : -errno;
+            break;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *h = (struct nlmsghdr *)buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_seq != seq) continue;
+            if (h->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *e = NLMSG_DATA(h);
+                if (ret == 0) ret = e->error;
+                done = true;
+                break;
+            }
+            if (ret == 0) {
+                ret = cb(h, arg);
+            }
+        }
+    }
+
+    if (ret < 0) nl->total_errors++;
+    return ret;
+}
+
+/**
+ * @brief 发送 dump 请求并对每条应答调用 cb (调用方持锁)
+ */
+static int nl_dump(DataplaneNetlink *nl, int fd, NlMsgBuf *m, nl_dump_cb cb, void *arg)
+{
+    m->nlh.nlmsg_flags |= NLM_F_DUMP;
+    m->nlh.nlmsg_seq = ++nl->seq;
+    nl->total_requests++;
+
+    int err = nl_send(fd, m->buf, m->nlh.nlmsg_len);
+    if (err) return err;
+
+    char *buf = nl->rx_buf;
+    uint32_t seq = m->nlh.nlmsg_seq;
+    int ret = 0;
+    bool done = false;
+
+    while (!done) {
+        ssize_t n = recv(fd, buf, DP_NL_RECV_BUF, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ret = (errno == EAGAIN || errno == EWOULDBLOCK) ? -ETIMEDOUT : -errno;
+            break;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *h = (struct nlmsghdr *)buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_seq != seq) continue;
+            if (h->nlmsg_type == NLMSG_DONE) {
+                done = true;
+                break;
+            }
+            if (h->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *e = NLMSG_DATA(h);
+                ret = e->error;
+                done = true;
+                break;
+            }
+            if (ret == 0) {
+                ret = cb(h, arg);
+            }
+        }
+    }
+
+    if (ret < 0) nl->total_errors++;
+    return ret;
+}
+
+/*===========================================================================
+ * 批量请求
+ *===========================================================================*/
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    uint32_t count;
+} NlBatch;
+
+/**
+ * @brief 追加一条消息 (复制后改写类型与标志)
+ */
+static int nl_batch_append(NlBatch *b, const struct nlmsghdr *h, uint16_t type, uint16_t flags)
+{
+    size_t need = NLMSG_ALIGN(h->nlmsg_len);
+    if (need > DP_NL_BATCH_CHUNK) return -EMSGSIZE;
+
+    if (b->len + need > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 8192;
+        while (cap < b->len + need) cap *= 2;
+        char *grown = realloc(b->buf, cap);
+        if (!grown) return -ENOMEM;
+        b->buf = grown;
+        b->cap = cap;
+    }
+
+    struct nlmsghdr *copy = (struct nlmsghdr *)(b->buf + b->len);
+    memcpy(copy, h, h->nlmsg_len);
+    memset((char *)copy + h->nlmsg_len, 0, need - h->nlmsg_len);
+    copy->nlmsg_type = type;
+    copy->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    copy->nlmsg_pid = 0;
+    b->len += need;
+    b->count++;
+    return 0;
+}
+
+/**
+ * @brief 分块发送批量请求并收取全部 ACK (调用方持锁)
+ * @return 成功处理的消息数 (>=0), 负 errno=发送/接收失败
+ */
+static int nl_batch_commit(DataplaneNetlink *nl, int fd, NlBatch *b, int ignore)
+{
+    size_t off = 0;
+    int first_err = 0;
+    int ok = 0;
+
+    while (off < b->len) {
+        /* 按消息边界切出不超过 DP_NL_BATCH_CHUNK 的一块 */
+        size_t start = off;
+        uint32_t n = 0;
+        uint32_t first_seq = nl->seq + 1;
+        while (off < b->len) {
+            struct nlmsghdr *h = (struct nlmsghdr *)(b->buf + off);
+            size_t sz = NLMSG_ALIGN(h->nlmsg_len);
+            if (off + sz - start > DP_NL_BATCH_CHUNK) break;
+            h->nlmsg_seq = ++nl->seq;
+            off += sz;
+            n++;
+        }
+        nl->total_requests += n;
+
+        int err = nl_send(fd, b->buf + start, off - start);
+        if (err == 0) {
+            err = nl_recv_acks(nl, fd, first_seq, n, ignore);
+        }
+        if (err == 0) {
+            ok += (int)n;
+        } else if (first_err == 0) {
+            first_err = err;
+        }
+    }
+
+    return first_err ? first_err : ok;
+}
+
+static void nl_batch_free(NlBatch *b)
+{
+    free(b->buf);
+    memset(b, 0, sizeof(*b));
+}
+
+/*===========================================================================
+ * 生命周期
+ *===========================================================================*/
+
+static void nf_msg_init(NlMsgBuf *m, uint8_t subsys, uint8_t cmd, uint16_t flags, uint8_t family)
+{
+    struct nfgenmsg *nfg = nl_msg_init(m, (uint16_t)((subsys << 8) | cmd), flags,
+                                       sizeof(struct nfgenmsg));
+    nfg->nfgen_family = family;
+    nfg->version = NFNETLINK_V0;
+    nfg->res_id = 0;
+}
+
+static int ipset_type_cb(const struct nlmsghdr *h, void *arg)
+{
+    DataplaneNetlink *nl = arg;
+    const struct nfgenmsg *nfg = NLMSG_DATA(h);
+    const struct nlattr *tb[IPSET_ATTR_REVISION_MIN + 1];
+
+    nl_parse_attrs((const char *)nfg + NLMSG_ALIGN(sizeof(*nfg)),
+                   (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*nfg)), tb,
+                   IPSET_ATTR_REVISION_MIN);
+    if (tb[IPSET_ATTR_REVISION] && nl_attr_len(tb[IPSET_ATTR_REVISION]) >= 1) {
+        nl->ipset_hash_ip_rev = *(const uint8_t *)nl_attr_data(tb[IPSET_ATTR_REVISION]);
+    }
+    return 0;
+}
+
+/**
+ * @brief 向内核查询 hash:ip 支持的最高修订号 (IPSET_CMD_TYPE, 调用方持锁)
+ * @details 创建集合必须携带修订号; 固定写 0 在移除旧修订的内核上会失败。
+ * 查询失败时退回 0。
+ */
+static void ipset_negotiate_revision(DataplaneNetlink *nl)
+{
+    NlMsgBuf m;
+
+    nf_msg_init(&m, NFNL_SUBSYS_IPSET, IPSET_CMD_TYPE, 0, AF_INET);
+    nl_attr_u8(&m, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL);
+    nl_attr_str(&m, IPSET_ATTR_TYPENAME, "hash:ip");
+    nl_attr_u8(&m, IPSET_ATTR_FAMILY, AF_INET);
+
+    nl->ipset_hash_ip_rev = 0;
+    int err = nl_query(nl, nl->nf_fd, &m, ipset_type_cb, nl);
+    if (err) {
+        fd_log_notice("[dataplane] ⚠ netlink: hash:ip 修订号查询失败 (%s)，使用 0",
+                      strerror(-err));
+    }
+}
+
+int magic_dp_nl_open(DataplaneNetlink *nl)
+{
+    if (!nl) return -EINVAL;
+
+    memset(nl, 0, sizeof(*nl));
+    nl->nf_fd = -1;
+
+    nl->rx_buf = malloc(DP_NL_RECV_BUF);
+    if (!nl->rx_buf) return -ENOMEM;
+
+    nl->rt_fd = nl_socket_open(NETLINK_ROUTE);
+    if (nl->rt_fd < 0) {
+        int err = nl->rt_fd;
+        fd_log_error("[dataplane] netlink: NETLINK_ROUTE 打开失败: %s", strerror(-err));
+        nl->rt_fd = -1;
+        free(nl->rx_buf);
+        nl->rx_buf = NULL;
+        return err;
+    }
+
+    pthread_mutex_init(&nl->mutex, NULL);
+    nl->initialized = true;
+
+    nl->nf_fd = nl_socket_open(NETLINK_NETFILTER);
+    if (nl->nf_fd < 0) {
+        fd_log_notice("[dataplane] ⚠ netlink: NETLINK_NETFILTER 不可用 (%s)，ipset/conntrack 使用命令行",
+                      strerror(-nl->nf_fd));
+        nl->nf_fd = -1;
+        return 0;
+    }
+
+    NlMsgBuf m;
+    uint8_t proto = IPSET_PROTOCOL;
+
+    /* 探测 ip_set: IPSET_CMD_PROTOCOL 会带一条数据应答和一条 ACK */
+    nf_msg_init(&m, NFNL_SUBSYS_IPSET, IPSET_CMD_PROTOCOL, 0, AF_INET);
+    nl_attr_u8(&m, IPSET_ATTR_PROTOCOL, proto);
+    pthread_mutex_lock(&nl->mutex);
+    nl->has_ipset = (nl_talk(nl, nl->nf_fd, &m, 0) == 0);
+    if (nl->has_ipset) {
+        ipset_negotiate_revision(nl);
+    }
+
+    /* 探测 ctnetlink: 读取全局统计 */
+    nf_msg_init(&m, NFNL_SUBSYS_CTNETLINK, IPCTNL_MSG_CT_GET_STATS, 0, AF_UNSPEC);
+    nl->has_conntrack = (nl_talk(nl, nl->nf_fd, &m, 0) == 0);
+    nl->total_errors = 0;
+    pthread_mutex_unlock(&nl->mutex);
+
+    fd_log_notice("[dataplane] ✓ netlink 后端已打开 (rtnetlink=yes, ipset=%s, conntrack=%s)",
+                  nl->has_ipset ? "yes" : "no", nl->has_conntrack ? "yes" : "no");
+    return 0;
+}
+
+void magic_dp_nl_close(DataplaneNetlink *nl)
+{
+    if (!nl || !nl->initialized) return;
+
+    pthread_mutex_lock(&nl->mutex);
+    if (nl->rt_fd >= 0) close(nl->rt_fd);
+    if (nl->nf_fd >= 0) close(nl->nf_fd);
+    nl->rt_fd = -1;
+    nl->nf_fd = -1;
+    free(nl->rx_buf);
+    nl->rx_buf = NULL;
+    nl->initialized = false;
+    pthread_mutex_unlock(&nl->mutex);
+
+    fd_log_notice("[dataplane] netlink 后端已关闭 (请求=%llu, 失败=%llu)",
+                  (unsigned long long)nl->total_requests,
+                  (unsigned long long)nl->total_errors);
+    pthread_mutex_destroy(&nl->mutex);
+}
+
+/*===========================================================================
+ * rtnetlink: 接口 / 路由 / 策略规则
+ *===========================================================================*/
+
+int magic_dp_nl_link_up(DataplaneNetlink *nl, const char *ifname)
+{
+    if (!nl || !nl->initialized || !ifname) return -EINVAL;
+
+    unsigned int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) return -ENODEV;
+
+    NlMsgBuf m;
+    struct ifinfomsg *ifi = nl_msg_init(&m, RTM_NEWLINK, 0, sizeof(struct ifinfomsg));
+    ifi->ifi_family = AF_UNSPEC;
+    ifi->ifi_index = (int)ifindex;
+    ifi->ifi_flags = IFF_UP;
+    ifi->ifi_change = IFF_UP;
+
+    pthread_mutex_lock(&nl->mutex);
+    int err = nl_talk(nl, nl->rt_fd, &m, 0);
+    pthread_mutex_unlock(&nl->mutex);
+    return err;
+}
+
+static struct rtmsg *route_msg_init(NlMsgBuf *m, uint16_t type, uint16_t flags, uint32_t table)
+{
+    struct rtmsg *rtm = nl_msg_init(m, type, flags, sizeof(struct rtmsg));
+    rtm->rtm_family = AF_INET;
+    rtm->rtm_dst_len = 0;
+    rtm->rtm_table = table < 256 ? (uint8_t)table : RT_TABLE_UNSPEC;
+    rtm->rtm_protocol = RTPROT_STATIC;
+    rtm->rtm_scope = RT_SCOPE_UNIVERSE;
+    rtm->rtm_type = RTN_UNICAST;
+    nl_attr_u32(m, RTA_TABLE, table);
+    return rtm;
+}
+
+int magic_dp_nl_route_default(DataplaneNetlink *nl, uint32_t table,
+                              const char *ifname, const char *gateway,
+                              bool onlink)
+{
+    if (!nl || !nl->initialized || !ifname) return -EINVAL;
+
+    unsigned int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) return -ENODEV;
+
+    NlMsgBuf m;
+    struct rtmsg *rtm = route_msg_init(&m, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, table);
+
+    if (gateway && gateway[0]) {
+        struct in_addr gw;
+        if (inet_pton(AF_INET, gateway, &gw) != 1) return -EINVAL;
+        nl_attr_put(&m, RTA_GATEWAY, &gw, sizeof(gw));
+        if (onlink) rtm->rtm_flags |= RTNH_F_ONLINK;
+    } else {
+        rtm->rtm_scope = RT_SCOPE_LINK;
+    }
+    nl_attr_u32(&m, RTA_OIF, ifindex);
+
+    pthread_mutex_lock(&nl->mutex);
+    int err = nl_talk(nl, nl->rt_fd, &m, 0);
+    pthread_mutex_unlock(&nl->mutex);
+    return err;
+}
+
+int magic_dp_nl_route_blackhole(DataplaneNetlink *nl, uint32_t table)
+{
+    if (!nl || !nl->initialized) return -EINVAL;
+
+    NlMsgBuf m;
+    struct rtmsg *rtm = route_msg_init(&m, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, table);
+    rtm->rtm_type = RTN_BLACKHOLE;
+
+    pthread_mutex_lock(&nl->mutex);
+    int err = nl_talk(nl, nl->rt_fd, &m, 0);
+    pthread_mutex_unlock(&nl->mutex);
+    return err;
+}
+
+typedef struct {
+    uint32_t table;
+    NlBatch *batch;
+} RouteFlushArg;
+
+static int route_flush_cb(const struct nlmsghdr *h, void *arg)
+{
+    RouteFlushArg *a = arg;
+    if (h->nlmsg_type != RTM_NEWROUTE) return 0;
+
+    const struct rtmsg *rtm = NLMSG_DATA(h);
+    if (rtm->rtm_family != AF_INET) return 0;
+
+    const struct nlattr *tb[RTA_MAX + 1];
+    nl_parse_attrs((const char *)rtm + NLMSG_ALIGN(sizeof(*rtm)),
+                   (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*rtm)), tb, RTA_MAX);
+
+    uint32_t table = rtm->rtm_table;
+    if (tb[RTA_TABLE] && nl_attr_len(tb[RTA_TABLE]) >= 4) {
+        memcpy(&table, nl_attr_data(tb[RTA_TABLE]), 4);
+    }
+    if (table != a->table) return 0;
+
+    /* 与 ip route flush 相同: 原样回送，类型改为 RTM_DELROUTE */
+    return nl_batch_append(a->batch, h, RTM_DELROUTE, 0);
+}
+
+int magic_dp_nl_route_flush_table(DataplaneNetlink *nl, uint32_t table)
+{
+    if (!nl || !nl->initialized) return -EINVAL;
+
+    NlBatch batch = {0};
+    RouteFlushArg arg = { table, &batch };
+
+    NlMsgBuf m;
+    struct rtmsg *rtm = nl_msg_init(&m, RTM_GETROUTE, 0, sizeof(struct rtmsg));
+    rtm->rtm_family = AF_INET;
+
+    pthread_mutex_lock(&nl->mutex);
+    int ret = nl_dump(nl, nl->rt_fd, &m, route_flush_cb, &arg);
+    if (ret == 0) {
+        ret = nl_batch_commit(nl, nl->rt_fd, &batch, -ESRCH);
+    }
+    pthread_mutex_unlock(&nl->mutex);
+
+    nl_batch_free(&batch);
+    return ret;
+}
+
+int magic_dp_nl_rule(DataplaneNetlink *nl, bool add, const char *src_ip,
+                     uint32_t fwmark, uint32_t table, uint32_t priority)
+{
+    if (!nl || !nl->initialized) return -EINVAL;
+    if (add && table == 0) return -EINVAL;
+
+    NlMsgBuf m;
+    struct fib_rule_hdr *frh = nl_msg_init(&m, add ? RTM_NEWRULE : RTM_DELRULE,
+                                           add ? (NLM_F_CREATE | NLM_F_EXCL) : 0,
+                                           sizeof(struct fib_rule_hdr));
+    frh->family = AF_INET;
+    if (add) frh->action = FR_ACT_TO_TBL;
+
+    if (src_ip && src_ip[0]) {
+        uint32_t addr, mask;
+        if (parse_prefix(src_ip, &addr, &mask) != 0) return -EINVAL;
+        frh->src_len = (uint8_t)__builtin_popcount(mask);
+        nl_attr_put(&m, FRA_SRC, &addr, sizeof(addr));
+    }
+    if (fwmark) {
+        nl_attr_u32(&m, FRA_FWMARK, fwmark);
+        nl_attr_u32(&m, FRA_FWMASK, 0xFFFFFFFFu);
+    }
+    if (table) {
+        frh->table = table < 256 ? (uint8_t)table : RT_TABLE_UNSPEC;
+        nl_attr_u32(&m, FRA_TABLE, table);
+    }
+    if (priority) {
+        nl_attr_u32(&m, FRA_PRIORITY, priority);
+    }
+
+    pthread_mutex_lock(&nl->mutex);
+    int err = nl_talk(nl, nl->rt_fd, &m, 0);
+    pthread_mutex_unlock(&nl->mutex);
+    return err;
+}
+
+typedef struct {
+    bool by_src;
+    uint32_t addr_be;
+    uint32_t mask_be;
+    uint32_t mark_lo;
+    uint32_t mark_hi;
+    uint32_t prio_lo;
+    uint32_t prio_hi;
+    NlBatch *batch;
+} RuleFlushArg;
+
+static int rule_flush_cb(const struct nlmsghdr *h, void *arg)
+{
+    RuleFlushArg *a = arg;
+    if (h->nlmsg_type != RTM_NEWRULE) return 0;
+
+    const struct fib_rule_hdr *frh = NLMSG_DATA(h);
+    if (frh->family != AF_INET) return 0;
+
+    const struct nlattr *tb[FRA_MAX + 1];
+    nl_parse_attrs((const char *)frh + NLMSG_ALIGN(sizeof(*frh)),
+                   (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*frh)), tb, FRA_MAX);
+
+    if (a->by_src) {
+        if (!tb[FRA_SRC] || nl_attr_len(tb[FRA_SRC]) < 4) return 0;
+        /* 规则本身必须不比目标网段更宽 */
+        if (frh->src_len < (uint8_t)__builtin_popcount(a->mask_be)) return 0;
+        uint32_t src;
+        memcpy(&src, nl_attr_data(tb[FRA_SRC]), 4);
+        if ((src & a->mask_be) != a->addr_be) return 0;
+        /* 只删本模块安装的规则 (优先级区间), 不碰管理员手工规则 */
+        uint32_t prio = 0;
+        if (tb[FRA_PRIORITY] && nl_attr_len(tb[FRA_PRIORITY]) >= 4) {
+            memcpy(&prio, nl_attr_data(tb[FRA_PRIORITY]), 4);
+        }
+        if (prio < a->prio_lo || prio > a->prio_hi) return 0;
+    } else {
+        if (!tb[FRA_FWMARK] || nl_attr_len(tb[FRA_FWMARK]) < 4) return 0;
+        uint32_t mark;
+        memcpy(&mark, nl_attr_data(tb[FRA_FWMARK]), 4);
+        if (mark < a->mark_lo || mark > a->mark_hi) return 0;
+    }
+
+    return nl_batch_append(a->batch, h, RTM_DELRULE, 0);
+}
+
+static int rule_flush(DataplaneNetlink *nl, RuleFlushArg *arg)
+{
+    NlBatch batch = {0};
+    arg->batch = &batch;
+
+    NlMsgBuf m;
+    struct fib_rule_hdr *frh = nl_msg_init(&m, RTM_GETRULE, 0, sizeof(struct fib_rule_hdr));
+    frh->family = AF_INET;
+
+    pthread_mutex_lock(&nl->mutex);
+    int ret = nl_dump(nl, nl->rt_fd, &m, rule_flush_cb, arg);
+    if (ret == 0) {
+        ret = nl_batch_commit(nl, nl->rt_fd, &batch, -ENOENT);
+    }
+    pthread_mutex_unlock(&nl->mutex);
+
+    nl_batch_free(&batch);
+    return ret;
+}
+
+int magic_dp_nl_rule_flush_src(DataplaneNetlink *nl, const char *prefix,
+                               uint32_t prio_lo, uint32_t prio_hi)
+{
+    if (!nl || !nl->initialized) return -EINVAL;
+
+    RuleFlushArg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.by_src = true;
+    arg.prio_lo = prio_lo;
+    arg.prio_hi = prio_hi;
+    if (parse_prefix(prefix, &arg.addr_be, &arg.mask_be) != 0) return -EINVAL;
+
+    return rule_flush(nl, &arg);
+}
+
+int magic_dp_nl_rule_flush_fwmark(DataplaneNetlink *nl, uint32_t mark_lo,
+                                  uint32_t mark_hi)
+{
+    if (!nl || !nl->initialized) return -EINVAL;
+
+    RuleFlushArg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.mark_lo = mark_lo;
+    arg.mark_hi = mark_hi;
+
+    return rule_flush(nl, &arg);
+}
+
+/*===========================================================================
+ * nfnetlink: ipset
+ *===========================================================================*/
+
+/**
+ * @brief 构造 ipset 命令公共部分 (协议版本 + 集合名)
+ * @details 不带 NLM_F_EXCL: 内核据此忽略"已存在/不存在"错误 (即 -exist)。
+ */
+static int ipset_msg_init(NlMsgBuf *m, uint8_t cmd, const char *name)
+{
+    if (!name || strlen(name) >= IPSET_MAXNAMELEN) return -EINVAL;
+
+    nf_msg_init(m, NFNL_SUBSYS_IPSET, cmd, 0, AF_INET);
+    nl_attr_u8(m, IPSET_ATTR_PROTOCOL, IPSET_PROTOCOL);
+    nl_attr_str(m, IPSET_ATTR_SETNAME, name);
+    return 0;
+}
+
+static int ipset_talk(DataplaneNetlink *nl, NlMsgBuf *m, int ignore)
+{
+    pthread_mutex_lock(&nl->mutex);
+    int err = nl_talk(nl, nl->nf_fd, m, ignore);
+    pthread_mutex_unlock(&nl->mutex);
+    return err;
+}
+
+int magic_dp_nl_ipset_create(DataplaneNetlink *nl, const char *name)
+{
+    if (!nl || !nl->initialized || !nl->has_ipset) return -EOPNOTSUPP;
+
+    NlMsgBuf m;
+    if (ipset_msg_init(&m, IPSET_CMD_CREATE, name) != 0) return -EINVAL;
+    nl_attr_str(&m, IPSET_ATTR_TYPENAME, "hash:ip");
+    nl_attr_u8(&m, IPSET_ATTR_REVISION, nl->ipset_hash_ip_rev);
+    nl_attr_u8(&m, IPSET_ATTR_FAMILY, AF_INET);
+    nl_attr_u32(&m, IPSET_ATTR_FLAGS | NLA_F_NET_BYTEORDER, htonl(IPSET_FLAG_EXIST));
+    struct nlattr *data = nl_nest_start(&m, IPSET_ATTR_DATA);
+    nl_nest_end(&m, data);
+
+    /* 同名同类型集合已存在 (如上次运行残留) 视为成功 */
+    return ipset_talk(nl, &m, -EEXIST);
+}
+
+int magic_dp_nl_ipset_flush(DataplaneNetlink *nl, const char *name)
+{
+    if (!nl || !nl->initialized || !nl->has_ipset) return -EOPNOTSUPP;
+
+    NlMsgBuf m;
+    if (ipset_msg_init(&m, IPSET_CMD_FLUSH, name) != 0) return -EINVAL;
+    return ipset_talk(nl, &m, 0);
+}
+
+int magic_dp_nl_ipset_destroy(DataplaneNetlink *nl, const char *name)
+{
+    if (!nl || !nl->initialized || !nl->has_ipset) return -EOPNOTSUPP;
+
+    NlMsgBuf m;
+    if (ipset_msg_init(&m, IPSET_CMD_DESTROY, name) != 0) return -EINVAL;
+    return ipset_talk(nl, &m, 0);
+}
+
+int magic_dp_nl_ipset_entry(DataplaneNetlink *nl, bool add, const char *name,
+                            const char *ip)
+{
+    if (!nl || !nl->initialized || !nl->has_ipset) return -EOPNOTSUPP;
+
+    struct in_addr in;
+    if (!ip || inet_pton(AF_INET, ip, &in) != 1) return -EINVAL;
+
+    NlMsgBuf m;
+    if (ipset_msg_init(&m, add ? IPSET_CMD_ADD : IPSET_CMD_DEL, name) != 0) return -EINVAL;
+    struct nlattr *data = nl_nest_start(&m, IPSET_ATTR_DATA);
+    struct nlattr *ipn = nl_nest_start(&m, IPSET_ATTR_IP);
+    nl_attr_put(&m, IPSET_ATTR_IPADDR_IPV4 | NLA_F_NET_BYTEORDER, &in.s_addr, 4);
+    nl_nest_end(&m, ipn);
+    nl_nest_end(&m, data);
+
+    return ipset_talk(nl, &m, 0);
+}
+
+/*===========================================================================
+ * nfnetlink: conntrack
+ *===========================================================================*/
+
+typedef struct {
+    uint32_t addr_be;
+    uint32_t mask_be;
+    NlBatch *batch;
+} CtFlushArg;
+
+static int ct_flush_cb(const struct nlmsghdr *h, void *arg)
+{
+    CtFlushArg *a = arg;
+    const struct nfgenmsg *nfg = NLMSG_DATA(h);
+    if (nfg->nfgen_family != AF_INET) return 0;
+
+    const struct nlattr *tb[CTA_MAX + 1];
+    nl_parse_attrs((const char *)nfg + NLMSG_ALIGN(sizeof(*nfg)),
+                   (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*nfg)), tb, CTA_MAX);
+    if (!tb[CTA_TUPLE_ORIG]) return 0;
+
+    const struct nlattr *tuple[CTA_TUPLE_MAX + 1];
+    nl_parse_attrs(nl_attr_data(tb[CTA_TUPLE_ORIG]), nl_attr_len(tb[CTA_TUPLE_ORIG]),
+                   tuple, CTA_TUPLE_MAX);
+    if (!tuple[CTA_TUPLE_IP]) return 0;
+
+    const struct nlattr *ip[CTA_IP_MAX + 1];
+    nl_parse_attrs(nl_attr_data(tuple[CTA_TUPLE_IP]), nl_attr_len(tuple[CTA_TUPLE_IP]),
+                   ip, CTA_IP_MAX);
+    if (!ip[CTA_IP_V4_SRC] || nl_attr_len(ip[CTA_IP_V4_SRC]) < 4) return 0;
+
+    uint32_t src;
+    memcpy(&src, nl_attr_data(ip[CTA_IP_V4_SRC]), 4);
+    if ((src & a->mask_be) != a->addr_be) return 0;
+
+    /* 删除请求: 原方向五元组 (+ zone) 原样带回 */
+    NlMsgBuf m;
+    nf_msg_init(&m, NFNL_SUBSYS_CTNETLINK, IPCTNL_MSG_CT_DELETE, 0, AF_INET);
+    const struct nlattr *orig = tb[CTA_TUPLE_ORIG];
+    if (!nl_attr_put(&m, orig->nla_type, nl_attr_data(orig), (size_t)nl_attr_len(orig))) {
+        return 0;
+    }
+    if (tb[CTA_ZONE]) {
+        nl_attr_put(&m, tb[CTA_ZONE]->nla_type, nl_attr_data(tb[CTA_ZONE]),
+                    (size_t)nl_attr_len(tb[CTA_ZONE]));
+    }
+    return nl_batch_append(a->batch, &m.nlh, m.nlh.nlmsg_type, 0);
+}
+
+int magic_dp_nl_conntrack_flush_src(DataplaneNetlink *nl, const char *prefix)
+{
+    if (!nl || !nl->initialized || !nl->has_conntrack) return -EOPNOTSUPP;
+
+    NlBatch batch = {0};
+    CtFlushArg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (parse_prefix(prefix, &arg.addr_be, &arg.mask_be) != 0) return -EINVAL;
+    arg.batch = &batch;
+
+    NlMsgBuf m;
+    nf_msg_init(&m, NFNL_SUBSYS_CTNETLINK, IPCTNL_MSG_CT_GET, 0, AF_INET);
+
+    pthread_mutex_lock(&nl->mutex);
+    int ret = nl_dump(nl, nl->nf_fd, &m, ct_flush_cb, &arg);
+    if (ret == 0) {
+        /* dump 与删除之间条目可能已超时消失 */
+        ret = nl_batch_commit(nl, nl->nf_fd, &batch, -ENOENT);
+    }
+    pthread_mutex_unlock(&nl->mutex);
+
+    nl_batch_free(&batch);
+    return ret;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file magic_dataplane_nl.h
+ * @brief MAGIC 数据平面 netlink 后端
+ * @description 直接通过 rtnetlink / nfnetlink 下发数据平面配置，替代
+ * fork/exec 方式调用 ip / ipset / conntrack 命令:
+ *
+ * - NETLINK_ROUTE     : 接口 up、策略路由表 (默认路由/黑洞路由/清空)、ip rule
+ * - NETLINK_NETFILTER : ipset (NFNL_SUBSYS_IPSET)、conntrack
+ * (NFNL_SUBSYS_CTNETLINK)
+ *
+ * 批量删除 (清空路由表、按源网段/fwmark 清理 ip rule、按源地址清理 conntrack)
+ * 先一次 dump 收集匹配项，再把全部删除请求拼成一个缓冲区发送，逐条收取 ACK。
+ *
+ * 所有函数成功返回 0，失败返回负的 errno；内部自带互斥锁，可在任意线程调用。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_DATAPLANE_NL_H
+#define MAGIC_DATAPLANE_NL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DP_NL_RECV_TIMEOUT_MS 2000 /* 等待内核应答的超时 */
+#define DP_NL_BATCH_CHUNK 32768    /* 单次 sendto 的批量请求上限 (字节) */
+#define DP_NL_RECV_BUF 65536       /* 接收缓冲区 (容纳一次 dump recv) */
+
+/**
+ * @brief netlink 后端上下文
+ */
+typedef struct {
+  int rt_fd;                 ///< NETLINK_ROUTE 套接字。
+  int nf_fd;                 ///< NETLINK_NETFILTER 套接字。
+  uint32_t seq;              ///< 下一个请求序号。
+  char *rx_buf;              ///< 接收缓冲区 (DP_NL_RECV_BUF 字节, 持锁使用)。
+  bool has_ipset;            ///< 内核 ip_set 子系统可用。
+  bool has_conntrack;        ///< 内核 ctnetlink 子系统可用。
+  uint8_t ipset_hash_ip_rev; ///< 内核 hash:ip 最高修订号 (打开时协商)。
+
+  /* 统计 */
+  uint64_t total_requests; ///< 发送的请求消息数。
+  uint64_t total_errors;   ///< 失败的请求数 (不含可忽略的不存在错误)。
+
+  pthread_mutex_t mutex; ///< 串行化请求/应答。
+  bool initialized;      ///< 是否已打开。
+} DataplaneNetlink;
+
+/**
+ * @brief 打开 netlink 套接字并探测 ipset / conntrack 子系统
+ * @param nl 后端上下文
+ * @return 0=成功 (NETLINK_ROUTE 可用), 负 errno=失败
+ */
+int magic_dp_nl_open(DataplaneNetlink *nl);
+
+/**
+ * @brief 关闭 netlink 套接字
+ * @param nl 后端上下文
+ */
+void magic_dp_nl_close(DataplaneNetlink *nl);
+
+/**
+ * @brief 启动网络接口 (等价 ip link set <if> up)
+ * @param nl 后端上下文
+ * @param ifname 接口名
+ * @return 0=成功, 负 errno=失败
+ */
+int magic_dp_nl_link_up(DataplaneNetlink *nl, const char *ifname);
+
+/**
+ * @brief 在指定路由表添加默认路由
+ * @details gateway 为 NULL 或空时等价
+ *          ip route add default dev <if> table <t>，否则等价
+ *          ip route add default via <gw> dev <if> table <t> [onlink]
+ *
+ * @param nl 后端上下文
+ * @param table 路由表 ID
+ * @param ifname 出口接口
+ * @param gateway 网关 IP (可为 NULL)
+ * @param onlink 是否设置 onlink 标志
+ * @return 0=成功, 负 errno=失败 (-EEXIST 表示已存在)
+ */
+int magic_dp_nl_route_default(DataplaneNetlink *nl, uint32_t table,
+                              const char *ifname, const char *gateway,
+                              bool onlink);
+
+/**
+ * @brief 在指定路由表添加黑洞默认路由 (ip route add blackhole default table
+ * <t>)
+ * @param nl 后端上下文
+ * @param table 路由表 ID
+ * @return 0=成功, 负 errno=失败
+ */
+int magic_dp_nl_route_blackhole(DataplaneNetlink *nl, uint32_t table);
+
+/**
+ * @brief 清空指定路由表的全部 IPv4 路由 (ip route flush table <t>)
+ * @param nl 后端上下文
+ * @param table 路由表 ID
+ * @return 删除的路由数 (>=0), 负 errno=失败
+ */
+int magic_dp_nl_route_flush_table(DataplaneNetlink *nl, uint32_t table);
+
+/**
+ * @brief 添加/删除一条 IPv4 策略路由规则
+ * @details 删除时取 0 / NULL 的字段视为通配，语义与 ip rule del 相同。
+ *
+ * @param nl 后端上下文
+ * @param add true=添加, false=删除
+ * @param src_ip 源地址 (from <ip>/32, NULL=不限)
+ * @param fwmark fwmark 匹配 (0=不限)
+ * @param table 查找的路由表 (0=不限, 仅删除时允许)
+ * @param priority 优先级 (0=不指定)
+ * @return 0=成功, 负 errno=失败 (删除不存在的规则返回 -ENOENT)
+ */
+int magic_dp_nl_rule(DataplaneNetlink *nl, bool add, const char *src_ip,
+                     uint32_t fwmark, uint32_t table, uint32_t priority);
+
+/**
+ * @brief 删除源地址落在给定网段内、优先级在 [prio_lo, prio_hi] 内的 IPv4
+ * 策略路由规则
+ * @param nl 后端上下文
+ * @param prefix 网段 ("a.b.c.d/len" 或单个 IP)
+ * @param prio_lo 优先级下限
+ * @param prio_hi 优先级上限
+ * @return 删除的规则数 (>=0), 负 errno=失败
+ */
+int magic_dp_nl_rule_flush_src(DataplaneNetlink *nl, const char *prefix,
+                               uint32_t prio_lo, uint32_t prio_hi);
+
+/**
+ * @brief 删除 fwmark 落在 [mark_lo, mark_hi] 内的全部 IPv4 策略路由规则
+ * @param nl 后端上下文
+ * @param mark_lo fwmark 下界
+ * @param mark_hi fwmark 上界
+ * @return 删除的规则数 (>=0), 负 errno=失败
+ */
+int magic_dp_nl_rule_flush_fwmark(DataplaneNetlink *nl, uint32_t mark_lo,
+                                  uint32_t mark_hi);
+
+/**
+ * @brief 创建 hash:ip 集合 (已存在时成功, 等价 ipset create ... -exist)
+ * @param nl 后端上下文
+ * @param name 集合名
+ * @return 0=成功, 负 errno=失败
+ */
+int magic_dp_nl_ipset_create(DataplaneNetlink *nl, const char *name);
+
+/**
+ * @brief 清空集合 (ipset flush)
+ * @param nl 后端上下文
+ * @param name 集合名
+ * @return 0=成功, 负 errno=失败
+ */
+int magic_dp_nl_ipset_flush(DataplaneNetlink *nl, const char *name);
+
+/**
+ * @brief 销毁集合 (ipset destroy)
+ * @param nl 后端上下文
+ * @param name 集合名
+ * @return 0=成功, 负 errno=失败
+ */
+int magic_dp_nl_ipset_destroy(DataplaneNetlink *nl, const char *name);
+
+/**
+ * @brief 向集合添加/删除 IPv4 地址 (幂等, 等价 -exist)
+ * @param nl 后端上下文
+ * @param add true=添加, false=删除
+ * @param name 集合名
+ * @param ip IPv4 地址字符串
+ * @return 0=成功, 负 errno=失败
+ */
+int magic_dp_nl_ipset_entry(DataplaneNetlink *nl, bool add, const char *name,
+                            const char *ip);
+
+/**
+ * @brief 删除原方向源地址落在给定网段内的全部 IPv4 conntrack 条目
+ * @details 等价 conntrack -D -s <prefix>。
+ * @param nl 后端上下文
+ * @param prefix 网段 ("a.b.c.d/len" 或单个 IP)
+ * @return 删除的条目数 (>=0), 负 errno=失败
+ */
+int magic_dp_nl_conntrack_flush_src(DataplaneNetlink *nl, const char *prefix);
+
+#endif /* MAGIC_DATAPLANE_NL_H */
@@ -0,0 +1,471 @@
+/**
+ * @file magic_flow.c
+ * @brief MAGIC 全局流分类器实现。
+ * @details 规则池 + 按前缀长度组合分组的哈希表 (Tuple Space Search)。
+ *          规则池按需倍增，以下标互相引用；组哈希表在负载因子超过 2 时
+ *          倍增重建。读写锁保护全部结构。
+ */
+
+#include "magic_flow.h"
+#include "magic_hash.h"
+#include <arpa/inet.h>
+#include <freeDiameter/extension.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*===========================================================================
+ * 内部辅助函数 (调用方持锁)
+ *===========================================================================*/
+
+static inline uint32_t flow_mask(uint8_t plen) {
+  return plen == 0 ? 0 : 0xFFFFFFFFu << (32 - plen);
+}
+
+/* 组内哈希: 截断后的 (src, dst) */
+static inline uint32_t flow_tuple_hash(uint32_t src, uint32_t dst) {
+  uint64_t k = ((uint64_t)src << 32) | dst;
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  return (uint32_t)k;
+}
+
+static inline uint32_t flow_src_hash(uint32_t src) {
+  return flow_tuple_hash(src, 0x9e3779b9u);
+}
+
+/* 会话 ID 哈希 (FNV-1a) */
+static uint32_t flow_sess_hash(const char *session_id) {
+  return magic_fnv1a32_str(session_id) & (FLOW_SESSION_BUCKETS - 1);
+}
+
+/* [start, end] 的最小覆盖前缀 */
+static void flow_range_to_prefix(uint32_t start, uint32_t end, uint32_t *ip,
+                                 uint8_t *plen) {
+  uint8_t len = 32;
+  while (len > 0 && (start & flow_mask(len)) != (end & flow_mask(len)))
+    len--;
+  *plen = len;
+  *ip = start & flow_mask(len);
+}
+
+static inline bool flow_rule_matches_key(const MagicFlowRule *r,
+                                         const MagicFlowKey *k) {
+  if (r->direction != k->direction)
+    return false;
+  if (r->protocol != 0 && r->protocol != k->protocol)
+    return false;
+  if (k->src_port < r->src_port_lo || k->src_port > r->src_port_hi)
+    return false;
+  if (k->dst_port < r->dst_port_lo || k->dst_port > r->dst_port_hi)
+    return false;
+  return true;
+}
+
+static bool flow_rules_overlap(const MagicFlowRule *a, const MagicFlowRule *b) {
+  if (a->direction != b->direction)
+    return false;
+  if (a->protocol != 0 && b->protocol != 0 && a->protocol != b->protocol)
+    return false;
+
+  uint32_t sm = flow_mask(a->src_plen < b->src_plen ? a->src_plen : b->src_plen);
+  if ((a->src_ip & sm) != (b->src_ip & sm))
+    return false;
+  uint32_t dm = flow_mask(a->dst_plen < b->dst_plen ? a->dst_plen : b->dst_plen);
+  if ((a->dst_ip & dm) != (b->dst_ip & dm))
+    return false;
+
+  if (a->src_port_hi < b->src_port_lo || b->src_port_hi < a->src_port_lo)
+    return false;
+  if (a->dst_port_hi < b->dst_port_lo || b->dst_port_hi < a->dst_port_lo)
+    return false;
+  return true;
+}
+
+/* 命中优先级: a 是否优于 b */
+static inline bool flow_entry_better(const MagicFlowEntry *a,
+                                     const MagicFlowEntry *b) {
+  if (a->rule.precedence != b->rule.precedence)
+    return a->rule.precedence < b->rule.precedence;
+  return a->seq < b->seq;
+}
+
+static void flow_fill_match(const MagicFlowClassifier *fc, int32_t idx,
+                            MagicFlowMatch *m) {
+  const MagicFlowEntry *e = &fc->entries[idx];
+  memcpy(m->session_id, e->rule.session_id, sizeof(m->session_id));
+  m->bearer_id = e->rule.bearer_id;
+  m->tft_index = e->rule.tft_index;
+  m->rule_id = (uint32_t)idx;
+}
+
+static int flow_pool_grow(MagicFlowClassifier *fc) {
+  uint32_t new_cap = fc->capacity ? fc->capacity * 2 : FLOW_INITIAL_RULES;
+  MagicFlowEntry *grown =
+      realloc(fc->entries, (size_t)new_cap * sizeof(MagicFlowEntry));
+  if (!grown)
+    return -1;
+
+  /* 新增槽位按下标顺序挂到空闲链 */
+  for (uint32_t i = new_cap; i-- > fc->capacity;) {
+    memset(&grown[i], 0, sizeof(grown[i]));
+    grown[i].tuple_next = fc->free_head;
+    fc->free_head = (int32_t)i;
+  }
+  fc->entries = grown;
+  fc->capacity = new_cap;
+  return 0;
+}
+
+static int flow_tuple_rehash(MagicFlowClassifier *fc, MagicFlowTuple *t,
+                             uint32_t nbuckets) {
+  int32_t *nb = malloc((size_t)nbuckets * sizeof(int32_t));
+  int32_t *ns = malloc((size_t)nbuckets * sizeof(int32_t));
+  if (!nb || !ns) {
+    free(nb);
+    free(ns);
+    return -1;
+  }
+  for (uint32_t i = 0; i < nbuckets; i++)
+    nb[i] = ns[i] = -1;
+
+  for (uint32_t b = 0; b < t->nbuckets; b++) {
+    int32_t idx = t->buckets[b];
+    while (idx >= 0) {
+      MagicFlowEntry *e = &fc->entries[idx];
+      int32_t next = e->tuple_next;
+      uint32_t h = flow_tuple_hash(e->rule.src_ip, e->rule.dst_ip) &
+                   (nbuckets - 1);
+      e->tuple_next = nb[h];
+      nb[h] = idx;
+      h = flow_src_hash(e->rule.src_ip) & (nbuckets - 1);
+      e->src_next = ns[h];
+      ns[h] = idx;
+      idx = next;
+    }
+  }
+
+  free(t->buckets);
+  free(t->src_buckets);
+  t->buckets = nb;
+  t->src_buckets = ns;
+  t->nbuckets = nbuckets;
+  return 0;
+}
+
+static void flow_unlink_entry(MagicFlowClassifier *fc, int32_t idx) {
+  MagicFlowEntry *e = &fc->entries[idx];
+  MagicFlowTuple *t = &fc->tuples[e->tuple_idx];
+
+  uint32_t h =
+      flow_tuple_hash(e->rule.src_ip, e->rule.dst_ip) & (t->nbuckets - 1);
+  int32_t *pp = &t->buckets[h];
+  while (*pp >= 0 && *pp != idx)
+    pp = &fc->entries[*pp].tuple_next;
+  if (*pp == idx)
+    *pp = e->tuple_next;
+
+  pp = &t->src_buckets[flow_src_hash(e->rule.src_ip) & (t->nbuckets - 1)];
+  while (*pp >= 0 && *pp != idx)
+    pp = &fc->entries[*pp].src_next;
+  if (*pp == idx)
+    *pp = e->src_next;
+
+  if (--t->count == 0) {
+    for (uint32_t i = 0; i < fc->num_active; i++) {
+      if (fc->active[i] == (uint16_t)e->tuple_idx) {
+        fc->active[i] = fc->active[--fc->num_active];
+        break;
+      }
+    }
+  }
+
+  e->in_use = false;
+  e->tuple_next = fc->free_head;
+  fc->free_head = idx;
+  fc->count--;
+}
+
+/*===========================================================================
+ * 公共 API
+ *===========================================================================*/
+
+int magic_flow_init(MagicFlowClassifier *fc) {
+  if (!fc)
+    return -1;
+
+  memset(fc, 0, sizeof(*fc));
+  fc->free_head = -1;
+  for (uint32_t i = 0; i < FLOW_SESSION_BUCKETS; i++)
+    fc->sess_buckets[i] = -1;
+  for (uint32_t s = 0; s <= 32; s++) {
+    for (uint32_t d = 0; d <= 32; d++) {
+      fc->tuples[s * 33 + d].src_plen = (uint8_t)s;
+      fc->tuples[s * 33 + d].dst_plen = (uint8_t)d;
+    }
+  }
+
+  if (flow_pool_grow(fc) != 0) {
+    fd_log_error("[app_magic] Flow classifier: failed to allocate rule pool");
+    return -1;
+  }
+
+  pthread_rwlock_init(&fc->lock, NULL);
+  fc->initialized = true;
+  fd_log_notice("[app_magic] Flow classifier initialized");
+  return 0;
+}
+
+void magic_flow_cleanup(MagicFlowClassifier *fc) {
+  if (!fc || !fc->initialized)
+    return;
+
+  pthread_rwlock_wrlock(&fc->lock);
+  for (uint32_t i = 0; i < 33 * 33; i++) {
+    free(fc->tuples[i].buckets);
+    free(fc->tuples[i].src_buckets);
+  }
+  free(fc->entries);
+  fc->entries = NULL;
+  fc->initialized = false;
+  pthread_rwlock_unlock(&fc->lock);
+  pthread_rwlock_destroy(&fc->lock);
+
+  fd_log_notice("[app_magic] Flow classifier cleaned up");
+}
+
+int magic_flow_rule_from_tft(const TFTRule *tft, const char *client_ip,
+                             uint8_t direction, MagicFlowRule *rule) {
+  if (!tft || !rule)
+    return -1;
+
+  memset(rule, 0, sizeof(*rule));
+  rule->direction = direction;
+
+  if (tft->src_ip.is_valid) {
+    flow_range_to_prefix(tft->src_ip.start_ip, tft->src_ip.end_ip,
+                         &rule->src_ip, &rule->src_plen);
+  }
+  if (tft->dst_ip.is_valid) {
+    flow_range_to_prefix(tft->dst_ip.start_ip, tft->dst_ip.end_ip,
+                         &rule->dst_ip, &rule->dst_plen);
+  }
+
+  /* 客户端一侧: 机 → 地为源地址，地 → 机为目的地址 */
+  struct in_addr addr;
+  if (client_ip && inet_pton(AF_INET, client_ip, &addr) == 1) {
+    if (direction == FLOW_DIR_TO_AIRCRAFT) {
+      rule->dst_ip = ntohl(addr.s_addr);
+      rule->dst_plen = 32;
+    } else {
+      rule->src_ip = ntohl(addr.s_addr);
+      rule->src_plen = 32;
+    }
+  }
+
+  rule->protocol = tft->has_protocol ? tft->protocol : 0;
+
+  rule->src_port_lo = tft->src_port.is_valid ? tft->src_port.start_port : 0;
+  rule->src_port_hi = tft->src_port.is_valid ? tft->src_port.end_port : 65535;
+  rule->dst_port_lo = tft->dst_port.is_valid ? tft->dst_port.start_port : 0;
+  rule->dst_port_hi = tft->dst_port.is_valid ? tft->dst_port.end_port : 65535;
+  return 0;
+}
+
+int magic_flow_insert(MagicFlowClassifier *fc, const MagicFlowRule *rule) {
+  if (!fc || !fc->initialized || !rule || !rule->session_id[0] ||
+      rule->src_plen > 32 || rule->dst_plen > 32)
+    return -1;
+
+  pthread_rwlock_wrlock(&fc->lock);
+
+  if (fc->free_head < 0 && flow_pool_grow(fc) != 0) {
+    pthread_rwlock_unlock(&fc->lock);
+    fd_log_error("[app_magic] Flow classifier: rule pool grow failed (%u)",
+                 fc->capacity);
+    return -1;
+  }
+
+  uint16_t ti = (uint16_t)(rule->src_plen * 33 + rule->dst_plen);
+  MagicFlowTuple *t = &fc->tuples[ti];
+  if (!t->buckets || t->count >= t->nbuckets * 2) {
+    uint32_t nb = t->nbuckets ? t->nbuckets * 2 : FLOW_TUPLE_MIN_BUCKETS;
+    if (flow_tuple_rehash(fc, t, nb) != 0) {
+      pthread_rwlock_unlock(&fc->lock);
+      fd_log_error("[app_magic] Flow classifier: tuple /%u,/%u rehash failed",
+                   rule->src_plen, rule->dst_plen);
+      return -1;
+    }
+  }
+
+  int32_t idx = fc->free_head;
+  MagicFlowEntry *e = &fc->entries[idx];
+  fc->free_head = e->tuple_next;
+
+  e->rule = *rule;
+  e->rule.session_id[FLOW_SESSION_ID_LEN - 1] = '\0';
+  e->rule.src_ip &= flow_mask(rule->src_plen);
+  e->rule.dst_ip &= flow_mask(rule->dst_plen);
+  e->seq = fc->next_seq++;
+  e->tuple_idx = (int16_t)ti;
+  e->in_use = true;
+
+  uint32_t h = flow_tuple_hash(e->rule.src_ip, e->rule.dst_ip) &
+               (t->nbuckets - 1);
+  e->tuple_next = t->buckets[h];
+  t->buckets[h] = idx;
+  h = flow_src_hash(e->rule.src_ip) & (t->nbuckets - 1);
+  e->src_next = t->src_buckets[h];
+  t->src_buckets[h] = idx;
+  if (t->count++ == 0)
+    fc->active[fc->num_active++] = ti;
+
+  uint32_t sh = flow_sess_hash(e->rule.session_id);
+  e->sess_next = fc->sess_buckets[sh];
+  fc->sess_buckets[sh] = idx;
+
+  fc->count++;
+  pthread_rwlock_unlock(&fc->lock);
+  return idx;
+}
+
+int magic_flow_remove_session(MagicFlowClassifier *fc, const char *session_id) {
+  if (!fc || !fc->initialized || !session_id)
+    return 0;
+
+  int removed = 0;
+  pthread_rwlock_wrlock(&fc->lock);
+
+  int32_t *pp = &fc->sess_buckets[flow_sess_hash(session_id)];
+  while (*pp >= 0) {
+    int32_t idx = *pp;
+    MagicFlowEntry *e = &fc->entries[idx];
+    if (strcmp(e->rule.session_id, session_id) == 0) {
+      *pp = e->sess_next;
+      flow_unlink_entry(fc, idx);
+      removed++;
+    } else {
+      pp = &e->sess_next;
+    }
+  }
+
+  pthread_rwlock_unlock(&fc->lock);
+
+  if (removed > 0)
+    fd_log_debug("[app_magic] Flow classifier: %d rule(s) removed for %s",
+                 removed, session_id);
+  return removed;
+}
+
+int magic_flow_lookup(MagicFlowClassifier *fc, const MagicFlowKey *key,
+                      MagicFlowMatch *match) {
+  if (!fc || !fc->initialized || !key)
+    return -1;
+
+  int32_t best = -1;
+  pthread_rwlock_rdlock(&fc->lock);
+
+  for (uint32_t a = 0; a < fc->num_active; a++) {
+    const MagicFlowTuple *t = &fc->tuples[fc->active[a]];
+    uint32_t src = key->src_ip & flow_mask(t->src_plen);
+    uint32_t dst = key->dst_ip & flow_mask(t->dst_plen);
+    int32_t idx = t->buckets[flow_tuple_hash(src, dst) & (t->nbuckets - 1)];
+
+    for (; idx >= 0; idx = fc->entries[idx].tuple_next) {
+      const MagicFlowEntry *e = &fc->entries[idx];
+      if (e->rule.src_ip != src || e->rule.dst_ip != dst)
+        continue;
+      if (!flow_rule_matches_key(&e->rule, key))
+        continue;
+      if (best < 0 || flow_entry_better(e, &fc->entries[best]))
+        best = idx;
+    }
+  }
+
+  if (best >= 0 && match)
+    flow_fill_match(fc, best, match);
+
+  pthread_rwlock_unlock(&fc->lock);
+
+  __atomic_add_fetch(&fc->total_lookups, 1, __ATOMIC_RELAXED);
+  if (best >= 0)
+    __atomic_add_fetch(&fc->total_hits, 1, __ATOMIC_RELAXED);
+  return best >= 0 ? 0 : -1;
+}
+
+int magic_flow_find_conflicts(MagicFlowClassifier *fc,
+                              const MagicFlowRule *rule, MagicFlowMatch *out,
+                              int max_out) {
+  if (!fc || !fc->initialized || !rule || !out || max_out <= 0)
+    return 0;
+
+  uint32_t r_src = rule->src_ip & flow_mask(rule->src_plen);
+  uint32_t r_dst = rule->dst_ip & flow_mask(rule->dst_plen);
+  int found = 0;
+
+  pthread_rwlock_rdlock(&fc->lock);
+
+  for (uint32_t a = 0; a < fc->num_active && found < max_out; a++) {
+    const MagicFlowTuple *t = &fc->tuples[fc->active[a]];
+    uint32_t mask = t->nbuckets - 1;
+    bool src_coarse = t->src_plen <= rule->src_plen;
+    bool dst_coarse = t->dst_plen <= rule->dst_plen;
+
+    /* 组前缀两维都不比新规则更细: 只有一个 (src, dst) 桶可能相交；
+     * 仅源维不更细: 只有一个 src 桶可能相交；否则扫描整组 */
+    uint32_t b_first = 0, b_last = mask;
+    if (src_coarse) {
+      uint32_t src = r_src & flow_mask(t->src_plen);
+      b_first = b_last = dst_coarse ? flow_tuple_hash(
+                                          src, r_dst & flow_mask(t->dst_plen)) &
+                                          mask
+                                    : flow_src_hash(src) & mask;
+    }
+    bool by_src = src_coarse && !dst_coarse;
+
+    for (uint32_t b = b_first; b <= b_last && found < max_out; b++) {
+      int32_t idx = by_src ? t->src_buckets[b] : t->buckets[b];
+      while (idx >= 0 && found < max_out) {
+        const MagicFlowEntry *e = &fc->entries[idx];
+        idx = by_src ? e->src_next : e->tuple_next;
+        if (!flow_rules_overlap(&e->rule, rule))
+          continue;
+        if (strcmp(e->rule.session_id, rule->session_id) == 0)
+          continue;
+        flow_fill_match(fc, (int32_t)(e - fc->entries), &out[found++]);
+      }
+    }
+  }
+
+  pthread_rwlock_unlock(&fc->lock);
+
+  if (found > 0)
+    __atomic_add_fetch(&fc->total_conflicts, (uint64_t)found,
+                       __ATOMIC_RELAXED);
+  return found;
+}
+
+void magic_flow_dump(MagicFlowClassifier *fc) {
+  if (!fc || !fc->initialized)
+    return;
+
+  pthread_rwlock_rdlock(&fc->lock);
+  fd_log_notice("[app_magic] Flow classifier: %u rule(s) in %u tuple(s), "
+                "pool=%u",
+                fc->count, fc->num_active, fc->capacity);
+  for (uint32_t a = 0; a < fc->num_active; a++) {
+    const MagicFlowTuple *t = &fc->tuples[fc->active[a]];
+    fd_log_notice("[app_magic]   /%-2u src × /%-2u dst: %u rule(s), %u "
+                  "bucket(s)",
+                  t->src_plen, t->dst_plen, t->count, t->nbuckets);
+  }
+  pthread_rwlock_unlock(&fc->lock);
+
+  fd_log_notice("[app_magic]   lookups=%llu hits=%llu conflicts=%llu",
+                (unsigned long long)__atomic_load_n(&fc->total_lookups,
+                                                    __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&fc->total_hits,
+                                                    __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&fc->total_conflicts,
+                                                    __ATOMIC_RELAXED));
+}
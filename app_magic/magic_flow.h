@@ -0,0 +1,210 @@
+/**
+ * @file magic_flow.h
+ * @brief MAGIC 全局流分类器头文件。
+ * @details 把所有会话已生效的 TFT 规则放进同一个分类结构，提供:
+ *          - 五元组 → (会话, 承载, TFT 下标) 的流量归属查询
+ *          - MCAR/MCCR 时新 TFT 与其他会话已有 TFT 的重叠 (冲突) 检测
+ *
+ * 结构 (Tuple Space Search):
+ * - 规则按 (源前缀长度, 目的前缀长度) 分组，每组一张哈希表，
+ *   键为按该组掩码截断后的 (源 IP, 目的 IP)
+ * - 查询时对每个非空组做一次哈希探测，链上再比较协议与端口区间；
+ *   实际部署中前缀长度组合很少 (通常 /32 源 × 若干目的前缀)，
+ *   与规则总数基本无关
+ * - 命中多条时取 precedence 最小者，相同则取先插入者
+ * - 每组另有一张仅按源前缀的哈希表，冲突检测时若组内目的前缀比新规则
+ *   更细，可先按源地址缩小范围
+ * - 同一会话的规则另串一条链，会话结束时按会话整体删除
+ *
+ * IP 均为主机字节序；非 CIDR 对齐的地址范围按最小覆盖前缀收录。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_FLOW_H
+#define MAGIC_FLOW_H
+
+#include "magic_tft_validator.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FLOW_SESSION_ID_LEN 128     /* 会话 ID 最大长度 */
+#define FLOW_INITIAL_RULES 256      /* 规则池初始容量 (按需倍增) */
+#define FLOW_SESSION_BUCKETS 1024   /* 会话哈希桶数 (2 的幂) */
+#define FLOW_TUPLE_MIN_BUCKETS 16   /* 每组哈希表初始桶数 (2 的幂) */
+#define FLOW_MAX_CONFLICTS 16       /* 单条规则最多报告的冲突数 */
+
+/* 流量方向 (与 SessionTftRule.direction 一致) */
+#define FLOW_DIR_TO_GROUND 1   /* 机 → 地 (TFT-to-Ground) */
+#define FLOW_DIR_TO_AIRCRAFT 2 /* 地 → 机 (TFT-to-Aircraft) */
+
+/**
+ * @brief 分类规则。
+ */
+typedef struct {
+  uint32_t src_ip;       ///< 源网络地址。
+  uint32_t dst_ip;       ///< 目的网络地址。
+  uint8_t src_plen;      ///< 源前缀长度 (0 = 任意)。
+  uint8_t dst_plen;      ///< 目的前缀长度 (0 = 任意)。
+  uint8_t protocol;      ///< 协议号 (0 = 任意)。
+  uint8_t direction;     ///< FLOW_DIR_*。
+  uint16_t src_port_lo;  ///< 源端口下界。
+  uint16_t src_port_hi;  ///< 源端口上界。
+  uint16_t dst_port_lo;  ///< 目的端口下界。
+  uint16_t dst_port_hi;  ///< 目的端口上界。
+  uint16_t precedence;   ///< 评估优先级 (越小越先)。
+  uint8_t tft_index;     ///< 在会话 TFT 列表中的下标。
+  uint32_t bearer_id;    ///< 插入时会话的承载 ID。
+  char session_id[FLOW_SESSION_ID_LEN]; ///< 所属会话。
+} MagicFlowRule;
+
+/**
+ * @brief 查询键 (单个数据包的五元组)。
+ */
+typedef struct {
+  uint32_t src_ip;   ///< 源 IP。
+  uint32_t dst_ip;   ///< 目的 IP。
+  uint16_t src_port; ///< 源端口。
+  uint16_t dst_port; ///< 目的端口。
+  uint8_t protocol;  ///< 协议号。
+  uint8_t direction; ///< FLOW_DIR_*。
+} MagicFlowKey;
+
+/**
+ * @brief 查询/冲突结果。
+ */
+typedef struct {
+  char session_id[FLOW_SESSION_ID_LEN]; ///< 命中规则所属会话。
+  uint32_t bearer_id;                   ///< 命中规则的承载 ID。
+  uint8_t tft_index;                    ///< 命中规则的 TFT 下标。
+  uint32_t rule_id;                     ///< 规则池下标。
+} MagicFlowMatch;
+
+/**
+ * @brief 规则池条目 (内部使用)。
+ */
+typedef struct {
+  MagicFlowRule rule;
+  uint64_t seq;       ///< 插入序号 (同 precedence 时先插入者优先)。
+  int32_t tuple_next; ///< 组内 (src, dst) 哈希链后继 / 空闲链后继。
+  int32_t src_next;   ///< 组内 src 哈希链后继 (冲突检测用)。
+  int32_t sess_next;  ///< 会话链后继。
+  int16_t tuple_idx;  ///< 所属组下标。
+  bool in_use;        ///< 是否在使用。
+} MagicFlowEntry;
+
+/**
+ * @brief 前缀长度组 (内部使用)。
+ */
+typedef struct {
+  uint8_t src_plen;   ///< 源前缀长度。
+  uint8_t dst_plen;   ///< 目的前缀长度。
+  uint32_t count;     ///< 组内规则数。
+  uint32_t nbuckets;  ///< 哈希桶数 (2 的幂)。
+  int32_t *buckets;   ///< (src, dst) 哈希桶 (规则池下标, -1 = 空)。
+  int32_t *src_buckets; ///< 仅按 src 的哈希桶 (与 buckets 同大小)。
+} MagicFlowTuple;
+
+/**
+ * @brief 流分类器上下文。
+ */
+typedef struct {
+  MagicFlowEntry *entries; ///< 规则池。
+  uint32_t capacity;       ///< 规则池容量。
+  uint32_t count;          ///< 使用中的规则数。
+  int32_t free_head;       ///< 空闲链表头。
+  uint64_t next_seq;       ///< 下一个插入序号。
+
+  MagicFlowTuple tuples[33 * 33]; ///< 按 src_plen*33+dst_plen 索引。
+  uint16_t active[33 * 33];       ///< 非空组下标列表。
+  uint32_t num_active;            ///< 非空组数量。
+
+  int32_t sess_buckets[FLOW_SESSION_BUCKETS]; ///< 会话哈希桶。
+
+  /* 统计 */
+  uint64_t total_lookups;   ///< 查询次数。
+  uint64_t total_hits;      ///< 命中次数。
+  uint64_t total_conflicts; ///< 报告的冲突数。
+
+  pthread_rwlock_t lock; ///< 查询共享、增删独占。
+  bool initialized;      ///< 是否已初始化。
+} MagicFlowClassifier;
+
+/**
+ * @brief 初始化流分类器。
+ * @param fc 分类器上下文。
+ * @return 0 成功，-1 失败。
+ */
+int magic_flow_init(MagicFlowClassifier *fc);
+
+/**
+ * @brief 清理流分类器。
+ * @param fc 分类器上下文。
+ */
+void magic_flow_cleanup(MagicFlowClassifier *fc);
+
+/**
+ * @brief 由解析后的 TFT 构造分类规则 (会话字段由调用方填写)。
+ * @details 与数据平面 mangle 规则保持一致: 给定 client_ip 时客户端一侧
+ *          (TO_GROUND 的源、TO_AIRCRAFT 的目的) 取 client_ip/32，否则取
+ *          TFT 中的地址范围。
+ *
+ * @param tft 解析后的 TFT。
+ * @param client_ip 客户端 IP 字符串 (可为 NULL)。
+ * @param direction FLOW_DIR_*。
+ * @param rule 输出规则。
+ * @return 0 成功，-1 参数错误。
+ */
+int magic_flow_rule_from_tft(const TFTRule *tft, const char *client_ip,
+                             uint8_t direction, MagicFlowRule *rule);
+
+/**
+ * @brief 插入一条规则。
+ * @param fc 分类器上下文。
+ * @param rule 规则 (session_id 必填)。
+ * @return 规则池下标 (>= 0)，-1 失败。
+ */
+int magic_flow_insert(MagicFlowClassifier *fc, const MagicFlowRule *rule);
+
+/**
+ * @brief 删除会话的全部规则。
+ * @param fc 分类器上下文。
+ * @param session_id 会话 ID。
+ * @return 删除的规则数。
+ */
+int magic_flow_remove_session(MagicFlowClassifier *fc, const char *session_id);
+
+/**
+ * @brief 查询五元组所属会话。
+ * @param fc 分类器上下文。
+ * @param key 五元组。
+ * @param match 输出命中结果。
+ * @return 0 命中，-1 未命中。
+ */
+int magic_flow_lookup(MagicFlowClassifier *fc, const MagicFlowKey *key,
+                      MagicFlowMatch *match);
+
+/**
+ * @brief 查找与给定规则重叠的其他会话规则。
+ * @details 两条规则同方向、源/目的前缀相交、协议相容且端口区间均相交时
+ *          视为冲突。与 rule->session_id 相同的规则不计入。
+ *
+ * @param fc 分类器上下文。
+ * @param rule 待检测规则。
+ * @param out 输出冲突列表。
+ * @param max_out 列表容量。
+ * @return 冲突数 (不超过 max_out)。
+ */
+int magic_flow_find_conflicts(MagicFlowClassifier *fc,
+                              const MagicFlowRule *rule, MagicFlowMatch *out,
+                              int max_out);
+
+/**
+ * @brief 打印分类器统计。
+ * @param fc 分类器上下文。
+ */
+void magic_flow_dump(MagicFlowClassifier *fc);
+
+#endif /* MAGIC_FLOW_H */
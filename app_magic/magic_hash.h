@@ -0,0 +1,53 @@
+/**
+ * @file magic_hash.h
+ * @brief MAGIC 内部共用的 FNV-1a 哈希。
+ * @details 会话 ID、客户端 ID、对端名等字符串键的哈希表统一使用 32 位
+ *          FNV-1a；配置缓存的内容签名使用可分段累加的 64 位 FNV-1a。
+ *          仅用于内存索引与一致性校验，不具备抗碰撞攻击能力。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_HASH_H
+#define MAGIC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAGIC_FNV32_OFFSET 2166136261u            /* 32 位初始值 */
+#define MAGIC_FNV32_PRIME 16777619u               /* 32 位乘数 */
+#define MAGIC_FNV64_OFFSET 1469598103934665603ull /* 64 位初始值 */
+#define MAGIC_FNV64_PRIME 1099511628211ull        /* 64 位乘数 */
+
+/**
+ * @brief 以 NUL 结尾字符串的 32 位 FNV-1a 哈希。
+ * @details 结果未截断，调用方按桶数取掩码或取模。
+ */
+static inline uint32_t magic_fnv1a32_str(const char *s) {
+  uint32_t h = MAGIC_FNV32_OFFSET;
+  for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+    h ^= *p;
+    h *= MAGIC_FNV32_PRIME;
+  }
+  return h;
+}
+
+/**
+ * @brief 把一段数据累加进 64 位 FNV-1a 哈希。
+ * @param h 当前哈希值，首段传 MAGIC_FNV64_OFFSET。
+ * @param data 数据。
+ * @param len 数据长度。
+ * @return 累加后的哈希值。
+ */
+static inline uint64_t magic_fnv1a64(uint64_t h, const void *data,
+                                     size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= MAGIC_FNV64_PRIME;
+  }
+  return h;
+}
+
+#endif /* MAGIC_HASH_H */
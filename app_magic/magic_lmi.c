@@ -8,9 +8,8 @@
  *          - MIH 原语的处理与转发。
  *
  * 架构：
- * - 主线程：管理服务器 Socket 和客户端列表。
- * - 客户端线程：每个连接的 DLM 独占一个线程处理消息交互。
- * - 监控线程：处理心跳超时和死连接清理。
+ * - 事件循环线程：以 epoll 统一处理全部 DLM 连接、数据报与 UDP 心跳。
+ * - 超时定时器：按各 DLM 学习到的心跳节奏检测掉线，并处理资源请求超时。
  *
  * @author MAGIC System Development Team
  * @date 2025-11-30
@@ -24,7 +23,10 @@
 #include <errno.h>                  /* 错误码定义 */
 #include <freeDiameter/extension.h> /* freeDiameter 扩展框架 */
 #include <string.h>                 /* 字符串操作函数 */
+#include <sys/epoll.h>              /* 事件循环 */
+#include <sys/eventfd.h>            /* 事件循环唤醒 */
 #include <sys/socket.h>             /* Socket API */
+#include <sys/timerfd.h>            /* 超时定时器 */
 #include <sys/un.h>                 /* Unix Domain Socket */
 #include <unistd.h>                 /* Unix 标准函数 */
 
@@ -37,9 +39,94 @@
 /* 心跳监控配置 */
 #define HEARTBEAT_TIMEOUT_SEC                                                  \
   30 /* 心跳超时时间 (秒) - DLM 无响应超过此时间判定为掉线 */
-#define MONITOR_CHECK_INTERVAL_SEC                                             \
-  10 /* 监控检查间隔 (秒) - 监控线程扫描周期                    \
-      */
+/* 自适应心跳检测 (phi-accrual 风格): 截止时刻 = 间隔均值 + 因子 × 抖动 */
+#define LMI_HB_MIN_SAMPLES 3  /* 间隔样本不足时退回固定超时 */
+#define LMI_HB_DEV_FACTOR 7   /* 平均偏差倍数, 正态近似下约 phi = 8 */
+#define LMI_HB_MIN_DEV_MS 100 /* 抖动下限 (毫秒), 吸收调度与网络延迟 */
+#define LMI_HB_MEAN_FLOOR 3   /* 截止下限: 间隔均值的倍数 (容忍丢 2 个) */
+#define LMI_HB_PAUSE_MS 1000  /* 停顿余量 (毫秒): DLM/本进程的调度停顿 */
+
+/* 链路质量趋势 (预测性切换): 预测值在窗口内越过判据即判定劣化 */
+#define LMI_QUALITY_ALPHA 0.3             /* 平滑系数 */
+#define LMI_QUALITY_MIN_SAMPLES 3         /* 判定前的最少参数报告数 */
+#define LMI_QUALITY_HORIZON_MS 5000       /* 预测窗口 (毫秒) */
+#define LMI_QUALITY_RSSI_FLOOR_DBM -90.0  /* 信号强度下限 */
+#define LMI_QUALITY_BW_MIN_RATIO 0.25     /* 可用带宽低于基线的比例 */
+#define LMI_QUALITY_LATENCY_MAX_RATIO 3.0 /* 延迟超过基线的倍数 */
+#define LMI_QUALITY_RECOVER_REPORTS 3     /* 连续健康报告数后解除劣化 */
+
+/* 共享内存链路状态: DLM 每秒发布一次, 超过此时长未更新视为不可用 */
+#define LMI_LINKSTATE_FRESH_MS 5000
+
+#define LMI_EPOLL_BATCH 32   /* 事件循环单次 epoll_wait 处理的事件数 */
+#define LMI_SEQ_BATCH 32     /* 顺序包连接单次可读事件最多接收的记录数 */
+#define LMI_RX_PAD_SIZE 4096 /* 短帧补零到此长度, 处理函数可按结构体读取 */
+
+/* 本线程当前应使用的配置快照 (反应器每批事件处于一个读临界区内) */
+static inline MagicConfig *lmi_config(MagicLmiContext *ctx) {
+  return magic_config_current(ctx->config_store);
+}
+
+/* DLM 客户端表访问 (槽位内容受 clients_mutex 保护) */
+static inline int lmi_client_capacity(MagicLmiContext *ctx) {
+  return (int)magic_pool_capacity(&ctx->clients);
+}
+
+static inline DlmClient *lmi_client(MagicLmiContext *ctx, int idx) {
+  return (DlmClient *)magic_pool_at(&ctx->clients, (uint32_t)idx);
+}
+
+static inline LmiClientAux *lmi_client_aux(MagicLmiContext *ctx, int idx) {
+  return (LmiClientAux *)magic_pool_at(&ctx->client_aux, (uint32_t)idx);
+}
+
+static inline pthread_mutex_t *lmi_client_lock(MagicLmiContext *ctx, int idx) {
+  return &lmi_client_aux(ctx, idx)->lock;
+}
+
+static void lmi_client_aux_init(void *elem) {
+  pthread_mutex_init(&((LmiClientAux *)elem)->lock, NULL);
+}
+
+static void lmi_client_aux_fini(void *elem) {
+  pthread_mutex_destroy(&((LmiClientAux *)elem)->lock);
+}
+
+/**
+ * @brief 取一个未注册的 DLM 客户端槽位，表满时扩容 (持 clients_mutex 调用)。
+ * @return 槽位下标，内存不足时返回 -1。
+ */
+static int lmi_client_alloc_locked(MagicLmiContext *ctx) {
+  int cap = lmi_client_capacity(ctx);
+  for (int i = 0; i < cap; i++) {
+    if (!lmi_client(ctx, i)->is_registered) {
+      return i;
+    }
+  }
+
+  /* 先扩辅助表: 遍历以 clients 容量为界，界内的锁总是已初始化 */
+  if (magic_pool_capacity(&ctx->client_aux) <= (uint32_t)cap &&
+      magic_pool_grow(&ctx->client_aux, lmi_client_aux_init) < 0) {
+    return -1;
+  }
+  int idx = magic_pool_grow(&ctx->clients, NULL);
+  if (idx >= 0) {
+    fd_log_notice("[app_magic] DLM client table grown to %d slots",
+                  lmi_client_capacity(ctx));
+  }
+  return idx;
+}
+
+/* 事件循环 epoll 标签 (流式连接为 LMI_EV_CONN + 槽位下标) */
+enum {
+  LMI_EV_WAKE = 1,   /* 唤醒 eventfd */
+  LMI_EV_TIMER,      /* 超时 timerfd */
+  LMI_EV_LISTEN,     /* 流式监听 Socket */
+  LMI_EV_LISTEN_SEQ, /* 顺序包监听 Socket */
+  LMI_EV_DGRAM,      /* 数据报 Socket */
+  LMI_EV_UDP,        /* UDP 心跳 Socket */
+  LMI_EV_CONN = 0x100
+};
 
 /*===========================================================================
  * IPC 协议定义 (Inter-Process Communication)
@@ -206,10 +293,17 @@ typedef struct {
 } __attribute__((packed)) MsgMihResourceResp;
 
 /* 前向声明 - 声明将在后面定义的函数 */
-static void *dlm_server_thread(void *arg);             /* DLM 服务器主线程 */
-static void *handle_dlm_client_thread(void *arg);      /* DLM 客户端处理线程 */
-static void *heartbeat_monitor_thread_func(void *arg); /* 心跳监控线程 */
-static void *udp_listener_thread(void *arg);           /* UDP 监听线程 */
+static int lmi_reactor_add(MagicLmiContext *ctx, int fd,
+                           uint32_t tag);           /* 注册到事件循环 */
+static void lmi_reactor_stop(MagicLmiContext *ctx); /* 停止事件循环 */
+static uint64_t lmi_pending_expire(MagicLmiContext *ctx,
+                                   uint64_t now_ms); /* 资源请求超时 */
+static void
+handle_mih_resource_confirm(MagicLmiContext *ctx, int client_fd,
+                            uint32_t transaction_id,
+                            const LINK_Resource_Confirm *cnf); /* 资源确认 */
+static void lmi_fail_client_pending(MagicLmiContext *ctx,
+                                    int client_idx); /* DLM 断开 */
 static __attribute__((unused)) int
 send_ipc_msg(int fd, uint8_t type, const void *payload,
              uint32_t payload_len); /* 发送 IPC 消息 */
@@ -231,6 +325,278 @@ static void handle_udp_heartbeat(MagicLmiContext *ctx,
                                  const void *data,
                                  size_t data_len); /* 处理 UDP 心跳 */
 
+/*===========================================================================
+ * DLM 存活检测 (自适应心跳截止时刻)
+ *
+ * 对每个 DLM 学习周期性消息 (心跳/参数报告) 的到达间隔均值与抖动,
+ * 按 RFC 6298 风格的整数 EWMA 平滑。当等待时间超过
+ * `均值 + LMI_HB_DEV_FACTOR × 抖动` 时, 下一次心跳按正态近似
+ * 仍会到达的概率约为 1e-8 (phi ≈ 8), 即判定 DLM 掉线。
+ * 节奏极稳时抖动趋近于零, 因此截止时刻不低于 LMI_HB_MEAN_FLOOR 倍均值,
+ * 并另加 LMI_HB_PAUSE_MS 吸收偶发停顿。
+ * 心跳与参数报告节奏不同, 混在一起会把抖动估大或把均值估小; 每个 DLM
+ * 只用一种来源学习, 有心跳时以心跳为准, 仅无心跳的数据报 DLM 使用参数报告。
+ * 样本不足时退回 HEARTBEAT_TIMEOUT_SEC, 且自适应截止时刻不超过该值。
+ *===========================================================================*/
+
+/**
+ * @brief 记录一次 DLM 消息到达 (调用者须持有 clients_mutex)。
+ *
+ * @param client DLM 客户端。
+ * @param src 消息来源; 心跳/参数报告用于学习到达间隔。
+ */
+static void lmi_client_seen(DlmClient *client, LmiSeenSource src) {
+  uint64_t now_ms = magic_timer_now_ms();
+
+  client->last_seen = time(NULL);
+  client->last_seen_ms = now_ms;
+  if (src == LMI_SEEN_OTHER) {
+    return;
+  }
+
+  if (client->hb_source != src) {
+    if (client->hb_source == LMI_SEEN_HEARTBEAT) {
+      return; /* 已按心跳学习, 参数报告只刷新可见时间 */
+    }
+    /* 首个周期来源, 或心跳取代参数报告: 从头学习 */
+    client->hb_source = src;
+    client->hb_last_ms = 0;
+    client->hb_samples = 0;
+  }
+
+  if (client->hb_last_ms != 0 && now_ms > client->hb_last_ms) {
+    uint64_t gap = now_ms - client->hb_last_ms;
+    uint32_t sample =
+        gap > UINT32_MAX / 8 ? UINT32_MAX / 8 : (uint32_t)gap; /* 防溢出 */
+
+    if (client->hb_samples == 0) {
+      client->hb_mean_ms = sample;
+      client->hb_dev_ms = sample / 2;
+    } else {
+      uint32_t err = sample > client->hb_mean_ms ? sample - client->hb_mean_ms
+                                                 : client->hb_mean_ms - sample;
+      client->hb_dev_ms = (3 * client->hb_dev_ms + err) / 4;
+      client->hb_mean_ms = (7 * client->hb_mean_ms + sample) / 8;
+    }
+    if (client->hb_samples < UINT32_MAX) {
+      client->hb_samples++;
+    }
+  }
+  client->hb_last_ms = now_ms;
+}
+
+/**
+ * @brief 计算 DLM 的掉线判定时刻 (单调时钟毫秒)。
+ * @details 以最后一次收到任意消息的时刻为基准: 已学习到心跳节奏时使用
+ *          自适应截止, 否则 (或自适应值更大时) 使用 HEARTBEAT_TIMEOUT_SEC。
+ */
+static uint64_t lmi_client_deadline(const DlmClient *client) {
+  uint64_t limit = (uint64_t)HEARTBEAT_TIMEOUT_SEC * 1000ULL;
+
+  if (client->hb_samples >= LMI_HB_MIN_SAMPLES) {
+    uint32_t dev = client->hb_dev_ms > LMI_HB_MIN_DEV_MS ? client->hb_dev_ms
+                                                         : LMI_HB_MIN_DEV_MS;
+    uint64_t adaptive =
+        (uint64_t)client->hb_mean_ms + (uint64_t)LMI_HB_DEV_FACTOR * dev;
+    uint64_t floor_ms = (uint64_t)LMI_HB_MEAN_FLOOR * client->hb_mean_ms;
+    if (adaptive < floor_ms) {
+      adaptive = floor_ms;
+    }
+    adaptive += LMI_HB_PAUSE_MS;
+    if (adaptive < limit) {
+      limit = adaptive;
+    }
+  }
+  return client->last_seen_ms + limit;
+}
+
+/*===========================================================================
+ * 链路质量趋势跟踪 (预测性切换)
+ *
+ * 对 DLM 参数报告中的信号强度、可用带宽与延迟分别做 EWMA 平滑并估计
+ * 变化率, 以 LMI_QUALITY_HORIZON_MS 为窗口线性外推。任一指标的预测值
+ * 越过判据时发出 LINK_EVENT_GOING_DOWN, 使 MAGIC 在主链路真正中断前
+ * 于备用链路上先建后拆 (make-before-break)。DLM 主动发送的
+ * Link_Going_Down.indication 走同一路径。
+ *===========================================================================*/
+
+/**
+ * @brief 质量状态变化。
+ */
+typedef enum {
+  LMI_QUALITY_STEADY = 0, /* 无变化 */
+  LMI_QUALITY_DEGRADING,  /* 进入劣化 */
+  LMI_QUALITY_RECOVERED   /* 解除劣化 */
+} LmiQualityChange;
+
+/**
+ * @brief 用一个新样本更新指标的平滑值与变化率。
+ */
+static void lmi_trend_update(LmiQualityTrend *trend, double value,
+                             double dt_sec, bool first) {
+  if (first) {
+    trend->ewma = value;
+    trend->slope = 0.0;
+    return;
+  }
+
+  double prev = trend->ewma;
+  trend->ewma += LMI_QUALITY_ALPHA * (value - prev);
+  if (dt_sec > 0.0) {
+    double rate = (trend->ewma - prev) / dt_sec;
+    trend->slope += LMI_QUALITY_ALPHA * (rate - trend->slope);
+  }
+}
+
+/**
+ * @brief 按变化率外推预测窗口结束时的指标值。
+ */
+static double lmi_trend_predict(const LmiQualityTrend *trend) {
+  return trend->ewma + trend->slope * (LMI_QUALITY_HORIZON_MS / 1000.0);
+}
+
+/**
+ * @brief 用参数报告更新链路质量趋势 (调用者须持有 clients_mutex)。
+ *
+ * @param client DLM 客户端。
+ * @param params 报告中的链路参数 (0 表示该项未上报)。
+ * @param[out] ind 进入劣化时填充的预测性 Going_Down 指示。
+ * @return 质量状态变化。
+ */
+static LmiQualityChange lmi_quality_update(DlmClient *client,
+                                           const LINK_PARAMETERS *params,
+                                           LINK_Going_Down_Indication *ind) {
+  LmiLinkQuality *q = &client->quality;
+  uint64_t now_ms = magic_timer_now_ms();
+  bool first = (q->samples == 0);
+  double dt_sec = first ? 0.0 : (now_ms - q->last_report_ms) / 1000.0;
+
+  if (params->signal_strength_dbm != 0) {
+    lmi_trend_update(&q->rssi, params->signal_strength_dbm, dt_sec,
+                     q->rssi.ewma == 0.0);
+  }
+  if (params->available_bandwidth_kbps != 0 || q->bandwidth.baseline > 0.0) {
+    lmi_trend_update(&q->bandwidth, params->available_bandwidth_kbps, dt_sec,
+                     q->bandwidth.baseline == 0.0);
+    if (q->bandwidth.ewma > q->bandwidth.baseline) {
+      q->bandwidth.baseline = q->bandwidth.ewma;
+    }
+  }
+  if (params->current_latency_ms != 0) {
+    lmi_trend_update(&q->latency, params->current_latency_ms, dt_sec,
+                     q->latency.baseline == 0.0);
+    if (q->latency.baseline == 0.0 || q->latency.ewma < q->latency.baseline) {
+      q->latency.baseline = q->latency.ewma;
+    }
+  }
+  q->last_report_ms = now_ms;
+  if (++q->samples < LMI_QUALITY_MIN_SAMPLES) {
+    return LMI_QUALITY_STEADY;
+  }
+
+  /* 逐项判定预测值是否越过劣化判据 */
+  const char *cause = NULL;
+  int hits = 0;
+  double rssi = lmi_trend_predict(&q->rssi);
+  if (q->rssi.ewma != 0.0 && rssi < LMI_QUALITY_RSSI_FLOOR_DBM) {
+    cause = "signal strength falling";
+    hits++;
+  }
+  if (q->bandwidth.baseline > 0.0 &&
+      lmi_trend_predict(&q->bandwidth) <
+          q->bandwidth.baseline * LMI_QUALITY_BW_MIN_RATIO) {
+    cause = cause ? cause : "available bandwidth collapsing";
+    hits++;
+  }
+  if (q->latency.baseline > 0.0 &&
+      lmi_trend_predict(&q->latency) >
+          q->latency.baseline * LMI_QUALITY_LATENCY_MAX_RATIO) {
+    cause = cause ? cause : "latency rising";
+    hits++;
+  }
+
+  if (hits == 0) {
+    /* 劣化状态下需连续健康且超过保持时间才解除 */
+    if (q->degrading && ++q->healthy_streak >= LMI_QUALITY_RECOVER_REPORTS &&
+        now_ms >= q->hold_until_ms) {
+      q->degrading = false;
+      return LMI_QUALITY_RECOVERED;
+    }
+    return LMI_QUALITY_STEADY;
+  }
+
+  q->healthy_streak = 0;
+  if (q->degrading) {
+    return LMI_QUALITY_STEADY;
+  }
+
+  /* 估计距离中断的时间: 信号强度按当前下降速率到达下限, 否则取预测窗口 */
+  uint32_t time_to_down_ms = LMI_QUALITY_HORIZON_MS;
+  if (q->rssi.slope < 0.0 && q->rssi.ewma > LMI_QUALITY_RSSI_FLOOR_DBM) {
+    double ms =
+        (LMI_QUALITY_RSSI_FLOOR_DBM - q->rssi.ewma) / q->rssi.slope * 1000.0;
+    if (ms < time_to_down_ms) {
+      time_to_down_ms = (uint32_t)ms;
+    }
+  } else if (q->rssi.ewma != 0.0 &&
+             q->rssi.ewma <= LMI_QUALITY_RSSI_FLOOR_DBM) {
+    time_to_down_ms = 0;
+  }
+
+  memset(ind, 0, sizeof(*ind));
+  memcpy(&ind->link_identifier, &client->link_identifier,
+         sizeof(LINK_TUPLE_ID));
+  ind->time_to_down_ms = time_to_down_ms;
+  ind->reason_code = LINK_DOWN_REASON_SIGNAL_LOSS;
+  ind->confidence = (uint8_t)(hits >= 3 ? 100 : 40 + 30 * hits);
+  snprintf(ind->reason_text, sizeof(ind->reason_text), "predicted: %s", cause);
+
+  q->degrading = true;
+  q->hold_until_ms = now_ms + time_to_down_ms;
+  return LMI_QUALITY_DEGRADING;
+}
+
+/**
+ * @brief 将 DLM 主动发送的 Going_Down 指示记入质量状态 (须持有 clients_mutex)。
+ * @return 首次进入劣化时返回 LMI_QUALITY_DEGRADING。
+ */
+static LmiQualityChange
+lmi_quality_going_down(DlmClient *client,
+                       const LINK_Going_Down_Indication *ind) {
+  LmiLinkQuality *q = &client->quality;
+  uint64_t hold = magic_timer_now_ms() + ind->time_to_down_ms;
+
+  q->healthy_streak = 0;
+  if (hold > q->hold_until_ms) {
+    q->hold_until_ms = hold;
+  }
+  if (q->degrading) {
+    return LMI_QUALITY_STEADY;
+  }
+  q->degrading = true;
+  return LMI_QUALITY_DEGRADING;
+}
+
+/**
+ * @brief 分发质量状态变化 (在锁外调用)。
+ * @details 进入劣化时触发 LINK_EVENT_GOING_DOWN, 事件数据为
+ *          `LINK_Going_Down_Indication`; 解除劣化仅记录日志,
+ *          策略引擎在下一次选路时自然恢复使用该链路。
+ */
+static void lmi_quality_notify(MagicLmiContext *ctx, const char *link_id,
+                               LmiQualityChange change,
+                               const LINK_Going_Down_Indication *ind) {
+  if (change == LMI_QUALITY_DEGRADING) {
+    fd_log_notice("[app_magic] ⚠ Link %s degrading: %.*s (down in ~%u ms, "
+                  "confidence %u%%)",
+                  link_id, (int)sizeof(ind->reason_text), ind->reason_text,
+                  ind->time_to_down_ms, ind->confidence);
+    trigger_lmi_event_callbacks(ctx, link_id, LINK_EVENT_GOING_DOWN, ind);
+  } else if (change == LMI_QUALITY_RECOVERED) {
+    fd_log_notice("[app_magic] ✓ Link %s quality recovered", link_id);
+  }
+}
+
 /*===========================================================================
  * LMI 基础 API 函数实现
  *
@@ -257,16 +623,30 @@ int magic_lmi_init(MagicLmiContext *ctx) {
   /* 初始化上下文为零值 */
   memset(ctx, 0, sizeof(MagicLmiContext));
   ctx->server_fd = -1;                    /* 流式服务器 Socket 未初始化 */
+  ctx->seq_server_fd = -1;                /* 顺序包服务器 Socket 未初始化 */
   ctx->dgram_fd = -1;                     /* 数据报服务器 Socket 未初始化 */
   ctx->udp_fd = -1;                       /* UDP 监听服务器 Socket 未初始化 */
   ctx->running = false;                   /* 流式服务器未运行 */
   ctx->dgram_running = false;             /* 数据报服务器未运行 */
   ctx->udp_running = false;               /* UDP 监听服务器未运行 */
-  ctx->heartbeat_monitor_running = false; /* 心跳监控线程未运行 */
+  ctx->reactor_running = false;           /* 事件循环未运行 */
+  ctx->epoll_fd = -1;                     /* 事件循环未创建 */
+  ctx->timer_fd = -1;                     /* 超时定时器未创建 */
+  ctx->wake_fd = -1;                      /* 唤醒 eventfd 未创建 */
   ctx->udp_port = 1947;                   /* 默认 UDP 监听端口 */
+  ctx->linkstate = NULL;                  /* 共享链路状态表未映射 */
+  for (int i = 0; i < LMI_MAX_CONNECTIONS; i++) {
+    ctx->conns[i].fd = -1; /* 流式连接槽位空闲 */
+  }
 
   /* 初始化客户端管理互斥锁 */
   pthread_mutex_init(&ctx->clients_mutex, NULL);
+  magic_pool_init(&ctx->clients, sizeof(DlmClient), MAGIC_DLM_CLIENT_CHUNK);
+  magic_pool_init(&ctx->client_aux, sizeof(LmiClientAux),
+                  MAGIC_DLM_CLIENT_CHUNK);
+
+  /* 初始化异步资源请求在途表 */
+  pthread_mutex_init(&ctx->pending_mutex, NULL);
 
   /* 初始化事件回调机制 */
   pthread_mutex_init(&ctx->callbacks_mutex, NULL);
@@ -288,14 +668,25 @@ int magic_lmi_init(MagicLmiContext *ctx) {
  * @param config 指向 MAGIC 配置的指针
  * @return 0=成功, -1=失败
  */
-int magic_lmi_start_server(MagicLmiContext *ctx, MagicConfig *config) {
+int magic_lmi_start_server(MagicLmiContext *ctx, MagicConfigStore *store) {
   /* 参数验证 */
-  if (!ctx || !config) {
+  if (!ctx || !store) {
     return -1; /* 参数无效 */
   }
 
-  /* 保存配置引用 */
-  ctx->config = config;
+  /* 保存配置存储 */
+  ctx->config_store = store;
+
+  /* 先于监听创建共享链路状态表, DLM 连接后即可附着; 失败仅降级为 Socket 上报 */
+  ctx->linkstate = mih_linkstate_create();
+  if (ctx->linkstate) {
+    fd_log_notice("[app_magic] Shared link-state table at %s",
+                  MIH_LINKSTATE_PATH);
+  } else {
+    fd_log_error("[app_magic] ⚠ Shared link-state table unavailable (%s), "
+                 "falling back to socket reports",
+                 strerror(errno));
+  }
 
   /* 创建 Unix Domain Socket */
   ctx->server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
@@ -327,26 +718,34 @@ int magic_lmi_start_server(MagicLmiContext *ctx, MagicConfig *config) {
     return -1; /* 监听失败 */
   }
 
-  /* 启动服务器线程 */
+  /* 交给事件循环接受连接 (心跳与请求超时也由其负责) */
   ctx->running = true;
-  if (pthread_create(&ctx->server_thread, NULL, dlm_server_thread, ctx) != 0) {
-    fd_log_error("[app_magic] Failed to create DLM server thread");
+  if (lmi_reactor_add(ctx, ctx->server_fd, LMI_EV_LISTEN) != 0) {
+    fd_log_error("[app_magic] Failed to start LMI event loop");
+    ctx->running = false;
     close(ctx->server_fd);
-    return -1; /* 线程创建失败 */
+    ctx->server_fd = -1;
+    return -1; /* 事件循环启动失败 */
   }
 
-  /* 启动心跳监控线程 */
-  ctx->heartbeat_monitor_running = true;
-  if (pthread_create(&ctx->heartbeat_monitor_thread, NULL,
-                     heartbeat_monitor_thread_func, ctx) != 0) {
-    fd_log_error("[app_magic] Failed to create heartbeat monitor thread");
-    ctx->running = false;
-    close(ctx->server_fd);
-    return -1; /* 线程创建失败 */
+  /* 顺序包监听 (保留消息边界, DLM 优先使用); 失败时 DLM 回退到流式 */
+  ctx->seq_server_fd = mih_transport_create_seqpacket_server(
+      MIH_SEQPACKET_SOCKET_PATH);
+  if (ctx->seq_server_fd >= 0 &&
+      lmi_reactor_add(ctx, ctx->seq_server_fd, LMI_EV_LISTEN_SEQ) != 0) {
+    close(ctx->seq_server_fd);
+    unlink(MIH_SEQPACKET_SOCKET_PATH);
+    ctx->seq_server_fd = -1;
+  }
+  if (ctx->seq_server_fd < 0) {
+    fd_log_error("[app_magic] ⚠ SEQPACKET listener unavailable, "
+                 "DLMs will use the stream socket");
   }
 
   /* 记录服务器启动成功 */
-  fd_log_notice("[app_magic] DLM server started on %s", DLM_SOCK_PATH);
+  fd_log_notice("[app_magic] DLM server started on %s (seqpacket: %s)",
+                DLM_SOCK_PATH,
+                ctx->seq_server_fd >= 0 ? MIH_SEQPACKET_SOCKET_PATH : "off");
   return 0;
 }
 
@@ -368,12 +767,12 @@ DlmClient *magic_lmi_find_by_link(MagicLmiContext *ctx, const char *link_id) {
   /* 在客户端数组中查找匹配的链路 */
   pthread_mutex_lock(&ctx->clients_mutex);
 
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        strcmp(ctx->clients[i].link_id, link_id) == 0) {
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        strcmp(lmi_client(ctx, i)->link_id, link_id) == 0) {
       /* 找到匹配的客户端 */
       pthread_mutex_unlock(&ctx->clients_mutex);
-      return &ctx->clients[i];
+      return lmi_client(ctx, i);
     }
   }
 
@@ -382,6 +781,20 @@ DlmClient *magic_lmi_find_by_link(MagicLmiContext *ctx, const char *link_id) {
   return NULL;
 }
 
+/**
+ * @brief DLM 客户端表当前容量。
+ */
+int magic_lmi_client_capacity(MagicLmiContext *ctx) {
+  return ctx ? lmi_client_capacity(ctx) : 0;
+}
+
+/**
+ * @brief 按下标取 DLM 客户端槽位。
+ */
+DlmClient *magic_lmi_client_at(MagicLmiContext *ctx, int index) {
+  return ctx && index >= 0 ? lmi_client(ctx, index) : NULL;
+}
+
 /**
  * @brief 更新链路状态
  *
@@ -394,19 +807,50 @@ DlmClient *magic_lmi_find_by_link(MagicLmiContext *ctx, const char *link_id) {
 void magic_lmi_update_link_status(MagicLmiContext *ctx, const char *link_id,
                                   bool is_active) {
   /* 参数验证 */
-  if (!ctx || !ctx->config) {
+  if (!ctx || !ctx->config_store) {
     return; /* 参数无效 */
   }
 
   /* 在配置中查找链路并更新状态 */
-  DatalinkProfile *link = magic_config_find_datalink(ctx->config, link_id);
+  DatalinkProfile *link = magic_config_find_datalink(lmi_config(ctx), link_id);
   if (link) {
-    link->is_active = is_active;
+    magic_config_set_link_active(ctx->config_store, link->dlm_name, is_active);
     fd_log_notice("[app_magic] Link %s status: %s", link_id,
                   is_active ? "ACTIVE" : "INACTIVE");
   }
 }
 
+/**
+ * @brief 无锁读取 DLM 发布的链路状态
+ *
+ * 快照由 DLM 以 seqlock 写入共享内存, 此处仅做内存读取;
+ * 超过 LMI_LINKSTATE_FRESH_MS 未更新说明 DLM 已停止发布, 视为不可用。
+ * 快照仅供参考 (见 mih_linkstate.h), 调用者只能据此降低链路的可选性
+ *
+ * @param ctx 指向 LMI 上下文的指针
+ * @param link_id 链路标识符
+ * @param state [out] 链路状态快照
+ * @return 0=成功, -1=无可用的新鲜快照
+ */
+int magic_lmi_read_link_state(MagicLmiContext *ctx, const char *link_id,
+                              mih_linkstate_snapshot_t *state) {
+  if (!ctx || !ctx->linkstate || !link_id || !state) {
+    return -1; /* 参数无效或共享区不可用 */
+  }
+
+  if (mih_linkstate_read(ctx->linkstate, link_id, state) != 0) {
+    return -1; /* 该链路未发布状态 */
+  }
+
+  if (mih_linkstate_now_ms() - state->update_ms > LMI_LINKSTATE_FRESH_MS) {
+    return -1; /* 快照过期 */
+  }
+  if (state->link_state > LINK_STATE_GOING_UP) {
+    return -1; /* 取值非法, 不可信 */
+  }
+  return 0;
+}
+
 /**
  * @brief 清理 LMI 接口
  *
@@ -429,11 +873,10 @@ void magic_lmi_cleanup(MagicLmiContext *ctx) {
   /* 停止 UDP 监听服务器运行 */
   ctx->udp_running = false;
 
-  /* 停止心跳监控线程 */
-  if (ctx->heartbeat_monitor_running) {
-    ctx->heartbeat_monitor_running = false;
-    pthread_join(ctx->heartbeat_monitor_thread, NULL);
-    fd_log_debug("[app_magic] Heartbeat monitor thread stopped");
+  /* 停止事件循环, 关闭全部流式连接; 尚未确认的请求一律以失败完成 */
+  lmi_reactor_stop(ctx);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    lmi_fail_client_pending(ctx, i);
   }
 
   /* 关闭流式服务器 Socket */
@@ -442,6 +885,12 @@ void magic_lmi_cleanup(MagicLmiContext *ctx) {
     unlink(DLM_SOCK_PATH); /* 删除 socket 文件 */
   }
 
+  /* 关闭顺序包服务器 Socket */
+  if (ctx->seq_server_fd >= 0) {
+    close(ctx->seq_server_fd);
+    unlink(MIH_SEQPACKET_SOCKET_PATH); /* 删除 socket 文件 */
+  }
+
   /* 关闭数据报服务器 Socket */
   if (ctx->dgram_fd >= 0) {
     close(ctx->dgram_fd);
@@ -454,8 +903,15 @@ void magic_lmi_cleanup(MagicLmiContext *ctx) {
     fd_log_debug("[app_magic] UDP listener socket closed");
   }
 
+  /* 解除共享链路状态表映射 (文件保留, 运行中的 DLM 仍持有映射) */
+  mih_linkstate_detach(ctx->linkstate);
+  ctx->linkstate = NULL;
+
   /* 销毁互斥锁 */
   pthread_mutex_destroy(&ctx->clients_mutex);
+  magic_pool_destroy(&ctx->clients, NULL);
+  magic_pool_destroy(&ctx->client_aux, lmi_client_aux_fini);
+  pthread_mutex_destroy(&ctx->pending_mutex);
 
   /* 记录清理完成 */
   fd_log_notice("[app_magic] LMI interface cleaned up");
@@ -488,13 +944,7 @@ handle_mih_register_request(MagicLmiContext *ctx, int client_fd,
   /* 查找空闲的客户端槽位 */
   pthread_mutex_lock(&ctx->clients_mutex);
 
-  int client_index = -1;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (!ctx->clients[i].is_registered) {
-      client_index = i; /* 找到空闲槽位 */
-      break;
-    }
-  }
+  int client_index = lmi_client_alloc_locked(ctx); /* 表满时扩容 */
 
   if (client_index == -1) {
     /* 没有可用的客户端槽位 */
@@ -502,7 +952,7 @@ handle_mih_register_request(MagicLmiContext *ctx, int client_fd,
     fd_log_error("[app_magic] No available client slots for DLM registration");
   } else {
     /* 分配客户端槽位并填充信息 */
-    DlmClient *client = &ctx->clients[client_index];
+    DlmClient *client = lmi_client(ctx, client_index);
 
     /* 设置客户端基本信息 */
     client->is_registered = true;
@@ -515,13 +965,18 @@ handle_mih_register_request(MagicLmiContext *ctx, int client_fd,
            sizeof(MIH_Link_Capabilities));
     client->dlm_pid = req->dlm_pid;
     client->last_heartbeat = time(NULL);
-    client->last_seen = time(NULL); /* 初始化最后可见时间,防止心跳超时误判 */
+    client->hb_last_ms = 0; /* 重新学习心跳节奏与链路质量 */
+    client->hb_samples = 0;
+    client->hb_source = LMI_SEEN_OTHER;
+    memset(&client->quality, 0, sizeof(client->quality));
+    /* 初始化最后可见时间,防止心跳超时误判 */
+    lmi_client_seen(client, LMI_SEEN_OTHER);
 
     /* 更新链路状态为活动 */
     DatalinkProfile *link =
-        magic_config_find_datalink(ctx->config, client->link_id);
+        magic_config_find_datalink(lmi_config(ctx), client->link_id);
     if (link) {
-      link->is_active = true;
+      magic_config_set_link_active(ctx->config_store, link->dlm_name, true);
     }
 
     /* 设置响应状态 */
@@ -542,9 +997,15 @@ handle_mih_register_request(MagicLmiContext *ctx, int client_fd,
   /* 解锁互斥锁 */
   pthread_mutex_unlock(&ctx->clients_mutex);
 
-  /* 发送注册确认响应 */
+  /* 发送注册确认响应 (已分配槽位时与该 DLM 的其他写入串行) */
+  if (client_index >= 0) {
+    pthread_mutex_lock(lmi_client_lock(ctx, client_index));
+  }
   mih_transport_send(client_fd, MIH_EXT_LINK_REGISTER_CONFIRM, &confirm,
                      sizeof(confirm));
+  if (client_index >= 0) {
+    pthread_mutex_unlock(lmi_client_lock(ctx, client_index));
+  }
 }
 
 /**
@@ -565,10 +1026,10 @@ static void handle_mih_link_up_indication(MagicLmiContext *ctx, int client_fd,
 
   /* 查找对应的客户端 */
   DlmClient *client = NULL;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      client = &ctx->clients[i];
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      client = lmi_client(ctx, i);
       break;
     }
   }
@@ -578,14 +1039,15 @@ static void handle_mih_link_up_indication(MagicLmiContext *ctx, int client_fd,
     memcpy(&client->link_params, &ind->link_params,
            sizeof(mih_link_parameters_t));
 
-    /* 标记链路为UP状态 */
+    /* 标记链路为UP状态, 重新学习链路质量 */
     client->is_link_up = true;
+    memset(&client->quality, 0, sizeof(client->quality));
 
     /* 更新配置中的链路状态为 Active */
     DatalinkProfile *link =
-        magic_config_find_datalink(ctx->config, client->link_id);
+        magic_config_find_datalink(lmi_config(ctx), client->link_id);
     if (link) {
-      link->is_active = true;
+      magic_config_set_link_active(ctx->config_store, link->dlm_name, true);
     }
 
     /* 记录链路上线事件 */
@@ -615,47 +1077,29 @@ static void handle_mih_link_up_indication(MagicLmiContext *ctx, int client_fd,
  */
 static void handle_mih_link_down_indication(MagicLmiContext *ctx, int client_fd,
                                             const mih_link_down_ind_t *ind) {
-  pthread_mutex_lock(&ctx->clients_mutex);
-
-  /* 查找对应的客户端 */
-  DlmClient *client = NULL;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      client = &ctx->clients[i];
-      break;
-    }
-  }
-
-  if (client) {
-    /* 标记链路为DOWN状态 */
-    client->is_link_up = false;
-  }
-
-  pthread_mutex_unlock(&ctx->clients_mutex);
-
   char link_id[MAX_ID_LEN] = {0};
 
   /* 锁定客户端数组 */
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* 查找对应的客户端 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      /* 保存链路 ID 用于后续通知 */
-      strncpy(link_id, ctx->clients[i].link_id, sizeof(link_id) - 1);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      /* 标记链路为DOWN状态，保存链路 ID 用于后续通知 */
+      lmi_client(ctx, i)->is_link_up = false;
+      strncpy(link_id, lmi_client(ctx, i)->link_id, sizeof(link_id) - 1);
 
       /* 更新链路状态为离线 */
-      DatalinkProfile *link =
-          magic_config_find_datalink(ctx->config, ctx->clients[i].link_id);
+      DatalinkProfile *link = magic_config_find_datalink(
+          lmi_config(ctx), lmi_client(ctx, i)->link_id);
       if (link) {
-        link->is_active = false;
+        magic_config_set_link_active(ctx->config_store, link->dlm_name, false);
       }
 
       /* 记录链路下线事件 */
       fd_log_notice("[app_magic] ✗ Link DOWN: %s (reason=%u)",
-                    ctx->clients[i].link_id, ind->reason_code);
+                    lmi_client(ctx, i)->link_id, ind->reason_code);
       break;
     }
   }
@@ -663,63 +1107,13 @@ static void handle_mih_link_down_indication(MagicLmiContext *ctx, int client_fd,
   /* 解锁客户端数组 */
   pthread_mutex_unlock(&ctx->clients_mutex);
 
-  /* 如果找到了对应的链路，通知所有使用该链路的客户端会话 */
+  /*
+   * 会话迁移与 MNTR 通知由 LINK_EVENT_DOWN 回调交给定时器线程
+   * (on_link_down_job)。迁移要等待 MIH 资源确认，而确认只能由本事件循环
+   * 接收，在这里直接执行会阻塞整个 LMI 直到资源请求超时。
+   */
   if (link_id[0] != '\0') {
-    /* 获取全局 MAGIC 上下文 */
-    extern MagicContext g_magic_ctx;
-    MagicContext *magic_ctx = &g_magic_ctx;
-
-    /* 遍历所有会话，查找使用该链路的会话 */
-    pthread_mutex_lock(&magic_ctx->session_mgr.mutex);
-
-    int notified_count = 0;
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-      ClientSession *session = &magic_ctx->session_mgr.sessions[i];
-
-      /* 跳过未使用或已终止的会话 */
-      if (!session->in_use || session->state == SESSION_STATE_CLOSED) {
-        continue;
-      }
-
-      /* 检查会话是否使用了下线的链路 */
-      if (strcmp(session->assigned_link_id, link_id) == 0) {
-        /* 准备 MNTR 通知参数 */
-        MNTRParams mntr_params;
-        memset(&mntr_params, 0, sizeof(mntr_params));
-
-        /* 链路丢失 - MAGIC-Status-Code = 2007 (LINK_ERROR) - ARINC 839 规范 */
-        mntr_params.magic_status_code = MAGIC_STATUS_LINK_ERROR;
-        mntr_params.error_message = "Link Down - datalink connection lost";
-        mntr_params.new_granted_bw = 0; /* 链路断开，带宽为 0 */
-        mntr_params.new_granted_ret_bw = 0;
-        mntr_params.force_send = true; /* 强制发送，绕过风暴抑制 */
-
-        /* 发送 MNTR 通知 */
-        fd_log_notice(
-            "[app_magic] Sending MNTR (LINK_DOWN) to session %s (link=%s)",
-            session->session_id, link_id);
-
-        if (magic_cic_send_mntr(magic_ctx, session, &mntr_params) == 0) {
-          notified_count++;
-
-          /* 更新会话状态为 SUSPENDED (挂起) */
-          session->state = SESSION_STATE_SUSPENDED;
-
-          /* 记录旧带宽值用于链路恢复时参考 */
-          fd_log_debug("[app_magic] Session %s suspended (was: %u kbps)",
-                       session->session_id, session->granted_bw_kbps);
-        } else {
-          fd_log_error("[app_magic] Failed to send MNTR to session %s",
-                       session->session_id);
-        }
-      }
-    }
-
-    pthread_mutex_unlock(&magic_ctx->session_mgr.mutex);
-
-    fd_log_notice("[app_magic] Link down notification sent to %d session(s) "
-                  "using link %s",
-                  notified_count, link_id);
+    trigger_lmi_event_callbacks(ctx, link_id, LINK_EVENT_DOWN, ind);
   }
 }
 
@@ -735,33 +1129,43 @@ static void handle_mih_link_down_indication(MagicLmiContext *ctx, int client_fd,
  */
 static void handle_mih_heartbeat(MagicLmiContext *ctx, int client_fd,
                                  const MIH_EXT_Heartbeat *hb) {
+  int client_idx = -1;
+
   /* 锁定客户端数组 */
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* 查找对应的客户端并更新心跳时间 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      ctx->clients[i].last_heartbeat = time(NULL);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      lmi_client(ctx, i)->last_heartbeat = time(NULL);
+      lmi_client_seen(lmi_client(ctx, i), LMI_SEEN_HEARTBEAT);
+      client_idx = i;
 
       /* 记录心跳信息 */
       fd_log_debug("[app_magic] Heartbeat from %s (health=%u, tx=%lu, rx=%lu)",
-                   ctx->clients[i].link_id, hb->health_status, hb->tx_bytes,
+                   lmi_client(ctx, i)->link_id, hb->health_status, hb->tx_bytes,
                    hb->rx_bytes);
-
-      /* 发送心跳确认 */
-      MIH_EXT_Heartbeat_Ack ack;
-      memset(&ack, 0, sizeof(ack));
-      ack.ack_status = 0; /* OK */
-      ack.server_timestamp = (uint32_t)time(NULL);
-
-      mih_transport_send(client_fd, MIH_EXT_HEARTBEAT_ACK, &ack, sizeof(ack));
       break;
     }
   }
 
   /* 解锁客户端数组 */
   pthread_mutex_unlock(&ctx->clients_mutex);
+
+  if (client_idx < 0) {
+    return;
+  }
+
+  /* 发送心跳确认 (只持有该 DLM 的写入锁) */
+  MIH_EXT_Heartbeat_Ack ack;
+  memset(&ack, 0, sizeof(ack));
+  ack.ack_status = 0; /* OK */
+  ack.server_timestamp = (uint32_t)time(NULL);
+
+  pthread_mutex_lock(lmi_client_lock(ctx, client_idx));
+  mih_transport_send(client_fd, MIH_EXT_HEARTBEAT_ACK, &ack, sizeof(ack));
+  pthread_mutex_unlock(lmi_client_lock(ctx, client_idx));
 }
 
 /**
@@ -777,15 +1181,19 @@ static void handle_mih_heartbeat(MagicLmiContext *ctx, int client_fd,
 static void
 handle_mih_parameters_report(MagicLmiContext *ctx, int client_fd,
                              const LINK_Parameters_Report_Indication *ind) {
+  LmiQualityChange change = LMI_QUALITY_STEADY;
+  LINK_Going_Down_Indication going_down;
+  char link_id[MAX_ID_LEN] = {0};
+
   /* 锁定客户端数组 */
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* 查找对应的客户端 */
   DlmClient *client = NULL;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      client = &ctx->clients[i];
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      client = lmi_client(ctx, i);
       break;
     }
   }
@@ -805,7 +1213,11 @@ handle_mih_parameters_report(MagicLmiContext *ctx, int client_fd,
     client->link_params.ip_address = ind->parameters.ip_address;
 
     /* 更新最后活动时间 */
-    client->last_seen = time(NULL);
+    lmi_client_seen(client, LMI_SEEN_OTHER);
+
+    /* 更新链路质量趋势 */
+    change = lmi_quality_update(client, &ind->parameters, &going_down);
+    memcpy(link_id, client->link_id, sizeof(link_id));
 
     fd_log_debug(
         "[app_magic] ✓ Parameters Report from %s: RSSI=%d dBm, BW=%u kbps",
@@ -815,6 +1227,38 @@ handle_mih_parameters_report(MagicLmiContext *ctx, int client_fd,
 
   /* 解锁客户端数组 */
   pthread_mutex_unlock(&ctx->clients_mutex);
+
+  lmi_quality_notify(ctx, link_id, change, &going_down);
+}
+
+/**
+ * @brief 处理 MIH 标准 Link_Going_Down 指示
+ *
+ * DLM 预计链路即将断开时发送, 与本地趋势预测共用劣化处理路径:
+ * 首次进入劣化时触发 LINK_EVENT_GOING_DOWN, 由上层先建后拆
+ *
+ * @param ctx LMI 上下文指针
+ * @param client_fd 客户端 Socket 文件描述符
+ * @param ind 链路即将断开指示
+ */
+static void handle_mih_going_down(MagicLmiContext *ctx, int client_fd,
+                                  const LINK_Going_Down_Indication *ind) {
+  LmiQualityChange change = LMI_QUALITY_STEADY;
+  char link_id[MAX_ID_LEN] = {0};
+
+  pthread_mutex_lock(&ctx->clients_mutex);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      lmi_client_seen(lmi_client(ctx, i), LMI_SEEN_OTHER);
+      change = lmi_quality_going_down(lmi_client(ctx, i), ind);
+      memcpy(link_id, lmi_client(ctx, i)->link_id, sizeof(link_id));
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->clients_mutex);
+
+  lmi_quality_notify(ctx, link_id, change, ind);
 }
 
 /*===========================================================================
@@ -923,13 +1367,7 @@ handle_dlm_registration(MagicLmiContext *ctx, int client_fd,
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* v2.0: 在配置中查找对应的 DLM */
-  DLMConfig *dlm = NULL;
-  for (uint32_t i = 0; i < ctx->config->num_dlm_configs; i++) {
-    if (strcmp(ctx->config->dlm_configs[i].dlm_name, reg->dlm_id) == 0) {
-      dlm = &ctx->config->dlm_configs[i];
-      break;
-    }
-  }
+  DLMConfig *dlm = magic_config_find_dlm(lmi_config(ctx), reg->dlm_id);
 
   if (!dlm) {
     /* 未找到对应的 DLM 配置 */
@@ -943,14 +1381,9 @@ handle_dlm_registration(MagicLmiContext *ctx, int client_fd,
     return;
   }
 
-  /* 查找空闲的客户端槽位 */
-  DlmClient *client = NULL;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (!ctx->clients[i].is_registered) {
-      client = &ctx->clients[i];
-      break;
-    }
-  }
+  /* 查找空闲的客户端槽位 (表满时扩容) */
+  int free_idx = lmi_client_alloc_locked(ctx);
+  DlmClient *client = free_idx >= 0 ? lmi_client(ctx, free_idx) : NULL;
 
   if (!client) {
     /* 没有空闲槽位 */
@@ -971,16 +1404,17 @@ handle_dlm_registration(MagicLmiContext *ctx, int client_fd,
   strncpy(client->dlm_id, reg->dlm_id, sizeof(client->dlm_id) - 1);
   strncpy(client->link_id, dlm->dlm_name, sizeof(client->link_id) - 1);
   client->last_heartbeat = time(NULL);
+  lmi_client_seen(client, LMI_SEEN_OTHER);
 
   /* v2.0: 标记 DLM 为活动状态 */
-  dlm->is_active = true;
+  magic_config_set_link_active(ctx->config_store, dlm->dlm_name, true);
 
   /* 解锁客户端数组 */
   pthread_mutex_unlock(&ctx->clients_mutex);
 
   /* 发送注册成功确认 */
   MsgRegisterAck ack = {
-      .result = 0, .assigned_id = 1000 + (uint32_t)(client - ctx->clients)};
+      .result = 0, .assigned_id = 1000 + (uint32_t)free_idx};
   strncpy(ack.message, "Registration successful", sizeof(ack.message) - 1);
   send_ipc_msg(client_fd, MSG_TYPE_REGISTER_ACK, &ack, sizeof(ack));
 
@@ -1010,10 +1444,10 @@ handle_link_event(MagicLmiContext *ctx, int client_fd,
 
   /* 查找对应的 DLM 客户端 */
   DlmClient *client = NULL;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      client = &ctx->clients[i];
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      client = lmi_client(ctx, i);
       break;
     }
   }
@@ -1026,9 +1460,10 @@ handle_link_event(MagicLmiContext *ctx, int client_fd,
 
   /* 更新链路状态 */
   DatalinkProfile *link =
-      magic_config_find_datalink(ctx->config, client->link_id);
+      magic_config_find_datalink(lmi_config(ctx), client->link_id);
   if (link) {
-    link->is_active = event->is_link_up;
+    magic_config_set_link_active(ctx->config_store, link->dlm_name,
+                                 event->is_link_up);
   }
 
   /* 解锁客户端数组 */
@@ -1064,10 +1499,11 @@ handle_heartbeat(MagicLmiContext *ctx, int client_fd, const MsgHeartbeat *hb) {
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* 查找对应的客户端并更新心跳时间 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      ctx->clients[i].last_heartbeat = time(NULL);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      lmi_client(ctx, i)->last_heartbeat = time(NULL);
+      lmi_client_seen(lmi_client(ctx, i), LMI_SEEN_HEARTBEAT);
       break;
     }
   }
@@ -1077,118 +1513,120 @@ handle_heartbeat(MagicLmiContext *ctx, int client_fd, const MsgHeartbeat *hb) {
 }
 
 /*===========================================================================
- * DLM 客户端处理线程
+ * DLM 流式连接处理
  *
- * 每个连接的 DLM 客户端都有一个专用线程处理其消息
- * 线程负责接收和分发不同类型的 MIH 消息
+ * 所有 DLM 流式连接由 LMI 事件循环统一读取: 每次可读只做一次非阻塞
+ * recv, 在连接缓冲区内重组完整帧后按 MIH 原语类型分发
  *===========================================================================*/
 
 /**
- * @brief DLM 客户端线程参数结构体
+ * @brief 分发一个完整的 MIH 流式帧。
  *
- * 用于传递给客户端处理线程的参数
+ * @param ctx LMI 上下文。
+ * @param client_fd 客户端 Socket 文件描述符。
+ * @param hdr MIH 传输层头部。
+ * @param payload 有效载荷 (已按结构体对齐)。
+ * @param len 有效载荷长度。
  */
-typedef struct {
-  MagicLmiContext *ctx; /* LMI 上下文指针 */
-  int client_fd;        /* 客户端 Socket 文件描述符 */
-} ClientThreadArg;
+static void lmi_dispatch_stream_frame(MagicLmiContext *ctx, int client_fd,
+                                      const mih_transport_header_t *hdr,
+                                      const void *payload, size_t len) {
+  /* 根据 MIH 原语类型分发处理 */
+  switch (hdr->primitive_type) {
+  case MIH_EXT_LINK_REGISTER_REQUEST:
+    /* MIH 扩展链路注册请求 */
+    handle_mih_register_request(ctx, client_fd,
+                                (const MIH_EXT_Link_Register_Request *)payload);
+    break;
 
-/**
- * @brief DLM 客户端消息处理线程。
- * @details 为每个连接的 DLM 客户端创建的专用线程。
- *          使用 MIH 传输层接收和处理来自 DLM 的 MIH 原语。
- *          线程会一直运行，直到连接断开或服务器停止。
- *
- * @param arg 线程参数 (`ClientThreadArg*`)，包含客户端文件描述符和上下文。
- * @return NULL (线程退出时)。
- *
- * @warning 此函数在独立线程中运行，访问共享资源 (如 `ctx->clients`)
- * 时必须加锁。
- */
-static void *handle_dlm_client_thread(void *arg) {
-  /* 解析线程参数 */
-  ClientThreadArg *thread_arg = (ClientThreadArg *)arg;
-  MagicLmiContext *ctx = thread_arg->ctx;
-  int client_fd = thread_arg->client_fd;
+  case MIH_LINK_UP_INDICATION:
+    /* MIH 链路上线指示 */
+    handle_mih_link_up_indication(ctx, client_fd,
+                                  (const mih_link_up_ind_t *)payload);
+    break;
 
-  /* 释放参数结构体内存 */
-  free(thread_arg);
+  case MIH_LINK_DOWN_INDICATION:
+    /* MIH 链路下线指示 */
+    handle_mih_link_down_indication(ctx, client_fd,
+                                    (const mih_link_down_ind_t *)payload);
+    break;
 
-  /* 消息缓冲区 */
-  char buffer[4096];
-  mih_transport_header_t mih_header;
+  case MIH_EXT_HEARTBEAT:
+    /* MIH 扩展心跳消息 */
+    handle_mih_heartbeat(ctx, client_fd, (const MIH_EXT_Heartbeat *)payload);
+    break;
 
-  /* 记录线程启动 */
-  fd_log_debug("[app_magic] DLM client thread started (fd=%d)", client_fd);
+  case MIH_LINK_PARAMETERS_REPORT_IND:
+    /* MIH 标准参数报告指示 */
+    handle_mih_parameters_report(
+        ctx, client_fd, (const LINK_Parameters_Report_Indication *)payload);
+    break;
 
-  /* 消息处理循环 */
-  while (ctx->running) {
-    /* 使用 MIH 传输层接收消息 */
-    int n = mih_transport_recv(client_fd, &mih_header, buffer, sizeof(buffer));
-    if (n < 0) {
-      /* 接收失败, 客户端断开连接 */
-      fd_log_debug("[app_magic] DLM client disconnected (fd=%d)", client_fd);
-      break;
+  case MIH_LINK_GOING_DOWN_IND:
+    /* MIH 标准链路即将断开指示 */
+    if (len >= sizeof(LINK_Going_Down_Indication)) {
+      handle_mih_going_down(ctx, client_fd,
+                            (const LINK_Going_Down_Indication *)payload);
     }
+    break;
 
-    /* 根据 MIH 原语类型分发处理 */
-    switch (mih_header.primitive_type) {
-    case MIH_EXT_LINK_REGISTER_REQUEST:
-      /* MIH 扩展链路注册请求 */
-      handle_mih_register_request(ctx, client_fd,
-                                  (MIH_EXT_Link_Register_Request *)buffer);
-      break;
-
-    case MIH_LINK_UP_INDICATION:
-      /* MIH 链路上线指示 */
-      handle_mih_link_up_indication(ctx, client_fd,
-                                    (mih_link_up_ind_t *)buffer);
-      break;
-
-    case MIH_LINK_DOWN_INDICATION:
-      /* MIH 链路下线指示 */
-      handle_mih_link_down_indication(ctx, client_fd,
-                                      (mih_link_down_ind_t *)buffer);
-      break;
-
-    case MIH_EXT_HEARTBEAT:
-      /* MIH 扩展心跳消息 */
-      handle_mih_heartbeat(ctx, client_fd, (MIH_EXT_Heartbeat *)buffer);
-      break;
-
-    case MIH_LINK_PARAMETERS_REPORT_IND:
-      /* MIH 标准参数报告指示 */
-      handle_mih_parameters_report(ctx, client_fd,
-                                   (LINK_Parameters_Report_Indication *)buffer);
-      break;
-
-    default:
-      /* 未知的 MIH 原语类型 */
-      fd_log_debug("[app_magic] Unknown MIH primitive: 0x%04X",
-                   mih_header.primitive_type);
-      break;
+  case MIH_LINK_RESOURCE_CNF:
+    /* 资源请求确认, 按事务 ID 匹配在途请求 */
+    if (len >= sizeof(LINK_Resource_Confirm)) {
+      handle_mih_resource_confirm(ctx, client_fd, hdr->transaction_id,
+                                  (const LINK_Resource_Confirm *)payload);
     }
+    break;
+
+  default:
+    /* 未知的 MIH 原语类型 */
+    fd_log_debug("[app_magic] Unknown MIH primitive: 0x%04X",
+                 hdr->primitive_type);
+    break;
   }
+}
+
+/**
+ * @brief 关闭一个流式连接并清理对应的 DLM 客户端。
+ * @details 标记链路离线, 在该 DLM 的锁内清空客户端 (与进行中的簿记/写入
+ *          互斥), 以失败完成其在途请求, 最后注销并关闭 Socket。
+ *
+ * @param ctx LMI 上下文。
+ * @param conn 流式连接。
+ * @param link_down 是否触发 LINK_EVENT_DOWN (心跳超时时为 true)。
+ */
+static void lmi_conn_close(MagicLmiContext *ctx, LmiConnection *conn,
+                           bool link_down) {
+  int client_fd = conn->fd;
+  int gone_idx = -1;
+  char link_id[MAX_ID_LEN] = "";
 
   /* 清理客户端状态 */
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* 查找并清理对应的客户端 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      gone_idx = i;
+      memcpy(link_id, lmi_client(ctx, i)->link_id, sizeof(link_id));
+
       /* 更新链路状态为离线 */
-      DatalinkProfile *link =
-          magic_config_find_datalink(ctx->config, ctx->clients[i].link_id);
+      DatalinkProfile *link = magic_config_find_datalink(
+          lmi_config(ctx), lmi_client(ctx, i)->link_id);
       if (link) {
-        link->is_active = false;
+        magic_config_set_link_active(ctx->config_store, link->dlm_name, false);
       }
 
       /* 记录断开连接信息 */
-      fd_log_notice("[app_magic] DLM disconnected: %s", ctx->clients[i].dlm_id);
-
-      /* 清空客户端信息 */
-      memset(&ctx->clients[i], 0, sizeof(DlmClient));
+      fd_log_notice("[app_magic] DLM disconnected: %s",
+                    lmi_client(ctx, i)->dlm_id);
+
+      /* 清空客户端信息 (与该 DLM 上进行中的簿记/写入互斥) */
+      pthread_mutex_lock(lmi_client_lock(ctx, i));
+      memset(lmi_client(ctx, i), 0, sizeof(DlmClient));
+      lmi_client_aux(ctx, i)->echoes_txn = false;
+      pthread_mutex_unlock(lmi_client_lock(ctx, i));
       break;
     }
   }
@@ -1196,83 +1634,194 @@ static void *handle_dlm_client_thread(void *arg) {
   /* 解锁客户端数组 */
   pthread_mutex_unlock(&ctx->clients_mutex);
 
-  /* 关闭客户端 Socket */
+  /* 该 DLM 上未确认的资源请求不会再有应答 */
+  if (gone_idx >= 0) {
+    lmi_fail_client_pending(ctx, gone_idx);
+    if (link_down) {
+      trigger_lmi_event_callbacks(ctx, link_id, LINK_EVENT_DOWN, NULL);
+    }
+  }
+
+  /* 注销并关闭客户端 Socket */
+  epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
   close(client_fd);
+  conn->fd = -1;
+  conn->rx_len = 0;
+}
 
-  return NULL;
+/**
+ * @brief 分发一个完整的帧。
+ * @details 有效载荷拷贝到 8 字节对齐的缓冲区 (帧在预读缓冲区中的偏移任意),
+ *          短帧补零到 LMI_RX_PAD_SIZE, 处理函数可直接按结构体读取。
+ *
+ * @param ctx LMI 上下文。
+ * @param conn 流式连接。
+ * @param frame 帧起始地址 (头部 + 有效载荷)。
+ */
+static void lmi_conn_deliver(MagicLmiContext *ctx, LmiConnection *conn,
+                             const uint8_t *frame) {
+  static union {
+    uint8_t bytes[LMI_RX_BUFFER_SIZE];
+    uint64_t align;
+  } payload; /* 仅事件循环线程使用 */
+  const size_t hdr_len = sizeof(mih_transport_header_t);
+
+  mih_transport_header_t hdr;
+  memcpy(&hdr, frame, hdr_len);
+
+  size_t len = hdr.message_length - hdr_len;
+  memcpy(payload.bytes, frame + hdr_len, len);
+  if (len < LMI_RX_PAD_SIZE) {
+    memset(payload.bytes + len, 0, LMI_RX_PAD_SIZE - len);
+  }
+  lmi_dispatch_stream_frame(ctx, conn->fd, &hdr, payload.bytes, len);
 }
 
-/*===========================================================================
- * DLM 服务器主线程
+/**
+ * @brief 处理顺序包连接可读事件。
+ * @details 每条记录恰好是一帧, 无需重组; 单次可读事件最多连续接收
+ *          LMI_SEQ_BATCH 条记录, 减少高负载下的 epoll_wait 次数。
  *
- * 监听 DLM 连接请求并创建客户端处理线程
- *===========================================================================*/
+ * @param ctx LMI 上下文。
+ * @param conn 顺序包连接。
+ */
+static void lmi_conn_readable_seq(MagicLmiContext *ctx, LmiConnection *conn) {
+  const size_t hdr_len = sizeof(mih_transport_header_t);
+
+  for (int i = 0; i < LMI_SEQ_BATCH && conn->fd >= 0; i++) {
+    ssize_t n = recv(conn->fd, conn->rx_buf, sizeof(conn->rx_buf),
+                     MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      return;
+    }
+    if (n <= 0) {
+      fd_log_debug("[app_magic] DLM client disconnected (fd=%d)", conn->fd);
+      lmi_conn_close(ctx, conn, false);
+      return;
+    }
+
+    mih_transport_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if ((size_t)n >= hdr_len) {
+      memcpy(&hdr, conn->rx_buf, hdr_len);
+    }
+    if (hdr.message_length < hdr_len || hdr.message_length != (size_t)n) {
+      /* 记录长度与帧头不符 (含超长被截断的记录) */
+      fd_log_error("[app_magic] ✗ Invalid MIH record length %zd (fd=%d)", n,
+                   conn->fd);
+      lmi_conn_close(ctx, conn, false);
+      return;
+    }
+    lmi_conn_deliver(ctx, conn, conn->rx_buf);
+  }
+}
 
 /**
- * @brief DLM 服务器主线程。
- * @details 监听 Unix Domain Socket 上的 DLM 连接请求。
- *          accept 新连接后，为每个客户端创建独立的 `handle_dlm_client_thread`
- * 线程。
+ * @brief 处理流式连接可读事件。
+ * @details 非阻塞读取一次 (按缓冲区剩余空间预读), 然后分发其中所有完整的帧;
+ *          半帧留在缓冲区等待下一次可读, 不会阻塞事件循环。
  *
- * @param arg 线程参数 (`MagicLmiContext*`)。
- * @return NULL (服务器停止时)。
+ * @param ctx LMI 上下文。
+ * @param conn 流式连接。
  */
-static void *dlm_server_thread(void *arg) {
-  /* 获取 LMI 上下文 */
-  MagicLmiContext *ctx = (MagicLmiContext *)arg;
+static void lmi_conn_readable(MagicLmiContext *ctx, LmiConnection *conn) {
+  const size_t hdr_len = sizeof(mih_transport_header_t);
 
-  /* 记录服务器线程启动 */
-  fd_log_notice("[app_magic] DLM server thread started");
-
-  /* 连接接受循环 */
-  while (ctx->running) {
-    /* 客户端地址结构 */
-    struct sockaddr_un client_addr;
-    socklen_t addr_len = sizeof(client_addr);
-
-    /* 接受新连接 */
-    int client_fd =
-        accept(ctx->server_fd, (struct sockaddr *)&client_addr, &addr_len);
-    if (client_fd < 0) {
-      if (ctx->running) {
-        /* 记录接受连接失败的错误 */
-        fd_log_error("[app_magic] DLM accept failed: %s", strerror(errno));
-      }
-      break;
+  if (conn->seqpacket) {
+    lmi_conn_readable_seq(ctx, conn);
+    return;
+  }
+
+  ssize_t n = recv(conn->fd, conn->rx_buf + conn->rx_len,
+                   sizeof(conn->rx_buf) - conn->rx_len, MSG_DONTWAIT);
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    return;
+  }
+  if (n <= 0) {
+    /* 接收失败, 客户端断开连接 */
+    fd_log_debug("[app_magic] DLM client disconnected (fd=%d)", conn->fd);
+    lmi_conn_close(ctx, conn, false);
+    return;
+  }
+  conn->rx_len += (size_t)n;
+
+  size_t off = 0;
+  while (conn->fd >= 0 && conn->rx_len - off >= hdr_len) {
+    mih_transport_header_t hdr;
+    memcpy(&hdr, conn->rx_buf + off, hdr_len);
+    if (hdr.message_length < hdr_len) {
+      /* 帧长度非法, 无法再定位帧边界 */
+      fd_log_error("[app_magic] ✗ Invalid MIH frame length %u (fd=%d)",
+                   hdr.message_length, conn->fd);
+      lmi_conn_close(ctx, conn, false);
+      return;
+    }
+    if (conn->rx_len - off < hdr.message_length) {
+      break; /* 半帧 */
     }
 
-    /* 记录新客户端连接 */
-    fd_log_debug("[app_magic] New DLM client connected (fd=%d)", client_fd);
+    lmi_conn_deliver(ctx, conn, conn->rx_buf + off);
+    off += hdr.message_length;
+  }
 
-    /* 为每个客户端创建处理线程 */
-    ClientThreadArg *thread_arg = malloc(sizeof(ClientThreadArg));
-    if (thread_arg) {
-      /* 设置线程参数 */
-      thread_arg->ctx = ctx;
-      thread_arg->client_fd = client_fd;
+  /* 把剩余的半帧移到缓冲区头部 */
+  if (conn->fd >= 0 && off > 0) {
+    memmove(conn->rx_buf, conn->rx_buf + off, conn->rx_len - off);
+    conn->rx_len -= off;
+  }
+}
 
-      /* 创建客户端处理线程 */
-      pthread_t client_thread;
-      if (pthread_create(&client_thread, NULL, handle_dlm_client_thread,
-                         thread_arg) == 0) {
-        /* 分离线程, 自动清理资源 */
-        pthread_detach(client_thread);
-      } else {
-        /* 线程创建失败 */
-        fd_log_error("[app_magic] Failed to create client thread");
-        free(thread_arg);
-        close(client_fd);
-      }
-    } else {
-      /* 内存分配失败 */
-      close(client_fd);
+/**
+ * @brief 接受一个新的 DLM 流式连接。
+ * @details 监听 Socket 可读时调用; 连接登记到空闲槽位并加入事件循环。
+ *
+ * @param ctx LMI 上下文。
+ * @param seqpacket 是否来自顺序包监听 Socket。
+ */
+static void lmi_accept_connection(MagicLmiContext *ctx, bool seqpacket) {
+  /* 客户端地址结构 */
+  struct sockaddr_un client_addr;
+  socklen_t addr_len = sizeof(client_addr);
+
+  /* 接受新连接 */
+  int listen_fd = seqpacket ? ctx->seq_server_fd : ctx->server_fd;
+  int client_fd =
+      accept(listen_fd, (struct sockaddr *)&client_addr, &addr_len);
+  if (client_fd < 0) {
+    if (errno != EAGAIN && errno != EINTR) {
+      /* 记录接受连接失败的错误 */
+      fd_log_error("[app_magic] DLM accept failed: %s", strerror(errno));
     }
+    return;
   }
 
-  /* 记录服务器线程退出 */
-  fd_log_notice("[app_magic] DLM server thread exiting");
+  /* 查找空闲的连接槽位 */
+  int slot = -1;
+  for (int i = 0; i < LMI_MAX_CONNECTIONS; i++) {
+    if (ctx->conns[i].fd < 0) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    fd_log_error("[app_magic] No free LMI connection slot (fd=%d)", client_fd);
+    close(client_fd);
+    return;
+  }
 
-  return NULL;
+  ctx->conns[slot].fd = client_fd;
+  ctx->conns[slot].seqpacket = seqpacket;
+  ctx->conns[slot].rx_len = 0;
+  if (lmi_reactor_add(ctx, client_fd, LMI_EV_CONN + (uint32_t)slot) != 0) {
+    fd_log_error("[app_magic] Failed to watch DLM client (fd=%d)", client_fd);
+    ctx->conns[slot].fd = -1;
+    close(client_fd);
+    return;
+  }
+
+  /* 记录新客户端连接 */
+  fd_log_debug("[app_magic] New DLM client connected (fd=%d, slot=%d, %s)",
+               client_fd, slot, seqpacket ? "seqpacket" : "stream");
 }
 
 /*===========================================================================
@@ -1300,6 +1849,7 @@ BEARER_ID magic_dlm_allocate_bearer(DlmClient *client) {
       /* 激活 Bearer */
       client->bearers[i].is_active = true;
       client->bearers[i].bearer_id = i + 1;
+      client->bearers[i].dlm_bearer_id = 0;
       client->bearers[i].created_time = time(NULL);
       client->bearers[i].tx_bytes = 0;
       client->bearers[i].rx_bytes = 0;
@@ -1490,52 +2040,507 @@ handle_mih_resource_request(MagicLmiContext *ctx, int client_fd,
   fd_log_notice("[app_magic]   Action: %s",
                 resource_action_to_string(req->action));
 
-  /* 锁定客户端数组 */
-  pthread_mutex_lock(&ctx->clients_mutex);
+  /* 锁定客户端数组 */
+  pthread_mutex_lock(&ctx->clients_mutex);
+
+  /* 查找对应的 DLM 客户端 */
+  DlmClient *client = NULL;
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      client = lmi_client(ctx, i);
+      break;
+    }
+  }
+
+  if (!client) {
+    /* 客户端未找到 */
+    fd_log_error("[app_magic] DLM client not found");
+    memset(&resp, 0, sizeof(resp));
+    resp.status = STATUS_FAILURE;
+    strncpy(resp.reason, "Client not registered", sizeof(resp.reason) - 1);
+    pthread_mutex_unlock(&ctx->clients_mutex);
+    send_ipc_msg(client_fd, MSG_TYPE_RESOURCE_RESP, &resp, sizeof(resp));
+    return;
+  }
+
+  /* 调用内部处理函数 */
+  handle_mih_resource_request_internal(ctx, client, req, &resp);
+
+  /* 解锁客户端数组 */
+  pthread_mutex_unlock(&ctx->clients_mutex);
+
+  /* 发送响应消息 */
+  send_ipc_msg(client_fd, MSG_TYPE_RESOURCE_RESP, &resp, sizeof(resp));
+
+  /* 记录响应信息 */
+  fd_log_notice("[app_magic] MIH_LINK_RESOURCE.Confirm:");
+  fd_log_notice("[app_magic]   Status: %s", status_to_string(resp.status));
+  if (resp.has_bearer_id) {
+    fd_log_notice("[app_magic]   Bearer ID: %u", resp.bearer_id);
+  }
+  fd_log_notice("[app_magic]   Reason: %s", resp.reason);
+}
+
+/*===========================================================================
+ * 异步资源请求 (MIH_LINK_RESOURCE 事务 ID 匹配)
+ *
+ * 请求方只在解析 DLM 时短暂持有 clients_mutex; Bearer 簿记与 Socket
+ * 写入只持有目标 DLM 的 LmiClientAux.lock, 等待 Confirm 期间不持有任何锁,
+ * 因此不同 DLM (如 SATCOM 与 CELLULAR) 上的资源建立可以相互重叠。
+ *===========================================================================*/
+
+/**
+ * @brief 解析资源请求的目标链路名。
+ * @details 优先使用 link_identifier.link_addr；为空时回退到
+ *          destination_id 中 "MIHF_<link>" 形式的链路名。
+ */
+static const char *
+lmi_request_link_name(const MIH_Link_Resource_Request *request) {
+  const char *mihf = request->destination_id.mihf_id;
+
+  if (request->link_identifier.link_addr[0]) {
+    return request->link_identifier.link_addr;
+  }
+  return strncmp(mihf, "MIHF_", 5) == 0 ? mihf + 5 : mihf;
+}
+
+/**
+ * @brief 调用完成回调。
+ * @warning 调用方不得持有任何 LMI 锁。
+ */
+static void lmi_pending_finish(MagicLmiContext *ctx,
+                               const LmiPendingRequest *entry) {
+  if (entry->callback) {
+    entry->callback(ctx, entry->transaction_id, &entry->confirm, entry->arg);
+  }
+}
+
+/**
+ * @brief 登记在途请求并唤醒事件循环重新计算最早超时。
+ * @return 0 成功，-1 在途表已满。
+ */
+static int lmi_pending_add(MagicLmiContext *ctx,
+                           const LmiPendingRequest *entry) {
+  int rc = -1;
+
+  pthread_mutex_lock(&ctx->pending_mutex);
+  for (int i = 0; i < LMI_MAX_PENDING; i++) {
+    if (!ctx->pending[i].in_use) {
+      ctx->pending[i] = *entry;
+      ctx->pending[i].in_use = true;
+      rc = 0;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->pending_mutex);
+
+  /* 唤醒事件循环按新的截止时刻重设定时器 */
+  if (rc == 0 && ctx->wake_fd >= 0) {
+    uint64_t one = 1;
+    ssize_t w = write(ctx->wake_fd, &one, sizeof(one));
+    (void)w;
+  }
+  return rc;
+}
+
+/**
+ * @brief 从在途表摘除一个请求。
+ * @details 按事务 ID 精确匹配 (@p client_idx 为 -1 时不限 DLM)。
+ *          @p fifo 为 true 时改为取该 DLM 最早发出的请求,
+ *          用于不回显事务 ID 的 DLM。
+ *
+ * @return true 摘除成功 (记录拷贝到 @p out)，false 未找到。
+ */
+static bool lmi_pending_take(MagicLmiContext *ctx, int client_idx,
+                             uint32_t transaction_id, bool fifo,
+                             LmiPendingRequest *out) {
+  int hit = -1;
+
+  pthread_mutex_lock(&ctx->pending_mutex);
+  for (int i = 0; i < LMI_MAX_PENDING; i++) {
+    const LmiPendingRequest *p = &ctx->pending[i];
+    if (!p->in_use || (client_idx >= 0 && p->client_idx != client_idx)) {
+      continue;
+    }
+    if (fifo) {
+      /* 事务 ID 在 DLM 写入锁内分配, 其顺序即发送顺序 */
+      if (hit < 0 ||
+          (int32_t)(p->transaction_id - ctx->pending[hit].transaction_id) <
+              0) {
+        hit = i;
+      }
+    } else if (p->transaction_id == transaction_id) {
+      hit = i;
+      break;
+    }
+  }
+  if (hit >= 0) {
+    *out = ctx->pending[hit];
+    ctx->pending[hit].in_use = false;
+  }
+  pthread_mutex_unlock(&ctx->pending_mutex);
+  return hit >= 0;
+}
+
+/**
+ * @brief 以失败状态完成一个已摘除的请求。
+ *
+ * @param rollback 是否撤销本地镜像中为新分配预留的 Bearer
+ *                 (DLM 已断开时槽位已清空, 不应再回滚)。
+ */
+static void lmi_pending_fail(MagicLmiContext *ctx, LmiPendingRequest *entry,
+                             STATUS status, bool rollback) {
+  if (entry->action == RESOURCE_ACTION_REQUEST && entry->local_bearer_id) {
+    if (rollback) {
+      pthread_mutex_lock(lmi_client_lock(ctx, entry->client_idx));
+      magic_dlm_release_bearer(lmi_client(ctx, entry->client_idx),
+                               entry->local_bearer_id);
+      pthread_mutex_unlock(lmi_client_lock(ctx, entry->client_idx));
+    }
+    entry->confirm.has_bearer_id = false;
+    entry->confirm.bearer_identifier = 0;
+  }
+  entry->confirm.status = status;
+  lmi_pending_finish(ctx, entry);
+}
+
+/**
+ * @brief 以 STATUS_LINK_NOT_AVAILABLE 完成某 DLM 上的全部在途请求。
+ * @details DLM 断开或 LMI 清理时调用。
+ */
+static void lmi_fail_client_pending(MagicLmiContext *ctx, int client_idx) {
+  LmiPendingRequest entry;
+
+  while (lmi_pending_take(ctx, client_idx, 0, true, &entry)) {
+    fd_log_notice("[app_magic] ⚠ MIH_LINK_RESOURCE txn=%u aborted: "
+                  "DLM gone",
+                  entry.transaction_id);
+    lmi_pending_fail(ctx, &entry, STATUS_LINK_NOT_AVAILABLE, false);
+  }
+}
+
+/**
+ * @brief 完成所有已到期的资源请求 (由事件循环调用)。
+ * @details 到期请求以 STATUS_FAILURE 完成并回滚本地预留的 Bearer。
+ *
+ * @param ctx LMI 上下文。
+ * @param now_ms 当前单调时钟 (毫秒)。
+ * @return 剩余请求中最早的截止时刻，无在途请求时返回 UINT64_MAX。
+ */
+static uint64_t lmi_pending_expire(MagicLmiContext *ctx, uint64_t now_ms) {
+  LmiPendingRequest expired[LMI_MAX_PENDING];
+  uint64_t next = UINT64_MAX;
+  int n = 0;
+
+  pthread_mutex_lock(&ctx->pending_mutex);
+  for (int i = 0; i < LMI_MAX_PENDING; i++) {
+    LmiPendingRequest *p = &ctx->pending[i];
+    if (!p->in_use) {
+      continue;
+    }
+    if (p->deadline_ms <= now_ms) {
+      expired[n++] = *p;
+      p->in_use = false;
+    } else if (p->deadline_ms < next) {
+      next = p->deadline_ms;
+    }
+  }
+  pthread_mutex_unlock(&ctx->pending_mutex);
+
+  /* 在锁外完成, 回调可能再次发起请求 */
+  for (int k = 0; k < n; k++) {
+    fd_log_notice("[app_magic] ⚠ MIH_LINK_RESOURCE txn=%u timed out (%s)",
+                  expired[k].transaction_id,
+                  lmi_client(ctx, expired[k].client_idx)->link_id);
+    lmi_pending_fail(ctx, &expired[k], STATUS_FAILURE, true);
+  }
+  return next;
+}
+
+/**
+ * @brief 处理 DLM 返回的 MIH_LINK_RESOURCE.confirm。
+ * @details 按事务 ID 匹配在途请求, 在该 DLM 的锁内把结果同步到本地
+ *          Bearer 镜像, 然后在锁外回调。无人认领的成功分配 (超时后
+ *          迟到的确认) 会立即在 DLM 侧释放, 避免资源泄漏。
+ *
+ * @param ctx LMI 上下文。
+ * @param client_fd 客户端 Socket 文件描述符。
+ * @param transaction_id 确认消息头中的事务 ID。
+ * @param cnf 链路层资源确认。
+ */
+static void handle_mih_resource_confirm(MagicLmiContext *ctx, int client_fd,
+                                        uint32_t transaction_id,
+                                        const LINK_Resource_Confirm *cnf) {
+  int idx = -1;
+
+  pthread_mutex_lock(&ctx->clients_mutex);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        lmi_client(ctx, i)->client_fd == client_fd) {
+      idx = i;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->clients_mutex);
+  if (idx < 0) {
+    return;
+  }
+
+  /* 先精确匹配; 该 DLM 从未回显过事务 ID 时按发送顺序匹配 */
+  LmiPendingRequest entry;
+  bool found = lmi_pending_take(ctx, idx, transaction_id, false, &entry);
+  if (found) {
+    lmi_client_aux(ctx, idx)->echoes_txn = true;
+  } else if (!lmi_client_aux(ctx, idx)->echoes_txn) {
+    found = lmi_pending_take(ctx, idx, transaction_id, true, &entry);
+  }
+
+  pthread_mutex_lock(lmi_client_lock(ctx, idx));
+  DlmClient *client = lmi_client(ctx, idx);
+  BearerState *bearer = NULL;
+  if (found && entry.action == RESOURCE_ACTION_REQUEST) {
+    bearer = magic_dlm_find_bearer(client, entry.local_bearer_id);
+    if (bearer && cnf->status != STATUS_SUCCESS) {
+      magic_dlm_release_bearer(client, entry.local_bearer_id);
+      bearer = NULL;
+    } else if (bearer) {
+      bearer->dlm_bearer_id = cnf->has_bearer_id ? cnf->bearer_identifier : 0;
+    }
+  }
+  if (cnf->status == STATUS_SUCCESS && cnf->has_bearer_id && !bearer &&
+      (!found || entry.action == RESOURCE_ACTION_REQUEST)) {
+    /* DLM 分配成功但本地已无人认领 */
+    LINK_Resource_Request rel;
+    memset(&rel, 0, sizeof(rel));
+    rel.resource_action = RESOURCE_ACTION_RELEASE;
+    rel.has_bearer_id = true;
+    rel.bearer_identifier = cnf->bearer_identifier;
+    mih_transport_send(client_fd, MIH_LINK_RESOURCE_REQ, &rel, sizeof(rel));
+    fd_log_notice("[app_magic] ⚠ Releasing orphaned DLM bearer %u on %s "
+                  "(txn=%u)",
+                  cnf->bearer_identifier, client->link_id, transaction_id);
+  }
+  pthread_mutex_unlock(lmi_client_lock(ctx, idx));
+
+  if (!found) {
+    fd_log_notice("[app_magic] ⚠ Unmatched MIH_LINK_RESOURCE.confirm "
+                  "(txn=%u, status=%s)",
+                  transaction_id, status_to_string(cnf->status));
+    return;
+  }
+
+  /* 以 DLM 的结果完成请求 (Bearer ID 保持为本地镜像 ID) */
+  entry.confirm.status = cnf->status;
+  if (cnf->status != STATUS_SUCCESS &&
+      entry.action == RESOURCE_ACTION_REQUEST) {
+    entry.confirm.has_bearer_id = false;
+    entry.confirm.bearer_identifier = 0;
+  }
+  fd_log_debug("[app_magic] MIH_LINK_RESOURCE.confirm txn=%u: status=%s",
+               entry.transaction_id, status_to_string(cnf->status));
+  lmi_pending_finish(ctx, &entry);
+}
+
+/**
+ * @brief 异步发起 MIH_LINK_RESOURCE.Request。
+ * @details 流程:
+ *          1. 短暂持有 clients_mutex 解析目标 DLM (只拷贝下标与 fd)。
+ *          2. 持有该 DLM 的 Bearer 锁完成本地 Bearer 簿记,
+ *             登记在途请求并以事务 ID 写入 DLM Socket。
+ *          3. 释放锁后返回; Confirm/超时/断开时回调。
+ *
+ * @param ctx LMI 上下文指针。
+ * @param request 资源请求参数结构体。
+ * @param timeout_ms 确认超时 (毫秒)，0 表示默认值。
+ * @param cb 完成回调 (可为 NULL)。
+ * @param arg 回调用户参数。
+ * @return 事务 ID，0 表示请求未发起。
+ */
+uint32_t magic_lmi_resource_request_async(
+    MagicLmiContext *ctx, const MIH_Link_Resource_Request *request,
+    uint32_t timeout_ms, lmi_resource_cb_t cb, void *arg) {
+  /* 参数验证 */
+  if (!ctx || !request) {
+    return 0;
+  }
+
+  /* 查找对应的链路 */
+  DatalinkProfile *link = magic_config_find_datalink(
+      lmi_config(ctx), lmi_request_link_name(request));
+  if (!link || !link->is_active) {
+    /* 链路不可用 */
+    return 0;
+  }
+
+  /* v2.0: 查找对应的 DLM 客户端 (只在拷贝下标与 fd 时持有全局锁) */
+  int idx = -1;
+  int fd = -1;
+  pthread_mutex_lock(&ctx->clients_mutex);
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        strcmp(lmi_client(ctx, i)->link_id, link->dlm_name) == 0) {
+      idx = i;
+      fd = lmi_client(ctx, i)->client_fd;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->clients_mutex);
+  if (idx < 0) {
+    /* DLM 客户端不可用 */
+    return 0;
+  }
+
+  /* 构造内部消息 */
+  MsgMihResourceReq req;
+  memset(&req, 0, sizeof(req));
+  strncpy(req.link_id, link->dlm_name, sizeof(req.link_id) - 1);
+  req.action = request->resource_action;
+  req.has_bearer_id = request->has_bearer_id;
+  if (request->has_bearer_id) {
+    req.bearer_id = request->bearer_identifier;
+  }
+  req.has_qos_params = request->has_qos_params;
+  if (request->has_qos_params) {
+    req.qos_params = request->qos_parameters;
+  }
+
+  /* 在途记录 (确认中的身份字段来自请求) */
+  LmiPendingRequest entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.client_idx = idx;
+  entry.action = request->resource_action;
+  entry.callback = cb;
+  entry.arg = arg;
+  entry.deadline_ms = magic_timer_now_ms() +
+                      (timeout_ms ? timeout_ms : LMI_RESOURCE_TIMEOUT_MS);
+  entry.confirm.source_identifier = request->destination_id;
+  entry.confirm.link_identifier = request->link_identifier;
+
+  LINK_Resource_Request link_req;
+  memset(&link_req, 0, sizeof(link_req));
+  bool tracked = false;
+  bool send_failed = false;
+
+  pthread_mutex_lock(lmi_client_lock(ctx, idx));
+  DlmClient *client = lmi_client(ctx, idx);
+  if (!client->is_registered || client->client_fd != fd) {
+    /* 解析之后 DLM 已断开 */
+    pthread_mutex_unlock(lmi_client_lock(ctx, idx));
+    return 0;
+  }
 
-  /* 查找对应的 DLM 客户端 */
-  DlmClient *client = NULL;
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        ctx->clients[i].client_fd == client_fd) {
-      client = &ctx->clients[i];
-      break;
-    }
+  /* 释放前记下 DLM 侧的 Bearer ID */
+  BEARER_ID dlm_bearer = 0;
+  if (req.action == RESOURCE_ACTION_RELEASE && req.has_bearer_id) {
+    BearerState *bearer = magic_dlm_find_bearer(client, req.bearer_id);
+    dlm_bearer = bearer ? bearer->dlm_bearer_id : 0;
   }
 
-  if (!client) {
-    /* 客户端未找到 */
-    fd_log_error("[app_magic] DLM client not found");
-    memset(&resp, 0, sizeof(resp));
-    resp.status = STATUS_FAILURE;
-    strncpy(resp.reason, "Client not registered", sizeof(resp.reason) - 1);
-    pthread_mutex_unlock(&ctx->clients_mutex);
-    send_ipc_msg(client_fd, MSG_TYPE_RESOURCE_RESP, &resp, sizeof(resp));
-    return;
+  /* 本地 Bearer 簿记 (准入、分配或释放镜像) */
+  MsgMihResourceResp resp;
+  handle_mih_resource_request_internal(ctx, client, &req, &resp);
+  entry.transaction_id = mih_transport_next_transaction_id();
+  entry.confirm.status = resp.status;
+  entry.confirm.has_bearer_id = resp.has_bearer_id;
+  entry.confirm.bearer_identifier = resp.has_bearer_id ? resp.bearer_id : 0;
+
+  /* 流式连接上的新分配与已由 DLM 确认的释放需要等待 DLM 应答;
+   * QoS 更新没有对应的 DLM 原语, 仅在本地生效 */
+  if (fd >= 0 && resp.status == STATUS_SUCCESS) {
+    if (req.action == RESOURCE_ACTION_REQUEST && !req.has_bearer_id) {
+      link_req.resource_action = RESOURCE_ACTION_REQUEST;
+      link_req.has_qos_params = true;
+      link_req.qos_parameters = req.qos_params;
+      entry.local_bearer_id = resp.bearer_id;
+      tracked = true;
+    } else if (req.action == RESOURCE_ACTION_RELEASE && dlm_bearer != 0) {
+      link_req.resource_action = RESOURCE_ACTION_RELEASE;
+      link_req.has_bearer_id = true;
+      link_req.bearer_identifier = dlm_bearer;
+      tracked = true;
+    }
   }
 
-  /* 调用内部处理函数 */
-  handle_mih_resource_request_internal(ctx, client, req, &resp);
+  if (tracked && lmi_pending_add(ctx, &entry) != 0) {
+    fd_log_error("[app_magic] ✗ LMI pending table full (%d)",
+                 LMI_MAX_PENDING);
+    tracked = false;
+    if (entry.local_bearer_id) {
+      /* 无法跟踪的新分配直接拒绝 */
+      magic_dlm_release_bearer(client, entry.local_bearer_id);
+      entry.confirm.status = STATUS_INSUFFICIENT_RESOURCES;
+      entry.confirm.has_bearer_id = false;
+      entry.confirm.bearer_identifier = 0;
+    } else {
+      /* 释放仍然下发, 只是不再等待应答 */
+      mih_transport_send(fd, MIH_LINK_RESOURCE_REQ, &link_req,
+                         sizeof(link_req));
+    }
+  }
 
-  /* 解锁客户端数组 */
-  pthread_mutex_unlock(&ctx->clients_mutex);
+  if (tracked) {
+    send_failed = mih_transport_send_txn(fd, MIH_LINK_RESOURCE_REQ, &link_req,
+                                         sizeof(link_req),
+                                         entry.transaction_id) != 0;
+  }
+  pthread_mutex_unlock(lmi_client_lock(ctx, idx));
+
+  fd_log_debug("[app_magic] MIH_LINK_RESOURCE.request txn=%u on %s: %s, "
+               "local=%s, bearer=%u%s",
+               entry.transaction_id, link->dlm_name,
+               resource_action_to_string(req.action),
+               status_to_string(resp.status), entry.confirm.bearer_identifier,
+               tracked ? " (awaiting DLM)" : "");
+
+  if (!tracked) {
+    /* 本地即时完成 */
+    lmi_pending_finish(ctx, &entry);
+  } else if (send_failed) {
+    /* 写入失败: 若尚未被断开路径摘除则自行以失败完成 */
+    LmiPendingRequest taken;
+    if (lmi_pending_take(ctx, idx, entry.transaction_id, false, &taken)) {
+      fd_log_error("[app_magic] ✗ Failed to send MIH_LINK_RESOURCE.request "
+                   "to %s",
+                   link->dlm_name);
+      lmi_pending_fail(ctx, &taken, STATUS_FAILURE, true);
+    }
+  }
 
-  /* 发送响应消息 */
-  send_ipc_msg(client_fd, MSG_TYPE_RESOURCE_RESP, &resp, sizeof(resp));
+  return entry.transaction_id;
+}
 
-  /* 记录响应信息 */
-  fd_log_notice("[app_magic] MIH_LINK_RESOURCE.Confirm:");
-  fd_log_notice("[app_magic]   Status: %s", status_to_string(resp.status));
-  if (resp.has_bearer_id) {
-    fd_log_notice("[app_magic]   Bearer ID: %u", resp.bearer_id);
-  }
-  fd_log_notice("[app_magic]   Reason: %s", resp.reason);
+/**
+ * @brief 同步封装使用的一次性结果槽。
+ */
+typedef struct {
+  pthread_mutex_t mutex;             ///< 保护 done/confirm。
+  pthread_cond_t cond;               ///< 完成通知。
+  bool done;                         ///< 是否已完成。
+  MIH_Link_Resource_Confirm confirm; ///< 完成结果。
+} LmiResourceFuture;
+
+/** 同步封装的完成回调: 填充结果槽并唤醒等待者。 */
+static void lmi_future_complete(MagicLmiContext *ctx, uint32_t transaction_id,
+                                const MIH_Link_Resource_Confirm *confirm,
+                                void *arg) {
+  LmiResourceFuture *future = (LmiResourceFuture *)arg;
+
+  (void)ctx;
+  (void)transaction_id;
+  pthread_mutex_lock(&future->mutex);
+  future->confirm = *confirm;
+  future->done = true;
+  pthread_cond_signal(&future->cond);
+  pthread_mutex_unlock(&future->mutex);
 }
 
 /**
  * @brief 实现 MIH_LINK_RESOURCE.Request (High-Level API)。
  * @details 供高层应用程序 (如 SESS 模块) 调用的 API，用于发起资源操作。
  *          提供符合 IEEE 802.21 标准的接口。
+ *          基于 magic_lmi_resource_request_async() 等待 DLM 的 Confirm,
+ *          等待期间不持有任何 LMI 锁。
  *
  * @param ctx LMI 上下文指针。
  * @param request 资源请求参数结构体。
@@ -1553,64 +2558,63 @@ int magic_dlm_mih_link_resource_request(
   /* 初始化确认消息 */
   memset(confirm, 0, sizeof(MIH_Link_Resource_Confirm));
 
-  /* 查找对应的链路 */
-  DatalinkProfile *link = magic_config_find_datalink(
-      ctx->config, request->link_identifier.link_addr);
-  if (!link || !link->is_active) {
-    /* 链路不可用 */
+  LmiResourceFuture future;
+  memset(&future, 0, sizeof(future));
+  pthread_mutex_init(&future.mutex, NULL);
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&future.cond, &cattr);
+  pthread_condattr_destroy(&cattr);
+
+  uint32_t txn = magic_lmi_resource_request_async(
+      ctx, request, LMI_RESOURCE_TIMEOUT_MS, lmi_future_complete, &future);
+  if (txn == 0) {
+    /* 链路或 DLM 客户端不可用 */
     confirm->status = STATUS_LINK_NOT_AVAILABLE;
+    pthread_cond_destroy(&future.cond);
+    pthread_mutex_destroy(&future.mutex);
     return -1;
   }
 
-  /* 构造内部消息 */
-  MsgMihResourceReq req;
-  memset(&req, 0, sizeof(req));
-
-  /* v2.0: 设置 DLM 名称 */
-  strncpy(req.link_id, link->dlm_name, sizeof(req.link_id) - 1);
-
-  /* 设置操作类型 */
-  req.action = request->resource_action;
-
-  /* 设置 Bearer ID（如果有） */
-  req.has_bearer_id = request->has_bearer_id;
-  if (request->has_bearer_id) {
-    req.bearer_id = request->bearer_identifier;
-  }
+  /* 超时由事件循环负责; 额外 1 秒余量兜底事件循环未运行的情况 */
+  uint64_t deadline = magic_timer_now_ms() + LMI_RESOURCE_TIMEOUT_MS + 1000;
+  struct timespec ts;
+  ts.tv_sec = (time_t)(deadline / 1000ULL);
+  ts.tv_nsec = (long)((deadline % 1000ULL) * 1000000ULL);
 
-  /* 设置 QoS 参数（如果有） */
-  req.has_qos_params = request->has_qos_params;
-  if (request->has_qos_params) {
-    req.qos_params = request->qos_parameters;
+  pthread_mutex_lock(&future.mutex);
+  while (!future.done) {
+    if (pthread_cond_timedwait(&future.cond, &future.mutex, &ts) ==
+        ETIMEDOUT) {
+      break;
+    }
   }
+  bool done = future.done;
+  pthread_mutex_unlock(&future.mutex);
 
-  /* v2.0: 查找对应的 DLM 客户端 */
-  DlmClient *dlm_client = magic_lmi_find_by_link(ctx, link->dlm_name);
-  if (!dlm_client) {
-    /* DLM 客户端不可用 */
-    confirm->status = STATUS_LINK_NOT_AVAILABLE;
-    return -1;
+  if (!done) {
+    /* 自行摘除并以失败完成; 已被其他线程摘除则等待其回调结束 */
+    LmiPendingRequest entry;
+    if (lmi_pending_take(ctx, -1, txn, false, &entry)) {
+      lmi_pending_fail(ctx, &entry, STATUS_FAILURE, true);
+    }
+    pthread_mutex_lock(&future.mutex);
+    while (!future.done) {
+      pthread_cond_wait(&future.cond, &future.mutex);
+    }
+    pthread_mutex_unlock(&future.mutex);
   }
 
-  /* 处理请求（直接调用内部函数，不通过IPC） */
-  MsgMihResourceResp resp;
-  pthread_mutex_lock(&ctx->clients_mutex);
-  handle_mih_resource_request_internal(ctx, dlm_client, &req, &resp);
-  pthread_mutex_unlock(&ctx->clients_mutex);
-
-  /* 填充确认消息 */
-  confirm->source_identifier = request->destination_id;
-  confirm->link_identifier = request->link_identifier;
-  confirm->status = resp.status;
-  confirm->has_bearer_id = resp.has_bearer_id;
-  if (resp.has_bearer_id) {
-    confirm->bearer_identifier = resp.bearer_id;
-  }
+  *confirm = future.confirm;
+  pthread_cond_destroy(&future.cond);
+  pthread_mutex_destroy(&future.mutex);
 
   /* 记录 API 调用结果 */
   fd_log_notice(
       "[app_magic] MIH_LINK_RESOURCE high-level API: status=%s, bearer=%d",
-      status_to_string(resp.status), resp.has_bearer_id ? resp.bearer_id : 0);
+      status_to_string(confirm->status),
+      confirm->has_bearer_id ? confirm->bearer_identifier : 0);
 
   /* 返回操作结果 */
   return (confirm->status == STATUS_SUCCESS) ? 0 : -1;
@@ -1756,59 +2760,60 @@ static DlmClient *find_or_create_dgram_client(MagicLmiContext *ctx,
   pthread_mutex_lock(&ctx->clients_mutex);
 
   /* 查找已存在的客户端 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered) {
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered) {
       /* 使用 link_id 匹配套接字路径中的 DLM 类型 */
       if (strstr(sock_path, "cellular") &&
-          strstr(ctx->clients[i].dlm_id, "CELLULAR")) {
+          strstr(lmi_client(ctx, i)->dlm_id, "CELLULAR")) {
         pthread_mutex_unlock(&ctx->clients_mutex);
-        return &ctx->clients[i];
+        return lmi_client(ctx, i);
       }
       if (strstr(sock_path, "satcom") &&
-          strstr(ctx->clients[i].dlm_id, "SATCOM")) {
+          strstr(lmi_client(ctx, i)->dlm_id, "SATCOM")) {
         pthread_mutex_unlock(&ctx->clients_mutex);
-        return &ctx->clients[i];
+        return lmi_client(ctx, i);
       }
-      if (strstr(sock_path, "wifi") && strstr(ctx->clients[i].dlm_id, "WIFI")) {
+      if (strstr(sock_path, "wifi") &&
+          strstr(lmi_client(ctx, i)->dlm_id, "WIFI")) {
         pthread_mutex_unlock(&ctx->clients_mutex);
-        return &ctx->clients[i];
+        return lmi_client(ctx, i);
       }
     }
   }
 
   /* 查找空闲槽位创建新客户端 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (!ctx->clients[i].is_registered) {
-      DlmClient *client = &ctx->clients[i];
-      memset(client, 0, sizeof(DlmClient));
-      client->is_registered = true;
-      client->client_fd = -1; /* 数据报模式无持久连接 */
-      client->last_heartbeat = time(NULL);
-
-      /* 从套接字路径提取 DLM 类型 - 使用与配置文件一致的 LINK_xxx 格式 */
-      if (strstr(sock_path, "cellular")) {
-        strncpy(client->dlm_id, "DLM_CELLULAR_DGRAM",
-                sizeof(client->dlm_id) - 1);
-        strncpy(client->link_id, "LINK_CELLULAR", sizeof(client->link_id) - 1);
-        client->link_identifier.link_type = LINK_PARAM_TYPE_FDD_LTE;
-      } else if (strstr(sock_path, "satcom")) {
-        strncpy(client->dlm_id, "DLM_SATCOM_DGRAM", sizeof(client->dlm_id) - 1);
-        strncpy(client->link_id, "LINK_SATCOM", sizeof(client->link_id) - 1);
-        client->link_identifier.link_type = LINK_PARAM_TYPE_SATCOM_KU;
-      } else if (strstr(sock_path, "wifi")) {
-        strncpy(client->dlm_id, "DLM_WIFI_DGRAM", sizeof(client->dlm_id) - 1);
-        strncpy(client->link_id, "LINK_WIFI", sizeof(client->link_id) - 1);
-        client->link_identifier.link_type = LINK_PARAM_TYPE_802_11;
-      } else {
-        strncpy(client->dlm_id, "DLM_UNKNOWN", sizeof(client->dlm_id) - 1);
-        strncpy(client->link_id, "LINK_UNKNOWN", sizeof(client->link_id) - 1);
-      }
-
-      fd_log_notice("[app_magic] Created DGRAM client for %s: %s (link_id=%s)",
-                    sock_path, client->dlm_id, client->link_id);
-      pthread_mutex_unlock(&ctx->clients_mutex);
-      return client;
+  int free_idx = lmi_client_alloc_locked(ctx); /* 表满时扩容 */
+  if (free_idx >= 0) {
+    DlmClient *client = lmi_client(ctx, free_idx);
+    memset(client, 0, sizeof(DlmClient));
+    client->is_registered = true;
+    client->client_fd = -1; /* 数据报模式无持久连接 */
+    client->last_heartbeat = time(NULL);
+    lmi_client_seen(client, LMI_SEEN_OTHER);
+
+    /* 从套接字路径提取 DLM 类型 - 使用与配置文件一致的 LINK_xxx 格式 */
+    if (strstr(sock_path, "cellular")) {
+      strncpy(client->dlm_id, "DLM_CELLULAR_DGRAM",
+              sizeof(client->dlm_id) - 1);
+      strncpy(client->link_id, "LINK_CELLULAR", sizeof(client->link_id) - 1);
+      client->link_identifier.link_type = LINK_PARAM_TYPE_FDD_LTE;
+    } else if (strstr(sock_path, "satcom")) {
+      strncpy(client->dlm_id, "DLM_SATCOM_DGRAM", sizeof(client->dlm_id) - 1);
+      strncpy(client->link_id, "LINK_SATCOM", sizeof(client->link_id) - 1);
+      client->link_identifier.link_type = LINK_PARAM_TYPE_SATCOM_KU;
+    } else if (strstr(sock_path, "wifi")) {
+      strncpy(client->dlm_id, "DLM_WIFI_DGRAM", sizeof(client->dlm_id) - 1);
+      strncpy(client->link_id, "LINK_WIFI", sizeof(client->link_id) - 1);
+      client->link_identifier.link_type = LINK_PARAM_TYPE_802_11;
+    } else {
+      strncpy(client->dlm_id, "DLM_UNKNOWN", sizeof(client->dlm_id) - 1);
+      strncpy(client->link_id, "LINK_UNKNOWN", sizeof(client->link_id) - 1);
     }
+
+    fd_log_notice("[app_magic] Created DGRAM client for %s: %s (link_id=%s)",
+                  sock_path, client->dlm_id, client->link_id);
+    pthread_mutex_unlock(&ctx->clients_mutex);
+    return client;
   }
 
   pthread_mutex_unlock(&ctx->clients_mutex);
@@ -1887,16 +2892,17 @@ static void handle_dgram_link_up_indication(MagicLmiContext *ctx,
   sync_client_params(client);
 
   client->last_heartbeat = time(NULL);
-  client->last_seen = time(NULL); /* 更新最后接收消息时间 */
+  lmi_client_seen(client, LMI_SEEN_OTHER); /* 更新最后接收消息时间 */
+  memset(&client->quality, 0, sizeof(client->quality)); /* 重新学习链路质量 */
   pthread_mutex_unlock(&ctx->clients_mutex);
 
   /* v2.0: 更新配置中的 DLM 状态 */
   bool first_up = false;
   fd_log_notice(
-      "[app_magic] Looking up DLM: client->link_id='%s', ctx->config=%p",
-      client->link_id, (void *)ctx->config);
-  if (ctx->config) {
-    DLMConfig *dlm = magic_config_find_dlm(ctx->config, client->link_id);
+      "[app_magic] Looking up DLM: client->link_id='%s', config=%p",
+      client->link_id, (void *)lmi_config(ctx));
+  if (lmi_config(ctx)) {
+    DLMConfig *dlm = magic_config_find_dlm(lmi_config(ctx), client->link_id);
     fd_log_notice("[app_magic] magic_config_find_dlm returned: %p",
                   (void *)dlm);
     if (dlm) {
@@ -1904,7 +2910,7 @@ static void handle_dgram_link_up_indication(MagicLmiContext *ctx,
                     dlm->dlm_name, dlm->is_active);
       if (!dlm->is_active) {
         first_up = true;
-        dlm->is_active = true;
+        magic_config_set_link_active(ctx->config_store, dlm->dlm_name, true);
         fd_log_notice("[app_magic] Set dlm->is_active = true for %s",
                       dlm->dlm_name);
       }
@@ -1913,7 +2919,7 @@ static void handle_dgram_link_up_indication(MagicLmiContext *ctx,
                    client->link_id);
     }
   } else {
-    fd_log_error("[app_magic] ctx->config is NULL!");
+    fd_log_error("[app_magic] Configuration not loaded!");
   }
 
   /* 首次上线打印详细日志，后续心跳只打印调试日志 */
@@ -1961,11 +2967,11 @@ static void handle_dgram_link_down_indication(MagicLmiContext *ctx,
   const LINK_Down_Indication *ind = (const LINK_Down_Indication *)data;
   DlmClient *client = find_or_create_dgram_client(ctx, from_path);
 
-  if (client && ctx->config) {
+  if (client && lmi_config(ctx)) {
     DatalinkProfile *link =
-        magic_config_find_datalink(ctx->config, client->link_id);
+        magic_config_find_datalink(lmi_config(ctx), client->link_id);
     if (link) {
-      link->is_active = false;
+      magic_config_set_link_active(ctx->config_store, link->dlm_name, false);
     }
 
     /* v2.2: 从数据平面注销链路 */
@@ -2023,15 +3029,23 @@ static void handle_dgram_parameters_report(MagicLmiContext *ctx,
     sync_client_params(client);
 
     client->last_heartbeat = time(NULL);
-    client->last_seen = time(NULL); /* 更新最后接收消息时间 */
+    /* 数据报 DLM 无独立心跳, 以周期性参数报告学习到达间隔 */
+    lmi_client_seen(client, LMI_SEEN_REPORT);
+
+    /* 更新链路质量趋势 */
+    LINK_Going_Down_Indication going_down;
+    LmiQualityChange change =
+        lmi_quality_update(client, &ind->parameters, &going_down);
     pthread_mutex_unlock(&ctx->clients_mutex);
 
+    lmi_quality_notify(ctx, client->link_id, change, &going_down);
+
     /* 隐式 Link_Up: 如果链路能发送参数报告，说明它已经在线 */
-    if (ctx->config) {
+    if (lmi_config(ctx)) {
       DatalinkProfile *link =
-          magic_config_find_datalink(ctx->config, client->link_id);
+          magic_config_find_datalink(lmi_config(ctx), client->link_id);
       if (link && !link->is_active) {
-        link->is_active = true;
+        magic_config_set_link_active(ctx->config_store, link->dlm_name, true);
         fd_log_notice("[app_magic] ✓ Link %s marked ONLINE (implicit via "
                       "Parameters_Report)",
                       client->link_id);
@@ -2068,6 +3082,7 @@ static void handle_dgram_capability_confirm(MagicLmiContext *ctx,
     pthread_mutex_lock(&ctx->clients_mutex);
     memcpy(&client->link_capability, &cnf->capability, sizeof(LINK_CAPABILITY));
     client->last_heartbeat = time(NULL);
+    lmi_client_seen(client, LMI_SEEN_OTHER);
     pthread_mutex_unlock(&ctx->clients_mutex);
   }
 
@@ -2103,6 +3118,7 @@ static void handle_dgram_get_parameters_confirm(MagicLmiContext *ctx,
     memcpy(&client->current_parameters, &cnf->parameters,
            sizeof(LINK_PARAMETERS));
     client->last_heartbeat = time(NULL);
+    lmi_client_seen(client, LMI_SEEN_OTHER);
     pthread_mutex_unlock(&ctx->clients_mutex);
   }
 
@@ -2133,6 +3149,7 @@ static void handle_dgram_event_subscribe_confirm(MagicLmiContext *ctx,
     pthread_mutex_lock(&ctx->clients_mutex);
     client->subscribed_events = cnf->subscribed_events;
     client->last_heartbeat = time(NULL);
+    lmi_client_seen(client, LMI_SEEN_OTHER);
     pthread_mutex_unlock(&ctx->clients_mutex);
   }
 
@@ -2162,6 +3179,42 @@ static void handle_dgram_resource_confirm(MagicLmiContext *ctx,
   }
 }
 
+/**
+ * @brief 处理数据报模式的 Link_Going_Down.indication
+ * @details 与流式连接相同, 首次进入劣化时触发 LINK_EVENT_GOING_DOWN。
+ *
+ * @param ctx LMI 上下文指针。
+ * @param from_path 消息来源路径。
+ * @param data 消息数据指针。
+ * @param len 消息长度。
+ */
+static void handle_dgram_going_down(MagicLmiContext *ctx,
+                                    const char *from_path,
+                                    const uint8_t *data, size_t len) {
+  if (len < sizeof(LINK_Going_Down_Indication)) {
+    fd_log_error("[app_magic] DGRAM Link_Going_Down too short: %zu", len);
+    return;
+  }
+
+  const LINK_Going_Down_Indication *ind =
+      (const LINK_Going_Down_Indication *)data;
+  DlmClient *client = find_or_create_dgram_client(ctx, from_path);
+
+  fd_log_notice("[app_magic] DGRAM Link_Going_Down.indication from %s "
+                "(in %u ms: %.*s)",
+                from_path, ind->time_to_down_ms,
+                (int)sizeof(ind->reason_text), ind->reason_text);
+
+  if (client) {
+    pthread_mutex_lock(&ctx->clients_mutex);
+    lmi_client_seen(client, LMI_SEEN_OTHER);
+    LmiQualityChange change = lmi_quality_going_down(client, ind);
+    pthread_mutex_unlock(&ctx->clients_mutex);
+
+    lmi_quality_notify(ctx, client->link_id, change, ind);
+  }
+}
+
 /**
  * @brief 处理数据报模式接收到的消息。
  * @details 根据 2 字节的消息类型码 (`msg_type`) 分发到对应的具体处理函数。
@@ -2196,9 +3249,7 @@ static void process_dgram_message(MagicLmiContext *ctx, const char *from_path,
     break;
 
   case MIH_LINK_GOING_DOWN_IND:
-    fd_log_notice("[app_magic] DGRAM Link_Going_Down.indication from %s",
-                  from_path);
-    /* TODO: 实现 Link_Going_Down 处理 */
+    handle_dgram_going_down(ctx, from_path, data, len);
     break;
 
   case MIH_LINK_PARAMETERS_REPORT_IND:
@@ -2241,74 +3292,39 @@ static void process_dgram_message(MagicLmiContext *ctx, const char *from_path,
 }
 
 /**
- * @brief 数据报服务器主线程 (DGRAM)。
- * @details 创建并运行数据报模式服务器循环。
- *          - 使用 `select()` 监听 Socket，支持超时和非阻塞退出。
+ * @brief 处理数据报 Socket 可读事件 (DGRAM)。
+ * @details 由事件循环在 Socket 可读时调用, 每次接收并处理一个数据报;
+ *          剩余数据报在下一轮 epoll_wait 中继续处理。
  *          - 接收消息格式：[Type(2B)][Payload...]。
  *
- * @param arg 线程参数 (`MagicLmiContext*`)。
- * @return NULL。
+ * @param ctx LMI 上下文指针。
  */
-static void *dgram_server_thread(void *arg) {
-  MagicLmiContext *ctx = (MagicLmiContext *)arg;
-
-  fd_log_notice("[app_magic] DGRAM server thread started (fd=%d)",
-                ctx->dgram_fd);
-
+static void lmi_read_dgram(MagicLmiContext *ctx) {
   uint8_t buffer[MIH_MAX_MESSAGE_SIZE];
   struct sockaddr_un from_addr;
-  socklen_t from_len;
-
-  while (ctx->dgram_running) {
-    /* 使用 select() 实现超时接收 */
-    fd_set readfds;
-    struct timeval tv;
-
-    FD_ZERO(&readfds);
-    FD_SET(ctx->dgram_fd, &readfds);
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-
-    int ret = select(ctx->dgram_fd + 1, &readfds, NULL, NULL, &tv);
-
-    if (ret < 0) {
-      if (errno == EINTR)
-        continue;
-      fd_log_error("[app_magic] DGRAM select() failed: %s", strerror(errno));
-      break;
-    }
-
-    if (ret == 0) {
-      /* 超时，继续循环 */
-      continue;
-    }
-
-    /* 接收消息 */
-    from_len = sizeof(from_addr);
-    memset(&from_addr, 0, sizeof(from_addr));
+  socklen_t from_len = sizeof(from_addr);
 
-    uint16_t msg_type;
-    int payload_len =
-        mih_transport_recvfrom(ctx->dgram_fd, (struct sockaddr *)&from_addr,
-                               &from_len, &msg_type, buffer, sizeof(buffer));
+  /* 接收消息 */
+  memset(&from_addr, 0, sizeof(from_addr));
 
-    if (payload_len < 0) {
-      fd_log_error("[app_magic] DGRAM recvfrom() failed");
-      continue;
-    }
+  uint16_t msg_type;
+  int payload_len =
+      mih_transport_recvfrom(ctx->dgram_fd, (struct sockaddr *)&from_addr,
+                             &from_len, &msg_type, buffer, sizeof(buffer));
 
-    /* 处理消息 */
-    process_dgram_message(ctx, from_addr.sun_path, msg_type, buffer,
-                          (size_t)payload_len);
+  if (payload_len < 0) {
+    fd_log_error("[app_magic] DGRAM recvfrom() failed");
+    return;
   }
 
-  fd_log_notice("[app_magic] DGRAM server thread exiting");
-  return NULL;
+  /* 处理消息 */
+  process_dgram_message(ctx, from_addr.sun_path, msg_type, buffer,
+                        (size_t)payload_len);
 }
 
 /**
  * @brief 启动数据报模式 LMI 服务器。
- * @details 创建 Unix Domain Datagram Socket 并启动接收线程。
+ * @details 创建 Unix Domain Datagram Socket 并交给 LMI 事件循环接收。
  *          用于兼容旧版或轻量级 DLM 客户端，无需建立持久连接。
  *
  * @param ctx LMI 上下文指针。
@@ -2331,12 +3347,13 @@ int magic_lmi_start_dgram_server(MagicLmiContext *ctx,
     return -1;
   }
 
-  /* 启动服务器线程 */
+  /* 交给事件循环接收 */
   ctx->dgram_running = true;
-  if (pthread_create(&ctx->dgram_thread, NULL, dgram_server_thread, ctx) != 0) {
-    fd_log_error("[app_magic] Failed to create DGRAM server thread");
+  if (lmi_reactor_add(ctx, ctx->dgram_fd, LMI_EV_DGRAM) != 0) {
+    fd_log_error("[app_magic] Failed to watch DGRAM server socket");
     close(ctx->dgram_fd);
     ctx->dgram_fd = -1;
+    ctx->dgram_running = false;
     return -1;
   }
 
@@ -2376,8 +3393,9 @@ static void handle_udp_heartbeat(MagicLmiContext *ctx,
                hb->dlm_id);
 
   /* 验证链路是否在配置文件中定义 */
-  if (ctx->config) {
-    DatalinkProfile *link = magic_config_find_datalink(ctx->config, hb->dlm_id);
+  if (lmi_config(ctx)) {
+    DatalinkProfile *link =
+        magic_config_find_datalink(lmi_config(ctx), hb->dlm_id);
     if (!link) {
       fd_log_error("[app_magic] ✗ Rejected UDP heartbeat from %s - Link not "
                    "defined in configuration: %s",
@@ -2400,10 +3418,10 @@ static void handle_udp_heartbeat(MagicLmiContext *ctx,
   int client_index = -1;
 
   /* 先查找是否已经存在 */
-  for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-    if (ctx->clients[i].is_registered &&
-        strcmp(ctx->clients[i].dlm_id, hb->dlm_id) == 0) {
-      client = &ctx->clients[i];
+  for (int i = 0; i < lmi_client_capacity(ctx); i++) {
+    if (lmi_client(ctx, i)->is_registered &&
+        strcmp(lmi_client(ctx, i)->dlm_id, hb->dlm_id) == 0) {
+      client = lmi_client(ctx, i);
       client_index = i;
       break;
     }
@@ -2411,39 +3429,36 @@ static void handle_udp_heartbeat(MagicLmiContext *ctx,
 
   /* 如果不存在，创建新记录 */
   if (!client) {
-    for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-      if (!ctx->clients[i].is_registered) {
-        client = &ctx->clients[i];
-        client_index = i;
-
-        /* 初始化新客户端 */
-        memset(client, 0, sizeof(DlmClient));
-        client->is_registered = true;
-        client->client_fd = -1; /* UDP 不使用连接 */
-        strncpy(client->dlm_id, hb->dlm_id, sizeof(client->dlm_id) - 1);
-        strncpy(client->link_id, hb->dlm_id, sizeof(client->link_id) - 1);
-        client->last_heartbeat = time(NULL);
-        client->last_seen = time(NULL);
-
-        /* 更新链路状态为活动 */
-        if (ctx->config) {
-          DatalinkProfile *link =
-              magic_config_find_datalink(ctx->config, client->link_id);
-          if (link) {
-            link->is_active = true;
-          }
-        }
+    client_index = lmi_client_alloc_locked(ctx); /* 表满时扩容 */
+    if (client_index >= 0) {
+      client = lmi_client(ctx, client_index);
 
-        fd_log_notice(
-            "[app_magic] ✓ DLM registered via UDP: %s (index=%d, from %s:%d)",
-            client->dlm_id, client_index, inet_ntoa(from_addr->sin_addr),
-            ntohs(from_addr->sin_port));
+      /* 初始化新客户端 */
+      memset(client, 0, sizeof(DlmClient));
+      client->is_registered = true;
+      client->client_fd = -1; /* UDP 不使用连接 */
+      strncpy(client->dlm_id, hb->dlm_id, sizeof(client->dlm_id) - 1);
+      strncpy(client->link_id, hb->dlm_id, sizeof(client->link_id) - 1);
+      client->last_heartbeat = time(NULL);
+      lmi_client_seen(client, LMI_SEEN_HEARTBEAT);
+
+      /* 更新链路状态为活动 */
+      if (lmi_config(ctx)) {
+        DatalinkProfile *link =
+            magic_config_find_datalink(lmi_config(ctx), client->link_id);
+        if (link) {
+          magic_config_set_link_active(ctx->config_store, link->dlm_name,
+                                       true);
+        }
+      }
 
-        /* 触发链路上线事件 */
-        trigger_lmi_event_callbacks(ctx, client->link_id, LINK_EVENT_UP, NULL);
+      fd_log_notice(
+          "[app_magic] ✓ DLM registered via UDP: %s (index=%d, from %s:%d)",
+          client->dlm_id, client_index, inet_ntoa(from_addr->sin_addr),
+          ntohs(from_addr->sin_port));
 
-        break;
-      }
+      /* 触发链路上线事件 */
+      trigger_lmi_event_callbacks(ctx, client->link_id, LINK_EVENT_UP, NULL);
     }
 
     if (!client) {
@@ -2455,7 +3470,7 @@ static void handle_udp_heartbeat(MagicLmiContext *ctx,
   } else {
     /* 更新现有客户端的心跳时间 */
     client->last_heartbeat = time(NULL);
-    client->last_seen = time(NULL);
+    lmi_client_seen(client, LMI_SEEN_HEARTBEAT);
 
     fd_log_debug(
         "[app_magic] Updated heartbeat for DLM: %s (last_seen updated)",
@@ -2466,70 +3481,35 @@ static void handle_udp_heartbeat(MagicLmiContext *ctx,
 }
 
 /**
- * @brief UDP 监听线程主函数。
- * @details 持续监听 UDP 端口 (默认 1947) 接收心跳广播。
- *          使用 `select()` 实现非阻塞 I/O。
+ * @brief 处理 UDP Socket 可读事件。
+ * @details 由事件循环在 UDP 端口 (默认 1947) 可读时调用,
+ *          每次接收并处理一个心跳广播。
  *
- * @param arg 线程参数 (`MagicLmiContext*`)。
- * @return NULL。
+ * @param ctx LMI 上下文指针。
  */
-static void *udp_listener_thread(void *arg) {
-  MagicLmiContext *ctx = (MagicLmiContext *)arg;
-
-  fd_log_notice("[app_magic] UDP listener thread started (port=%u)",
-                ctx->udp_port);
-
+static void lmi_read_udp(MagicLmiContext *ctx) {
   uint8_t buffer[4096]; /* UDP 接收缓冲区 */
   struct sockaddr_in from_addr;
-  socklen_t from_len;
-
-  while (ctx->udp_running) {
-    /* 使用 select() 实现超时接收 */
-    fd_set readfds;
-    struct timeval tv;
-
-    FD_ZERO(&readfds);
-    FD_SET(ctx->udp_fd, &readfds);
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-
-    int ret = select(ctx->udp_fd + 1, &readfds, NULL, NULL, &tv);
-
-    if (ret < 0) {
-      if (errno == EINTR)
-        continue;
-      fd_log_error("[app_magic] UDP select() failed: %s", strerror(errno));
-      break;
-    }
-
-    if (ret == 0) {
-      /* 超时，继续循环 */
-      continue;
-    }
-
-    /* 接收 UDP 数据包 */
-    from_len = sizeof(from_addr);
-    memset(&from_addr, 0, sizeof(from_addr));
+  socklen_t from_len = sizeof(from_addr);
 
-    ssize_t recv_len = recvfrom(ctx->udp_fd, buffer, sizeof(buffer), 0,
-                                (struct sockaddr *)&from_addr, &from_len);
+  /* 接收 UDP 数据包 */
+  memset(&from_addr, 0, sizeof(from_addr));
 
-    if (recv_len < 0) {
-      fd_log_error("[app_magic] UDP recvfrom() failed: %s", strerror(errno));
-      continue;
-    }
+  ssize_t recv_len = recvfrom(ctx->udp_fd, buffer, sizeof(buffer), 0,
+                              (struct sockaddr *)&from_addr, &from_len);
 
-    if (recv_len == 0) {
-      /* 空数据包，忽略 */
-      continue;
-    }
+  if (recv_len < 0) {
+    fd_log_error("[app_magic] UDP recvfrom() failed: %s", strerror(errno));
+    return;
+  }
 
-    /* 处理接收到的消息 */
-    handle_udp_heartbeat(ctx, &from_addr, buffer, (size_t)recv_len);
+  if (recv_len == 0) {
+    /* 空数据包，忽略 */
+    return;
   }
 
-  fd_log_notice("[app_magic] UDP listener thread exiting");
-  return NULL;
+  /* 处理接收到的消息 */
+  handle_udp_heartbeat(ctx, &from_addr, buffer, (size_t)recv_len);
 }
 
 /**
@@ -2596,10 +3576,10 @@ int magic_lmi_start_udp_listener(MagicLmiContext *ctx, uint16_t port) {
     return -1;
   }
 
-  /* 启动 UDP 监听线程 */
+  /* 交给事件循环接收 */
   ctx->udp_running = true;
-  if (pthread_create(&ctx->udp_thread, NULL, udp_listener_thread, ctx) != 0) {
-    fd_log_error("[app_magic] Failed to create UDP listener thread");
+  if (lmi_reactor_add(ctx, ctx->udp_fd, LMI_EV_UDP) != 0) {
+    fd_log_error("[app_magic] Failed to watch UDP listener socket");
     close(ctx->udp_fd);
     ctx->udp_fd = -1;
     ctx->udp_running = false;
@@ -2701,79 +3681,289 @@ int magic_lmi_register_event_callback(MagicLmiContext *ctx, uint16_t event_type,
   return 0;
 }
 /*===========================================================================
- * 心跳监控线程
+ * LMI 事件循环 (epoll 反应器)
  *
- * 功能：定期检查所有已注册 DLM 的心跳超时情况
- * - 每隔 MONITOR_CHECK_INTERVAL_SEC 扫描一次所有客户端
- * - 对于超过 HEARTBEAT_TIMEOUT_SEC 未发送心跳的 DLM，触发 LINK_EVENT_DOWN
+ * 单线程统一处理流式监听 Socket、全部 DLM 流式连接、数据报 Socket、
+ * UDP 心跳 Socket, 以及驱动心跳超时与资源请求超时的 timerfd:
+ * - 按各 DLM 的自适应截止时刻 (见 lmi_client_deadline) 精确设定定时器
+ * - 对于超过截止时刻未收到任何消息的 DLM，触发 LINK_EVENT_DOWN
  * - 避免被动等待 Link_Down.indication，实现主动故障检测
  *
  * 典型场景：DLM 进程被 SIGKILL 杀死，无法发送 Link_Down 消息
  *===========================================================================*/
 
 /**
- * @brief 心跳监控线程函数。
- * @details 后台线程，定期 (每 5s) 检查所有 DLM 客户端的 `last_seen` 时间戳。
- *          - 如果 `now - last_seen > HEARTBEAT_TIMEOUT`，判定为超时。
- *          - 触发 `LINK_EVENT_DOWN` 事件并清理客户端资源。
- *          用于处理 DLM 异常退出 (Crash/Kill) 的情况。
+ * @brief 检查 DLM 心跳超时。
+ * @details 对超过自适应截止时刻的 DLM 触发
+ *          LINK_EVENT_DOWN: 流式 DLM 关闭连接并清理客户端,
+ *          数据报/UDP DLM 标记为未注册。回调在锁外调用。
+ *
+ * @param ctx LMI 上下文。
+ * @param now_ms 当前单调时钟 (毫秒)。
+ * @return 最早的下一次超时检查时刻，无已注册 DLM 时返回 UINT64_MAX。
+ */
+static uint64_t lmi_check_heartbeats(MagicLmiContext *ctx, uint64_t now_ms) {
+  int num_links = 0;
+  int num_fds = 0;
+  uint64_t next = UINT64_MAX;
+
+  pthread_mutex_lock(&ctx->clients_mutex);
+
+  /* 超时列表按客户端表当前容量分配 (持锁期间容量不变) */
+  int capacity = lmi_client_capacity(ctx);
+  char(*down_links)[MAX_ID_LEN] = calloc((size_t)capacity + 1, MAX_ID_LEN);
+  int *down_fds = calloc((size_t)capacity + 1, sizeof(*down_fds));
+  if (!down_links || !down_fds) {
+    pthread_mutex_unlock(&ctx->clients_mutex);
+    free(down_links);
+    free(down_fds);
+    return now_ms + 1000; /* 内存不足，稍后重试 */
+  }
+
+  /* 遍历所有客户端检查超时 */
+  for (int i = 0; i < capacity; i++) {
+    DlmClient *client = lmi_client(ctx, i);
+
+    /* 跳过未注册的客户端 */
+    if (!client->is_registered) {
+      continue;
+    }
+
+    uint64_t due = lmi_client_deadline(client);
+    if (now_ms < due) {
+      if (due < next) {
+        next = due;
+      }
+      continue;
+    }
+
+    fd_log_notice("[app_magic] ⚠ DLM heartbeat timeout detected: %s (last "
+                  "seen %llu ms ago, interval %u±%u ms, %u samples)",
+                  client->link_id,
+                  (unsigned long long)(now_ms - client->last_seen_ms),
+                  client->hb_mean_ms, client->hb_dev_ms, client->hb_samples);
+
+    if (client->client_fd >= 0) {
+      /* 流式连接: 由连接关闭路径清理并触发 LINK_EVENT_DOWN */
+      down_fds[num_fds++] = client->client_fd;
+    } else {
+      /* 标记为未注册（避免重复触发） */
+      memcpy(down_links[num_links++], client->link_id, MAX_ID_LEN);
+      client->is_registered = false;
+      fd_log_notice("[app_magic] ✓ Cleaned up timed-out DLM: %s",
+                    client->link_id);
+    }
+  }
+
+  pthread_mutex_unlock(&ctx->clients_mutex);
+
+  /* 触发 LINK_EVENT_DOWN 回调 */
+  for (int k = 0; k < num_links; k++) {
+    trigger_lmi_event_callbacks(ctx, down_links[k], LINK_EVENT_DOWN, NULL);
+  }
+  for (int k = 0; k < num_fds; k++) {
+    for (int c = 0; c < LMI_MAX_CONNECTIONS; c++) {
+      if (ctx->conns[c].fd == down_fds[k]) {
+        lmi_conn_close(ctx, &ctx->conns[c], true);
+        break;
+      }
+    }
+  }
+  free(down_links);
+  free(down_fds);
+  return next;
+}
+
+/**
+ * @brief 按绝对截止时刻设定超时 timerfd (UINT64_MAX 表示停用)。
+ */
+static void lmi_reactor_arm(MagicLmiContext *ctx, uint64_t deadline_ms) {
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+
+  if (deadline_ms != UINT64_MAX) {
+    its.it_value.tv_sec = (time_t)(deadline_ms / 1000ULL);
+    its.it_value.tv_nsec = (long)((deadline_ms % 1000ULL) * 1000000ULL);
+  }
+  timerfd_settime(ctx->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * @brief LMI 事件循环线程。
+ * @details 每轮先处理到期的心跳/资源请求超时并按最早截止时刻重设
+ *          timerfd, 然后在 epoll_wait 上阻塞, 按标签分发就绪事件。
  *
  * @param arg 线程参数 (`MagicLmiContext*`)。
  * @return NULL。
  */
-static void *heartbeat_monitor_thread_func(void *arg) {
+static void *lmi_reactor_thread(void *arg) {
   MagicLmiContext *ctx = (MagicLmiContext *)arg;
+  struct epoll_event events[LMI_EPOLL_BATCH];
+
+  fd_log_notice("[app_magic] ✓ LMI event loop started (heartbeat timeout=%ds)",
+                HEARTBEAT_TIMEOUT_SEC);
+
+  while (ctx->reactor_running) {
+    /* 处理到期超时并按最早截止时刻设定定时器 */
+    magic_config_read_begin(ctx->config_store);
+    uint64_t now = magic_timer_now_ms();
+    uint64_t next = lmi_check_heartbeats(ctx, now);
+    uint64_t pending_next = lmi_pending_expire(ctx, now);
+    lmi_reactor_arm(ctx, pending_next < next ? pending_next : next);
+    magic_config_read_end(ctx->config_store);
+
+    /* 阻塞等待期间不处于读临界区, 不拖延配置重载的宽限期 */
+    int n = epoll_wait(ctx->epoll_fd, events, LMI_EPOLL_BATCH, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fd_log_error("[app_magic] LMI epoll_wait() failed: %s", strerror(errno));
+      break;
+    }
 
-  fd_log_notice("[app_magic] ✓ Heartbeat monitor thread started (timeout=%ds, "
-                "interval=%ds)",
-                HEARTBEAT_TIMEOUT_SEC, MONITOR_CHECK_INTERVAL_SEC);
+    /* 同一批事件使用同一个配置快照 */
+    magic_config_read_begin(ctx->config_store);
+    for (int i = 0; i < n; i++) {
+      uint32_t tag = events[i].data.u32;
+      uint64_t drain;
+      ssize_t r;
+
+      switch (tag) {
+      case LMI_EV_WAKE:
+        r = read(ctx->wake_fd, &drain, sizeof(drain));
+        (void)r;
+        break;
 
-  while (ctx->heartbeat_monitor_running) {
-    time_t now = time(NULL);
+      case LMI_EV_TIMER:
+        r = read(ctx->timer_fd, &drain, sizeof(drain));
+        (void)r;
+        break;
 
-    pthread_mutex_lock(&ctx->clients_mutex);
+      case LMI_EV_LISTEN:
+        lmi_accept_connection(ctx, false);
+        break;
 
-    /* 遍历所有客户端检查超时 */
-    for (int i = 0; i < MAX_DLM_CLIENTS; i++) {
-      DlmClient *client = &ctx->clients[i];
+      case LMI_EV_LISTEN_SEQ:
+        lmi_accept_connection(ctx, true);
+        break;
 
-      /* 跳过未注册的客户端 */
-      if (!client->is_registered) {
-        continue;
-      }
+      case LMI_EV_DGRAM:
+        lmi_read_dgram(ctx);
+        break;
 
-      /* 检查心跳超时 */
-      time_t elapsed = now - client->last_seen;
-      if (elapsed > HEARTBEAT_TIMEOUT_SEC) {
-        fd_log_notice("[app_magic] ⚠ DLM heartbeat timeout detected: %s (last "
-                      "seen %ld sec ago)",
-                      client->link_id, (long)elapsed);
+      case LMI_EV_UDP:
+        lmi_read_udp(ctx);
+        break;
 
-        /* 触发 LINK_EVENT_DOWN 回调 */
-        trigger_lmi_event_callbacks(ctx, client->link_id, LINK_EVENT_DOWN,
-                                    NULL);
+      default:
+        /* DLM 流式连接 (同一批次中可能已被关闭) */
+        if (tag >= LMI_EV_CONN && tag < LMI_EV_CONN + LMI_MAX_CONNECTIONS &&
+            ctx->conns[tag - LMI_EV_CONN].fd >= 0) {
+          lmi_conn_readable(ctx, &ctx->conns[tag - LMI_EV_CONN]);
+        }
+        break;
+      }
+    }
+    magic_config_read_end(ctx->config_store);
+  }
 
-        /* 标记为未注册（避免重复触发） */
-        client->is_registered = false;
+  fd_log_notice("[app_magic] LMI event loop exiting");
+  return NULL;
+}
 
-        /* 关闭客户端连接 */
-        if (client->client_fd > 0) {
-          close(client->client_fd);
-          client->client_fd = -1;
-        }
+/**
+ * @brief 创建 epoll/timerfd/eventfd 并启动事件循环线程 (已运行则直接返回)。
+ * @return 0 成功，-1 失败。
+ */
+static int lmi_reactor_start(MagicLmiContext *ctx) {
+  if (ctx->reactor_running) {
+    return 0;
+  }
 
-        fd_log_notice("[app_magic] ✓ Cleaned up timed-out DLM: %s",
-                      client->link_id);
-      }
+  ctx->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  ctx->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  ctx->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ctx->epoll_fd >= 0 && ctx->timer_fd >= 0 && ctx->wake_fd >= 0) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = LMI_EV_TIMER;
+    int rc = epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, ctx->timer_fd, &ev);
+    ev.data.u32 = LMI_EV_WAKE;
+    rc |= epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, ctx->wake_fd, &ev);
+
+    ctx->reactor_running = true;
+    if (rc == 0 && pthread_create(&ctx->reactor_thread, NULL,
+                                  lmi_reactor_thread, ctx) == 0) {
+      return 0;
     }
+    ctx->reactor_running = false;
+  }
 
-    pthread_mutex_unlock(&ctx->clients_mutex);
+  fd_log_error("[app_magic] Failed to start LMI event loop: %s",
+               strerror(errno));
+  if (ctx->epoll_fd >= 0) {
+    close(ctx->epoll_fd);
+  }
+  if (ctx->timer_fd >= 0) {
+    close(ctx->timer_fd);
+  }
+  if (ctx->wake_fd >= 0) {
+    close(ctx->wake_fd);
+  }
+  ctx->epoll_fd = ctx->timer_fd = ctx->wake_fd = -1;
+  return -1;
+}
 
-    /* 休眠一段时间再进行下一轮检查 */
-    sleep(MONITOR_CHECK_INTERVAL_SEC);
+/**
+ * @brief 把文件描述符注册到事件循环 (必要时先启动事件循环)。
+ *
+ * @param ctx LMI 上下文。
+ * @param fd 要监听可读事件的文件描述符。
+ * @param tag 分发标签 (LMI_EV_*)。
+ * @return 0 成功，-1 失败。
+ */
+static int lmi_reactor_add(MagicLmiContext *ctx, int fd, uint32_t tag) {
+  if (lmi_reactor_start(ctx) != 0) {
+    return -1;
   }
 
-  fd_log_notice("[app_magic] Heartbeat monitor thread exiting");
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = tag;
+  return epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0 ? 0 : -1;
+}
 
-  return NULL;
-}
\ No newline at end of file
+/**
+ * @brief 停止事件循环并关闭全部流式连接。
+ * @details 连接关闭时清理对应的 DLM 客户端并以失败完成其在途请求。
+ */
+static void lmi_reactor_stop(MagicLmiContext *ctx) {
+  if (ctx->reactor_running) {
+    uint64_t one = 1;
+    ctx->reactor_running = false;
+    ssize_t w = write(ctx->wake_fd, &one, sizeof(one));
+    (void)w;
+    pthread_join(ctx->reactor_thread, NULL);
+    fd_log_debug("[app_magic] LMI event loop stopped");
+  }
+
+  for (int i = 0; i < LMI_MAX_CONNECTIONS; i++) {
+    if (ctx->conns[i].fd >= 0) {
+      lmi_conn_close(ctx, &ctx->conns[i], false);
+    }
+  }
+
+  if (ctx->epoll_fd >= 0) {
+    close(ctx->epoll_fd);
+  }
+  if (ctx->timer_fd >= 0) {
+    close(ctx->timer_fd);
+  }
+  if (ctx->wake_fd >= 0) {
+    close(ctx->wake_fd);
+  }
+  ctx->epoll_fd = ctx->timer_fd = ctx->wake_fd = -1;
+}
@@ -24,7 +24,10 @@
 #define MAGIC_LMI_H /* 防止重复包含 */
 
 #include "magic_config.h"   /* MAGIC 配置定义 */
+#include "magic_config_store.h" /* 配置快照存储 */
 #include "mih_extensions.h" /* MIH 扩展定义 */
+#include "mih_linkstate.h"  /* 共享内存链路状态表 */
+#include "magic_pool.h"     /* 按块增长的对象池 */
 #include "mih_protocol.h"   /* MIH 协议定义 */
 #include <pthread.h>        /* POSIX 线程支持 */
 #include <stdbool.h>        /* 布尔类型支持 */
@@ -36,8 +39,8 @@
  * 每个 DLM 实例连接到 LMI 服务器后, 会创建一个 DlmClient 实例
  *===========================================================================*/
 
-#define MAX_DLM_CLIENTS 10 /* 最大 DLM 客户端连接数 */
-#define MAX_BEARERS 8      /* 每个 DLM 客户端最大 Bearer 数量 */
+#define MAGIC_DLM_CLIENT_CHUNK 8 /* DLM 客户端表每次扩容的槽位数 */
+#define MAX_BEARERS 8            /* 每个 DLM 客户端最大 Bearer 数量 */
 
 /*---------------------------------------------------------------------------
  * BearerState - 承载状态结构体
@@ -51,14 +54,54 @@
  *          每个 Bearer 有独立的 QoS 参数和流量统计。
  */
 typedef struct {
-  bool is_active;       ///< 是否处于活动状态。
-  BEARER_ID bearer_id;  ///< Bearer 唯一标识符 (0-255)。
-  QOS_PARAM qos_params; ///< 该 Bearer 的 QoS 参数。
-  time_t created_time;  ///< Bearer 创建时间戳。
-  uint64_t tx_bytes;    ///< 发送字节数统计。
-  uint64_t rx_bytes;    ///< 接收字节数统计。
+  bool is_active;          ///< 是否处于活动状态。
+  BEARER_ID bearer_id;     ///< Bearer 唯一标识符 (0-255)。
+  QOS_PARAM qos_params;    ///< 该 Bearer 的 QoS 参数。
+  BEARER_ID dlm_bearer_id; ///< DLM 确认的 Bearer ID (0 = 未经 DLM 确认)。
+  time_t created_time;     ///< Bearer 创建时间戳。
+  uint64_t tx_bytes;       ///< 发送字节数统计。
+  uint64_t rx_bytes;       ///< 接收字节数统计。
 } BearerState;
 
+/*---------------------------------------------------------------------------
+ * LmiLinkQuality - 链路质量趋势
+ *
+ * 由 DLM 周期性参数报告驱动, 用于在链路真正中断前预测劣化
+ *---------------------------------------------------------------------------*/
+/**
+ * @brief 单项链路质量指标的平滑值与变化趋势。
+ */
+typedef struct {
+  double ewma;     ///< 指数加权平滑值。
+  double slope;    ///< 平滑后的变化率 (单位/秒)。
+  double baseline; ///< 本次上线以来的最佳平滑值 (带宽取最大, 延迟取最小)。
+} LmiQualityTrend;
+
+/**
+ * @brief 链路质量跟踪状态 (LmiLinkQuality)。
+ * @details 跟踪信号强度、可用带宽与延迟的趋势。预测值在预测窗口内越过
+ *          劣化判据时标记为劣化并发出 LINK_EVENT_GOING_DOWN。
+ */
+typedef struct {
+  LmiQualityTrend rssi;      ///< 信号强度 (dBm)。
+  LmiQualityTrend bandwidth; ///< 可用带宽 (kbps)。
+  LmiQualityTrend latency;   ///< 往返延迟 (ms)。
+  uint64_t last_report_ms;   ///< 上一次参数报告的单调时间 (0 = 无样本)。
+  uint64_t hold_until_ms;    ///< 劣化状态最早可解除的时刻。
+  uint32_t samples;          ///< 已处理的参数报告数。
+  uint32_t healthy_streak;   ///< 劣化状态下连续未触发判据的报告数。
+  bool degrading;            ///< 是否处于劣化状态 (已发出 GOING_DOWN)。
+} LmiLinkQuality;
+
+/**
+ * @brief DLM 消息来源 (存活检测只用一种周期来源学习到达间隔)。
+ */
+typedef enum {
+  LMI_SEEN_OTHER = 0,     ///< 非周期消息 (注册、事件、应答等)。
+  LMI_SEEN_HEARTBEAT = 1, ///< 心跳 (流式/UDP)。
+  LMI_SEEN_REPORT = 2,    ///< 周期性参数报告 (数据报 DLM)。
+} LmiSeenSource;
+
 /*---------------------------------------------------------------------------
  * DlmClient - DLM 客户端状态结构体
  *
@@ -82,6 +125,21 @@ typedef struct {
   time_t last_heartbeat;    ///< 最后一次收到心跳的时间。
   time_t last_seen;         ///< 最后一次收到任意消息的时间 (用于超时检测)。
 
+  /*-----------------------------------------------------------------------
+   * 自适应心跳检测 (单调时钟毫秒, 受 clients_mutex 保护)
+   *-----------------------------------------------------------------------*/
+  uint64_t last_seen_ms;   ///< 最后一次收到任意消息的时刻 (掉线判定基准)。
+  uint64_t hb_last_ms;     ///< 最后一次收到周期性消息的时刻。
+  uint32_t hb_mean_ms;     ///< 周期性消息到达间隔的平滑均值。
+  uint32_t hb_dev_ms;      ///< 到达间隔的平滑平均偏差 (抖动)。
+  uint32_t hb_samples;     ///< 已学习的间隔样本数。
+  LmiSeenSource hb_source; ///< 学习间隔所用的周期来源。
+
+  /*-----------------------------------------------------------------------
+   * 链路质量趋势 (预测性切换, 受 clients_mutex 保护)
+   *-----------------------------------------------------------------------*/
+  LmiLinkQuality quality; ///< 参数报告驱动的质量趋势与劣化状态。
+
   /*-----------------------------------------------------------------------
    * MIH 协议扩展字段
    *-----------------------------------------------------------------------*/
@@ -146,6 +204,73 @@ typedef struct {
   lmi_event_callback_t callback; ///< 回调函数指针。
 } EventCallbackEntry;
 
+/*---------------------------------------------------------------------------
+ * 流式连接接收状态 (事件循环按帧重组, 不阻塞于半帧)
+ *---------------------------------------------------------------------------*/
+
+#define LMI_MAX_CONNECTIONS 16   /* 同时跟踪的流式连接数 (含未注册连接) */
+#define LMI_RX_BUFFER_SIZE 65536 /* 预读缓冲区, 可容纳一个最大帧 (64 KB) */
+
+/**
+ * @brief 流式连接接收状态。
+ */
+typedef struct {
+  int fd;                             ///< 连接 Socket (-1 = 空闲)。
+  bool seqpacket;                     ///< SOCK_SEQPACKET 连接 (每条记录一帧)。
+  size_t rx_len;                      ///< 缓冲区中已累积的字节数。
+  uint8_t rx_buf[LMI_RX_BUFFER_SIZE]; ///< 帧重组缓冲区。
+} LmiConnection;
+
+/*---------------------------------------------------------------------------
+ * 异步资源请求 (MIH_LINK_RESOURCE.request / .confirm)
+ *
+ * 请求以事务 ID 发往 DLM 后立即返回, DLM 的 Confirm 按事务 ID
+ * 匹配回在途表中的请求并触发完成回调; 超时由事件循环统一处理
+ *---------------------------------------------------------------------------*/
+
+#define LMI_MAX_PENDING 64           /* 同时在途的资源请求上限 */
+#define LMI_RESOURCE_TIMEOUT_MS 3000 /* 资源请求默认确认超时 (毫秒) */
+
+/**
+ * @brief DLM 客户端的锁与协议状态 (注销时不随 DlmClient 清零)。
+ */
+typedef struct {
+  /** Bearer 表与 Socket 写入锁 (加锁顺序: 先 clients_mutex)。 */
+  pthread_mutex_t lock;
+  bool echoes_txn; ///< DLM 是否回显事务 ID。
+} LmiClientAux;
+
+/**
+ * @brief 资源请求完成回调函数类型。
+ * @details 每个成功发起的异步请求恰好回调一次: 收到 DLM Confirm、超时、
+ *          DLM 断开或本地即时完成时。回调在不持有任何 LMI 锁的情况下调用,
+ *          可能运行于调用者线程或 LMI 事件循环线程中。
+ *
+ * @param ctx            LMI 上下文指针。
+ * @param transaction_id 请求的事务 ID。
+ * @param confirm        资源确认结果 (仅在回调期间有效)。
+ * @param arg            发起请求时传入的用户参数。
+ */
+typedef void (*lmi_resource_cb_t)(struct MagicLmiContext *ctx,
+                                  uint32_t transaction_id,
+                                  const MIH_Link_Resource_Confirm *confirm,
+                                  void *arg);
+
+/**
+ * @brief 在途资源请求记录。
+ */
+typedef struct {
+  bool in_use;                       ///< 槽位是否占用。
+  uint32_t transaction_id;           ///< 发往 DLM 的事务 ID。
+  int client_idx;                    ///< 目标 DLM 在 clients[] 中的下标。
+  uint8_t action;                    ///< RESOURCE_ACTION_REQUEST / RELEASE。
+  BEARER_ID local_bearer_id;         ///< 本地镜像中对应的 Bearer ID。
+  MIH_Link_Resource_Confirm confirm; ///< 预填充的确认 (身份字段)。
+  uint64_t deadline_ms;              ///< 超时时刻 (单调时钟, 毫秒)。
+  lmi_resource_cb_t callback;        ///< 完成回调 (可为 NULL)。
+  void *arg;                         ///< 回调用户参数。
+} LmiPendingRequest;
+
 /*---------------------------------------------------------------------------
  * MagicLmiContext - LMI 上下文结构体
  *
@@ -160,43 +285,64 @@ typedef struct {
  */
 typedef struct MagicLmiContext {
   /*-----------------------------------------------------------------------
-   * 流式服务器状态 (SOCK_STREAM - 用于完整 MIH 传输层)
+   * 流式服务器状态 (SOCK_STREAM/SOCK_SEQPACKET - 完整 MIH 传输层)
    *-----------------------------------------------------------------------*/
-  int server_fd;           ///< 服务器监听 Socket 文件描述符。
-  pthread_t server_thread; ///< 服务器主处理线程。
-  bool running;            ///< 服务器运行状态标志。
+  int server_fd;     ///< 服务器监听 Socket 文件描述符。
+  int seq_server_fd; ///< 顺序包 (SOCK_SEQPACKET) 监听 Socket。
+  bool running;      ///< 服务器运行状态标志。
 
   /*-----------------------------------------------------------------------
    * 数据报服务器状态 (SOCK_DGRAM - 用于 DLM 原型简化协议)
    *-----------------------------------------------------------------------*/
-  int dgram_fd;           ///< 数据报服务器 Socket 文件描述符。
-  pthread_t dgram_thread; ///< 数据报服务器处理线程。
-  bool dgram_running;     ///< 数据报服务器运行状态标志。
+  int dgram_fd;       ///< 数据报服务器 Socket 文件描述符。
+  bool dgram_running; ///< 数据报服务器运行状态标志。
 
   /*-----------------------------------------------------------------------
    * UDP 监听服务器状态 (接收 DLM 原型 UDP 广播心跳)
    *-----------------------------------------------------------------------*/
-  int udp_fd;           ///< UDP 监听 Socket 文件描述符。
-  pthread_t udp_thread; ///< UDP 监听线程。
-  bool udp_running;     ///< UDP 监听服务器运行状态标志。
-  uint16_t udp_port;    ///< UDP 监听端口 (默认 1947)。
+  int udp_fd;        ///< UDP 监听 Socket 文件描述符。
+  bool udp_running;  ///< UDP 监听服务器运行状态标志。
+  uint16_t udp_port; ///< UDP 监听端口 (默认 1947)。
 
   /*-----------------------------------------------------------------------
-   * 心跳监控线程 (用于检测 DLM 超时)
+   * 事件循环 (单线程 epoll 反应器)
+   *
+   * 监听 Socket、全部 DLM 流式连接、数据报/UDP Socket 以及超时 timerfd
+   * 由同一线程分发; 心跳与资源请求超时按各自的截止时刻精确唤醒
    *-----------------------------------------------------------------------*/
-  pthread_t heartbeat_monitor_thread; ///< 心跳监控线程。
-  bool heartbeat_monitor_running;     ///< 心跳监控运行状态。
+  int epoll_fd;                             ///< epoll 实例。
+  int timer_fd;                             ///< 超时检查 timerfd。
+  int wake_fd;                              ///< 唤醒 eventfd (停止/重算超时)。
+  pthread_t reactor_thread;                 ///< 事件循环线程。
+  bool reactor_running;                     ///< 事件循环运行状态。
+  LmiConnection conns[LMI_MAX_CONNECTIONS]; ///< 流式连接接收状态。
 
   /*-----------------------------------------------------------------------
    * 客户端管理
    *-----------------------------------------------------------------------*/
-  DlmClient clients[MAX_DLM_CLIENTS]; ///< DLM 客户端实例数组。
-  pthread_mutex_t clients_mutex;      ///< 客户端数组保护互斥锁。
+  /** DLM 客户端表 (DlmClient, 满时按块扩容, 元素地址不变)。 */
+  MagicPool clients;
+  /** 与 clients 同下标的 LmiClientAux (先于 clients 扩容)。 */
+  MagicPool client_aux;
+  pthread_mutex_t clients_mutex; ///< 客户端表保护互斥锁 (串行化扩容)。
+
+  /*-----------------------------------------------------------------------
+   * 异步资源请求在途表
+   *-----------------------------------------------------------------------*/
+  LmiPendingRequest pending[LMI_MAX_PENDING]; ///< 在途资源请求。
+  pthread_mutex_t pending_mutex;              ///< 在途表保护互斥锁。
+
+  /*-----------------------------------------------------------------------
+   * 共享内存链路状态表
+   *
+   * DLM 以 seqlock 发布链路状态, 策略引擎无锁读取
+   *-----------------------------------------------------------------------*/
+  mih_linkstate_region_t *linkstate; ///< 共享区映射 (NULL=不可用)。
 
   /*-----------------------------------------------------------------------
    * 配置引用
    *-----------------------------------------------------------------------*/
-  MagicConfig *config; ///< 全局 MAGIC 系统配置引用。
+  MagicConfigStore *config_store; ///< 配置快照存储 (经 lmi_config 取快照)。
 
   /*-----------------------------------------------------------------------
    * 事件回调机制
@@ -227,10 +373,10 @@ int magic_lmi_init(MagicLmiContext *ctx);
  * @details 创建监听 Socket，并启动服务器线程以接受 DLM 连接。
  *
  * @param ctx 指向 LMI 上下文的指针。
- * @param config 指向 MAGIC 全局配置的指针。
+ * @param store 已加载首个版本的配置存储。
  * @return 0 成功，-1 失败。
  */
-int magic_lmi_start_server(MagicLmiContext *ctx, MagicConfig *config);
+int magic_lmi_start_server(MagicLmiContext *ctx, MagicConfigStore *store);
 
 /**
  * @brief 启动数据报模式 LMI 服务器 (Unix Domain Datagram)。
@@ -261,6 +407,19 @@ int magic_lmi_start_udp_listener(MagicLmiContext *ctx, uint16_t port);
  */
 DlmClient *magic_lmi_find_by_link(MagicLmiContext *ctx, const char *link_id);
 
+/**
+ * @brief DLM 客户端表当前容量 (遍历上界)。
+ * @details 表满时按 MAGIC_DLM_CLIENT_CHUNK 扩容，可不加锁读取；
+ *          遍历槽位内容仍须持有 clients_mutex。
+ */
+int magic_lmi_client_capacity(MagicLmiContext *ctx);
+
+/**
+ * @brief 按下标取 DLM 客户端槽位。
+ * @return 槽位指针 (可能未注册)，下标越界返回 NULL。
+ */
+DlmClient *magic_lmi_client_at(MagicLmiContext *ctx, int index);
+
 /**
  * @brief 更新链路状态。
  * @details 设置指定链路的在线/离线状态。
@@ -280,6 +439,20 @@ void magic_lmi_update_link_status(MagicLmiContext *ctx, const char *link_id,
  */
 void magic_lmi_cleanup(MagicLmiContext *ctx);
 
+/**
+ * @brief 无锁读取 DLM 发布的链路状态。
+ * @details 从共享内存链路状态表读取一致快照，不加锁、不进入内核。
+ *          DLM 未发布该链路或快照已过期 (DLM 停止发布) 时返回失败，
+ *          调用方应回退到 DlmClient 中经 Socket 上报的状态。
+ *
+ * @param ctx 指向 LMI 上下文的指针。
+ * @param link_id 链路标识符。
+ * @param state [out] 链路状态快照。
+ * @return 0 成功，-1 无可用的新鲜快照。
+ */
+int magic_lmi_read_link_state(MagicLmiContext *ctx, const char *link_id,
+                              mih_linkstate_snapshot_t *state);
+
 /*===========================================================================
  * MIH 原语支持 API (ARINC 839 Attachment 2)
  *
@@ -290,6 +463,7 @@ void magic_lmi_cleanup(MagicLmiContext *ctx);
 /**
  * @brief 处理 MIH_LINK_RESOURCE.Request - MIH 链路资源请求。
  * @details 用于 CM Core 向 DLM 请求或释放链路资源 (Bearer)。
+ *          同步封装: 基于 magic_lmi_resource_request_async() 等待 Confirm。
  *
  * @param ctx 指向 LMI 上下文的指针。
  * @param request 资源请求结构体。
@@ -300,6 +474,27 @@ int magic_dlm_mih_link_resource_request(
     MagicLmiContext *ctx, const MIH_Link_Resource_Request *request,
     MIH_Link_Resource_Confirm *confirm);
 
+/**
+ * @brief 异步发起 MIH_LINK_RESOURCE.Request。
+ * @details 在该 DLM 的本地 Bearer 镜像中完成簿记后, 以新的事务 ID 将
+ *          请求写入 DLM Socket 并立即返回, 不持有全局客户端锁等待应答。
+ *          DLM 的 Confirm 按事务 ID 匹配并回调 @p cb; 超过 @p timeout_ms
+ *          未确认则以 STATUS_FAILURE 回调并回滚本地分配。
+ *          无流式连接的 DLM (数据报/UDP) 及 QoS 更新仅做本地簿记,
+ *          在返回前即回调。
+ *
+ * @param ctx 指向 LMI 上下文的指针。
+ * @param request 资源请求结构体。
+ * @param timeout_ms 确认超时 (毫秒)，0 表示 LMI_RESOURCE_TIMEOUT_MS。
+ * @param cb 完成回调 (可为 NULL, 即不关心结果)。
+ * @param arg 回调用户参数。
+ * @return 事务 ID (非 0)；0 表示请求未发起 (参数无效或链路不可用),
+ *         此时不会回调。
+ */
+uint32_t magic_lmi_resource_request_async(
+    MagicLmiContext *ctx, const MIH_Link_Resource_Request *request,
+    uint32_t timeout_ms, lmi_resource_cb_t cb, void *arg);
+
 /**
  * @brief 处理 LINK_RESOURCE.Request - 链路层资源请求。
  * @details DLM 客户端内部处理函数，执行具体的资源分配逻辑。
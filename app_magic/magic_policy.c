@@ -374,13 +374,14 @@ static int calculate_link_score(const DLMConfig *dlm,
 
 /**
  * @brief 初始化策略引擎。
- * @details 绑定全局配置，清空上下文，并输出初始化日志。
+ * @details 绑定配置存储，清空上下文，并输出初始化日志。
  *
  * @param ctx 策略上下文指针。
- * @param config 全局配置指针。
- * @return int 成功返回 0，失败返回 -1 (参数为空)。
+ * @param store 配置存储 (须已加载首个版本)。
+ * @return int 成功返回 0，失败返回 -1 (参数为空或配置未加载)。
  */
-int magic_policy_init(PolicyContext *ctx, MagicConfig *config) {
+int magic_policy_init(PolicyContext *ctx, MagicConfigStore *store) {
+  MagicConfig *config = store ? magic_config_current(store) : NULL;
   if (!ctx || !config) { // 检查输入参数是否为空，如果为空则返回错误
     fd_log_error(
         "[app_magic] Policy init: NULL parameter"); // 记录错误日志，提示参数为空
@@ -389,8 +390,8 @@ int magic_policy_init(PolicyContext *ctx, MagicConfig *config) {
 
   memset(ctx, 0,
          sizeof(PolicyContext)); // 将策略上下文结构体清零，初始化所有成员为0
-  ctx->config = config;          // 将传入的配置指针赋值给上下文的config成员
-  ctx->initialized = true;       // 设置初始化标志为true，表示策略引擎已初始化
+  ctx->config_store = store; // 绑定配置存储，每次决策取读临界区内的快照
+  ctx->initialized = true;   // 设置初始化标志为true，表示策略引擎已初始化
 
   fd_log_notice("[app_magic] ✓ Policy Engine Initialized (v2.0)");
   fd_log_notice("[app_magic]     DLMs: %u", config->num_dlm_configs);
@@ -432,6 +433,13 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
   memset(resp, 0,
          sizeof(PolicyResponse)); // 将响应结构体清零，初始化所有成员为0
 
+  /* 整个决策过程使用同一个配置快照 (调用方所在读临界区固定的版本) */
+  MagicConfig *config = magic_config_current(ctx->config_store);
+  if (!config) {
+    snprintf(resp->reason, sizeof(resp->reason), "Configuration not loaded");
+    return -1;
+  }
+
   fd_log_debug(
       "[app_magic] === Policy Decision Start ==="); // 记录调试日志，开始策略决策过程
   fd_log_debug("[app_magic]   Client: %s",
@@ -446,8 +454,8 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
    * ======================================== */
 
   ClientProfile *client = magic_config_find_client(
-      ctx->config, req->client_id); // 根据客户端ID查找客户端配置文件
-  if (!client) {                    // 如果未找到客户端配置
+      config, req->client_id); // 根据客户端ID查找客户端配置文件
+  if (!client) {               // 如果未找到客户端配置
     snprintf(resp->reason, sizeof(resp->reason), // 格式化错误原因字符串
              "Client '%s' not found in configuration",
              req->client_id); // 设置错误原因：客户端未在配置中找到
@@ -494,14 +502,14 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
    * ======================================== */
 
   PolicyRuleSet *ruleset = magic_config_find_ruleset(
-      ctx->config, req->flight_phase); // 根据飞行阶段查找对应的策略规则集
-  if (!ruleset) {                      // 如果未找到特定阶段的规则集
+      config, req->flight_phase); // 根据飞行阶段查找对应的策略规则集
+  if (!ruleset) {                 // 如果未找到特定阶段的规则集
     fd_log_debug("[app_magic]   No specific ruleset for phase '%s', using "
                  "default", // 记录调试日志，使用默认规则集
                  req->flight_phase);
     /* 使用第一个规则集作为默认 */
-    if (ctx->config->policy.num_rulesets > 0) {   // 检查是否有任何规则集配置
-      ruleset = &ctx->config->policy.rulesets[0]; // 使用第一个规则集作为默认
+    if (config->policy.num_rulesets > 0) {   // 检查是否有任何规则集配置
+      ruleset = &config->policy.rulesets[0]; // 使用第一个规则集作为默认
     } else {
       snprintf(
           resp->reason, sizeof(resp->reason),
@@ -520,7 +528,7 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
 
   /* v2.0: 使用动态流量分类替代静态 traffic_class_id */
   const char *dynamic_traffic_class = magic_policy_classify_traffic(
-      &ctx->config->policy,
+      &config->policy,
       req->priority_class, /* 来自 magic.conf 的 PRIORITY_CLASS */
       req->qos_level,      /* 来自 magic.conf 的 QOS_LEVEL */
       req->profile_name);  /* 来自 magic.conf 的 PROFILE_NAME */
@@ -612,7 +620,7 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
     }
 
     /* v2.0: 查找 DLM 配置 */
-    DLMConfig *dlm = magic_config_find_dlm(ctx->config, pref->link_id);
+    DLMConfig *dlm = magic_config_find_dlm(config, pref->link_id);
     if (!dlm) {
       fd_log_debug("[app_magic]     DLM %s: Not found in config",
                    pref->link_id);
@@ -625,8 +633,19 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
       continue;
     }
 
+    /* DLM 经共享内存发布的最新链路状态 (无锁读取, 比 Socket 上报更及时) */
+    mih_linkstate_snapshot_t shared;
+    bool has_shared =
+        ctx->lmi_ctx &&
+        magic_lmi_read_link_state(ctx->lmi_ctx, pref->link_id, &shared) == 0;
+    if (has_shared && shared.link_state == LINK_STATE_DOWN) {
+      fd_log_debug("[app_magic]     DLM %s: Link down (shared state)",
+                   pref->link_id);
+      continue;
+    }
+
     /* v2.2: ADIF 覆盖范围检查 (基于实时位置数据) */
-    if (!ctx->config->adif_degraded_mode && dlm->coverage.enabled &&
+    if (!config->adif_degraded_mode && dlm->coverage.enabled &&
         req->has_adif_data) {
       /* 从请求中获取飞机位置并检查覆盖范围 */
       if (req->aircraft_lat != 0.0 || req->aircraft_lon != 0.0) {
@@ -669,11 +688,18 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
 
     /* v2.1: 负载均衡 - 根据当前活跃会话数调整评分 */
     int active_sessions = 0;
+    bool degrading = false;
     if (ctx->lmi_ctx) {
-      for (int j = 0; j < MAX_DLM_CLIENTS; j++) {
-        if (ctx->lmi_ctx->clients[j].is_registered &&
-            strcmp(ctx->lmi_ctx->clients[j].link_id, pref->link_id) == 0) {
-          active_sessions = ctx->lmi_ctx->clients[j].num_active_bearers;
+      int dlm_capacity = magic_lmi_client_capacity(ctx->lmi_ctx);
+      for (int j = 0; j < dlm_capacity; j++) {
+        const DlmClient *c = magic_lmi_client_at(ctx->lmi_ctx, j);
+        if (c->is_registered && strcmp(c->link_id, pref->link_id) == 0) {
+          active_sessions = c->num_active_bearers;
+          /* 共享快照仅供参考: 只在比 Socket 上报更多时采用 */
+          if (has_shared && shared.active_bearers > active_sessions) {
+            active_sessions = shared.active_bearers;
+          }
+          degrading = c->quality.degrading;
           fd_log_notice("[app_magic]     DLM %s 当前活跃会话数: %d",
                         pref->link_id, active_sessions);
           break;
@@ -686,6 +712,15 @@ int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
     int load_penalty = active_sessions * 600;
     score -= load_penalty;
 
+    /* 链路正在劣化 (预测即将中断或 DLM 已报告 GoingDown): 扣10000分，
+     * 有备用链路时不再选用 */
+    if (degrading ||
+        (has_shared && shared.link_state == LINK_STATE_GOING_DOWN)) {
+      score -= 10000;
+      fd_log_debug("[app_magic]     DLM %s: -10000 (degrading)",
+                   pref->link_id);
+    }
+
     /* v2.0: 如果是客户端的首选 DLM，给予额外加分 */
     if (client->link_policy.preferred_dlm[0] &&
         strcmp(pref->link_id, client->link_policy.preferred_dlm) == 0) {
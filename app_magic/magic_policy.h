@@ -8,6 +8,7 @@
 #define MAGIC_POLICY_H
 
 #include "magic_config.h"
+#include "magic_config_store.h"
 #include "magic_session.h"
 #include <stdbool.h>
 
@@ -69,7 +70,7 @@ typedef struct {
  *===========================================================================*/
 
 typedef struct {
-  MagicConfig *config;             ///< 全局配置指针。
+  MagicConfigStore *config_store;  ///< 配置存储 (决策时取固定的快照)。
   bool initialized;                ///< 策略引擎初始化状态。
   struct MagicLmiContext *lmi_ctx; ///< v2.1: 指向 MagicLmiContext
                                    ///< 的指针，用于获取实时链路负载信息。
@@ -81,13 +82,14 @@ typedef struct {
 
 /**
  * @brief 初始化策略引擎。
- * @details 将全局配置绑定到策略上下文，并初始化内部状态。
+ * @details 将配置存储绑定到策略上下文，并初始化内部状态。
+ *          每次决策使用调用线程读临界区内固定的配置快照。
  *
  * @param ctx 策略上下文指针。
- * @param config 全局配置指针。
+ * @param store 配置存储。
  * @return int 成功返回 0，失败返回 -1。
  */
-int magic_policy_init(PolicyContext *ctx, MagicConfig *config);
+int magic_policy_init(PolicyContext *ctx, MagicConfigStore *store);
 
 /**
  * @brief 执行策略决策（链路选择）。
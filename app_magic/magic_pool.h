@@ -0,0 +1,137 @@
+/**
+ * @file magic_pool.h
+ * @brief 按块增长、元素地址不变的对象池。
+ * @details 会话池、客户端上下文与 DLM 客户端表等按下标遍历、又被长期持有
+ *          指针的数组共用此实现。元素按固定大小的块分配，扩容只追加新块，
+ *          已有元素不搬移。块目录扩容时换成新目录，旧目录保留到销毁，
+ *          因此不加锁的遍历看到的要么是旧容量要么是新容量，不会越界。
+ *
+ *          扩容须由调用方的锁串行化；元素内容的并发访问仍由调用方负责。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_POOL_H
+#define MAGIC_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/** 块目录 (只增不改，替换后挂入 retired 链表)。 */
+typedef struct MagicPoolDir {
+  uint32_t nchunks;              ///< 块数。
+  struct MagicPoolDir *retired;  ///< 被本目录替换的旧目录。
+  void *chunks[];                ///< 各块首地址。
+} MagicPoolDir;
+
+/** 对象池。 */
+typedef struct {
+  MagicPoolDir *dir;    ///< 当前块目录 (原子读写, NULL=尚无元素)。
+  size_t elem_size;     ///< 元素大小。
+  uint32_t chunk_elems; ///< 每块元素数。
+} MagicPool;
+
+/**
+ * @brief 初始化空池 (不分配内存)。
+ * @param pool 对象池。
+ * @param elem_size 元素大小。
+ * @param chunk_elems 每块元素数 (>0)。
+ */
+static inline void magic_pool_init(MagicPool *pool, size_t elem_size,
+                                   uint32_t chunk_elems) {
+  pool->dir = NULL;
+  pool->elem_size = elem_size;
+  pool->chunk_elems = chunk_elems;
+}
+
+/**
+ * @brief 当前容量 (元素个数)，可不加锁调用。
+ */
+static inline uint32_t magic_pool_capacity(const MagicPool *pool) {
+  const MagicPoolDir *dir = __atomic_load_n(&pool->dir, __ATOMIC_ACQUIRE);
+  return dir ? dir->nchunks * pool->chunk_elems : 0;
+}
+
+/**
+ * @brief 按下标取元素，可不加锁调用。
+ * @return 元素指针，下标超出容量时返回 NULL。
+ */
+static inline void *magic_pool_at(const MagicPool *pool, uint32_t idx) {
+  const MagicPoolDir *dir = __atomic_load_n(&pool->dir, __ATOMIC_ACQUIRE);
+  uint32_t chunk = idx / pool->chunk_elems;
+  if (!dir || chunk >= dir->nchunks)
+    return NULL;
+  return (char *)dir->chunks[chunk] +
+         (size_t)(idx % pool->chunk_elems) * pool->elem_size;
+}
+
+/**
+ * @brief 元素指针换算为下标。
+ * @return 下标，指针不属于本池时返回 -1。
+ */
+static inline int magic_pool_index(const MagicPool *pool, const void *elem) {
+  const MagicPoolDir *dir = __atomic_load_n(&pool->dir, __ATOMIC_ACQUIRE);
+  size_t chunk_bytes = (size_t)pool->chunk_elems * pool->elem_size;
+  for (uint32_t c = 0; dir && c < dir->nchunks; c++) {
+    const char *base = (const char *)dir->chunks[c];
+    if ((const char *)elem >= base && (const char *)elem < base + chunk_bytes) {
+      size_t off = (size_t)((const char *)elem - base);
+      if (off % pool->elem_size != 0)
+        return -1;
+      return (int)(c * pool->chunk_elems + off / pool->elem_size);
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief 追加一个清零的块 (调用方加锁)。
+ * @details init 非 NULL 时在新块发布前逐个初始化元素。
+ * @return 新块首元素的下标，内存不足时返回 -1。
+ */
+static inline int magic_pool_grow(MagicPool *pool, void (*init)(void *elem)) {
+  MagicPoolDir *old = pool->dir;
+  uint32_t n = old ? old->nchunks : 0;
+  void *chunk = calloc(pool->chunk_elems, pool->elem_size);
+  MagicPoolDir *dir =
+      malloc(sizeof(*dir) + (size_t)(n + 1) * sizeof(dir->chunks[0]));
+  if (!chunk || !dir) {
+    free(chunk);
+    free(dir);
+    return -1;
+  }
+
+  for (uint32_t i = 0; init && i < pool->chunk_elems; i++)
+    init((char *)chunk + (size_t)i * pool->elem_size);
+  for (uint32_t c = 0; c < n; c++)
+    dir->chunks[c] = old->chunks[c];
+  dir->chunks[n] = chunk;
+  dir->nchunks = n + 1;
+  dir->retired = old;
+  __atomic_store_n(&pool->dir, dir, __ATOMIC_RELEASE);
+  return (int)(n * pool->chunk_elems);
+}
+
+/**
+ * @brief 释放全部块与目录 (调用方保证已无并发访问)。
+ * @details fini 非 NULL 时先对每个元素调用。
+ */
+static inline void magic_pool_destroy(MagicPool *pool,
+                                      void (*fini)(void *elem)) {
+  MagicPoolDir *dir = pool->dir;
+  for (uint32_t c = 0; dir && c < dir->nchunks; c++) {
+    for (uint32_t i = 0; fini && i < pool->chunk_elems; i++)
+      fini((char *)dir->chunks[c] + (size_t)i * pool->elem_size);
+    free(dir->chunks[c]);
+  }
+  while (dir) {
+    MagicPoolDir *retired = dir->retired;
+    free(dir);
+    dir = retired;
+  }
+  pool->dir = NULL;
+}
+
+#endif /* MAGIC_POOL_H */
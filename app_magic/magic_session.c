@@ -24,7 +24,8 @@
 
 /**
  * @brief 初始化会话管理器。
- * @details 清零所有会话槽位，初始化互斥锁。
+ * @details 会话池与客户端上下文池初始为空，首次使用时按块分配；
+ *          初始化互斥锁。
  * @param mgr 指向会话管理器实例的指针。
  * @return 0 成功，-1 失败（参数为空）。
  */
@@ -32,20 +33,53 @@ int magic_session_init(SessionManager *mgr) {
   if (!mgr)
     return -1;
 
-  memset(mgr->sessions, 0, sizeof(mgr->sessions));
-  memset(mgr->clients, 0, sizeof(mgr->clients));
+  magic_pool_init(&mgr->sessions, sizeof(ClientSession), MAGIC_SESSION_CHUNK);
+  magic_pool_init(&mgr->clients, sizeof(ClientContext), MAGIC_CLIENT_CHUNK);
   mgr->session_count = 0;
   mgr->client_count = 0;
 
   // 初始化互斥锁，使用默认属性
   pthread_mutex_init(&mgr->mutex, NULL);
 
-  fd_log_notice("[app_magic] Session manager initialized (max sessions: %d, "
-                "max clients: %d)",
-                MAX_SESSIONS, MAX_CLIENTS);
+  fd_log_notice("[app_magic] Session manager initialized (pools grow by "
+                "%d sessions / %d clients)",
+                MAGIC_SESSION_CHUNK, MAGIC_CLIENT_CHUNK);
   return 0;
 }
 
+int magic_session_capacity(SessionManager *mgr) {
+  return mgr ? (int)magic_pool_capacity(&mgr->sessions) : 0;
+}
+
+ClientSession *magic_session_at(SessionManager *mgr, int index) {
+  if (!mgr || index < 0)
+    return NULL;
+  return magic_pool_at(&mgr->sessions, (uint32_t)index);
+}
+
+int magic_session_index(SessionManager *mgr, const ClientSession *session) {
+  if (!mgr || !session)
+    return -1;
+  return magic_pool_index(&mgr->sessions, session);
+}
+
+/* 取客户端上下文槽位 (调用方持有 mgr->mutex) */
+static ClientContext *client_at(SessionManager *mgr, int index) {
+  return magic_pool_at(&mgr->clients, (uint32_t)index);
+}
+
+/* 按客户端 ID 查找上下文 (调用方持有 mgr->mutex) */
+static ClientContext *client_find_locked(SessionManager *mgr,
+                                         const char *client_id) {
+  int cap = (int)magic_pool_capacity(&mgr->clients);
+  for (int i = 0; i < cap; i++) {
+    ClientContext *ctx = client_at(mgr, i);
+    if (ctx->in_use && strcmp(ctx->client_id, client_id) == 0)
+      return ctx;
+  }
+  return NULL;
+}
+
 /*===========================================================================
  * 查找会话 - 提供根据客户端ID统计会话数量和根据会话ID查找会话的功能
  *===========================================================================*/
@@ -61,14 +95,13 @@ int magic_session_count_by_client(
   pthread_mutex_lock(
       &mgr->mutex); // 加锁互斥锁，确保对会话数组的访问是线程安全的
 
-  for (int i = 0; i < MAX_SESSIONS;
-       i++) {                      // 遍历所有会话槽位，查找匹配的客户端会话
-    if (mgr->sessions[i].in_use && // 检查该槽位是否正在使用
-        strcmp(mgr->sessions[i].client_id, client_id) ==
-            0 && // 检查客户端ID是否匹配
-        mgr->sessions[i].state ==
-            SESSION_STATE_ACTIVE) { // 检查会话状态是否为活动状态
-      count++;                      // 如果所有条件满足，计数器加1
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) { // 遍历所有会话槽位，查找匹配的客户端会话
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use && // 检查该槽位是否正在使用
+        strcmp(sess->client_id, client_id) == 0 && // 检查客户端ID是否匹配
+        sess->state == SESSION_STATE_ACTIVE) { // 检查会话状态是否为活动状态
+      count++; // 如果所有条件满足，计数器加1
     }
   }
 
@@ -85,12 +118,13 @@ magic_session_find_by_id(SessionManager *mgr,
 
   pthread_mutex_lock(&mgr->mutex); // 加锁互斥锁，确保查找过程的线程安全
 
-  for (int i = 0; i < MAX_SESSIONS; i++) { // 遍历所有会话槽位，查找匹配的会话ID
-    if (mgr->sessions[i].in_use &&         // 检查该槽位是否正在使用
-        strcmp(mgr->sessions[i].session_id, session_id) ==
-            0) {                         // 检查会话ID是否匹配
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) { // 遍历所有会话槽位，查找匹配的会话ID
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use && // 检查该槽位是否正在使用
+        strcmp(sess->session_id, session_id) == 0) { // 检查会话ID是否匹配
       pthread_mutex_unlock(&mgr->mutex); // 找到匹配会话后立即解锁互斥锁
-      return &mgr->sessions[i];          // 返回指向匹配会话的指针
+      return sess;                       // 返回指向匹配会话的指针
     }
   }
 
@@ -106,7 +140,7 @@ magic_session_find_by_id(SessionManager *mgr,
  * @brief 创建新会话。
  * @details
  * 1. 加锁保护。
- * 2. 遍历查找空闲槽位。
+ * 2. 遍历查找空闲槽位，用尽时会话池追加一块。
  * 3. 初始化会话结构体，设置创建时间、状态为 INIT。
  * 4. 关联或创建 ClientContext。
  * 5. 增加会话计数并解锁。
@@ -115,7 +149,7 @@ magic_session_find_by_id(SessionManager *mgr,
  * @param session_id 全局唯一会话 ID。
  * @param client_id 客户端标识。
  * @param client_realm 客户端域。
- * @return 成功返回会话指针，失败（无空位）返回 NULL。
+ * @return 成功返回会话指针，失败（内存不足）返回 NULL。
  */
 ClientSession *magic_session_create(SessionManager *mgr, const char *session_id,
                                     const char *client_id,
@@ -125,22 +159,26 @@ ClientSession *magic_session_create(SessionManager *mgr, const char *session_id,
 
   pthread_mutex_lock(&mgr->mutex);
 
-  /* 查找空闲槽位 */
+  /* 查找空闲槽位，池已满时扩容 */
   int free_slot = -1;
-  for (int i = 0; i < MAX_SESSIONS; i++) {
-    if (!mgr->sessions[i].in_use) {
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) {
+    if (!magic_session_at(mgr, i)->in_use) {
       free_slot = i;
       break;
     }
   }
+  if (free_slot == -1) {
+    free_slot = magic_pool_grow(&mgr->sessions, NULL);
+  }
 
   if (free_slot == -1) {
     pthread_mutex_unlock(&mgr->mutex);
-    fd_log_error("[app_magic] No available session slots");
+    fd_log_error("[app_magic] Cannot grow session pool beyond %d slots", cap);
     return NULL;
   }
 
-  ClientSession *session = &mgr->sessions[free_slot];
+  ClientSession *session = magic_session_at(mgr, free_slot);
   memset(session, 0, sizeof(ClientSession));
 
   session->in_use = true;
@@ -273,22 +311,14 @@ int magic_session_delete(SessionManager *mgr,
 
   pthread_mutex_lock(&mgr->mutex); // 加锁互斥锁，确保删除过程的线程安全
 
-  for (int i = 0; i < MAX_SESSIONS; i++) { // 遍历所有会话槽位，查找匹配的会话ID
-    if (mgr->sessions[i].in_use &&         // 检查该槽位是否正在使用
-        strcmp(mgr->sessions[i].session_id, session_id) ==
-            0) { // 检查会话ID是否匹配
-
-      ClientSession *session = &mgr->sessions[i];
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) { // 遍历所有会话槽位，查找匹配的会话ID
+    ClientSession *session = magic_session_at(mgr, i);
+    if (session->in_use && // 检查该槽位是否正在使用
+        strcmp(session->session_id, session_id) == 0) { // 检查会话ID是否匹配
 
       /* 更新客户端上下文的带宽配额 */
-      ClientContext *ctx = NULL;
-      for (int j = 0; j < MAX_CLIENTS; j++) {
-        if (mgr->clients[j].in_use &&
-            strcmp(mgr->clients[j].client_id, session->client_id) == 0) {
-          ctx = &mgr->clients[j];
-          break;
-        }
-      }
+      ClientContext *ctx = client_find_locked(mgr, session->client_id);
 
       if (ctx) {
         /* 回收带宽配额 */
@@ -299,8 +329,9 @@ int magic_session_delete(SessionManager *mgr,
         magic_client_remove_session(ctx, i);
       }
 
-      /* 清除 TFT 规则 */
+      /* 清除 TFT 规则 (会话级与全局流分类器) */
       magic_session_clear_tfts(session);
+      magic_flow_remove_session(&g_magic_ctx.flow_ctx, session->session_id);
 
       /* 释放资源 - 在删除会话前，先释放其占用的链路资源 */
       pthread_mutex_unlock(
@@ -339,21 +370,22 @@ int magic_session_cleanup_timeout(SessionManager *mgr,
 
   pthread_mutex_lock(&mgr->mutex); // 加锁互斥锁，确保清理过程的线程安全
 
-  for (int i = 0; i < MAX_SESSIONS; i++) { // 遍历所有会话槽位，查找超时的会话
-    if (mgr->sessions[i].in_use &&         // 检查该槽位是否正在使用
-        (now - mgr->sessions[i].last_activity) >
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) { // 遍历所有会话槽位，查找超时的会话
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use && // 检查该槽位是否正在使用
+        (now - sess->last_activity) >
             timeout_sec) { // 检查最后活动时间是否超过超时阈值
 
       fd_log_notice(
           "[app_magic] Cleaning up timeout session: %s (idle %ld "
-          "sec)",                      // 记录通知日志，表示正在清理超时会话
-          mgr->sessions[i].session_id, // 记录会话ID
-          (long)(now - mgr->sessions[i].last_activity)); // 记录空闲时间（秒）
-
-      magic_session_release_link(mgr,
-                                 &mgr->sessions[i]); // 释放超时会话的链路资源
-      memset(&mgr->sessions[i], 0, sizeof(ClientSession)); // 将会话槽位清零
-      cleaned++;                                           // 清理计数器加1
+          "sec)",          // 记录通知日志，表示正在清理超时会话
+          sess->session_id, // 记录会话ID
+          (long)(now - sess->last_activity)); // 记录空闲时间（秒）
+
+      magic_session_release_link(mgr, sess); // 释放超时会话的链路资源
+      memset(sess, 0, sizeof(ClientSession)); // 将会话槽位清零
+      cleaned++;                              // 清理计数器加1
     }
   }
 
@@ -374,15 +406,19 @@ void magic_session_cleanup(SessionManager *mgr) // 完全清理会话管理器
 
   pthread_mutex_lock(&mgr->mutex); // 加锁互斥锁，确保清理过程的线程安全
 
-  for (int i = 0; i < MAX_SESSIONS; i++) { // 遍历所有会话槽位
-    if (mgr->sessions[i].in_use) {         // 检查该槽位是否正在使用
-      magic_session_release_link(mgr,
-                                 &mgr->sessions[i]); // 释放该会话的链路资源
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) {            // 遍历所有会话槽位
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use) {                      // 检查该槽位是否正在使用
+      magic_session_release_link(mgr, sess); // 释放该会话的链路资源
     }
   }
 
-  memset(mgr->sessions, 0, sizeof(mgr->sessions)); // 将整个会话数组清零
-  pthread_mutex_unlock(&mgr->mutex);               // 解锁互斥锁
+  magic_pool_destroy(&mgr->sessions, NULL); // 释放会话池
+  magic_pool_destroy(&mgr->clients, NULL);  // 释放客户端上下文池
+  mgr->session_count = 0;
+  mgr->client_count = 0;
+  pthread_mutex_unlock(&mgr->mutex); // 解锁互斥锁
 
   pthread_mutex_destroy(&mgr->mutex); // 销毁互斥锁，释放系统资源
 
@@ -456,19 +492,19 @@ int magic_session_find_subscribed(SessionManager *mgr, ClientSession **sessions,
   pthread_mutex_lock(&mgr->mutex);
 
   fd_log_notice("[app_magic] DEBUG: Searching for subscribed sessions...");
-  for (int i = 0; i < MAX_SESSIONS && count < max_count; i++) {
-    if (mgr->sessions[i].in_use) {
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap && count < max_count; i++) {
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use) {
       fd_log_notice("[app_magic] DEBUG:   Session[%d]: in_use=1, "
                     "subscribed=%d, level=%u, state=%d",
-                    i, mgr->sessions[i].status_subscription_active,
-                    mgr->sessions[i].subscribed_status_level,
-                    mgr->sessions[i].state);
+                    i, sess->status_subscription_active,
+                    sess->subscribed_status_level, sess->state);
     }
-    if (mgr->sessions[i].in_use &&
-        mgr->sessions[i].status_subscription_active &&
-        (mgr->sessions[i].state == SESSION_STATE_AUTHENTICATED ||
-         mgr->sessions[i].state == SESSION_STATE_ACTIVE)) {
-      sessions[count++] = &mgr->sessions[i];
+    if (sess->in_use && sess->status_subscription_active &&
+        (sess->state == SESSION_STATE_AUTHENTICATED ||
+         sess->state == SESSION_STATE_ACTIVE)) {
+      sessions[count++] = sess;
       fd_log_notice(
           "[app_magic] DEBUG:   ✓ Session[%d] added to broadcast list", i);
     }
@@ -485,13 +521,14 @@ ClientSession *magic_session_find_by_client(SessionManager *mgr,
 
   pthread_mutex_lock(&mgr->mutex);
 
-  for (int i = 0; i < MAX_SESSIONS; i++) {
-    if (mgr->sessions[i].in_use &&
-        strcmp(mgr->sessions[i].client_id, client_id) == 0 &&
-        mgr->sessions[i].state != SESSION_STATE_CLOSED &&
-        mgr->sessions[i].state != SESSION_STATE_TERMINATING) {
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) {
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use && strcmp(sess->client_id, client_id) == 0 &&
+        sess->state != SESSION_STATE_CLOSED &&
+        sess->state != SESSION_STATE_TERMINATING) {
       pthread_mutex_unlock(&mgr->mutex);
-      return &mgr->sessions[i];
+      return sess;
     }
   }
 
@@ -574,8 +611,9 @@ int magic_session_get_active_sessions(SessionManager *mgr,
 
   pthread_mutex_lock(&mgr->mutex);
 
-  for (int i = 0; i < MAX_SESSIONS && count < max_count; i++) {
-    ClientSession *sess = &mgr->sessions[i];
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap && count < max_count; i++) {
+    ClientSession *sess = magic_session_at(mgr, i);
     if (sess->in_use && (sess->state == SESSION_STATE_ACTIVE ||
                          sess->state == SESSION_STATE_AUTHENTICATED)) {
       sessions[count++] = sess;
@@ -587,6 +625,55 @@ int magic_session_get_active_sessions(SessionManager *mgr,
   return count;
 }
 
+int magic_session_get_active_ids(SessionManager *mgr,
+                                 char (*ids)[MAX_SESSION_ID_LEN],
+                                 int max_count) {
+  if (!mgr || !ids || max_count <= 0)
+    return 0;
+
+  int count = 0;
+
+  pthread_mutex_lock(&mgr->mutex);
+
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap && count < max_count; i++) {
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use && (sess->state == SESSION_STATE_ACTIVE ||
+                         sess->state == SESSION_STATE_AUTHENTICATED)) {
+      memcpy(ids[count++], sess->session_id, MAX_SESSION_ID_LEN);
+    }
+  }
+
+  pthread_mutex_unlock(&mgr->mutex);
+
+  return count;
+}
+
+int magic_session_update_traffic(SessionManager *mgr, const char *session_id,
+                                 uint64_t bytes_in, uint64_t bytes_out) {
+  if (!mgr || !session_id)
+    return -1;
+
+  int ret = -1;
+
+  pthread_mutex_lock(&mgr->mutex);
+
+  int cap = magic_session_capacity(mgr);
+  for (int i = 0; i < cap; i++) {
+    ClientSession *sess = magic_session_at(mgr, i);
+    if (sess->in_use && strcmp(sess->session_id, session_id) == 0) {
+      sess->bytes_in = bytes_in;
+      sess->bytes_out = bytes_out;
+      ret = 0;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&mgr->mutex);
+
+  return ret;
+}
+
 /*===========================================================================
  * ClientContext API 实现 - 客户端级别的配额管理
  *===========================================================================*/
@@ -599,39 +686,39 @@ ClientContext *magic_client_context_get_or_create(SessionManager *mgr,
   /* 注意: 调用者应该已经持有 mgr->mutex 锁 */
 
   /* 首先查找是否已存在 */
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (mgr->clients[i].in_use &&
-        strcmp(mgr->clients[i].client_id, client_id) == 0) {
-      return &mgr->clients[i];
-    }
+  ClientContext *ctx = client_find_locked(mgr, client_id);
+  if (ctx) {
+    return ctx;
   }
 
-  /* 不存在，创建新的 */
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (!mgr->clients[i].in_use) {
-      ClientContext *ctx = &mgr->clients[i];
-      memset(ctx, 0, sizeof(ClientContext));
+  /* 不存在，创建新的: 客户端上下文不回收，依次占用槽位，池满时追加一块 */
+  int slot = mgr->client_count;
+  if (slot >= (int)magic_pool_capacity(&mgr->clients) &&
+      magic_pool_grow(&mgr->clients, NULL) < 0) {
+    fd_log_error("[app_magic] Cannot grow client context pool beyond %d "
+                 "clients",
+                 mgr->client_count);
+    return NULL;
+  }
 
-      ctx->in_use = true;
-      strncpy(ctx->client_id, client_id, sizeof(ctx->client_id) - 1);
-      ctx->first_seen = time(NULL);
-      ctx->last_activity = time(NULL);
-      ctx->max_concurrent_sessions = MAX_SESSIONS_PER_CLIENT; // 默认值
+  ctx = client_at(mgr, slot);
+  memset(ctx, 0, sizeof(ClientContext));
 
-      /* 初始化活跃会话索引数组为-1 (表示无效) */
-      for (int j = 0; j < MAX_SESSIONS_PER_CLIENT; j++) {
-        ctx->active_session_indices[j] = -1;
-      }
+  ctx->in_use = true;
+  strncpy(ctx->client_id, client_id, sizeof(ctx->client_id) - 1);
+  ctx->first_seen = time(NULL);
+  ctx->last_activity = time(NULL);
+  ctx->max_concurrent_sessions = MAX_SESSIONS_PER_CLIENT; // 默认值
 
-      mgr->client_count++;
-      fd_log_notice("[app_magic] ClientContext created: %s [total clients: %d]",
-                    client_id, mgr->client_count);
-      return ctx;
-    }
+  /* 初始化活跃会话索引数组为-1 (表示无效) */
+  for (int j = 0; j < MAX_SESSIONS_PER_CLIENT; j++) {
+    ctx->active_session_indices[j] = -1;
   }
 
-  fd_log_error("[app_magic] No available client context slots");
-  return NULL;
+  mgr->client_count++;
+  fd_log_notice("[app_magic] ClientContext created: %s [total clients: %d]",
+                client_id, mgr->client_count);
+  return ctx;
 }
 
 ClientContext *magic_client_context_find(SessionManager *mgr,
@@ -640,17 +727,9 @@ ClientContext *magic_client_context_find(SessionManager *mgr,
     return NULL;
 
   pthread_mutex_lock(&mgr->mutex);
-
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (mgr->clients[i].in_use &&
-        strcmp(mgr->clients[i].client_id, client_id) == 0) {
-      pthread_mutex_unlock(&mgr->mutex);
-      return &mgr->clients[i];
-    }
-  }
-
+  ClientContext *ctx = client_find_locked(mgr, client_id);
   pthread_mutex_unlock(&mgr->mutex);
-  return NULL;
+  return ctx;
 }
 
 void magic_client_context_set_quota(ClientContext *ctx,
@@ -801,7 +880,7 @@ bool magic_client_can_create_session(ClientContext *ctx) {
 }
 
 int magic_client_add_session(ClientContext *ctx, int session_index) {
-  if (!ctx || session_index < 0 || session_index >= MAX_SESSIONS)
+  if (!ctx || session_index < 0)
     return -1;
 
   /* 检查是否已达上限 */
@@ -867,8 +946,9 @@ int magic_client_get_sessions(SessionManager *mgr, ClientContext *ctx,
 
   for (int i = 0; i < ctx->active_session_count && count < max_count; i++) {
     int idx = ctx->active_session_indices[i];
-    if (idx >= 0 && idx < MAX_SESSIONS && mgr->sessions[idx].in_use) {
-      sessions[count++] = &mgr->sessions[idx];
+    ClientSession *sess = magic_session_at(mgr, idx);
+    if (sess && sess->in_use) {
+      sessions[count++] = sess;
     }
   }
 
@@ -18,12 +18,13 @@
 #ifndef MAGIC_SESSION_H
 #define MAGIC_SESSION_H
 
+#include "magic_pool.h"
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
 
-#define MAX_SESSIONS 100
+#define MAGIC_SESSION_CHUNK 64     /* 会话池每次扩容的槽位数 */
 #define MAX_SESSION_ID_LEN 128     /* 与 magic_traffic_monitor.h 保持一致 */
 #define MAX_SESSIONS_PER_CLIENT 10 /* 每个客户端最大并发会话数 */
 #define MAX_TFT_PER_SESSION 8      /* 每个会话最大 TFT 规则数 */
@@ -143,9 +144,11 @@ typedef struct {
   uint32_t current_bw_percent;  ///< 当前链路带宽利用率百分比 (0-100)。
 
   /* MNTR 广播风暴抑制 */
-  time_t last_mntr_sent_time;     ///< 上一次发送 MNTR 的时间。
-  uint32_t last_notified_bw_kbps; ///< 上一次通知客户端的带宽值 (防抖动)。
-  bool mntr_pending_ack;          ///< 是否有 MNTR 未收到 ACK。
+  time_t last_mntr_sent_time;       ///< 上一次发送 MNTR 的时间。
+  uint32_t last_notified_bw_kbps;   ///< 上一次通知客户端的带宽值 (防抖动)。
+  char last_notified_link_id[64];   ///< 上一次通知客户端的链路 ID。
+  uint32_t last_notified_bearer_id; ///< 上一次通知客户端的 Bearer ID。
+  bool mntr_pending_ack;            ///< 是否有 MNTR 未收到 ACK。
 
   /* 网关 IP (用于链路切换通知) */
   char gateway_ip[64]; ///< 当前分配的网关 IP 地址。
@@ -175,7 +178,7 @@ typedef struct {
  * 4. 支持并发会话数限制
  *===========================================================================*/
 
-#define MAX_CLIENTS 50 /* 最大客户端数量 */
+#define MAGIC_CLIENT_CHUNK 64 /* 客户端上下文池每次扩容的槽位数 */
 
 /**
  * @brief 客户端上下文 (ClientContext)。
@@ -208,7 +211,7 @@ typedef struct {
 
   /* 活跃会话跟踪 */
   int active_session_indices
-      [MAX_SESSIONS_PER_CLIENT]; ///< 活跃会话在全局数组中的索引列表。
+      [MAX_SESSIONS_PER_CLIENT]; ///< 活跃会话在会话池中的下标列表。
   int active_session_count;      ///< 当前活跃会话数量。
 
   /* 统计信息 */
@@ -227,14 +230,17 @@ typedef struct {
 /**
  * @brief 会话管理器上下文。
  * @details 全局单例 (g_magic_ctx.session_mgr)，持有所有会话和客户端上下文。
+ *          两个池均按块增长、槽位地址不变: 槽位用尽时在 mutex 内追加一块，
+ *          会话指针与池下标在会话存续期间保持有效。按下标遍历会话用
+ *          magic_session_capacity / magic_session_at。
  */
 typedef struct {
-  ClientSession sessions[MAX_SESSIONS]; ///< 全局会话存储池。
-  int session_count;                    ///< 当前全局活跃会话数量。
+  MagicPool sessions; ///< 全局会话存储池 (ClientSession)。
+  int session_count;  ///< 当前全局活跃会话数量。
 
   /* 客户端上下文管理 */
-  ClientContext clients[MAX_CLIENTS]; ///< 全局客户端上下文存储池。
-  int client_count;                   ///< 当前已记录的客户端数量。
+  MagicPool clients; ///< 全局客户端上下文存储池 (ClientContext)。
+  int client_count;  ///< 当前已记录的客户端数量。
 
   pthread_mutex_t mutex; ///< 保护会话和客户端数组的互斥锁。
 } SessionManager;
@@ -250,6 +256,29 @@ typedef struct {
  */
 int magic_session_init(SessionManager *mgr);
 
+/**
+ * @brief 会话池当前槽位数 (随会话数增长)，可不加锁调用。
+ * @param mgr 会话管理器。
+ * @return 槽位数。
+ */
+int magic_session_capacity(SessionManager *mgr);
+
+/**
+ * @brief 按池下标取会话槽位，可不加锁调用 (槽位内容需自行判断 in_use)。
+ * @param mgr 会话管理器。
+ * @param index 池下标。
+ * @return 槽位指针，下标超出当前容量时返回 NULL。
+ */
+ClientSession *magic_session_at(SessionManager *mgr, int index);
+
+/**
+ * @brief 会话指针换算为池下标。
+ * @param mgr 会话管理器。
+ * @param session 会话指针。
+ * @return 池下标，不属于会话池时返回 -1。
+ */
+int magic_session_index(SessionManager *mgr, const ClientSession *session);
+
 /**
  * @brief 统计指定客户端的活动会话数量。
  * @param mgr 会话管理器。
@@ -377,6 +406,28 @@ const char *magic_session_state_name(SessionState state);
 int magic_session_get_active_sessions(SessionManager *mgr,
                                       ClientSession **sessions, int max_count);
 
+/**
+ * @brief 在锁内复制所有活跃会话的 ID (供不持锁的周期任务遍历)
+ * @param mgr 会话管理器
+ * @param ids 输出: 会话 ID 数组
+ * @param max_count 数组最大容量
+ * @return 返回复制的会话数量
+ */
+int magic_session_get_active_ids(SessionManager *mgr,
+                                 char (*ids)[MAX_SESSION_ID_LEN],
+                                 int max_count);
+
+/**
+ * @brief 在锁内更新会话的累计流量缓存
+ * @param mgr 会话管理器
+ * @param session_id 会话 ID
+ * @param bytes_in 累计入站字节数
+ * @param bytes_out 累计出站字节数
+ * @return 0=成功, -1=会话已不存在
+ */
+int magic_session_update_traffic(SessionManager *mgr, const char *session_id,
+                                 uint64_t bytes_in, uint64_t bytes_out);
+
 /*===========================================================================
  * ClientContext API - 客户端级别的配额管理
  *===========================================================================*/
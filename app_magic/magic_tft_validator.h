@@ -111,6 +111,18 @@ int tft_validate_against_whitelist(const char *tft_string,
                                    const TrafficSecurityConfig *whitelist,
                                    char *error_msg, size_t error_msg_len);
 
+/**
+ * @brief 预编译客户端的 TFT 白名单
+ *
+ * @param whitelist 白名单配置，结果写入 whitelist->tft_matcher
+ * @return 有效条目数, -1=参数错误
+ *
+ * @note 在配置加载时对每个 ClientProfile 调用一次；之后
+ *       tft_validate_against_whitelist() 只解析请求 TFT，白名单侧为纯数值比较。
+ *       未编译的配置在验证时会临时编译 (结果不缓存)。
+ */
+int tft_whitelist_compile(TrafficSecurityConfig *whitelist);
+
 /*===========================================================================
  * 辅助解析函数
  *===========================================================================*/
@@ -0,0 +1,242 @@
+/**
+ * @file magic_timer.c
+ * @brief MAGIC 延迟任务调度器实现。
+ * @details 最小堆 + 单工作线程。工作线程在最早到期时间上
+ *          pthread_cond_timedwait，到期后在锁外执行回调。
+ */
+
+#include "magic_timer.h"
+#include <errno.h>
+#include <freeDiameter/extension.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*===========================================================================
+ * 内部辅助函数
+ *===========================================================================*/
+
+uint64_t magic_timer_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/* 堆序比较: a 是否应排在 b 之前 */
+static bool timer_entry_before(const MagicTimerEntry *a,
+                               const MagicTimerEntry *b) {
+  if (a->deadline_ms != b->deadline_ms)
+    return a->deadline_ms < b->deadline_ms;
+  return a->seq < b->seq;
+}
+
+static void timer_heap_sift_up(MagicTimerContext *tm, uint32_t i) {
+  MagicTimerEntry e = tm->heap[i];
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+    if (!timer_entry_before(&e, &tm->heap[parent]))
+      break;
+    tm->heap[i] = tm->heap[parent];
+    i = parent;
+  }
+  tm->heap[i] = e;
+}
+
+static void timer_heap_sift_down(MagicTimerContext *tm, uint32_t i) {
+  MagicTimerEntry e = tm->heap[i];
+  for (;;) {
+    uint32_t child = 2 * i + 1;
+    if (child >= tm->count)
+      break;
+    if (child + 1 < tm->count &&
+        timer_entry_before(&tm->heap[child + 1], &tm->heap[child]))
+      child++;
+    if (!timer_entry_before(&tm->heap[child], &e))
+      break;
+    tm->heap[i] = tm->heap[child];
+    i = child;
+  }
+  tm->heap[i] = e;
+}
+
+/* 弹出堆顶 (调用方持锁且保证 count > 0) */
+static MagicTimerEntry timer_heap_pop(MagicTimerContext *tm) {
+  MagicTimerEntry top = tm->heap[0];
+  tm->count--;
+  if (tm->count > 0) {
+    tm->heap[0] = tm->heap[tm->count];
+    timer_heap_sift_down(tm, 0);
+  }
+  return top;
+}
+
+/* 在锁外执行一个到期任务 (钩子已在持锁时拷贝) */
+static void timer_run(const MagicTimerEntry *due, magic_timer_hook_t enter,
+                      magic_timer_hook_t leave, void *hook_arg) {
+  if (enter)
+    enter(hook_arg);
+  due->cb(due->arg);
+  if (leave)
+    leave(hook_arg);
+}
+
+/**
+ * @brief 调度器工作线程。
+ * @details 等待堆顶到期，弹出并在锁外执行回调。
+ */
+static void *timer_thread_func(void *arg) {
+  MagicTimerContext *tm = (MagicTimerContext *)arg;
+
+  pthread_mutex_lock(&tm->mutex);
+  while (tm->running) {
+    if (tm->count == 0) {
+      pthread_cond_wait(&tm->cond, &tm->mutex);
+      continue;
+    }
+
+    uint64_t now = magic_timer_now_ms();
+    if (tm->heap[0].deadline_ms > now) {
+      uint64_t deadline = tm->heap[0].deadline_ms;
+      struct timespec ts;
+      ts.tv_sec = (time_t)(deadline / 1000ULL);
+      ts.tv_nsec = (long)((deadline % 1000ULL) * 1000000ULL);
+      pthread_cond_timedwait(&tm->cond, &tm->mutex, &ts);
+      continue; /* 被唤醒后重新检查堆顶 (可能插入了更早的任务) */
+    }
+
+    MagicTimerEntry due = timer_heap_pop(tm);
+    magic_timer_hook_t enter = tm->enter, leave = tm->leave;
+    void *hook_arg = tm->hook_arg;
+    pthread_mutex_unlock(&tm->mutex);
+    timer_run(&due, enter, leave, hook_arg);
+    pthread_mutex_lock(&tm->mutex);
+  }
+  pthread_mutex_unlock(&tm->mutex);
+
+  return NULL;
+}
+
+/*===========================================================================
+ * 公共 API
+ *===========================================================================*/
+
+int magic_timer_init(MagicTimerContext *tm) {
+  if (!tm)
+    return -1;
+
+  memset(tm, 0, sizeof(*tm));
+
+  tm->heap = calloc(MAGIC_TIMER_INITIAL_CAPACITY, sizeof(MagicTimerEntry));
+  if (!tm->heap) {
+    fd_log_error("[app_magic] Timer: failed to allocate heap");
+    return -1;
+  }
+  tm->capacity = MAGIC_TIMER_INITIAL_CAPACITY;
+
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&tm->cond, &cattr);
+  pthread_condattr_destroy(&cattr);
+  pthread_mutex_init(&tm->mutex, NULL);
+
+  tm->running = true;
+  if (pthread_create(&tm->thread, NULL, timer_thread_func, tm) != 0) {
+    fd_log_error("[app_magic] Timer: failed to create worker thread");
+    tm->running = false;
+    pthread_cond_destroy(&tm->cond);
+    pthread_mutex_destroy(&tm->mutex);
+    free(tm->heap);
+    tm->heap = NULL;
+    return -1;
+  }
+
+  tm->initialized = true;
+  fd_log_notice("[app_magic] Timer scheduler initialized");
+  return 0;
+}
+
+int magic_timer_schedule(MagicTimerContext *tm, uint32_t delay_ms,
+                         magic_timer_cb_t cb, void *arg) {
+  if (!tm || !cb || !tm->initialized)
+    return -1;
+
+  pthread_mutex_lock(&tm->mutex);
+
+  if (!tm->running) {
+    pthread_mutex_unlock(&tm->mutex);
+    return -1;
+  }
+
+  if (tm->count == tm->capacity) {
+    uint32_t new_cap = tm->capacity * 2;
+    MagicTimerEntry *grown =
+        realloc(tm->heap, (size_t)new_cap * sizeof(MagicTimerEntry));
+    if (!grown) {
+      pthread_mutex_unlock(&tm->mutex);
+      fd_log_error("[app_magic] Timer: heap grow to %u failed", new_cap);
+      return -1;
+    }
+    tm->heap = grown;
+    tm->capacity = new_cap;
+  }
+
+  MagicTimerEntry *e = &tm->heap[tm->count];
+  e->deadline_ms = magic_timer_now_ms() + delay_ms;
+  e->seq = tm->next_seq++;
+  e->cb = cb;
+  e->arg = arg;
+  tm->count++;
+  timer_heap_sift_up(tm, tm->count - 1);
+
+  pthread_cond_signal(&tm->cond);
+  pthread_mutex_unlock(&tm->mutex);
+  return 0;
+}
+
+void magic_timer_set_hooks(MagicTimerContext *tm, magic_timer_hook_t enter,
+                           magic_timer_hook_t leave, void *arg) {
+  if (!tm || !tm->initialized)
+    return;
+
+  pthread_mutex_lock(&tm->mutex);
+  tm->enter = enter;
+  tm->leave = leave;
+  tm->hook_arg = arg;
+  pthread_mutex_unlock(&tm->mutex);
+}
+
+void magic_timer_cleanup(MagicTimerContext *tm) {
+  if (!tm || !tm->initialized)
+    return;
+
+  pthread_mutex_lock(&tm->mutex);
+  tm->running = false;
+  pthread_cond_broadcast(&tm->cond);
+  pthread_mutex_unlock(&tm->mutex);
+
+  pthread_join(tm->thread, NULL);
+
+  /* 立即执行剩余任务，使挂起的请求得到应答 (此时再调度会失败) */
+  uint32_t flushed = 0;
+  pthread_mutex_lock(&tm->mutex);
+  while (tm->count > 0) {
+    MagicTimerEntry due = timer_heap_pop(tm);
+    pthread_mutex_unlock(&tm->mutex);
+    timer_run(&due, tm->enter, tm->leave, tm->hook_arg);
+    flushed++;
+    pthread_mutex_lock(&tm->mutex);
+  }
+  pthread_mutex_unlock(&tm->mutex);
+
+  pthread_cond_destroy(&tm->cond);
+  pthread_mutex_destroy(&tm->mutex);
+  free(tm->heap);
+  tm->heap = NULL;
+  tm->capacity = 0;
+  tm->initialized = false;
+
+  fd_log_notice("[app_magic] Timer scheduler stopped (%u pending task(s) "
+                "flushed)",
+                flushed);
+}
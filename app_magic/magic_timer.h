@@ -0,0 +1,112 @@
+/**
+ * @file magic_timer.h
+ * @brief MAGIC 延迟任务调度器头文件。
+ * @details 提供基于单调时钟的一次性定时任务调度，用于把需要等待的操作
+ *          (如 MIH 资源请求重试) 移出 Diameter 分发线程。
+ *
+ * 设计要点:
+ * - 单个工作线程 + 最小堆 (按到期时间，其次按提交顺序)
+ * - 使用 CLOCK_MONOTONIC，不受系统时间跳变影响
+ * - 回调在工作线程中执行，不持有调度器锁，可在回调中再次调度
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_TIMER_H
+#define MAGIC_TIMER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAGIC_TIMER_INITIAL_CAPACITY 64 /* 定时任务堆初始容量 */
+
+/**
+ * @brief 定时任务回调函数类型。
+ * @param arg 调度时传入的用户数据。
+ */
+typedef void (*magic_timer_cb_t)(void *arg);
+
+/**
+ * @brief 回调执行前后的钩子类型 (如进入/退出配置读临界区)。
+ * @param arg 设置钩子时传入的用户数据。
+ */
+typedef void (*magic_timer_hook_t)(void *arg);
+
+/**
+ * @brief 定时任务条目。
+ */
+typedef struct {
+  uint64_t deadline_ms; ///< 到期时间 (单调时钟, 毫秒)。
+  uint64_t seq;         ///< 提交序号 (相同到期时间时保持 FIFO)。
+  magic_timer_cb_t cb;  ///< 到期回调。
+  void *arg;            ///< 回调参数。
+} MagicTimerEntry;
+
+/**
+ * @brief 定时任务调度器上下文。
+ */
+typedef struct {
+  MagicTimerEntry *heap; ///< 最小堆存储。
+  uint32_t count;        ///< 当前任务数。
+  uint32_t capacity;     ///< 堆容量 (按需倍增)。
+  uint64_t next_seq;     ///< 下一个提交序号。
+
+  pthread_mutex_t mutex; ///< 保护堆的互斥锁。
+  pthread_cond_t cond;   ///< 新任务/退出通知 (CLOCK_MONOTONIC)。
+  pthread_t thread;      ///< 工作线程。
+  bool running;          ///< 工作线程运行标志。
+
+  magic_timer_hook_t enter; ///< 每个回调执行前调用 (可为 NULL)。
+  magic_timer_hook_t leave; ///< 每个回调执行后调用 (可为 NULL)。
+  void *hook_arg;           ///< 钩子参数。
+  bool initialized;      ///< 是否已初始化。
+} MagicTimerContext;
+
+/**
+ * @brief 获取单调时钟当前时间。
+ * @return 毫秒时间戳。
+ */
+uint64_t magic_timer_now_ms(void);
+
+/**
+ * @brief 初始化调度器并启动工作线程。
+ * @param tm 调度器上下文。
+ * @return 0 成功，-1 失败。
+ */
+int magic_timer_init(MagicTimerContext *tm);
+
+/**
+ * @brief 提交一次性定时任务。
+ * @param tm 调度器上下文。
+ * @param delay_ms 延迟 (毫秒)，0 表示尽快执行。
+ * @param cb 到期回调。
+ * @param arg 回调参数。
+ * @return 0 成功，-1 失败 (调度器未运行或内存不足)。
+ * @note 失败时回调不会被调用，调用方需自行完成/释放 arg。
+ */
+int magic_timer_schedule(MagicTimerContext *tm, uint32_t delay_ms,
+                         magic_timer_cb_t cb, void *arg);
+
+/**
+ * @brief 设置回调执行前后的钩子。
+ * @details 钩子在工作线程中、锁外与回调成对调用；
+ *          须在 magic_timer_init 之后设置。
+ * @param tm 调度器上下文。
+ * @param enter 回调前钩子。
+ * @param leave 回调后钩子。
+ * @param arg 钩子参数。
+ */
+void magic_timer_set_hooks(MagicTimerContext *tm, magic_timer_hook_t enter,
+                           magic_timer_hook_t leave, void *arg);
+
+/**
+ * @brief 停止工作线程并清理调度器。
+ * @details 尚未到期的任务会在返回前立即执行一次，保证挂起的请求得到应答；
+ *          此时再次调度会失败。
+ * @param tm 调度器上下文。
+ */
+void magic_timer_cleanup(MagicTimerContext *tm);
+
+#endif /* MAGIC_TIMER_H */
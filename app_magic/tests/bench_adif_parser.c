@@ -0,0 +1,256 @@
+/**
+ * @file bench_adif_parser.c
+ * @brief ADIF publish XML 流式解析器的正确性核对与 100 Hz 吞吐基准。
+ * @details 直接编译 magic_adif.c 以驱动真实的接收线程。验证:
+ *          - 逐字节喂入与整份喂入结果一致
+ *          - 一次喂入两份相同文档: 两份均完成，第二份为 no-op
+ *          - 文档中途出错后重新同步: 残留的 <parameter .../> 不被当作
+ *            新文档提交，下一份完整文档正常解析
+ *          - 100 Hz 推送经 TCP 分段送达接收线程 (含一份损坏文档)，
+ *            回调次数与最终状态正确
+ *          输出单份文档的解析耗时与 100 Hz 下的 CPU 占用；耗时只输出不断言。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include "magic_adif.c"
+#include <netinet/tcp.h>
+#include <time.h>
+
+#define BENCH_DOCS 20000     /* 计时解析的文档数 */
+#define BENCH_RATE_HZ 100    /* 端到端推送频率 */
+#define BENCH_PUSHES 100     /* 端到端推送文档数 (1 秒) */
+#define BENCH_PHASE_DOCS 25  /* 每个飞行阶段持续的文档数 */
+#define BENCH_CORRUPT_DOC 60 /* 端到端推送中损坏的文档序号 */
+
+static const AdifFlightPhase phases[] = {FLIGHT_PHASE_GATE, FLIGHT_PHASE_TAXI,
+                                         FLIGHT_PHASE_CLIMB,
+                                         FLIGHT_PHASE_CRUISE};
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* 生成一份 publishAvionicParameters 文档 (与 ADIF 模拟器格式一致) */
+static int gen_doc(char *buf, size_t len, AdifFlightPhase phase, double lat,
+                   unsigned long long ts) {
+  bool on_ground = phase <= FLIGHT_PHASE_TAXI;
+  return snprintf(
+      buf, len,
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<method name=\"publishAvionicParameters\">\n"
+      "    <parameters>\n"
+      "        <parameter name=\"WeightOnWheels\" value=\"%d\" "
+      "validity=\"1\" time=\"%llu\"/>\n"
+      "        <parameter name=\"Latitude\" value=\"%.6f\" validity=\"1\" "
+      "time=\"%llu\"/>\n"
+      "        <parameter name=\"Longitude\" value=\"114.100000\" "
+      "validity=\"1\" time=\"%llu\"/>\n"
+      "        <parameter name=\"BaroCorrectedAltitude\" value=\"%d\" "
+      "validity=\"1\" time=\"%llu\"/>\n"
+      "        <parameter name=\"FlightPhase\" value=\"%s\" validity=\"1\" "
+      "time=\"%llu\"/>\n"
+      "        <parameter name=\"AircraftTailNumber\" value=\"B-1234\" "
+      "validity=\"1\" time=\"%llu\"/>\n"
+      "        <parameter name=\"GroundSpeed\" value=\"%d\" validity=\"1\" "
+      "time=\"%llu\"/>\n"
+      "        <parameter name=\"VerticalSpeed\" value=\"0\" validity=\"1\" "
+      "time=\"%llu\"/>\n"
+      "    </parameters>\n"
+      "</method>\n",
+      on_ground ? 0 : 1, ts, lat, ts, ts, on_ground ? 0 : 30000, ts,
+      adif_flight_phase_to_string(phase), ts, ts, on_ground ? 10 : 450, ts,
+      ts);
+}
+
+/* 按接收线程的方式喂入一段数据，返回完成的文档数 */
+static int feed_all(AdifXmlParser *p, const char *data, size_t len) {
+  int docs = 0;
+  size_t off = 0;
+  while (off < len) {
+    size_t used = 0;
+    int rc = adif_xml_parser_feed(p, data + off, len - off, &used);
+    off += used;
+    if (rc < 0)
+      adif_xml_parser_resync(p);
+    else
+      docs += rc;
+  }
+  return docs;
+}
+
+static void verify_split(void) {
+  char doc[4096];
+  int n = gen_doc(doc, sizeof(doc), FLIGHT_PHASE_CLIMB, 22.5, 1234567);
+
+  AdifAircraftState whole;
+  CHECK(0, adif_parse_publish_xml(doc, &whole));
+  CHECK(FLIGHT_PHASE_CLIMB, whole.flight_phase.phase);
+  CHECK(0, whole.wow.on_ground);
+  CHECK_STR("B-1234", whole.aircraft_id.tail_number);
+
+  AdifXmlParser p;
+  adif_xml_parser_init(&p);
+  int docs = 0;
+  for (int i = 0; i < n; i++)
+    docs += feed_all(&p, doc + i, 1);
+  CHECK(1, docs);
+  p.aircraft.last_update_ms = whole.last_update_ms;
+  CHECK(0, memcmp(&whole, &p.aircraft, sizeof(whole)));
+
+  /* 同一份文档再来两次: 均完成，均无变化 */
+  char two[8192];
+  memcpy(two, doc, (size_t)n);
+  memcpy(two + n, doc, (size_t)n);
+  CHECK(2, feed_all(&p, two, 2 * (size_t)n));
+  CHECK(3, p.documents);
+  CHECK(2, p.noop_documents);
+  CHECK(0, p.changed_mask);
+}
+
+/* 文档中途出错: 丢弃其余部分，从下一份文档的根标签恢复 */
+static void verify_resync(void) {
+  char bad[4096], good[4096], stream[8192];
+  gen_doc(bad, sizeof(bad), FLIGHT_PHASE_TAXI, 10.0, 1);
+  int gn = gen_doc(good, sizeof(good), FLIGHT_PHASE_CRUISE, 33.25, 2);
+
+  /* 在第二个 <parameter> 前插入非法标签，其后还有 6 个自闭合参数 */
+  char *cut = strstr(strstr(bad, "<parameter ") + 1, "<parameter ");
+  CHECK(1, cut != NULL);
+  int bn = snprintf(stream, sizeof(stream), "%.*s< oops>%s%s",
+                    (int)(cut - bad), bad, cut, good);
+  CHECK(1, bn < (int)sizeof(stream));
+
+  AdifXmlParser p;
+  adif_xml_parser_init(&p);
+  CHECK(1, feed_all(&p, stream, (size_t)bn));
+  CHECK(1, p.documents);
+  CHECK(FLIGHT_PHASE_CRUISE, p.aircraft.flight_phase.phase);
+  CHECK(1, p.aircraft.position.latitude == 33.25);
+  CHECK(0, p.resync);
+
+  /* 逐字节喂入同样能恢复 */
+  adif_xml_parser_init(&p);
+  int docs = 0;
+  for (int i = 0; i < bn; i++)
+    docs += feed_all(&p, stream + i, 1);
+  CHECK(1, docs);
+  CHECK(FLIGHT_PHASE_CRUISE, p.aircraft.flight_phase.phase);
+
+  /* 重新同步时只认发布方法名: 其他 <method> 根被丢弃 */
+  adif_xml_parser_resync(&p);
+  const char *other = "<method name=\"getAvionicParameters\">"
+                      "<parameters/></method>";
+  CHECK(0, feed_all(&p, other, strlen(other)));
+  CHECK(1, feed_all(&p, good, (size_t)gn));
+}
+
+/*===========================================================================
+ * 100 Hz 端到端
+ *===========================================================================*/
+
+static int g_callbacks;
+
+static void on_state(const AdifAircraftState *state, void *user_data) {
+  (void)state;
+  (void)user_data;
+  g_callbacks++;
+}
+
+static void run_receiver(void) {
+  AdifClientContext ctx;
+  CHECK(0, adif_client_init(&ctx, NULL));
+  adif_client_set_callback(&ctx, on_state, NULL);
+  ctx.running = true;
+  ctx.async_sock = create_async_listener(0);
+  CHECK(1, ctx.async_sock >= 0);
+
+  struct sockaddr_in addr;
+  socklen_t alen = sizeof(addr);
+  CHECK(0, getsockname(ctx.async_sock, (struct sockaddr *)&addr, &alen));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  pthread_t thread;
+  CHECK(0, pthread_create(&thread, NULL, adif_receiver_thread, &ctx));
+
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(0, connect(s, (struct sockaddr *)&addr, sizeof(addr)));
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  /* 每份文档拆成两段发送，拆分点逐份移动 */
+  double t0 = now_sec();
+  char doc[4096];
+  for (int i = 0; i < BENCH_PUSHES; i++) {
+    AdifFlightPhase phase = phases[i / BENCH_PHASE_DOCS];
+    int n = gen_doc(doc, sizeof(doc), phase, 22.5 + (i / 10) * 0.01,
+                    (unsigned long long)i * 10);
+    if (i == BENCH_CORRUPT_DOC)
+      memcpy(strstr(doc, "<parameter ") + 1, " ", 1);
+    int cut = (i * 37) % n;
+    CHECK(cut, send(s, doc, (size_t)cut, 0));
+    CHECK(n - cut, send(s, doc + cut, (size_t)(n - cut), 0));
+
+    double due = t0 + (double)(i + 1) / BENCH_RATE_HZ;
+    while (now_sec() < due)
+      usleep(500);
+  }
+  usleep(100000);
+
+  ctx.running = false;
+  close(s);
+  pthread_join(thread, NULL);
+
+  /* GATE → TAXI → CLIMB → CRUISE: 三次变化，TAXI → CLIMB 同时翻转 WoW */
+  CHECK(3, g_callbacks);
+  CHECK(FLIGHT_PHASE_CRUISE, ctx.aircraft_state.flight_phase.phase);
+  CHECK(0, ctx.aircraft_state.wow.on_ground);
+  double lat = 22.5 + ((BENCH_PUSHES - 1) / 10) * 0.01;
+  CHECK(1, ctx.aircraft_state.position.latitude > lat - 1e-6 &&
+               ctx.aircraft_state.position.latitude < lat + 1e-6);
+  printf("100 Hz x %d: %d callbacks, final phase %s\n", BENCH_PUSHES,
+         g_callbacks,
+         adif_flight_phase_to_string(ctx.aircraft_state.flight_phase.phase));
+  adif_client_cleanup(&ctx);
+}
+
+int main(void) {
+  verify_split();
+  verify_resync();
+
+  /* 计时: 不变文档 (100 Hz 推送的常态) 与逐份变化的文档 */
+  static AdifXmlParser p;
+  char doc[4096];
+  int n = gen_doc(doc, sizeof(doc), FLIGHT_PHASE_CRUISE, 22.5, 1);
+  adif_xml_parser_init(&p);
+  double t0 = now_sec();
+  for (int i = 0; i < BENCH_DOCS; i++)
+    feed_all(&p, doc, (size_t)n);
+  double noop = (now_sec() - t0) / BENCH_DOCS;
+  CHECK(BENCH_DOCS, p.documents);
+
+  static char docs[2][4096];
+  int lens[2];
+  lens[0] = gen_doc(docs[0], sizeof(docs[0]), FLIGHT_PHASE_CRUISE, 22.5, 1);
+  lens[1] = gen_doc(docs[1], sizeof(docs[1]), FLIGHT_PHASE_CLIMB, 22.6, 2);
+  adif_xml_parser_init(&p);
+  t0 = now_sec();
+  for (int i = 0; i < BENCH_DOCS; i++)
+    feed_all(&p, docs[i & 1], (size_t)lens[i & 1]);
+  double changing = (now_sec() - t0) / BENCH_DOCS;
+  CHECK(0, p.noop_documents);
+
+  printf("document:      %d bytes\n", n);
+  printf("parse no-op:   %6.0f ns/doc (%.4f%% CPU at %d Hz)\n", noop * 1e9,
+         noop * BENCH_RATE_HZ * 100, BENCH_RATE_HZ);
+  printf("parse changed: %6.0f ns/doc (%.4f%% CPU at %d Hz)\n",
+         changing * 1e9, changing * BENCH_RATE_HZ * 100, BENCH_RATE_HZ);
+
+  run_receiver();
+  PASSTEST();
+}
@@ -0,0 +1,265 @@
+/**
+ * @file bench_flow_classifier.c
+ * @brief 全局流分类器 (magic_flow) 的正确性对照与性能基准。
+ * @details 随机生成 BENCH_RULES 条规则 (源 /32 客户端地址，目的前缀
+ *          /8~/32，端口区间随机)，按会话删除其中一部分再以新规则重新
+ *          登记这些会话，使计时时仍有 BENCH_RULES 条规则在用:
+ *          - 以线性扫描为基准逐一核对 magic_flow_lookup 的结果
+ *          - 核对 magic_flow_find_conflicts 与两两重叠判定的结果
+ *          - 验证 TFT-to-Aircraft 规则以客户端为目的地址登记
+ *          - 输出查询、线性扫描与冲突检测的单次耗时 (ns/op)
+ *          任一核对不一致即失败；耗时只输出不断言。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include "magic_flow.h"
+#include <time.h>
+
+#define BENCH_RULES 10000     /* 规则数 */
+#define BENCH_TFTS 8          /* 每会话 TFT 数 */
+#define BENCH_KEYS 200000     /* 计时查询次数 */
+#define BENCH_VERIFY 20000    /* 与线性扫描核对的查询数 */
+#define BENCH_CONFLICTS 500   /* 核对的冲突查询数 */
+
+static MagicFlowRule rules[BENCH_RULES];
+static bool alive[BENCH_RULES];
+static uint32_t seq[BENCH_RULES]; /* 插入序号 (重新登记的规则排在最后) */
+static uint32_t next_seq;
+static MagicFlowClassifier fc;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t plen_mask(uint8_t plen) {
+  return plen ? 0xFFFFFFFFu << (32 - plen) : 0;
+}
+
+/* 线性扫描基准: 命中多条时取 precedence 最小、其次先插入者 (seq 最小) */
+static int linear_lookup(const MagicFlowKey *key) {
+  int best = -1;
+  for (int i = 0; i < BENCH_RULES; i++) {
+    const MagicFlowRule *r = &rules[i];
+    if (!alive[i] || r->direction != key->direction)
+      continue;
+    if ((key->src_ip & plen_mask(r->src_plen)) != r->src_ip ||
+        (key->dst_ip & plen_mask(r->dst_plen)) != r->dst_ip)
+      continue;
+    if (r->protocol && r->protocol != key->protocol)
+      continue;
+    if (key->src_port < r->src_port_lo || key->src_port > r->src_port_hi ||
+        key->dst_port < r->dst_port_lo || key->dst_port > r->dst_port_hi)
+      continue;
+    if (best < 0 || r->precedence < rules[best].precedence ||
+        (r->precedence == rules[best].precedence && seq[i] < seq[best]))
+      best = i;
+  }
+  return best;
+}
+
+/* 两两重叠判定 (与 magic_flow_find_conflicts 的定义一致) */
+static bool rules_overlap(const MagicFlowRule *a, const MagicFlowRule *b) {
+  if (a->direction != b->direction)
+    return false;
+  if (a->protocol && b->protocol && a->protocol != b->protocol)
+    return false;
+  uint32_t sm = plen_mask(a->src_plen < b->src_plen ? a->src_plen
+                                                    : b->src_plen);
+  uint32_t dm = plen_mask(a->dst_plen < b->dst_plen ? a->dst_plen
+                                                    : b->dst_plen);
+  if ((a->src_ip & sm) != (b->src_ip & sm) ||
+      (a->dst_ip & dm) != (b->dst_ip & dm))
+    return false;
+  return a->src_port_hi >= b->src_port_lo &&
+         b->src_port_hi >= a->src_port_lo &&
+         a->dst_port_hi >= b->dst_port_lo && b->dst_port_hi >= a->dst_port_lo;
+}
+
+/* 随机生成第 i 条规则并登记 */
+static void add_rule(int i) {
+  static const uint8_t plens[] = {8, 16, 24, 32};
+
+  MagicFlowRule *r = &rules[i];
+  memset(r, 0, sizeof(*r));
+  r->src_ip = 0xC0A80000u | (uint32_t)(rand() % 2000);
+  r->src_plen = 32;
+  r->dst_plen = plens[rand() % 4];
+  r->dst_ip = (0x0A000000u | (uint32_t)(rand() & 0xFFFFFF)) &
+              plen_mask(r->dst_plen);
+  r->protocol = (rand() % 3 == 0) ? 0 : (rand() % 2 ? 6 : 17);
+  r->direction = FLOW_DIR_TO_GROUND;
+  int a = rand() % 65536, b = rand() % 65536;
+  r->dst_port_lo = (uint16_t)(a < b ? a : b);
+  r->dst_port_hi = (uint16_t)(a < b ? b : a);
+  r->src_port_hi = 65535;
+  r->precedence = (uint16_t)(i % BENCH_TFTS);
+  r->tft_index = (uint8_t)(i % BENCH_TFTS);
+  snprintf(r->session_id, sizeof(r->session_id), "sess;%d", i / BENCH_TFTS);
+  CHECK(1, magic_flow_insert(&fc, r) >= 0);
+  alive[i] = true;
+  seq[i] = next_seq++;
+}
+
+static void build_rules(void) {
+  for (int i = 0; i < BENCH_RULES; i++)
+    add_rule(i);
+
+  /* 删除每 5 个会话中的 1 个，覆盖空闲链复用与组内链表摘除 */
+  for (int s = 0; s < BENCH_RULES / BENCH_TFTS; s += 5) {
+    char id[32];
+    snprintf(id, sizeof(id), "sess;%d", s);
+    CHECK(BENCH_TFTS, magic_flow_remove_session(&fc, id));
+    for (int j = 0; j < BENCH_TFTS; j++)
+      alive[s * BENCH_TFTS + j] = false;
+  }
+
+  /* 被删会话以新规则重新登记 (复用空闲槽位)，在用规则回到 BENCH_RULES */
+  for (int i = 0; i < BENCH_RULES; i++) {
+    if (!alive[i])
+      add_rule(i);
+  }
+  CHECK(BENCH_RULES, fc.count);
+}
+
+static void random_key(MagicFlowKey *key) {
+  const MagicFlowRule *r = &rules[rand() % BENCH_RULES];
+  key->src_ip = r->src_ip;
+  key->dst_ip = r->dst_ip | ((uint32_t)rand() & ~plen_mask(r->dst_plen));
+  key->protocol = rand() % 2 ? 6 : 17;
+  key->src_port = (uint16_t)rand();
+  key->dst_port = (uint16_t)rand();
+  key->direction = FLOW_DIR_TO_GROUND;
+}
+
+static void verify_lookup(MagicFlowKey *keys) {
+  int hits = 0;
+  for (int i = 0; i < BENCH_VERIFY; i++) {
+    MagicFlowMatch m;
+    int rc = magic_flow_lookup(&fc, &keys[i], &m);
+    int expect = linear_lookup(&keys[i]);
+    CHECK(expect >= 0, rc == 0);
+    if (rc == 0) {
+      CHECK_STR(rules[expect].session_id, m.session_id);
+      CHECK(rules[expect].tft_index, m.tft_index);
+      hits++;
+    }
+  }
+  printf("lookup verified: %d/%d hits\n", hits, BENCH_VERIFY);
+}
+
+static void verify_conflicts(void) {
+  static MagicFlowMatch out[BENCH_RULES];
+  static const uint8_t plens[] = {0, 8, 16, 24, 32};
+
+  for (int q = 0; q < BENCH_CONFLICTS; q++) {
+    MagicFlowRule x = rules[rand() % BENCH_RULES];
+    x.dst_plen = plens[rand() % 5];
+    x.dst_ip &= plen_mask(x.dst_plen);
+    strcpy(x.session_id, "new");
+
+    int expect = 0;
+    for (int i = 0; i < BENCH_RULES; i++)
+      expect += alive[i] && rules_overlap(&rules[i], &x);
+    CHECK(expect, magic_flow_find_conflicts(&fc, &x, out, BENCH_RULES));
+  }
+}
+
+/* TFT-to-Aircraft: 客户端为目的地址，地面服务器为源地址 */
+static void verify_to_aircraft(void) {
+  TFTRule tft;
+  memset(&tft, 0, sizeof(tft));
+  tft.is_valid = true;
+  tft.src_ip.is_valid = true;
+  tft.src_ip.start_ip = 0x0B000000u; /* 11.0.0.0/24 */
+  tft.src_ip.end_ip = 0x0B0000FFu;
+  tft.has_protocol = true;
+  tft.protocol = 17;
+  tft.dst_port.is_valid = true;
+  tft.dst_port.start_port = 5000;
+  tft.dst_port.end_port = 5010;
+
+  MagicFlowRule r;
+  CHECK(0, magic_flow_rule_from_tft(&tft, "192.168.200.9",
+                                    FLOW_DIR_TO_AIRCRAFT, &r));
+  CHECK(0xC0A8C809u, r.dst_ip);
+  CHECK(32, r.dst_plen);
+  CHECK(0x0B000000u, r.src_ip);
+  CHECK(24, r.src_plen);
+  strcpy(r.session_id, "sess;down");
+  r.tft_index = 2;
+  CHECK(1, magic_flow_insert(&fc, &r) >= 0);
+
+  MagicFlowKey key = {.src_ip = 0x0B000042u,
+                      .dst_ip = 0xC0A8C809u,
+                      .src_port = 40000,
+                      .dst_port = 5004,
+                      .protocol = 17,
+                      .direction = FLOW_DIR_TO_AIRCRAFT};
+  MagicFlowMatch m;
+  CHECK(0, magic_flow_lookup(&fc, &key, &m));
+  CHECK_STR("sess;down", m.session_id);
+  CHECK(2, m.tft_index);
+
+  /* 同一五元组按机 → 地方向查询不命中 */
+  key.direction = FLOW_DIR_TO_GROUND;
+  CHECK(-1, magic_flow_lookup(&fc, &key, &m));
+
+  CHECK(1, magic_flow_remove_session(&fc, "sess;down"));
+}
+
+int main(void) {
+  srand(7);
+  CHECK(0, magic_flow_init(&fc));
+
+  build_rules();
+
+  MagicFlowKey *keys = calloc(BENCH_KEYS, sizeof(*keys));
+  CHECK(1, keys != NULL);
+  for (int i = 0; i < BENCH_KEYS; i++)
+    random_key(&keys[i]);
+
+  verify_lookup(keys);
+  verify_conflicts();
+  verify_to_aircraft();
+
+  /* 计时 */
+  MagicFlowMatch m;
+  int hits = 0;
+  double t0 = now_sec();
+  for (int i = 0; i < BENCH_KEYS; i++)
+    hits += magic_flow_lookup(&fc, &keys[i], &m) == 0;
+  double t1 = now_sec();
+  printf("lookup:        %6.0f ns/op (%d rules, %d hits)\n",
+         (t1 - t0) / BENCH_KEYS * 1e9, fc.count, hits);
+
+  int linear_hits = 0;
+  t0 = now_sec();
+  for (int i = 0; i < BENCH_VERIFY / 10; i++)
+    linear_hits += linear_lookup(&keys[i]) >= 0;
+  t1 = now_sec();
+  printf("linear scan:   %6.0f ns/op (%d hits)\n",
+         (t1 - t0) / (BENCH_VERIFY / 10) * 1e9, linear_hits);
+
+  MagicFlowMatch out[FLOW_MAX_CONFLICTS];
+  long conflicts = 0;
+  t0 = now_sec();
+  for (int i = 0; i < BENCH_CONFLICTS; i++) {
+    MagicFlowRule q = rules[rand() % BENCH_RULES];
+    strcpy(q.session_id, "new");
+    conflicts += magic_flow_find_conflicts(&fc, &q, out, FLOW_MAX_CONFLICTS);
+  }
+  t1 = now_sec();
+  printf("conflict scan: %6.0f ns/op (avg %.1f conflicts)\n",
+         (t1 - t0) / BENCH_CONFLICTS * 1e9,
+         (double)conflicts / BENCH_CONFLICTS);
+
+  free(keys);
+  magic_flow_cleanup(&fc);
+  PASSTEST();
+}
@@ -0,0 +1,61 @@
+/**
+ * @file magic_tests.h
+ * @brief app_magic 单元测试公共宏。
+ * @details 与 freeDiameter 自带测试 (tests/tests.h) 相同的约定: 每个测试是
+ *          独立可执行文件，断言失败立即以非零状态退出，全部通过时调用
+ *          PASSTEST()。被测模块的外部依赖在测试文件中以假实现替换。
+ *          运行条件不满足 (如缺少权限) 时调用 SKIPTEST()，以
+ *          MAGIC_TEST_SKIP 退出，ctest 记为跳过。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#ifndef MAGIC_TESTS_H
+#define MAGIC_TESTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAGIC_TEST_SKIP 77 /* 跳过测试的退出码 (ctest SKIP_RETURN_CODE) */
+
+/* 整数断言: 期望值与实际值不等时报告位置并退出 */
+#define CHECK(_expected, _actual)                                              \
+  do {                                                                         \
+    long long __e = (long long)(_expected);                                    \
+    long long __a = (long long)(_actual);                                      \
+    if (__e != __a) {                                                          \
+      fprintf(stderr, "%s:%d: CHECK(%s == %s) failed: %lld != %lld\n",         \
+              __FILE__, __LINE__, #_expected, #_actual, __e, __a);             \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+/* 字符串断言 */
+#define CHECK_STR(_expected, _actual)                                          \
+  do {                                                                         \
+    const char *__e = (_expected);                                             \
+    const char *__a = (_actual);                                               \
+    if (strcmp(__e, __a) != 0) {                                               \
+      fprintf(stderr, "%s:%d: CHECK_STR(%s == %s) failed: \"%s\" != \"%s\"\n", \
+              __FILE__, __LINE__, #_expected, #_actual, __e, __a);             \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+/* 全部断言通过 */
+#define PASSTEST()                                                             \
+  do {                                                                         \
+    printf("PASS: %s\n", __FILE__);                                            \
+    exit(0);                                                                   \
+  } while (0)
+
+/* 运行条件不满足，跳过测试 */
+#define SKIPTEST(_reason)                                                      \
+  do {                                                                         \
+    printf("SKIP: %s (%s)\n", __FILE__, (_reason));                            \
+    exit(MAGIC_TEST_SKIP);                                                     \
+  } while (0)
+
+#endif /* MAGIC_TESTS_H */
@@ -0,0 +1,309 @@
+/**
+ * @file test_admission_stress.c
+ * @brief 带宽准入控制 (magic_admission) 的并发压力测试。
+ * @details 多个线程对同一组链路并发执行预留/提交/回滚/释放，预留允许按
+ *          priority_class 挤占，同时有检查线程周期性持锁核对账本。验证:
+ *          - 任意时刻各链路、各客户端账本等于其未挤占预留记录之和
+ *          - 静止后 (无未决预留) 保证类不超过物理容量、总量不超过超售容量、
+ *            客户端不超过限额
+ *          - 释放全部会话后账本归零、预留槽位全部回收
+ *          - 链路/客户端账本的 ID 哈希索引在扩容重建后覆盖全部账本，
+ *            重配置追加的链路可按 ID 查到
+ *          配置由假实现提供: 4 条链路 (重配置后 40 条)、256 个有限额的
+ *          客户端。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include "magic_admission.h"
+#include "magic_hash.h"
+
+#define STRESS_THREADS 8       /* 工作线程数 */
+#define STRESS_SESSIONS 200    /* 每线程会话数 (总数即最大并存预留规模) */
+#define STRESS_ITERATIONS 5000 /* 每线程操作次数 */
+#define STRESS_LINKS 4         /* 链路数 */
+#define STRESS_CLIENTS 256     /* 客户端数 */
+#define STRESS_RECONF_LINKS 40 /* 重配置后的链路数 */
+
+/*===========================================================================
+ * 假配置
+ *===========================================================================*/
+
+static DLMConfig g_dlms[STRESS_RECONF_LINKS];
+static ClientProfile g_profiles[STRESS_CLIENTS];
+static MagicConfig g_config;
+static MagicConfigStore g_store;
+
+MagicConfig *magic_config_current(MagicConfigStore *store) {
+  (void)store;
+  return &g_config;
+}
+
+ClientProfile *magic_config_find_client(MagicConfig *config,
+                                        const char *client_id) {
+  (void)config;
+  for (int i = 0; i < STRESS_CLIENTS; i++) {
+    if (strcmp(g_profiles[i].client_id, client_id) == 0)
+      return &g_profiles[i];
+  }
+  return NULL;
+}
+
+static void setup_config(void) {
+  for (int i = 0; i < STRESS_RECONF_LINKS; i++) {
+    snprintf(g_dlms[i].dlm_name, sizeof(g_dlms[i].dlm_name), "LINK_%d", i);
+    g_dlms[i].max_forward_bw_kbps = 200000;
+    g_dlms[i].max_return_bw_kbps = 50000;
+    g_dlms[i].oversubscription_ratio = 1.5f;
+  }
+  for (int i = 0; i < STRESS_CLIENTS; i++) {
+    snprintf(g_profiles[i].client_id, sizeof(g_profiles[i].client_id),
+             "client-%d", i);
+    g_profiles[i].bandwidth.max_forward_kbps = 8000;
+    g_profiles[i].bandwidth.max_return_kbps = 2000;
+  }
+  g_config.dlm_configs = g_dlms;
+  g_config.num_dlm_configs = STRESS_LINKS;
+}
+
+/*===========================================================================
+ * 账本核对
+ *===========================================================================*/
+
+static MagicAdmissionContext g_ac;
+static volatile int g_stop;
+static unsigned long g_checks;
+
+/* 持锁核对: 账本 = 计入账本的预留 (RESERVED/COMMITTED) 之和 */
+static void check_ledgers_locked(bool quiescent) {
+  uint64_t link_fwd[STRESS_LINKS][ADMISSION_CLASS_COUNT] = {{0}};
+  uint64_t link_ret[STRESS_LINKS][ADMISSION_CLASS_COUNT] = {{0}};
+  uint64_t client_fwd[STRESS_CLIENTS] = {0};
+  uint64_t client_ret[STRESS_CLIENTS] = {0};
+  uint32_t in_use = 0;
+
+  for (int i = 0; i < ADMISSION_MAX_RESERVATIONS; i++) {
+    const AdmissionReservation *r = &g_ac.res[i];
+    if (r->state == ADMISSION_RES_FREE)
+      continue;
+    in_use++;
+    CHECK(1, !quiescent || r->state == ADMISSION_RES_COMMITTED);
+    if (r->state == ADMISSION_RES_PREEMPTING)
+      continue;
+    link_fwd[r->link_idx][r->qos_class] += r->fwd_kbps;
+    link_ret[r->link_idx][r->qos_class] += r->ret_kbps;
+    client_fwd[r->client_idx] += r->fwd_kbps;
+    client_ret[r->client_idx] += r->ret_kbps;
+  }
+  CHECK(g_ac.res_count, in_use);
+
+  for (uint32_t l = 0; l < g_ac.link_count; l++) {
+    const AdmissionLinkLedger *ll = &g_ac.links[l];
+    for (int c = 0; c < ADMISSION_CLASS_COUNT; c++) {
+      CHECK(link_fwd[l][c], ll->used_fwd_kbps[c]);
+      CHECK(link_ret[l][c], ll->used_ret_kbps[c]);
+    }
+    if (!quiescent)
+      continue;
+    CHECK(1, ll->used_fwd_kbps[ADMISSION_CLASS_GUARANTEED] <=
+                 ll->capacity_fwd_kbps);
+    CHECK(1, ll->used_ret_kbps[ADMISSION_CLASS_GUARANTEED] <=
+                 ll->capacity_ret_kbps);
+    CHECK(1, link_fwd[l][0] + link_fwd[l][1] <= ll->oversub_fwd_kbps);
+    CHECK(1, link_ret[l][0] + link_ret[l][1] <= ll->oversub_ret_kbps);
+  }
+
+  for (uint32_t c = 0; c < g_ac.client_count; c++) {
+    const AdmissionClientLedger *cl = &g_ac.clients[c];
+    CHECK(client_fwd[c], cl->used_fwd_kbps);
+    CHECK(client_ret[c], cl->used_ret_kbps);
+    if (quiescent) {
+      CHECK(1, cl->used_fwd_kbps <= cl->max_fwd_kbps);
+      CHECK(1, cl->used_ret_kbps <= cl->max_ret_kbps);
+    }
+  }
+}
+
+static void *checker_thread(void *arg) {
+  (void)arg;
+  while (!g_stop) {
+    pthread_mutex_lock(&g_ac.lock);
+    check_ledgers_locked(false);
+    pthread_mutex_unlock(&g_ac.lock);
+    g_checks++;
+  }
+  return NULL;
+}
+
+/*===========================================================================
+ * 工作线程
+ *===========================================================================*/
+
+typedef struct {
+  int id;
+  unsigned int seed;
+  unsigned long reserves;
+  unsigned long victims;
+} Worker;
+
+static void session_name(char *buf, size_t len, int worker, int n) {
+  snprintf(buf, len, "sess;%d;%d", worker, n);
+}
+
+static void *worker_thread(void *arg) {
+  Worker *w = (Worker *)arg;
+
+  for (int it = 0; it < STRESS_ITERATIONS; it++) {
+    int n = rand_r(&w->seed) % STRESS_SESSIONS;
+    char session_id[64], client_id[32], link_id[16];
+    session_name(session_id, sizeof(session_id), w->id, n);
+    snprintf(client_id, sizeof(client_id), "client-%d",
+             (w->id * STRESS_SESSIONS + n) % STRESS_CLIENTS);
+    snprintf(link_id, sizeof(link_id), "LINK_%d",
+             rand_r(&w->seed) % STRESS_LINKS);
+
+    if (rand_r(&w->seed) % 8 == 0) {
+      magic_admission_release(&g_ac, session_id);
+      continue;
+    }
+
+    AdmissionRequest req = {
+        .session_id = session_id,
+        .client_id = client_id,
+        .link_id = link_id,
+        .requested_fwd_kbps = 100 + rand_r(&w->seed) % 1500,
+        .requested_ret_kbps = 20 + rand_r(&w->seed) % 400,
+        .priority_class = (uint8_t)(rand_r(&w->seed) % 10),
+        .allow_preemption = rand_r(&w->seed) % 3 == 0,
+    };
+    if (rand_r(&w->seed) % 2) {
+      req.required_fwd_kbps = req.requested_fwd_kbps / 4;
+      req.required_ret_kbps = req.requested_ret_kbps / 4;
+    }
+
+    AdmissionGrant grant;
+    w->reserves++;
+    if (magic_admission_reserve(&g_ac, &req, &grant) != ADMISSION_OK)
+      continue;
+    CHECK(1, grant.granted_fwd_kbps <= req.requested_fwd_kbps);
+    CHECK(1, grant.granted_ret_kbps <= req.requested_ret_kbps);
+
+    /* 模拟 MIH 结果: 大部分成功提交，其余回滚 */
+    if (rand_r(&w->seed) % 4 == 0) {
+      CHECK(0, magic_admission_rollback(&g_ac, session_id));
+    } else {
+      AdmissionVictims victims;
+      CHECK(0, magic_admission_commit(&g_ac, session_id, &victims));
+      w->victims += victims.count;
+    }
+  }
+  return NULL;
+}
+
+/* 每个账本恰好出现在其 ID 对应的桶链上一次 */
+static void check_index(void) {
+  uint32_t seen = 0;
+  for (uint32_t b = 0; b < g_ac.link_buckets; b++) {
+    for (int i = g_ac.link_hash[b]; i >= 0; i = g_ac.links[i].hash_next) {
+      CHECK(b, magic_fnv1a32_str(g_ac.links[i].link_id) &
+                   (g_ac.link_buckets - 1));
+      seen++;
+    }
+  }
+  CHECK(g_ac.link_count, seen);
+  CHECK(g_ac.link_capacity, g_ac.link_buckets);
+
+  seen = 0;
+  for (uint32_t b = 0; b < g_ac.client_buckets; b++) {
+    for (int i = g_ac.client_hash[b]; i >= 0; i = g_ac.clients[i].hash_next) {
+      CHECK(b, magic_fnv1a32_str(g_ac.clients[i].client_id) &
+                   (g_ac.client_buckets - 1));
+      seen++;
+    }
+  }
+  CHECK(g_ac.client_count, seen);
+  CHECK(g_ac.client_capacity, g_ac.client_buckets);
+}
+
+int main(void) {
+  setup_config();
+  CHECK(0, magic_admission_init(&g_ac, &g_store));
+  CHECK(STRESS_LINKS, g_ac.link_count);
+
+  Worker workers[STRESS_THREADS];
+  pthread_t threads[STRESS_THREADS], checker;
+  CHECK(0, pthread_create(&checker, NULL, checker_thread, NULL));
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    workers[i] = (Worker){.id = i, .seed = 1234u + (unsigned)i};
+    CHECK(0, pthread_create(&threads[i], NULL, worker_thread, &workers[i]));
+  }
+  for (int i = 0; i < STRESS_THREADS; i++)
+    pthread_join(threads[i], NULL);
+  g_stop = 1;
+  pthread_join(checker, NULL);
+
+  unsigned long reserves = 0, victims = 0;
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    reserves += workers[i].reserves;
+    victims += workers[i].victims;
+  }
+  CHECK(reserves, g_ac.total_admitted + g_ac.total_rejected);
+  CHECK(victims, g_ac.total_preempted);
+  printf("reservations=%lu admitted=%lu preempted=%lu live=%u checks=%lu\n",
+         reserves, (unsigned long)g_ac.total_admitted, victims,
+         g_ac.res_count, g_checks);
+
+  /* 静止状态: 无未决预留，容量与限额均不超 */
+  pthread_mutex_lock(&g_ac.lock);
+  check_ledgers_locked(true);
+  pthread_mutex_unlock(&g_ac.lock);
+  CHECK(1, g_ac.total_preempted > 0);
+
+  /* 释放全部会话后账本归零 */
+  for (int w = 0; w < STRESS_THREADS; w++) {
+    for (int n = 0; n < STRESS_SESSIONS; n++) {
+      char session_id[64];
+      session_name(session_id, sizeof(session_id), w, n);
+      magic_admission_release(&g_ac, session_id);
+    }
+  }
+  CHECK(0, g_ac.res_count);
+  for (uint32_t l = 0; l < g_ac.link_count; l++) {
+    for (int c = 0; c < ADMISSION_CLASS_COUNT; c++) {
+      CHECK(0, g_ac.links[l].used_fwd_kbps[c]);
+      CHECK(0, g_ac.links[l].used_ret_kbps[c]);
+    }
+    CHECK(-1, g_ac.links[l].res_head);
+  }
+  for (uint32_t c = 0; c < g_ac.client_count; c++) {
+    CHECK(0, g_ac.clients[c].used_fwd_kbps);
+    CHECK(0, g_ac.clients[c].used_ret_kbps);
+  }
+
+  int free_slots = 0;
+  for (int idx = g_ac.free_head; idx >= 0; idx = g_ac.res[idx].hash_next)
+    free_slots++;
+  CHECK(ADMISSION_MAX_RESERVATIONS, free_slots);
+
+  /* 账本索引: 客户端已从 16 倍增到 256，重配置再把链路扩到 40 条 */
+  CHECK(STRESS_CLIENTS, g_ac.client_count);
+  check_index();
+  g_config.num_dlm_configs = STRESS_RECONF_LINKS;
+  magic_admission_reconfigure(&g_ac, &g_config);
+  CHECK(STRESS_RECONF_LINKS, g_ac.link_count);
+  check_index();
+  for (int i = 0; i < STRESS_RECONF_LINKS; i++) {
+    uint32_t fwd = 0, ret = 0;
+    CHECK(0, magic_admission_get_link_headroom(&g_ac, g_dlms[i].dlm_name,
+                                               &fwd, &ret));
+    CHECK(300000, fwd);
+    CHECK(75000, ret);
+  }
+  CHECK(-1, magic_admission_get_link_headroom(&g_ac, "LINK_NONE", NULL, NULL));
+
+  magic_admission_cleanup(&g_ac);
+  PASSTEST();
+}
@@ -0,0 +1,496 @@
+/**
+ * @file test_cic_failover.c
+ * @brief 链路故障迁移 (magic_cic_failover_link) 的批量切换测试。
+ * @details 直接编译 magic_cic.c 以访问其静态状态，外部模块以假实现替换:
+ *          策略引擎总是选择 CELLULAR，MIH 资源请求依次分配承载 7、8…，
+ *          数据平面事务的提交结果由测试控制。验证:
+ *          - 提交失败: 准入全部回滚、新承载被释放、会话仍在旧链路与旧承载上、
+ *            旧承载保留、不发送 MNTR
+ *          - 登记失败: 单个会话当场回滚，其余会话正常迁移
+ *          - 提交后个别会话结果为失败: 只回滚该会话，其余会话正常迁移
+ *          - 提交成功: 准入提交、会话更新、旧承载在提交之后才释放、发送 MNTR
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include "magic_cic.c"
+
+/*===========================================================================
+ * 被测上下文与调用记录
+ *===========================================================================*/
+
+MagicContext g_magic_ctx;
+struct std_diam_dict_handles g_std_dict;
+struct magic_dict_handles g_magic_dict;
+
+#define MAX_EVENTS 32
+
+typedef struct {
+  char link_id[64];
+  uint8_t bearer_id;
+  int seq; /* 全局事件序号，用于检查先后顺序 */
+} ReleaseEvent;
+
+static struct {
+  int seq;
+  int txn_commit_result;   /* magic_dataplane_txn_commit 的返回值 */
+  const char *fail_switch; /* 登记切换时失败的会话 */
+  const char *fail_commit; /* 提交结果为失败的会话 */
+  DataplaneTxnEntry entries[MAX_EVENTS];
+  int txn_commit_seq;
+  uint8_t next_bearer;
+
+  int adm_reserve;
+  int adm_commit;
+  int adm_rollback;
+  int mntr;
+  int nrelease;
+  ReleaseEvent release[MAX_EVENTS];
+} fake;
+
+static ClientSession g_sessions[3];
+static int g_nsessions;
+
+static void reset_fake(int commit_result, const char *fail_switch) {
+  memset(&fake, 0, sizeof(fake));
+  fake.txn_commit_result = commit_result;
+  fake.fail_switch = fail_switch;
+  fake.next_bearer = 7;
+}
+
+static void add_session(const char *id, const char *link, uint8_t bearer) {
+  ClientSession *s = &g_sessions[g_nsessions++];
+  memset(s, 0, sizeof(*s));
+  snprintf(s->session_id, sizeof(s->session_id), "%s", id);
+  snprintf(s->client_id, sizeof(s->client_id), "client-%s", id);
+  snprintf(s->assigned_link_id, sizeof(s->assigned_link_id), "%s", link);
+  s->bearer_id = bearer;
+  s->state = SESSION_STATE_ACTIVE;
+  s->granted_bw_kbps = 1000;
+  s->granted_ret_bw_kbps = 500;
+}
+
+static const ReleaseEvent *find_release(const char *link, uint8_t bearer) {
+  char mihf[80];
+  snprintf(mihf, sizeof(mihf), "MIHF_%s", link);
+  for (int i = 0; i < fake.nrelease; i++) {
+    if (strcmp(fake.release[i].link_id, mihf) == 0 &&
+        fake.release[i].bearer_id == bearer) {
+      return &fake.release[i];
+    }
+  }
+  return NULL;
+}
+
+/*===========================================================================
+ * 切换路径用到的假实现
+ *===========================================================================*/
+
+int magic_session_get_active_sessions(SessionManager *mgr,
+                                      ClientSession **sessions,
+                                      int max_count) {
+  int n = 0;
+  for (int i = 0; i < g_nsessions && n < max_count; i++) {
+    sessions[n++] = &g_sessions[i];
+  }
+  return n;
+}
+
+int magic_session_capacity(SessionManager *mgr) {
+  return (int)(sizeof(g_sessions) / sizeof(g_sessions[0]));
+}
+
+bool adif_client_is_connected(AdifClientContext *ctx) { return false; }
+
+int magic_policy_select_path(PolicyContext *ctx, const PolicyRequest *req,
+                             PolicyResponse *resp) {
+  resp->success = true;
+  snprintf(resp->selected_link_id, sizeof(resp->selected_link_id), "CELLULAR");
+  return 0;
+}
+
+AdmissionResult magic_admission_reserve(MagicAdmissionContext *ac,
+                                        const AdmissionRequest *req,
+                                        AdmissionGrant *grant) {
+  fake.adm_reserve++;
+  memset(grant, 0, sizeof(*grant));
+  grant->granted_fwd_kbps = req->requested_fwd_kbps / 2;
+  grant->granted_ret_kbps = req->requested_ret_kbps / 2;
+  return ADMISSION_OK;
+}
+
+int magic_admission_commit(MagicAdmissionContext *ac, const char *session_id,
+                           AdmissionVictims *victims) {
+  fake.adm_commit++;
+  return 0;
+}
+
+int magic_admission_rollback(MagicAdmissionContext *ac,
+                             const char *session_id) {
+  fake.adm_rollback++;
+  return 0;
+}
+
+int magic_dlm_mih_link_resource_request(
+    MagicLmiContext *ctx, const MIH_Link_Resource_Request *request,
+    MIH_Link_Resource_Confirm *confirm) {
+  confirm->status = STATUS_SUCCESS;
+  confirm->has_bearer_id = true;
+  confirm->bearer_identifier = fake.next_bearer++;
+  return 0;
+}
+
+uint32_t magic_lmi_resource_request_async(
+    MagicLmiContext *ctx, const MIH_Link_Resource_Request *request,
+    uint32_t timeout_ms, lmi_resource_cb_t cb, void *arg) {
+  if (request->resource_action == RESOURCE_ACTION_RELEASE &&
+      fake.nrelease < MAX_EVENTS) {
+    ReleaseEvent *ev = &fake.release[fake.nrelease++];
+    snprintf(ev->link_id, sizeof(ev->link_id), "%s",
+             request->destination_id.mihf_id);
+    ev->bearer_id = request->bearer_identifier;
+    ev->seq = ++fake.seq;
+  }
+  return 1;
+}
+
+uint32_t magic_dataplane_get_table_id(DataplaneContext *ctx,
+                                      const char *link_id) {
+  return 101;
+}
+
+int magic_dataplane_txn_begin(DataplaneContext *ctx, DataplaneTxn *txn) {
+  memset(txn, 0, sizeof(*txn));
+  txn->ctx = ctx;
+  return 0;
+}
+
+int magic_dataplane_txn_switch_session(DataplaneTxn *txn,
+                                       const char *session_id,
+                                       const char *new_link_id) {
+  if (fake.fail_switch && strcmp(fake.fail_switch, session_id) == 0) {
+    return -1;
+  }
+  DataplaneTxnEntry *entry = &fake.entries[txn->count++];
+  snprintf(entry->session_id, sizeof(entry->session_id), "%s", session_id);
+  snprintf(entry->new_link_id, sizeof(entry->new_link_id), "%s", new_link_id);
+  txn->entries = fake.entries;
+  return 0;
+}
+
+int magic_dataplane_txn_commit(DataplaneTxn *txn) {
+  fake.txn_commit_seq = ++fake.seq;
+  txn->committed = true;
+  for (uint32_t i = 0; i < txn->count; i++) {
+    bool failed = fake.txn_commit_result < 0 ||
+                  (fake.fail_commit &&
+                   strcmp(fake.fail_commit, txn->entries[i].session_id) == 0);
+    txn->entries[i].switched = failed ? -1 : 1;
+  }
+  return fake.txn_commit_result;
+}
+
+int magic_dataplane_txn_result(const DataplaneTxn *txn,
+                               const char *session_id) {
+  for (uint32_t i = 0; i < txn->count; i++) {
+    if (strcmp(txn->entries[i].session_id, session_id) == 0) {
+      return txn->committed ? txn->entries[i].switched : -1;
+    }
+  }
+  return -1;
+}
+
+void magic_dataplane_txn_release(DataplaneTxn *txn) {}
+
+int magic_dataplane_get_link_gateway(DataplaneContext *ctx, const char *link_id,
+                                     char *gateway_ip, size_t ip_len) {
+  return -1;
+}
+
+int magic_cic_on_handover(MagicContext *ctx, ClientSession *session,
+                          const char *new_link_id, const char *new_gateway_ip) {
+  fake.mntr++;
+  return 0;
+}
+
+MagicConfig *magic_config_current(MagicConfigStore *store) { return NULL; }
+
+ClientProfile *magic_config_find_client(MagicConfig *config,
+                                        const char *client_id) {
+  return NULL;
+}
+
+const char *magic_admission_result_str(AdmissionResult result) { return "-"; }
+
+/*===========================================================================
+ * 切换路径不会用到的依赖 (仅满足链接)
+ *===========================================================================*/
+
+int add_comm_ans_params_simple(struct msg *msg,
+                               const comm_ans_params_t *params) { abort(); }
+int add_dlm_info_simple(struct avp *a, const dlm_info_t *d) { abort(); }
+int add_link_status_simple(struct avp *a, const link_status_t *l) { abort(); }
+int adif_client_get_state(AdifClientContext *c, AdifAircraftState *s) {
+  abort();
+}
+const char *adif_flight_phase_to_string(AdifFlightPhase p) { abort(); }
+const char *adif_phase_to_policy_phase(AdifFlightPhase p) { abort(); }
+int cdr_close(CDRManager *m, CDRRecord *c, uint64_t i, uint64_t o) {
+  abort();
+}
+CDRRecord *cdr_create(CDRManager *m, const char *s, const char *c,
+                      const char *d) {
+  abort();
+}
+CDRRecord *cdr_find_by_session(CDRManager *m, const char *s) { abort(); }
+void cdr_periodic_maintenance(CDRManager *m) { abort(); }
+int cdr_rollover(CDRManager *m, const char *s, uint64_t i, uint64_t o,
+                 CDRRolloverResult *r) {
+  abort();
+}
+int magic_admission_release(MagicAdmissionContext *a, const char *s) {
+  abort();
+}
+void magic_cic_push_dump_stats(void) { abort(); }
+int magic_cic_send_initial_mscr(MagicContext *c, ClientSession *s) {
+  abort();
+}
+int magic_cic_send_mntr(MagicContext *c, ClientSession *s,
+                        const MNTRParams *p) {
+  abort();
+}
+MagicConfigSnapshot *magic_config_hold(MagicConfigStore *s) { abort(); }
+bool magic_config_is_dlm_allowed(const ClientProfile *c, const char *d) {
+  abort();
+}
+bool magic_config_is_flight_phase_allowed(const ClientProfile *c,
+                                          CfgFlightPhase p) {
+  abort();
+}
+CfgFlightPhase magic_config_parse_flight_phase(const char *p) { abort(); }
+MagicConfigSnapshot *magic_config_pin(MagicConfigStore *s,
+                                      MagicConfigSnapshot *n) {
+  abort();
+}
+MagicConfig *magic_config_read_begin(MagicConfigStore *s) { abort(); }
+void magic_config_read_end(MagicConfigStore *s) { abort(); }
+void magic_config_release(MagicConfigStore *s, MagicConfigSnapshot *n) {
+  abort();
+}
+void magic_config_unpin(MagicConfigStore *s, MagicConfigSnapshot *p) {
+  abort();
+}
+int magic_dataplane_add_client_route(DataplaneContext *c, const char *ip,
+                                     const char *s, const char *l,
+                                     const char *d) {
+  abort();
+}
+int magic_dataplane_add_tft_rule(DataplaneContext *c, const TftTuple *t,
+                                 const char *s, const char *l) {
+  abort();
+}
+int magic_dataplane_ipset_add_control(const char *ip) { abort(); }
+int magic_dataplane_ipset_add_data(const char *ip) { abort(); }
+int magic_dataplane_register_link(DataplaneContext *c, const char *l,
+                                  const char *i, const char *g) {
+  abort();
+}
+int magic_dataplane_remove_client_route(DataplaneContext *c, const char *s) {
+  abort();
+}
+int magic_dataplane_remove_tft_rules(DataplaneContext *c, const char *s) {
+  abort();
+}
+int magic_dataplane_switch_client_link(DataplaneContext *c, const char *s,
+                                       const char *l) {
+  abort();
+}
+int magic_dict_init(void) { abort(); }
+void magic_flow_dump(MagicFlowClassifier *f) { abort(); }
+int magic_flow_find_conflicts(MagicFlowClassifier *f, const MagicFlowRule *r,
+                              MagicFlowMatch *o, int n) {
+  abort();
+}
+int magic_flow_insert(MagicFlowClassifier *f, const MagicFlowRule *r) {
+  abort();
+}
+int magic_flow_remove_session(MagicFlowClassifier *f, const char *s) {
+  abort();
+}
+int magic_flow_rule_from_tft(const TFTRule *t, const char *ip, uint8_t d,
+                             MagicFlowRule *r) {
+  abort();
+}
+DlmClient *magic_lmi_find_by_link(MagicLmiContext *c, const char *l) {
+  abort();
+}
+int magic_lmi_client_capacity(MagicLmiContext *c) { abort(); }
+DlmClient *magic_lmi_client_at(MagicLmiContext *c, int i) { abort(); }
+int magic_session_assign_link(ClientSession *s, const char *l, uint8_t b,
+                              uint32_t f, uint32_t r) {
+  abort();
+}
+ClientSession *magic_session_create(SessionManager *m, const char *s,
+                                    const char *c, const char *r) {
+  abort();
+}
+ClientSession *magic_session_find_by_id(SessionManager *m, const char *s) {
+  abort();
+}
+ClientSession *magic_session_at(SessionManager *m, int i) { abort(); }
+int magic_session_set_state(ClientSession *s, SessionState n) { abort(); }
+int magic_session_set_subscription(ClientSession *s, uint32_t l) { abort(); }
+const char *magic_session_state_name(SessionState s) { abort(); }
+uint64_t magic_timer_now_ms(void) { abort(); }
+int magic_timer_schedule(MagicTimerContext *t, uint32_t d, magic_timer_cb_t c,
+                         void *a) {
+  abort();
+}
+int napt_validate_against_whitelist(const char *n,
+                                    const TrafficSecurityConfig *w,
+                                    const char *ip, char *e, size_t l) {
+  abort();
+}
+int tft_parse_rule(const char *t, TFTRule *r) { abort(); }
+int tft_validate_against_whitelist(const char *t,
+                                   const TrafficSecurityConfig *w, char *e,
+                                   size_t l) {
+  abort();
+}
+int traffic_get_session_stats(TrafficMonitorContext *c, const char *s,
+                              TrafficStats *st) {
+  abort();
+}
+uint32_t traffic_register_session(TrafficMonitorContext *c, const char *s,
+                                  const char *cl, const char *ip) {
+  abort();
+}
+uint32_t traffic_session_id_to_mark(const char *s) { abort(); }
+int traffic_unregister_session(TrafficMonitorContext *c, const char *s) {
+  abort();
+}
+
+/*===========================================================================
+ * 测试用例
+ *===========================================================================*/
+
+/* 事务提交失败: 全部回滚，会话原样留在 SATCOM */
+static void test_commit_failure(void) {
+  g_nsessions = 0;
+  add_session("s1", "SATCOM", 3);
+  add_session("s2", "SATCOM", 4);
+  reset_fake(-1, NULL);
+
+  CHECK(0, magic_cic_failover_link(&g_magic_ctx, "SATCOM"));
+
+  CHECK(2, fake.adm_reserve);
+  CHECK(0, fake.adm_commit);
+  CHECK(2, fake.adm_rollback);
+  CHECK(0, fake.mntr);
+
+  for (int i = 0; i < 2; i++) {
+    CHECK_STR("SATCOM", g_sessions[i].assigned_link_id);
+    CHECK(1000, g_sessions[i].granted_bw_kbps);
+    CHECK(500, g_sessions[i].granted_ret_bw_kbps);
+  }
+  CHECK(3, g_sessions[0].bearer_id);
+  CHECK(4, g_sessions[1].bearer_id);
+
+  /* 只释放新链路上刚分配的承载，旧承载保留 */
+  CHECK(2, fake.nrelease);
+  CHECK(1, find_release("CELLULAR", 7) != NULL);
+  CHECK(1, find_release("CELLULAR", 8) != NULL);
+  CHECK(0, find_release("SATCOM", 3) != NULL);
+  CHECK(0, find_release("SATCOM", 4) != NULL);
+}
+
+/* 单个会话登记失败: 当场回滚该会话，其余会话正常迁移 */
+static void test_queue_failure(void) {
+  g_nsessions = 0;
+  add_session("s1", "SATCOM", 3);
+  add_session("s2", "SATCOM", 4);
+  reset_fake(1, "s1");
+
+  CHECK(1, magic_cic_failover_link(&g_magic_ctx, "SATCOM"));
+
+  CHECK(1, fake.adm_commit);
+  CHECK(1, fake.adm_rollback);
+  CHECK(1, fake.mntr);
+
+  CHECK_STR("SATCOM", g_sessions[0].assigned_link_id);
+  CHECK(3, g_sessions[0].bearer_id);
+  CHECK(1, find_release("CELLULAR", 7) != NULL);
+  CHECK(0, find_release("SATCOM", 3) != NULL);
+
+  CHECK_STR("CELLULAR", g_sessions[1].assigned_link_id);
+  CHECK(8, g_sessions[1].bearer_id);
+  CHECK(1, find_release("SATCOM", 4) != NULL);
+}
+
+/* 提交后某会话结果为失败: 只回滚该会话，其余会话正常迁移 */
+static void test_commit_entry_failure(void) {
+  g_nsessions = 0;
+  add_session("s1", "SATCOM", 3);
+  add_session("s2", "SATCOM", 4);
+  reset_fake(1, NULL);
+  fake.fail_commit = "s2";
+
+  CHECK(1, magic_cic_failover_link(&g_magic_ctx, "SATCOM"));
+
+  CHECK(1, fake.adm_commit);
+  CHECK(1, fake.adm_rollback);
+  CHECK(1, fake.mntr);
+
+  CHECK_STR("CELLULAR", g_sessions[0].assigned_link_id);
+  CHECK(1, find_release("SATCOM", 3) != NULL);
+
+  CHECK_STR("SATCOM", g_sessions[1].assigned_link_id);
+  CHECK(4, g_sessions[1].bearer_id);
+  CHECK(1, find_release("CELLULAR", 8) != NULL);
+  CHECK(0, find_release("SATCOM", 4) != NULL);
+}
+
+/* 事务提交成功: 切换生效，旧承载在提交之后释放 */
+static void test_commit_success(void) {
+  g_nsessions = 0;
+  add_session("s1", "SATCOM", 3);
+  add_session("s2", "SATCOM", 4);
+  reset_fake(2, NULL);
+
+  CHECK(2, magic_cic_failover_link(&g_magic_ctx, "SATCOM"));
+
+  CHECK(2, fake.adm_commit);
+  CHECK(0, fake.adm_rollback);
+  CHECK(2, fake.mntr);
+
+  CHECK_STR("CELLULAR", g_sessions[0].assigned_link_id);
+  CHECK_STR("CELLULAR", g_sessions[1].assigned_link_id);
+  CHECK(7, g_sessions[0].bearer_id);
+  CHECK(8, g_sessions[1].bearer_id);
+  CHECK(500, g_sessions[0].granted_bw_kbps);
+  CHECK(250, g_sessions[0].granted_ret_bw_kbps);
+
+  CHECK(2, fake.nrelease);
+  const ReleaseEvent *r1 = find_release("SATCOM", 3);
+  const ReleaseEvent *r2 = find_release("SATCOM", 4);
+  CHECK(1, r1 != NULL && r2 != NULL);
+  CHECK(1, r1->seq > fake.txn_commit_seq);
+  CHECK(1, r2->seq > fake.txn_commit_seq);
+}
+
+int main(int argc, char *argv[]) {
+  (void)argc;
+  (void)argv;
+
+  g_ctx = &g_magic_ctx;
+
+  test_commit_failure();
+  test_queue_failure();
+  test_commit_entry_failure();
+  test_commit_success();
+
+  PASSTEST();
+}
@@ -0,0 +1,184 @@
+/**
+ * @file test_dataplane_netns.c
+ * @brief 数据平面 netlink 后端在独立网络命名空间中的路由/规则下发测试。
+ * @details 直接编译 magic_dataplane_nl.c。unshare(CLONE_NEWNET) 进入新的
+ *          网络命名空间后经 netlink 后端:
+ *          - 启动 lo，向策略路由表安装默认路由与黑洞路由
+ *          - 安装按源地址与按 fwmark 的策略路由规则
+ *          - 以批量删除接口移除上述规则与路由
+ *          每一步都另行 dump 内核路由表/规则表核对结果，不依赖后端自身的
+ *          返回值。无 CAP_SYS_ADMIN (无法创建命名空间) 时跳过。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include "magic_dataplane_nl.c"
+#include <sched.h>
+
+#define NS_TABLE 100                  /* 默认路由所在的策略路由表 */
+#define NS_BLACKHOLE_TABLE 101        /* 黑洞路由所在的策略路由表 */
+#define NS_CLIENT_IP "10.255.0.5"     /* 按源地址规则的客户端地址 */
+#define NS_CLIENT_NET "10.255.0.0/24" /* 按源地址批量清理的网段 */
+#define NS_RULE_PRIO 1000             /* 按源地址规则的优先级 */
+#define NS_MARK 0x100                 /* 按 fwmark 规则的标记 */
+#define NS_MARK_PRIO 900              /* 按 fwmark 规则的优先级 */
+
+/*===========================================================================
+ * 内核状态核对 (独立 dump)
+ *===========================================================================*/
+
+typedef struct {
+  uint32_t table;
+  uint8_t type;
+  int count;
+} RouteCount;
+
+static int route_count_cb(const struct nlmsghdr *h, void *arg) {
+  RouteCount *c = arg;
+  if (h->nlmsg_type != RTM_NEWROUTE)
+    return 0;
+
+  const struct rtmsg *rtm = NLMSG_DATA(h);
+  const struct nlattr *tb[RTA_MAX + 1];
+  nl_parse_attrs((const char *)rtm + NLMSG_ALIGN(sizeof(*rtm)),
+                 (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*rtm)), tb, RTA_MAX);
+
+  uint32_t table = rtm->rtm_table;
+  if (tb[RTA_TABLE] && nl_attr_len(tb[RTA_TABLE]) >= 4)
+    memcpy(&table, nl_attr_data(tb[RTA_TABLE]), 4);
+  if (table == c->table && rtm->rtm_dst_len == 0 && rtm->rtm_type == c->type)
+    c->count++;
+  return 0;
+}
+
+/* 统计指定表中给定类型的 IPv4 默认路由条数 */
+static int count_routes(DataplaneNetlink *nl, uint32_t table, uint8_t type) {
+  RouteCount c = {table, type, 0};
+  NlMsgBuf m;
+  struct rtmsg *rtm = nl_msg_init(&m, RTM_GETROUTE, 0, sizeof(*rtm));
+  rtm->rtm_family = AF_INET;
+  pthread_mutex_lock(&nl->mutex);
+  int err = nl_dump(nl, nl->rt_fd, &m, route_count_cb, &c);
+  pthread_mutex_unlock(&nl->mutex);
+  CHECK(0, err);
+  return c.count;
+}
+
+typedef struct {
+  uint32_t src_be;   ///< 源地址 (网络序, 0=无 FRA_SRC)。
+  uint32_t fwmark;   ///< fwmark (0=无 FRA_FWMARK)。
+  uint32_t table;    ///< 路由表。
+  uint32_t priority; ///< 优先级。
+  int count;         ///< 匹配条数。
+} RuleCount;
+
+static int rule_count_cb(const struct nlmsghdr *h, void *arg) {
+  RuleCount *c = arg;
+  if (h->nlmsg_type != RTM_NEWRULE)
+    return 0;
+
+  const struct fib_rule_hdr *frh = NLMSG_DATA(h);
+  const struct nlattr *tb[FRA_MAX + 1];
+  nl_parse_attrs((const char *)frh + NLMSG_ALIGN(sizeof(*frh)),
+                 (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*frh)), tb, FRA_MAX);
+
+  uint32_t src = 0, mark = 0, table = frh->table, prio = 0;
+  if (tb[FRA_SRC] && nl_attr_len(tb[FRA_SRC]) >= 4)
+    memcpy(&src, nl_attr_data(tb[FRA_SRC]), 4);
+  if (tb[FRA_FWMARK] && nl_attr_len(tb[FRA_FWMARK]) >= 4)
+    memcpy(&mark, nl_attr_data(tb[FRA_FWMARK]), 4);
+  if (tb[FRA_TABLE] && nl_attr_len(tb[FRA_TABLE]) >= 4)
+    memcpy(&table, nl_attr_data(tb[FRA_TABLE]), 4);
+  if (tb[FRA_PRIORITY] && nl_attr_len(tb[FRA_PRIORITY]) >= 4)
+    memcpy(&prio, nl_attr_data(tb[FRA_PRIORITY]), 4);
+
+  if (src == c->src_be && mark == c->fwmark && table == c->table &&
+      prio == c->priority && frh->action == FR_ACT_TO_TBL)
+    c->count++;
+  return 0;
+}
+
+/* 统计与给定字段完全匹配的 IPv4 策略路由规则条数 */
+static int count_rules(DataplaneNetlink *nl, const char *src_ip,
+                       uint32_t fwmark, uint32_t table, uint32_t priority) {
+  RuleCount c = {0, fwmark, table, priority, 0};
+  if (src_ip)
+    CHECK(1, inet_pton(AF_INET, src_ip, &c.src_be));
+  NlMsgBuf m;
+  struct fib_rule_hdr *frh =
+      nl_msg_init(&m, RTM_GETRULE, 0, sizeof(struct fib_rule_hdr));
+  frh->family = AF_INET;
+  pthread_mutex_lock(&nl->mutex);
+  int err = nl_dump(nl, nl->rt_fd, &m, rule_count_cb, &c);
+  pthread_mutex_unlock(&nl->mutex);
+  CHECK(0, err);
+  return c.count;
+}
+
+int main(void) {
+  if (unshare(CLONE_NEWNET) != 0)
+    SKIPTEST("需要 CAP_SYS_ADMIN 创建网络命名空间");
+
+  DataplaneNetlink nl;
+  CHECK(0, magic_dp_nl_open(&nl));
+
+  /* 新命名空间里 lo 默认 down，scope link 路由要求接口已启动 */
+  CHECK(0, magic_dp_nl_link_up(&nl, "lo"));
+
+  /* === 路由安装 === */
+  CHECK(0, count_routes(&nl, NS_TABLE, RTN_UNICAST));
+  CHECK(0, magic_dp_nl_route_default(&nl, NS_TABLE, "lo", NULL, false));
+  CHECK(1, count_routes(&nl, NS_TABLE, RTN_UNICAST));
+  CHECK(-EEXIST, magic_dp_nl_route_default(&nl, NS_TABLE, "lo", NULL, false));
+  CHECK(-ENODEV,
+        magic_dp_nl_route_default(&nl, NS_TABLE, "magic-none", NULL, false));
+
+  CHECK(0, magic_dp_nl_route_blackhole(&nl, NS_BLACKHOLE_TABLE));
+  CHECK(1, count_routes(&nl, NS_BLACKHOLE_TABLE, RTN_BLACKHOLE));
+
+  /* === 规则安装 === */
+  CHECK(0, count_rules(&nl, NS_CLIENT_IP, 0, NS_TABLE, NS_RULE_PRIO));
+  CHECK(0, magic_dp_nl_rule(&nl, true, NS_CLIENT_IP, 0, NS_TABLE,
+                            NS_RULE_PRIO));
+  CHECK(1, count_rules(&nl, NS_CLIENT_IP, 0, NS_TABLE, NS_RULE_PRIO));
+  CHECK(-EEXIST, magic_dp_nl_rule(&nl, true, NS_CLIENT_IP, 0, NS_TABLE,
+                                  NS_RULE_PRIO));
+
+  CHECK(0, magic_dp_nl_rule(&nl, true, NULL, NS_MARK, NS_TABLE, NS_MARK_PRIO));
+  CHECK(1, count_rules(&nl, NULL, NS_MARK, NS_TABLE, NS_MARK_PRIO));
+
+  /* === 规则移除 === */
+  /* 优先级区间之外的规则不被按源地址清理 */
+  CHECK(0, magic_dp_nl_rule_flush_src(&nl, NS_CLIENT_NET, NS_RULE_PRIO + 1,
+                                      NS_RULE_PRIO + 100));
+  CHECK(1, count_rules(&nl, NS_CLIENT_IP, 0, NS_TABLE, NS_RULE_PRIO));
+  CHECK(1, magic_dp_nl_rule_flush_src(&nl, NS_CLIENT_NET, NS_RULE_PRIO,
+                                      NS_RULE_PRIO));
+  CHECK(0, count_rules(&nl, NS_CLIENT_IP, 0, NS_TABLE, NS_RULE_PRIO));
+  CHECK(-ENOENT, magic_dp_nl_rule(&nl, false, NS_CLIENT_IP, 0, NS_TABLE,
+                                  NS_RULE_PRIO));
+
+  /* 单条删除 */
+  CHECK(0, magic_dp_nl_rule(&nl, true, NS_CLIENT_IP, 0, NS_TABLE,
+                            NS_RULE_PRIO));
+  CHECK(0, magic_dp_nl_rule(&nl, false, NS_CLIENT_IP, 0, NS_TABLE,
+                            NS_RULE_PRIO));
+  CHECK(0, count_rules(&nl, NS_CLIENT_IP, 0, NS_TABLE, NS_RULE_PRIO));
+
+  CHECK(1, magic_dp_nl_rule_flush_fwmark(&nl, NS_MARK, NS_MARK));
+  CHECK(0, count_rules(&nl, NULL, NS_MARK, NS_TABLE, NS_MARK_PRIO));
+
+  /* === 路由移除 === */
+  CHECK(1, magic_dp_nl_route_flush_table(&nl, NS_TABLE));
+  CHECK(0, count_routes(&nl, NS_TABLE, RTN_UNICAST));
+  CHECK(0, magic_dp_nl_route_flush_table(&nl, NS_TABLE));
+  CHECK(1, count_routes(&nl, NS_BLACKHOLE_TABLE, RTN_BLACKHOLE));
+  CHECK(1, magic_dp_nl_route_flush_table(&nl, NS_BLACKHOLE_TABLE));
+  CHECK(0, count_routes(&nl, NS_BLACKHOLE_TABLE, RTN_BLACKHOLE));
+
+  magic_dp_nl_close(&nl);
+  PASSTEST();
+}
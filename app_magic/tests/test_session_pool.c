@@ -0,0 +1,130 @@
+/**
+ * @file test_session_pool.c
+ * @brief 会话池与客户端上下文池 (magic_session) 的扩容测试。
+ * @details 直接编译 magic_session.c。以 500 客户端机队之上的规模验证:
+ *          - 600 个客户端各建一个会话: 客户端上下文与会话均按块扩容成功
+ *          - 扩容后已有会话地址不变，下标与指针互相换算一致
+ *          - 删除会话后槽位被复用，容量不再增长
+ *          - 扩容期间不加锁的遍历 (magic_session_capacity/at) 不越界
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include "magic_session.c"
+
+#define POOL_CLIENTS 600 /* 客户端数 (超过旧的 50 客户端/100 会话上限) */
+
+/*===========================================================================
+ * 假实现
+ *===========================================================================*/
+
+MagicContext g_magic_ctx;
+
+int magic_dataplane_remove_client_route(DataplaneContext *ctx,
+                                        const char *session_id) {
+  return 0;
+}
+
+int magic_flow_remove_session(MagicFlowClassifier *fc,
+                              const char *session_id) {
+  return 0;
+}
+
+/*===========================================================================
+ * 不加锁的遍历线程
+ *===========================================================================*/
+
+static SessionManager g_mgr;
+static volatile int g_stop;
+static unsigned long g_scans;
+
+static void *scanner_thread(void *arg) {
+  (void)arg;
+  while (!g_stop) {
+    int cap = magic_session_capacity(&g_mgr);
+    for (int i = 0; i < cap; i++)
+      CHECK(1, magic_session_at(&g_mgr, i) != NULL);
+    g_scans++;
+  }
+  return NULL;
+}
+
+int main(void) {
+  static ClientSession *created[POOL_CLIENTS];
+  char sid[64], cid[64];
+
+  CHECK(0, magic_session_init(&g_mgr));
+  CHECK(0, magic_session_capacity(&g_mgr));
+
+  pthread_t scanner;
+  CHECK(0, pthread_create(&scanner, NULL, scanner_thread, NULL));
+
+  /* 每个客户端一个会话，跨越多次扩容 */
+  for (int i = 0; i < POOL_CLIENTS; i++) {
+    snprintf(sid, sizeof(sid), "sess-%d", i);
+    snprintf(cid, sizeof(cid), "client-%d", i);
+    created[i] = magic_session_create(&g_mgr, sid, cid, "realm");
+    CHECK(1, created[i] != NULL);
+  }
+
+  g_stop = 1;
+  pthread_join(scanner, NULL);
+
+  CHECK(POOL_CLIENTS, g_mgr.session_count);
+  CHECK(POOL_CLIENTS, g_mgr.client_count);
+  int cap = magic_session_capacity(&g_mgr);
+  CHECK(1, cap >= POOL_CLIENTS);
+  CHECK(0, cap % MAGIC_SESSION_CHUNK);
+  CHECK(1, magic_session_at(&g_mgr, cap) == NULL);
+
+  /* 地址不变，下标与指针互相换算一致 */
+  for (int i = 0; i < POOL_CLIENTS; i++) {
+    snprintf(sid, sizeof(sid), "sess-%d", i);
+    snprintf(cid, sizeof(cid), "client-%d", i);
+    CHECK(1, magic_session_find_by_id(&g_mgr, sid) == created[i]);
+    CHECK_STR(sid, created[i]->session_id);
+    int idx = magic_session_index(&g_mgr, created[i]);
+    CHECK(1, idx >= 0);
+    CHECK(1, magic_session_at(&g_mgr, idx) == created[i]);
+
+    ClientContext *ctx = magic_client_context_find(&g_mgr, cid);
+    CHECK(1, ctx != NULL);
+    CHECK(1, ctx->active_session_count);
+    CHECK(idx, ctx->active_session_indices[0]);
+  }
+  ClientSession outside;
+  CHECK(-1, magic_session_index(&g_mgr, &outside));
+
+  /* 删除一半会话后重建: 槽位复用，容量不变 */
+  for (int i = 0; i < POOL_CLIENTS; i += 2) {
+    snprintf(sid, sizeof(sid), "sess-%d", i);
+    CHECK(0, magic_session_delete(&g_mgr, sid));
+  }
+  CHECK(POOL_CLIENTS / 2, g_mgr.session_count);
+  for (int i = 0; i < POOL_CLIENTS; i += 2) {
+    snprintf(sid, sizeof(sid), "sess-again-%d", i);
+    snprintf(cid, sizeof(cid), "client-%d", i);
+    CHECK(1, magic_session_create(&g_mgr, sid, cid, "realm") != NULL);
+  }
+  CHECK(cap, magic_session_capacity(&g_mgr));
+  CHECK(POOL_CLIENTS, g_mgr.client_count);
+
+  /* 遍历接口按容量返回全部活动会话 */
+  for (int i = 0; i < cap; i++) {
+    ClientSession *s = magic_session_at(&g_mgr, i);
+    if (s->in_use)
+      magic_session_set_state(s, SESSION_STATE_ACTIVE);
+  }
+  ClientSession **active = calloc((size_t)cap, sizeof(*active));
+  CHECK(POOL_CLIENTS,
+        magic_session_get_active_sessions(&g_mgr, active, cap));
+  free(active);
+
+  printf("%d sessions / %d clients, session capacity %d, %lu unlocked scans\n",
+         g_mgr.session_count, g_mgr.client_count, cap, g_scans);
+  magic_session_cleanup(&g_mgr);
+  PASSTEST();
+}
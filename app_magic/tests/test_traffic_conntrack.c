@@ -0,0 +1,238 @@
+/**
+ * @file test_traffic_conntrack.c
+ * @brief 流量监控 conntrack 后端按连接求增量的计数校验。
+ * @details 直接编译 magic_traffic_monitor.c，以假 libnetfilter_conntrack
+ *          提供连接表，假 system() 截获防火墙命令。验证:
+ *          - 刷新使用不清零的 NFCT_Q_DUMP_FILTER，而非 ..._FILTER_RESET
+ *          - 连续 dump 只累加每条连接自上次读取以来的增量
+ *          - DESTROY 事件只结算最后一段增量并移除读数；从未被 dump 到的
+ *            连接按全量计入
+ *          - 未收到 DESTROY 的连接在连续两次 dump 缺席后被回收
+ *          - 读数表从初始容量倍增到数千条连接后计数仍准确
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+/* 截获被测模块的 system() 调用 */
+#define system fake_system
+int fake_system(const char *cmd);
+#include "magic_traffic_monitor.c"
+#undef system
+
+#define CT_MAX_CONNS 4096 /* 假连接表容量 */
+#define CT_MANY 3000      /* 扩容场景的连接数 */
+
+int fake_system(const char *cmd) { return 0; }
+
+/*===========================================================================
+ * 假 libnetfilter_conntrack
+ *===========================================================================*/
+
+struct nf_conntrack {
+  uint64_t attr[ATTR_MAX]; ///< 属性值。
+  bool set[ATTR_MAX];      ///< 属性是否存在。
+};
+
+static struct nf_conntrack g_table[CT_MAX_CONNS]; /* 内核中的存活连接 */
+static int g_nconns;
+static enum nf_conntrack_query g_last_query;
+static int (*g_dump_cb)(enum nf_conntrack_msg_type, struct nf_conntrack *,
+                        void *);
+static void *g_dump_data;
+
+int nfct_attr_is_set(const struct nf_conntrack *ct,
+                     const enum nf_conntrack_attr type) {
+  return ct->set[type];
+}
+
+uint8_t nfct_get_attr_u8(const struct nf_conntrack *ct,
+                         const enum nf_conntrack_attr type) {
+  return (uint8_t)ct->attr[type];
+}
+
+uint16_t nfct_get_attr_u16(const struct nf_conntrack *ct,
+                           const enum nf_conntrack_attr type) {
+  return (uint16_t)ct->attr[type];
+}
+
+uint32_t nfct_get_attr_u32(const struct nf_conntrack *ct,
+                           const enum nf_conntrack_attr type) {
+  return (uint32_t)ct->attr[type];
+}
+
+uint64_t nfct_get_attr_u64(const struct nf_conntrack *ct,
+                           const enum nf_conntrack_attr type) {
+  return ct->attr[type];
+}
+
+struct nfct_handle *nfct_open(uint8_t subsys_id, unsigned subscriptions) {
+  return NULL;
+}
+
+int nfct_close(struct nfct_handle *h) { return 0; }
+
+int nfct_fd(struct nfct_handle *h) { return -1; }
+
+int nfct_callback_register(struct nfct_handle *h,
+                           enum nf_conntrack_msg_type type,
+                           int (*cb)(enum nf_conntrack_msg_type type,
+                                     struct nf_conntrack *ct, void *data),
+                           void *data) {
+  g_dump_cb = cb;
+  g_dump_data = data;
+  return 0;
+}
+
+int nfct_catch(struct nfct_handle *h) { return 0; }
+
+/* 内核按 mark 过滤后逐条回调 */
+int nfct_query(struct nfct_handle *h, const enum nf_conntrack_query query,
+               const void *data) {
+  g_last_query = query;
+  for (int i = 0; i < g_nconns; i++) {
+    if ((g_table[i].attr[ATTR_MARK] & TRAFFIC_MARK_MASK) == TRAFFIC_MARK_BASE)
+      g_dump_cb(NFCT_T_UNKNOWN, &g_table[i], g_dump_data);
+  }
+  return 0;
+}
+
+struct nfct_filter *nfct_filter_create(void) { return NULL; }
+
+void nfct_filter_destroy(struct nfct_filter *filter) {}
+
+void nfct_filter_add_attr(struct nfct_filter *filter,
+                          const enum nfct_filter_attr attr, const void *value) {
+}
+
+int nfct_filter_attach(int fd, struct nfct_filter *filter) { return 0; }
+
+struct nfct_filter_dump *nfct_filter_dump_create(void) {
+  static char dummy;
+  return (struct nfct_filter_dump *)&dummy;
+}
+
+void nfct_filter_dump_destroy(struct nfct_filter_dump *filter) {}
+
+void nfct_filter_dump_set_attr(struct nfct_filter_dump *filter,
+                               const enum nfct_filter_dump_attr type,
+                               const void *data) {}
+
+/*===========================================================================
+ * 辅助
+ *===========================================================================*/
+
+static TrafficMonitorContext g_ctx;
+
+static void ct_set(struct nf_conntrack *ct, enum nf_conntrack_attr type,
+                   uint64_t v) {
+  ct->attr[type] = v;
+  ct->set[type] = true;
+}
+
+/* 追加一条计数为零的存活连接 */
+static struct nf_conntrack *ct_add(uint32_t id, uint32_t mark) {
+  struct nf_conntrack *ct = &g_table[g_nconns++];
+  memset(ct, 0, sizeof(*ct));
+  ct_set(ct, ATTR_ID, id);
+  ct_set(ct, ATTR_MARK, mark);
+  ct_set(ct, ATTR_ORIG_COUNTER_BYTES, 0);
+  ct_set(ct, ATTR_ORIG_COUNTER_PACKETS, 0);
+  ct_set(ct, ATTR_REPL_COUNTER_BYTES, 0);
+  ct_set(ct, ATTR_REPL_COUNTER_PACKETS, 0);
+  return ct;
+}
+
+/* 内核侧计数增长 */
+static void ct_traffic(struct nf_conntrack *ct, uint64_t bytes_in,
+                       uint64_t bytes_out) {
+  ct->attr[ATTR_ORIG_COUNTER_BYTES] += bytes_in;
+  ct->attr[ATTR_ORIG_COUNTER_PACKETS]++;
+  ct->attr[ATTR_REPL_COUNTER_BYTES] += bytes_out;
+  ct->attr[ATTR_REPL_COUNTER_PACKETS]++;
+}
+
+/* 连接结束: 从连接表摘除并投递 DESTROY 事件 (携带最终计数) */
+static void ct_destroy(int pos) {
+  struct nf_conntrack ct = g_table[pos];
+  g_table[pos] = g_table[--g_nconns];
+  destroy_callback(NFCT_T_DESTROY, &ct, &g_ctx);
+}
+
+static void expect_stats(const char *sid, uint64_t in, uint64_t out) {
+  CHECK(0, traffic_refresh_stats(&g_ctx));
+  CHECK(NFCT_Q_DUMP_FILTER, g_last_query);
+  TrafficStats st;
+  CHECK(0, traffic_get_session_stats(&g_ctx, sid, &st));
+  CHECK(in, st.bytes_in);
+  CHECK(out, st.bytes_out);
+}
+
+int main(void) {
+  /* conntrack 后端，不启动事件线程 (DESTROY 直接调用回调) */
+  CHECK(0, traffic_monitor_init(&g_ctx, TRAFFIC_BACKEND_IPTABLES));
+  g_ctx.netlink_available = true;
+  g_ctx.nfct_handle = (void *)&g_ctx;
+  nfct_callback_register(NULL, NFCT_T_ALL, dump_callback, &g_ctx);
+
+  uint32_t mark = traffic_register_session(&g_ctx, "sess;1", "client-1",
+                                           "192.168.10.1");
+  CHECK(1, mark != 0);
+
+  /* 两条连接，连续刷新只累加增量 */
+  struct nf_conntrack *a = ct_add(101, mark);
+  struct nf_conntrack *b = ct_add(102, mark);
+  ct_traffic(a, 100, 200);
+  ct_traffic(b, 10, 0);
+  expect_stats("sess;1", 110, 200);
+  expect_stats("sess;1", 110, 200);
+  ct_traffic(a, 50, 60);
+  expect_stats("sess;1", 160, 260);
+  CHECK(2, g_ctx.conn_count);
+
+  /* 其他 mark 的连接不计入 */
+  ct_traffic(ct_add(103, 0x42), 999, 999);
+  expect_stats("sess;1", 160, 260);
+  g_nconns--;
+
+  /* b 结束: DESTROY 只结算上次读取之后的 30 字节 */
+  ct_traffic(b, 30, 0);
+  ct_destroy(1);
+  CHECK(1, g_ctx.conn_count);
+  expect_stats("sess;1", 190, 260);
+
+  /* 从未被 dump 到的短连接: DESTROY 按全量计入 */
+  struct nf_conntrack *c = ct_add(104, mark);
+  ct_traffic(c, 5, 7);
+  ct_destroy(1);
+  expect_stats("sess;1", 195, 267);
+
+  /* a 未收到 DESTROY 就消失: 第一次 dump 缺席保留，第二次回收 */
+  g_nconns = 0;
+  expect_stats("sess;1", 195, 267);
+  CHECK(1, g_ctx.conn_count);
+  expect_stats("sess;1", 195, 267);
+  CHECK(0, g_ctx.conn_count);
+  CHECK(1, g_ctx.total_conn_expired);
+
+  /* 数千条连接: 读数表倍增后增量仍准确 */
+  for (uint32_t i = 0; i < CT_MANY; i++)
+    ct_traffic(ct_add(1000 + i * 7919, mark), 1, 2);
+  expect_stats("sess;1", 195 + CT_MANY, 267 + 2 * CT_MANY);
+  CHECK(CT_MANY, g_ctx.conn_count);
+  CHECK(1, g_ctx.conn_capacity >= CT_MANY);
+  for (int i = 0; i < g_nconns; i += 2)
+    ct_traffic(&g_table[i], 1, 1);
+  expect_stats("sess;1", 195 + CT_MANY + CT_MANY / 2,
+               267 + 2 * CT_MANY + CT_MANY / 2);
+  while (g_nconns > 0)
+    ct_destroy(g_nconns - 1);
+  CHECK(0, g_ctx.conn_count);
+  expect_stats("sess;1", 195 + CT_MANY + CT_MANY / 2,
+               267 + 2 * CT_MANY + CT_MANY / 2);
+
+  traffic_monitor_cleanup(&g_ctx);
+  PASSTEST();
+}
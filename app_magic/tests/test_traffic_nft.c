@@ -0,0 +1,141 @@
+/**
+ * @file test_traffic_nft.c
+ * @brief 流量监控 nftables 计数器后端下发的 nft 命令校验。
+ * @details 直接编译 magic_traffic_monitor.c，以假 system() 截获命令而不执行。
+ *          验证:
+ *          - 计数表 inet magic_acct、acct_in/acct_out 映射 (mark → counter)
+ *            与 prerouting 计数链 (优先级 -140) 的定义
+ *          - 计数链位于打标链 (inet magic prerouting) 之后
+ *          - 注册/注销 mark 时计数器与映射元素的增删顺序
+ *          以 root 运行且系统有 nft 时，再把全部脚本合成一个批次交给
+ *          `nft -c` 做语法与语义检查 (只检查不提交)。
+ *
+ * @author MAGIC System Development Team
+ * @date 2026-10-18
+ */
+
+#include "magic_tests.h"
+
+#include <unistd.h>
+
+/* 截获被测模块的 system() 调用 */
+#define system fake_system
+int fake_system(const char *cmd);
+#include "magic_traffic_monitor.c"
+#undef system
+
+#define MAX_CMDS 16
+
+static char g_cmds[MAX_CMDS][1024];
+static int g_ncmds;
+
+int fake_system(const char *cmd) {
+  if (g_ncmds < MAX_CMDS) {
+    snprintf(g_cmds[g_ncmds++], sizeof(g_cmds[0]), "%s", cmd);
+  }
+  return 0;
+}
+
+/* 取最后一条包含 needle 的命令 */
+static const char *find_cmd(const char *needle) {
+  for (int i = g_ncmds; i > 0; i--) {
+    if (strstr(g_cmds[i - 1], needle))
+      return g_cmds[i - 1];
+  }
+  fprintf(stderr, "no command contains \"%s\"\n", needle);
+  exit(1);
+}
+
+#define CHECK_HAS(_cmd, _needle) CHECK(1, strstr((_cmd), (_needle)) != NULL)
+
+/* 取 "priority N;" 中的 N */
+static int chain_priority(const char *cmd) {
+  const char *p = strstr(cmd, "priority ");
+  CHECK(1, p != NULL);
+  return atoi(p + strlen("priority "));
+}
+
+/* 取单引号内的 nft 脚本 */
+static void script_of(const char *cmd, char *out, size_t len) {
+  const char *b = strchr(cmd, '\'');
+  const char *e = b ? strchr(b + 1, '\'') : NULL;
+  CHECK(1, b != NULL && e != NULL);
+  snprintf(out, len, "%.*s", (int)(e - b - 1), b + 1);
+}
+
+static int quote_count(const char *cmd) {
+  int n = 0;
+  for (; *cmd; cmd++)
+    n += *cmd == '\'';
+  return n;
+}
+
+int main(void) {
+  /* 计数表、映射与计数链 */
+  CHECK(0, nft_acct_setup_table());
+  const char *setup = find_cmd("add map");
+  CHECK(2, quote_count(setup));
+  CHECK_HAS(setup, "add table inet magic_acct;");
+  CHECK_HAS(setup, "delete table inet magic_acct;");
+  CHECK_HAS(setup, "add map inet magic_acct acct_in { type mark : counter; }");
+  CHECK_HAS(setup,
+            "add map inet magic_acct acct_out { type mark : counter; }");
+  CHECK_HAS(setup, "add chain inet magic_acct acct { type filter hook "
+                   "prerouting priority -140; policy accept; }");
+  CHECK_HAS(setup, "ct direction original counter name ct mark map @acct_in");
+  CHECK_HAS(setup, "ct direction reply counter name ct mark map @acct_out");
+  CHECK(-140, chain_priority(setup));
+
+  /* 打标链先于计数链: 首包在计数前已带 ct mark */
+  CHECK(0, add_nftables_rule("192.168.126.10", 0x101));
+  const char *mark_chain = find_cmd("add chain inet magic prerouting");
+  CHECK(1, chain_priority(mark_chain) < chain_priority(setup));
+  CHECK_HAS(find_cmd("ip saddr 192.168.126.10"), "ct mark set 0x101");
+
+  /* 注册: 先建计数器再加映射元素 */
+  CHECK(0, nft_acct_add_mark(0x101));
+  const char *add = find_cmd("add counter");
+  CHECK(2, quote_count(add));
+  CHECK_HAS(add, "add counter inet magic_acct m101_in;");
+  CHECK_HAS(add, "add counter inet magic_acct m101_out;");
+  CHECK_HAS(add, "add element inet magic_acct acct_in { 0x101 : \"m101_in\" }");
+  CHECK_HAS(add,
+            "add element inet magic_acct acct_out { 0x101 : \"m101_out\" }");
+  CHECK(1, strstr(add, "add counter") < strstr(add, "add element"));
+
+  /* 注销: 映射仍引用计数器时不能删除，须先删元素 */
+  CHECK(0, nft_acct_del_mark(0x101));
+  const char *del = find_cmd("delete counter");
+  CHECK(2, quote_count(del));
+  CHECK_HAS(del, "delete element inet magic_acct acct_in { 0x101 }");
+  CHECK_HAS(del, "delete element inet magic_acct acct_out { 0x101 }");
+  CHECK_HAS(del, "delete counter inet magic_acct m101_in");
+  CHECK_HAS(del, "delete counter inet magic_acct m101_out");
+  CHECK(1, strstr(del, "delete element") < strstr(del, "delete counter"));
+
+  /* 有 nft 且为 root 时做一次完整的 nft -c 检查 */
+  if (geteuid() == 0 && system("nft --version > /dev/null 2>&1") == 0) {
+    char path[] = "/tmp/magic_nft_check.XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(1, fd >= 0);
+    FILE *f = fdopen(fd, "w");
+    const char *scripts[] = {setup, add, del};
+    for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+      char script[1024];
+      script_of(scripts[i], script, sizeof(script));
+      fprintf(f, "%s\n", script);
+    }
+    fclose(f);
+
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "nft -c -f %s", path);
+    int ret = system(cmd);
+    unlink(path);
+    CHECK(0, ret);
+    printf("nft -c: ruleset accepted\n");
+  } else {
+    printf("nft -c: skipped (needs root and nft)\n");
+  }
+
+  PASSTEST();
+}
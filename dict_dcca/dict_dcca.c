@@ -1485,3 +1485,4 @@ static int dict_dcca_entry(char * conffile)
 
 /* needs dict_nasreq for Filter-Id */
 EXTENSION_ENTRY("dict_dcca", dict_dcca_entry, "dict_nasreq");
+EXTENSION_PARALLEL_INIT();
@@ -1042,3 +1042,4 @@ static int dict_dcca_3gpp_entry(char * conffile)
 }
 
 EXTENSION_ENTRY("dict_dcca_3gpp", dict_dcca_3gpp_entry, "dict_dcca");
+EXTENSION_PARALLEL_INIT();
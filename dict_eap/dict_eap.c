@@ -517,3 +517,4 @@ static int deap_entry(char * conffile)
 }
 
 EXTENSION_ENTRY("dict_eap", deap_entry, "dict_nasreq");
+EXTENSION_PARALLEL_INIT();
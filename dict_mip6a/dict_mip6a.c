@@ -1092,3 +1092,4 @@ int dict_mip6a_init(char * conffile)
 	return 0;
 }
 EXTENSION_ENTRY("dict_mip6a", dict_mip6a_init, "dict_rfc5777");
+EXTENSION_PARALLEL_INIT();
@@ -1135,3 +1135,4 @@ int dict_mip6i_init(char * conffile)
 	return 0;
 }
 EXTENSION_ENTRY("dict_mip6i", dict_mip6i_init, "dict_rfc5777");
+EXTENSION_PARALLEL_INIT();
@@ -256,3 +256,4 @@ int dict_nas_mipv6_init(char * conffile)
 	return 0;
 }
 EXTENSION_ENTRY("dict_nas_mipv6", dict_nas_mipv6_init);
+EXTENSION_PARALLEL_INIT();
@@ -3733,3 +3733,4 @@ static int dnr_entry(char * conffile)
 }
 
 EXTENSION_ENTRY("dict_nasreq", dnr_entry);
+EXTENSION_PARALLEL_INIT();
@@ -2136,3 +2136,4 @@ int dict_rfc5777_init(char * conffile)
 	return 0;
 }
 EXTENSION_ENTRY("dict_rfc5777", dict_rfc5777_init);
+EXTENSION_PARALLEL_INIT();
@@ -2950,3 +2950,4 @@ int ds_dict_init(char * conffile)
 	return 0;
 }
 EXTENSION_ENTRY("dict_sip", ds_dict_init);
+EXTENSION_PARALLEL_INIT();
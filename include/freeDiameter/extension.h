@@ -68,6 +68,14 @@ int fd_ext_init(int major, int minor, char * conffile) {				\
 	return (_function)(conffile);							\
 }
 
+/* Optional marker: the extension's init only performs thread-safe operations (typically
+ fd_dict_new / fd_dict_search) and needs nothing loaded before it except the extensions
+ listed in EXTENSION_ENTRY. The daemon may then run it concurrently with other such
+ extensions; extensions without the marker are always initialized alone, in order. */
+#define EXTENSION_PARALLEL_INIT()							\
+__attribute__((visibility("default")))							\
+const int fd_ext_parallel_init = 1
+
 /* Optional exit point (finish function) of the extension */
 __attribute__((visibility("default")))
 void fd_ext_fini(void);
@@ -37,6 +37,7 @@
 
 #include <dlfcn.h>	/* We may use libtool's <ltdl.h> later for better portability.... */
 #include <libgen.h>	/* for "basename" */
+#include <unistd.h>	/* for "sysconf" */
 
 /* plugins management */
 
@@ -50,11 +51,20 @@ struct fd_ext_info {
 	char		*ext_name;	/* points to the extension name, either inside depends, or basename(filename) */
 	int		free_ext_name;	/* must be freed if it was malloc'd */
 	void		(*fini)(void);	/* optional address of the fd_ext_fini callback */
+	int		(*init)(int, int, char *); /* address of the fd_ext_init entry point */
+	int		parallel;	/* the extension exports fd_ext_parallel_init */
+	int		running;	/* init is in progress in init_thr */
+	pthread_t	init_thr;	/* thread running init, for parallel extensions */
+	int		init_ret;	/* value returned by init */
 };
 
 /* list of extensions */
 static struct fd_list ext_list = FD_LIST_INITIALIZER(ext_list);
 
+/* parallel initializations in progress, and the limit (number of online processors) */
+static long ext_running = 0;
+static long ext_max_running = 1;
+
 /* Add new extension */
 int fd_ext_add( char * filename, char * conffile )
 {
@@ -144,19 +154,126 @@ static int check_dependencies(struct fd_ext_info * ext)
 	return 0;
 }
 
+/* Thread running the entry point of a parallel extension */
+static void * ext_init_thread(void * arg)
+{
+	struct fd_ext_info * ext = arg;
+	char buf[48];
+	
+	snprintf(buf, sizeof(buf), "Init %s", ext->ext_name);
+	fd_log_threadname ( buf );
+	
+	ext->init_ret = (*ext->init)( FD_PROJECT_VERSION_MAJOR, FD_PROJECT_VERSION_MINOR, ext->conffile );
+	return NULL;
+}
+
+/* Wait for the init of an extension running in parallel, return its result */
+static int ext_init_wait(struct fd_ext_info * ext)
+{
+	if (!ext->running)
+		return 0;
+	
+	CHECK_POSIX( pthread_join(ext->init_thr, NULL) );
+	ext->running = 0;
+	ext_running--;
+	if (ext->init_ret != 0) {
+		TRACE_ERROR("Extension %s returned an error during initialization: %s", ext->filename, strerror(ext->init_ret));
+	}
+	return ext->init_ret;
+}
+
+/* Wait for all extensions before 'upto' (excluded) still initializing; return the first error */
+static int ext_init_wait_all(struct fd_list * upto)
+{
+	struct fd_list * li;
+	int ret = 0, r;
+	
+	for (li = ext_list.next; li != upto; li = li->next) {
+		r = ext_init_wait((struct fd_ext_info *)li);
+		if (r && !ret)
+			ret = r;
+	}
+	return ret;
+}
+
+/* Wait for the oldest parallel initialization still in progress */
+static int ext_init_wait_oldest(void)
+{
+	struct fd_list * li;
+	
+	for (li = ext_list.next; li != &ext_list; li = li->next) {
+		struct fd_ext_info * e = (struct fd_ext_info *)li;
+		if (e->running)
+			return ext_init_wait(e);
+	}
+	return 0;
+}
+
+/* Wait for the declared dependencies of a parallel extension (check_dependencies found them already) */
+static int ext_init_wait_depends(struct fd_ext_info * ext)
+{
+	int i;
+	struct fd_list * li;
+	
+	for (i = 1; ext->depends[i]; i++) {
+		for (li = ext_list.next; li != &ext->chain; li = li->next) {
+			struct fd_ext_info * e = (struct fd_ext_info *)li;
+			if (!strcasecmp(e->ext_name, ext->depends[i])) {
+				CHECK_FCT( ext_init_wait(e) );
+			}
+		}
+	}
+	return 0;
+}
+
+/* Initialize one extension. Extensions exporting fd_ext_parallel_init are started in their own thread
+  as soon as their declared dependencies are initialized; all others run alone in this thread, after
+  every extension before them in the configuration has finished. */
+static int ext_init(struct fd_ext_info * ext)
+{
+	int ret;
+	
+	if (ext->parallel) {
+		CHECK_FCT( ext_init_wait_depends(ext) );
+		while (ext_running >= ext_max_running) {
+			CHECK_FCT( ext_init_wait_oldest() );
+		}
+		TRACE_DEBUG (FULL, "Initializing [%s] in parallel.", ext->ext_name);
+		CHECK_POSIX( pthread_create(&ext->init_thr, NULL, ext_init_thread, ext) );
+		ext->running = 1;
+		ext_running++;
+		return 0;
+	}
+	
+	CHECK_FCT( ext_init_wait_all(&ext->chain) );
+	
+	ret = (*ext->init)( FD_PROJECT_VERSION_MAJOR, FD_PROJECT_VERSION_MINOR, ext->conffile );
+	if (ret != 0) {
+		/* The extension was unable to load cleanly */
+		TRACE_ERROR("Extension %s returned an error during initialization: %s", ext->filename, strerror(ret));
+	}
+	return ret;
+}
+
 /* Load all extensions in the list */
 int fd_ext_load()
 {
-	int ret;
-	int (*fd_ext_init)(int, int, char *) = NULL;
+	int ret = 0, r;
+	int nb_parallel = 0;
 	struct fd_list * li;
 	
 	TRACE_ENTRY();
 	
+	/* Concurrent initializations only pay off with several processors: they all take the dictionary lock */
+	ext_max_running = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ext_max_running < 1)
+		ext_max_running = 1;
+	
 	/* Loop on all extensions */
 	for (li = ext_list.next; li != &ext_list; li = li->next)
 	{
 		struct fd_ext_info * ext = (struct fd_ext_info *)li;
+		const int * parallel;
 		LOG_D( "Loading : %s", ext->filename);
 		
 		/* Load the extension */
@@ -171,19 +288,21 @@ int fd_ext_load()
 					LOG_F("In addition, not all declared dependencies are satisfied (Internal Error!)");
 				}
 			}
-			return EINVAL;
+			ret = EINVAL;
+			break;
 		}
 		
 		/* Check if declared dependencies are satisfied. */
-		CHECK_FCT( check_dependencies(ext) );
+		CHECK_FCT_DO( ret = check_dependencies(ext), break );
 		
 		/* Resolve the entry point of the extension */
-		fd_ext_init = ( int (*) (int, int, char *) )dlsym( ext->handler, "fd_ext_init" );
+		ext->init = ( int (*) (int, int, char *) )dlsym( ext->handler, "fd_ext_init" );
 		
-		if (fd_ext_init == NULL) {
+		if (ext->init == NULL) {
 			/* An error occurred */
 			TRACE_ERROR("Unable to resolve symbol 'fd_ext_init' for extension %s: %s", ext->filename, dlerror());
-			return EINVAL;
+			ret = EINVAL;
+			break;
 		}
 		
 		/* Resolve the exit point of the extension, which is optional for extensions */
@@ -197,18 +316,31 @@ int fd_ext_load()
 			TRACE_DEBUG (FULL, "Extension [%s] fd_ext_fini has been resolved successfully.", ext->filename);
 		}
 		
+		/* Can the entry point run concurrently with other extensions? (optional, requires the dependencies API) */
+		parallel = dlsym( ext->handler, "fd_ext_parallel_init" );
+		ext->parallel = (parallel && *parallel && ext->depends && ext_max_running > 1) ? 1 : 0;
+		nb_parallel += ext->parallel;
+		
 		/* Now call the entry point to initialize the extension */
-		ret = (*fd_ext_init)( FD_PROJECT_VERSION_MAJOR, FD_PROJECT_VERSION_MINOR, ext->conffile );
-		if (ret != 0) {
-			/* The extension was unable to load cleanly */
-			TRACE_ERROR("Extension %s returned an error during initialization: %s", ext->filename, strerror(ret));
-			return ret;
-		}
+		ret = ext_init(ext);
+		if (ret != 0)
+			break;
 		
 		/* Proceed to the next extension */
 	}
+	
+	/* Parallel initializations must be over before we return, even on error */
+	r = ext_init_wait_all(&ext_list);
+	if (ret)
+		return ret;
+	if (r)
+		return r;
 
-	LOG_N("All extensions loaded.");
+	if (nb_parallel) {
+		LOG_N("All extensions loaded (%d initialized in parallel).", nb_parallel);
+	} else {
+		LOG_N("All extensions loaded.");
+	}
 	
 	/* We have finished. */
 	return 0;
@@ -432,6 +432,122 @@ static int parse_whitelist_port_range(const char *port_range_str, PortRange *ran
     return 0;
 }
 
+/*===========================================================================
+ * 白名单预编译
+ *===========================================================================*/
+
+static inline void proto_bitmap_set(uint32_t *bitmap, uint8_t proto) {
+    bitmap[proto >> 5] |= 1u << (proto & 31);
+}
+
+static inline bool proto_bitmap_test(const uint32_t *bitmap, uint8_t proto) {
+    return (bitmap[proto >> 5] & (1u << (proto & 31))) != 0;
+}
+
+/**
+ * @brief 将 allowed_tfts[] 解析为紧凑匹配表
+ * @param whitelist 白名单配置
+ * @param matcher 输出的匹配器
+ * @return 有效条目数
+ */
+static int tft_matcher_build(const TrafficSecurityConfig *whitelist,
+                             TftWhitelistMatcher *matcher) {
+    memset(matcher, 0, sizeof(*matcher));
+
+    uint32_t n = whitelist->num_allowed_tfts;
+    if (n > MAX_ALLOWED_TFTS) {
+        n = MAX_ALLOWED_TFTS;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        TFTRule wl;
+        if (tft_parse_rule(whitelist->allowed_tfts[i], &wl) != 0 || !wl.is_valid) {
+            fd_log_debug("[tft_validator] Skipping invalid whitelist entry [%u]: %s",
+                        i + 1, whitelist->allowed_tfts[i]);
+            matcher->num_invalid++;
+            continue;
+        }
+
+        TftMatchRule *r = &matcher->rules[matcher->num_rules++];
+        r->index = (uint16_t)i;
+        r->protocol = (wl.has_protocol) ? wl.protocol : 0;
+
+        if (wl.src_ip.is_valid) {
+            r->flags |= TFT_MATCH_HAS_SRC_IP;
+            r->src_ip_start = wl.src_ip.start_ip;
+            r->src_ip_end = wl.src_ip.end_ip;
+        }
+        if (wl.dst_ip.is_valid) {
+            r->flags |= TFT_MATCH_HAS_DST_IP;
+            r->dst_ip_start = wl.dst_ip.start_ip;
+            r->dst_ip_end = wl.dst_ip.end_ip;
+        }
+
+        /* 0.65535 表示任意端口，匹配时直接跳过 */
+        r->dst_port_start = wl.dst_port.start_port;
+        r->dst_port_end = wl.dst_port.end_port;
+        if (!wl.dst_port.is_valid ||
+            (wl.dst_port.start_port == 0 && wl.dst_port.end_port == 65535)) {
+            r->flags |= TFT_MATCH_ANY_DST_PORT;
+        }
+        r->src_port_start = wl.src_port.start_port;
+        r->src_port_end = wl.src_port.end_port;
+        if (!wl.src_port.is_valid ||
+            (wl.src_port.start_port == 0 && wl.src_port.end_port == 65535)) {
+            r->flags |= TFT_MATCH_ANY_SRC_PORT;
+        }
+
+        if (r->protocol == 0) {
+            memset(matcher->proto_bitmap, 0xFF, sizeof(matcher->proto_bitmap));
+        } else {
+            proto_bitmap_set(matcher->proto_bitmap, r->protocol);
+        }
+    }
+
+    matcher->compiled = true;
+    return (int)matcher->num_rules;
+}
+
+int tft_whitelist_compile(TrafficSecurityConfig *whitelist) {
+    if (!whitelist) {
+        return -1;
+    }
+    return tft_matcher_build(whitelist, &whitelist->tft_matcher);
+}
+
+/**
+ * @brief 检查请求TFT是否落在单条预编译白名单条目内
+ */
+static bool tft_match_rule(const TftMatchRule *r, const TFTRule *req) {
+    if (r->protocol != 0 && req->protocol != r->protocol) {
+        return false;
+    }
+
+    if ((r->flags & TFT_MATCH_HAS_SRC_IP) && req->src_ip.is_valid &&
+        (req->src_ip.start_ip < r->src_ip_start || req->src_ip.end_ip > r->src_ip_end)) {
+        return false;
+    }
+
+    if ((r->flags & TFT_MATCH_HAS_DST_IP) && req->dst_ip.is_valid &&
+        (req->dst_ip.start_ip < r->dst_ip_start || req->dst_ip.end_ip > r->dst_ip_end)) {
+        return false;
+    }
+
+    if (!(r->flags & TFT_MATCH_ANY_DST_PORT) && req->dst_port.is_valid &&
+        (req->dst_port.start_port < r->dst_port_start ||
+         req->dst_port.end_port > r->dst_port_end)) {
+        return false;
+    }
+
+    if (!(r->flags & TFT_MATCH_ANY_SRC_PORT) && req->src_port.is_valid &&
+        (req->src_port.start_port < r->src_port_start ||
+         req->src_port.end_port > r->src_port_end)) {
+        return false;
+    }
+
+    return true;
+}
+
 /**
  * @brief 验证TFT规则是否在白名单中（精确匹配）
  * 
@@ -491,82 +607,41 @@ int tft_validate_against_whitelist(
                  request_rule.dst_port.start_port, request_rule.dst_port.end_port,
                  request_rule.protocol);
     
-    /* ★★★ 遍历白名单，进行语义范围验证 ★★★ */
-    for (uint32_t i = 0; i < whitelist->num_allowed_tfts; i++) {
-        TFTRule whitelist_rule;
-        if (tft_parse_rule(whitelist->allowed_tfts[i], &whitelist_rule) != 0) {
-            fd_log_debug("[tft_validator] Skipping invalid whitelist entry [%u]: %s", 
-                        i+1, whitelist->allowed_tfts[i]);
-            continue;
-        }
-        
-        fd_log_debug("[tft_validator] Checking against whitelist[%u]: src_port=%u-%u, dst_port=%u-%u",
-                     i+1, whitelist_rule.src_port.start_port, whitelist_rule.src_port.end_port,
-                     whitelist_rule.dst_port.start_port, whitelist_rule.dst_port.end_port);
-        
-        /* 检查协议是否匹配 */
-        if (whitelist_rule.has_protocol && whitelist_rule.protocol != 0) {
-            if (request_rule.protocol != whitelist_rule.protocol) {
-                fd_log_debug("[tft_validator]   ✗ Protocol mismatch: req=%u, wl=%u",
-                            request_rule.protocol, whitelist_rule.protocol);
-                continue;
-            }
+    /* ★★★ 使用预编译的白名单进行语义范围验证 ★★★ */
+    const TftWhitelistMatcher *matcher = &whitelist->tft_matcher;
+    TftWhitelistMatcher *scratch = NULL;
+    if (!matcher->compiled) {
+        /* 未经配置加载流程的白名单：临时编译，不写回 */
+        scratch = malloc(sizeof(*scratch));
+        if (!scratch) {
+            snprintf(error_msg, error_msg_len, "Out of memory compiling TFT whitelist");
+            return -2;
         }
-        
-        /* 检查源IP是否在白名单范围内 */
-        if (whitelist_rule.src_ip.is_valid && request_rule.src_ip.is_valid) {
-            if (request_rule.src_ip.start_ip < whitelist_rule.src_ip.start_ip ||
-                request_rule.src_ip.end_ip > whitelist_rule.src_ip.end_ip) {
-                fd_log_debug("[tft_validator]   ✗ Source IP out of range");
-                continue;
-            }
-        }
-        
-        /* 检查目标IP是否在白名单范围内 */
-        if (whitelist_rule.dst_ip.is_valid && request_rule.dst_ip.is_valid) {
-            if (request_rule.dst_ip.start_ip < whitelist_rule.dst_ip.start_ip ||
-                request_rule.dst_ip.end_ip > whitelist_rule.dst_ip.end_ip) {
-                fd_log_debug("[tft_validator]   ✗ Destination IP out of range");
+        tft_matcher_build(whitelist, scratch);
+        matcher = scratch;
+    }
+
+    if (proto_bitmap_test(matcher->proto_bitmap, request_rule.protocol)) {
+        for (uint32_t i = 0; i < matcher->num_rules; i++) {
+            const TftMatchRule *r = &matcher->rules[i];
+            if (!tft_match_rule(r, &request_rule)) {
                 continue;
             }
+
+            /* 所有条件通过 */
+            fd_log_notice("[tft_validator] ✓ TFT validated against whitelist entry [%u/%u]",
+                         r->index + 1, whitelist->num_allowed_tfts);
+            fd_log_notice("[tft_validator]   Allowed: src_port=%u-%u, dst_port=%u-%u",
+                         r->src_port_start, r->src_port_end,
+                         r->dst_port_start, r->dst_port_end);
+            free(scratch);
+            return 0;  /* 验证通过 */
         }
-        
-        /* ★★★ 检查目标端口是否在白名单范围内 ★★★ */
-        if (whitelist_rule.dst_port.is_valid && request_rule.dst_port.is_valid) {
-            /* 跳过 0.65535 表示任意端口的白名单规则 */
-            if (!(whitelist_rule.dst_port.start_port == 0 && whitelist_rule.dst_port.end_port == 65535)) {
-                if (request_rule.dst_port.start_port < whitelist_rule.dst_port.start_port ||
-                    request_rule.dst_port.end_port > whitelist_rule.dst_port.end_port) {
-                    fd_log_debug("[tft_validator]   ✗ Dest port out of range: req=%u-%u, wl=%u-%u",
-                                request_rule.dst_port.start_port, request_rule.dst_port.end_port,
-                                whitelist_rule.dst_port.start_port, whitelist_rule.dst_port.end_port);
-                    continue;
-                }
-            }
-        }
-        
-        /* ★★★ 检查源端口是否在白名单范围内 ★★★ */
-        if (whitelist_rule.src_port.is_valid && request_rule.src_port.is_valid) {
-            /* 跳过 0.65535 表示任意端口的白名单规则 */
-            if (!(whitelist_rule.src_port.start_port == 0 && whitelist_rule.src_port.end_port == 65535)) {
-                if (request_rule.src_port.start_port < whitelist_rule.src_port.start_port ||
-                    request_rule.src_port.end_port > whitelist_rule.src_port.end_port) {
-                    fd_log_debug("[tft_validator]   ✗ Source port out of range: req=%u-%u, wl=%u-%u",
-                                request_rule.src_port.start_port, request_rule.src_port.end_port,
-                                whitelist_rule.src_port.start_port, whitelist_rule.src_port.end_port);
-                    continue;
-                }
-            }
-        }
-        
-        /* 所有条件通过 */
-        fd_log_notice("[tft_validator] ✓ TFT validated against whitelist entry [%u/%u]",
-                     i + 1, whitelist->num_allowed_tfts);
-        fd_log_notice("[tft_validator]   Allowed: src_port=%u-%u, dst_port=%u-%u",
-                     whitelist_rule.src_port.start_port, whitelist_rule.src_port.end_port,
-                     whitelist_rule.dst_port.start_port, whitelist_rule.dst_port.end_port);
-        return 0;  /* 验证通过 */
+    } else {
+        fd_log_debug("[tft_validator]   ✗ Protocol %u not present in whitelist",
+                     request_rule.protocol);
     }
+    free(scratch);
     
     /* 未找到匹配的规则 */
     snprintf(error_msg, error_msg_len, 
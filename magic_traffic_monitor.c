@@ -5,9 +5,13 @@
  *
  * 实现说明:
  * 1. 使用 conntrack mark 标记每个会话的连接
- * 2. 通过 Netlink 查询带有特定 mark 的 conntrack 条目
- * 3. 聚合同一 mark 下所有连接的字节/数据包计数器
- * 4. 同时支持 iptables 和 nftables 后端
+ * 2. 常驻事件线程接收 MAGIC mark 范围内的 DESTROY 事件，累加结束连接的计数器
+ * 3. 统计过期时做一次按 mark 过滤的 dump，与每条连接的上次读数相减，
+ *    累加存活连接的增量 (不清零内核计数器)
+ * 4. 会话统计直接读取 mark 表，与 conntrack 表规模无关
+ * 5. 同时支持 iptables 和 nftables 后端
+ * 6. nftables 计数器后端: 按 ct mark 映射到具名计数器，一次 NFT_MSG_GETOBJ
+ *    dump 读取全部会话的绝对计数，不打开 conntrack 句柄也不订阅事件
  *
  * 依赖:
  * - libnetfilter_conntrack (需安装 libnetfilter_conntrack-dev)
@@ -20,34 +24,29 @@
 
 #include "magic_traffic_monitor.h"
 #include <arpa/inet.h>
+#include <endian.h>
 #include <errno.h>
 #include <freeDiameter/freeDiameter-host.h>
 #include <freeDiameter/libfdcore.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netlink.h>
+
 /* libnetfilter_conntrack 头文件 */
 #include <libnetfilter_conntrack/libnetfilter_conntrack.h>
 #include <libnetfilter_conntrack/libnetfilter_conntrack_tcp.h>
 
-/*===========================================================================
- * 内部数据结构
- *===========================================================================*/
-
-/**
- * @brief Netlink 回调上下文。
- * @details 在遍历 conntrack 表时传递给回调函数，用于过滤和累加统计数据。
- */
-typedef struct {
-  uint32_t target_mark; ///< 查询的目标 conntrack mark。
-  TrafficStats *stats;  ///< 输出统计结构指针。
-  int match_count;      ///< 匹配的连接数。
-} NetlinkCallbackCtx;
-
 /*===========================================================================
  * 辅助函数
  *===========================================================================*/
@@ -103,8 +102,8 @@ TrafficBackendType traffic_detect_backend(void) {
                "/sbin/nft --version > /dev/null 2>&1 || "
                "nft --version > /dev/null 2>&1");
   if (WIFEXITED(ret) && WEXITSTATUS(ret) == 0) {
-    fd_log_notice("[traffic] 检测到 nftables 后端");
-    return TRAFFIC_BACKEND_NFTABLES;
+    fd_log_notice("[traffic] 检测到 nftables 后端 (具名计数器)");
+    return TRAFFIC_BACKEND_NFT_COUNTERS;
   }
 
   /* 检查 iptables - 使用绝对路径 */
@@ -126,6 +125,28 @@ TrafficBackendType traffic_detect_backend(void) {
   fd_log_notice("[traffic] 未检测到防火墙后端，使用默认 iptables");
   return TRAFFIC_BACKEND_IPTABLES;
 }
+
+const char *traffic_backend_name(TrafficBackendType backend) {
+  switch (backend) {
+  case TRAFFIC_BACKEND_IPTABLES:
+    return "iptables";
+  case TRAFFIC_BACKEND_NFTABLES:
+    return "nftables";
+  case TRAFFIC_BACKEND_NFT_COUNTERS:
+    return "nftables-counters";
+  default:
+    return "auto";
+  }
+}
+
+/**
+ * @brief 后端是否使用 nftables 打标规则
+ */
+static bool uses_nft_rules(TrafficBackendType backend) {
+  return backend == TRAFFIC_BACKEND_NFTABLES ||
+         backend == TRAFFIC_BACKEND_NFT_COUNTERS;
+}
+
 /**
  * @brief 执行系统命令
  */
@@ -157,97 +178,731 @@ static TrafficSession *find_free_slot(TrafficMonitorContext *ctx) {
 }
 
 /*===========================================================================
- * Netlink 回调函数
+ * Netlink 计数 (按 mark 增量累计)
  *===========================================================================*/
 
 /**
- * @brief conntrack 条目回调函数
- * 当查询到匹配的 conntrack 条目时调用
+ * @brief 按连接原方向五元组查询所属会话 (仅 IPv4)。
+ * @note 调用者须持有 ctx->mutex。
+ * @return 已注册的会话，未安装回调、未命中或会话未注册时返回 NULL。
  */
-static int conntrack_callback(enum nf_conntrack_msg_type type,
-                              struct nf_conntrack *ct, void *data) {
-  (void)type;
-  NetlinkCallbackCtx *cb_ctx = (NetlinkCallbackCtx *)data;
+static TrafficSession *classify_conntrack(TrafficMonitorContext *ctx,
+                                          struct nf_conntrack *ct) {
+  if (!ctx->classify || !nfct_attr_is_set(ct, ATTR_L3PROTO) ||
+      nfct_get_attr_u8(ct, ATTR_L3PROTO) != AF_INET) {
+    return NULL;
+  }
+
+  TrafficFlowTuple tuple = {0};
+  tuple.src_ip = ntohl(nfct_get_attr_u32(ct, ATTR_ORIG_IPV4_SRC));
+  tuple.dst_ip = ntohl(nfct_get_attr_u32(ct, ATTR_ORIG_IPV4_DST));
+  tuple.protocol = nfct_get_attr_u8(ct, ATTR_ORIG_L4PROTO);
+  if (nfct_attr_is_set(ct, ATTR_ORIG_PORT_SRC)) {
+    tuple.src_port = ntohs(nfct_get_attr_u16(ct, ATTR_ORIG_PORT_SRC));
+    tuple.dst_port = ntohs(nfct_get_attr_u16(ct, ATTR_ORIG_PORT_DST));
+  }
+
+  char session_id[MAX_SESSION_ID_LEN];
+  if (ctx->classify(ctx->classify_arg, &tuple, session_id,
+                    sizeof(session_id)) != 0) {
+    return NULL;
+  }
+  return traffic_find_session(ctx, session_id);
+}
+
+/*
+ * 连接读数表: 以 conntrack ID 为键记录每条存活连接上次读到的计数器。
+ * 内核 ct ID 本身已是散列值，桶下标直接取低位。条目按下标链接，
+ * 扩容时整体 realloc 后重建桶。以下函数的调用者均须持有 ctx->mutex。
+ */
+
+static uint32_t conn_bucket(const TrafficMonitorContext *ctx, uint32_t ct_id) {
+  return ct_id & (ctx->conn_capacity - 1);
+}
+
+static int conn_find(TrafficMonitorContext *ctx, uint32_t ct_id) {
+  if (!ctx->conn_capacity) {
+    return -1;
+  }
+  for (int i = ctx->conn_hash[conn_bucket(ctx, ct_id)]; i >= 0;
+       i = ctx->conns[i].next) {
+    if (ctx->conns[i].ct_id == ct_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief 读数表扩容 (倍增) 并重建桶。
+ * @return 0=成功, -1=内存不足 (原表保持不变)
+ */
+static int conn_grow(TrafficMonitorContext *ctx) {
+  uint32_t old_cap = ctx->conn_capacity;
+  uint32_t cap = old_cap ? old_cap * 2 : TRAFFIC_CONN_INITIAL;
+
+  int *hash = malloc((size_t)cap * sizeof(*hash));
+  TrafficConnEntry *conns =
+      hash ? realloc(ctx->conns, (size_t)cap * sizeof(*conns)) : NULL;
+  if (!conns) {
+    free(hash);
+    fd_log_error("[traffic] ✗ 连接读数表扩容到 %u 失败", cap);
+    return -1;
+  }
+
+  ctx->conns = conns;
+  ctx->conn_capacity = cap;
+  for (uint32_t i = 0; i < cap; i++) {
+    hash[i] = -1;
+  }
+
+  /* 旧条目重新入桶，新增条目挂入空闲链 */
+  for (uint32_t i = 0; i < old_cap; i++) {
+    if (conns[i].in_use) {
+      uint32_t b = conn_bucket(ctx, conns[i].ct_id);
+      conns[i].next = hash[b];
+      hash[b] = (int)i;
+    }
+  }
+  memset(&conns[old_cap], 0, (size_t)(cap - old_cap) * sizeof(*conns));
+  for (uint32_t i = old_cap; i < cap; i++) {
+    conns[i].next = (i + 1 < cap) ? (int)(i + 1) : ctx->conn_free;
+  }
+  ctx->conn_free = (int)old_cap;
+
+  free(ctx->conn_hash);
+  ctx->conn_hash = hash;
+  return 0;
+}
+
+/* 新建 ct_id 的记录 (计数为零)，内存不足返回 -1 */
+static int conn_insert(TrafficMonitorContext *ctx, uint32_t ct_id) {
+  if (ctx->conn_free < 0 && conn_grow(ctx) != 0) {
+    return -1;
+  }
+
+  int idx = ctx->conn_free;
+  TrafficConnEntry *e = &ctx->conns[idx];
+  ctx->conn_free = e->next;
+
+  uint32_t b = conn_bucket(ctx, ct_id);
+  memset(e, 0, sizeof(*e));
+  e->in_use = true;
+  e->ct_id = ct_id;
+  e->next = ctx->conn_hash[b];
+  ctx->conn_hash[b] = idx;
+  ctx->conn_count++;
+  return idx;
+}
+
+static void conn_remove(TrafficMonitorContext *ctx, int idx) {
+  TrafficConnEntry *e = &ctx->conns[idx];
+  int *link = &ctx->conn_hash[conn_bucket(ctx, e->ct_id)];
+  while (*link != idx) {
+    link = &ctx->conns[*link].next;
+  }
+  *link = e->next;
+
+  e->in_use = false;
+  e->next = ctx->conn_free;
+  ctx->conn_free = idx;
+  ctx->conn_count--;
+}
 
-  if (!ct || !cb_ctx) {
-    return NFCT_CB_CONTINUE;
+/**
+ * @brief 回收连续两次 dump 都未出现的记录。
+ * @details 连接结束后 DESTROY 事件可能还在事件套接字中排队，隔一次 dump
+ *          再回收，避免事件到达时找不到读数而把全量重复计入；事件丢失
+ *          (ENOBUFS) 的连接由此回收，其最后一段增量无法计入。
+ */
+static void conn_sweep(TrafficMonitorContext *ctx) {
+  for (uint32_t i = 0; i < ctx->conn_capacity; i++) {
+    TrafficConnEntry *e = &ctx->conns[i];
+    if (e->in_use && ctx->dump_gen - e->seen_gen >= 2) {
+      conn_remove(ctx, (int)i);
+      ctx->total_conn_expired++;
+    }
+  }
+}
+
+/* a - b，b > a (ID 被新连接复用) 时视为从零开始 */
+static uint64_t counter_delta(uint64_t now, uint64_t last) {
+  return now >= last ? now - last : now;
+}
+
+/**
+ * @brief 把一个 conntrack 条目自上次读取以来的增量累加到其所属会话的
+ *        mark 槽位。
+ * @details 打标规则按客户端源地址匹配，同一客户端 IP 的多个会话的连接
+ *          都带先生效会话的 mark；安装了归属回调时按五元组改记到
+ *          TFT 实际匹配的会话。
+ *
+ *          dump (final=false) 更新该连接的上次读数；DESTROY 事件
+ *          (final=true) 结算后移除记录。读数表内存不足时 dump 跳过该连接
+ *          (下次 dump 再计入)，不会重复计数。
+ * @note 调用者须持有 ctx->mutex。
+ */
+static void accumulate_conntrack(TrafficMonitorContext *ctx,
+                                 struct nf_conntrack *ct, bool final) {
+  if (!nfct_attr_is_set(ct, ATTR_MARK)) {
+    return;
   }
 
-  /* 获取 conntrack mark */
   uint32_t mark = nfct_get_attr_u32(ct, ATTR_MARK);
+  if (mark < TRAFFIC_MARK_BASE || mark > TRAFFIC_MARK_MAX) {
+    return;
+  }
 
-  /* 检查是否匹配目标 mark */
-  if (mark != cb_ctx->target_mark) {
-    return NFCT_CB_CONTINUE;
+  /* 原方向 = 客户端发送，反方向 = 客户端接收 */
+  uint64_t bytes_in = nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_BYTES);
+  uint64_t packets_in = nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_PACKETS);
+  uint64_t bytes_out = nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_BYTES);
+  uint64_t packets_out = nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_PACKETS);
+
+  /* 没有 ID 无法求增量: dump 跳过，DESTROY 按全量计入 */
+  if (!nfct_attr_is_set(ct, ATTR_ID)) {
+    if (!final) {
+      return;
+    }
+  } else {
+    uint32_t ct_id = nfct_get_attr_u32(ct, ATTR_ID);
+    int idx = conn_find(ctx, ct_id);
+    if (idx < 0 && !final) {
+      idx = conn_insert(ctx, ct_id);
+      if (idx < 0) {
+        return;
+      }
+    }
+    if (idx >= 0) {
+      TrafficConnEntry *e = &ctx->conns[idx];
+      uint64_t d_bytes_in = counter_delta(bytes_in, e->bytes_in);
+      uint64_t d_packets_in = counter_delta(packets_in, e->packets_in);
+      uint64_t d_bytes_out = counter_delta(bytes_out, e->bytes_out);
+      uint64_t d_packets_out = counter_delta(packets_out, e->packets_out);
+      if (final) {
+        conn_remove(ctx, idx);
+      } else {
+        e->bytes_in = bytes_in;
+        e->packets_in = packets_in;
+        e->bytes_out = bytes_out;
+        e->packets_out = packets_out;
+        e->seen_gen = ctx->dump_gen;
+      }
+      bytes_in = d_bytes_in;
+      packets_in = d_packets_in;
+      bytes_out = d_bytes_out;
+      packets_out = d_packets_out;
+    }
   }
 
-  /* 累加原方向 (客户端发送) 的字节/数据包 */
-  uint64_t bytes_orig = nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_BYTES);
-  uint64_t pkts_orig = nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_PACKETS);
+  TrafficSession *owner = classify_conntrack(ctx, ct);
+  if (owner && owner->conntrack_mark != mark) {
+    mark = owner->conntrack_mark;
+    ctx->total_reclassified++;
+  }
 
-  /* 累加反方向 (客户端接收) 的字节/数据包 */
-  uint64_t bytes_reply = nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_BYTES);
-  uint64_t pkts_reply = nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_PACKETS);
+  TrafficStats *acc = &ctx->mark_stats[mark - TRAFFIC_MARK_BASE];
+  acc->bytes_in += bytes_in;
+  acc->packets_in += packets_in;
+  acc->bytes_out += bytes_out;
+  acc->packets_out += packets_out;
+}
 
-  cb_ctx->stats->bytes_in += bytes_orig;
-  cb_ctx->stats->packets_in += pkts_orig;
-  cb_ctx->stats->bytes_out += bytes_reply;
-  cb_ctx->stats->packets_out += pkts_reply;
-  cb_ctx->match_count++;
+/**
+ * @brief 过滤 dump 回调 (调用者已持有 ctx->mutex)。
+ */
+static int dump_callback(enum nf_conntrack_msg_type type,
+                         struct nf_conntrack *ct, void *data) {
+  (void)type;
+  accumulate_conntrack((TrafficMonitorContext *)data, ct, false);
+  return NFCT_CB_CONTINUE;
+}
 
-  fd_log_debug(
-      "[traffic] conntrack match: mark=0x%x, orig=%lu/%lu, reply=%lu/%lu", mark,
-      bytes_orig, pkts_orig, bytes_reply, pkts_reply);
+/**
+ * @brief DESTROY 事件回调 (事件线程)。
+ */
+static int destroy_callback(enum nf_conntrack_msg_type type,
+                            struct nf_conntrack *ct, void *data) {
+  (void)type;
+  TrafficMonitorContext *ctx = (TrafficMonitorContext *)data;
+
+  pthread_mutex_lock(&ctx->mutex);
+  accumulate_conntrack(ctx, ct, true);
+  ctx->total_destroy_events++;
+  pthread_mutex_unlock(&ctx->mutex);
 
   return NFCT_CB_CONTINUE;
 }
 
 /**
- * @brief 通过 Netlink 查询指定 mark 的流量统计
+ * @brief 读取 MAGIC mark 范围内存活连接的计数器，把增量累加到 mark 表。
+ * @details 内核按 mark/mask 过滤 (IPv4 与 IPv6 一次完成)，只遍历 MAGIC
+ *          连接；所有会话共用这一次 dump。内核计数器不清零，增量由
+ *          连接读数表求出。
+ * @note 调用者须持有 ctx->mutex。
  */
-static int query_conntrack_stats(TrafficMonitorContext *ctx, uint32_t mark,
-                                 TrafficStats *stats) {
-  if (!ctx || !stats)
+static int dump_conntrack_counters(TrafficMonitorContext *ctx) {
+  struct nfct_handle *h = (struct nfct_handle *)ctx->nfct_handle;
+  if (!h) {
     return -1;
+  }
 
-  memset(stats, 0, sizeof(TrafficStats));
+  struct nfct_filter_dump *filter = nfct_filter_dump_create();
+  if (!filter) {
+    return -1;
+  }
 
-  /* 创建 conntrack 句柄 */
-  struct nfct_handle *h = nfct_open(CONNTRACK, 0);
+  struct nfct_filter_dump_mark mark = {.val = TRAFFIC_MARK_BASE,
+                                       .mask = TRAFFIC_MARK_MASK};
+  nfct_filter_dump_set_attr(filter, NFCT_FILTER_DUMP_MARK, &mark);
+
+  ctx->dump_gen++;
+  int ret = nfct_query(h, NFCT_Q_DUMP_FILTER, filter);
+  nfct_filter_dump_destroy(filter);
+
+  if (ret == -1) {
+    fd_log_error("[traffic] conntrack 过滤 dump 失败: %s", strerror(errno));
+    return -1;
+  }
+  conn_sweep(ctx);
+
+  ctx->last_refresh = time(NULL);
+  ctx->total_dumps++;
+  return 0;
+}
+
+static int nft_read_counters(TrafficMonitorContext *ctx);
+
+/**
+ * @brief 按后端刷新 mark 表。
+ * @note 调用者须持有 ctx->mutex。
+ */
+static int refresh_mark_counters(TrafficMonitorContext *ctx) {
+  if (ctx->backend == TRAFFIC_BACKEND_NFT_COUNTERS) {
+    return nft_read_counters(ctx);
+  }
+  return dump_conntrack_counters(ctx);
+}
+
+/**
+ * @brief 统计过期时刷新 mark 表。
+ * @note 调用者须持有 ctx->mutex。
+ */
+static void refresh_if_stale(TrafficMonitorContext *ctx) {
+  if (ctx->netlink_available &&
+      time(NULL) - ctx->last_refresh >= STATS_CACHE_TTL_SEC) {
+    refresh_mark_counters(ctx);
+  }
+}
+
+/**
+ * @brief 读取会话 mark 的累计计数器到 sess->stats。
+ * @note 调用者须持有 ctx->mutex。
+ */
+static void load_session_stats(TrafficMonitorContext *ctx,
+                               TrafficSession *sess) {
+  const TrafficStats *acc =
+      &ctx->mark_stats[sess->conntrack_mark - TRAFFIC_MARK_BASE];
+
+  sess->stats.bytes_in = acc->bytes_in;
+  sess->stats.bytes_out = acc->bytes_out;
+  sess->stats.packets_in = acc->packets_in;
+  sess->stats.packets_out = acc->packets_out;
+  sess->stats.last_update = ctx->last_refresh;
+}
+
+/**
+ * @brief DESTROY 事件接收线程。
+ * @details 套接字为非阻塞，poll 到可读后 nfct_catch 处理到 EAGAIN 为止；
+ *          ENOBUFS 表示内核丢弃了事件，对应连接的最后增量无法计入。
+ */
+static void *event_thread_func(void *arg) {
+  TrafficMonitorContext *ctx = (TrafficMonitorContext *)arg;
+  struct nfct_handle *h = (struct nfct_handle *)ctx->nfct_event_handle;
+  struct pollfd pfd = {.fd = nfct_fd(h), .events = POLLIN};
+
+  while (ctx->event_running) {
+    int n = poll(&pfd, 1, 1000);
+    if (n <= 0) {
+      continue;
+    }
+
+    if (nfct_catch(h) == -1 && errno == ENOBUFS) {
+      pthread_mutex_lock(&ctx->mutex);
+      ctx->total_event_overruns++;
+      pthread_mutex_unlock(&ctx->mutex);
+      fd_log_notice("[traffic] ⚠ conntrack 事件缓冲区溢出，部分结束连接未计入");
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief 订阅 MAGIC mark 范围内的 DESTROY 事件并启动接收线程。
+ * @return 0=成功, -1=失败 (仍可仅靠过滤 dump 计数)
+ */
+static int start_event_listener(TrafficMonitorContext *ctx) {
+  struct nfct_handle *h = nfct_open(CONNTRACK, NF_NETLINK_CONNTRACK_DESTROY);
   if (!h) {
-    fd_log_error("[traffic] nfct_open 失败: %s", strerror(errno));
+    fd_log_error("[traffic] 订阅 conntrack DESTROY 事件失败: %s",
+                 strerror(errno));
     return -1;
   }
 
-  /* 设置回调上下文 */
-  NetlinkCallbackCtx cb_ctx = {
-      .target_mark = mark, .stats = stats, .match_count = 0};
+  int fd = nfct_fd(h);
+
+  /* 内核侧 BPF 过滤: 只投递 MAGIC mark 范围内的连接 */
+  struct nfct_filter *filter = nfct_filter_create();
+  if (filter) {
+    struct nfct_filter_dump_mark mark = {.val = TRAFFIC_MARK_BASE,
+                                         .mask = TRAFFIC_MARK_MASK};
+    nfct_filter_add_attr(filter, NFCT_FILTER_MARK, &mark);
+    if (nfct_filter_attach(fd, filter) == -1) {
+      fd_log_notice("[traffic] ⚠ 事件 mark 过滤挂载失败 (%s)，改为用户态过滤",
+                    strerror(errno));
+    }
+    nfct_filter_destroy(filter);
+  }
 
-  /* 注册回调 */
-  nfct_callback_register(h, NFCT_T_ALL, conntrack_callback, &cb_ctx);
+  int rcvbuf = TRAFFIC_EVENT_RCVBUF;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
-  /* 查询所有 conntrack 条目 */
-  int ret = nfct_query(h, NFCT_Q_DUMP, &(int){AF_INET});
-  if (ret == -1) {
-    fd_log_error("[traffic] nfct_query 失败: %s", strerror(errno));
+  nfct_callback_register(h, NFCT_T_DESTROY, destroy_callback, ctx);
+
+  ctx->nfct_event_handle = h;
+  ctx->event_running = true;
+  if (pthread_create(&ctx->event_thread, NULL, event_thread_func, ctx) != 0) {
+    fd_log_error("[traffic] 创建 conntrack 事件线程失败");
+    ctx->event_running = false;
+    ctx->nfct_event_handle = NULL;
     nfct_close(h);
     return -1;
   }
 
-  /* 同时查询 IPv6 */
-  nfct_query(h, NFCT_Q_DUMP, &(int){AF_INET6});
+  return 0;
+}
+
+/**
+ * @brief 打开常驻 conntrack 查询句柄，必要时启用 nf_conntrack_acct。
+ * @return 0=成功, -1=失败 (netlink_available 置为 false)
+ */
+static int open_conntrack(TrafficMonitorContext *ctx) {
+  struct nfct_handle *h = nfct_open(CONNTRACK, 0);
+  if (h) {
+    nfct_callback_register(h, NFCT_T_ALL, dump_callback, ctx);
+    ctx->nfct_handle = h;
+    ctx->netlink_available = true;
+    fd_log_notice("[traffic] Netlink conntrack 连接成功");
+
+    /* 检查并自动启用 conntrack 计数 */
+    FILE *fp = fopen("/proc/sys/net/netfilter/nf_conntrack_acct", "r");
+    if (fp) {
+      char val;
+      if (fread(&val, 1, 1, fp) > 0 && val == '0') {
+        fclose(fp);
+        fd_log_notice(
+            "[traffic] 检测到 nf_conntrack_acct 未启用，尝试自动启用...");
+
+        /* 尝试自动启用 */
+        fp = fopen("/proc/sys/net/netfilter/nf_conntrack_acct", "w");
+        if (fp) {
+          if (fwrite("1", 1, 1, fp) > 0) {
+            fd_log_notice(
+                "[traffic] ✓ 已自动启用 net.netfilter.nf_conntrack_acct");
+          } else {
+            fd_log_error("[traffic] ✗ 自动启用失败: %s", strerror(errno));
+            fd_log_error("[traffic] 请手动运行: sysctl -w "
+                         "net.netfilter.nf_conntrack_acct=1");
+          }
+          fclose(fp);
+        } else {
+          fd_log_error("[traffic] ✗ 无权限启用 nf_conntrack_acct");
+          fd_log_error("[traffic] 请以 root 权限运行，或手动执行: sysctl -w "
+                       "net.netfilter.nf_conntrack_acct=1");
+        }
+      } else {
+        fclose(fp);
+      }
+    }
+  } else {
+    ctx->netlink_available = false;
+    fd_log_error("[traffic] Netlink conntrack 连接失败: %s", strerror(errno));
+    fd_log_error("[traffic] 请确保以 root 权限运行，并加载 nf_conntrack 模块");
+  }
+
+  return ctx->netlink_available ? 0 : -1;
+}
+
+/*===========================================================================
+ * nftables 具名计数器 (按 ct mark 映射)
+ *===========================================================================*/
+
+#define NFT_RECV_BUF 32768      /* 一次 recv 的 dump 缓冲区 */
+#define NFT_RECV_TIMEOUT_SEC 2  /* 等待内核应答的超时 */
+
+/**
+ * @brief 创建计数表、映射与计数链 (重建，清除上次运行的残留)。
+ * @details 计数链优先级 -140，位于打标链 (-150) 之后，首包即可按新 ct mark
+ *          计数；未注册的 mark 在映射中查不到，规则不生效。
+ */
+static int nft_acct_setup_table(void) {
+  return exec_cmd(
+      "nft 'add table inet " TRAFFIC_NFT_ACCT_TABLE "; "
+      "delete table inet " TRAFFIC_NFT_ACCT_TABLE "; "
+      "add table inet " TRAFFIC_NFT_ACCT_TABLE "; "
+      "add map inet " TRAFFIC_NFT_ACCT_TABLE " acct_in "
+      "{ type mark : counter; }; "
+      "add map inet " TRAFFIC_NFT_ACCT_TABLE " acct_out "
+      "{ type mark : counter; }; "
+      "add chain inet " TRAFFIC_NFT_ACCT_TABLE " acct "
+      "{ type filter hook prerouting priority -140; policy accept; }; "
+      "add rule inet " TRAFFIC_NFT_ACCT_TABLE " acct "
+      "ct direction original counter name ct mark map @acct_in; "
+      "add rule inet " TRAFFIC_NFT_ACCT_TABLE " acct "
+      "ct direction reply counter name ct mark map @acct_out' "
+      "2>/dev/null");
+}
+
+/**
+ * @brief 打开计数器读取套接字并建表。
+ * @return 0=成功, -1=失败 (调用者回退到 conntrack 计数)
+ */
+static int nft_acct_init(TrafficMonitorContext *ctx) {
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+  if (fd < 0) {
+    fd_log_error("[traffic] 打开 nftables netlink 套接字失败: %s",
+                 strerror(errno));
+    return -1;
+  }
+
+  struct sockaddr_nl local = {.nl_family = AF_NETLINK};
+  struct timeval tv = {.tv_sec = NFT_RECV_TIMEOUT_SEC};
+  if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+    fd_log_error("[traffic] 绑定 nftables netlink 套接字失败: %s",
+                 strerror(errno));
+    close(fd);
+    return -1;
+  }
 
-  nfct_close(h);
+  if (nft_acct_setup_table() != 0) {
+    fd_log_error("[traffic] 创建计数表 inet %s 失败", TRAFFIC_NFT_ACCT_TABLE);
+    close(fd);
+    return -1;
+  }
 
-  stats->last_update = time(NULL);
+  ctx->nft_fd = fd;
+  ctx->nft_seq = (uint32_t)time(NULL);
 
-  fd_log_debug("[traffic] 查询 mark=0x%x: %d 条匹配, in=%lu/%lu, out=%lu/%lu",
-               mark, cb_ctx.match_count, stats->bytes_in, stats->packets_in,
-               stats->bytes_out, stats->packets_out);
+  /* 空表读一次，确认内核支持对象 dump */
+  if (nft_read_counters(ctx) != 0) {
+    exec_cmd("nft delete table inet " TRAFFIC_NFT_ACCT_TABLE " 2>/dev/null");
+    ctx->nft_fd = -1;
+    close(fd);
+    return -1;
+  }
 
+  fd_log_notice("[traffic] ✓ nftables 计数表 inet %s 就绪",
+                TRAFFIC_NFT_ACCT_TABLE);
   return 0;
 }
 
+/**
+ * @brief 为会话 mark 创建一对计数器并加入映射 (一次 nft 调用)。
+ * @details 计数表在初始化时重建，注销时计数器随映射元素一并删除，
+ *          新建的计数器总是从零开始。
+ */
+static int nft_acct_add_mark(uint32_t mark) {
+  char cmd[512];
+  snprintf(cmd, sizeof(cmd),
+           "nft 'add counter inet %1$s m%2$03x_in; "
+           "add counter inet %1$s m%2$03x_out; "
+           "add element inet %1$s acct_in { 0x%2$x : \"m%2$03x_in\" }; "
+           "add element inet %1$s acct_out { 0x%2$x : \"m%2$03x_out\" }' "
+           "2>/dev/null",
+           TRAFFIC_NFT_ACCT_TABLE, mark);
+  return exec_cmd(cmd);
+}
+
+/**
+ * @brief 从映射中移除会话 mark 并删除其计数器。
+ */
+static int nft_acct_del_mark(uint32_t mark) {
+  char cmd[512];
+  snprintf(cmd, sizeof(cmd),
+           "nft 'delete element inet %1$s acct_in { 0x%2$x }; "
+           "delete element inet %1$s acct_out { 0x%2$x }; "
+           "delete counter inet %1$s m%2$03x_in; "
+           "delete counter inet %1$s m%2$03x_out' 2>/dev/null",
+           TRAFFIC_NFT_ACCT_TABLE, mark);
+  return exec_cmd(cmd);
+}
+
+/**
+ * @brief 追加一个 netlink 属性 (调用者保证缓冲区足够)。
+ */
+static void nft_put_attr(struct nlmsghdr *nlh, uint16_t type, const void *data,
+                         uint16_t len) {
+  struct nlattr *nla =
+      (struct nlattr *)((char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+  nla->nla_type = type;
+  nla->nla_len = NLA_HDRLEN + len;
+  memcpy((char *)nla + NLA_HDRLEN, data, len);
+  nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(nla->nla_len);
+}
+
+/**
+ * @brief 解析一条 NFT_MSG_NEWOBJ，把计数写入对应 mark 槽位 (绝对值)。
+ * @note 调用者须持有 ctx->mutex。
+ */
+static void nft_parse_counter(TrafficMonitorContext *ctx,
+                              const struct nlmsghdr *nlh) {
+  const char *table = NULL, *name = NULL;
+  uint64_t bytes = 0, packets = 0;
+
+  int len = (int)nlh->nlmsg_len - NLMSG_SPACE(sizeof(struct nfgenmsg));
+  const struct nlattr *nla =
+      (const struct nlattr *)((const char *)NLMSG_DATA(nlh) +
+                              NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+
+  for (; len >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN &&
+         nla->nla_len <= len;
+       len -= NLA_ALIGN(nla->nla_len),
+       nla = (const struct nlattr *)((const char *)nla +
+                                     NLA_ALIGN(nla->nla_len))) {
+    const char *payload = (const char *)nla + NLA_HDRLEN;
+
+    switch (nla->nla_type & NLA_TYPE_MASK) {
+    case NFTA_OBJ_TABLE:
+      table = payload;
+      break;
+    case NFTA_OBJ_NAME:
+      name = payload;
+      break;
+    case NFTA_OBJ_DATA: {
+      int dlen = nla->nla_len - NLA_HDRLEN;
+      const struct nlattr *d = (const struct nlattr *)payload;
+      for (; dlen >= NLA_HDRLEN && d->nla_len >= NLA_HDRLEN &&
+             d->nla_len <= dlen;
+           dlen -= NLA_ALIGN(d->nla_len),
+           d = (const struct nlattr *)((const char *)d +
+                                       NLA_ALIGN(d->nla_len))) {
+        uint64_t be;
+        if (d->nla_len < NLA_HDRLEN + sizeof(be)) {
+          continue;
+        }
+        memcpy(&be, (const char *)d + NLA_HDRLEN, sizeof(be));
+        if ((d->nla_type & NLA_TYPE_MASK) == NFTA_COUNTER_BYTES) {
+          bytes = be64toh(be);
+        } else if ((d->nla_type & NLA_TYPE_MASK) == NFTA_COUNTER_PACKETS) {
+          packets = be64toh(be);
+        }
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  if (!table || !name || strcmp(table, TRAFFIC_NFT_ACCT_TABLE) != 0) {
+    return;
+  }
+
+  /* 计数器名 m<mark>_in / m<mark>_out */
+  unsigned int mark;
+  char dir[4];
+  if (sscanf(name, "m%x_%3s", &mark, dir) != 2 || mark < TRAFFIC_MARK_BASE ||
+      mark > TRAFFIC_MARK_MAX) {
+    return;
+  }
+
+  TrafficStats *acc = &ctx->mark_stats[mark - TRAFFIC_MARK_BASE];
+  if (strcmp(dir, "in") == 0) {
+    acc->bytes_in = bytes;
+    acc->packets_in = packets;
+  } else if (strcmp(dir, "out") == 0) {
+    acc->bytes_out = bytes;
+    acc->packets_out = packets;
+  }
+}
+
+/**
+ * @brief 一次 NFT_MSG_GETOBJ dump 读取计数表内全部计数器。
+ * @details 请求带表名与对象类型，内核只返回本表的计数器；
+ *          开销与会话数成正比，与连接数无关。
+ * @note 调用者须持有 ctx->mutex。
+ */
+static int nft_read_counters(TrafficMonitorContext *ctx) {
+  if (ctx->nft_fd < 0) {
+    return -1;
+  }
+
+  char req[256] __attribute__((aligned(NLMSG_ALIGNTO)));
+  memset(req, 0, sizeof(req));
+
+  uint32_t seq = ++ctx->nft_seq;
+  struct nlmsghdr *nlh = (struct nlmsghdr *)req;
+  nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+  nlh->nlmsg_type = (NFNL_SUBSYS_NFTABLES << 8) | NFT_MSG_GETOBJ;
+  nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  nlh->nlmsg_seq = seq;
+
+  struct nfgenmsg *nfg = (struct nfgenmsg *)NLMSG_DATA(nlh);
+  nfg->nfgen_family = NFPROTO_INET;
+  nfg->version = NFNETLINK_V0;
+
+  uint32_t obj_type = htonl(NFT_OBJECT_COUNTER);
+  nft_put_attr(nlh, NFTA_OBJ_TABLE, TRAFFIC_NFT_ACCT_TABLE,
+               sizeof(TRAFFIC_NFT_ACCT_TABLE));
+  nft_put_attr(nlh, NFTA_OBJ_TYPE, &obj_type, sizeof(obj_type));
+
+  struct sockaddr_nl kernel = {.nl_family = AF_NETLINK};
+  if (sendto(ctx->nft_fd, req, nlh->nlmsg_len, 0, (struct sockaddr *)&kernel,
+             sizeof(kernel)) < 0) {
+    fd_log_error("[traffic] 发送计数器读取请求失败: %s", strerror(errno));
+    return -1;
+  }
+
+  static char buf[NFT_RECV_BUF] __attribute__((aligned(NLMSG_ALIGNTO)));
+  for (;;) {
+    ssize_t n = recv(ctx->nft_fd, buf, sizeof(buf), 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fd_log_error("[traffic] 接收计数器失败: %s", strerror(errno));
+      return -1;
+    }
+
+    int len = (int)n;
+    for (struct nlmsghdr *h = (struct nlmsghdr *)buf; NLMSG_OK(h, len);
+         h = NLMSG_NEXT(h, len)) {
+      if (h->nlmsg_seq != seq) {
+        continue; /* 上次超时遗留的应答 */
+      }
+      if (h->nlmsg_type == NLMSG_DONE) {
+        ctx->last_refresh = time(NULL);
+        ctx->total_dumps++;
+        return 0;
+      }
+      if (h->nlmsg_type == NLMSG_ERROR) {
+        const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(h);
+        if (err->error == 0) {
+          continue;
+        }
+        fd_log_error("[traffic] 读取计数器失败: %s", strerror(-err->error));
+        return -1;
+      }
+      if ((h->nlmsg_type & 0xff) == NFT_MSG_NEWOBJ) {
+        nft_parse_counter(ctx, h);
+      }
+    }
+  }
+}
+
 /*===========================================================================
  * 防火墙规则管理
  *===========================================================================*/
@@ -390,6 +1045,8 @@ int traffic_monitor_init(TrafficMonitorContext *ctx,
 
   memset(ctx, 0, sizeof(TrafficMonitorContext));
   pthread_mutex_init(&ctx->mutex, NULL);
+  ctx->nft_fd = -1;
+  ctx->conn_free = -1;
 
   /* 检测或设置后端 */
   if (backend == TRAFFIC_BACKEND_AUTO) {
@@ -400,58 +1057,28 @@ int traffic_monitor_init(TrafficMonitorContext *ctx,
 
   ctx->next_mark = TRAFFIC_MARK_BASE;
 
-  /* 测试 Netlink 连接 */
-  struct nfct_handle *h = nfct_open(CONNTRACK, 0);
-  if (h) {
-    nfct_close(h);
-    ctx->netlink_available = true;
-    fd_log_notice("[traffic] Netlink conntrack 连接测试成功");
-
-    /* 检查并自动启用 conntrack 计数 */
-    FILE *fp = fopen("/proc/sys/net/netfilter/nf_conntrack_acct", "r");
-    if (fp) {
-      char val;
-      if (fread(&val, 1, 1, fp) > 0 && val == '0') {
-        fclose(fp);
-        fd_log_notice(
-            "[traffic] 检测到 nf_conntrack_acct 未启用，尝试自动启用...");
+  if (ctx->backend == TRAFFIC_BACKEND_NFT_COUNTERS &&
+      nft_acct_init(ctx) != 0) {
+    fd_log_notice("[traffic] ⚠ nftables 计数器不可用，回退到 nftables + "
+                  "conntrack");
+    ctx->backend = TRAFFIC_BACKEND_NFTABLES;
+  }
 
-        /* 尝试自动启用 */
-        fp = fopen("/proc/sys/net/netfilter/nf_conntrack_acct", "w");
-        if (fp) {
-          if (fwrite("1", 1, 1, fp) > 0) {
-            fd_log_notice(
-                "[traffic] ✓ 已自动启用 net.netfilter.nf_conntrack_acct");
-          } else {
-            fd_log_error("[traffic] ✗ 自动启用失败: %s", strerror(errno));
-            fd_log_error("[traffic] 请手动运行: sysctl -w "
-                         "net.netfilter.nf_conntrack_acct=1");
-          }
-          fclose(fp);
-        } else {
-          fd_log_error("[traffic] ✗ 无权限启用 nf_conntrack_acct");
-          fd_log_error("[traffic] 请以 root 权限运行，或手动执行: sysctl -w "
-                       "net.netfilter.nf_conntrack_acct=1");
-        }
-      } else {
-        fclose(fp);
-      }
-    }
-  } else {
-    ctx->netlink_available = false;
-    fd_log_error("[traffic] Netlink conntrack 连接失败: %s", strerror(errno));
-    fd_log_error("[traffic] 请确保以 root 权限运行，并加载 nf_conntrack 模块");
+  if (ctx->backend == TRAFFIC_BACKEND_NFT_COUNTERS) {
+    ctx->netlink_available = true;
+  } else if (open_conntrack(ctx) == 0) {
+    start_event_listener(ctx);
   }
 
   ctx->is_initialized = true;
 
   fd_log_notice("[traffic] ════════════════════════════════════════");
   fd_log_notice("[traffic] MAGIC 流量监控模块初始化");
-  fd_log_notice("[traffic]   后端: %s", ctx->backend == TRAFFIC_BACKEND_NFTABLES
-                                            ? "nftables"
-                                            : "iptables");
+  fd_log_notice("[traffic]   后端: %s", traffic_backend_name(ctx->backend));
   fd_log_notice("[traffic]   Netlink: %s",
                 ctx->netlink_available ? "可用" : "不可用");
+  fd_log_notice("[traffic]   DESTROY 事件: %s",
+                ctx->nfct_event_handle ? "已订阅" : "未订阅");
   fd_log_notice("[traffic]   Mark 范围: 0x%x - 0x%x", TRAFFIC_MARK_BASE,
                 TRAFFIC_MARK_MAX);
   fd_log_notice("[traffic] ════════════════════════════════════════");
@@ -507,7 +1134,7 @@ uint32_t traffic_register_session(TrafficMonitorContext *ctx,
 
   /* 添加防火墙规则 */
   int ret;
-  if (ctx->backend == TRAFFIC_BACKEND_NFTABLES) {
+  if (uses_nft_rules(ctx->backend)) {
     ret = add_nftables_rule(client_ip, mark);
   } else {
     ret = add_iptables_rule(client_ip, mark);
@@ -519,6 +1146,14 @@ uint32_t traffic_register_session(TrafficMonitorContext *ctx,
     return 0;
   }
 
+  if (ctx->backend == TRAFFIC_BACKEND_NFT_COUNTERS &&
+      nft_acct_add_mark(mark) != 0) {
+    fd_log_error("[traffic] 添加计数器失败: mark=0x%x", mark);
+    del_nftables_rule(client_ip, mark);
+    pthread_mutex_unlock(&ctx->mutex);
+    return 0;
+  }
+
   /* 填充会话信息 */
   memset(slot, 0, sizeof(TrafficSession));
   slot->in_use = true;
@@ -530,6 +1165,9 @@ uint32_t traffic_register_session(TrafficMonitorContext *ctx,
   slot->conntrack_mark = mark;
   slot->stats.start_time = time(NULL);
 
+  /* mark 可能被先前的会话用过，从零开始累计 */
+  memset(&ctx->mark_stats[mark - TRAFFIC_MARK_BASE], 0, sizeof(TrafficStats));
+
   ctx->session_count++;
 
   pthread_mutex_unlock(&ctx->mutex);
@@ -556,12 +1194,22 @@ int traffic_unregister_session(TrafficMonitorContext *ctx,
   }
 
   /* 删除防火墙规则 */
-  if (ctx->backend == TRAFFIC_BACKEND_NFTABLES) {
+  if (uses_nft_rules(ctx->backend)) {
     del_nftables_rule(sess->client_ip, sess->conntrack_mark);
   } else {
     del_iptables_rule(sess->client_ip, sess->conntrack_mark);
   }
 
+  /* 计数器随会话删除，先读取最终值 */
+  if (ctx->backend == TRAFFIC_BACKEND_NFT_COUNTERS) {
+    refresh_mark_counters(ctx);
+    if (nft_acct_del_mark(sess->conntrack_mark) != 0) {
+      fd_log_notice("[traffic] ⚠ 删除计数器失败: mark=0x%x",
+                    sess->conntrack_mark);
+    }
+  }
+
+  load_session_stats(ctx, sess);
   fd_log_notice("[traffic] ✓ 注销会话: %s mark=0x%x 流量: in=%lu out=%lu",
                 session_id, sess->conntrack_mark, sess->stats.bytes_in,
                 sess->stats.bytes_out);
@@ -591,35 +1239,10 @@ int traffic_get_session_stats(TrafficMonitorContext *ctx,
     return -1;
   }
 
-  /* 检查缓存是否有效 */
-  time_t now = time(NULL);
-  if (now - sess->cache_time < STATS_CACHE_TTL_SEC) {
-    /* 使用缓存 */
-    memcpy(stats, &sess->cached_stats, sizeof(TrafficStats));
-    pthread_mutex_unlock(&ctx->mutex);
-    return 0;
-  }
-
-  /* 查询 Netlink */
-  if (ctx->netlink_available) {
-    if (query_conntrack_stats(ctx, sess->conntrack_mark, stats) == 0) {
-      /* 更新缓存 */
-      memcpy(&sess->cached_stats, stats, sizeof(TrafficStats));
-      sess->cache_time = now;
-
-      /* 累加到会话统计 */
-      sess->stats.bytes_in = stats->bytes_in;
-      sess->stats.bytes_out = stats->bytes_out;
-      sess->stats.packets_in = stats->packets_in;
-      sess->stats.packets_out = stats->packets_out;
-      sess->stats.last_update = now;
-    }
-  } else {
-    /* Netlink 不可用，返回已缓存的统计 */
-    memcpy(stats, &sess->stats, sizeof(TrafficStats));
-  }
-
-  stats->start_time = sess->stats.start_time;
+  /* 过期时一次 dump 刷新全部 mark，随后直接读取本会话槽位 */
+  refresh_if_stale(ctx);
+  load_session_stats(ctx, sess);
+  memcpy(stats, &sess->stats, sizeof(TrafficStats));
 
   pthread_mutex_unlock(&ctx->mutex);
 
@@ -637,22 +1260,18 @@ int traffic_get_client_stats(TrafficMonitorContext *ctx, const char *client_id,
 
   pthread_mutex_lock(&ctx->mutex);
 
+  refresh_if_stale(ctx);
+
   for (uint32_t i = 0; i < MAX_TRAFFIC_SESSIONS; i++) {
     TrafficSession *sess = &ctx->sessions[i];
     if (sess->in_use && strcmp(sess->client_id, client_id) == 0) {
-      TrafficStats sess_stats;
+      load_session_stats(ctx, sess);
+      const TrafficStats *sess_stats = &sess->stats;
 
-      /* 查询每个会话的统计 */
-      if (ctx->netlink_available) {
-        query_conntrack_stats(ctx, sess->conntrack_mark, &sess_stats);
-      } else {
-        memcpy(&sess_stats, &sess->stats, sizeof(TrafficStats));
-      }
-
-      total_stats->bytes_in += sess_stats.bytes_in;
-      total_stats->bytes_out += sess_stats.bytes_out;
-      total_stats->packets_in += sess_stats.packets_in;
-      total_stats->packets_out += sess_stats.packets_out;
+      total_stats->bytes_in += sess_stats->bytes_in;
+      total_stats->bytes_out += sess_stats->bytes_out;
+      total_stats->packets_in += sess_stats->packets_in;
+      total_stats->packets_out += sess_stats->packets_out;
 
       if (total_stats->start_time == 0 ||
           sess->stats.start_time < total_stats->start_time) {
@@ -684,21 +1303,18 @@ int traffic_get_all_stats(TrafficMonitorContext *ctx,
 
   pthread_mutex_lock(&ctx->mutex);
 
+  refresh_if_stale(ctx);
+
   for (uint32_t i = 0; i < MAX_TRAFFIC_SESSIONS; i++) {
     TrafficSession *sess = &ctx->sessions[i];
     if (sess->in_use) {
-      TrafficStats sess_stats;
+      load_session_stats(ctx, sess);
+      const TrafficStats *sess_stats = &sess->stats;
 
-      if (ctx->netlink_available) {
-        query_conntrack_stats(ctx, sess->conntrack_mark, &sess_stats);
-      } else {
-        memcpy(&sess_stats, &sess->stats, sizeof(TrafficStats));
-      }
-
-      total_stats->bytes_in += sess_stats.bytes_in;
-      total_stats->bytes_out += sess_stats.bytes_out;
-      total_stats->packets_in += sess_stats.packets_in;
-      total_stats->packets_out += sess_stats.packets_out;
+      total_stats->bytes_in += sess_stats->bytes_in;
+      total_stats->bytes_out += sess_stats->bytes_out;
+      total_stats->packets_in += sess_stats->packets_in;
+      total_stats->packets_out += sess_stats->packets_out;
 
       if (total_stats->start_time == 0 ||
           sess->stats.start_time < total_stats->start_time) {
@@ -728,26 +1344,36 @@ int traffic_refresh_stats(TrafficMonitorContext *ctx) {
 
   pthread_mutex_lock(&ctx->mutex);
 
+  int ret = refresh_mark_counters(ctx);
   for (uint32_t i = 0; i < MAX_TRAFFIC_SESSIONS; i++) {
     TrafficSession *sess = &ctx->sessions[i];
     if (sess->in_use) {
-      TrafficStats stats;
-      if (query_conntrack_stats(ctx, sess->conntrack_mark, &stats) == 0) {
-        memcpy(&sess->stats, &stats, sizeof(TrafficStats));
-        sess->stats.start_time = sess->stats.start_time; /* 保留开始时间 */
-        memcpy(&sess->cached_stats, &stats, sizeof(TrafficStats));
-        sess->cache_time = time(NULL);
-      }
+      load_session_stats(ctx, sess);
     }
   }
 
   pthread_mutex_unlock(&ctx->mutex);
 
-  fd_log_notice("[traffic] ✓ 刷新所有会话统计");
+  if (ret != 0) {
+    return -1;
+  }
+
+  fd_log_debug("[traffic] ✓ 刷新所有会话统计");
 
   return 0;
 }
 
+void traffic_set_classifier(TrafficMonitorContext *ctx, TrafficClassifyFn fn,
+                            void *arg) {
+  if (!ctx || !ctx->is_initialized)
+    return;
+
+  pthread_mutex_lock(&ctx->mutex);
+  ctx->classify = fn;
+  ctx->classify_arg = arg;
+  pthread_mutex_unlock(&ctx->mutex);
+}
+
 TrafficSession *traffic_find_session(TrafficMonitorContext *ctx,
                                      const char *session_id) {
   if (!ctx || !session_id)
@@ -788,13 +1414,17 @@ void traffic_monitor_print_status(TrafficMonitorContext *ctx) {
   fd_log_notice("[traffic] ════════════════════════════════════════");
   fd_log_notice("[traffic] 流量监控状态");
   fd_log_notice("[traffic] ════════════════════════════════════════");
-  fd_log_notice("[traffic] 后端: %s", ctx->backend == TRAFFIC_BACKEND_NFTABLES
-                                          ? "nftables"
-                                          : "iptables");
+  fd_log_notice("[traffic] 后端: %s", traffic_backend_name(ctx->backend));
   fd_log_notice("[traffic] Netlink: %s",
                 ctx->netlink_available ? "可用" : "不可用");
   fd_log_notice("[traffic] 活动会话: %u / %u", ctx->session_count,
                 MAX_TRAFFIC_SESSIONS);
+  fd_log_notice("[traffic] 读取: %lu 次, DESTROY 事件: %lu, 溢出: %lu",
+                ctx->total_dumps, ctx->total_destroy_events,
+                ctx->total_event_overruns);
+  fd_log_notice("[traffic] 按五元组改记: %lu", ctx->total_reclassified);
+  fd_log_notice("[traffic] 跟踪连接: %u, 未收到 DESTROY 即回收: %lu",
+                ctx->conn_count, ctx->total_conn_expired);
 
   fd_log_notice("[traffic] ─────────────────────────────────────");
 
@@ -822,6 +1452,14 @@ void traffic_monitor_cleanup(TrafficMonitorContext *ctx) {
   if (!ctx)
     return;
 
+  /* 先停止事件线程 (其回调需要获取 ctx->mutex) */
+  if (ctx->nfct_event_handle) {
+    ctx->event_running = false;
+    pthread_join(ctx->event_thread, NULL);
+    nfct_close((struct nfct_handle *)ctx->nfct_event_handle);
+    ctx->nfct_event_handle = NULL;
+  }
+
   pthread_mutex_lock(&ctx->mutex);
 
   fd_log_notice("[traffic] 正在清理流量监控模块...");
@@ -830,7 +1468,7 @@ void traffic_monitor_cleanup(TrafficMonitorContext *ctx) {
   for (uint32_t i = 0; i < MAX_TRAFFIC_SESSIONS; i++) {
     TrafficSession *sess = &ctx->sessions[i];
     if (sess->in_use) {
-      if (ctx->backend == TRAFFIC_BACKEND_NFTABLES) {
+      if (uses_nft_rules(ctx->backend)) {
         del_nftables_rule(sess->client_ip, sess->conntrack_mark);
       } else {
         del_iptables_rule(sess->client_ip, sess->conntrack_mark);
@@ -841,7 +1479,7 @@ void traffic_monitor_cleanup(TrafficMonitorContext *ctx) {
   ctx->session_count = 0;
 
   /* 清理防火墙链 */
-  if (ctx->backend == TRAFFIC_BACKEND_NFTABLES) {
+  if (uses_nft_rules(ctx->backend)) {
     exec_cmd("nft delete table inet magic 2>/dev/null");
   } else {
     exec_cmd("iptables -t mangle -F MAGIC_MARK 2>/dev/null");
@@ -849,6 +1487,25 @@ void traffic_monitor_cleanup(TrafficMonitorContext *ctx) {
     exec_cmd("iptables -t mangle -X MAGIC_MARK 2>/dev/null");
   }
 
+  /* 计数表整体删除 (含全部计数器) */
+  if (ctx->nft_fd >= 0) {
+    exec_cmd("nft delete table inet " TRAFFIC_NFT_ACCT_TABLE " 2>/dev/null");
+    close(ctx->nft_fd);
+    ctx->nft_fd = -1;
+  }
+
+  if (ctx->nfct_handle) {
+    nfct_close((struct nfct_handle *)ctx->nfct_handle);
+    ctx->nfct_handle = NULL;
+  }
+
+  free(ctx->conns);
+  free(ctx->conn_hash);
+  ctx->conns = NULL;
+  ctx->conn_hash = NULL;
+  ctx->conn_capacity = ctx->conn_count = 0;
+  ctx->conn_free = -1;
+
   ctx->is_initialized = false;
 
   pthread_mutex_unlock(&ctx->mutex);
@@ -22,9 +22,25 @@
  * 工作流程:
  * 1. MCCR 会话创建时，调用 traffic_register_session() 分配 conntrack mark
  * 2. iptables/nftables 规则使用此 mark 标记匹配的连接
- * 3. MADR 请求时，调用 traffic_get_session_stats() 通过 Netlink 读取计数器
+ * 3. MADR 请求时，调用 traffic_get_session_stats() 读取按 mark 累计的计数器
  * 4. 会话结束时，调用 traffic_unregister_session() 清理
  *
+ * 计数方式 (按 mark 增量累计，读取为 O(1)):
+ * - 常驻事件订阅: 只接收 MAGIC mark 范围内连接的 DESTROY 事件 (内核侧 BPF
+ *   过滤)，把连接结束时的计数器累加到 mark 表
+ * - 常驻查询句柄: 统计过期时做一次内核侧按 mark 过滤的 dump (不清零内核
+ *   计数器，conntrack 工具与其他读者看到的仍是绝对值)，与按 conntrack ID
+ *   记录的上次读数相减，增量累加到 mark 表；所有会话共用这一次 dump
+ * - DESTROY 事件同样只累加上次读数之后的增量并移除该连接的记录，两条路径
+ *   不会重复计数；连续两次 dump 未出现的记录 (事件丢失) 被回收
+ *
+ * nftables 计数器后端 (TRAFFIC_BACKEND_NFT_COUNTERS):
+ * - 表 inet magic_acct 的 prerouting 链按 ct direction 把报文计入
+ *   `counter name ct mark map @acct_in / @acct_out`
+ * - 每个会话注册时创建一对具名计数器 m<mark>_in / m<mark>_out 并加入映射
+ * - 刷新时一次 NFT_MSG_GETOBJ dump 读取全部计数器，不再依赖 conntrack；
+ *   计数器在连接结束后仍保留，开销与连接数无关，可每秒刷新写入 CDR
+ *
  * @author MAGIC System Development Team
  * @version 2.1
  * @date 2025-12-02
@@ -35,6 +51,7 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 
@@ -47,17 +64,31 @@
 #define TRAFFIC_MARK_MAX 0x1FF
 #define MAX_TRAFFIC_SESSIONS 256
 
+/* mark 范围的内核过滤掩码 (BASE 按 MAX_TRAFFIC_SESSIONS 对齐) */
+#define TRAFFIC_MARK_MASK (~(uint32_t)(MAX_TRAFFIC_SESSIONS - 1))
+
+/* DESTROY 事件套接字接收缓冲区 (字节)，突发大量连接结束时避免丢事件 */
+#define TRAFFIC_EVENT_RCVBUF (4 * 1024 * 1024)
+
+/* 连接读数表初始容量 (2 的幂, 满时倍增) */
+#define TRAFFIC_CONN_INITIAL 1024
+
 /* 统计缓存刷新间隔 (秒) - 避免频繁 Netlink 查询 */
 #define STATS_CACHE_TTL_SEC 2
 
 /* 会话 ID 最大长度 */
 #define MAX_SESSION_ID_LEN 128
 
+/* nftables 计数器后端: 表名与 CDR 周期更新间隔 */
+#define TRAFFIC_NFT_ACCT_TABLE "magic_acct"
+#define TRAFFIC_CDR_UPDATE_MS 1000
+
 /* 后端类型 */
 typedef enum {
   TRAFFIC_BACKEND_IPTABLES = 0, ///< 使用 iptables + conntrack 后端。
   TRAFFIC_BACKEND_NFTABLES = 1, ///< 使用 nftables + conntrack 后端。
-  TRAFFIC_BACKEND_AUTO = 2      ///< 自动检测可用后端。
+  TRAFFIC_BACKEND_AUTO = 2,     ///< 自动检测可用后端。
+  TRAFFIC_BACKEND_NFT_COUNTERS = 3 ///< nftables 打标 + 按 ct mark 映射的具名计数器。
 } TrafficBackendType;
 
 /*===========================================================================
@@ -84,12 +115,43 @@ typedef struct {
   char session_id[MAX_SESSION_ID_LEN]; ///< 关联的 Diameter 会话 ID。
   char client_id[64];                  ///< 客户端 ID (Origin-Host)。
   char client_ip[64];                  ///< 客户端 IP 地址 (IPv4/IPv6)。
-  uint32_t conntrack_mark;   ///< 分配的 Conntrack 标记值 (用于内核流量识别)。
-  TrafficStats stats;        ///< 实时流量统计 (从 Netlink 获取)。
-  TrafficStats cached_stats; ///< 缓存的统计 (减少 Netlink 查询开销)。
-  time_t cache_time;         ///< 缓存时间戳 (用于 TTL 判断)。
+  uint32_t conntrack_mark; ///< 分配的 Conntrack 标记值 (用于内核流量识别)。
+  TrafficStats stats;      ///< 最近一次读取的流量统计。
 } TrafficSession;
 
+/**
+ * @brief 存活连接上次读取的计数器 (按 conntrack ID 索引)
+ */
+typedef struct {
+  bool in_use;          ///< 是否使用中。
+  uint32_t ct_id;       ///< conntrack ID (ATTR_ID)。
+  uint32_t seen_gen;    ///< 最近一次出现在 dump 中的代次。
+  int next;             ///< 同桶/空闲链下一条目 (-1 = 链尾)。
+  uint64_t bytes_in;    ///< 上次读取的原方向字节数。
+  uint64_t bytes_out;   ///< 上次读取的反方向字节数。
+  uint64_t packets_in;  ///< 上次读取的原方向数据包数。
+  uint64_t packets_out; ///< 上次读取的反方向数据包数。
+} TrafficConnEntry;
+
+/**
+ * @brief 连接五元组 (IPv4, 连接原方向, 主机字节序)
+ */
+typedef struct {
+  uint32_t src_ip;   ///< 源 IP。
+  uint32_t dst_ip;   ///< 目的 IP。
+  uint16_t src_port; ///< 源端口 (无端口协议为 0)。
+  uint16_t dst_port; ///< 目的端口 (无端口协议为 0)。
+  uint8_t protocol;  ///< 协议号。
+} TrafficFlowTuple;
+
+/**
+ * @brief 流量归属回调: 按五元组查询连接所属会话。
+ * @details 在持有 ctx->mutex 时调用，不得回调流量监控 API。
+ * @return 0 命中 (session_id 已填写)，-1 未命中。
+ */
+typedef int (*TrafficClassifyFn)(void *arg, const TrafficFlowTuple *tuple,
+                                 char *session_id, size_t len);
+
 /**
  * @brief 流量监控上下文
  */
@@ -103,8 +165,36 @@ typedef struct {
   bool is_initialized;        ///< 模块是否已初始化。
   bool netlink_available;     ///< Netlink 接口是否可用。
 
+  /* 按 mark 累计的计数器 (下标 = mark - TRAFFIC_MARK_BASE, 注册时清零) */
+  TrafficStats mark_stats[MAX_TRAFFIC_SESSIONS];
+  time_t last_refresh; ///< 最近一次过滤 dump 的时间。
+
+  /* 存活连接的上次读数 (dump 求增量，DESTROY 时结算并移除) */
+  TrafficConnEntry *conns; ///< 条目池 (满时倍增，按下标链接)。
+  int *conn_hash;          ///< ct_id 哈希桶 (桶数 = conn_capacity)。
+  uint32_t conn_capacity;  ///< 条目池容量 (2 的幂)。
+  uint32_t conn_count;     ///< 使用中的条目数。
+  int conn_free;           ///< 空闲链表头 (-1 = 无)。
+  uint32_t dump_gen;       ///< 当前 dump 代次。
+
   /* Netlink 句柄 (由实现文件管理) */
-  void *nfct_handle; ///< libnetfilter_conntrack 句柄 (opaque)。
+  int nft_fd;              ///< nftables 计数器读取套接字 (-1=未打开)。
+  uint32_t nft_seq;        ///< nftables 请求序号。
+  void *nfct_handle;       ///< 常驻查询句柄 (opaque)。
+  void *nfct_event_handle; ///< DESTROY 事件订阅句柄 (opaque, NULL=未订阅)。
+  pthread_t event_thread;  ///< 事件接收线程。
+  volatile bool event_running; ///< 事件线程运行标志。
+
+  /* 按五元组细分归属 (同一客户端 IP 的多个会话共用打标规则时) */
+  TrafficClassifyFn classify; ///< 归属回调 (NULL=仅按 mark)。
+  void *classify_arg;         ///< 回调参数。
+
+  /* 统计 */
+  uint64_t total_dumps;          ///< 过滤 dump / 计数器读取次数。
+  uint64_t total_destroy_events; ///< 处理的 DESTROY 事件数。
+  uint64_t total_event_overruns; ///< 事件缓冲区溢出次数 (可能丢失计数)。
+  uint64_t total_reclassified;   ///< 按五元组改记到其他会话的连接数。
+  uint64_t total_conn_expired;   ///< 未收到 DESTROY 即被回收的连接记录数。
 } TrafficMonitorContext;
 
 /*===========================================================================
@@ -148,7 +238,8 @@ int traffic_unregister_session(TrafficMonitorContext *ctx,
 
 /**
  * @brief 获取会话流量统计
- * 通过 Netlink 查询内核 conntrack 计数器
+ * 读取会话 mark 的累计计数器；超过 STATS_CACHE_TTL_SEC 未刷新时先做一次
+ * 过滤 dump (所有会话共用)
  *
  * @param ctx 流量监控上下文指针
  * @param session_id 会话 ID
@@ -181,13 +272,26 @@ int traffic_get_all_stats(TrafficMonitorContext *ctx,
 
 /**
  * @brief 刷新统计缓存
- * 强制从内核重新读取所有会话的流量计数器
+ * 立即做一次过滤 dump，把存活连接的计数器累加到 mark 表
  *
  * @param ctx 流量监控上下文指针
  * @return 0=成功, -1=失败
  */
 int traffic_refresh_stats(TrafficMonitorContext *ctx);
 
+/**
+ * @brief 安装按五元组的流量归属回调
+ * conntrack 后端累计计数时先按连接原方向五元组查询所属会话，命中且
+ * 该会话已注册时计入其 mark 槽位，否则仍按连接 mark 计入。
+ * NFT_COUNTERS 后端在内核中按 mark 计数，不经过回调。
+ *
+ * @param ctx 流量监控上下文指针 (须已初始化)
+ * @param fn 归属回调 (NULL=取消)
+ * @param arg 回调参数
+ */
+void traffic_set_classifier(TrafficMonitorContext *ctx, TrafficClassifyFn fn,
+                            void *arg);
+
 /**
  * @brief 查找会话
  *
@@ -241,4 +345,12 @@ uint32_t traffic_session_id_to_mark(const char *session_id);
  */
 TrafficBackendType traffic_detect_backend(void);
 
+/**
+ * @brief 后端类型名称 (用于日志)
+ *
+ * @param backend 后端类型
+ * @return 名称字符串
+ */
+const char *traffic_backend_name(TrafficBackendType backend);
+
 #endif /* MAGIC_TRAFFIC_MONITOR_H */
@@ -0,0 +1,396 @@
+/**
+ * @file mih_linkstate.h
+ * @brief DLM 与 CM Core 之间的共享内存链路状态表
+ * @description 每个 DLM 独占一个缓存行对齐的槽位, 以 seqlock 发布
+ *              链路状态 (状态、带宽、延迟、RSSI、Bearer 数); CM Core
+ *              无锁、无系统调用地读取最新快照。Unix Socket 仅承载控制原语。
+ *
+ * 内存布局 (文件 MIH_LINKSTATE_PATH, 由 CM Core 创建):
+ * +---------------------------+  0
+ * | 区域头 (magic/version)     |
+ * +---------------------------+  64
+ * | 槽位 0 (缓存行对齐)        |
+ * | 槽位 1                     |
+ * | ...                       |
+ * +---------------------------+
+ *
+ * seqlock 协议:
+ * - 写者 (槽位所属 DLM, 每个槽位只有一个写者):
+ *   seq 加 1 (奇数, 写入中) → 写数据 → seq 加 1 (偶数, 完成)
+ * - 读者 (CM Core): 读 seq (须为偶数) → 复制数据 → 再读 seq,
+ *   两次相同则快照一致, 否则重试
+ *
+ * 快照仅供参考: 任何能写共享区的进程都能改写任意槽位, 读者只能据此
+ * 降低链路的可选性 (Down/GoingDown、更高的 Bearer 数), 不能据此放行;
+ * 链路注册与资源分配仍以 Unix Socket 上的 MIH 原语为准。
+ *
+ * 本文件为纯头文件实现, DLM 与 CM Core 共同包含, 无需额外链接库。
+ *
+ * @author MAGIC System Development Team
+ * @date 2025-12-01
+ */
+
+#ifndef MIH_LINKSTATE_H /* 头文件保护宏开始 */
+#define MIH_LINKSTATE_H /* 防止重复包含 */
+
+#include <errno.h>    /* 错误码 */
+#include <fcntl.h>    /* open */
+#include <signal.h>   /* kill (检测槽位所有者是否存活) */
+#include <stdbool.h>  /* 布尔类型 */
+#include <stdint.h>   /* 标准整数类型 */
+#include <string.h>   /* memcpy, strncmp */
+#include <sys/mman.h> /* mmap */
+#include <sys/stat.h> /* fstat, fchmod */
+#include <time.h>     /* clock_gettime */
+#include <unistd.h>   /* ftruncate, getpid, geteuid */
+
+/*===========================================================================
+ * 配置常量
+ *===========================================================================*/
+
+#define MIH_LINKSTATE_PATH "/dev/shm/magic_linkstate" /* 共享区文件 */
+#define MIH_LINKSTATE_MODE 0660                       /* 属主与同组可读写 */
+#define MIH_LINKSTATE_MAGIC 0x4D4C5354U               /* "MLST" */
+#define MIH_LINKSTATE_VERSION 1                       /* 布局版本 */
+#define MIH_LINKSTATE_MAX_SLOTS 16                    /* 槽位数 (DLM 数上限) */
+#define MIH_LINKSTATE_LINK_ID_LEN 48                  /* 链路 ID 长度 */
+#define MIH_LINKSTATE_READ_RETRIES 64                 /* 读者最大重试次数 */
+
+/*===========================================================================
+ * 数据结构
+ *===========================================================================*/
+
+/**
+ * @brief 链路状态快照 (由 DLM 发布)
+ */
+typedef struct {
+  uint8_t link_state;                /* mih_link_state_t (LINK_STATE_*) */
+  uint8_t signal_quality;            /* 信号质量 (0-100) */
+  uint16_t active_bearers;           /* 当前活动的 Bearer 数量 */
+  int32_t signal_strength_dbm;       /* 信号强度 (dBm) */
+  uint32_t available_bandwidth_kbps; /* 可用带宽 (kbps) */
+  uint32_t current_tx_rate_kbps;     /* 当前发送速率 (kbps) */
+  uint32_t current_rx_rate_kbps;     /* 当前接收速率 (kbps) */
+  uint32_t current_latency_ms;       /* 当前延迟 (毫秒) */
+  uint32_t current_jitter_ms;        /* 延迟抖动 (毫秒) */
+  uint32_t reserved;                 /* 保留, 用于对齐 */
+  uint64_t update_ms; /* 发布时刻 (CLOCK_MONOTONIC 毫秒), 由发布函数填写 */
+} mih_linkstate_snapshot_t;
+
+/**
+ * @brief 链路状态槽位 (缓存行对齐, 避免不同 DLM 之间伪共享)
+ */
+typedef struct {
+  uint32_t seq;                            /* seqlock 序号 */
+  int32_t owner_pid;                       /* 所属 DLM 进程 (0=空闲) */
+  char link_id[MIH_LINKSTATE_LINK_ID_LEN]; /* 链路 ID (与注册时一致) */
+  mih_linkstate_snapshot_t state;          /* 链路状态快照 */
+} __attribute__((aligned(64))) mih_linkstate_slot_t;
+
+/**
+ * @brief 共享区头部
+ */
+typedef struct {
+  uint32_t magic;     /* MIH_LINKSTATE_MAGIC */
+  uint16_t version;   /* MIH_LINKSTATE_VERSION */
+  uint16_t num_slots; /* 槽位数 */
+  uint32_t slot_size; /* sizeof(mih_linkstate_slot_t), 校验布局一致 */
+} __attribute__((aligned(64))) mih_linkstate_header_t;
+
+/**
+ * @brief 共享区整体布局
+ */
+typedef struct {
+  mih_linkstate_header_t header;
+  mih_linkstate_slot_t slots[MIH_LINKSTATE_MAX_SLOTS];
+} mih_linkstate_region_t;
+
+/*===========================================================================
+ * 共享区映射
+ *===========================================================================*/
+
+/**
+ * @brief 校验共享区头部是否与当前布局一致
+ */
+static inline int
+mih_linkstate_header_valid(const mih_linkstate_region_t *region) {
+  return region->header.magic == MIH_LINKSTATE_MAGIC &&
+         region->header.version == MIH_LINKSTATE_VERSION &&
+         region->header.num_slots == MIH_LINKSTATE_MAX_SLOTS &&
+         region->header.slot_size == sizeof(mih_linkstate_slot_t);
+}
+
+/**
+ * @brief 校验共享区文件的类型、属主与权限
+ * @param fd 已打开的共享区文件
+ * @param st fd 的 fstat 结果
+ * @param create 非 0 时为创建者 (CM Core): 文件须属于自己, 权限重设为
+ *               MIH_LINKSTATE_MODE; 否则 (DLM) 属主须为自己或 root,
+ *               且权限不宽于 MIH_LINKSTATE_MODE
+ * @return 0 通过, -1 不通过 (errno=EPERM)
+ */
+static inline int mih_linkstate_check_file(int fd, const struct stat *st,
+                                           int create) {
+  uid_t self = geteuid();
+
+  if (!S_ISREG(st->st_mode) ||
+      (st->st_uid != self && (create || st->st_uid != 0))) {
+    errno = EPERM;
+    return -1;
+  }
+  mode_t mode = st->st_mode & 07777;
+  if (create && mode != MIH_LINKSTATE_MODE) {
+    /* 不受 umask 影响, 同组 DLM 须可写 */
+    return fchmod(fd, MIH_LINKSTATE_MODE);
+  }
+  if (mode & ~MIH_LINKSTATE_MODE) {
+    errno = EPERM;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief 映射共享区文件
+ *
+ * /dev/shm 对所有用户可写, 文件可能被他人预先创建或替换为符号链接:
+ * 创建时以 O_EXCL 新建 (已存在则不跟随符号链接地打开), 打开后用 fstat
+ * 校验属主与权限, 不符合时拒绝映射。
+ *
+ * @param create 非 0 时创建/调整文件大小 (CM Core), 否则只附着 (DLM)
+ * @return 映射地址, 失败返回 NULL
+ */
+static inline mih_linkstate_region_t *mih_linkstate_map(int create) {
+  int flags = O_RDWR | O_NOFOLLOW | O_CLOEXEC;
+  int fd = -1;
+
+  if (create) {
+    fd = open(MIH_LINKSTATE_PATH, flags | O_CREAT | O_EXCL,
+              MIH_LINKSTATE_MODE);
+  }
+  if (fd < 0 && (!create || errno == EEXIST)) {
+    fd = open(MIH_LINKSTATE_PATH, flags);
+  }
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || mih_linkstate_check_file(fd, &st, create) != 0) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return NULL;
+  }
+  if (create && (size_t)st.st_size != sizeof(mih_linkstate_region_t)) {
+    if (ftruncate(fd, sizeof(mih_linkstate_region_t)) != 0) {
+      close(fd);
+      return NULL;
+    }
+    st.st_size = sizeof(mih_linkstate_region_t);
+  }
+  if ((size_t)st.st_size < sizeof(mih_linkstate_region_t)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  void *addr = mmap(NULL, sizeof(mih_linkstate_region_t),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return addr == MAP_FAILED ? NULL : (mih_linkstate_region_t *)addr;
+}
+
+/**
+ * @brief 创建 (或重新附着) 共享区 - CM Core 调用
+ *
+ * 布局已一致时保留现有内容, CM Core 重启后运行中的 DLM 无需重新认领槽位。
+ *
+ * @return 映射地址, 失败返回 NULL
+ */
+static inline mih_linkstate_region_t *mih_linkstate_create(void) {
+  mih_linkstate_region_t *region = mih_linkstate_map(1);
+  if (region && !mih_linkstate_header_valid(region)) {
+    memset(region, 0, sizeof(*region));
+    region->header.version = MIH_LINKSTATE_VERSION;
+    region->header.num_slots = MIH_LINKSTATE_MAX_SLOTS;
+    region->header.slot_size = sizeof(mih_linkstate_slot_t);
+    /* magic 最后写入, DLM 见到 magic 即可认为布局已初始化 */
+    __atomic_store_n(&region->header.magic, MIH_LINKSTATE_MAGIC,
+                     __ATOMIC_RELEASE);
+  }
+  return region;
+}
+
+/**
+ * @brief 附着到 CM Core 创建的共享区 - DLM 调用
+ * @return 映射地址, 共享区不存在或布局不一致时返回 NULL
+ */
+static inline mih_linkstate_region_t *mih_linkstate_attach(void) {
+  mih_linkstate_region_t *region = mih_linkstate_map(0);
+  if (region && !mih_linkstate_header_valid(region)) {
+    munmap(region, sizeof(*region));
+    return NULL;
+  }
+  return region;
+}
+
+/**
+ * @brief 解除共享区映射
+ */
+static inline void mih_linkstate_detach(mih_linkstate_region_t *region) {
+  if (region) {
+    munmap(region, sizeof(*region));
+  }
+}
+
+/*===========================================================================
+ * 写者 (DLM)
+ *===========================================================================*/
+
+/**
+ * @brief 获取当前单调时钟 (毫秒)
+ */
+static inline uint64_t mih_linkstate_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/**
+ * @brief 开始写入槽位 (seq 变为奇数)
+ */
+static inline void mih_linkstate_write_begin(mih_linkstate_slot_t *slot) {
+  uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 结束写入槽位 (seq 变为偶数)
+ */
+static inline void mih_linkstate_write_end(mih_linkstate_slot_t *slot) {
+  uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 认领链路状态槽位
+ *
+ * 优先复用同一链路 ID 的槽位 (DLM 重启), 其原所有者须已退出;
+ * 否则认领一个空闲槽位。
+ *
+ * @param region 共享区
+ * @param link_id 链路 ID (与 MIH 注册时的 link_addr 一致)
+ * @return 槽位指针, 无可用槽位返回 NULL
+ */
+static inline mih_linkstate_slot_t *
+mih_linkstate_claim(mih_linkstate_region_t *region, const char *link_id) {
+  int32_t self = (int32_t)getpid();
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < MIH_LINKSTATE_MAX_SLOTS; i++) {
+      mih_linkstate_slot_t *slot = &region->slots[i];
+      int32_t owner = __atomic_load_n(&slot->owner_pid, __ATOMIC_ACQUIRE);
+
+      if (pass == 0) {
+        /* 第一轮: 同名槽位, 所有者空闲或已退出 */
+        if (strncmp(slot->link_id, link_id, MIH_LINKSTATE_LINK_ID_LEN) != 0 ||
+            (owner != 0 && owner != self &&
+             !(kill(owner, 0) != 0 && errno == ESRCH))) {
+          continue;
+        }
+      } else if (owner != 0) {
+        /* 第二轮: 任意空闲槽位 */
+        continue;
+      }
+
+      if (owner != self &&
+          !__atomic_compare_exchange_n(&slot->owner_pid, &owner, self, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        continue;
+      }
+
+      mih_linkstate_write_begin(slot);
+      strncpy(slot->link_id, link_id, MIH_LINKSTATE_LINK_ID_LEN - 1);
+      slot->link_id[MIH_LINKSTATE_LINK_ID_LEN - 1] = '\0';
+      memset(&slot->state, 0, sizeof(slot->state));
+      slot->state.update_ms = mih_linkstate_now_ms();
+      mih_linkstate_write_end(slot);
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief 发布链路状态快照
+ * @param slot 已认领的槽位
+ * @param state 链路状态 (update_ms 由本函数填写)
+ */
+static inline void
+mih_linkstate_publish(mih_linkstate_slot_t *slot,
+                      const mih_linkstate_snapshot_t *state) {
+  mih_linkstate_write_begin(slot);
+  memcpy(&slot->state, state, sizeof(slot->state));
+  slot->state.update_ms = mih_linkstate_now_ms();
+  mih_linkstate_write_end(slot);
+}
+
+/**
+ * @brief 释放槽位 (DLM 退出前调用)
+ *
+ * 保留链路 ID 并把状态置为 Down, 读者据此立即看到链路不可用。
+ */
+static inline void mih_linkstate_release(mih_linkstate_slot_t *slot) {
+  mih_linkstate_write_begin(slot);
+  memset(&slot->state, 0, sizeof(slot->state));
+  slot->state.update_ms = mih_linkstate_now_ms();
+  mih_linkstate_write_end(slot);
+  __atomic_store_n(&slot->owner_pid, 0, __ATOMIC_RELEASE);
+}
+
+/*===========================================================================
+ * 读者 (CM Core)
+ *===========================================================================*/
+
+/**
+ * @brief 无锁读取指定链路的状态快照
+ *
+ * @param region 共享区
+ * @param link_id 链路 ID
+ * @param[out] state 一致的状态快照
+ * @return 0 成功, -1 未找到该链路或写者持续写入导致重试耗尽
+ */
+static inline int mih_linkstate_read(const mih_linkstate_region_t *region,
+                                     const char *link_id,
+                                     mih_linkstate_snapshot_t *state) {
+  for (int i = 0; i < MIH_LINKSTATE_MAX_SLOTS; i++) {
+    const mih_linkstate_slot_t *slot = &region->slots[i];
+    char id[MIH_LINKSTATE_LINK_ID_LEN];
+
+    for (int tries = 0; tries < MIH_LINKSTATE_READ_RETRIES; tries++) {
+      uint32_t begin = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      if (begin & 1) {
+        continue; /* 写入中 */
+      }
+
+      memcpy(id, slot->link_id, sizeof(id));
+      memcpy(state, &slot->state, sizeof(*state));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+      if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != begin) {
+        continue; /* 快照被改写, 重试 */
+      }
+
+      id[sizeof(id) - 1] = '\0';
+      if (strcmp(id, link_id) == 0) {
+        return 0;
+      }
+      break; /* 一致但不是目标链路 */
+    }
+  }
+  return -1;
+}
+
+#endif /* MIH_LINKSTATE_H */
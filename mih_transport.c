@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 /*===========================================================================
@@ -25,7 +26,7 @@
  * @brief 全局事务 ID 计数器
  *
  * 用于生成唯一的 MIH 消息事务标识符
- * 线程不安全，需要在多线程环境中保护
+ * 通过原子操作递增，可在多线程环境中并发调用
  */
 static uint32_t g_transaction_id = 0;
 
@@ -85,27 +86,59 @@ int mih_transport_send(int sockfd,
                       uint16_t primitive_type,
                       const void *payload,
                       size_t payload_len)
+{
+    /* 自动分配事务 ID */
+    return mih_transport_send_txn(sockfd, primitive_type, payload,
+                                  payload_len, 0);
+}
+
+/**
+ * @brief 发送携带指定事务 ID 的 MIH 消息
+ *
+ * 头部与有效载荷以两个 iovec 一次 sendmsg() 发出 (有效载荷不拷贝)，
+ * 多个线程写同一 Socket 时不会出现头部/载荷交错；
+ * 顺序包 Socket 上一次 sendmsg() 恰好对应一条记录
+ *
+ * @param sockfd Socket 文件描述符
+ * @param primitive_type MIH 原语类型
+ * @param payload 消息有效载荷数据
+ * @param payload_len 有效载荷长度
+ * @param transaction_id 事务 ID (0 表示自动生成)
+ * @return 成功返回 0, 失败返回 -1
+ */
+int mih_transport_send_txn(int sockfd,
+                          uint16_t primitive_type,
+                          const void *payload,
+                          size_t payload_len,
+                          uint32_t transaction_id)
 {
     /* 参数验证 */
-    if (sockfd < 0 || !payload || payload_len == 0) {
+    if (sockfd < 0 || !payload || payload_len == 0 ||
+        payload_len > MIH_MAX_FRAME_SIZE - sizeof(mih_transport_header_t)) {
         return -1;
     }
 
-    /* 构造消息头 */
+    /* 构造消息头, 有效载荷直接引用调用方缓冲区 */
     mih_transport_header_t header;
-    mih_transport_init_header(&header, primitive_type, payload_len, 0);
-
-    /* 发送消息头 */
-    ssize_t sent = send(sockfd, &header, sizeof(header), 0);
-    if (sent != sizeof(header)) {
-        /* 头部发送失败 */
-        return -1;
-    }
-
-    /* 发送有效载荷 */
-    sent = send(sockfd, payload, payload_len, 0);
-    if ((size_t)sent != payload_len) {
-        /* 有效载荷发送失败 */
+    mih_transport_init_header(&header, primitive_type, payload_len,
+                              transaction_id);
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = payload_len;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    /* 一次发送完整消息 (对端关闭时不产生 SIGPIPE) */
+    size_t total = sizeof(header) + payload_len;
+    ssize_t sent = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    if (sent < 0 || (size_t)sent != total) {
+        /* 发送失败或被截断 */
         return -1;
     }
 
@@ -226,15 +259,13 @@ int mih_transport_connect(const char *socket_path,
 }
 
 /**
- * @brief 创建 MIH 服务器 Socket
- *
- * 创建 Unix Domain Socket 服务器
- * 绑定到指定路径并开始监听连接请求
+ * @brief 创建并监听指定类型的 Unix Domain Socket 服务器
  *
  * @param socket_path Socket 文件路径
+ * @param type SOCK_STREAM 或 SOCK_SEQPACKET
  * @return 成功返回服务器 Socket 文件描述符, 失败返回 -1
  */
-int mih_transport_create_server(const char *socket_path)
+static int mih_transport_listen(const char *socket_path, int type)
 {
     /* 参数验证 */
     if (!socket_path) {
@@ -242,7 +273,7 @@ int mih_transport_create_server(const char *socket_path)
     }
 
     /* 创建服务器 Socket */
-    int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int sockfd = socket(AF_UNIX, type, 0);
     if (sockfd < 0) {
         perror("[MIH Transport] socket");
         return -1;
@@ -276,6 +307,34 @@ int mih_transport_create_server(const char *socket_path)
     return sockfd;
 }
 
+/**
+ * @brief 创建 MIH 服务器 Socket
+ *
+ * 创建 Unix Domain Socket 服务器
+ * 绑定到指定路径并开始监听连接请求
+ *
+ * @param socket_path Socket 文件路径
+ * @return 成功返回服务器 Socket 文件描述符, 失败返回 -1
+ */
+int mih_transport_create_server(const char *socket_path)
+{
+    return mih_transport_listen(socket_path, SOCK_STREAM);
+}
+
+/**
+ * @brief 创建顺序包模式 MIH 服务器 Socket
+ *
+ * 与流式服务器使用相同的 12 字节帧头, 但内核保留记录边界:
+ * 每次 recv() 恰好得到一个完整原语, 接收端无需帧重组
+ *
+ * @param socket_path Socket 文件路径
+ * @return 成功返回服务器 Socket 文件描述符, 失败返回 -1
+ */
+int mih_transport_create_seqpacket_server(const char *socket_path)
+{
+    return mih_transport_listen(socket_path, SOCK_SEQPACKET);
+}
+
 /*===========================================================================
  * 事务 ID 管理函数
  *===========================================================================*/
@@ -284,14 +343,19 @@ int mih_transport_create_server(const char *socket_path)
  * @brief 获取下一个事务 ID
  *
  * 生成唯一的 MIH 消息事务标识符
- * 使用全局计数器，自动递增
+ * 使用全局计数器原子递增，回绕时跳过 0 (0 保留为 "自动生成")
  *
  * @return 新的唯一事务 ID
  */
 uint32_t mih_transport_next_transaction_id(void)
 {
+    uint32_t id;
+
     /* 返回递增后的事务 ID */
-    return ++g_transaction_id;
+    do {
+        id = __atomic_add_fetch(&g_transaction_id, 1, __ATOMIC_RELAXED);
+    } while (id == 0);
+    return id;
 }
 
 /*===========================================================================
@@ -4,9 +4,10 @@
  * @description Provides IPC mechanisms for CM Core <-> DLM communication - 为CM核心<->DLM通信提供IPC机制
  * @date 2025-11-27
  * 
- * 支持两种传输模式:
+ * 支持三种传输模式:
  * 1. 流式模式 (SOCK_STREAM): 使用完整 mih_transport_header_t (12 字节)
- * 2. 数据报模式 (SOCK_DGRAM): 使用简化 2 字节类型码前缀
+ * 2. 顺序包模式 (SOCK_SEQPACKET): 帧格式同流式, 每个原语一条记录, 内核保留边界
+ * 3. 数据报模式 (SOCK_DGRAM): 使用简化 2 字节类型码前缀
  */
 
 #ifndef MIH_TRANSPORT_H  // 防止头文件被重复包含的保护宏开始
@@ -15,15 +16,18 @@
 #include <stdint.h>      // 包含标准整数类型定义头文件，提供uint16_t、uint32_t等类型
 #include <sys/types.h>   // 包含系统类型定义头文件，提供size_t等类型
 #include <sys/socket.h>  // 包含套接字定义头文件，提供 struct sockaddr, socklen_t 等
+#include <sys/uio.h>     // 包含分散/聚集 I/O 定义头文件，提供 struct iovec
 
 /*===========================================================================
  * Transport Configuration - 传输配置
  *===========================================================================*/
 
-#define MIH_SOCKET_PATH         "/tmp/magic_core.sock"  // MIH套接字路径，Unix域套接字文件路径 (流式)
-#define MIH_DGRAM_SOCKET_PATH   "/tmp/mihf.sock"        // MIH数据报套接字路径 (用于 DLM 原型)
-#define MIH_MAX_MESSAGE_SIZE    4096                    // MIH最大消息大小，单位字节
-#define MIH_SOCKET_BACKLOG      10                      // MIH套接字监听队列长度
+#define MIH_SOCKET_PATH           "/tmp/magic_core.sock"     // MIH套接字路径，Unix域套接字文件路径 (流式)
+#define MIH_SEQPACKET_SOCKET_PATH "/tmp/magic_core_seq.sock" // MIH顺序包套接字路径 (保留消息边界)
+#define MIH_DGRAM_SOCKET_PATH     "/tmp/mihf.sock"           // MIH数据报套接字路径 (用于 DLM 原型)
+#define MIH_MAX_MESSAGE_SIZE      4096                       // MIH数据报模式最大消息大小，单位字节
+#define MIH_MAX_FRAME_SIZE        65535                      // 流式/顺序包帧上限 (message_length 为 16 位)
+#define MIH_SOCKET_BACKLOG        10                         // MIH套接字监听队列长度
 
 /* 简化消息头大小 (仅 2 字节类型码) - 用于数据报模式 */
 #define MIH_DGRAM_HEADER_SIZE   2
@@ -80,6 +84,24 @@ int mih_transport_send(int sockfd,                              // 通过套接
                       const void *payload,                      // 有效载荷指针参数
                       size_t payload_len);                      // 有效载荷长度参数
 
+/**
+ * @brief Send MIH message with explicit transaction ID - 发送携带指定事务ID的MIH消息
+ * @param sockfd Socket file descriptor - 套接字文件描述符
+ * @param primitive_type MIH primitive type - MIH原语类型
+ * @param payload Pointer to MIH primitive payload - 指向MIH原语有效载荷的指针
+ * @param payload_len Size of payload - 有效载荷大小
+ * @param transaction_id Transaction ID (0 = auto-generate) - 事务ID（0 = 自动生成）
+ * @return 0 on success, -1 on failure - 成功返回0，失败返回-1
+ *
+ * @note Header and payload go out in a single sendmsg() - 头部与有效载荷以 iovec
+ *       一次 sendmsg() 发出, 不拷贝有效载荷; 帧上限 MIH_MAX_FRAME_SIZE
+ */
+int mih_transport_send_txn(int sockfd,                          // 发送携带事务ID的MIH消息函数
+                          uint16_t primitive_type,              // MIH原语类型参数
+                          const void *payload,                  // 有效载荷指针参数
+                          size_t payload_len,                   // 有效载荷长度参数
+                          uint32_t transaction_id);             // 事务ID参数
+
 /**
  * @brief Receive MIH message from socket - 从套接字接收MIH消息
  * @param sockfd Socket file descriptor - 套接字文件描述符
@@ -89,6 +111,7 @@ int mih_transport_send(int sockfd,                              // 通过套接
  * @return Bytes received (payload only), -1 on failure - 接收到的字节数（仅有效载荷），失败返回-1
  * 
  * @note This function reads header first, validates it, then reads payload - 此函数首先读取头，验证它，然后读取有效载荷
+ * @note Stream sockets only - 仅用于流式 Socket; 顺序包 Socket 须一次 recv() 读取整条记录
  */
 int mih_transport_recv(int sockfd,                             // 从套接字接收MIH消息函数
                       mih_transport_header_t *header,          // 接收头指针参数
@@ -113,6 +136,15 @@ int mih_transport_connect(const char *socket_path,             // 连接到MIH
  */
 int mih_transport_create_server(const char *socket_path);     // 创建MIH服务器套接字函数
 
+/**
+ * @brief 创建并绑定顺序包模式 MIH 服务器套接字 (SOCK_SEQPACKET)
+ * @param socket_path Unix 域套接字路径
+ * @return 成功返回套接字 FD，失败返回 -1
+ *
+ * @note 帧格式与流式模式相同; 每条记录恰好是一个完整原语, 接收端无需重组
+ */
+int mih_transport_create_seqpacket_server(const char *socket_path);
+
 /**
  * @brief Get next transaction ID (auto-increment) - 获取下一个事务ID（自动递增）
  * @return New transaction ID - 新事务ID